@@ -193,6 +193,7 @@ void DoParameterSVD(const ConfigParameters& config)
     }
 
     ComputationNetwork net(deviceID);
+    net.SetElementwiseFusion(false); // the decomposition edits the nodes by name
     net.Load<ElemType>(modelPath);
 
     net.PerformSVDecomposition<ElemType>(svdconfig, AlignedSize);
@@ -523,6 +524,7 @@ void DoTopologyPlot(const ConfigParameters& config)
         outputDotFile = modelPath + L".dot";
 
     ComputationNetwork net(CPUDEVICE);
+    net.SetElementwiseFusion(false); // plot the network as it was created
     net.Load<ElemType>(modelPath);
 
     net.PlotNetworkTopology(outputDotFile);
@@ -63,6 +63,7 @@ void DoExportToDbn(const ConfigParameters& config)
     wstring dbnModelPath = config("dbnModelPath");
 
     ComputationNetworkPtr net = make_shared<ComputationNetwork>(deviceID);
+    net->SetElementwiseFusion(false); // the export looks for the individual nodes of each layer
     net->Load<ElemType>(modelPath);
 
     // write dbn file
@@ -218,7 +218,9 @@ void DoDumpNodes(const ConfigParameters& config)
     if (!printValues && !printMetadata)
         InvalidArgument("printValues and printMetadata: Since both are set to false, there will be nothing to dump");
 
-    ComputationNetworkPtr net = ComputationNetwork::CreateFromFile<ElemType>(CPUDEVICE, modelPath);
+    ComputationNetworkPtr net = make_shared<ComputationNetwork>(CPUDEVICE);
+    net->SetElementwiseFusion(false); // dump all nodes of the model
+    net->Load<ElemType>(modelPath);
     net->DumpNodeInfoToFile(nodeName, printValues, printMetadata, outputFile, nodeNameRegexStr);
 }
 
@@ -534,6 +534,9 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
 
     Globals::SetShareNodeValueMatrices(config(L"shareNodeValueMatrices", true));
     Globals::SetGradientAccumulationOptimization(config(L"optimizeGradientAccumulation", true));
+    Globals::SetNumNodeExecutionThreads(config(L"numNodeExecutionThreads", (size_t)0));
+    Globals::SetElementwiseFusion(config(L"fuseElementwiseOperations", true));
+    Globals::SetWinogradConvolution(config(L"useWinogradConvolution", false));
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
 
@@ -677,6 +680,9 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
 
     Globals::SetShareNodeValueMatrices(config(L"shareNodeValueMatrices", true));
     Globals::SetGradientAccumulationOptimization(config(L"optimizeGradientAccumulation", true));
+    Globals::SetNumNodeExecutionThreads(config(L"numNodeExecutionThreads", (size_t)0));
+    Globals::SetElementwiseFusion(config(L"fuseElementwiseOperations", true));
+    Globals::SetWinogradConvolution(config(L"useWinogradConvolution", false));
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
 
@@ -121,6 +121,7 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
         std::wstring modelFormat = GetOptionalModelFormat(params, numFixedParams);
 
         auto cn = make_shared<ComputationNetwork>(CPUDEVICE);
+        cn->SetElementwiseFusion(false); // MEL accesses the nodes by name
         cn->Load<ElemType>(params[0]);
         OverrideModelNameAndSetDefaultModel(cn);
     }
@@ -133,6 +134,7 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
         std::wstring modelFormat = GetOptionalModelFormat(params, numFixedParams);
 
         auto cn = make_shared<ComputationNetwork>(CPUDEVICE);
+        cn->SetElementwiseFusion(false); // MEL accesses the nodes by name
 #if 1 // support for a specific kind of legacy format, for the sole purpose of allowing users to convert (=load & save) them
         if (modelFormat == L"cntk_legacy_no_tensorlib")
         {
@@ -20,7 +20,9 @@
 #include <iosfwd>
 #include <algorithm>
 #include <mutex>
+#include <condition_variable>
 #include <future>
+#include <atomic>
 #include <cstddef>
 
 #ifdef SWIG
@@ -516,6 +518,7 @@ namespace CNTK
         friend class BlockMomentumDistributedLearner;
         friend class Internal::VariableResolver;
         friend class Trainer;
+        friend class Serializer;
 
         template <typename T, typename ...CtorArgTypes>
         friend inline std::shared_ptr<T> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
@@ -772,6 +775,9 @@ namespace CNTK
     private:
         CNTK_API NDArrayView(::CNTK::DataType dataType, const DeviceDescriptor& device, ::CNTK::StorageFormat storageType, const NDShape& viewShape, bool readOnly, void* tensorView);
 
+        // Construct a dense CPU view of memory-mapped data; the 'mapping' is kept alive as long as any view of the data exists.
+        NDArrayView(::CNTK::DataType dataType, const NDShape& viewShape, void* dataBuffer, size_t bufferSizeInBytes, const std::shared_ptr<void>& mapping);
+
         template <typename ElementType>
         static std::shared_ptr<Microsoft::MSR::CNTK::Matrix<ElementType>> GetMatrixImpl(const Microsoft::MSR::CNTK::TensorView<ElementType>* tensorView, size_t rowColSplitPoint);
 
@@ -793,6 +799,7 @@ namespace CNTK
         ::CNTK::StorageFormat m_storageFormat;
         NDShape m_viewShape;
         bool m_isReadOnly;
+        bool m_isMemoryMapped; // the data is memory-mapped from a model file (see ModelFormat::CNTKv2RawTensors)
 
         std::shared_ptr<void> m_tensorView; // Microsoft::MSR::CNTK::TensorView<ElemType>*
     };
@@ -2823,6 +2830,24 @@ namespace CNTK
         Invalid,
     };
 
+    ///
+    /// Format of the model files written by Function::SaveModel
+    ///
+    enum class ModelFormat
+    {
+        ///
+        /// The graph and the values of the Parameters and Constants in one protobuf message
+        ///
+        CNTKv2,
+
+        ///
+        /// The graph in a protobuf message, followed by the values of the Parameters and Constants as raw, 64-byte aligned tensors.
+        /// Function::LoadModel memory-maps these files and uses the values in place (on the CPU) instead of copying them,
+        /// so that loading is fast, and all processes that load the same model share its memory.
+        ///
+        CNTKv2RawTensors,
+    };
+
     ///
     /// Represents a function (optionally differentiable w.r.t. its inputs)
     /// A Function denotes a symbolic computation with zero or more input arguments and one or more outputs. 
@@ -3169,7 +3194,7 @@ namespace CNTK
         ///
         /// Save this Function graph into a model file.
         ///
-        CNTK_API void SaveModel(const std::wstring& modelFile);
+        CNTK_API void SaveModel(const std::wstring& modelFile, ModelFormat format = ModelFormat::CNTKv2);
 
         ///
         /// Restore the models parameters (in-place) from a model file
@@ -3177,7 +3202,8 @@ namespace CNTK
         CNTK_API void RestoreModel(const std::wstring& modelFilePath);
 
         ///
-        /// Load a Function from a model file
+        /// Load a Function from a model file. The values of models in the ModelFormat::CNTKv2RawTensors format
+        /// are memory-mapped and used in place, if computeDevice is the CPU.
         ///
         CNTK_API static FunctionPtr LoadModel(const std::wstring& modelFile, const DeviceDescriptor& computeDevice = DeviceDescriptor::UseDefaultDevice());
 
@@ -4183,6 +4209,12 @@ namespace CNTK
         // This option results in the mean value of the gradients across the samples in the minibatch to be used by the learner.
         // The mean gradient is computed by dividing the gradient values accumulated across all samples by the actual number of samples (labels) in the minibatch.
         bool useMeanGradient = false;
+
+        // This option results in all parameters of the learner being updated at once, in a single parallel pass over all of them
+        // that also applies the gradient clipping and L2 regularization, instead of a sequence of operations for each parameter.
+        // The smoothed gradients of the learner are then kept in a single buffer. It is currently supported by the SGD, momentum SGD,
+        // Nesterov, FSAdaGrad and Adam learners, for dense parameters and gradients on the CPU; otherwise it has no effect.
+        bool fuseParameterUpdates = false;
     };
 
     ///  
@@ -4479,6 +4511,19 @@ namespace CNTK
         bool resetSGDMomentumAfterAggregation = true,
         double blockLearningRate = 1.0);
 
+    ///
+    /// Create a data parallel distributed learner that exchanges only the 'sparsity' fraction of the entries of each gradient
+    /// with the largest magnitude (or, if 'threshold' is positive, the entries whose magnitude reaches it), and accumulates
+    /// the other entries locally until they are sent. The compression ratio and the communication time are reported to
+    /// the progress writers at the end of each sweep.
+    ///
+    CNTK_API DistributedLearnerPtr CreateSparseGradientDistributedLearner(
+        DistributedCommunicatorPtr communicator,
+        LearnerPtr learner,
+        size_t distributeAfterSamples,
+        double sparsity = 0.01,
+        double threshold = 0);
+
     ///
     /// Describes an input stream: its name, element type, storage, etc.
     ///
@@ -4603,6 +4648,93 @@ namespace CNTK
     ///
     CNTK_API EvaluatorPtr CreateEvaluator(const FunctionPtr& evaluationFunction, const std::vector<ProgressWriterPtr>& progressWriters = {});
 
+    ///
+    /// An execution context for evaluating the Function of an EvaluationContextPool. A context must only be used by
+    /// one thread at a time; it is returned to its pool when the EvaluationContextPtr obtained from Acquire() is released.
+    ///
+    class EvaluationContext final
+    {
+        friend class EvaluationContextPool;
+
+        template <typename T, typename ...CtorArgTypes>
+        friend inline std::shared_ptr<T> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
+
+    public:
+        ///
+        /// Computes the specified 'outputs' of the pooled Function for the specified 'arguments'.
+        /// 'arguments' and 'outputs' are keyed by the Arguments() and Outputs() of the Function the pool was created for.
+        /// If the value of an output is null, a new Value object is allocated for it. Otherwise the computed value is
+        /// copied into the specified Value object.
+        ///
+        CNTK_API void Evaluate(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputs);
+
+        ///
+        /// The Function this context evaluates: a clone of the pooled Function that shares its Parameters, Constants and arguments.
+        ///
+        FunctionPtr EvaluationFunction() const { return m_function; }
+
+    private:
+        EvaluationContext(const FunctionPtr& function, const std::vector<Variable>& pooledFunctionOutputs, const DeviceDescriptor& device);
+
+        FunctionPtr m_function;
+        DeviceDescriptor m_device;
+        std::unordered_map<Variable, Variable> m_outputMap; // outputs of the pooled Function -> outputs of m_function
+    };
+
+    ///
+    /// A pool of execution contexts for evaluating a Function concurrently from multiple threads, e.g. in a server.
+    /// All contexts share the Parameters and Constants of the Function, so that the model is stored once.
+    /// The network is not compiled once for all contexts, though: every context is a Clone(ParameterCloningMethod::Share)
+    /// of the Function with a computation network and MatrixPool of its own. Creating a pool therefore compiles the
+    /// network 'numContexts' times, and besides the shared model a pool takes 'numContexts' times the memory of the nodes
+    /// and activations of one evaluation. Since all networks are built when the pool is created, acquiring a context
+    /// only takes a mutex; it is not lock-free.
+    ///
+    class EvaluationContextPool final : public std::enable_shared_from_this<EvaluationContextPool>
+    {
+        template <typename T, typename ...CtorArgTypes>
+        friend inline std::shared_ptr<T> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
+
+    public:
+        ///
+        /// Returns an idle context, which is returned to the pool when the last reference to it is released.
+        /// If all contexts are in use, blocks until one becomes idle.
+        ///
+        CNTK_API EvaluationContextPtr Acquire();
+
+        ///
+        /// The Function that this pool evaluates.
+        ///
+        FunctionPtr EvaluationFunction() const { return m_function; }
+
+        ///
+        /// Number of contexts in the pool, i.e. the number of evaluations that can run concurrently.
+        ///
+        size_t NumContexts() const { return m_contexts.size(); }
+
+        ///
+        /// The device the contexts evaluate on.
+        ///
+        const DeviceDescriptor& Device() const { return m_device; }
+
+    private:
+        EvaluationContextPool(const FunctionPtr& function, size_t numContexts, const DeviceDescriptor& device);
+
+        void Release(size_t index);
+
+        FunctionPtr m_function;
+        DeviceDescriptor m_device;
+        std::vector<std::shared_ptr<EvaluationContext>> m_contexts;
+        std::vector<size_t> m_idleContexts; // indices into m_contexts of the contexts not in use
+        std::mutex m_mutex;                 // protects m_idleContexts
+        std::condition_variable m_contextReleased;
+    };
+
+    ///
+    /// Create a pool of 'numContexts' execution contexts for evaluating the specified Function concurrently on the specified device.
+    ///
+    CNTK_API EvaluationContextPoolPtr CreateEvaluationContextPool(const FunctionPtr& function, size_t numContexts, const DeviceDescriptor& device = DeviceDescriptor::UseDefaultDevice());
+
     ///
     /// Trainer is the top-level abstraction responsible for the orchestration of the training of a model
     /// using the specified learners and training data either explicitly supplied as Value objects or from
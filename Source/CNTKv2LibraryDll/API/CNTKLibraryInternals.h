@@ -203,6 +203,12 @@ namespace CNTK
     class Evaluator;
     typedef std::shared_ptr<Evaluator> EvaluatorPtr;
 
+    class EvaluationContext;
+    typedef std::shared_ptr<EvaluationContext> EvaluationContextPtr;
+
+    class EvaluationContextPool;
+    typedef std::shared_ptr<EvaluationContextPool> EvaluationContextPoolPtr;
+
     class Trainer;
     typedef std::shared_ptr<Trainer> TrainerPtr;
 
@@ -268,6 +274,17 @@ namespace CNTK
         CNTK_API void SetComputationNetworkTrackGapNans(bool enable);
         bool GetComputationNetworkTrackGapNans();
 
+        // Per-node forward/backward timing, reported by the profiler started with StartProfiler().
+        CNTK_API void SetComputationNetworkNodeProfiling(bool enable);
+        bool GetComputationNetworkNodeProfiling();
+
+        // Networks created for evaluation on the CPU (Forward without backprop roots) compute the products of parameters and data
+        // in 16-bit fixed point, see QuantizedTimesNode. If numProductsToCompare is not 0, each quantized product is also computed
+        // without quantization for its first numProductsToCompare evaluations, and its error and speed-up are reported.
+        // Parameters are quantized again whenever their values change, e.g. when they are shared with a network that is trained.
+        CNTK_API void SetEvaluationQuantization(bool enable, size_t bitShiftA = 2, size_t bitShiftB = 2, size_t numProductsToCompare = 0);
+        bool GetEvaluationQuantization(size_t& bitShiftA, size_t& bitShiftB, size_t& numProductsToCompare);
+
         CNTK_API void SetGPUMemoryAllocationTraceLevel(int traceLevel);
 
         CNTK_API void SetMathLibTraceLevel(int traceLevel);
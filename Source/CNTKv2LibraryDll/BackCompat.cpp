@@ -532,6 +532,8 @@ namespace CNTK
             ComputationNetworkPtr net = make_shared<ComputationNetwork>(AsCNTKImplDeviceId(computeDevice));
             net->SetTraceLevel(Internal::GetComputationNetworkTraceLevel());
             net->SetTrackGapNans(Internal::GetComputationNetworkTrackGapNans());
+            net->SetNodeProfiling(Internal::GetComputationNetworkNodeProfiling());
+            net->SetElementwiseFusion(false); // the conversion needs all nodes of the model
 
             auto dataType = DetectLegacyModelDataType(modelFile);
             switch (dataType)
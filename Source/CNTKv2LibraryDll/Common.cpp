@@ -421,6 +421,37 @@ namespace CNTK
             return s_computationNetworkTrackGapNans.load();
         }
 
+        std::atomic<bool> s_computationNetworkNodeProfiling(false);
+        void SetComputationNetworkNodeProfiling(bool enable)
+        {
+            s_computationNetworkNodeProfiling.store(enable);
+        }
+
+        bool GetComputationNetworkNodeProfiling()
+        {
+            return s_computationNetworkNodeProfiling.load();
+        }
+
+        std::atomic<bool> s_evaluationQuantization(false);
+        std::atomic<size_t> s_evaluationQuantizationBitShiftA(2);
+        std::atomic<size_t> s_evaluationQuantizationBitShiftB(2);
+        std::atomic<size_t> s_evaluationQuantizationProductsToCompare(0);
+        void SetEvaluationQuantization(bool enable, size_t bitShiftA, size_t bitShiftB, size_t numProductsToCompare)
+        {
+            s_evaluationQuantizationBitShiftA.store(bitShiftA);
+            s_evaluationQuantizationBitShiftB.store(bitShiftB);
+            s_evaluationQuantizationProductsToCompare.store(numProductsToCompare);
+            s_evaluationQuantization.store(enable);
+        }
+
+        bool GetEvaluationQuantization(size_t& bitShiftA, size_t& bitShiftB, size_t& numProductsToCompare)
+        {
+            bitShiftA = s_evaluationQuantizationBitShiftA.load();
+            bitShiftB = s_evaluationQuantizationBitShiftB.load();
+            numProductsToCompare = s_evaluationQuantizationProductsToCompare.load();
+            return s_evaluationQuantization.load();
+        }
+
         void SetGPUMemoryAllocationTraceLevel(int traceLevel)
         {
             Microsoft::MSR::CNTK::TracingGPUMemoryAllocator::SetTraceLevel(traceLevel);
@@ -1221,8 +1221,23 @@ namespace CNTK
 
             m_computationNetwork->SetTraceLevel(Internal::GetComputationNetworkTraceLevel());
             m_computationNetwork->SetTrackGapNans(Internal::GetComputationNetworkTrackGapNans());
+            m_computationNetwork->SetNodeProfiling(Internal::GetComputationNetworkNodeProfiling());
+            // The Variables of all Functions map to nodes, so nodes cannot be fused away.
+            m_computationNetwork->SetElementwiseFusion(false);
             m_computationNetwork->CompileNetwork();
 
+            // Networks that are only evaluated may use quantized products, which replace the Times nodes of the same name.
+            size_t quantizationBitShiftA, quantizationBitShiftB, numQuantizedProductsToCompare;
+            if (backpropRoots.empty() && Internal::GetEvaluationQuantization(quantizationBitShiftA, quantizationBitShiftB, numQuantizedProductsToCompare) &&
+                m_computationNetwork->QuantizeTimesNodes<ElementType>(quantizationBitShiftA, quantizationBitShiftB, numQuantizedProductsToCompare) > 0)
+            {
+                for (auto& varNodePair : m_variableToNodeMap)
+                {
+                    if (m_computationNetwork->NodeNameExists(varNodePair.second->NodeName()))
+                        varNodePair.second = m_computationNetwork->GetNodeFromName(varNodePair.second->NodeName());
+                }
+            }
+
             // Verify that the shapes of the output Variables that we computed match the corresponding nodes in the ComputationNetwork
             for (auto varNodePair : m_variableToNodeMap)
             {
@@ -47,6 +47,7 @@ namespace CNTK
         friend class Trainer;
         friend class CompositeMinibatchSource;
         friend class PackedValue;
+        friend class EvaluationContextPool;
 
         template <typename T, typename ...CtorArgTypes>
         friend inline std::shared_ptr<T> MakeSharedObject(CtorArgTypes&& ...ctorArgs);
@@ -0,0 +1,124 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "CNTKLibrary.h"
+#include "CompositeFunction.h"
+
+namespace CNTK
+{
+    EvaluationContextPoolPtr CreateEvaluationContextPool(const FunctionPtr& function, size_t numContexts, const DeviceDescriptor& device)
+    {
+        return MakeSharedObject<EvaluationContextPool>(function, numContexts, device);
+    }
+
+    EvaluationContext::EvaluationContext(const FunctionPtr& function, const std::vector<Variable>& pooledFunctionOutputs, const DeviceDescriptor& device)
+        : m_function(function), m_device(device)
+    {
+        auto outputs = m_function->Outputs();
+        if (outputs.size() != pooledFunctionOutputs.size())
+            LogicError("EvaluationContext: The clone '%S' has %d outputs, but the pooled Function has %d.", m_function->AsString().c_str(), (int)outputs.size(), (int)pooledFunctionOutputs.size());
+
+        for (size_t i = 0; i < outputs.size(); ++i)
+            m_outputMap.insert({ pooledFunctionOutputs[i], outputs[i] });
+    }
+
+    void EvaluationContext::Evaluate(const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputs)
+    {
+        std::unordered_map<Variable, ValuePtr> contextOutputs;
+        for (const auto& output : outputs)
+        {
+            auto iter = m_outputMap.find(output.first);
+            if (iter == m_outputMap.end())
+                InvalidArgument("EvaluationContext::Evaluate: Variable '%S' is not an output of the Function the evaluation context was created for.", output.first.AsString().c_str());
+
+            contextOutputs.insert({ iter->second, output.second });
+        }
+
+        m_function->Evaluate(arguments, contextOutputs, m_device);
+
+        for (auto& output : outputs)
+        {
+            auto& value = contextOutputs.at(m_outputMap.at(output.first));
+
+            // A newly allocated output Value may refer to the storage of the context's network, which will be reused by
+            // the next evaluation, possibly on another thread once the context is back in the pool.
+            if (!output.second)
+                value = value->DeepClone();
+
+            output.second = value;
+        }
+    }
+
+    EvaluationContextPool::EvaluationContextPool(const FunctionPtr& function, size_t numContexts, const DeviceDescriptor& device)
+        : m_function(function), m_device(device)
+    {
+        if (!m_function)
+            InvalidArgument("EvaluationContextPool: The Function must not be null.");
+
+        if (numContexts == 0)
+            InvalidArgument("EvaluationContextPool: The number of contexts must be greater than 0.");
+
+        // The clones use the Function's own arguments, so that callers can use the same argument map with every context.
+        std::unordered_map<Variable, Variable> argumentReplacements;
+        for (const auto& argument : m_function->Arguments())
+            argumentReplacements.insert({ argument, argument });
+
+        auto outputs = m_function->Outputs();
+        auto dataType = DataType::Unknown;
+        for (const auto& output : outputs)
+        {
+            if (dataType == DataType::Unknown)
+                dataType = output.GetDataType();
+        }
+
+        // Each context needs a network of its own, as the networks keep the activations in their nodes; only the Parameters and Constants are shared.
+        // Every clone compiles that network separately, with a MatrixPool of its own.
+        m_contexts.reserve(numContexts);
+        for (size_t i = 0; i < numContexts; ++i)
+        {
+            auto clone = m_function->Clone(ParameterCloningMethod::Share, argumentReplacements);
+
+            // Build and allocate the network of the context now, rather than on its first evaluation.
+            auto compositeClone = dynamic_cast<CompositeFunction*>(clone.get());
+            auto cloneOutputs = clone->Outputs();
+            std::unordered_set<Variable> outputsToEvaluate(cloneOutputs.begin(), cloneOutputs.end());
+            if (dataType == DataType::Float)
+                compositeClone->GetComputationNetwork<float>(m_device, {}, outputsToEvaluate, {}, true);
+            else if (dataType == DataType::Double)
+                compositeClone->GetComputationNetwork<double>(m_device, {}, outputsToEvaluate, {}, true);
+
+            m_contexts.push_back(MakeSharedObject<EvaluationContext>(clone, outputs, m_device));
+        }
+
+        // The contexts are handed out last-in, first-out, so that a lightly loaded pool keeps reusing the networks that are warm in the cache.
+        for (size_t i = numContexts; i-- > 0;)
+            m_idleContexts.push_back(i);
+    }
+
+    EvaluationContextPtr EvaluationContextPool::Acquire()
+    {
+        size_t index;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_contextReleased.wait(lock, [this] { return !m_idleContexts.empty(); });
+            index = m_idleContexts.back();
+            m_idleContexts.pop_back();
+        }
+
+        // The returned pointer keeps the pool alive and returns the context to it when released.
+        auto pool = shared_from_this();
+        return EvaluationContextPtr(m_contexts[index].get(), [pool, index](EvaluationContext*) { pool->Release(index); });
+    }
+
+    void EvaluationContextPool::Release(size_t index)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_idleContexts.push_back(index);
+        }
+        m_contextReleased.notify_one();
+    }
+}
@@ -9,6 +9,7 @@
 #include "CompositeFunction.h"
 #include "BlockFunction.h"
 #include "Utils.h"
+#include "Serialization.h"
 #include "UserFunctionFactory.h"
 
 using namespace Microsoft::MSR::CNTK;
@@ -406,18 +407,27 @@ namespace CNTK
         Forward(arguments, outputs, computeDevice, {});
     }
 
-    void Function::SaveModel(const std::wstring& modelFilePath)
+    void Function::SaveModel(const std::wstring& modelFilePath, ModelFormat format/* = ModelFormat::CNTKv2*/)
     {
         Dictionary model = Serialize();
-        auto stream = GetFstream(modelFilePath, false);
-        *stream << model;
-        stream->flush();
+        if (format == ModelFormat::CNTKv2RawTensors)
+        {
+            SaveRawTensorModel(model, modelFilePath);
+            return;
+        }
+
+        WriteModelFile(modelFilePath, [&](std::fstream& stream) { stream << model; });
     }
 
     /*static*/ FunctionPtr Function::LoadModel(const std::wstring& modelFile, const DeviceDescriptor& computeDevice)
     {
         auto stream = GetFstream(modelFile, true);
-        if (!Internal::IsLegacyModel(*stream))
+        if (IsRawTensorModel(*stream))
+        {
+            stream.reset();
+            return Function::Deserialize(LoadRawTensorModel(modelFile), computeDevice);
+        }
+        else if (!Internal::IsLegacyModel(*stream))
         {
             Dictionary model;
             *stream >> model;
@@ -445,6 +455,8 @@ namespace CNTK
 
         if (Internal::IsLegacyModel(modelBuffer, modelBufferLength))
             InvalidArgument("Loading a legacy model from byte array is not supported.");
+        else if (IsRawTensorModel(modelBuffer, modelBufferLength))
+            return Function::Deserialize(LoadRawTensorModel(modelBuffer, modelBufferLength), computeDevice); // (the values are copied, since the buffer belongs to the caller)
         else
         {
             modelStreamBuffer buf(modelBuffer, modelBufferLength);
@@ -464,7 +476,13 @@ namespace CNTK
     void Function::RestoreModel(const std::wstring& modelFilePath)
     {
         auto stream = GetFstream(modelFilePath, true);
-        if (!Internal::IsLegacyModel(*stream))
+        if (IsRawTensorModel(*stream))
+        {
+            stream.reset();
+            RestoreFromCheckpoint(LoadRawTensorModel(modelFilePath));
+            return;
+        }
+        else if (!Internal::IsLegacyModel(*stream))
         {
             Dictionary model;
             *stream >> model;
@@ -272,41 +272,44 @@ namespace CNTK
         if (trainingSampleCount == 0)
             InvalidArgument("Learner::Update() cannot perform an update with an empty minibatch.");
 
-        for (const auto& parameter : Parameters())
+        if (!m_additionalOptions.fuseParameterUpdates || !TryFusedUpdate(gradientValues, trainingSampleCount))
         {
-            const auto& smoothedGradientValue = m_smoothedGradientValues.at(parameter);
-            const auto& gradientValue = gradientValues.at(parameter);
-            // TODO: make this a runtime parameter.
+            for (const auto& parameter : Parameters())
+            {
+                const auto& smoothedGradientValue = m_smoothedGradientValues.at(parameter);
+                const auto& gradientValue = gradientValues.at(parameter);
+                // TODO: make this a runtime parameter.
 #if DUMPOUTPUT
-            LOGPRINTF(stderr, "Update_%ls\n", parameter.Uid().c_str());
+                LOGPRINTF(stderr, "Update_%ls\n", parameter.Uid().c_str());
 #endif
 
 #ifdef _DEBUG
-            if (HasNan(smoothedGradientValue, "TrainOneEpoch/UpdateWeights/Learner::Update(): "))
-                LogicError("%ls has NaNs in smoothedGradient.", parameter.Uid().c_str());
+                if (HasNan(smoothedGradientValue, "TrainOneEpoch/UpdateWeights/Learner::Update(): "))
+                    LogicError("%ls has NaNs in smoothedGradient.", parameter.Uid().c_str());
 #endif
 
 #if DUMPOUTPUT
-            const auto learningRate = LearningRate(trainingSampleCount);
-            const auto momentum = MomentumValueForMB(trainingSampleCount);
-            LOGPRINTF(stderr, "learnRatePerSample=%0.8f, momentum=%0.8f, actualMBSize=%ld\n",
-                      learningRate, momentum, trainingSampleCount);
-            LOGPRINTF(stderr, "GradUpdateType()=%s, GradientUpdateNoiseStd()=%0.8f\n",
-                      LearnerType().c_str(), m_additionalOptions.gaussianNoiseInjectionStdDev);
-            Print(gradientValue, "Gradient Update");
-            Print(smoothedGradientValue, "Smoothed Gradient Input");
+                const auto learningRate = LearningRate(trainingSampleCount);
+                const auto momentum = MomentumValueForMB(trainingSampleCount);
+                LOGPRINTF(stderr, "learnRatePerSample=%0.8f, momentum=%0.8f, actualMBSize=%ld\n",
+                          learningRate, momentum, trainingSampleCount);
+                LOGPRINTF(stderr, "GradUpdateType()=%s, GradientUpdateNoiseStd()=%0.8f\n",
+                          LearnerType().c_str(), m_additionalOptions.gaussianNoiseInjectionStdDev);
+                Print(gradientValue, "Gradient Update");
+                Print(smoothedGradientValue, "Smoothed Gradient Input");
 #endif
-            DISPATCH_TO_TYPED_UPDATE_FUNCTION;
+                DISPATCH_TO_TYPED_UPDATE_FUNCTION;
 
 #if DUMPOUTPUT
-            Print(parameter.Value(), "Parameter Update");
+                Print(parameter.Value(), "Parameter Update");
 #endif
 
 #ifdef _DEBUG
-            const auto& parameterValue = parameter.Value();
-            if (HasNan(parameterValue, "TrainOneEpoch/UpdateWeights/Learner::Update(): "))
-                LogicError("%ls has NaNs in parameter values after parameter update.", parameter.Uid().c_str());
+                const auto& parameterValue = parameter.Value();
+                if (HasNan(parameterValue, "TrainOneEpoch/UpdateWeights/Learner::Update(): "))
+                    LogicError("%ls has NaNs in parameter values after parameter update.", parameter.Uid().c_str());
 #endif
+            }
         }
         m_sampleCount += trainingSampleCount;
         m_minibatchCount++;
@@ -331,6 +334,89 @@ namespace CNTK
         paramRef.RecordValueUpdate();
     }
 
+    bool LearnerBase::TryFusedUpdate(const unordered_map<Parameter, NDArrayViewPtr>& gradientValues, size_t trainingSampleCount)
+    {
+        const auto dataType = Parameters().front().GetDataType();
+        for (const auto& parameter : Parameters())
+        {
+            const auto& parameterValue = parameter.Value();
+            const auto& gradientValue = gradientValues.at(parameter);
+            if (parameter.GetDataType() != dataType || parameterValue->Device().Type() != DeviceKind::CPU || parameterValue->IsSparse() ||
+                gradientValue->Device().Type() != DeviceKind::CPU || gradientValue->IsSparse())
+                return false;
+        }
+
+        FusedUpdate update;
+        if (!PrepareFusedUpdate(update, trainingSampleCount))
+            return false;
+
+        // the same preprocessing of the gradients as in PreProcess()
+        const auto actualMBSize = m_additionalOptions.useMeanGradient ? 1 : trainingSampleCount;
+        update.gradientScale = m_additionalOptions.useMeanGradient ? 1.0 / trainingSampleCount : 1.0;
+        update.clippingThreshold = m_additionalOptions.gradientClippingThresholdPerSample * actualMBSize;
+        update.clippingWithTruncation = m_additionalOptions.gradientClippingWithTruncation;
+        if (m_additionalOptions.l2RegularizationWeight > 0)
+            update.l2RegularizationWeight = m_additionalOptions.l2RegularizationWeight * actualMBSize;
+
+        if (!m_flatSmoothedGradients)
+            FlattenSmoothedGradients();
+
+        if (dataType == DataType::Float)
+            UpdateFused<float>(update, gradientValues, trainingSampleCount);
+        else if (dataType == DataType::Double)
+            UpdateFused<double>(update, gradientValues, trainingSampleCount);
+        else
+            LogicError("Unsupported DataType %s", DataTypeName(dataType));
+
+        return true;
+    }
+
+    template <typename ElementType>
+    void LearnerBase::UpdateFused(const FusedUpdate& update, const unordered_map<Parameter, NDArrayViewPtr>& gradientValues, size_t trainingSampleCount)
+    {
+        vector<shared_ptr<Matrix<ElementType>>> matrices; // (keeps the matrices alive)
+        vector<Matrix<ElementType>*> parameterMatrices, gradientMatrices, smoothedGradientMatrices;
+        for (const auto& parameter : Parameters())
+        {
+            matrices.push_back(GetWritableMatrix<ElementType>(parameter.Value()));
+            parameterMatrices.push_back(matrices.back().get());
+            matrices.push_back(GetWritableMatrix<ElementType>(gradientValues.at(parameter)));
+            gradientMatrices.push_back(matrices.back().get());
+            matrices.push_back(GetWritableMatrix<ElementType>(m_smoothedGradientValues.at(parameter)));
+            smoothedGradientMatrices.push_back(matrices.back().get());
+        }
+
+        Matrix<ElementType>::FusedParameterUpdate(update, parameterMatrices, gradientMatrices, smoothedGradientMatrices);
+
+        for (const auto& parameter : Parameters())
+        {
+            PostProcess<ElementType>(parameter, gradientValues.at(parameter), trainingSampleCount);
+
+            auto paramRef = parameter;
+            paramRef.RecordValueUpdate();
+        }
+    }
+
+    // The fused update is faster if the smoothed gradients are adjacent in memory, so they are moved into a single buffer.
+    void LearnerBase::FlattenSmoothedGradients()
+    {
+        size_t totalSize = 0;
+        for (const auto& parameter : Parameters())
+            totalSize += m_smoothedGradientValues.at(parameter)->Shape().TotalSize();
+
+        m_flatSmoothedGradients = AllocateNDArrayView(Parameters().front(), { 1, totalSize });
+        size_t offset = 0;
+        for (const auto& parameter : Parameters())
+        {
+            auto& smoothedGradientValue = m_smoothedGradientValues.at(parameter);
+            const auto shape = smoothedGradientValue->Shape();
+            auto flatSmoothedGradientValue = m_flatSmoothedGradients->SliceView({ 0, offset }, { 1, shape.TotalSize() })->AsShape(shape);
+            flatSmoothedGradientValue->CopyFrom(*smoothedGradientValue);
+            smoothedGradientValue = flatSmoothedGradientValue;
+            offset += shape.TotalSize();
+        }
+    }
+
     string LearnerBase::LearnerType() const
     {
         return Typename(this);
@@ -482,6 +568,13 @@ namespace CNTK
         parameterMatrix->SGDUpdate(*gradientMatrix, learningRate);
     }
 
+    /*virtual*/ bool LearnerSGD::PrepareFusedUpdate(FusedUpdate& update, size_t trainingSampleCount) const /*override*/
+    {
+        update.type = FusedUpdateType::SGD;
+        update.learnRatePerSample = LearningRate(trainingSampleCount);
+        return true;
+    }
+
     double LearnerMomentumSGD::MomentumValueForMB(const MomentumSchedule& schedule, size_t minibatchSize) const
     {
         double currentMomentum = GetCurrentTrainingParameterValue(schedule);
@@ -517,6 +610,17 @@ namespace CNTK
                                            learningRate, momentum, UseUnitGainMomentum());
     }
 
+    /*virtual*/ bool LearnerMomentumSGD::PrepareFusedUpdate(FusedUpdate& update, size_t trainingSampleCount) const /*override*/
+    {
+        ReportTrainingParameterValue(m_momentumSchedule, L"Momentum");
+
+        update.type = FusedUpdateType::MomentumSGD;
+        update.learnRatePerSample = LearningRate(trainingSampleCount);
+        update.momentum = MomentumValueForMB(trainingSampleCount);
+        update.unitGainMomentum = UseUnitGainMomentum();
+        return true;
+    }
+
     /*virtual*/ void LearnerNesterov::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, 
                                              const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const /*override*/
     {
@@ -536,6 +640,15 @@ namespace CNTK
                                                               learningRate, momentum, UseUnitGainMomentum());
     }
 
+    /*virtual*/ bool LearnerNesterov::PrepareFusedUpdate(FusedUpdate& update, size_t trainingSampleCount) const /*override*/
+    {
+        update.type = FusedUpdateType::Nesterov;
+        update.learnRatePerSample = LearningRate(trainingSampleCount);
+        update.momentum = MomentumValueForMB(trainingSampleCount);
+        update.unitGainMomentum = UseUnitGainMomentum();
+        return true;
+    }
+
     LearnerAdaGrad::LearnerAdaGrad(const std::vector<Parameter>& parameters,
                                    const LearningRateSchedule& learningRateSchedule,
                                    bool needAveMultiplier,
@@ -654,6 +767,22 @@ namespace CNTK
                                                 s_targetAdagradAvDenom, momentum, varMomentum, UseUnitGainMomentum());
     }
 
+    /*virtual*/ bool LearnerFSAdaGrad::PrepareFusedUpdate(FusedUpdate& update, size_t trainingSampleCount) const /*override*/
+    {
+        update.type = FusedUpdateType::FSAdaGrad;
+        update.learnRatePerSample = LearningRate(trainingSampleCount);
+        update.momentum = MomentumValueForMB(trainingSampleCount);
+        update.unitGainMomentum = UseUnitGainMomentum();
+        update.varMomentum = VarianceMomentumValueForMB(trainingSampleCount);
+        update.targetAdagradAvDenom = s_targetAdagradAvDenom;
+
+        // the smoothed counts of all parameters are the same, since they are always updated together
+        for (auto& smoothedCount : m_smoothedCounts)
+            smoothedCount.second = update.varMomentum * smoothedCount.second + (1.0 - update.varMomentum) * trainingSampleCount;
+        update.smoothedCount = m_smoothedCounts.begin()->second;
+        return true;
+    }
+
     LearnerAdam::LearnerAdam(const vector<Parameter>& parameters,
         const LearningRateSchedule& learningRateSchedule,
         const MomentumSchedule& momentumSchedule,
@@ -696,6 +825,21 @@ namespace CNTK
             momentum, varMomentum, UseUnitGainMomentum());
     }
 
+    /*virtual*/ bool LearnerAdam::PrepareFusedUpdate(FusedUpdate& update, size_t trainingSampleCount) const /*override*/
+    {
+        update.type = FusedUpdateType::Adam;
+        update.learnRatePerSample = LearningRate(trainingSampleCount);
+        update.momentum = MomentumValueForMB(trainingSampleCount);
+        update.unitGainMomentum = UseUnitGainMomentum();
+        update.varMomentum = VarianceMomentumValueForMB(trainingSampleCount);
+
+        // the smoothed counts of all parameters are the same, since they are always updated together
+        for (auto& smoothedCount : m_smoothedCounts)
+            smoothedCount.second++;
+        update.smoothedCount = m_smoothedCounts.begin()->second;
+        return true;
+    }
+
     LearnerRMSProp::LearnerRMSProp(const vector<Parameter>& parameters,
                                    const LearningRateSchedule& learningRateSchedule,
                                    double gamma, double inc, double dec, double max, double min,
@@ -9,6 +9,10 @@
 #include "CNTKLibrary.h"
 #include <numeric>
 
+namespace Microsoft { namespace MSR { namespace CNTK {
+    struct FusedUpdate;
+}}}
+
 namespace CNTK 
 {
     // An abstract base class at the root of the standard learners hierarchy
@@ -39,6 +43,13 @@ namespace CNTK
 
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const = 0;
 
+        // Describes the update of the parameters for Matrix::FusedParameterUpdate() (see AdditionalLearningOptions::fuseParameterUpdates),
+        // or returns false if the learner does not support fused updates. Called once per minibatch, before the fused update.
+        virtual bool PrepareFusedUpdate(Microsoft::MSR::CNTK::FusedUpdate& /*update*/, size_t /*trainingSampleCount*/) const
+        {
+            return false;
+        }
+
         std::string LearnerType() const;
 
         // Returns current (per-sample) learning rate.
@@ -104,6 +115,20 @@ namespace CNTK
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
+        // Updates all parameters at once (see AdditionalLearningOptions::fuseParameterUpdates), or returns false if this is
+        // not possible, in which case they are updated one by one.
+        bool TryFusedUpdate(const std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues, size_t trainingSampleCount);
+
+        template <typename ElementType>
+        void UpdateFused(const Microsoft::MSR::CNTK::FusedUpdate& update, const std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues, size_t trainingSampleCount);
+
+        // Moves the smoothed gradients of all parameters into m_flatSmoothedGradients.
+        void FlattenSmoothedGradients();
+
+        // A single buffer that holds the smoothed gradients of all parameters once they are updated by fused updates,
+        // m_smoothedGradientValues then refer to slices of it.
+        NDArrayViewPtr m_flatSmoothedGradients;
+
         // TODO: make these functions friends of NDViewArray and move to Utils?
         static bool HasNan(const NDArrayViewPtr& value, const char* name);
         static void Print(const NDArrayViewPtr& value, const char* msg);
@@ -128,6 +153,8 @@ namespace CNTK
 
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
 
+        virtual bool PrepareFusedUpdate(Microsoft::MSR::CNTK::FusedUpdate& update, size_t trainingSampleCount) const override;
+
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
     };
@@ -156,6 +183,8 @@ namespace CNTK
     protected:
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
 
+        virtual bool PrepareFusedUpdate(Microsoft::MSR::CNTK::FusedUpdate& update, size_t trainingSampleCount) const override;
+
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
@@ -190,6 +219,8 @@ namespace CNTK
     protected:
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
 
+        virtual bool PrepareFusedUpdate(Microsoft::MSR::CNTK::FusedUpdate& update, size_t trainingSampleCount) const override;
+
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
     };
@@ -245,6 +276,8 @@ namespace CNTK
 
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
 
+        virtual bool PrepareFusedUpdate(Microsoft::MSR::CNTK::FusedUpdate& update, size_t trainingSampleCount) const override;
+
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
@@ -276,6 +309,8 @@ namespace CNTK
 
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
 
+        virtual bool PrepareFusedUpdate(Microsoft::MSR::CNTK::FusedUpdate& update, size_t trainingSampleCount) const override;
+
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
@@ -15,11 +15,13 @@ using namespace Microsoft::MSR::CNTK;
 
 namespace CNTK
 {
+    // If 'bufferOwner' is given, the matrix keeps it alive, and with it the buffer.
     template <typename ElementType>
     static TensorView<ElementType>* AllocateTensorView(const NDShape& viewShape,
                                                        const DeviceDescriptor& device,
                                                        void* dataBuffer,
-                                                       size_t bufferSizeInBytes)
+                                                       size_t bufferSizeInBytes,
+                                                       const std::shared_ptr<void>& bufferOwner = nullptr)
     {
         if (dataBuffer == nullptr)
             InvalidArgument("Cannot create a NDArrayView over a null data buffer.");
@@ -29,7 +31,12 @@ namespace CNTK
                             (int)bufferSizeInBytes, viewShape.AsString().c_str());
 
         auto matrixDims = GetMatrixDimensions(viewShape);
-        std::shared_ptr<Matrix<ElementType>> matrix = std::make_shared<Matrix<ElementType>>(matrixDims.first, matrixDims.second, (ElementType*)dataBuffer, AsCNTKImplDeviceId(device), matrixFlagDontOwnBuffer);
+        std::shared_ptr<Matrix<ElementType>> matrix;
+        if (bufferOwner)
+            matrix.reset(new Matrix<ElementType>(matrixDims.first, matrixDims.second, (ElementType*)dataBuffer, AsCNTKImplDeviceId(device), matrixFlagDontOwnBuffer),
+                         [bufferOwner](Matrix<ElementType>* matrixPtr) { delete matrixPtr; });
+        else
+            matrix = std::make_shared<Matrix<ElementType>>(matrixDims.first, matrixDims.second, (ElementType*)dataBuffer, AsCNTKImplDeviceId(device), matrixFlagDontOwnBuffer);
         return new TensorView<ElementType>(matrix, AsTensorViewShape(viewShape));
     }
 
@@ -37,14 +44,15 @@ namespace CNTK
                                     const NDShape& viewShape,
                                     const DeviceDescriptor& device,
                                     void* dataBuffer,
-                                    size_t bufferSizeInBytes)
+                                    size_t bufferSizeInBytes,
+                                    const std::shared_ptr<void>& bufferOwner = nullptr)
     {
         switch (dataType)
         {
         case DataType::Float:
-            return AllocateTensorView<float>(viewShape, device, dataBuffer, bufferSizeInBytes);
+            return AllocateTensorView<float>(viewShape, device, dataBuffer, bufferSizeInBytes, bufferOwner);
         case DataType::Double:
-            return AllocateTensorView<double>(viewShape, device, dataBuffer, bufferSizeInBytes);
+            return AllocateTensorView<double>(viewShape, device, dataBuffer, bufferSizeInBytes, bufferOwner);
         default:
             LogicError("Unsupported DataType %s", DataTypeName(dataType));
             break;
@@ -90,6 +98,12 @@ namespace CNTK
     {
     }
 
+    NDArrayView::NDArrayView(CNTK::DataType dataType, const NDShape& viewShape, void* dataBuffer, size_t bufferSizeInBytes, const std::shared_ptr<void>& mapping)
+        : NDArrayView(dataType, DeviceDescriptor::CPUDevice(), StorageFormat::Dense, viewShape, false, AllocateTensorView(dataType, viewShape, DeviceDescriptor::CPUDevice(), dataBuffer, bufferSizeInBytes, mapping))
+    {
+        m_isMemoryMapped = true;
+    }
+
     template <typename ElementType>
     NDArrayView::NDArrayView(const NDShape& viewShape, const SparseIndexType* colStarts, const SparseIndexType* rowIndices, const ElementType* nonZeroValues, size_t numNonZeroValues, const DeviceDescriptor& device, bool readOnly/* = false*/)
         : NDArrayView(AsDataType<ElementType>(), device, StorageFormat::SparseCSC, viewShape, false, AllocateTensorView<ElementType>(viewShape, StorageFormat::SparseCSC, device, numNonZeroValues))
@@ -105,7 +119,7 @@ namespace CNTK
     }
 
     NDArrayView::NDArrayView(CNTK::DataType dataType, const DeviceDescriptor& device, CNTK::StorageFormat storageType, const NDShape& viewShape, bool readOnly, void* tensorView)
-        : m_dataType(dataType), m_device(device), m_storageFormat(storageType), m_viewShape(viewShape), m_isReadOnly(readOnly)
+        : m_dataType(dataType), m_device(device), m_storageFormat(storageType), m_viewShape(viewShape), m_isReadOnly(readOnly), m_isMemoryMapped(false)
     {
         m_tensorView = std::shared_ptr<void>(tensorView, [this](void*) {
             switch (m_dataType)
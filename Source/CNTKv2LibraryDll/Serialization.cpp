@@ -6,6 +6,7 @@
 #include "stdafx.h"
 #include "CNTKLibrary.h"
 #include "Utils.h"
+#include "Serialization.h"
 #include <istream>
 #include <ostream>
 #include <string>
@@ -14,6 +15,13 @@
 
 #ifdef _MSC_VER
 #include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
 #endif
 
 #pragma warning(push)
@@ -28,6 +36,108 @@ namespace CNTK
 
     using namespace ::google::protobuf;
 
+    // Model files in the raw-tensor format (ModelFormat::CNTKv2RawTensors) consist of
+    //  - the magic number below (8 bytes),
+    //  - the size of the protobuf in bytes (8 bytes),
+    //  - the protobuf of the model dictionary, in which the dense NDArrayViews refer to their values by offset and size (raw_data),
+    //  - the values of these NDArrayViews, starting at the first multiple of 64 bytes after the protobuf, each one 64-byte aligned.
+    // Such files are memory-mapped when they are loaded, so that the values can be used in place.
+    static const char s_rawTensorModelMagic[8] = { 'C', 'N', 'T', 'K', 'R', 'A', 'W', '1' };
+    static const size_t s_rawTensorHeaderSize = sizeof(s_rawTensorModelMagic) + sizeof(uint64_t);
+    static const size_t s_rawTensorAlignment = 64;
+
+    static size_t AlignRawTensorOffset(size_t offset)
+    {
+        return (offset + s_rawTensorAlignment - 1) / s_rawTensorAlignment * s_rawTensorAlignment;
+    }
+
+    // The NDArrayViews whose values are written after the protobuf, and the offsets of these values.
+    struct RawTensorWriter
+    {
+        std::vector<std::pair<const NDArrayView*, size_t>> m_views;
+        size_t m_size = 0;
+
+        size_t Add(const NDArrayView& view)
+        {
+            size_t offset = AlignRawTensorOffset(m_size);
+            m_views.push_back(std::make_pair(&view, offset));
+            m_size = offset + view.Shape().TotalSize() * DataTypeSize(view.GetDataType());
+            return offset;
+        }
+    };
+
+    // The values of a model in the raw-tensor format. If 'm_mapping' is set, the values are wrapped by the NDArrayViews
+    // (which keep the mapping alive), otherwise they are copied.
+    struct RawTensorReader
+    {
+        char* m_data;
+        size_t m_size;
+        std::shared_ptr<void> m_mapping;
+    };
+
+    // Copy-on-write memory mapping of a complete file. Pages that are not written to (all of them, if the model is only
+    // evaluated) are shared with the page cache, and hence with all processes that map the same file.
+    class MappedModelFile
+    {
+    public:
+        explicit MappedModelFile(const std::wstring& filename) : m_data(nullptr), m_size(0)
+        {
+#ifdef _MSC_VER
+            // FILE_SHARE_DELETE lets WriteModelFile() replace the file while it is mapped.
+            HANDLE file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (file == INVALID_HANDLE_VALUE)
+                RuntimeError("Cannot open file '%S' for memory mapping, error %x.", filename.c_str(), GetLastError());
+            LARGE_INTEGER size;
+            HANDLE mapping = GetFileSizeEx(file, &size) ? CreateFileMapping(file, NULL, PAGE_WRITECOPY, 0, 0, NULL) : NULL;
+            if (mapping != NULL)
+            {
+                m_size = (size_t)size.QuadPart;
+                m_data = (char*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+            }
+            DWORD error = GetLastError();
+            if (mapping != NULL)
+                CloseHandle(mapping); // (the view keeps the mapping)
+            CloseHandle(file);
+            if (m_data == nullptr)
+                RuntimeError("Cannot memory-map file '%S', error %x.", filename.c_str(), error);
+#else
+            int fd = open(ToString(filename).c_str(), O_RDONLY);
+            if (fd < 0)
+                RuntimeError("Cannot open file '%S' for memory mapping: %s.", filename.c_str(), strerror(errno));
+            struct stat sb;
+            void* data = MAP_FAILED;
+            if (fstat(fd, &sb) == 0)
+            {
+                m_size = (size_t)sb.st_size;
+                data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            }
+            int error = errno;
+            close(fd); // (the mapping keeps the file)
+            if (data == MAP_FAILED)
+                RuntimeError("Cannot memory-map file '%S': %s.", filename.c_str(), strerror(error));
+            m_data = (char*)data;
+#endif
+        }
+
+        ~MappedModelFile()
+        {
+#ifdef _MSC_VER
+            UnmapViewOfFile(m_data);
+#else
+            munmap(m_data, m_size);
+#endif
+        }
+
+        char* Data() const { return m_data; }
+        size_t Size() const { return m_size; }
+
+    private:
+        char* m_data;
+        size_t m_size;
+
+        MappedModelFile(const MappedModelFile&) = delete; MappedModelFile& operator=(const MappedModelFile&) = delete;
+    };
+
     class Serializer
     {
         friend std::ostream& operator<<(std::ostream&, const Dictionary&);
@@ -38,22 +148,25 @@ namespace CNTK
         friend class Dictionary;
         friend class DictionaryValue;
 
+        friend void SaveRawTensorModel(const Dictionary& model, const std::wstring& modelFile);
+        friend Dictionary LoadRawTensorModel(char* modelBuffer, size_t bufferLength, const std::shared_ptr<void>& mapping);
+
     private:
-        static proto::DictionaryValue* CreateProto(const DictionaryValue& src, Arena* arena = nullptr);
-        static proto::Dictionary* CreateProto(const Dictionary& src, Arena* arena = nullptr);
-        static proto::Vector* CreateProto(const std::vector<DictionaryValue>& src, Arena* arena = nullptr);
-        static proto::NDArrayView* CreateProto(const NDArrayView& src, Arena* arena = nullptr);
+        static proto::DictionaryValue* CreateProto(const DictionaryValue& src, Arena* arena = nullptr, RawTensorWriter* rawTensors = nullptr);
+        static proto::Dictionary* CreateProto(const Dictionary& src, Arena* arena = nullptr, RawTensorWriter* rawTensors = nullptr);
+        static proto::Vector* CreateProto(const std::vector<DictionaryValue>& src, Arena* arena = nullptr, RawTensorWriter* rawTensors = nullptr);
+        static proto::NDArrayView* CreateProto(const NDArrayView& src, Arena* arena = nullptr, RawTensorWriter* rawTensors = nullptr);
         static proto::Axis* CreateProto(const Axis& src, Arena* arena = nullptr);
         static proto::NDShape* CreateProto(const NDShape& src, Arena* arena = nullptr);
 
-        static Dictionary* CreateFromProto(const proto::Dictionary& src);
-        static std::vector<DictionaryValue>* CreateFromProto(const proto::Vector& src);
-        static NDArrayView* CreateFromProto(const proto::NDArrayView& src);
+        static Dictionary* CreateFromProto(const proto::Dictionary& src, const RawTensorReader* rawTensors = nullptr);
+        static std::vector<DictionaryValue>* CreateFromProto(const proto::Vector& src, const RawTensorReader* rawTensors = nullptr);
+        static NDArrayView* CreateFromProto(const proto::NDArrayView& src, const RawTensorReader* rawTensors = nullptr);
         static Axis* CreateFromProto(const proto::Axis& src);
         static NDShape* CreateFromProto(const proto::NDShape& src);
 
-        static void Copy(const DictionaryValue& src, proto::DictionaryValue& dst, Arena* arena = nullptr);
-        static void Copy(const proto::DictionaryValue& src, DictionaryValue& dst);
+        static void Copy(const DictionaryValue& src, proto::DictionaryValue& dst, Arena* arena = nullptr, RawTensorWriter* rawTensors = nullptr);
+        static void Copy(const proto::DictionaryValue& src, DictionaryValue& dst, const RawTensorReader* rawTensors = nullptr);
 
         static proto::NDArrayView::DataType ToProtoType(DataType type)
         {
@@ -178,14 +291,20 @@ namespace CNTK
         }
     }
 
-    /*static*/ proto::NDArrayView* Serializer::CreateProto(const NDArrayView& src, Arena* arena)
+    /*static*/ proto::NDArrayView* Serializer::CreateProto(const NDArrayView& src, Arena* arena, RawTensorWriter* rawTensors)
     {
         proto::NDArrayView* dst = (arena != nullptr) ? 
             Arena::CreateMessage<proto::NDArrayView>(arena) : new proto::NDArrayView();
         dst->set_data_type(ToProtoType(src.GetDataType()));
         dst->set_allocated_shape(CreateProto(src.Shape(), arena));
         dst->set_storage_format(ToProtoType(src.GetStorageFormat()));
-        if (src.GetDataType() == DataType::Float)
+        if (rawTensors != nullptr && !src.IsSparse() && (src.GetDataType() == DataType::Float || src.GetDataType() == DataType::Double))
+        {
+            auto rawData = dst->mutable_raw_data();
+            rawData->set_offset(rawTensors->Add(src));
+            rawData->set_size(src.Shape().TotalSize() * DataTypeSize(src.GetDataType()));
+        }
+        else if (src.GetDataType() == DataType::Float)
         {
             CopyData<float>(src, dst->mutable_float_values()->mutable_value());
         }
@@ -196,7 +315,7 @@ namespace CNTK
         return dst;
     }
 
-    /*static*/ NDArrayView* Serializer::CreateFromProto(const proto::NDArrayView& src)
+    /*static*/ NDArrayView* Serializer::CreateFromProto(const proto::NDArrayView& src, const RawTensorReader* rawTensors)
     {
         if (!proto::NDArrayView::DataType_IsValid(src.data_type()) ||
             !proto::NDArrayView::StorageFormat_IsValid(src.storage_format()))
@@ -207,6 +326,26 @@ namespace CNTK
         std::unique_ptr<NDShape> shape(CreateFromProto(src.shape()));
         auto dataType = FromProtoType(src.data_type());
         auto storageFormat = FromProtoType(src.storage_format());
+
+        if (src.values_case() == proto::NDArrayView::kRawData)
+        {
+            auto offset = src.raw_data().offset();
+            auto size = src.raw_data().size();
+            if (rawTensors == nullptr || storageFormat != StorageFormat::Dense || dataType == DataType::Unknown ||
+                size != shape->TotalSize() * DataTypeSize(dataType) || offset > rawTensors->m_size || size > rawTensors->m_size - offset)
+            {
+                RuntimeError("NDArrayView (shape = '%S') refers to values that are not in the model.", shape->AsString().c_str());
+            }
+
+            char* buffer = rawTensors->m_data + offset;
+            if (rawTensors->m_mapping)
+                return new NDArrayView(dataType, *shape, buffer, size, rawTensors->m_mapping);
+
+            NDArrayView* dst = new NDArrayView(dataType, storageFormat, *shape, DeviceDescriptor::CPUDevice());
+            dst->CopyFrom(NDArrayView(dataType, *shape, buffer, size, DeviceDescriptor::CPUDevice(), /*readOnly =*/ true));
+            return dst;
+        }
+
         NDArrayView* dst = new NDArrayView(dataType, storageFormat, *shape, DeviceDescriptor::CPUDevice());
 
         if (dataType == DataType::Float)
@@ -220,60 +359,60 @@ namespace CNTK
         return dst;
     }
 
-    /*static*/ proto::Vector* Serializer::CreateProto(const std::vector<DictionaryValue>& src, Arena* arena)
+    /*static*/ proto::Vector* Serializer::CreateProto(const std::vector<DictionaryValue>& src, Arena* arena, RawTensorWriter* rawTensors)
     {
         proto::Vector* dst = (arena != nullptr) ? 
             Arena::CreateMessage<proto::Vector>(arena) : new proto::Vector();
         dst->mutable_value()->Reserve((int)src.size());
         for (const auto& value : src)
         {
-            dst->mutable_value()->AddAllocated(CreateProto(value, arena));
+            dst->mutable_value()->AddAllocated(CreateProto(value, arena, rawTensors));
         }
         return dst;
     }
 
-    /*static*/ std::vector<DictionaryValue>* Serializer::CreateFromProto(const proto::Vector& src)
+    /*static*/ std::vector<DictionaryValue>* Serializer::CreateFromProto(const proto::Vector& src, const RawTensorReader* rawTensors)
     {
         std::vector<DictionaryValue>* dst = new std::vector<DictionaryValue>(src.value_size());
         for (auto i = 0; i < src.value_size(); ++i)
         {
-            Copy(src.value()[i], dst->at(i));
+            Copy(src.value()[i], dst->at(i), rawTensors);
         }
         return dst;
     }
 
-    /*static*/ proto::Dictionary* Serializer::CreateProto(const Dictionary& src, Arena* arena)
+    /*static*/ proto::Dictionary* Serializer::CreateProto(const Dictionary& src, Arena* arena, RawTensorWriter* rawTensors)
     {
         proto::Dictionary* dst = (arena != nullptr) ? 
             Arena::CreateMessage<proto::Dictionary>(arena) : new proto::Dictionary();
         dst->set_version(src.s_version);
         for (const auto& kv : src)
         {
-            Copy(kv.second, dst->mutable_data()->operator[](ToString(kv.first)), arena);
+            Copy(kv.second, dst->mutable_data()->operator[](ToString(kv.first)), arena, rawTensors);
         }
         return dst;
     }
 
-    /*static*/ Dictionary* Serializer::CreateFromProto(const proto::Dictionary& src)
+    /*static*/ Dictionary* Serializer::CreateFromProto(const proto::Dictionary& src, const RawTensorReader* rawTensors)
     {
         Dictionary* dst = new Dictionary();
         for (const auto& kv : src.data())
         {
-            Copy(kv.second, dst->operator[](ToWString(kv.first)));
+            Copy(kv.second, dst->operator[](ToWString(kv.first)), rawTensors);
         }
         return dst;
     }
 
-    /*static*/ proto::DictionaryValue* Serializer::CreateProto(const DictionaryValue& src, Arena* arena)
+    /*static*/ proto::DictionaryValue* Serializer::CreateProto(const DictionaryValue& src, Arena* arena, RawTensorWriter* rawTensors)
     {
         proto::DictionaryValue* dst = (arena != nullptr) ? 
             Arena::CreateMessage<proto::DictionaryValue>(arena) : new proto::DictionaryValue();
         dst->set_version(src.s_version);
-        Copy(src, *dst, arena);
+        Copy(src, *dst, arena, rawTensors);
         return dst;
     }
 
-    /*static*/ void Serializer::Copy(const DictionaryValue& src, proto::DictionaryValue& dst, Arena* arena)
+    /*static*/ void Serializer::Copy(const DictionaryValue& src, proto::DictionaryValue& dst, Arena* arena, RawTensorWriter* rawTensors)
     {
         auto valueType = src.ValueType();
         dst.set_value_type(ToProtoType(valueType));
@@ -307,20 +446,20 @@ namespace CNTK
             dst.set_allocated_axis_value(CreateProto(src.Value<Axis>(), arena));
             break;
         case DictionaryValue::Type::Vector:
-            dst.set_allocated_vector_value(CreateProto(src.Value<std::vector<DictionaryValue>>(), arena));
+            dst.set_allocated_vector_value(CreateProto(src.Value<std::vector<DictionaryValue>>(), arena, rawTensors));
             break;
         case DictionaryValue::Type::Dictionary:
-            dst.set_allocated_dictionary_value(CreateProto(src.Value<Dictionary>(), arena));
+            dst.set_allocated_dictionary_value(CreateProto(src.Value<Dictionary>(), arena, rawTensors));
             break;
         case DictionaryValue::Type::NDArrayView:
-            dst.set_allocated_nd_array_view_value(CreateProto(src.Value<NDArrayView>(), arena));
+            dst.set_allocated_nd_array_view_value(CreateProto(src.Value<NDArrayView>(), arena, rawTensors));
             break;
         default:
             NOT_IMPLEMENTED
         }
     }
 
-    /*static*/ void Serializer::Copy(const proto::DictionaryValue& src, DictionaryValue& dst)
+    /*static*/ void Serializer::Copy(const proto::DictionaryValue& src, DictionaryValue& dst, const RawTensorReader* rawTensors)
     {
         auto valueType = src.value_type();
 
@@ -359,13 +498,13 @@ namespace CNTK
             dst.m_data.m_ptr = CreateFromProto(src.axis_value());
             break;
         case proto::DictionaryValue::Vector:
-            dst.m_data.m_ptr = CreateFromProto(src.vector_value());
+            dst.m_data.m_ptr = CreateFromProto(src.vector_value(), rawTensors);
             break;
         case proto::DictionaryValue::Dictionary:
-            dst.m_data.m_ptr = CreateFromProto(src.dictionary_value());
+            dst.m_data.m_ptr = CreateFromProto(src.dictionary_value(), rawTensors);
             break;
         case proto::DictionaryValue::NDArrayView:
-            dst.m_data.m_ptr = CreateFromProto(src.nd_array_view_value());
+            dst.m_data.m_ptr = CreateFromProto(src.nd_array_view_value(), rawTensors);
             break;
         }
     }
@@ -528,4 +667,175 @@ namespace CNTK
 
         return dictionaryValue;
     }
+
+    bool IsRawTensorModel(std::fstream& stream)
+    {
+        char buffer[sizeof(s_rawTensorModelMagic)] = {};
+        const auto position = stream.tellg();
+        stream.read(buffer, sizeof(buffer));
+        stream.clear();
+        stream.seekg(position);
+        return memcmp(buffer, s_rawTensorModelMagic, sizeof(buffer)) == 0;
+    }
+
+    bool IsRawTensorModel(const char* modelBuffer, size_t bufferLength)
+    {
+        return bufferLength >= sizeof(s_rawTensorModelMagic) && memcmp(modelBuffer, s_rawTensorModelMagic, sizeof(s_rawTensorModelMagic)) == 0;
+    }
+
+    void SaveRawTensorModel(const Dictionary& model, const std::wstring& modelFile)
+    {
+        UsingUTF8 locale;
+        Arena arena;
+        RawTensorWriter rawTensors;
+        proto::Dictionary* proto(Serializer::CreateProto(model, &arena, &rawTensors));
+        std::string protoBytes;
+        if (!proto->SerializeToString(&protoBytes))
+            RuntimeError("Failed to serialize the model to file %ls.", modelFile.c_str());
+
+        WriteModelFile(modelFile, [&](std::fstream& stream)
+        {
+            uint64_t protoSize = protoBytes.size();
+            stream.write(s_rawTensorModelMagic, sizeof(s_rawTensorModelMagic));
+            stream.write((const char*)&protoSize, sizeof(protoSize));
+            stream.write(protoBytes.data(), protoBytes.size());
+
+            const size_t dataOffset = AlignRawTensorOffset(s_rawTensorHeaderSize + protoBytes.size());
+            const std::vector<char> padding(s_rawTensorAlignment, 0);
+            size_t position = s_rawTensorHeaderSize + protoBytes.size();
+            for (const auto& viewAndOffset : rawTensors.m_views)
+            {
+                const NDArrayView& view = *viewAndOffset.first;
+                size_t offset = dataOffset + viewAndOffset.second;
+                stream.write(padding.data(), offset - position);
+                size_t size = view.Shape().TotalSize() * DataTypeSize(view.GetDataType());
+                const char* data = (view.GetDataType() == DataType::Float) ? (const char*)view.DataBuffer<float>() : (const char*)view.DataBuffer<double>();
+                stream.write(data, size);
+                position = offset + size;
+            }
+        });
+    }
+
+#ifdef _MSC_VER
+    // Renames 'from' to 'to', replacing 'to'. A model file that is mapped by a loaded model (see MappedModelFile) stays
+    // open; it can only be replaced by a rename with POSIX semantics, which releases its name right away (Windows 10 1607 and later).
+    static bool ReplaceFileByRename(const std::wstring& from, const std::wstring& to)
+    {
+        HANDLE file = CreateFileW(from.c_str(), DELETE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        // the new name must be a full path, as the rename is not relative to a directory
+        std::wstring target(GetFullPathNameW(to.c_str(), 0, NULL, NULL), L'\0');
+        DWORD targetLength = target.empty() ? 0 : GetFullPathNameW(to.c_str(), (DWORD)target.size(), &target[0], NULL);
+        if (targetLength == 0 || targetLength >= target.size())
+        {
+            DWORD error = GetLastError();
+            CloseHandle(file);
+            SetLastError(error);
+            return false;
+        }
+
+        std::vector<char> buffer(sizeof(FILE_RENAME_INFO) + targetLength * sizeof(wchar_t));
+        auto renameInfo = reinterpret_cast<FILE_RENAME_INFO*>(buffer.data());
+        renameInfo->RootDirectory = NULL;
+        renameInfo->FileNameLength = targetLength * sizeof(wchar_t);
+        memcpy(renameInfo->FileName, target.c_str(), renameInfo->FileNameLength);
+
+        BOOL renamed = FALSE;
+#ifdef FILE_RENAME_FLAG_POSIX_SEMANTICS
+        renameInfo->Flags = FILE_RENAME_FLAG_REPLACE_IF_EXISTS | FILE_RENAME_FLAG_POSIX_SEMANTICS;
+        renamed = SetFileInformationByHandle(file, FileRenameInfoEx, renameInfo, (DWORD)buffer.size());
+#endif
+        // without POSIX semantics (older Windows, or file systems other than NTFS) only a file that is not in use can be replaced
+        if (!renamed)
+        {
+            renameInfo->ReplaceIfExists = TRUE;
+            renamed = SetFileInformationByHandle(file, FileRenameInfo, renameInfo, (DWORD)buffer.size());
+        }
+
+        DWORD error = GetLastError();
+        CloseHandle(file);
+        SetLastError(error);
+        return renamed != FALSE;
+    }
+#endif
+
+    // A model loaded from a raw-tensor file keeps using the mapped file (see LoadRawTensorModel), also while it is
+    // saved, possibly to the same file. Truncating that file would take the values from under the mapping; the model
+    // is therefore written to a new file in the same directory, which then replaces the old one by a rename.
+    void WriteModelFile(const std::wstring& modelFile, const std::function<void(std::fstream&)>& write)
+    {
+        const std::wstring tempModelFile = modelFile + L".tmp";
+        {
+            auto stream = GetFstream(tempModelFile, false);
+            write(*stream);
+            stream->flush();
+            if (stream->fail())
+            {
+                stream.reset();
+                _wunlink(tempModelFile.c_str());
+                RuntimeError("Failed to write the model to file %ls.", modelFile.c_str());
+            }
+        }
+
+#ifdef _MSC_VER
+        if (!ReplaceFileByRename(tempModelFile, modelFile))
+        {
+            DWORD error = GetLastError();
+            _wunlink(tempModelFile.c_str());
+            // The model file is never written in place, as a loaded model may still use its values.
+            RuntimeError("Failed to replace the model file %ls, error %x. If a model loaded from this file is still in use, "
+                         "this version of Windows cannot replace it; save the model to a different file.", modelFile.c_str(), error);
+        }
+#else
+        if (rename(ToString(tempModelFile).c_str(), ToString(modelFile).c_str()) != 0)
+        {
+            int error = errno;
+            _wunlink(tempModelFile.c_str());
+            RuntimeError("Failed to replace the model file %ls: %s.", modelFile.c_str(), strerror(error));
+        }
+#endif
+    }
+
+    // Parse a model in the raw-tensor format. The values are used in place if 'mapping' keeps the buffer alive,
+    // and copied otherwise.
+    Dictionary LoadRawTensorModel(char* modelBuffer, size_t bufferLength, const std::shared_ptr<void>& mapping)
+    {
+        if (!IsRawTensorModel(modelBuffer, bufferLength) || bufferLength < s_rawTensorHeaderSize)
+            RuntimeError("The model is not in the raw-tensor format.");
+
+        uint64_t protoSize;
+        memcpy(&protoSize, modelBuffer + sizeof(s_rawTensorModelMagic), sizeof(protoSize));
+        if (protoSize > bufferLength - s_rawTensorHeaderSize || protoSize > INT_MAX)
+            RuntimeError("The model in the raw-tensor format is truncated or corrupt.");
+
+        UsingUTF8 locale;
+        Arena arena;
+        proto::Dictionary* proto = Arena::CreateMessage<proto::Dictionary>(&arena);
+        io::CodedInputStream input((const uint8_t*)modelBuffer + s_rawTensorHeaderSize, (int)protoSize);
+        if (!ParseMessage(input, *proto))
+            RuntimeError("Failed to parse protobuf %s of the model in the raw-tensor format.", proto->GetTypeName().c_str());
+
+        size_t dataOffset = std::min(AlignRawTensorOffset(s_rawTensorHeaderSize + (size_t)protoSize), bufferLength);
+        RawTensorReader rawTensors = { modelBuffer + dataOffset, bufferLength - dataOffset, mapping };
+
+        Dictionary dictionary;
+        for (const auto& kv : proto->data())
+        {
+            Serializer::Copy(kv.second, dictionary[ToWString(kv.first)], &rawTensors);
+        }
+        return dictionary;
+    }
+
+    Dictionary LoadRawTensorModel(const std::wstring& modelFile)
+    {
+        auto mapping = std::make_shared<MappedModelFile>(modelFile);
+        return LoadRawTensorModel(mapping->Data(), mapping->Size(), mapping);
+    }
+
+    Dictionary LoadRawTensorModel(const char* modelBuffer, size_t bufferLength)
+    {
+        return LoadRawTensorModel(const_cast<char*>(modelBuffer), bufferLength, nullptr);
+    }
 }
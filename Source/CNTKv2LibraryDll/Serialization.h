@@ -44,6 +44,16 @@ namespace CNTK
     const std::wstring internalWorkerStateKey = L"internal_worker_state";
     const std::wstring externalWorkerStateKey = L"external_worker_state";
 
+    // Model files in the raw-tensor format (see ModelFormat::CNTKv2RawTensors), implemented in Serialization.cpp
+    bool IsRawTensorModel(std::fstream& stream);
+    bool IsRawTensorModel(const char* modelBuffer, size_t bufferLength);
+    void SaveRawTensorModel(const Dictionary& model, const std::wstring& modelFile);
+    Dictionary LoadRawTensorModel(const std::wstring& modelFile);
+    Dictionary LoadRawTensorModel(const char* modelBuffer, size_t bufferLength);
+
+    // Writes a model file through a new file that replaces the old one, which may be mapped by a loaded model.
+    void WriteModelFile(const std::wstring& modelFile, const std::function<void(std::fstream&)>& write);
+
     template <typename T> 
     inline std::string GetVersionsString(size_t currentVersion, size_t dictVersion)
     {
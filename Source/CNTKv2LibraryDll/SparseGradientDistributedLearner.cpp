@@ -0,0 +1,354 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "SparseGradientDistributedLearner.h"
+#include "Learner.h"
+#include "PerformanceProfiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <type_traits>
+
+namespace CNTK
+{
+    namespace
+    {
+        // The (index, value) pairs are sent in buffers of the element type of the gradient; the index is stored in the
+        // bits of an element, so that it is exact for any size of the parameter.
+        template <typename ElementType>
+        using PackedIndexType = typename std::conditional<sizeof(ElementType) == sizeof(uint32_t), uint32_t, uint64_t>::type;
+    }
+
+    DistributedLearnerPtr CreateSparseGradientDistributedLearner(
+        DistributedCommunicatorPtr communicator,
+        LearnerPtr learner,
+        size_t distributeAfterSamples,
+        double sparsity,
+        double threshold)
+    {
+        return MakeSharedObject<SparseGradientDistributedLearner>(communicator, learner, distributeAfterSamples, sparsity, threshold);
+    }
+
+    SparseGradientDistributedLearner::SparseGradientDistributedLearner(
+        DistributedCommunicatorPtr communicator,
+        LearnerPtr learner,
+        size_t distributeAfterSamples,
+        double sparsity,
+        double threshold)
+        : DistributedLearnerBase(communicator, learner, distributeAfterSamples),
+          m_sparsity(sparsity),
+          m_threshold(threshold),
+          m_numGradientValues(0),
+          m_numSentEntries(0),
+          m_communicationTime(0),
+          m_numMinibatches(0)
+    {
+        if (threshold < 0)
+            InvalidArgument("SparseGradientDistributedLearner: the threshold (%f) must not be negative.", threshold);
+
+        if (threshold == 0 && (sparsity <= 0 || sparsity > 1))
+            InvalidArgument("SparseGradientDistributedLearner: the sparsity (%f) must be in the interval (0, 1].", sparsity);
+    }
+
+    bool SparseGradientDistributedLearner::Update(std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues, MinibatchInfo& info)
+    {
+        if (m_sampleCount >= m_distributeAfterSamples)
+        {
+            auto profGradientAgg = Microsoft::MSR::CNTK::ScopeProfile(Microsoft::MSR::CNTK::profilerEvtMainGradient);
+
+            if (info.IsEmpty())
+                PrepaireZeroGradients(gradientValues, info);
+            ConvertToOrdered(gradientValues, m_gradientBuffer);
+
+            AggregateSparse(m_communicator->Workers());
+
+            auto value = MakeSharedObject<NDArrayView>(static_cast<double>(info.numberOfSamples), NDShape{ 1 }, DeviceDescriptor::CPUDevice());
+            std::vector<NDArrayViewPtr> valuesToAggregate{ info.evalCriterionValue, info.trainingLossValue, value };
+
+            m_communicator->AggregateInPlace(valuesToAggregate, m_communicator->Workers());
+            info.numberOfSamples = static_cast<size_t>(*valuesToAggregate.back()->WritableDataBuffer<double>());
+
+            m_numMinibatches++;
+            if (info.atEndOfSweep)
+                ReportStatistics();
+        }
+
+        auto profWeights = Microsoft::MSR::CNTK::ScopeProfile(Microsoft::MSR::CNTK::profilerEvtMainWeights);
+
+        m_sampleCount += info.numberOfSamples;
+        m_gradientBuffer.clear();
+
+        if (info.IsEmpty())
+            return false;
+
+        return m_learner->Update(gradientValues, info.numberOfSamples, info.atEndOfSweep);
+    }
+
+    void SparseGradientDistributedLearner::RestoreFromCheckpoint(const Dictionary& checkpoint)
+    {
+        DistributedLearnerBase::RestoreFromCheckpoint(checkpoint);
+
+        // The residuals are local to each worker and are not part of the checkpoint, they restart from zero.
+        m_residuals.clear();
+        m_cpuGradients.clear();
+    }
+
+    void SparseGradientDistributedLearner::AggregateSparse(const std::unordered_set<DistributedWorkerDescriptor>& workers)
+    {
+        const size_t numParameters = m_gradientBuffer.size();
+        if (numParameters == 0)
+            return;
+
+        if (m_residuals.empty())
+        {
+            for (const auto& i : m_gradientBuffer)
+            {
+                const auto& gradient = i.second;
+                if (gradient->IsSparse())
+                    LogicError("SparseGradientDistributedLearner: sparse gradients (parameter '%S') are not supported.", i.first.AsString().c_str());
+
+                m_residuals.push_back(MakeSharedObject<NDArrayView>(0, gradient->GetDataType(), gradient->Shape(), DeviceDescriptor::CPUDevice()));
+                m_cpuGradients.push_back(gradient->Device() == DeviceDescriptor::CPUDevice() ?
+                    nullptr : MakeSharedObject<NDArrayView>(gradient->GetDataType(), gradient->Shape(), DeviceDescriptor::CPUDevice()));
+            }
+        }
+
+        if (m_residuals.size() != numParameters)
+            LogicError("SparseGradientDistributedLearner: the number of gradients (%zu) differs from the number of residuals (%zu).", numParameters, m_residuals.size());
+
+        // Add the gradients to the residuals, and select the entries of the residuals to send.
+        std::vector<NDArrayViewPtr> cpuGradients(numParameters);
+        std::vector<std::vector<size_t>> selected(numParameters);
+        for (size_t p = 0; p < numParameters; ++p)
+        {
+            const auto& gradient = m_gradientBuffer[p].second;
+            if (m_cpuGradients[p])
+                m_cpuGradients[p]->CopyFrom(*gradient);
+            cpuGradients[p] = m_cpuGradients[p] ? m_cpuGradients[p] : gradient;
+
+            if (gradient->GetDataType() == DataType::Float)
+                AccumulateAndSelect<float>(cpuGradients[p], m_residuals[p], selected[p]);
+            else if (gradient->GetDataType() == DataType::Double)
+                AccumulateAndSelect<double>(cpuGradients[p], m_residuals[p], selected[p]);
+            else
+                LogicError("SparseGradientDistributedLearner: unsupported DataType %s.", DataTypeName(gradient->GetDataType()));
+        }
+
+        // The allgather needs the same number of entries on all workers. With top-k it is known, with the threshold
+        // the counts are exchanged first, and the workers that selected fewer entries pad their buffers.
+        auto start = std::chrono::high_resolution_clock::now();
+
+        std::vector<size_t> numEntries(numParameters);
+        if (m_threshold > 0)
+        {
+            auto counts = MakeSharedObject<NDArrayView>(DataType::Double, NDShape{ numParameters }, DeviceDescriptor::CPUDevice());
+            auto countsBuffer = counts->WritableDataBuffer<double>();
+            for (size_t p = 0; p < numParameters; ++p)
+                countsBuffer[p] = static_cast<double>(selected[p].size());
+
+            std::vector<NDArrayViewPtr> allCounts;
+            m_communicator->Concatenate(std::vector<NDArrayViewPtr>{ counts }, allCounts, workers);
+
+            const double* allCountsBuffer = allCounts.front()->DataBuffer<double>();
+            const size_t numWorkers = allCounts.front()->Shape().TotalSize() / numParameters;
+            for (size_t p = 0; p < numParameters; ++p)
+            {
+                for (size_t w = 0; w < numWorkers; ++w)
+                    numEntries[p] = std::max(numEntries[p], static_cast<size_t>(allCountsBuffer[w * numParameters + p]));
+            }
+        }
+        else
+        {
+            // k depends only on the size of the parameter, so all workers agree on it even if some of them selected
+            // fewer entries (e.g. because of NaNs in the residual); those pad their buffers as in the threshold mode.
+            for (size_t p = 0; p < numParameters; ++p)
+                numEntries[p] = NumTopEntries(m_residuals[p]->Shape().TotalSize());
+        }
+
+        auto packStart = std::chrono::high_resolution_clock::now();
+        m_communicationTime += packStart - start;
+
+        std::vector<size_t> exchanged;
+        std::vector<NDArrayViewPtr> sendBuffers;
+        for (size_t p = 0; p < numParameters; ++p)
+        {
+            if (numEntries[p] == 0)
+                continue;
+
+            const auto dataType = m_residuals[p]->GetDataType();
+            auto sendBuffer = MakeSharedObject<NDArrayView>(dataType, NDShape{ 2 * numEntries[p] }, DeviceDescriptor::CPUDevice());
+            if (dataType == DataType::Float)
+                PackSelected<float>(selected[p], numEntries[p], m_residuals[p], sendBuffer);
+            else
+                PackSelected<double>(selected[p], numEntries[p], m_residuals[p], sendBuffer);
+
+            exchanged.push_back(p);
+            sendBuffers.push_back(sendBuffer);
+            m_numSentEntries += numEntries[p];
+        }
+
+        start = std::chrono::high_resolution_clock::now();
+
+        std::vector<NDArrayViewPtr> receiveBuffers;
+        if (!sendBuffers.empty())
+            m_communicator->Concatenate(sendBuffers, receiveBuffers, workers);
+
+        m_communicationTime += std::chrono::high_resolution_clock::now() - start;
+
+        // Sum up the entries of all workers into the gradients, in the order of the workers, so that all of them
+        // compute the same gradients.
+        std::vector<NDArrayViewPtr> receivedPerParameter(numParameters);
+        for (size_t e = 0; e < exchanged.size(); ++e)
+            receivedPerParameter[exchanged[e]] = receiveBuffers[e];
+
+        for (size_t p = 0; p < numParameters; ++p)
+        {
+            if (cpuGradients[p]->GetDataType() == DataType::Float)
+                UnpackAndSum<float>(receivedPerParameter[p], numEntries[p], cpuGradients[p]);
+            else
+                UnpackAndSum<double>(receivedPerParameter[p], numEntries[p], cpuGradients[p]);
+
+            if (m_cpuGradients[p])
+                m_gradientBuffer[p].second->CopyFrom(*m_cpuGradients[p]);
+
+            m_numGradientValues += cpuGradients[p]->Shape().TotalSize();
+        }
+    }
+
+    template <typename ElementType>
+    void SparseGradientDistributedLearner::AccumulateAndSelect(const NDArrayViewPtr& gradient, const NDArrayViewPtr& residual, std::vector<size_t>& selected)
+    {
+        const size_t size = residual->Shape().TotalSize();
+        const ElementType* gradientBuffer = gradient->DataBuffer<ElementType>();
+        ElementType* residualBuffer = residual->WritableDataBuffer<ElementType>();
+
+        for (size_t i = 0; i < size; ++i)
+            residualBuffer[i] += gradientBuffer[i];
+
+        selected.clear();
+        if (m_threshold > 0)
+        {
+            for (size_t i = 0; i < size; ++i)
+            {
+                if (std::abs(residualBuffer[i]) >= m_threshold)
+                    selected.push_back(i);
+            }
+            return;
+        }
+
+        const size_t k = NumTopEntries(size);
+        selected.reserve(k);
+        if (k == size)
+        {
+            for (size_t i = 0; i < size; ++i)
+                selected.push_back(i);
+            return;
+        }
+
+        // The k-th largest magnitude; the entries above it are sent, and as many of those equal to it as needed to get k.
+        std::vector<ElementType> magnitudes(size);
+        for (size_t i = 0; i < size; ++i)
+            magnitudes[i] = std::abs(residualBuffer[i]);
+        std::nth_element(magnitudes.begin(), magnitudes.begin() + (k - 1), magnitudes.end(), std::greater<ElementType>());
+        const ElementType kthMagnitude = magnitudes[k - 1];
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            if (std::abs(residualBuffer[i]) > kthMagnitude)
+                selected.push_back(i);
+        }
+
+        for (size_t i = 0; i < size && selected.size() < k; ++i)
+        {
+            if (std::abs(residualBuffer[i]) == kthMagnitude)
+                selected.push_back(i);
+        }
+
+        // NaNs break the ordering of nth_element, the selection must still not exceed the k entries that are exchanged.
+        if (selected.size() > k)
+            selected.resize(k);
+    }
+
+    size_t SparseGradientDistributedLearner::NumTopEntries(size_t size) const
+    {
+        return std::min(size, std::max<size_t>(1, static_cast<size_t>(std::ceil(m_sparsity * size))));
+    }
+
+    template <typename ElementType>
+    void SparseGradientDistributedLearner::PackSelected(const std::vector<size_t>& selected, size_t numEntries, const NDArrayViewPtr& residual, const NDArrayViewPtr& sendBuffer)
+    {
+        typedef PackedIndexType<ElementType> IndexType;
+        static_assert(sizeof(IndexType) == sizeof(ElementType), "The index must have the size of an element.");
+
+        if (residual->Shape().TotalSize() > std::numeric_limits<IndexType>::max())
+            LogicError("SparseGradientDistributedLearner: the parameter has too many entries (%zu) to be indexed.", residual->Shape().TotalSize());
+
+        ElementType* residualBuffer = residual->WritableDataBuffer<ElementType>();
+        ElementType* data = sendBuffer->WritableDataBuffer<ElementType>();
+        for (size_t e = 0; e < numEntries; ++e)
+        {
+            // padding entries add zero to the first entry
+            IndexType index = 0;
+            ElementType value = 0;
+            if (e < selected.size())
+            {
+                index = static_cast<IndexType>(selected[e]);
+                value = residualBuffer[selected[e]];
+                residualBuffer[selected[e]] = 0;
+            }
+
+            std::memcpy(&data[2 * e], &index, sizeof(index));
+            data[2 * e + 1] = value;
+        }
+    }
+
+    template <typename ElementType>
+    void SparseGradientDistributedLearner::UnpackAndSum(const NDArrayViewPtr& receiveBuffer, size_t numEntries, const NDArrayViewPtr& gradient)
+    {
+        typedef PackedIndexType<ElementType> IndexType;
+
+        const size_t size = gradient->Shape().TotalSize();
+        ElementType* gradientBuffer = gradient->WritableDataBuffer<ElementType>();
+        std::fill(gradientBuffer, gradientBuffer + size, ElementType(0));
+
+        if (numEntries == 0)
+            return;
+
+        const ElementType* data = receiveBuffer->DataBuffer<ElementType>();
+        const size_t numReceived = receiveBuffer->Shape().TotalSize() / 2;
+        for (size_t e = 0; e < numReceived; ++e)
+        {
+            IndexType index;
+            std::memcpy(&index, &data[2 * e], sizeof(index));
+            if (index >= size)
+                LogicError("SparseGradientDistributedLearner: received an invalid index (%zu) for a gradient of size %zu.", static_cast<size_t>(index), size);
+
+            gradientBuffer[index] += data[2 * e + 1];
+        }
+    }
+
+    void SparseGradientDistributedLearner::ReportStatistics()
+    {
+        if (m_numMinibatches == 0)
+            return;
+
+        // Each transmitted entry is an index and a value.
+        const double compressionRatio = m_numSentEntries > 0 ? m_numGradientValues / (2.0 * m_numSentEntries) : 0;
+        const double communicationTimeInMs = 1000 * m_communicationTime.count() / m_numMinibatches;
+        for (auto& writer : m_progressWriters)
+        {
+            writer->Write(L"Sparse gradient compression ratio", compressionRatio);
+            writer->Write(L"Sparse gradient communication time per minibatch (ms)", communicationTimeInMs);
+        }
+
+        m_numGradientValues = 0;
+        m_numSentEntries = 0;
+        m_communicationTime = std::chrono::duration<double>(0);
+        m_numMinibatches = 0;
+    }
+}
@@ -0,0 +1,62 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma  once
+
+#include "CNTKLibrary.h"
+#include "DistributedLearnerBase.h"
+#include <chrono>
+
+namespace CNTK
+{
+    ///
+    /// Data parallel distributed learner that exchanges only a small part of the gradients.
+    ///
+    /// Each worker adds its gradient to a local residual, and sends only the entries of the residual with the largest
+    /// magnitude (or those whose magnitude reaches a threshold) to the other workers, as pairs of index and value.
+    /// The sent entries are removed from the residual; the others are kept and sent in later minibatches, once
+    /// they have accumulated (error feedback). The pairs of all workers are exchanged with an allgather
+    /// (DistributedCommunicator::Concatenate), and summed up to the gradients that are passed to the local learner.
+    ///
+    class SparseGradientDistributedLearner : public DistributedLearnerBase
+    {
+    public:
+        SparseGradientDistributedLearner(DistributedCommunicatorPtr communicator, LearnerPtr learner, size_t distributeAfterSamples, double sparsity, double threshold);
+
+        bool Update(std::unordered_map<Parameter, NDArrayViewPtr>& gradientValues, MinibatchInfo& info) override;
+
+        void RestoreFromCheckpoint(const Dictionary& checkpoint) override;
+
+    private:
+        void AggregateSparse(const std::unordered_set<DistributedWorkerDescriptor>& workers);
+
+        template <typename ElementType>
+        void AccumulateAndSelect(const NDArrayViewPtr& gradient, const NDArrayViewPtr& residual, std::vector<size_t>& selected);
+
+        template <typename ElementType>
+        void PackSelected(const std::vector<size_t>& selected, size_t numEntries, const NDArrayViewPtr& residual, const NDArrayViewPtr& sendBuffer);
+
+        template <typename ElementType>
+        void UnpackAndSum(const NDArrayViewPtr& receiveBuffer, size_t numEntries, const NDArrayViewPtr& gradient);
+
+        // the number of entries of a parameter of the given size that are exchanged in the top-k mode
+        size_t NumTopEntries(size_t size) const;
+
+        void ReportStatistics();
+
+        const double m_sparsity;  // fraction of the entries of each gradient that are sent (top-k)
+        const double m_threshold; // if positive, the entries whose magnitude reaches it are sent instead
+
+        // per parameter (in the order of m_gradientBuffer): the residual, and a CPU copy of the gradient if it is not on the CPU
+        std::vector<NDArrayViewPtr> m_residuals;
+        std::vector<NDArrayViewPtr> m_cpuGradients;
+
+        // statistics since the last report: gradient values, transmitted (index, value) pairs, and the time of the exchange
+        size_t m_numGradientValues;
+        size_t m_numSentEntries;
+        std::chrono::duration<double> m_communicationTime;
+        size_t m_numMinibatches;
+    };
+}
@@ -516,7 +516,10 @@ namespace CNTK
 
             // TODO: this copying here is redundant, value should be moved from the dictionary to the variable.
             // Also, the correct device should be used upfront when deserializing NDArrayView.
-            Variable var(shape, kind, dataType, value.DeepClone(device, kind == VariableKind::Constant), needsGradient, dynamicAxis, isSparse, name, uid);
+            // Memory-mapped values (see ModelFormat::CNTKv2RawTensors) are already where they belong, if they are used on the CPU.
+            bool useInPlace = value.m_isMemoryMapped && (value.Device() == device);
+            auto valueView = useInPlace ? value.Alias(kind == VariableKind::Constant) : value.DeepClone(device, kind == VariableKind::Constant);
+            Variable var(shape, kind, dataType, valueView, needsGradient, dynamicAxis, isSparse, name, uid);
             if (var.IsParameter())
                 return Parameter(var);
             else
@@ -52,6 +52,26 @@ File::File(const wchar_t* filename, int fileOptions)
     Init(filename, fileOptions);
 }
 
+File::File(InMemory, int fileOptions)
+    : m_filename(L"(memory)"), m_pcloseNeeded(false), m_inMemory(true), m_memoryData(nullptr), m_memorySize(0), m_seekable(false), m_options(fileOptions)
+{
+    if ((fileOptions & fileOptionsRead) || !(fileOptions & fileOptionsWrite))
+        RuntimeError("File: in-memory files can only be written");
+#ifdef _WIN32
+    // There are no memory streams on Windows. A temporary file that is deleted when closed ("D"), and kept in the cache
+    // as long as there is memory ("T"), is the closest.
+    wchar_t tempDirectory[MAX_PATH];
+    wchar_t tempPath[MAX_PATH];
+    if (!GetTempPathW(MAX_PATH, tempDirectory) || !GetTempFileNameW(tempDirectory, L"cntk", 0, tempPath))
+        RuntimeError("File: failed to create a temporary file for an in-memory file");
+    m_file = _wfopen(tempPath, (fileOptions & fileOptionsBinary) ? L"w+bTD" : L"w+tTD");
+#else
+    m_file = open_memstream(&m_memoryData, &m_memorySize);
+#endif
+    if (!m_file)
+        RuntimeError("File: failed to create an in-memory file: %s", strerror(errno));
+}
+
 template<class String>
 static bool IsNonFilePath(const String& filename)
 {
@@ -87,6 +107,9 @@ void File::Init(const wchar_t* filename, int fileOptions)
 {
     m_filename = filename;
     m_options = fileOptions;
+    m_inMemory = false;
+    m_memoryData = nullptr;
+    m_memorySize = 0;
     if (m_filename.empty())
         RuntimeError("File: filename is empty");
     const auto outputPipe = (m_filename.front() == '|');
@@ -277,6 +300,7 @@ File::~File(void)
             RuntimeError("File: failed to close file at %S", m_filename.c_str());
         }
     }
+    free(m_memoryData); // open_memstream() allocates with malloc()
 }
 
 void File::Flush()
@@ -284,6 +308,23 @@ void File::Flush()
     fflushOrDie(m_file);
 }
 
+std::vector<char> File::GetMemoryContents()
+{
+    if (!m_inMemory)
+        LogicError("File: GetMemoryContents() called on a file that is not in memory");
+    fflushOrDie(m_file);
+#ifdef _WIN32
+    auto size = filesize(m_file);
+    std::vector<char> contents(size);
+    fsetpos(m_file, 0);
+    freadOrDie(contents.data(), 1, size, m_file);
+    fsetpos(m_file, size);
+    return contents;
+#else
+    return std::vector<char>(m_memoryData, m_memoryData + m_memorySize);
+#endif
+}
+
 // read a line
 // End of line is denoted by one of these, i.e. we don't support the old Mac OS convention of CR
 //  - LF
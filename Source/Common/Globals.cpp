@@ -16,6 +16,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
     std::atomic<bool> Globals::m_enableShareNodeValueMatrices(true);
     std::atomic<bool> Globals::m_optimizeGradientAccumulation(true);
+    std::atomic<size_t> Globals::m_numNodeExecutionThreads(0);
+    std::atomic<bool> Globals::m_fuseElementwiseOperations(true);
+    std::atomic<bool> Globals::m_useWinogradConvolution(false);
 
     // Note: this is a map that transfers the old reader and writer names to
     //       the new naming scheme
@@ -0,0 +1,105 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUFeatures.h -- runtime detection of the instruction set extensions supported by the CPU and enabled by the OS.
+// Used to select between code paths compiled for different instruction sets at runtime.
+//
+
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CNTK_X86_CPU
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#include <cstdint>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class CPUFeatures
+{
+public:
+    // Features are detected once per process.
+    static const CPUFeatures& Get()
+    {
+        static const CPUFeatures features;
+        return features;
+    }
+
+    bool HasSSE42() const { return m_sse42; }
+    bool HasAVX2() const { return m_avx2; }
+    bool HasFMA() const { return m_fma; }
+    bool HasAVX512F() const { return m_avx512f; }
+    bool HasAVX512BW() const { return m_avx512bw; }
+    bool HasAVX512VNNI() const { return m_avx512vnni; }
+
+private:
+    CPUFeatures() :
+        m_sse42(false), m_avx2(false), m_fma(false), m_avx512f(false), m_avx512bw(false), m_avx512vnni(false)
+    {
+#ifdef CNTK_X86_CPU
+        uint32_t regs[4]; // eax, ebx, ecx, edx
+        CpuId(0, 0, regs);
+        uint32_t maxLeaf = regs[0];
+        if (maxLeaf < 1)
+            return;
+
+        CpuId(1, 0, regs);
+        m_sse42 = (regs[2] & (1u << 20)) != 0;
+        bool osxsave = (regs[2] & (1u << 27)) != 0;
+        bool avx = (regs[2] & (1u << 28)) != 0;
+        bool fma = (regs[2] & (1u << 12)) != 0;
+
+        // AVX and AVX-512 registers are only usable if the OS saves them on context switches.
+        uint64_t xcr0 = osxsave ? GetXCR0() : 0;
+        bool osSupportsAVX = (xcr0 & 0x6) == 0x6;        // XMM and YMM state
+        bool osSupportsAVX512 = (xcr0 & 0xe6) == 0xe6;   // XMM, YMM, opmask and ZMM state
+
+        m_fma = avx && fma && osSupportsAVX;
+        if (maxLeaf < 7)
+            return;
+
+        CpuId(7, 0, regs);
+        m_avx2 = avx && osSupportsAVX && (regs[1] & (1u << 5)) != 0;
+        m_avx512f = osSupportsAVX512 && (regs[1] & (1u << 16)) != 0;
+        m_avx512bw = m_avx512f && (regs[1] & (1u << 30)) != 0;
+        m_avx512vnni = m_avx512f && (regs[2] & (1u << 11)) != 0;
+#endif
+    }
+
+#ifdef CNTK_X86_CPU
+    static void CpuId(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+    {
+#ifdef _MSC_VER
+        __cpuidex(reinterpret_cast<int*>(regs), (int)leaf, (int)subleaf);
+#else
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    static uint64_t GetXCR0()
+    {
+#ifdef _MSC_VER
+        return _xgetbv(0);
+#else
+        uint32_t eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return ((uint64_t)edx << 32) | eax;
+#endif
+    }
+#endif
+
+    bool m_sse42;
+    bool m_avx2;
+    bool m_fma;
+    bool m_avx512f;
+    bool m_avx512bw;
+    bool m_avx512vnni;
+};
+
+}}}
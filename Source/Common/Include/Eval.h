@@ -362,4 +362,62 @@ void EVAL_API GetEvalExtended(IEvaluateModelExtended<ElemType>** peval);
 extern "C" EVAL_API void GetEvalExtendedF(IEvaluateModelExtended<float>** peval);
 extern "C" EVAL_API void GetEvalExtendedD(IEvaluateModelExtended<double>** peval);
 
+// ------------------------------------------------------------------------
+// Batched interface
+// ------------------------------------------------------------------------
+
+//
+// Statistics of the request batching, for tuning maxBatchSize and maxBatchLatencyMs.
+//
+struct BatchingStatistics
+{
+    // Number of requests and of forward passes (batches) since the last reset.
+    size_t m_numRequests;
+    size_t m_numBatches;
+
+    // [n] number of forward passes that evaluated n requests together.
+    std::vector<size_t> m_batchSizeHistogram;
+
+    // [k] number of requests whose latency was below 2^k microseconds (and not below 2^(k-1)).
+    // The latency is measured from the call of ForwardPass() until it returns.
+    std::vector<size_t> m_latencyHistogram;
+
+    // Latency percentiles in milliseconds, over the most recent requests.
+    double m_latencyP50;
+    double m_latencyP90;
+    double m_latencyP99;
+    double m_latencyMax;
+};
+
+//
+// Extended interface that can be called from multiple threads concurrently, e.g. by an online service.
+// Concurrent ForwardPass() calls are queued and evaluated together in a single forward pass, with one parallel
+// sequence per request (sequences can have different lengths), and the outputs are handed back to the callers.
+// The following parameters can be passed to Init() or with the network description to CreateNetwork():
+// maxBatchSize=32 (max number of requests that are evaluated together)
+// maxBatchLatencyMs=2 (max time to wait for further requests after the first one arrived)
+// Since the forward pass is shared with the requests of other callers, there is no RNN state to continue, and
+// ForwardPass() with resetRNN == false throws. The outputs of a network must have a dynamic axis to be split
+// between the requests; otherwise (e.g. an output that sums over all samples) every request is evaluated on its own.
+//
+template <typename ElemType>
+class IEvaluateModelBatched : public IEvaluateModelExtended<ElemType>
+{
+public:
+    //
+    // GetBatchingStatistics - retrieve statistics about batch sizes and request latencies.
+    //
+    virtual void GetBatchingStatistics(BatchingStatistics& statistics) const = 0;
+
+    //
+    // ResetBatchingStatistics - start collecting statistics anew, e.g. after a warm-up phase.
+    //
+    virtual void ResetBatchingStatistics() = 0;
+};
+
+template <typename ElemType>
+void EVAL_API GetEvalBatched(IEvaluateModelBatched<ElemType>** peval);
+extern "C" EVAL_API void GetEvalBatchedF(IEvaluateModelBatched<float>** peval);
+extern "C" EVAL_API void GetEvalBatchedD(IEvaluateModelBatched<double>** peval);
+
 } } }
@@ -97,6 +97,9 @@ private:
     std::wstring m_filename;
     FILE* m_file;        // file handle
     bool m_pcloseNeeded; // was opened with popen(), use pclose() when destructing
+    bool m_inMemory;     // writes into memory, see GetMemoryContents()
+    char* m_memoryData;  // buffer of open_memstream(), owned
+    size_t m_memorySize;
     bool m_seekable;     // this stream is seekable
     int m_options;       // FileOptions ored togther
     void Init(const wchar_t* filename, int fileOptions);
@@ -105,8 +108,15 @@ public:
     File(const std::wstring& filename, int fileOptions);
     File(const std::string&  filename, int fileOptions);
     File(const wchar_t* filename, int fileOptions);
+
+    // A File for writing into memory instead of a file, e.g. to serialize an object on one thread and write the bytes to disk on another.
+    struct InMemory {};
+    File(InMemory, int fileOptions);
     ~File();
 
+    // the bytes written so far into a File created with InMemory
+    std::vector<char> GetMemoryContents();
+
     void Flush();
 
     bool CanSeek() const { return m_seekable; }
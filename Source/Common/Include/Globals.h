@@ -28,11 +28,27 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         static void SetShareNodeValueMatrices(bool enable) { m_enableShareNodeValueMatrices = enable; }
         static bool ShouldEnableShareNodeValueMatrices() { return m_enableShareNodeValueMatrices; }
 
+        // Number of threads used to execute independent nodes of the network concurrently (CPU only); 0 or 1 disables it.
+        static void SetNumNodeExecutionThreads(size_t numThreads) { m_numNodeExecutionThreads = numThreads; }
+        static size_t GetNumNodeExecutionThreads() { return m_numNodeExecutionThreads; }
+        static bool ShouldExecuteNodesInParallel() { return m_numNodeExecutionThreads > 1; }
+
+        // Whether CompileNetwork() replaces chains of elementwise nodes by fused nodes (CPU only), see ComputationNetwork::FuseElementwiseNodes().
+        static void SetElementwiseFusion(bool enable) { m_fuseElementwiseOperations = enable; }
+        static bool ShouldFuseElementwiseOperations() { return m_fuseElementwiseOperations; }
+
+        // Whether the convolution nodes may use the Winograd CPU engine, see ConvolutionEngineKind::Winograd.
+        static void SetWinogradConvolution(bool enable) { m_useWinogradConvolution = enable; }
+        static bool ShouldUseWinogradConvolution() { return m_useWinogradConvolution; }
+
     private:
         static std::atomic<bool> m_forceDeterministicAlgorithms;
         // The global flag to enable matrices values in forward and backward prop
         static std::atomic<bool> m_enableShareNodeValueMatrices;
         static std::atomic<bool> m_forceConstantRandomSeed;
         static std::atomic<bool> m_optimizeGradientAccumulation;
+        static std::atomic<size_t> m_numNodeExecutionThreads;
+        static std::atomic<bool> m_fuseElementwiseOperations;
+        static std::atomic<bool> m_useWinogradConvolution;
     };
 }}}
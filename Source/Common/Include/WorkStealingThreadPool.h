@@ -0,0 +1,157 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// WorkStealingThreadPool.h -- a small thread pool for fine-grained tasks that spawn further tasks.
+//
+// Every worker owns a queue. Tasks submitted from a worker go to the back of its own queue and are taken
+// from there again (LIFO, which keeps a chain of dependent tasks on the same core); idle workers steal
+// from the front of the other queues. Tasks submitted from outside the pool are distributed round robin.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+class WorkStealingThreadPool
+{
+public:
+    typedef std::function<void()> Task;
+
+    explicit WorkStealingThreadPool(size_t numThreads) :
+        m_queues(numThreads == 0 ? 1 : numThreads),
+        m_numPendingTasks(0),
+        m_nextQueue(0),
+        m_stop(false)
+    {
+        for (size_t i = 0; i < m_queues.size(); i++)
+            m_queues[i].reset(new WorkQueue());
+        for (size_t i = 0; i < m_queues.size(); i++)
+            m_threads.push_back(std::thread([this, i] { WorkerLoop(i); }));
+    }
+
+    ~WorkStealingThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_wakeUpMutex);
+            m_stop = true;
+        }
+        m_wakeUp.notify_all();
+        for (auto& thread : m_threads)
+            thread.join();
+    }
+
+    size_t GetNumThreads() const { return m_threads.size(); }
+
+    // Index of the calling worker thread, or -1 if called from outside the pool.
+    static int GetCurrentWorkerIndex() { return CurrentWorker().index; }
+
+    // Tasks must not throw, exceptions have to be captured by the task itself.
+    void Submit(Task&& task)
+    {
+        const auto& worker = CurrentWorker();
+        size_t queue = (worker.pool == this) ? (size_t)worker.index : m_nextQueue++ % m_queues.size();
+        {
+            std::lock_guard<std::mutex> lock(m_queues[queue]->mutex);
+            m_queues[queue]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_wakeUpMutex);
+            m_numPendingTasks++;
+        }
+        m_wakeUp.notify_one();
+    }
+
+private:
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    struct WorkerInfo
+    {
+        const WorkStealingThreadPool* pool;
+        int index;
+    };
+
+    static WorkerInfo& CurrentWorker()
+    {
+        static thread_local WorkerInfo worker = { nullptr, -1 };
+        return worker;
+    }
+
+    bool TryPop(size_t queue, bool fromBack, Task& task)
+    {
+        std::lock_guard<std::mutex> lock(m_queues[queue]->mutex);
+        auto& tasks = m_queues[queue]->tasks;
+        if (tasks.empty())
+            return false;
+
+        if (fromBack)
+        {
+            task = std::move(tasks.back());
+            tasks.pop_back();
+        }
+        else
+        {
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        return true;
+    }
+
+    // Own queue first, then steal from the others.
+    bool TryGetTask(size_t self, Task& task)
+    {
+        if (TryPop(self, /*fromBack=*/true, task))
+            return true;
+        for (size_t i = 1; i < m_queues.size(); i++)
+        {
+            if (TryPop((self + i) % m_queues.size(), /*fromBack=*/false, task))
+                return true;
+        }
+        return false;
+    }
+
+    void WorkerLoop(size_t self)
+    {
+        CurrentWorker() = { this, (int)self };
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_wakeUpMutex);
+                m_wakeUp.wait(lock, [this] { return m_stop || m_numPendingTasks > 0; });
+                if (m_stop)
+                    return;
+                // claim one of the pending tasks; it is guaranteed to be in one of the queues
+                m_numPendingTasks--;
+            }
+
+            Task task;
+            while (!TryGetTask(self, task))
+                std::this_thread::yield(); // the task was claimed before it became visible in a queue
+            task();
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_wakeUpMutex;
+    std::condition_variable m_wakeUp;
+    size_t m_numPendingTasks;   // tasks submitted but not yet claimed by a worker, guarded by m_wakeUpMutex
+    std::atomic<size_t> m_nextQueue;
+    bool m_stop;
+};
+
+}}}
@@ -49,6 +49,11 @@ struct htkmlfentry;
 };
 }; // for numer lattice building
 
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+struct LatticeTestRunner;
+}}}} // for unit tests of the lattice-level forward/backward
+
 namespace msra { namespace lattices {
 
 typedef msra::math::ssematrixbase matrixbase;
@@ -67,6 +72,8 @@ enum mbrclassdefinition // used to identify definition of class in minimum bayes
 // ===========================================================================
 class lattice
 {
+    friend struct Microsoft::MSR::CNTK::Test::LatticeTestRunner;
+
     mutable int verbosity;
     struct header_v1_v2
     {
@@ -753,6 +760,12 @@ private:
                                      const msra::math::ssematrixbase& logLLs, msra::math::ssematrixbase& gammas,
                                      size_t edgeindex);
 
+    // lattices with fewer edges are processed sequentially on the CPU; the parallel loops would not pay off
+    static size_t parallelminedges;
+
+    // number of chunks to split a loop over 'n' items into for parallel processing on the CPU (1 = sequential)
+    static size_t numparallelchunks(size_t n, size_t numedges);
+
     double forwardbackwardlattice(const std::vector<float>& edgeacscores, parallelstate& parallelstate,
                                   std::vector<double>& logpps, std::vector<double>& logalphas, std::vector<double>& logbetas,
                                   const float lmf, const float wp, const float amf, const float boostingfactor, const bool sMBRmode,
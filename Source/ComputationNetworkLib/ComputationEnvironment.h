@@ -6,10 +6,13 @@
 #pragma once
 
 #include "Basics.h"
+#include <functional>
 #include <memory>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+class ComputationNodeBase;
+
 // ===========================================================================
 // ComputationEnvironment -- global network properties of interest to nodes
 // ===========================================================================
@@ -44,6 +47,12 @@ struct ComputationEnvironment
 
     bool trackGapNans = false;
 
+    // per-node profiling, see ComputationNetwork::SetNodeProfiling()
+    bool profileNodes = false;
+
+    // notification about completed gradients during Backprop(), see ComputationNetwork::SetGradientReadyCallback()
+    std::function<void(const std::shared_ptr<ComputationNodeBase>&)> gradientReadyCallback;
+
     // traceLevel
     int traceLevel = 0;
 
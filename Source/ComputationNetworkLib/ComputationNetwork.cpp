@@ -19,6 +19,7 @@
 #include "PreComputeNodes.h"
 #include "EvaluationNodes.h"
 #include "SpecialPurposeNodes.h"
+#include "FusedElementwiseNodes.h"
 #include "DeprecatedNodes.h" // (for SaveToDbnFile(), which is also deprecated)
 #include "MPIWrapper.h" // TODO: does not belong here
 #include <string>
@@ -47,6 +48,18 @@ vector<MemRequestInfo<double>>& MatrixPool::GetMemRequestInfoVec<double>()
     return m_memRequestInfoDoubleVec;
 }
 
+template <>
+vector<MemBufferInfo<float>>& MatrixPool::GetMemBufferInfoVec<float>()
+{
+    return m_memBufferInfoFloatVec;
+}
+
+template <>
+vector<MemBufferInfo<double>>& MatrixPool::GetMemBufferInfoVec<double>()
+{
+    return m_memBufferInfoDoubleVec;
+}
+
 // -----------------------------------------------------------------------
 // construction
 // -----------------------------------------------------------------------
@@ -102,12 +115,44 @@ void ComputationNetwork::Save(const wstring& fileName, const FileOptions fileFor
     renameOrDie(tmpFileName, fileName);
 }
 
+void ComputationNetwork::Save(File& fstream, const map<wstring, MatrixBasePtr>& parameterValues) const
+{
+    VerifyIsCompiled("Save");
+    SaveToStream(fstream, &parameterValues);
+}
+
+// helper for SaveToStream(): save a LearnableParameter with its value taken from 'parameterValues'
+// Returns false if the node is not a LearnableParameter<ElemType> or has no entry in 'parameterValues'.
+template <class ElemType>
+static bool TrySaveParameterWithValue(const ComputationNodeBasePtr& node, const map<wstring, MatrixBasePtr>& parameterValues, File& fstream)
+{
+    auto parameter = dynamic_pointer_cast<LearnableParameter<ElemType>>(node);
+    if (!parameter)
+        return false;
+
+    auto iter = parameterValues.find(node->NodeName());
+    if (iter == parameterValues.end())
+        return false;
+
+    auto value = dynamic_pointer_cast<Matrix<ElemType>>(iter->second);
+    if (!value)
+        LogicError("Save: The value given for parameter '%ls' has the wrong element type.", node->NodeName().c_str());
+
+    parameter->SaveWithValue(fstream, *value);
+    return true;
+}
+
 // TODO: how does the file distinguish float vs double nodes?
 void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptions fileFormat) const
 {
     File fstream(fileName, fileFormat | FileOptions::fileOptionsWrite);
     // Buffer writes in memory then flush to filesystem, which reduces number of small writes
     fstream.Setvbuf();
+    SaveToStream(fstream, nullptr);
+}
+
+void ComputationNetwork::SaveToStream(File& fstream, const map<wstring, MatrixBasePtr>* parameterValues) const
+{
     fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCN");
 
     // model version
@@ -115,13 +160,23 @@ void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptio
     fstream << (size_t) CURRENT_CNTK_MODEL_VERSION;
     fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
 
-    fstream << (size_t) m_nameToNodeMap.size();
+    // fused elementwise nodes are saved as the nodes they replace
+    vector<ComputationNodeBasePtr> nodes;
+    for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
+    {
+        auto fusedNode = dynamic_pointer_cast<FusedElementwiseNodeBase>(nodeIter->second);
+        if (fusedNode)
+            nodes.insert(nodes.end(), fusedNode->GetOriginalNodes().begin(), fusedNode->GetOriginalNodes().end());
+        else
+            nodes.push_back(nodeIter->second);
+    }
+
+    fstream << (size_t) nodes.size();
 
     // put all node info first
     fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BNodeList");
-    for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
+    for (const auto& nodePtr : nodes)
     {
-        ComputationNodeBasePtr nodePtr = nodeIter->second;
         // type
 #if CURRENT_CNTK_MODEL_VERSION >= CNTK_MODEL_VERSION_7
         wstring precision;
@@ -136,16 +191,17 @@ void ComputationNetwork::SaveToFileImpl(const wstring& fileName, const FileOptio
         // name
         fstream << nodePtr->NodeName();
         // content
-        nodePtr->Save(fstream);
+        if (!parameterValues ||
+            (!TrySaveParameterWithValue<float>(nodePtr, *parameterValues, fstream) && !TrySaveParameterWithValue<double>(nodePtr, *parameterValues, fstream)))
+            nodePtr->Save(fstream);
     }
 
     fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ENodeList");
 
     // put relationship
     fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BRelation");
-    for (auto nodeIter = m_nameToNodeMap.begin(); nodeIter != m_nameToNodeMap.end(); nodeIter++)
+    for (const auto& nodePtr : nodes)
     {
-        ComputationNodeBasePtr nodePtr = nodeIter->second;
         fstream << nodePtr->NodeName() << nodePtr->GetNumInputs();
         for (size_t i = 0; i < nodePtr->GetNumInputs(); i++)
         {
@@ -1157,6 +1213,61 @@ void ComputationNetwork::PerformSVDecomposition(const map<wstring, float>& SVDCo
     CompileNetwork();
 }
 
+// Replaces every TimesNode that multiplies a (dense) parameter matrix on the CPU by an equivalent QuantizedTimesNode
+// with the given quantizer bit shifts (see QuantizedTimesNode), for faster evaluation.
+// If numProductsToCompare is not 0, the quantized nodes also compute their first numProductsToCompare products without quantization
+// and report the error and the speed-up. Returns the number of replaced nodes.
+template <class ElemType>
+size_t ComputationNetwork::QuantizeTimesNodes(size_t bitShiftA, size_t bitShiftB, size_t numProductsToCompare)
+{
+    if (m_deviceId != CPUDEVICE)
+    {
+        fprintf(stderr, "QuantizeTimesNodes: Quantized products are only supported on the CPU; the network is left unchanged.\n");
+        return 0;
+    }
+
+    // whether the value of a node is sparse is known after validation
+    if (!IsCompiled())
+        CompileNetwork();
+
+    vector<shared_ptr<TimesNode<ElemType>>> timesNodes;
+    size_t numTimesNodes = 0;
+    size_t numSparseTimesNodes = 0;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        auto timesNode = dynamic_pointer_cast<TimesNode<ElemType>>(iter.second);
+        if (!timesNode)
+            continue;
+
+        numTimesNodes++;
+        // The product of two parameters is not quantized (see QuantizedMultiplier).
+        auto weights = dynamic_pointer_cast<LearnableParameter<ElemType>>(timesNode->GetInputs()[0]);
+        if (!weights || weights->Value().GetMatrixType() != MatrixType::DENSE || IsNodePtr<LearnableParameter<ElemType>>(timesNode->GetInputs()[1]))
+            continue;
+
+        // A product with sparse data would fall back to the unquantized sparse product (see QuantizedTimesNode).
+        if (timesNode->GetInputs()[1]->IsValueSparse())
+            numSparseTimesNodes++;
+        else
+            timesNodes.push_back(timesNode);
+    }
+
+    for (const auto& timesNode : timesNodes)
+    {
+        auto quantizedNode = New<QuantizedTimesNode<ElemType>>(m_deviceId, timesNode->NodeName(), bitShiftA, bitShiftB, timesNode->OutputRank(), timesNode->InferInputRankToMap());
+        ReplaceNode(timesNode->NodeName(), quantizedNode);
+        quantizedNode->CompareWithUnquantized(numProductsToCompare);
+    }
+
+    fprintf(stderr, "QuantizeTimesNodes: Replaced %d of %d Times nodes by QuantizedTimes nodes (bitShiftA = %d, bitShiftB = %d), %d products of parameters and sparse data are not quantized%s.\n",
+            (int)timesNodes.size(), (int)numTimesNodes, (int)bitShiftA, (int)bitShiftB, (int)numSparseTimesNodes,
+            IsBlockHandlerSupported<short>(BlockHandlerType::Best) ? "" : ", the processor does not support the optimized kernels");
+
+    if (!timesNodes.empty())
+        CompileNetwork();
+    return timesNodes.size();
+}
+
 // Helper class to form a logical DBN layer while exporting the network (used by SaveToDbnFile)
 class DbnLayer
 {
@@ -1524,6 +1635,7 @@ template void ComputationNetwork::InitLearnableParametersWithBilinearFill<float>
 template void ComputationNetwork::Read<float>(const wstring& fileName);
 template void ComputationNetwork::ReadPersistableParameters<float>(size_t modelVersion, File& fstream, bool create);
 template void ComputationNetwork::PerformSVDecomposition<float>(const map<wstring, float>& SVDConfig, size_t alignedsize);
+template size_t ComputationNetwork::QuantizeTimesNodes<float>(size_t bitShiftA, size_t bitShiftB, size_t numProductsToCompare);
 template /*static*/ void ComputationNetwork::SetDropoutRate<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate);
 template /*static*/ void ComputationNetwork::SetIRngUserSeed<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, size_t randSeedBase);
 template /*static*/ void ComputationNetwork::SetBatchNormalizationTimeConstants<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double normalizationTimeConstant, double& prevNormalizationTimeConstant, double blendTimeConstant, double& prevBlendTimeConstant);
@@ -1535,6 +1647,7 @@ template void ComputationNetwork::InitLearnableParametersWithBilinearFill<double
 template void ComputationNetwork::Read<double>(const wstring& fileName);
 template void ComputationNetwork::ReadPersistableParameters<double>(size_t modelVersion, File& fstream, bool create);
 template void ComputationNetwork::PerformSVDecomposition<double>(const map<wstring, float>& SVDConfig, size_t alignedsize);
+template size_t ComputationNetwork::QuantizeTimesNodes<double>(size_t bitShiftA, size_t bitShiftB, size_t numProductsToCompare);
 template /*static*/ void ComputationNetwork::SetDropoutRate<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate);
 template /*static*/ void ComputationNetwork::SetIRngUserSeed<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, size_t randSeedBase);
 template /*static*/ void ComputationNetwork::SetBatchNormalizationTimeConstants<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double normalizationTimeConstant, double& prevNormalizationTimeConstant, double blendTimeConstant, double& prevBlendTimeConstant);
@@ -52,6 +52,7 @@ public:
         m_randomSeedOffset(0),
         m_isCompiled(false),
         m_areMatricesAllocated(false),
+        m_fuseElementwiseNodes(true),
         m_pMBLayoutOfNetwork(make_shared<MBLayout>(1, 0, ComputationNodeBase::DefaultDynamicAxisName)),
         m_environment(make_shared<ComputationEnvironment>())
     {
@@ -120,9 +121,14 @@ public:
     void Save(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary) const;
     void SaveEdited(const std::wstring& fileName, const FileOptions fileFormat = FileOptions::fileOptionsBinary);
 
+    // Save() into an open File, with the values of the learnable parameters in 'parameterValues' (by node name) taken from there instead of from the nodes.
+    // SGD (option asyncCheckpoint) serializes the network with a snapshot of the parameters into memory this way, and writes the file on a background thread.
+    void Save(File& fstream, const std::map<std::wstring, MatrixBasePtr>& parameterValues) const;
+
 private:
 
     void SaveToFileImpl(const std::wstring& fileName, const FileOptions fileFormat) const;
+    void SaveToStream(File& fstream, const std::map<std::wstring, MatrixBasePtr>* parameterValues) const;
     
     static size_t GetModelVersion(File& fstream);
 
@@ -138,6 +144,9 @@ public:
     // main entry point for backprop
     void Backprop(const ComputationNodeBasePtr rootNode);
 
+    // statistics of the memory reserved for the shared matrices
+    const MatrixPoolStatistics& GetMatrixPoolStatistics() const { return m_matrixPool.GetStatistics(); }
+
     template <class NODESET> // version that takes multiple nodes
     void TravserseInSortedGlobalEvalOrder(const NODESET& nodes, const std::function<void(const ComputationNodeBasePtr&)>& action)
     {
@@ -171,9 +180,13 @@ public:
     template <class NODESET> // version that takes multiple nodes
     void ForwardProp(const NODESET& nodes)
     {
-        TravserseInSortedGlobalEvalOrder(nodes, [](const ComputationNodeBasePtr& node) {
-            PARTraversalFlowControlNode::ForwardProp(node, FrameRange(nullptr));
-        });
+        if (nodes.begin() == nodes.end())
+            return;
+
+        ReserveMatricesForMinibatch();
+
+        // all nodes are computed in one traversal, such that nodes of different ones may be executed in parallel
+        GetNestedNetworkForNodes(std::vector<ComputationNodeBasePtr>(nodes.begin(), nodes.end()))->ForwardProp(FrameRange(nullptr));
     }
 
     template <class NODESET_FROM, class NODESET_TO> // version that takes both initial and final set of nodes
@@ -229,7 +242,16 @@ public:
 
     void CompileNetwork(); // call this after creation, Load(), and any modification
 
+    // Whether CompileNetwork() replaces chains of elementwise nodes by fused nodes (if also enabled by Globals::SetElementwiseFusion()).
+    // Disable it before loading a network whose nodes are inspected or edited by name, since the fused-away nodes are no longer part of the network.
+    void SetElementwiseFusion(bool enable) { m_fuseElementwiseNodes = enable; }
+
 private:
+    void CompileNetworkStructure();
+    void ClearCompiledNetwork();
+    size_t FuseElementwiseNodes();
+    void UnfuseElementwiseNodes();
+    void ReplaceInNodeGroups(const ComputationNodeBasePtr& oldNode, const ComputationNodeBasePtr& newNode);
     void ValidateNetwork();
     size_t ValidateNodes(list<ComputationNodeBasePtr> nodes, bool isFirstPass, bool isFinalValidationPass);
     bool ValidateNode(ComputationNodeBasePtr node, bool isFinalValidationPass) const;
@@ -252,6 +274,7 @@ public:
 
 private:
     void PrintMemorySharingStructure(const std::vector<ComputationNodeBasePtr>& nodes);
+    void ReserveMatricesForMinibatch();
     void ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap);
     void AllocateGradientMatricesForInputs(ComputationNodeBasePtr parentNode);
 
@@ -262,6 +285,8 @@ public:
 
     void FormNestedNetwork(const ComputationNodeBasePtr& rootNode);
     ComputationNodeBasePtr GetNestedNetwork(const ComputationNodeBasePtr& rootNode);
+    // execution plan that computes all the given nodes in one traversal; formed on first use
+    ComputationNodeBasePtr GetNestedNetworkForNodes(std::vector<ComputationNodeBasePtr> nodes);
 
     // The methods below determine evaluation order, which is tricky in presence of recurrent loops.
     // TODO: Can this be moved to a separate class?
@@ -475,7 +500,12 @@ public:
     {
         auto iter = m_nameToNodeMap.find(name);
         if (iter == m_nameToNodeMap.end())
+        {
+            auto fusedIter = m_fusedNodeNames.find(name);
+            if (fusedIter != m_fusedNodeNames.end())
+                RuntimeError("GetNodeFromName: Node '%ls' has been fused into node '%ls'. Use fuseElementwiseOperations=false to access it.", name.c_str(), fusedIter->second.c_str());
             RuntimeError("GetNodeFromName: Network has no node named '%ls'.", name.c_str());
+        }
         return iter->second;
     }
 
@@ -823,6 +853,9 @@ public:
     template <class ElemType>
     void PerformSVDecomposition(const map<wstring, float>& SVDConfig, size_t AlignedSize);
 
+    template <class ElemType>
+    size_t QuantizeTimesNodes(size_t bitShiftA, size_t bitShiftB, size_t numProductsToCompare = 0);
+
     template <class ElemType>
     void SaveToDbnFile(ComputationNetworkPtr net, const std::wstring& fileName) const;
 
@@ -947,6 +980,24 @@ public:
     }
     int TraceLevel() const { return m_environment->traceLevel; }
 
+    // time the forward and backward computation of every node and report it to the performance profiler
+    // (which must be enabled as well, e.g. profilerEnabled=true), which writes a per-node report
+    void SetNodeProfiling(bool enable)
+    {
+        m_environment->profileNodes = enable;
+    }
+    bool IsNodeProfilingEnabled() const { return m_environment->profileNodes; }
+
+    // Registers a function that Backprop() calls for every node as soon as its gradient is complete,
+    // i.e. all nodes that read from it have backpropagated into it. This allows to start the aggregation
+    // of parameter gradients while the backprop of the lower layers is still running.
+    // If nodes are executed in parallel (Globals::GetNumNodeExecutionThreads()), the function is called concurrently.
+    // Pass nullptr to remove it.
+    void SetGradientReadyCallback(const std::function<void(const ComputationNodeBasePtr&)>& callback)
+    {
+        m_environment->gradientReadyCallback = callback;
+    }
+
     // call EnableNodeTracing() on the given nodes for real, category, and sparse printing
     void EnableNodeTracing(const std::vector<std::wstring>& traceNodeNamesReal,
                            const std::vector<std::wstring>& traceNodeNamesCategory,
@@ -1184,6 +1235,38 @@ protected:
         // There is currently no other constructor for inner nested PAR-traversed sub-networks, but there will be.
         PARTraversalFlowControlNode(const std::vector<shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const std::list<ComputationNodeBasePtr>& allNodes);
         // Base::m_nestedNodes contains all top-level nodes, in evaluation order
+
+        // Used by ComputationNetwork::AllocateAllMatrices() to keep nodes that may run concurrently from sharing memory.
+        bool ShouldExecuteInParallel() const;
+        // index of the nested node that executes the given node (a SEQ loop executes all of its members), or SIZE_MAX
+        size_t FindNestedNodeIndex(const ComputationNodeBasePtr& node) const;
+        // whether ForwardProp() resp. Backprop() may execute the two nested nodes concurrently, i.e. neither depends on the other
+        bool MayExecuteConcurrently(size_t i, size_t j, bool backward) const;
+
+    private:
+        // Parallel execution of independent nodes (opt-in, see Globals::SetNumNodeExecutionThreads()).
+        // The nested nodes form a DAG. A node is dispatched onto the thread pool as soon as all its predecessors have completed.
+        // Forward: the predecessors of a node are its inputs.
+        // Backward: the predecessors of a node are its parents, and the parents of a node are serialized among each other
+        // since they all accumulate into the node's gradient.
+        struct NodeDependencies
+        {
+            std::vector<std::vector<size_t>> successors; // [node index] -> indices of the nodes that depend on it
+            std::vector<size_t> numPredecessors;         // [node index] -> number of nodes it depends on
+        };
+
+        void BuildDependencyGraphs();
+        static void ComputeReachability(const NodeDependencies& dependencies, std::vector<std::vector<uint64_t>>& reachable);
+        void ExecuteInParallel(const NodeDependencies& dependencies, const std::function<void(const ComputationNodeBasePtr&)>& action, const char* passName, bool& isTimingDumped);
+
+        bool m_allNodesOnCPU;
+        std::unordered_map<ComputationNodeBase*, size_t> m_nestedNodeIndex;
+        NodeDependencies m_forwardDependencies;
+        NodeDependencies m_backwardDependencies;
+        std::vector<std::vector<uint64_t>> m_forwardReachable;  // [i] -> bit set of the nested nodes that transitively depend on i; only if executed in parallel
+        std::vector<std::vector<uint64_t>> m_backwardReachable;
+        bool m_isForwardTimingDumped;
+        bool m_isBackwardTimingDumped;
     };
 
 public:
@@ -1245,9 +1328,14 @@ private:
     bool m_isCompiled; // CompileNetwork has been called
     bool m_areMatricesAllocated; // AllocateAllMatrices has been called
 
+    // elementwise fusion, see FuseElementwiseNodes()
+    bool m_fuseElementwiseNodes;
+    std::map<std::wstring, std::wstring, nocase_compare> m_fusedNodeNames; // [name of a fused-away node] -> name of the fused node
+
     // cached network iterations
     std::map<const ComputationNodeBasePtr, std::list<ComputationNodeBasePtr>> m_evalOrders; // [out node] flat depth-first traversal starting from out node
     std::map<const ComputationNodeBasePtr, ComputationNodeBasePtr> m_nestedNetworks;        // [out node] network rewritten as recursive traveral, potentially optimized; execution plan
+    std::map<std::vector<ComputationNodeBasePtr>, ComputationNodeBasePtr> m_nestedNetworksForNodes; // [sorted out nodes] execution plan computing all of them together
 
     // cached quick-access list for inputs and parameters
     std::map<const ComputationNodeBasePtr, std::list<ComputationNodeBasePtr>> m_inputValues;         // [out node] -> all input nodes feeding into out node
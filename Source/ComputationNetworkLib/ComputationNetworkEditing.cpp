@@ -108,6 +108,8 @@ void ComputationNetwork::CopyInputs(const std::wstring fromName, std::wstring to
 // nodeNameNew - new node name
 void ComputationNetwork::RenameNode(const std::wstring& nodeNameOrig, const std::wstring& newNodeName)
 {
+    InvalidateCompiledNetwork(); // (restores fused nodes, so that all nodes can be found by name)
+
     RenameNode(GetNodeFromName(nodeNameOrig), newNodeName);
 }
 
@@ -174,13 +176,13 @@ void ComputationNetwork::DeleteNode(const std::wstring& nodeName)
 // need to update all the mappings as well childrens.
 void ComputationNetwork::ReplaceNode(wstring nodeName, ComputationNodeBasePtr newNode)
 {
+    InvalidateCompiledNetwork(); // (restores fused nodes, so that all nodes can be found by name)
+
     ComputationNodeBasePtr oldNode = GetNodeFromName(nodeName);
 
     if (newNode->NodeName() != nodeName) // TODO: This was not tested for earlier; I hope no code depends on this.
         InvalidArgument("ChangeNode: newNode must have the same name as the old node.");
 
-    InvalidateCompiledNetwork();
-
     // change all nodes that have old node as input to point to the new node instead
     ChangeNodeInputs(oldNode, newNode);
 
@@ -211,9 +213,9 @@ void ComputationNetwork::InsertNode(wstring inputNodeName, ComputationNodeBasePt
 {
     newNode->Validate(false);
 
-    ComputationNodeBasePtr inputNode = GetNodeFromName(inputNodeName);
+    InvalidateCompiledNetwork(); // (restores fused nodes, so that all nodes can be found by name)
 
-    InvalidateCompiledNetwork();
+    ComputationNodeBasePtr inputNode = GetNodeFromName(inputNodeName);
 
     // change all nodes that have old node as input to point to the new node instead
     ChangeNodeInputs(inputNode, newNode);
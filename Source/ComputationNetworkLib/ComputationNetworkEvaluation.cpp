@@ -11,12 +11,16 @@
 #include "RecurrentNodes.h"
 #include "InputAndParamNodes.h"
 #include "LinearAlgebraNodes.h"
+#include "WorkStealingThreadPool.h"
+#include "PerformanceProfiler.h"
 #include <string>
 #include <vector>
 #include <list>
 #include <set>
 #include <algorithm>
 #include <map>
+#include <mutex>
+#include <condition_variable>
 
 using namespace std;
 
@@ -40,6 +44,8 @@ void ComputationNetwork::ForwardProp(const ComputationNodeBasePtr rootNode)
 {
     VerifyIsCompiled("ForwardProp");
 
+    ReserveMatricesForMinibatch();
+
     // traverse all nodes in the pre-determined evaluation order
     GetNestedNetwork(rootNode)->ForwardProp(FrameRange(nullptr));
 }
@@ -80,6 +86,22 @@ void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // trai
     GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
 }
 
+// grow the shared matrices of the pool ahead of time if this minibatch is larger than any seen before
+void ComputationNetwork::ReserveMatricesForMinibatch()
+{
+    if (!m_areMatricesAllocated || !m_pMBLayoutOfNetwork)
+        return;
+
+    if (m_matrixPool.ReserveForMinibatch(m_pMBLayoutOfNetwork->GetNumCols()) && TraceLevel() > 0)
+    {
+        const auto& statistics = m_matrixPool.GetStatistics();
+        fprintf(stderr, "MatrixPool: Reserved %d shared matrices for minibatches of up to %d samples, %.1f MB (peak %.1f MB, %.1f%% unused by this minibatch).\n",
+                (int)statistics.numBuffers, (int)statistics.reservedNumSamples,
+                statistics.reservedBytes / (1024.0 * 1024.0), statistics.peakReservedBytes / (1024.0 * 1024.0),
+                100.0 * statistics.GetFragmentation());
+    }
+}
+
 void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNode)
 {
     if (m_nestedNetworks.find(rootNode) != m_nestedNetworks.end())
@@ -95,6 +117,36 @@ ComputationNodeBasePtr ComputationNetwork::GetNestedNetwork(const ComputationNod
     return m_nestedNetworks[rootNode];
 }
 
+// The nodes are computed by one PAR traversal over the union of their eval orders. It is filtered from the global
+// eval order, which keeps the members of each loop consecutive.
+ComputationNodeBasePtr ComputationNetwork::GetNestedNetworkForNodes(vector<ComputationNodeBasePtr> nodes)
+{
+    sort(nodes.begin(), nodes.end());
+    nodes.erase(unique(nodes.begin(), nodes.end()), nodes.end());
+    if (nodes.size() == 1 && m_nestedNetworks.find(nodes.front()) != m_nestedNetworks.end())
+        return m_nestedNetworks[nodes.front()];
+
+    auto& nestedNetwork = m_nestedNetworksForNodes[nodes];
+    if (!nestedNetwork)
+    {
+        unordered_set<ComputationNodeBasePtr> nodesToCompute;
+        for (const auto& node : nodes)
+        {
+            const auto& evalOrder = GetEvalOrder(node);
+            nodesToCompute.insert(evalOrder.begin(), evalOrder.end());
+        }
+
+        list<ComputationNodeBasePtr> combinedEvalOrder;
+        for (const auto& node : GetEvalOrder(nullptr))
+        {
+            if (nodesToCompute.find(node) != nodesToCompute.end())
+                combinedEvalOrder.push_back(node);
+        }
+        nestedNetwork = make_shared<PARTraversalFlowControlNode>(m_allSEQNodes, combinedEvalOrder);
+    }
+    return nestedNetwork;
+}
+
 // -----------------------------------------------------------------------
 // PARTraversalFlowControlNode methods -- implements PAR traversal
 //
@@ -131,14 +183,56 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
             nodeIter++; // and consume this node
         }
     }
+
+    BuildDependencyGraphs();
 }
+// -----------------------------------------------------------------------
+// per-node profiling
+// -----------------------------------------------------------------------
+
+// Measures the forward or backward computation of a node for the performance profiler while in scope,
+// if per-node profiling is enabled (ComputationNetwork::SetNodeProfiling()).
+// Flow-control nodes have no environment and are not measured themselves; the nodes of SEQ loops are measured per time step.
+class ScopedNodeProfile
+{
+public:
+    ScopedNodeProfile(const ComputationNodeBasePtr& node, const FrameRange& fr, bool backward) :
+        m_node(node), m_backward(backward), m_enabled(node->HasEnvironmentPtr() && node->Environment().profileNodes), m_stateId(0)
+    {
+        if (!m_enabled)
+            return;
+        m_fr = fr;
+        m_stateId = ProfilerTimeBegin();
+    }
+
+    ~ScopedNodeProfile()
+    {
+        if (!m_enabled)
+            return;
+        ProfilerSyncGpu(); // attribute the asynchronously executed kernels to this node, if profilerSyncGpu is set
+        ProfilerNodeTimeEnd(m_stateId, m_node->NodeName().c_str(), m_node->OperationName().c_str(), m_backward,
+                            m_node->GetFlopEstimate(m_fr, m_backward), m_node->GetMemoryTrafficEstimate(m_fr, m_backward));
+    }
+
+private:
+    const ComputationNodeBasePtr& m_node;
+    FrameRange m_fr;
+    bool m_backward;
+    bool m_enabled;
+    long long m_stateId;
+};
+
 /*static*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const ComputationNodeBasePtr& node, const FrameRange& fr)
 {
     if (node->IsOutOfDateWrtInputs())
     {
-        node->BeginForwardProp();
-        node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
-        node->EndForwardProp();
+        {
+            FrameRange nodeFrameRange = fr.WithLayout(node->GetMBLayout());
+            ScopedNodeProfile profile(node, nodeFrameRange, /*backward=*/false);
+            node->BeginForwardProp();
+            node->ForwardProp(nodeFrameRange);
+            node->EndForwardProp();
+        }
 
         node->BumpEvalTimeStamp();
 
@@ -150,27 +244,311 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const FrameRange& fr) /*override*/
 {
+    if (ShouldExecuteInParallel())
+    {
+        ExecuteInParallel(m_forwardDependencies, [&fr](const ComputationNodeBasePtr& node) { ForwardProp(node, fr); }, "forward", m_isForwardTimingDumped);
+        return;
+    }
+
     for (auto& node : m_nestedNodes)
         ForwardProp(node, fr);
 }
 
+static void BackpropNode(const ComputationNodeBasePtr& node, const FrameRange& fr)
+{
+    {
+        FrameRange nodeFrameRange = fr.WithLayout(node->GetMBLayout());
+        ScopedNodeProfile profile(node, nodeFrameRange, /*backward=*/true);
+        node->BeginBackprop();
+        node->Backprop(nodeFrameRange, true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+        node->EndBackprop();
+    }
+
+    // Extreme Tracing, part 2/4
+    if (node->HasEnvironmentPtr() && node->Environment().ShouldDumpNode() && node->NeedsGradient())
+        DumpNode<float>(node, /*dumpGradient=*/true) || DumpNode<double>(node, true);
+
+    // all parents come later in evaluation order and have been processed, hence the gradient of this node is final
+    if (node->HasEnvironmentPtr() && node->Environment().gradientReadyCallback && node->NeedsGradient())
+        node->Environment().gradientReadyCallback(node);
+}
+
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) /*override*/
 {
     childrenInThisLoop, childrenInOuterLoop; // TODO: think through what these mean when coming from PAR mode
+    if (ShouldExecuteInParallel())
+    {
+        ExecuteInParallel(m_backwardDependencies, [&fr](const ComputationNodeBasePtr& node) { BackpropNode(node, fr); }, "backward", m_isBackwardTimingDumped);
+        return;
+    }
+
     // process nodes in pre-determined order
     for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
+        BackpropNode(*pnode, fr);
+}
+
+// -----------------------------------------------------------------------
+// parallel execution of independent nodes
+// -----------------------------------------------------------------------
+
+// The pool is sized when a pass starts, such that a change of Globals::SetNumNodeExecutionThreads() takes effect with the next pass.
+// A pass keeps the pool it runs on alive until it has completed.
+static shared_ptr<WorkStealingThreadPool> GetNodeExecutionThreadPool()
+{
+    static std::mutex poolMutex;
+    static shared_ptr<WorkStealingThreadPool> threadPool;
+
+    size_t numThreads = max<size_t>(Globals::GetNumNodeExecutionThreads(), 1);
+    lock_guard<std::mutex> lock(poolMutex);
+    if (!threadPool || threadPool->GetNumThreads() != numThreads)
+        threadPool = make_shared<WorkStealingThreadPool>(numThreads);
+    return threadPool;
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::BuildDependencyGraphs()
+{
+    m_isForwardTimingDumped = false;
+    m_isBackwardTimingDumped = false;
+
+    // map every node to the index of the nested node that executes it (a SEQ loop executes all of its members)
+    m_allNodesOnCPU = true;
+    m_nestedNodeIndex.clear();
+    vector<vector<ComputationNodeBasePtr>> members(m_nestedNodes.size());
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
     {
-        auto& node = *pnode;
+        const auto& node = m_nestedNodes[i];
+        if (node->Is<SEQTraversalFlowControlNode>())
+            members[i] = node->As<SEQTraversalFlowControlNode>()->m_nestedNodes;
+        else
+            members[i].push_back(node);
 
-        node->BeginBackprop();
-        node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
-        node->EndBackprop();
+        for (const auto& member : members[i])
+        {
+            m_nestedNodeIndex[member.get()] = i;
+            m_allNodesOnCPU &= (member->GetDeviceId() == CPUDEVICE);
+        }
+    }
 
-        // Extreme Tracing, part 2/4
-        if (node->HasEnvironmentPtr() && node->Environment().ShouldDumpNode() && node->NeedsGradient())
-            DumpNode<float>(node, /*dumpGradient=*/true) || DumpNode<double>(node, true);
+    // the loop itself is executed by its nested node, too
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+        m_nestedNodeIndex[m_nestedNodes[i].get()] = i;
+
+    // inputs[i] and parents[i] are the nested nodes node i reads from and is read by, respectively
+    vector<std::set<size_t>> inputs(m_nestedNodes.size());
+    vector<std::set<size_t>> parents(m_nestedNodes.size());
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+    {
+        for (const auto& member : members[i])
+        {
+            for (const auto& input : member->GetInputs())
+            {
+                auto iter = m_nestedNodeIndex.find(input.get());
+                if (iter == m_nestedNodeIndex.end() || iter->second == i)
+                    continue;
+                inputs[i].insert(iter->second);
+                parents[iter->second].insert(i);
+            }
+        }
+    }
+
+    vector<std::set<size_t>> forwardSuccessors(m_nestedNodes.size());
+    vector<std::set<size_t>> backwardSuccessors(m_nestedNodes.size());
+    for (size_t i = 0; i < m_nestedNodes.size(); i++)
+    {
+        for (auto input : inputs[i])
+        {
+            forwardSuccessors[input].insert(i);
+            backwardSuccessors[i].insert(input);
+        }
+
+        // parents accumulate into the gradient of node i, backprop them one after another in reverse evaluation order
+        for (auto parent = parents[i].rbegin(); parent != parents[i].rend(); parent++)
+        {
+            auto next = parent;
+            if (++next != parents[i].rend())
+                backwardSuccessors[*parent].insert(*next);
+        }
+    }
+
+    auto toDependencies = [](const vector<std::set<size_t>>& successors, NodeDependencies& dependencies)
+    {
+        dependencies.successors.assign(successors.size(), vector<size_t>());
+        dependencies.numPredecessors.assign(successors.size(), 0);
+        for (size_t i = 0; i < successors.size(); i++)
+        {
+            dependencies.successors[i].assign(successors[i].begin(), successors[i].end());
+            for (auto successor : successors[i])
+                dependencies.numPredecessors[successor]++;
+        }
+    };
+    toDependencies(forwardSuccessors, m_forwardDependencies);
+    toDependencies(backwardSuccessors, m_backwardDependencies);
+
+    m_forwardReachable.clear();
+    m_backwardReachable.clear();
+    if (ShouldExecuteInParallel())
+    {
+        ComputeReachability(m_forwardDependencies, m_forwardReachable);
+        ComputeReachability(m_backwardDependencies, m_backwardReachable);
     }
 }
+
+// transitive closure of the successor relation, by propagating it backwards along a topological order
+/*static*/ void ComputationNetwork::PARTraversalFlowControlNode::ComputeReachability(const NodeDependencies& dependencies, vector<vector<uint64_t>>& reachable)
+{
+    const size_t numNodes = dependencies.successors.size();
+    vector<size_t> numPendingPredecessors = dependencies.numPredecessors;
+    vector<size_t> order;
+    for (size_t i = 0; i < numNodes; i++)
+    {
+        if (numPendingPredecessors[i] == 0)
+            order.push_back(i);
+    }
+    for (size_t k = 0; k < order.size(); k++)
+    {
+        for (auto successor : dependencies.successors[order[k]])
+        {
+            if (--numPendingPredecessors[successor] == 0)
+                order.push_back(successor);
+        }
+    }
+    if (order.size() != numNodes)
+        LogicError("PARTraversalFlowControlNode: The node dependencies contain a cycle.");
+
+    // one bit per node
+    const size_t numWords = (numNodes + 63) / 64;
+    reachable.assign(numNodes, vector<uint64_t>(numWords, 0));
+    for (auto node = order.rbegin(); node != order.rend(); node++)
+    {
+        auto& nodeReachable = reachable[*node];
+        for (auto successor : dependencies.successors[*node])
+        {
+            nodeReachable[successor / 64] |= 1ull << (successor % 64);
+            const auto& successorReachable = reachable[successor];
+            for (size_t w = 0; w < numWords; w++)
+                nodeReachable[w] |= successorReachable[w];
+        }
+    }
+}
+
+// Only CPU networks are executed in parallel; on the GPU, the kernels of all nodes are serialized on one stream anyway.
+bool ComputationNetwork::PARTraversalFlowControlNode::ShouldExecuteInParallel() const
+{
+    return Globals::ShouldExecuteNodesInParallel() && m_allNodesOnCPU && m_nestedNodes.size() > 1;
+}
+
+size_t ComputationNetwork::PARTraversalFlowControlNode::FindNestedNodeIndex(const ComputationNodeBasePtr& node) const
+{
+    auto iter = m_nestedNodeIndex.find(node.get());
+    return iter == m_nestedNodeIndex.end() ? SIZE_MAX : iter->second;
+}
+
+bool ComputationNetwork::PARTraversalFlowControlNode::MayExecuteConcurrently(size_t i, size_t j, bool backward) const
+{
+    const auto& reachable = backward ? m_backwardReachable : m_forwardReachable;
+    if (i == j || reachable.empty()) // not executed in parallel
+        return false;
+    auto isReachable = [&reachable](size_t from, size_t to) { return (reachable[from][to / 64] >> (to % 64)) & 1; };
+    return !isReachable(i, j) && !isReachable(j, i);
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::ExecuteInParallel(const NodeDependencies& dependencies,
+                                                                        const std::function<void(const ComputationNodeBasePtr&)>& action,
+                                                                        const char* passName, bool& isTimingDumped)
+{
+    struct NodeTiming
+    {
+        int thread;
+        chrono::steady_clock::time_point start;
+        chrono::steady_clock::time_point end;
+    };
+
+    const size_t numNodes = m_nestedNodes.size();
+    vector<atomic<size_t>> numPendingPredecessors(numNodes);
+    for (size_t i = 0; i < numNodes; i++)
+        numPendingPredecessors[i] = dependencies.numPredecessors[i];
+    vector<NodeTiming> timings(numNodes);
+
+    atomic<size_t> numPendingNodes(numNodes);
+    atomic<bool> failed(false);
+    exception_ptr firstException;
+    std::mutex doneMutex;
+    condition_variable allDone;
+    bool isDone = false;
+
+    auto threadPoolPtr = GetNodeExecutionThreadPool();
+    auto& threadPool = *threadPoolPtr;
+    auto startTime = chrono::steady_clock::now();
+
+    function<void(size_t)> execute = [&](size_t i)
+    {
+        timings[i].thread = WorkStealingThreadPool::GetCurrentWorkerIndex();
+        timings[i].start = chrono::steady_clock::now();
+        if (!failed) // after a failure, the remaining nodes are only drained
+        {
+            try
+            {
+                action(m_nestedNodes[i]);
+            }
+            catch (...)
+            {
+                lock_guard<std::mutex> lock(doneMutex);
+                if (!failed.exchange(true))
+                    firstException = current_exception();
+            }
+        }
+        timings[i].end = chrono::steady_clock::now();
+
+        for (auto successor : dependencies.successors[i])
+        {
+            if (--numPendingPredecessors[successor] == 0)
+                threadPool.Submit([&execute, successor] { execute(successor); });
+        }
+
+        if (--numPendingNodes == 0)
+        {
+            lock_guard<std::mutex> lock(doneMutex);
+            isDone = true;
+            allDone.notify_all();
+        }
+    };
+
+    for (size_t i = 0; i < numNodes; i++)
+    {
+        if (dependencies.numPredecessors[i] == 0)
+            threadPool.Submit([&execute, i] { execute(i); });
+    }
+
+    {
+        unique_lock<std::mutex> lock(doneMutex);
+        allDone.wait(lock, [&isDone] { return isDone; });
+    }
+
+    if (firstException)
+        rethrow_exception(firstException);
+
+    // dump the schedule of the first pass, to verify the achieved parallelism
+    if (isTimingDumped)
+        return;
+    isTimingDumped = true;
+    auto anyNode = m_nestedNodes.back();
+    if (!anyNode->HasEnvironmentPtr() || anyNode->Environment().traceLevel <= 0)
+        return;
+
+    auto toMs = [startTime](chrono::steady_clock::time_point t) { return chrono::duration<double, milli>(t - startTime).count(); };
+    double wallTime = 0, nodeTime = 0;
+    for (const auto& timing : timings)
+    {
+        wallTime = max(wallTime, toMs(timing.end));
+        nodeTime += toMs(timing.end) - toMs(timing.start);
+    }
+    fprintf(stderr, "\nParallel %s pass over %d nodes on %d threads: %.3f ms elapsed, %.3f ms in nodes, average parallelism %.2f\n",
+            passName, (int)numNodes, (int)threadPool.GetNumThreads(), wallTime, nodeTime, wallTime > 0 ? nodeTime / wallTime : 0.0);
+    for (size_t i = 0; i < numNodes; i++)
+        fprintf(stderr, "\tthread %2d  start %9.3f ms  duration %9.3f ms  %ls %ls operation\n",
+                timings[i].thread, toMs(timings[i].start), toMs(timings[i].end) - toMs(timings[i].start),
+                m_nestedNodes[i]->NodeName().c_str(), m_nestedNodes[i]->OperationName().c_str());
+}
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
 {
 }
@@ -250,7 +628,10 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
     {
         for (auto& node : m_nestedNodes)
         {
-            node->ForwardProp(t);
+            {
+                ScopedNodeProfile profile(node, t, /*backward=*/false);
+                node->ForwardProp(t);
+            }
             node->BumpEvalTimeStamp();
         }
     }
@@ -290,6 +671,7 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
         for (auto nodeIter2 = recurrentNodes.rbegin(); nodeIter2 != recurrentNodes.rend(); ++nodeIter2)
         {
             auto& node2 = *nodeIter2;
+            ScopedNodeProfile profile(node2, t, /*backward=*/true);
             node2->Backprop(t, true /*childrenInThisLoop*/, false /*childrenInOuterLoop*/);
             // The above flags tell Backprop() to skip back-propagation from inside a node into
             // a node that is outside the loop, which is done later in EndBackprop() in PAR mode.
@@ -314,7 +696,9 @@ static bool DumpNode(ComputationNodeBasePtr nodep, bool dumpGradient)
     for (auto nodeIter2 = m_nestedNodes.rbegin(); nodeIter2 != m_nestedNodes.rend(); ++nodeIter2)
     {
         auto& node2 = *nodeIter2;
-        node2->Backprop(FrameRange(m_nestedNodes[0]->GetMBLayout()), false /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+        FrameRange fr(m_nestedNodes[0]->GetMBLayout());
+        ScopedNodeProfile profile(node2, fr, /*backward=*/true);
+        node2->Backprop(fr, false /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
     }
 
     // tell all nodes we are done for this iteraTion
@@ -425,12 +809,21 @@ void ComputationNetwork::PrintComputationTree(const ComputationNodeBasePtr& root
 
 // called by model editing operations, such as DeleteNode(); and by RebuildNetwork()
 // These invalidates any post-processed structures. If they are accessed, we will fail.
+// Fused elementwise nodes are replaced by their original nodes again, so that editing sees the network as it was created.
 void ComputationNetwork::InvalidateCompiledNetwork()
+{
+    ClearCompiledNetwork();
+    UnfuseElementwiseNodes();
+}
+
+// clear the post-processed structures, but keep the nodes as they are
+void ComputationNetwork::ClearCompiledNetwork()
 {
     m_isCompiled = false;
     m_allSEQNodes.clear();
     m_evalOrders.clear();
     m_nestedNetworks.clear();
+    m_nestedNetworksForNodes.clear();
     m_inputValues.clear();
     m_learnableParameters.clear();
 }
@@ -455,6 +848,27 @@ void ComputationNetwork::CompileNetwork()
     // Or just invalidate it again, which is easier and safer.
     InvalidateCompiledNetwork();
 
+    CompileNetworkStructure();
+
+    // STEP: Optimize the network.
+    // Fusion changes the graph, so all steps above are repeated for the fused network.
+    if (FuseElementwiseNodes() > 0)
+    {
+        ClearCompiledNetwork();
+        CompileNetworkStructure();
+    }
+
+    // STEP: Some final details.
+    ResetEvalTimeStamps(); // invalidate all m_value fields. Really belongs into StartEvaluateMinibatchLoop()
+
+    if (TraceLevel() > 0)
+    fprintf(stderr, "\nPost-processing network complete.\n\n");
+    m_isCompiled = true;
+}
+
+// the part of CompileNetwork() that determines the execution order and validates the network
+void ComputationNetwork::CompileNetworkStructure()
+{
     // all steps below have to be repeated for all root nodes (=nodes without parents and PreComputeNodes)
     DetermineSetOfAllRoots();
 
@@ -500,16 +914,6 @@ void ComputationNetwork::CompileNetwork()
 
     // STEP: Infer node dimensions.
     ValidateNetwork();
-
-    // STEP: Optimize the network.
-    // :)
-
-    // STEP: Some final details.
-    ResetEvalTimeStamps(); // invalidate all m_value fields. Really belongs into StartEvaluateMinibatchLoop()
-
-    if (TraceLevel() > 0)
-    fprintf(stderr, "\nPost-processing network complete.\n\n");
-    m_isCompiled = true;
 }
 
 // determine the set of all root nodes
@@ -1066,7 +1470,18 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
 
     m_matrixPool.ResetStepCounter();
 
-    TravserseInSortedGlobalEvalOrder(forwardPropRoots, [&outputValueNeededDuringBackProp, &parentsMap, this](const ComputationNodeBasePtr& node) {
+    // The sharing structure relies on the nodes being executed in the order simulated below, which does not hold if they are
+    // executed in parallel. Hence the matrix pool is told which node, in which pass, makes the requests (a task), and below,
+    // which of them may run concurrently.
+    vector<pair<ComputationNodeBasePtr, bool /*backward*/>> tasks;
+    auto beginTask = [&tasks, this](const ComputationNodeBasePtr& node, bool backward)
+    {
+        m_matrixPool.BeginTask((int)tasks.size());
+        tasks.push_back(make_pair(node, backward));
+    };
+
+    TravserseInSortedGlobalEvalOrder(forwardPropRoots, [&outputValueNeededDuringBackProp, &parentsMap, &beginTask, this](const ComputationNodeBasePtr& node) {
+        beginTask(node, /*backward=*/false);
         if (node->Is<SEQTraversalFlowControlNode>())
         {
             auto seqTraversalFlowControlNode = node->As<SEQTraversalFlowControlNode>();
@@ -1096,6 +1511,7 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         set<ComputationNodeBasePtr> completedGradient;
 
         // we need to call it here since we always compute gradients for children and root node is not children of other node
+        beginTask(trainRootNode, /*backward=*/true);
         trainRootNode->RequestMatricesBeforeBackprop(m_matrixPool);
 
         for (auto iter = backPropNodes.rbegin(); iter != backPropNodes.rend(); iter++) // for gradient computation, traverse in reverse order
@@ -1107,6 +1523,7 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
                 shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(m_allSEQNodes, n);
                 if (completedGradient.insert(recInfo).second)
                 {
+                    beginTask(recInfo, /*backward=*/true);
                     // SEQ mode: allocate all in loop first, then deallocate again
                     // TODO: next step: use PARTraversalFlowControlNode::AllocateGradientMatricesForInputs() and ReleaseMatricesAfterBackprop()...
                     // BUGBUG: naw, ^^ would not work! Wrong order! Need to rethink this. Need to make AllocateEvalMatrices() and AllocateGradientMatrices() the virtual functions.
@@ -1118,6 +1535,7 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
             else
             {
                 // PAR mode: we can allocate and immediately deallocate one by one
+                beginTask(n, /*backward=*/true);
                 n->AllocateGradientMatricesForInputs(m_matrixPool);
                 // Root node's information will be used and should not be shared with others, also it's small (1x1)
                 if ((n != trainRootNode) && n->NeedsGradient())
@@ -1126,12 +1544,57 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         }
     }
 
+    // Nodes may run concurrently if a nested network executed in parallel has them in the same pass, and neither depends on the other.
+    // The nested network of every root is checked, since it depends on the order of ForwardProp() calls which one computes a node.
+    // So is the forward pass over all the roots together (ForwardProp() of several nodes). It also stands for any subset of them,
+    // since whether one node depends on another is the same in every traversal that contains both.
+    struct ParallelNetworkTasks
+    {
+        shared_ptr<PARTraversalFlowControlNode> network;
+        bool forwardOnly;
+        vector<size_t> nestedNodeIndices; // [task] -> index of the nested node executing the task, or SIZE_MAX
+    };
+    vector<ParallelNetworkTasks> parallelNetworks;
+    auto addParallelNetwork = [&tasks, &parallelNetworks](const ComputationNodeBasePtr& nestedNetwork, bool forwardOnly)
+    {
+        auto network = dynamic_pointer_cast<PARTraversalFlowControlNode>(nestedNetwork);
+        if (!network || !network->ShouldExecuteInParallel())
+            return;
+        ParallelNetworkTasks networkTasks{ network, forwardOnly, vector<size_t>(tasks.size()) };
+        for (size_t task = 0; task < tasks.size(); task++)
+            networkTasks.nestedNodeIndices[task] = network->FindNestedNodeIndex(tasks[task].first);
+        parallelNetworks.push_back(move(networkTasks));
+    };
+    for (const auto& keyValue : m_nestedNetworks)
+        addParallelNetwork(keyValue.second, /*forwardOnly=*/false);
+    if (forwardPropRoots.size() > 1)
+        addParallelNetwork(GetNestedNetworkForNodes(forwardPropRoots), /*forwardOnly=*/true);
+    if (!parallelNetworks.empty())
+    {
+        m_matrixPool.SetConcurrency([&tasks, &parallelNetworks](int task1, int task2)
+        {
+            bool backward = tasks[task1].second;
+            if (tasks[task2].second != backward) // the backward pass starts after the forward pass has completed
+                return false;
+            for (const auto& networkTasks : parallelNetworks)
+            {
+                if (backward && networkTasks.forwardOnly)
+                    continue;
+                size_t i = networkTasks.nestedNodeIndices[task1];
+                size_t j = networkTasks.nestedNodeIndices[task2];
+                if (i != SIZE_MAX && j != SIZE_MAX && networkTasks.network->MayExecuteConcurrently(i, j, backward))
+                    return true;
+            }
+            return false;
+        });
+    }
+
     m_matrixPool.OptimizedMemoryAllocation(); 
+    m_matrixPool.SetConcurrency(nullptr);
     m_areMatricesAllocated = true;
 
-    // TO DO: At the time of AllocateAllMatrices we don't know the minibatch size. In theory one may allocate memory again once we start to receive
-    // data from the reader (and the minibatch size is known). For some problems, minibatch size can change constantly, and there needs to be a 
-    // tradeoff in deciding how frequent to run optimized memory allocation. For now, we do it only once at the very beginning for speed concerns. 
+    // At the time of AllocateAllMatrices we don't know the minibatch size. The sharing structure is therefore decided once here,
+    // while the memory behind the shared matrices is reserved by ReserveMatricesForMinibatch() once the minibatch size is known.
 
     // TO DO: when some matrices are sparse, the memory size request may be wrong. One may need to call OptimizedMemoryAllocation later again 
     // if the requests of sparse allocation and release are re-processed correctly. Future work. 
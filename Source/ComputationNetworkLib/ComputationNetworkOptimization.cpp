@@ -0,0 +1,271 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+
+#include "Basics.h"
+#include "Globals.h"
+#include "ComputationNode.h"
+#include "ComputationNetwork.h"
+#include "FusedElementwiseNodes.h"
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <algorithm>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// elementwise fusion
+// -----------------------------------------------------------------------
+
+// Elementwise nodes (Plus, ElementTimes, Sigmoid, ...) whose values are only used by other elementwise nodes form trees
+// that can be computed in a single pass over the elements, without writing the intermediate values to memory.
+// FuseElementwiseNodes() replaces each such tree by a FusedElementwiseNode, which takes over the name of the tree's
+// output node and its place in the node groups. The other nodes of the tree are removed from the network; they are
+// restored by UnfuseElementwiseNodes(), which InvalidateCompiledNetwork() calls before the network is modified.
+
+// get the operation of a node that can be fused, or return false
+static bool TryGetFusibleOperation(const ComputationNodeBasePtr& node, FusedElementwiseOp& op)
+{
+    size_t numOperands;
+    return TryGetFusedElementwiseOp(node->OperationName(), op, numOperands) &&
+           node->GetNumInputs() == numOperands &&
+           node->GetDeviceId() == CPUDEVICE &&
+           (node->Is<ComputationNode<float>>() || node->Is<ComputationNode<double>>());
+}
+
+// whether two sample shapes are the same except for trailing singleton dimensions
+static bool AreShapesCompatible(const TensorShape& a, const TensorShape& b)
+{
+    size_t rank = max(a.GetRank(), b.GetRank());
+    return a.PadRank(rank) == b.PadRank(rank);
+}
+
+// whether the value of 'input' can be read by a FusedElementwiseNode whose output is shaped like 'output'
+// (same shape and layout; no layout, broadcast over the columns; or a scalar)
+// Sparse inputs (e.g. one-hot labels) would be converted to dense by the fused node, so they are better left to the original nodes.
+static bool CanBeFusedInput(const ComputationNodeBasePtr& input, const ComputationNodeBasePtr& output)
+{
+    auto value = input->ValuePtr(); // (not yet allocated for nodes that are not leaves)
+    if ((value && value->GetMatrixType() != MatrixType::DENSE) || input->GetDeviceId() != CPUDEVICE)
+        return false;
+    if (input->HasMBLayout())
+        return input->GetMBLayout() == output->GetMBLayout() && AreShapesCompatible(input->GetSampleLayout(), output->GetSampleLayout());
+    return AreShapesCompatible(input->GetSampleLayout(), output->GetSampleLayout()) || input->GetSampleLayout().GetNumElements() == 1;
+}
+
+template <class ElemType>
+static ComputationNodeBasePtr CreateFusedElementwiseNode(DEVICEID_TYPE deviceId, const wstring& name, const vector<FusedElementwiseInstruction>& program, const vector<ComputationNodeBasePtr>& originalNodes)
+{
+    return New<FusedElementwiseNode<ElemType>>(deviceId, name, program, originalNodes);
+}
+
+// Replace trees of elementwise nodes by FusedElementwiseNodes. Called by CompileNetwork() after validation.
+// Returns the number of fused nodes that were created.
+size_t ComputationNetwork::FuseElementwiseNodes()
+{
+    if (!m_fuseElementwiseNodes || !Globals::ShouldFuseElementwiseOperations() || m_deviceId != CPUDEVICE)
+        return 0;
+
+    const auto& evalOrder = GetEvalOrder(nullptr);
+
+    // nodes that are accessed from outside must remain in the network
+    set<ComputationNodeBasePtr> visibleNodes(m_allRoots.begin(), m_allRoots.end());
+    for (auto groupIter : GetAllNodeGroups())
+        visibleNodes.insert(groupIter->begin(), groupIter->end());
+
+    map<ComputationNodeBasePtr, set<ComputationNodeBasePtr>> consumers;
+    map<ComputationNodeBasePtr, size_t> evalOrderIndex;
+    for (const auto& node : evalOrder)
+    {
+        size_t index = evalOrderIndex.size();
+        evalOrderIndex[node] = index;
+        for (const auto& input : node->GetInputs())
+            consumers[input].insert(node);
+    }
+
+    // a node is a candidate if all of its inputs can be read by the fused node, in case they are not fused as well
+    auto isCandidate = [&](const ComputationNodeBasePtr& node, const ComputationNodeBasePtr& output)
+    {
+        FusedElementwiseOp op;
+        if (node->GetEnvironmentPtr() != m_environment || !TryGetFusibleOperation(node, op))
+            return false;
+        for (const auto& input : node->GetInputs())
+        {
+            if (!CanBeFusedInput(input, output))
+                return false;
+        }
+        return true;
+    };
+
+    // STEP: Form the groups, starting from the last node of the evaluation order, which is the output of a group.
+    // A group grows towards its inputs by nodes that are used by a single node of the group only.
+    vector<vector<ComputationNodeBasePtr>> groups;
+    vector<vector<ComputationNodeBasePtr>> groupInputs;
+    set<ComputationNodeBasePtr> fusedNodes;
+    for (auto iter = evalOrder.rbegin(); iter != evalOrder.rend(); ++iter)
+    {
+        const auto& output = *iter;
+        if (fusedNodes.find(output) != fusedNodes.end() || !isCandidate(output, output))
+            continue;
+        auto loop = FindInRecurrentLoops(m_allSEQNodes, output);
+
+        // collect the inputs of the members that are not members themselves
+        auto getInputs = [&](const vector<ComputationNodeBasePtr>& members)
+        {
+            vector<ComputationNodeBasePtr> inputs;
+            for (const auto& member : members)
+            {
+                for (const auto& input : member->GetInputs())
+                {
+                    if (find(members.begin(), members.end(), input) == members.end() && find(inputs.begin(), inputs.end(), input) == inputs.end())
+                        inputs.push_back(input);
+                }
+            }
+            return inputs;
+        };
+
+        vector<ComputationNodeBasePtr> members{ output };
+        vector<ComputationNodeBasePtr> workList{ output };
+        while (!workList.empty() && members.size() < FusedElementwiseNodeBase::s_maxInstructions)
+        {
+            auto member = workList.back();
+            workList.pop_back();
+            for (const auto& input : member->GetInputs())
+            {
+                if (members.size() >= FusedElementwiseNodeBase::s_maxInstructions)
+                    break;
+                if (find(members.begin(), members.end(), input) != members.end() || fusedNodes.find(input) != fusedNodes.end() || visibleNodes.find(input) != visibleNodes.end() ||
+                    consumers[input].size() != 1 || input->GetMBLayout() != output->GetMBLayout() || input->GetSampleLayout() != output->GetSampleLayout() ||
+                    input->Is<ComputationNode<float>>() != output->Is<ComputationNode<float>>() || FindInRecurrentLoops(m_allSEQNodes, input) != loop ||
+                    !isCandidate(input, output))
+                    continue;
+
+                members.push_back(input);
+                if (getInputs(members).size() > FusedElementwiseNodeBase::s_maxInputs)
+                    members.pop_back();
+                else
+                    workList.push_back(input);
+            }
+        }
+        if (members.size() < 2)
+            continue;
+
+        vector<ComputationNodeBasePtr> group = move(members);
+        sort(group.begin(), group.end(), [&](const ComputationNodeBasePtr& a, const ComputationNodeBasePtr& b) { return evalOrderIndex[a] < evalOrderIndex[b]; });
+        auto inputs = getInputs(group);
+        fusedNodes.insert(group.begin(), group.end());
+        groups.push_back(move(group));
+        groupInputs.push_back(move(inputs));
+    }
+
+    if (groups.empty())
+        return 0;
+
+    // STEP: Replace each group by a fused node.
+    map<ComputationNodeBasePtr, ComputationNodeBasePtr> replacements; // [output node of a group] -> fused node
+    size_t numFusedNodes = 0;
+    for (size_t i = 0; i < groups.size(); i++)
+    {
+        const auto& group = groups[i];
+        const auto& inputs = groupInputs[i];
+        const auto& output = group.back();
+
+        vector<FusedElementwiseInstruction> program;
+        for (const auto& member : group)
+        {
+            FusedElementwiseInstruction instruction;
+            TryGetFusibleOperation(member, instruction.op);
+            for (size_t j = 0; j < 2; j++)
+            {
+                const auto& operand = member->GetInputs()[min(j, member->GetNumInputs() - 1)];
+                auto memberIter = find(group.begin(), group.end(), operand);
+                if (memberIter != group.end())
+                    instruction.operands[j] = inputs.size() + (memberIter - group.begin());
+                else
+                    instruction.operands[j] = find(inputs.begin(), inputs.end(), operand) - inputs.begin();
+            }
+            program.push_back(instruction);
+        }
+
+        vector<ComputationNodeBasePtr> fusedInputs;
+        for (const auto& input : inputs)
+        {
+            auto replacement = replacements.find(input);
+            fusedInputs.push_back(replacement != replacements.end() ? replacement->second : input);
+        }
+
+        auto fusedNode = output->Is<ComputationNode<float>>() ? CreateFusedElementwiseNode<float>(m_deviceId, output->NodeName(), program, group)
+                                                              : CreateFusedElementwiseNode<double>(m_deviceId, output->NodeName(), program, group);
+        fusedNode->AttachInputs(fusedInputs);
+
+        // the original nodes are taken out of the network, but keep their inputs, so that they can be put back
+        for (const auto& member : group)
+        {
+            RemoveNodeFromNet(member);
+            if (member != output)
+                m_fusedNodeNames[member->NodeName()] = output->NodeName();
+        }
+        AddNodeToNet(fusedNode);
+        ChangeNodeInputs(output, fusedNode);
+        ReplaceInNodeGroups(output, fusedNode);
+        replacements[output] = fusedNode;
+        numFusedNodes += group.size();
+
+        if (TraceLevel() > 0)
+        {
+            fprintf(stderr, "FuseElementwiseNodes: %ls = FusedElementwise() replaces", output->NodeName().c_str());
+            for (const auto& member : group)
+                fprintf(stderr, " %ls = %ls()%s", member->NodeName().c_str(), member->OperationName().c_str(), member == output ? ".\n" : ",");
+        }
+    }
+
+    fprintf(stderr, "FuseElementwiseNodes: Fused %d elementwise nodes into %d nodes, which eliminates %d intermediate values.\n",
+            (int)numFusedNodes, (int)groups.size(), (int)(numFusedNodes - groups.size()));
+    return groups.size();
+}
+
+// Put the original nodes of all FusedElementwiseNodes back into the network.
+void ComputationNetwork::UnfuseElementwiseNodes()
+{
+    if (m_fusedNodeNames.empty())
+        return;
+
+    vector<ComputationNodeBasePtr> fusedNodes;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        if (dynamic_pointer_cast<FusedElementwiseNodeBase>(iter.second))
+            fusedNodes.push_back(iter.second);
+    }
+
+    for (const auto& fusedNode : fusedNodes)
+    {
+        const auto& originalNodes = dynamic_pointer_cast<FusedElementwiseNodeBase>(fusedNode)->GetOriginalNodes();
+        const auto& output = originalNodes.back();
+
+        RemoveNodeFromNet(fusedNode);
+        for (const auto& node : originalNodes)
+            AddNodeToNet(node);
+        ChangeNodeInputs(fusedNode, output);
+        ReplaceInNodeGroups(fusedNode, output);
+        fusedNode->DetachInputs();
+    }
+    m_fusedNodeNames.clear();
+}
+
+// replace a node in all node groups, including the cached criterion nodes
+void ComputationNetwork::ReplaceInNodeGroups(const ComputationNodeBasePtr& oldNode, const ComputationNodeBasePtr& newNode)
+{
+    for (auto groupIter : GetAllNodeGroups())
+        replace(groupIter->begin(), groupIter->end(), oldNode, newNode);
+    for (auto& iter : m_namedCriterionNodes)
+        replace(iter.second.begin(), iter.second.end(), oldNode, newNode);
+}
+
+}}}
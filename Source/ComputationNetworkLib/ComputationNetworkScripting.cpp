@@ -249,6 +249,7 @@ public:
         wstring pathName = config[L"pathName"];
         if (TraceLevel() > 0)
             fprintf(stderr, "Load: Loading model file: %ls", pathName.c_str());
+        SetElementwiseFusion(false); // the nodes of a loaded model are accessed by name, e.g. to clone or edit them
         Load<ElemType>(pathName); // note that for CNTK_MODEL_VERSION_7 and above, 'ElemType' is ignored
     }
 };
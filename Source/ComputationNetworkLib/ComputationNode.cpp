@@ -703,6 +703,32 @@ template <class ElemType>
     }
 }
 
+template <class ElemType>
+/*virtual*/ double ComputationNode<ElemType>::GetFlopEstimate(const FrameRange& fr, bool backward) const
+{
+    double numOutputElements = (double)GetSampleMatrixNumRows() * GetNumColsInFrameRange(fr);
+    if (!backward)
+        return numOutputElements;
+
+    size_t numInputGradients = 0;
+    for (const auto& input : GetInputs())
+        numInputGradients += input->NeedsGradient() ? 1 : 0;
+    return numOutputElements * numInputGradients;
+}
+
+template <class ElemType>
+/*virtual*/ double ComputationNode<ElemType>::GetMemoryTrafficEstimate(const FrameRange& fr, bool backward) const
+{
+    double numOutputElements = (double)GetSampleMatrixNumRows() * GetNumColsInFrameRange(fr);
+    double numElements = backward ? 2 * numOutputElements : numOutputElements;
+    for (const auto& input : GetInputs())
+    {
+        double numInputElements = (double)input->GetSampleMatrixNumRows() * input->GetNumColsInFrameRange(fr);
+        numElements += (backward && input->NeedsGradient()) ? 3 * numInputElements : numInputElements;
+    }
+    return numElements * sizeof(ElemType);
+}
+
 template <class ElemType>
 /*virtual*/ void ComputationNode<ElemType>::DumpNodeInfo(const bool /*printValues*/, const bool printMetadata, File& fstream) const
 {
@@ -765,6 +765,27 @@ public:
         return false;
     }
 
+    // -----------------------------------------------------------------------
+    // profiling
+    // -----------------------------------------------------------------------
+
+    // Estimates of the floating-point operations and of the bytes read and written by one
+    // ForwardProp() call on the frame range, or one Backprop() call if 'backward'.
+    // These are only used for the per-node profile (ComputationNetwork::SetNodeProfiling()).
+    virtual double GetFlopEstimate(const FrameRange& /*fr*/, bool /*backward*/) const { return 0; }
+    virtual double GetMemoryTrafficEstimate(const FrameRange& /*fr*/, bool /*backward*/) const { return 0; }
+
+    // number of matrix columns a ForwardProp() or Backprop() call on the frame range operates on
+    size_t GetNumColsInFrameRange(const FrameRange& fr) const
+    {
+        if (!HasMBLayout())
+            return GetSampleMatrixNumCols();
+        else if (fr.IsAllFrames())
+            return GetMBLayout()->GetNumCols();
+        else
+            return fr.m_timeRange * ((fr.seqIndex == SIZE_MAX) ? GetNumParallelSequences() : 1);
+    }
+
     // reset gradients of a node's inputs
     // This really only clears the lazy-init flags (LazyZeroGradient() actually clears the values lazily).
     void /*ComputationNodeBase::*/ ZeroGradientsOfInputs()
@@ -1845,6 +1866,15 @@ protected:
     }
 
 public:
+    // -----------------------------------------------------------------------
+    // profiling
+    // -----------------------------------------------------------------------
+
+    // Defaults for elementwise operations: one operation per output element (per input gradient in backward),
+    // reading all inputs and writing the output once (in backward also reading the output gradient and updating the input gradients).
+    virtual double GetFlopEstimate(const FrameRange& fr, bool backward) const override;
+    virtual double GetMemoryTrafficEstimate(const FrameRange& fr, bool backward) const override;
+
     // -----------------------------------------------------------------------
     // miscellaneous
     // -----------------------------------------------------------------------
@@ -2259,6 +2289,7 @@ protected:
     using Base::GetInputsFromConfig;                                                                                                                     \
     using Base::GetMBLayout;                                                                                                                             \
     using Base::GetMBLayoutAxisString;                                                                                                                   \
+    using Base::GetNumColsInFrameRange;                                                                                                                  \
     using Base::GetNumInputs;                                                                                                                            \
     using Base::GetNumParallelSequences;                                                                                                                 \
     using Base::GetNumTimeSteps;                                                                                                                         \
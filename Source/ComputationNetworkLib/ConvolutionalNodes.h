@@ -423,6 +423,15 @@ public:
         }
     }
 
+    double GetFlopEstimate(const FrameRange& fr, bool backward) const override
+    {
+        // one multiply-add per kernel element for every element on the convolved side
+        double numElements = m_transpose ? (double)Input(1)->GetSampleMatrixNumRows() * Input(1)->GetNumColsInFrameRange(fr)
+                                         : (double)GetSampleMatrixNumRows() * GetNumColsInFrameRange(fr);
+        double numConvolutions = backward ? (double)(Input(0)->NeedsGradient() + Input(1)->NeedsGradient()) : 1;
+        return 2 * numElements * m_kernelShape.GetNumElements() * numConvolutions;
+    }
+
     void Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
@@ -546,9 +555,12 @@ public:
                 auto geometry = std::make_shared<ConvolveGeometry>(!m_transpose ? inputShape : outputShape,
                                                                    m_kernelShape, m_mapCount, m_stride, 
                                                                    m_sharing, m_autoPad, m_lowerPad, m_upperPad);
+                auto enabledEngines = ConvolutionEngineKind::All;
+                if (Globals::ShouldUseWinogradConvolution())
+                    enabledEngines = (ConvolutionEngineKind)((int)enabledEngines | (int)ConvolutionEngineKind::Winograd);
                 m_convEng = ConvolutionEngine<ElemType>::Create(geometry, m_deviceId, m_imageLayout,
                                                                 m_maxTempMemSizeInSamples, m_poolKind,
-                                                                ConvolutionEngineKind::All, NodeName(), Globals::ShouldForceDeterministicAlgorithms());
+                                                                enabledEngines, NodeName(), Globals::ShouldForceDeterministicAlgorithms());
             }
 
             if (Input(0)->GetSampleLayout().GetNumElements() != m_kernelShape.GetNumElements() * m_convEng->Geometry()->KernelCount())
@@ -0,0 +1,641 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include "Matrix.h"
+#include "TensorOps.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// FusedElementwiseNode (inputs...) -- a tree of elementwise operations
+// (Plus, Minus, ElementTimes, LogPlus, Sigmoid, Tanh, ...) evaluated in a single pass.
+//
+// These nodes are not created by users; ComputationNetwork::FuseElementwiseNodes() replaces
+// chains of elementwise nodes by them when compiling the network (see ComputationNetworkOptimization.cpp).
+// The value of each element is computed from the inputs in one go, so that the intermediate
+// results never go to memory; the gradients of all inputs are computed the same way, in one pass that
+// recomputes the cheap intermediate values. When training, the results of the costly operations (Exp,
+// Sigmoid, ...) are kept instead. The node keeps the nodes it replaces, which are restored when the
+// network is saved or modified.
+//
+// The inputs either have the shape and layout of the output, or no MBLayout, in which case they are
+// broadcast over all columns (e.g. a bias), or they are a scalar. This is CPU only; the values and gradients
+// are dense, except for inputs, which are read from a dense copy if needed.
+// -----------------------------------------------------------------------
+
+enum class FusedElementwiseOp
+{
+    Plus,
+    Minus,
+    ElementTimes,
+    LogPlus,
+    Abs,
+    Cosine,
+    Exp,
+    ExponentialLinearUnit,
+    Log,
+    Negate,
+    Pass,
+    Reciprocal,
+    RectifiedLinear,
+    Sigmoid,
+    Sin,
+    Sqrt,
+    Tanh
+};
+
+// One operation of the fused expression. An operand refers to an input of the node (0..numInputs-1),
+// or to the result of an earlier instruction (numInputs + index of the instruction).
+struct FusedElementwiseInstruction
+{
+    FusedElementwiseOp op;
+    size_t operands[2];
+};
+
+// determine the operation and its number of operands for a node that can be fused, given its operation name
+static inline bool TryGetFusedElementwiseOp(const std::wstring& operationName, FusedElementwiseOp& op, size_t& numOperands)
+{
+    static const struct { const wchar_t* name; FusedElementwiseOp op; size_t numOperands; } ops[] =
+    {
+        { L"Plus",                  FusedElementwiseOp::Plus,                  2 },
+        { L"Minus",                 FusedElementwiseOp::Minus,                 2 },
+        { L"ElementTimes",          FusedElementwiseOp::ElementTimes,          2 },
+        { L"LogPlus",               FusedElementwiseOp::LogPlus,               2 },
+        { L"Abs",                   FusedElementwiseOp::Abs,                   1 },
+        { L"Cosine",                FusedElementwiseOp::Cosine,                1 },
+        { L"Exp",                   FusedElementwiseOp::Exp,                   1 },
+        { L"ExponentialLinearUnit", FusedElementwiseOp::ExponentialLinearUnit, 1 },
+        { L"Log",                   FusedElementwiseOp::Log,                   1 },
+        { L"Negate",                FusedElementwiseOp::Negate,                1 },
+        { L"Pass",                  FusedElementwiseOp::Pass,                  1 },
+        { L"Reciprocal",            FusedElementwiseOp::Reciprocal,            1 },
+        { L"RectifiedLinear",       FusedElementwiseOp::RectifiedLinear,       1 },
+        { L"Sigmoid",               FusedElementwiseOp::Sigmoid,               1 },
+        { L"Sin",                   FusedElementwiseOp::Sin,                   1 },
+        { L"Sqrt",                  FusedElementwiseOp::Sqrt,                  1 },
+        { L"Tanh",                  FusedElementwiseOp::Tanh,                  1 },
+    };
+    for (const auto& entry : ops)
+    {
+        if (operationName == entry.name)
+        {
+            op = entry.op;
+            numOperands = entry.numOperands;
+            return true;
+        }
+    }
+    return false;
+}
+
+// part of FusedElementwiseNode that does not depend on the element type, used by ComputationNetwork
+class FusedElementwiseNodeBase
+{
+public:
+    // limits of a fused expression, which keep the intermediate values of a block on the stack
+    static const size_t s_maxInstructions = 32;
+    static const size_t s_maxInputs = 16;
+
+    // the nodes replaced by this node, in evaluation order; the last one is the output, whose name this node has taken over
+    const std::vector<ComputationNodeBasePtr>& GetOriginalNodes() const { return m_originalNodes; }
+
+protected:
+    std::vector<ComputationNodeBasePtr> m_originalNodes;
+};
+
+template <class ElemType>
+class FusedElementwiseNode : public ComputationNode<ElemType>, public FusedElementwiseNodeBase
+{
+    typedef ComputationNode<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"FusedElementwise"; }
+
+    // number of elements an instruction is applied to at a time
+    static const size_t s_blockSize = 64;
+    // below this number of elements, a product is computed on a single thread
+    static const size_t s_minElementsForParallelism = 16384;
+
+    // how an input maps to the elements of the output
+    enum class InputKind
+    {
+        Full,   // same shape and layout as the output
+        Column, // one sample broadcast over all columns of the output
+        Scalar  // a single value
+    };
+
+public:
+    FusedElementwiseNode(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name)
+    {
+    }
+    FusedElementwiseNode(DEVICEID_TYPE deviceId, const wstring& name, const std::vector<FusedElementwiseInstruction>& program, const std::vector<ComputationNodeBasePtr>& originalNodes)
+        : Base(deviceId, name), m_program(program)
+    {
+        m_originalNodes = originalNodes;
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<FusedElementwiseNode<ElemType>>(nodeP);
+            node->m_program = m_program;
+            node->m_originalNodes = m_originalNodes;
+        }
+    }
+
+    const std::vector<FusedElementwiseInstruction>& GetProgram() const { return m_program; }
+
+    virtual void /*IComputationNode::*/ BeginForwardProp() override
+    {
+        Base::BeginForwardProp();
+        Value().SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, false);
+    }
+
+    // When training, the results of the costly operations (Exp, Sigmoid, ...) are kept for the gradient computation,
+    // like the unfused nodes keep their values; the others are recomputed.
+    virtual void /*ComputationNode::*/ UpdateFunctionMBSize() override
+    {
+        Base::UpdateFunctionMBSize();
+        m_hasSavedValues = m_savedValues && GetNumSavedValues() > 0 && Base::NeedsGradient() && Base::HasEnvironmentPtr() && Environment().IsTraining();
+        if (m_hasSavedValues)
+            m_savedValues->Resize(GetNumSavedValues() * GetSampleMatrixNumRows(), Value().GetNumCols());
+    }
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
+    {
+        size_t numElements;
+        ElemType* output = DataFor(Value(), GetMBLayout(), fr, numElements);
+        Layout layout = GetLayout(fr, numElements, /*gradientTargets=*/ {});
+
+        ForEachBlock(layout, [&](size_t column, size_t firstRow, size_t length, const ElemType* const* operands)
+        {
+            ElemType values[s_maxInstructions][s_blockSize];
+            const ElemType* results[s_maxInstructions];
+            Evaluate(operands, length, values, results, output + column * layout.rows + firstRow, layout.SavedValuesFor(column, firstRow), layout.rows, /*restore=*/ false);
+        });
+    }
+
+    // Each pass over the elements recomputes the whole expression, so the gradients of all inputs that the network
+    // backpropagates into for this frame range are computed together, when the first of them is requested.
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
+    {
+        std::vector<size_t> targets = GetGradientTargets(inputIndex);
+        if (targets.front() != inputIndex)
+            return; // computed together with an earlier input
+        for (size_t i : targets)
+        {
+            if (i != inputIndex)
+                InputRef(i).LazyZeroGradient(); // (the network zeroes the gradient of an input only right before backpropagating into it)
+        }
+
+        size_t numElements, numTargetElements;
+        const ElemType* outputGradient = DataFor(Gradient(), GetMBLayout(), fr, numElements);
+        Layout layout = GetLayout(fr, numElements, targets);
+        std::vector<ElemType*> targetData;
+        std::vector<char> overwriteTarget; // whether the gradient is assigned rather than added to (see ImplementsGradientOverwriteOptimization())
+        bool hasFullTargets = false;
+        bool hasColumnTargets = false;
+        for (size_t i : targets)
+        {
+            targetData.push_back(DataFor(InputRef(i).Gradient(), InputRef(i).GetMBLayout(), fr, numTargetElements));
+            overwriteTarget.push_back(InputRef(i).ParentOverwritesGradient());
+            hasFullTargets   |= layout.inputKinds[i] == InputKind::Full;
+            hasColumnTargets |= layout.inputKinds[i] == InputKind::Column;
+        }
+
+        // The blocks are split into contiguous ranges, which are processed in parallel. Gradients that are reduced over the columns
+        // are summed per range first, and then over the ranges, in an order that does not depend on the number of threads.
+        size_t numTasks = std::max<size_t>(std::min(layout.numBlocks, layout.rows * layout.columns / s_minElementsForParallelism), 1);
+        size_t blocksPerColumn = (layout.rows + s_blockSize - 1) / s_blockSize;
+        std::vector<ElemType> columnSums(hasColumnTargets ? numTasks * targets.size() * layout.rows : 0, 0);
+        std::vector<double> scalarSums(numTasks * targets.size(), 0);
+#pragma omp parallel for if (numTasks > 1)
+        for (long long task = 0; task < (long long)numTasks; task++)
+        {
+            ElemType values[s_maxInstructions][s_blockSize];
+            const ElemType* results[s_maxInstructions];
+            ElemType adjoints[s_maxInputs + s_maxInstructions][s_blockSize];
+            const ElemType* operands[s_maxInputs];
+            size_t endBlock = layout.numBlocks * (task + 1) / numTasks;
+            for (size_t block = layout.numBlocks * task / numTasks; block < endBlock; block++)
+            {
+                size_t column = block / blocksPerColumn;
+                size_t firstRow = (block % blocksPerColumn) * s_blockSize;
+                size_t length = std::min(s_blockSize, layout.rows - firstRow);
+                bool isGap = layout.IsGap(column); // gaps do not contribute to reduced gradients
+                if (isGap && !hasFullTargets)
+                    continue;
+                GetOperands(layout, column, firstRow, operands);
+                Evaluate(operands, length, values, results, nullptr, layout.SavedValuesFor(column, firstRow), layout.rows, /*restore=*/ true);
+                Backpropagate(operands, length, results, outputGradient + column * layout.rows + firstRow, adjoints);
+
+                for (size_t k = 0; k < targets.size(); k++)
+                {
+                    const ElemType* adjoint = adjoints[targets[k]];
+                    switch (layout.inputKinds[targets[k]])
+                    {
+                    case InputKind::Full:
+                    {
+                        ElemType* target = targetData[k] + column * layout.rows + firstRow;
+                        if (overwriteTarget[k])
+                            std::copy(adjoint, adjoint + length, target);
+                        else
+                        {
+                            for (size_t t = 0; t < length; t++)
+                                target[t] += adjoint[t];
+                        }
+                        break;
+                    }
+                    case InputKind::Column:
+                        if (!isGap)
+                        {
+                            ElemType* sum = columnSums.data() + (task * targets.size() + k) * layout.rows + firstRow;
+                            for (size_t t = 0; t < length; t++)
+                                sum[t] += adjoint[t];
+                        }
+                        break;
+                    case InputKind::Scalar:
+                        if (!isGap)
+                        {
+                            double sum = 0;
+                            for (size_t t = 0; t < length; t++)
+                                sum += adjoint[t];
+                            scalarSums[task * targets.size() + k] += sum;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+
+        for (size_t k = 0; k < targets.size(); k++)
+        {
+            if (layout.inputKinds[targets[k]] == InputKind::Column)
+            {
+                ElemType* target = targetData[k];
+                if (overwriteTarget[k])
+                    std::fill(target, target + layout.rows, (ElemType)0);
+                for (size_t task = 0; task < numTasks; task++)
+                {
+                    const ElemType* sum = columnSums.data() + (task * targets.size() + k) * layout.rows;
+                    for (size_t t = 0; t < layout.rows; t++)
+                        target[t] += sum[t];
+                }
+            }
+            else if (layout.inputKinds[targets[k]] == InputKind::Scalar)
+            {
+                double total = 0;
+                for (size_t task = 0; task < numTasks; task++)
+                    total += scalarSums[task * targets.size() + k];
+                targetData[k][0] = (overwriteTarget[k] ? 0 : targetData[k][0]) + (ElemType)total;
+            }
+        }
+    }
+
+    virtual bool ImplementsGradientOverwriteOptimization() const override { return true; }
+
+    // the intermediate values are recomputed from the inputs
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return true; }
+
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        if (GetNumSavedValues() > 0)
+            RequestMatrixFromPool(m_savedValues, matrixPool, GetNumSavedValues() * GetSampleLayout().GetNumElements(), HasMBLayout());
+    }
+
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        if (m_savedValues) // only requested if the expression has saved operations
+            ReleaseMatrixToPool(m_savedValues, matrixPool);
+    }
+
+    virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
+    {
+        Base::Validate(isFinalValidationPass);
+        InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
+
+        // the output has the shape of the largest input, with the largest rank of the inputs (like a broadcasting elementwise node); the others are broadcast
+        size_t largestInput = 0;
+        size_t rank = 0;
+        for (size_t i = 0; i < GetNumInputs(); i++)
+        {
+            if (Input(i)->GetSampleLayout().GetNumElements() > Input(largestInput)->GetSampleLayout().GetNumElements())
+                largestInput = i;
+            rank = max(rank, Input(i)->GetSampleLayout().GetRank());
+        }
+        SetDims(Input(largestInput)->GetSampleLayout().PadRank(rank), HasMBLayout());
+
+        if (isFinalValidationPass)
+        {
+            if (GetNumInputs() > s_maxInputs || m_program.empty() || m_program.size() > s_maxInstructions)
+                InvalidArgument("%ls: A fused expression must have at most %d inputs and 1 to %d operations.", NodeDescription().c_str(), (int)s_maxInputs, (int)s_maxInstructions);
+            size_t numElements = GetSampleLayout().GetNumElements();
+            for (size_t i = 0; i < GetNumInputs(); i++)
+            {
+                size_t inputNumElements = Input(i)->GetSampleLayout().GetNumElements();
+                if (inputNumElements != numElements && (inputNumElements != 1 || Input(i)->HasMBLayout()))
+                    InvalidArgument("%ls: Input [%s] cannot be broadcast to [%s].", NodeDescription().c_str(), string(Input(i)->GetSampleLayout()).c_str(), string(GetSampleLayout()).c_str());
+            }
+        }
+    }
+
+private:
+    // how the elements of the output are traversed: 'columns' columns of 'rows' elements, each split into blocks
+    struct Layout
+    {
+        size_t rows;
+        size_t columns;
+        size_t numBlocks;
+        std::vector<InputKind> inputKinds;
+        std::vector<const ElemType*> inputData;
+        std::vector<std::vector<ElemType>> scalars; // for scalar inputs: the value repeated for a block
+        const char* columnsValidity;                // nullptr if gaps need not be skipped
+        ElemType* savedValues;                      // nullptr if no values are saved; else 'numSavedValues' columns of 'rows' elements per column
+        size_t numSavedValues;
+
+        bool IsGap(size_t column) const { return columnsValidity && !columnsValidity[column]; }
+        // the first saved value for a block; those of the following saved instructions are 'rows' elements apart
+        ElemType* SavedValuesFor(size_t column, size_t firstRow) const { return savedValues ? savedValues + column * numSavedValues * rows + firstRow : nullptr; }
+    };
+
+    // The data of the columns of a value or gradient for the frame range, and their number of elements; the whole matrix without MBLayout.
+    // (This does not create views, which would be costly for the single time steps of a loop, and would keep the matrices from being resized.)
+    static ElemType* DataFor(Matrix<ElemType>& data, const MBLayoutPtr& pMBLayout, const FrameRange& fr, size_t& numElements)
+    {
+        CheckIsDenseCPUMatrix(data);
+        auto columnRange = pMBLayout ? ColumnRangeWithMBLayoutFor(data.GetNumCols(), fr, pMBLayout) : std::pair<size_t, size_t>(0, data.GetNumCols());
+        numElements = data.GetNumRows() * columnRange.second;
+        return data.Data() + data.GetNumRows() * columnRange.first;
+    }
+
+    // The inputs whose gradients the network requests for the same frame range as that of 'inputIndex', in the order it requests them:
+    // all inputs that need a gradient, except inside a loop, where the inputs inside and outside of the loop are backpropagated into separately
+    // (see ComputationNode::Backprop()).
+    std::vector<size_t> GetGradientTargets(size_t inputIndex)
+    {
+        std::vector<size_t> targets;
+        for (size_t i = 0; i < GetNumInputs(); i++)
+        {
+            if (i == inputIndex || (Input(i)->NeedsGradient() && (!IsPartOfLoop() || Input(i)->IsPartOfLoop() == Input(inputIndex)->IsPartOfLoop())))
+                targets.push_back(i);
+        }
+        return targets;
+    }
+
+    static void CheckIsDenseCPUMatrix(const Matrix<ElemType>& matrix)
+    {
+        if (matrix.GetDeviceId() != CPUDEVICE || matrix.GetMatrixType() != MatrixType::DENSE)
+            LogicError("FusedElementwiseNode: Only dense matrices on the CPU are supported.");
+    }
+
+    // Determine how the inputs map to the output elements. 'gradientTargets' are the inputs whose gradients are computed;
+    // if any of them is reduced over the columns, the gaps are marked, so that they can be skipped.
+    Layout GetLayout(const FrameRange& fr, size_t numElements, const std::vector<size_t>& gradientTargets)
+    {
+        Layout layout;
+        layout.rows = GetSampleMatrixNumRows();
+        layout.columns = numElements / layout.rows;
+        layout.columnsValidity = nullptr;
+
+        bool hasColumnInputs = false;
+        layout.inputKinds.resize(GetNumInputs());
+        layout.inputData.resize(GetNumInputs());
+        layout.scalars.resize(GetNumInputs());
+        m_denseInputs.resize(GetNumInputs());
+        for (size_t i = 0; i < GetNumInputs(); i++)
+        {
+            auto& value = InputRef(i).Value();
+            size_t inputNumElements;
+            if (value.GetMatrixType() == MatrixType::DENSE)
+                layout.inputData[i] = DataFor(value, InputRef(i).GetMBLayout(), fr, inputNumElements);
+            else // e.g. a sparse input, which is read from a dense copy
+            {
+                if (value.GetDeviceId() != CPUDEVICE)
+                    CheckIsDenseCPUMatrix(value);
+                if (!m_denseInputs[i])
+                    m_denseInputs[i] = make_shared<Matrix<ElemType>>(CPUDEVICE);
+                m_denseInputs[i]->AssignValuesOf(InputRef(i).HasMBLayout() ? DataWithMBLayoutFor(value, fr, InputRef(i).GetMBLayout()) : value.ColumnSlice(0, value.GetNumCols()));
+                layout.inputData[i] = DataFor(*m_denseInputs[i], nullptr, fr, inputNumElements);
+            }
+            if (inputNumElements == numElements)
+                layout.inputKinds[i] = InputKind::Full;
+            else if (inputNumElements == layout.rows)
+                layout.inputKinds[i] = InputKind::Column;
+            else if (inputNumElements == 1)
+                layout.inputKinds[i] = InputKind::Scalar;
+            else
+                LogicError("%ls: Input of %d elements does not match the output of %d elements.", NodeDescription().c_str(), (int)inputNumElements, (int)numElements);
+            if (layout.inputKinds[i] == InputKind::Scalar)
+                layout.scalars[i].assign(s_blockSize, layout.inputData[i][0]);
+            hasColumnInputs |= layout.inputKinds[i] == InputKind::Column;
+        }
+
+        bool hasReducedTargets = false;
+        for (size_t i : gradientTargets)
+            hasReducedTargets |= layout.inputKinds[i] != InputKind::Full;
+        if (hasReducedTargets && HasMBLayout() && GetMBLayout()->HasGaps(fr))
+        {
+            layout.columnsValidity = DataWithMBLayoutFor(GetMBLayout()->GetColumnsValidityMask(CPUDEVICE), fr, GetMBLayout()).Data();
+        }
+        else if (!hasColumnInputs && !m_hasSavedValues)
+        {
+            // the elements can be traversed as a single column
+            layout.rows = numElements;
+            layout.columns = 1;
+        }
+
+        size_t numSavedElements;
+        layout.savedValues = m_hasSavedValues ? DataFor(*m_savedValues, GetMBLayout(), fr, numSavedElements) : nullptr;
+        layout.numSavedValues = m_hasSavedValues ? GetNumSavedValues() : 0;
+
+        layout.numBlocks = layout.columns * ((layout.rows + s_blockSize - 1) / s_blockSize);
+        return layout;
+    }
+
+    // operand pointers of the inputs for the block starting at (firstRow, column)
+    static void GetOperands(const Layout& layout, size_t column, size_t firstRow, const ElemType** operands)
+    {
+        for (size_t i = 0; i < layout.inputKinds.size(); i++)
+        {
+            switch (layout.inputKinds[i])
+            {
+            case InputKind::Full:   operands[i] = layout.inputData[i] + column * layout.rows + firstRow; break;
+            case InputKind::Column: operands[i] = layout.inputData[i] + firstRow; break;
+            case InputKind::Scalar: operands[i] = layout.scalars[i].data(); break;
+            }
+        }
+    }
+
+    // Call f(column, firstRow, length, operands) for all blocks of the layout, in parallel.
+    template <class F>
+    static void ForEachBlock(const Layout& layout, const F& f)
+    {
+        size_t blocksPerColumn = (layout.rows + s_blockSize - 1) / s_blockSize;
+#pragma omp parallel for if (layout.rows * layout.columns >= s_minElementsForParallelism)
+        for (long long block = 0; block < (long long)layout.numBlocks; block++)
+        {
+            size_t column = block / blocksPerColumn;
+            size_t firstRow = (block % blocksPerColumn) * s_blockSize;
+            size_t length = std::min(s_blockSize, layout.rows - firstRow);
+            const ElemType* operands[s_maxInputs];
+            GetOperands(layout, column, firstRow, operands);
+            f(column, firstRow, length, operands);
+        }
+    }
+
+    // operations whose results are saved for the gradient computation rather than recomputed
+    static bool IsSavedOperation(FusedElementwiseOp op)
+    {
+        switch (op)
+        {
+        case FusedElementwiseOp::LogPlus:
+        case FusedElementwiseOp::Cosine:
+        case FusedElementwiseOp::Exp:
+        case FusedElementwiseOp::ExponentialLinearUnit:
+        case FusedElementwiseOp::Log:
+        case FusedElementwiseOp::Sigmoid:
+        case FusedElementwiseOp::Sin:
+        case FusedElementwiseOp::Sqrt:
+        case FusedElementwiseOp::Tanh:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    size_t GetNumSavedValues() const
+    {
+        return std::count_if(m_program.begin(), m_program.end(), [](const FusedElementwiseInstruction& instruction) { return IsSavedOperation(instruction.op); });
+    }
+
+    // Compute the values of all instructions for a block of elements; 'results' receives where the value of each instruction is,
+    // normally in 'values'. If 'output' is given, the last instruction writes into it.
+    // If 'saved' is given (see Layout::SavedValuesFor()), the saved operations write their results there,
+    // or, with 'restore', their results are taken from there instead of being recomputed.
+    void Evaluate(const ElemType* const* operands, size_t length, ElemType values[][s_blockSize], const ElemType** results,
+                  ElemType* output, ElemType* saved, size_t savedStride, bool restore) const
+    {
+        size_t numInputs = GetNumInputs();
+        auto operand = [&](size_t index) -> const ElemType* { return index < numInputs ? operands[index] : results[index - numInputs]; };
+        for (size_t i = 0; i < m_program.size(); i++)
+        {
+            const auto& instruction = m_program[i];
+            const ElemType* a = operand(instruction.operands[0]);
+            const ElemType* b = operand(instruction.operands[1]);
+            bool isOutput = output && i + 1 == m_program.size();
+            ElemType* savedValues = nullptr;
+            if (saved && IsSavedOperation(instruction.op))
+            {
+                savedValues = saved;
+                saved += savedStride;
+                if (restore)
+                {
+                    results[i] = savedValues;
+                    continue;
+                }
+            }
+            ElemType* r = isOutput ? output : savedValues ? savedValues : values[i];
+            results[i] = r;
+            switch (instruction.op)
+            {
+            case FusedElementwiseOp::Plus:                  for (size_t t = 0; t < length; t++) r[t] = OpSum(a[t], b[t]); break;
+            case FusedElementwiseOp::Minus:                 for (size_t t = 0; t < length; t++) r[t] = OpDifference(a[t], b[t]); break;
+            case FusedElementwiseOp::ElementTimes:          for (size_t t = 0; t < length; t++) r[t] = OpElementwiseProduct(a[t], b[t]); break;
+            case FusedElementwiseOp::LogPlus:               for (size_t t = 0; t < length; t++) r[t] = OpLogSum(a[t], b[t]); break;
+            case FusedElementwiseOp::Abs:                   for (size_t t = 0; t < length; t++) r[t] = OpAbs(a[t]); break;
+            case FusedElementwiseOp::Cosine:                for (size_t t = 0; t < length; t++) r[t] = OpCosine(a[t]); break;
+            case FusedElementwiseOp::Exp:                   for (size_t t = 0; t < length; t++) r[t] = OpExp(a[t]); break;
+            case FusedElementwiseOp::ExponentialLinearUnit: for (size_t t = 0; t < length; t++) r[t] = OpExponentialLinearUnit(a[t]); break;
+            case FusedElementwiseOp::Log:                   for (size_t t = 0; t < length; t++) r[t] = OpLog(a[t]); break;
+            case FusedElementwiseOp::Negate:                for (size_t t = 0; t < length; t++) r[t] = OpNegate(a[t]); break;
+            case FusedElementwiseOp::Pass:                  for (size_t t = 0; t < length; t++) r[t] = OpCopy(a[t]); break;
+            case FusedElementwiseOp::Reciprocal:            for (size_t t = 0; t < length; t++) r[t] = OpReciprocal(a[t]); break;
+            case FusedElementwiseOp::RectifiedLinear:       for (size_t t = 0; t < length; t++) r[t] = OpLinearRectifier(a[t]); break;
+            case FusedElementwiseOp::Sigmoid:               for (size_t t = 0; t < length; t++) r[t] = OpSigmoid(a[t]); break;
+            case FusedElementwiseOp::Sin:                   for (size_t t = 0; t < length; t++) r[t] = OpSin(a[t]); break;
+            case FusedElementwiseOp::Sqrt:                  for (size_t t = 0; t < length; t++) r[t] = OpSqrt(a[t]); break;
+            case FusedElementwiseOp::Tanh:                  for (size_t t = 0; t < length; t++) r[t] = OpTanh(a[t]); break;
+            }
+            if (isOutput && savedValues)
+                std::copy(r, r + length, savedValues);
+        }
+    }
+
+    // Given the values of all instructions for a block (see Evaluate()), compute the gradients of the output w.r.t. all operands (reverse mode).
+    void Backpropagate(const ElemType* const* operands, size_t length, const ElemType* const* results, const ElemType* outputGradient, ElemType adjoints[][s_blockSize]) const
+    {
+        size_t numInputs = GetNumInputs();
+        size_t numOperands = numInputs + m_program.size();
+        for (size_t k = 0; k < numOperands - 1; k++)
+            std::fill(adjoints[k], adjoints[k] + length, (ElemType)0);
+        std::copy(outputGradient, outputGradient + length, adjoints[numOperands - 1]);
+
+        auto operand = [&](size_t index) -> const ElemType* { return index < numInputs ? operands[index] : results[index - numInputs]; };
+        for (size_t i = m_program.size(); i-- > 0;)
+        {
+            const auto& instruction = m_program[i];
+            const ElemType* g = adjoints[numInputs + i];
+            const ElemType* y = results[i];
+            const ElemType* a = operand(instruction.operands[0]);
+            const ElemType* b = operand(instruction.operands[1]);
+            ElemType* da = adjoints[instruction.operands[0]];
+            ElemType* db = adjoints[instruction.operands[1]];
+            switch (instruction.op)
+            {
+            case FusedElementwiseOp::Plus:
+                for (size_t t = 0; t < length; t++) da[t] += g[t];
+                for (size_t t = 0; t < length; t++) db[t] += g[t];
+                break;
+            case FusedElementwiseOp::Minus:
+                for (size_t t = 0; t < length; t++) da[t] += g[t];
+                for (size_t t = 0; t < length; t++) db[t] -= g[t];
+                break;
+            case FusedElementwiseOp::ElementTimes:
+                for (size_t t = 0; t < length; t++) da[t] += OpElementwiseProduct(g[t], b[t]);
+                for (size_t t = 0; t < length; t++) db[t] += OpElementwiseProduct(g[t], a[t]);
+                break;
+            case FusedElementwiseOp::LogPlus:
+                for (size_t t = 0; t < length; t++) da[t] += OpElementwiseProductWithLogSumDerivative(g[t], b[t], a[t]);
+                for (size_t t = 0; t < length; t++) db[t] += OpElementwiseProductWithLogSumDerivative(g[t], a[t], b[t]);
+                break;
+            case FusedElementwiseOp::Abs:                   for (size_t t = 0; t < length; t++) da[t] += OpElementwiseProductWithAbsDerivative(g[t], a[t]); break;
+            case FusedElementwiseOp::Cosine:                for (size_t t = 0; t < length; t++) da[t] += OpElementwiseProductWithCosDerivative(g[t], a[t]); break;
+            case FusedElementwiseOp::Exp:                   for (size_t t = 0; t < length; t++) da[t] += OpElementwiseProduct(g[t], y[t]); break;
+            case FusedElementwiseOp::ExponentialLinearUnit: for (size_t t = 0; t < length; t++) da[t] += OpElementwiseProductWithExponentialLinearUnitDerivativeFromOutput(g[t], y[t]); break;
+            case FusedElementwiseOp::Log:                   for (size_t t = 0; t < length; t++) da[t] += OpElementwiseProductWithLogDerivativeFromOutput(g[t], y[t]); break;
+            case FusedElementwiseOp::Negate:                for (size_t t = 0; t < length; t++) da[t] -= g[t]; break;
+            case FusedElementwiseOp::Pass:                  for (size_t t = 0; t < length; t++) da[t] += g[t]; break;
+            case FusedElementwiseOp::Reciprocal:            for (size_t t = 0; t < length; t++) da[t] += OpElementwiseProductWithReciprocalDerivative(g[t], y[t]); break;
+            case FusedElementwiseOp::RectifiedLinear:       for (size_t t = 0; t < length; t++) da[t] += OpElementwiseProductWithLinearRectifierDerivativeFromOutput(g[t], y[t]); break;
+            case FusedElementwiseOp::Sigmoid:               for (size_t t = 0; t < length; t++) da[t] += OpElementwiseProductWithSigmoidDerivativeFromOutput(g[t], y[t]); break;
+            case FusedElementwiseOp::Sin:                   for (size_t t = 0; t < length; t++) da[t] += OpElementwiseProductWithSinDerivative(g[t], a[t]); break;
+            case FusedElementwiseOp::Sqrt:                  for (size_t t = 0; t < length; t++) da[t] += OpElementwiseProductWithSqrtDerivative(g[t], y[t]); break;
+            case FusedElementwiseOp::Tanh:                  for (size_t t = 0; t < length; t++) da[t] += OpElementwiseProductWithTanhDerivativeFromOutput(g[t], y[t]); break;
+            }
+        }
+    }
+
+    std::vector<FusedElementwiseInstruction> m_program;
+    shared_ptr<Matrix<ElemType>> m_savedValues;               // results of the saved operations, see UpdateFunctionMBSize()
+    bool m_hasSavedValues = false;
+    std::vector<shared_ptr<Matrix<ElemType>>> m_denseInputs;  // [inputIndex] dense copy of an input that is not dense
+};
+
+template class FusedElementwiseNode<float>;
+template class FusedElementwiseNode<double>;
+
+}}}
@@ -409,13 +409,19 @@ void LearnableParameter<ElemType>::ReviseFromFile(const wstring& reviseFromFileP
 
 template <class ElemType>
 void LearnableParameter<ElemType>::Save(File& fstream) const /*override*/
+{
+    SaveWithValue(fstream, Value());
+}
+
+template <class ElemType>
+void LearnableParameter<ElemType>::SaveWithValue(File& fstream, const Matrix<ElemType>& value) const
 {
     if (!m_initString.empty())
         LogicError("LearnableParameter: Cannot Save() before deferred initialization has completed.");
     Base::Save(fstream);
     fstream << m_learningRateMultiplier;
     m_sampleLayout.Save(fstream);
-    fstream << Value();
+    fstream << value;
 }
 
 template <class ElemType>
@@ -125,6 +125,9 @@ public:
     virtual void Save(File& fstream) const override;
     virtual void Load(File& fstream, size_t modelVersion) override;
 
+    // Save() with a different value, e.g. a snapshot taken earlier (see ComputationNetwork::Save())
+    void SaveWithValue(File& fstream, const Matrix<ElemType>& value) const;
+
     virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override;
 
     // computation functions don't do anything for parameter nodes
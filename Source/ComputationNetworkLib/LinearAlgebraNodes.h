@@ -20,6 +20,7 @@
 #include <utility>
 #include <assert.h>
 #include <set>
+#include <chrono>
 #include "Quantizers.h"
 #include "InputAndParamNodes.h"
 
@@ -762,6 +763,16 @@ public:
 
     virtual bool ImplementsGradientOverwriteOptimization() const override { return true; }
 
+    virtual double GetFlopEstimate(const FrameRange& fr, bool backward) const override
+    {
+        // For a product [M x K] * [K x N] -> [M x N], the element counts satisfy (M*K) * (K*N) / (M*N) = K^2,
+        // which gives the inner dimension without having to tell the output and reduction axes apart.
+        double numOutputElements = (double)GetSampleMatrixNumRows() * GetNumColsInFrameRange(fr);
+        double innerDim = sqrt((double)Input(0)->GetSampleMatrixNumRows() * Input(1)->GetSampleMatrixNumRows() / max(GetSampleMatrixNumRows(), (size_t)1));
+        double numProducts = backward ? (double)(Input(0)->NeedsGradient() + Input(1)->NeedsGradient()) : 1;
+        return 2 * numOutputElements * innerDim * numProducts;
+    }
+
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
@@ -1023,7 +1034,8 @@ template class TransposeTimesNode<double>;
 
 // Fixed-point matrix product. This scales inputs to 16bit signed integers by Symmetric quantizers, performs
 // integer multiplication using SSE/AVX2, and transforms the results back.
-// Only dense untransposed matrix multiplication will be quantized. If at least one matrix is sparse then it will fall back to un-quantized default evaluation
+// Only dense untransposed matrix multiplication will be quantized. If at least one matrix is sparse then it will fall back to un-quantized default evaluation,
+// see IsQuantized().
 // Currently it works for CPU only. On GPU logicError will be thrown.
 // One way to include this node to the network is with the Edit command:
 // ...
@@ -1032,6 +1044,7 @@ template class TransposeTimesNode<double>;
 // bitShift(A|B) - bit shift parameters of quantizers for matrices A and B, see the quantizers for more details. Decreases the maximum range of quantziation by 2^bitShift to prevent integer overflow during BLAS routines.
 // bitShift=0 doesn't change the range; higher bitShift will decrease precision of quantization, but will make BLAS routines less prone to overflow.
 // Other parameters - refer to the base multiplication class
+// For evaluation, ComputationNetwork::QuantizeTimesNodes() replaces all eligible TimesNodes of a loaded model by this node.
 template <class ElemType>
 class QuantizedTimesNode : public TimesNodeBase<ElemType, false>
 {
@@ -1047,9 +1060,24 @@ private:
     size_t m_bitShiftA; 
     size_t m_bitShiftB; 
 
+    // Eval time stamps of the parameter inputs when they were quantized, see ForwardProp().
+    uint64_t m_quantizedTimeStampA;
+    uint64_t m_quantizedTimeStampB;
+
+    // Comparison with the unquantized product, see CompareWithUnquantized().
+    size_t m_numProductsToCompare;
+    size_t m_numProductsCompared;
+    double m_quantizedSeconds;
+    double m_unquantizedSeconds;
+    double m_sumSquaredError;
+    double m_sumSquaredReference;
+    double m_maxAbsoluteError;
+
 public:
     QuantizedTimesNode(DEVICEID_TYPE deviceId, const wstring& name, size_t bitShiftA = 1, size_t bitShiftB = 1, size_t outputRank = 1, int inferInputRankToMap = Base::NoInferredInputRank)
-        : Base(deviceId, name, outputRank, inferInputRankToMap), m_bitShiftA(bitShiftA), m_bitShiftB(bitShiftB)
+        : Base(deviceId, name, outputRank, inferInputRankToMap), m_bitShiftA(bitShiftA), m_bitShiftB(bitShiftB),
+          m_quantizedTimeStampA(0), m_quantizedTimeStampB(0), m_numProductsToCompare(0), m_numProductsCompared(0), m_quantizedSeconds(0), m_unquantizedSeconds(0),
+          m_sumSquaredError(0), m_sumSquaredReference(0), m_maxAbsoluteError(0)
     {
         // TODO support multiplication on GPUs as well.
         if (deviceId != CPUDEVICE)
@@ -1093,12 +1121,51 @@ public:
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
+        // Parameters are quantized once and kept by the multiplier as long as their values do not change. Updates of the
+        // values bump the eval time stamp of the parameter, e.g. when the parameters are shared with a network that is trained.
+        bool parametersChanged = false;
         if (dynamic_pointer_cast<LearnableParameter<ElemType>>(Input(0)))
+        {
             this->m_pQuantizedMultiplier->SetIsAConstant(true);
+            parametersChanged |= Input(0)->GetEvalTimeStamp() != m_quantizedTimeStampA;
+            m_quantizedTimeStampA = Input(0)->GetEvalTimeStamp();
+        }
         if (dynamic_pointer_cast<LearnableParameter<ElemType>>(Input(1)))
+        {
             this->m_pQuantizedMultiplier->SetIsBConstant(true);
+            parametersChanged |= Input(1)->GetEvalTimeStamp() != m_quantizedTimeStampB;
+            m_quantizedTimeStampB = Input(1)->GetEvalTimeStamp();
+        }
+        if (parametersChanged)
+            this->m_pQuantizedMultiplier->InvalidateConstants();
 
-        Base::ForwardProp(fr);
+        if (m_numProductsCompared < m_numProductsToCompare && !IsQuantized())
+        {
+            // there is no quantized product to compare with
+            fprintf(stderr, "QuantizedTimes %ls: Not quantized, since an input is sparse.\n", NodeName().c_str());
+            m_numProductsToCompare = 0;
+        }
+
+        if (m_numProductsCompared < m_numProductsToCompare)
+            ForwardPropAndCompare(fr);
+        else
+            Base::ForwardProp(fr);
+    }
+
+    // Whether the product is computed in fixed point. With a sparse input it falls back to the unquantized sparse product.
+    bool IsQuantized() const
+    {
+        return !InputRef(0).IsValueSparse() && !InputRef(1).IsValueSparse();
+    }
+
+    // Computes the next numProducts products also without quantization, and prints the error and the speed-up of the
+    // quantized product once they are done. The network continues with the quantized values.
+    void CompareWithUnquantized(size_t numProducts)
+    {
+        m_numProductsToCompare = numProducts;
+        m_numProductsCompared = 0;
+        m_quantizedSeconds = m_unquantizedSeconds = 0;
+        m_sumSquaredError = m_sumSquaredReference = m_maxAbsoluteError = 0;
     }
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t /*inputIndex*/, const FrameRange& /*fr*/) override
@@ -1106,6 +1173,39 @@ public:
         // This operation is intended only for inference
         NOT_IMPLEMENTED;
     }
+
+private:
+    void ForwardPropAndCompare(const FrameRange& fr)
+    {
+        auto quantizedMultiplier = this->m_pQuantizedMultiplier;
+        this->m_pQuantizedMultiplier = nullptr;
+        auto start = std::chrono::high_resolution_clock::now();
+        Base::ForwardProp(fr);
+        m_unquantizedSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        this->m_pQuantizedMultiplier = quantizedMultiplier;
+
+        Matrix<ElemType> difference = ValueFor(fr).DeepClone();
+        double referenceNorm = difference.FrobeniusNorm();
+
+        start = std::chrono::high_resolution_clock::now();
+        Base::ForwardProp(fr);
+        m_quantizedSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        difference.AssignDifferenceOf(difference, ValueFor(fr));
+        double errorNorm = difference.FrobeniusNorm();
+        m_sumSquaredError += errorNorm * errorNorm;
+        m_sumSquaredReference += referenceNorm * referenceNorm;
+        m_maxAbsoluteError = std::max(m_maxAbsoluteError, (double)difference.MatrixNormInf());
+
+        if (++m_numProductsCompared == m_numProductsToCompare)
+        {
+            fprintf(stderr, "QuantizedTimes %ls: relative error %.3g%% (max absolute error %.3g), %.3f ms per product vs. %.3f ms unquantized (speed-up %.2f) over %d products%s.\n",
+                    NodeName().c_str(), m_sumSquaredReference > 0 ? 100 * sqrt(m_sumSquaredError / m_sumSquaredReference) : 0.0, m_maxAbsoluteError,
+                    1000 * m_quantizedSeconds / m_numProductsCompared, 1000 * m_unquantizedSeconds / m_numProductsCompared,
+                    m_quantizedSeconds > 0 ? m_unquantizedSeconds / m_quantizedSeconds : 0.0, (int)m_numProductsCompared,
+                    this->m_pQuantizedMultiplier->UsesBlockMultiplier() ? "" : " (no block multiplier for this processor)");
+        }
+    }
 };
 
 template class QuantizedTimesNode<float>;
@@ -11,6 +11,7 @@
 #include <set>
 #include <utility>
 #include <algorithm>
+#include <functional>
 #include <stdlib.h>
 
 #include "Basics.h"
@@ -58,6 +59,40 @@ struct MemAllocInfo
     }
 };
 
+// one shared buffer as handed out by OptimizedMemoryAllocationFunc(), together with what is known about its size
+template <class ElemType>
+struct MemBufferInfo
+{
+    shared_ptr<Matrix<ElemType>> matrixPtr;     // the matrix object shared by all requests assigned to this buffer
+    size_t sampleSize;                          // largest per-sample size of the requests that scale with the minibatch size
+    size_t fixedSize;                           // largest size of the requests that don't scale with the minibatch size
+    MemBufferInfo(const shared_ptr<Matrix<ElemType>>& matrixPtr, size_t sampleSize, size_t fixedSize)
+        :matrixPtr(matrixPtr), sampleSize(sampleSize), fixedSize(fixedSize)
+    {
+    }
+    size_t GetRequiredSize(size_t numSamples) const { return max(sampleSize * numSamples, fixedSize); }
+};
+
+// statistics of the minibatch-aware reservation of the shared buffers, see MatrixPool::ReserveForMinibatch()
+struct MatrixPoolStatistics
+{
+    size_t numBuffers;              // number of dense buffers owned by the pool
+    size_t numReservations;         // number of times the buffers had to grow
+    size_t largestNumSamples;       // largest minibatch size (number of columns) seen so far
+    size_t reservedNumSamples;      // minibatch size the buffers are currently reserved for
+    size_t reservedBytes;           // memory currently reserved for the buffers
+    size_t peakReservedBytes;       // maximum of reservedBytes over time
+    size_t usedBytes;               // memory needed by the last minibatch
+
+    MatrixPoolStatistics()
+        :numBuffers(0), numReservations(0), largestNumSamples(0), reservedNumSamples(0), reservedBytes(0), peakReservedBytes(0), usedBytes(0)
+    {
+    }
+
+    // fraction of the reserved memory not needed by the last minibatch
+    double GetFragmentation() const { return reservedBytes == 0 ? 0.0 : 1.0 - (double)usedBytes / reservedBytes; }
+};
+
 // MatrixPool -- class to support memory sharing
 // Despite the gather general name of this class, it is specifically designed to support the memory sharing of ComputationNodes.
 // Note: see #define SUPRESS_MEMSHARING below as for how to temporarily disable memory sharing altogether, for debugging
@@ -68,11 +103,81 @@ class MatrixPool
     set<DEVICEID_TYPE> m_deviceIDSet; 
     int m_stepCounter; 
 
+    // concurrency information for nodes executed in parallel, see BeginTask()
+    vector<int> m_stepTasks;                                // [step] -> task that made the request at this step, or -1
+    int m_currentTask;
+    std::function<bool(int, int)> m_mayRunConcurrently;     // (task, task) -> whether they may be executed concurrently
+    vector<pair<int, int>> m_concurrentSteps;               // [task] -> range of the steps of all tasks that may run concurrently with it
+
+    // the buffers created by OptimizedMemoryAllocation(), used to reserve memory once the minibatch size is known
+    vector<MemBufferInfo<float>> m_memBufferInfoFloatVec;
+    vector<MemBufferInfo<double>> m_memBufferInfoDoubleVec;
+    MatrixPoolStatistics m_statistics;
+
     template <class ElemType>
     vector<MemRequestInfo<ElemType>>& GetMemRequestInfoVec(); 
 
+    template <class ElemType>
+    vector<MemBufferInfo<ElemType>>& GetMemBufferInfoVec();
+
 public:
-    void ResetStepCounter() { m_stepCounter = 0; };
+    MatrixPool() : m_stepCounter(0), m_currentTask(-1) {}
+
+    void ResetStepCounter()
+    {
+        m_stepCounter = 0;
+        m_stepTasks.clear();
+        m_currentTask = -1;
+        m_mayRunConcurrently = nullptr;
+    }
+
+    // The requests are made while simulating a sequential execution of the nodes, and two requests may share a buffer
+    // if their steps don't overlap. If nodes are executed in parallel, this order does not hold. To account for that, the
+    // simulation is split into tasks (e.g. the forward or backward computation of a node), all subsequent requests belong to
+    // the task begun last, and SetConcurrency() tells which tasks may be executed concurrently. A request then additionally
+    // can't share a buffer with an earlier request that is still in use during a step of a task that may run concurrently
+    // with the task making the later request. Each task gets a step of its own, so that tasks without requests count, too.
+    void BeginTask(int task)
+    {
+        m_currentTask = task;
+        NextStep();
+    }
+
+    // Must be called after all requests have been made, before OptimizedMemoryAllocation().
+    // Any two tasks that may not run concurrently must be executed in the order they were begun in.
+    void SetConcurrency(const std::function<bool(int, int)>& mayRunConcurrently) { m_mayRunConcurrently = mayRunConcurrently; }
+
+    const MatrixPoolStatistics& GetStatistics() const { return m_statistics; }
+
+    // Reserves the shared buffers for a minibatch of numSamples columns.
+    // Without this, each shared matrix grows exactly to the size requested by the node that uses it, so with variable-length
+    // sequences every new largest minibatch reallocates most of the shared matrices in Matrix::Resize(), often several times
+    // per minibatch as the nodes sharing a buffer resize it one after another.
+    // Here, all buffers are grown at once, for the largest minibatch seen so far rounded up to the next size class,
+    // so that the number of reallocations is logarithmic in the largest minibatch size. Buffers never shrink.
+    // This must only be called while the content of the shared matrices is not needed, i.e. before forward prop of a new minibatch.
+    // Returns true if the buffers had to grow.
+    bool ReserveForMinibatch(size_t numSamples)
+    {
+        if (numSamples == 0)
+            return false;
+
+        m_statistics.largestNumSamples = max(m_statistics.largestNumSamples, numSamples);
+        bool needsToGrow = numSamples > m_statistics.reservedNumSamples;
+        if (needsToGrow)
+        {
+            m_statistics.reservedNumSamples = RoundUpToSizeClass(numSamples);
+            m_statistics.numReservations++;
+        }
+
+        m_statistics.numBuffers = 0;
+        m_statistics.reservedBytes = 0;
+        m_statistics.usedBytes = 0;
+        ReserveForMinibatchFunc<float>(numSamples, needsToGrow);
+        ReserveForMinibatchFunc<double>(numSamples, needsToGrow);
+        m_statistics.peakReservedBytes = max(m_statistics.peakReservedBytes, m_statistics.reservedBytes);
+        return needsToGrow;
+    }
 
     template <class ElemType>
     void RequestRelease(shared_ptr<Matrix<ElemType>> *pMatrixPtr)
@@ -87,7 +192,7 @@ public:
                 break; 
             }
         }
-        m_stepCounter++; 
+        NextStep();
     }
 
     // isWorkSpace is a flag indicating a memory is temporary and will be released very shortly. In the current implementation, all workspace
@@ -103,7 +208,7 @@ public:
         MemRequestInfo<ElemType> memInfo(deviceId, pMatrixPtr, matrixSize, mbScale, isWorkSpace, m_stepCounter);
         memInfoVec.push_back(memInfo); 
         m_deviceIDSet.insert(deviceId); 
-        m_stepCounter++; 
+        NextStep();
 
         // assign some temporary pointer, they will be replaced later unless the matrix is sparse
         *pMatrixPtr = make_shared<Matrix<ElemType>>(deviceId);
@@ -111,6 +216,8 @@ public:
 
     void OptimizedMemoryAllocation()
     {
+        ComputeConcurrentSteps();
+
         // MatrixPool is not templated, so we call both float and double versions here 
         OptimizedMemoryAllocationFunc<float>(); 
         OptimizedMemoryAllocationFunc<double>();
@@ -118,19 +225,105 @@ public:
     }
 
 private: 
+    void NextStep()
+    {
+        m_stepTasks.push_back(m_currentTask);
+        m_stepCounter++;
+    }
+
+    void ComputeConcurrentSteps()
+    {
+        m_concurrentSteps.clear();
+        if (!m_mayRunConcurrently)
+            return;
+
+        int numTasks = 0;
+        for (auto task : m_stepTasks)
+            numTasks = max(numTasks, task + 1);
+        vector<pair<int, int>> taskSteps(numTasks, make_pair(INT_MAX, INT_MIN));
+        for (int step = 0; step < (int)m_stepTasks.size(); step++)
+        {
+            int task = m_stepTasks[step];
+            if (task < 0)
+                continue;
+            taskSteps[task].first = min(taskSteps[task].first, step);
+            taskSteps[task].second = max(taskSteps[task].second, step);
+        }
+
+        m_concurrentSteps.assign(numTasks, make_pair(INT_MAX, INT_MIN));
+        for (int task1 = 0; task1 < numTasks; task1++)
+        {
+            for (int task2 = task1 + 1; task2 < numTasks; task2++)
+            {
+                if (taskSteps[task1].first == INT_MAX || taskSteps[task2].first == INT_MAX || !m_mayRunConcurrently(task1, task2))
+                    continue;
+                m_concurrentSteps[task1].first = min(m_concurrentSteps[task1].first, taskSteps[task2].first);
+                m_concurrentSteps[task1].second = max(m_concurrentSteps[task1].second, taskSteps[task2].second);
+                m_concurrentSteps[task2].first = min(m_concurrentSteps[task2].first, taskSteps[task1].first);
+                m_concurrentSteps[task2].second = max(m_concurrentSteps[task2].second, taskSteps[task1].second);
+            }
+        }
+    }
+
+    // range of the steps that may be executed concurrently with the task that made a request at the given step (empty if none)
+    pair<int, int> GetConcurrentSteps(int step) const
+    {
+        if (m_concurrentSteps.empty() || step < 0 || step >= (int)m_stepTasks.size() || m_stepTasks[step] < 0)
+            return make_pair(INT_MAX, INT_MIN);
+        return m_concurrentSteps[m_stepTasks[step]];
+    }
+
+    static bool Overlaps(pair<int, int> occ1, pair<int, int> occ2)
+    {
+        return occ1.first <= occ2.second && occ1.second >= occ2.first;
+    }
+
+    // Size classes are spaced four per power of two, so at most 25% of a reservation is slack.
+    static size_t RoundUpToSizeClass(size_t n)
+    {
+        size_t powerOfTwo = 1;
+        while (powerOfTwo <= n / 2)
+            powerOfTwo *= 2;
+        size_t step = max<size_t>(powerOfTwo / 4, 1);
+        return (n + step - 1) / step * step;
+    }
+
+    template <class ElemType>
+    void ReserveForMinibatchFunc(size_t numSamples, bool grow)
+    {
+        for (auto& bufferInfo : GetMemBufferInfoVec<ElemType>())
+        {
+            auto& matrix = *bufferInfo.matrixPtr;
+            // matrices that turned sparse, or whose size is unknown, are left to grow on demand
+            if (matrix.GetMatrixType() != DENSE || bufferInfo.GetRequiredSize(1) == 0)
+                continue;
+
+            // Resize() only reallocates if the buffer grows; nodes then resize within the reservation without reallocating
+            size_t reservedSize = bufferInfo.GetRequiredSize(m_statistics.reservedNumSamples);
+            if (grow)
+                matrix.Resize(reservedSize, 1);
+
+            m_statistics.numBuffers++;
+            m_statistics.reservedBytes += reservedSize * sizeof(ElemType);
+            m_statistics.usedBytes += bufferInfo.GetRequiredSize(numSamples) * sizeof(ElemType);
+        }
+    }
+
     bool CheckOverlap(pair<int, int>occ, vector<pair<int, int>>&occVec)
     {
         bool bRet = false;
         for (auto& o : occVec)
         {
-            if (occ.first <= o.second && occ.second >= o.first)
+            // With parallel execution, the earlier one also may not be in use by a task that may run concurrently with the task
+            // that allocates the later one. All other users of the later one depend on that task, so they run after it, too.
+            bool isConcurrent = occ.second < o.first ? Overlaps(occ, GetConcurrentSteps(o.first)) : Overlaps(o, GetConcurrentSteps(occ.first));
+            if (Overlaps(occ, o) || isConcurrent)
             {
                 bRet = true;
                 break;
             }
         }
 //#define SUPRESS_MEMSHARING // #define this to disable memory sharing by always return true 
-// TODO: Make this a runtime option.
 #ifdef SUPRESS_MEMSHARING
         bRet = true; 
 #endif
@@ -141,6 +334,8 @@ private:
     void OptimizedMemoryAllocationFunc()
     {
         vector<MemRequestInfo<ElemType>>& memInfoVec = GetMemRequestInfoVec<ElemType>();
+        vector<MemBufferInfo<ElemType>>& memBufferInfoVec = GetMemBufferInfoVec<ElemType>();
+        memBufferInfoVec.clear();
         if (memInfoVec.empty())
             return; 
 
@@ -254,11 +449,19 @@ private:
                     auto matrixPtr = make_shared<Matrix<ElemType>>(devId);
                     if (!matrixPtr) // this can't really happen, because we haven't started allocating memory yet
                         LogicError("MatrixPool: failed to get a valid matrix.");
+                    MemBufferInfo<ElemType> bufferInfo(matrixPtr, 0, 0);
                     for (auto& memInfo : memInfoVec)
                     {
                         if (memInfo.deviceId == devId && memInfo.isWorkSpace == wsFlag && memInfo.memoryId == i)
+                        {
                             *memInfo.pMatrixPtr = matrixPtr;
+                            if (memInfo.mbScale)
+                                bufferInfo.sampleSize = max(bufferInfo.sampleSize, memInfo.matrixSize);
+                            else
+                                bufferInfo.fixedSize = max(bufferInfo.fixedSize, memInfo.matrixSize);
+                        }
                     }
+                    memBufferInfoVec.push_back(bufferInfo);
                 }
             }
         }
@@ -41,6 +41,8 @@ void CNTKEvalBase<ElemType>::Init(const std::string& config)
     CPUMatrix<ElemType>::SetNumThreads(nThreads);
 
     Globals::SetShareNodeValueMatrices(m_config(L"shareNodeValueMatrices", true));
+    // Off by default: the evaluation interfaces address inner nodes by name (e.g. as outputs), which fused nodes hide.
+    Globals::SetElementwiseFusion(m_config(L"fuseElementwiseOperations", false));
 }
 
 
@@ -59,6 +61,15 @@ void CNTKEvalBase<ElemType>::CreateNetwork(const std::string& networkDescription
     {
         LogicError("Unable to construct network from description");
     }
+
+    // Optionally evaluate the products of parameters and data in 16-bit fixed point (see QuantizedTimesNode).
+    // With quantizationReportProducts > 0, each quantized product reports its error and speed-up against the
+    // unquantized product, computed in addition for that many products.
+    if (config(L"quantizeTimes", false))
+    {
+        this->m_net->template QuantizeTimesNodes<ElemType>(config(L"quantizeBitShiftA", (size_t)2), config(L"quantizeBitShiftB", (size_t)2),
+                                                           config(L"quantizationReportProducts", (size_t)0));
+    }
 }
 
 
@@ -306,7 +317,7 @@ VariableSchema CNTKEvalExtended<ElemType>::GetInputSchema() const
 
 template<typename ElemType>
 template<template<typename> class ValueContainer>
-void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<ElemType, ValueContainer> >& inputs, std::vector<ValueBuffer<ElemType, ValueContainer> >& outputs, bool resetRNN)
+EvalRequest<ElemType> CNTKEvalExtended<ElemType>::CreateRequest(const std::vector<ValueBuffer<ElemType, ValueContainer> >& inputs, std::vector<ValueBuffer<ElemType, ValueContainer> >& outputs, bool resetRNN) const
 {
     if (!m_started)
         RuntimeError("ForwardPass() called before StartForwardEvaluation()");
@@ -317,12 +328,13 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
     if (outputs.size() != m_outputNodes.size())
         RuntimeError("Expected %d outputs, but got %d.", (int)m_outputNodes.size(), (int)outputs.size());
 
+    EvalRequest<ElemType> request;
+    request.m_resetRNN = resetRNN;
+
     size_t i = 0;
     for (auto& inputNode : m_inputNodes)
     {
-        // const cast: The matrix class takes this over without copying and could theoretically change the contents,
-        // though it doesn't in this case.
-        auto& buffer = const_cast<ValueBuffer<ElemType, ValueContainer>&>(inputs[i]);
+        const auto& buffer = inputs[i];
         auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(inputNode->ValuePtr());
         auto type = matrix->GetMatrixType();
         size_t numRows = inputNode->GetSampleLayout().GetNumElements();
@@ -356,19 +368,130 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
         int numCols = type == MatrixType::DENSE ? buffer.m_buffer.size() / numRows : buffer.m_colIndices.size() - 1;
         if (numCols < 1)
             RuntimeError("Input: the number of column must be greater than or equal to 1.");
-        inputNode->GetMBLayout()->Init(1, numCols);
-        
-        // SentinelValueIndicatingUnspecifedSequenceBeginIdx is used to specify the lower bound of look-back step of recurrent nodes
-        inputNode->GetMBLayout()->AddSequence(0, 0, resetRNN ? 0 : SentinelValueIndicatingUnspecifedSequenceBeginIdx, numCols);
+
+        request.m_inputs.push_back(typename EvalRequest<ElemType>::Input
+        {
+            buffer.m_buffer.data(), buffer.m_buffer.size(),
+            buffer.m_indices.data(), buffer.m_indices.size(),
+            buffer.m_colIndices.data(), buffer.m_colIndices.size(),
+            (size_t)numCols
+        });
+
+        ++i;
+    }
+
+    request.m_setOutput = [this, &outputs](size_t i2, const ElemType* data, size_t numElements)
+    {
+        ValueContainer<ElemType>& vec = outputs[i2].m_buffer;
+
+        if (vec.capacity() < numElements)
+        {
+            // Bad luck - we can't reallocate memory of an external object at this point.
+            RuntimeError("Not enough space in output buffer for output '%ls'.", m_outputNodes[i2]->GetName().c_str());
+        }
+
+        vec.resize(numElements);
+        if (numElements > 0)
+            memcpy(const_cast<ElemType*>(vec.data()), data, numElements * sizeof(ElemType));
+    };
+
+    return request;
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::ForwardPassBatch(const std::vector<EvalRequest<ElemType>*>& requests)
+{
+    if (requests.empty())
+        return;
+
+    // Every request becomes a parallel sequence of its own, padded with a gap up to the longest one.
+    // A single request is passed to the network without copying.
+    const size_t numSequences = requests.size();
+    if (numSequences > 1)
+    {
+        if (!CanBatchRequests())
+            LogicError("ForwardPassBatch: Several requests can only be evaluated together if all outputs have a dynamic axis.");
+        for (const auto& request : requests)
+        {
+            if (!request->m_resetRNN)
+                LogicError("ForwardPassBatch: Several requests can only be evaluated together if they all reset the RNN state.");
+        }
+    }
+
+    size_t i = 0;
+    for (auto& inputNode : m_inputNodes)
+    {
+        auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(inputNode->ValuePtr());
+        auto type = matrix->GetMatrixType();
+        size_t numRows = inputNode->GetSampleLayout().GetNumElements();
+
+        size_t numTimeSteps = 0;
+        for (const auto& request : requests)
+            numTimeSteps = max(numTimeSteps, request->m_inputs[i].m_numCols);
+        size_t numCols = numTimeSteps * numSequences;
+
+        auto pMBLayout = inputNode->GetMBLayout();
+        pMBLayout->Init(numSequences, numTimeSteps);
+        for (size_t s = 0; s < numSequences; s++)
+        {
+            // SentinelValueIndicatingUnspecifedSequenceBeginIdx is used to specify the lower bound of look-back step of recurrent nodes
+            const auto& input = requests[s]->m_inputs[i];
+            pMBLayout->AddSequence(s, s, requests[s]->m_resetRNN ? 0 : SentinelValueIndicatingUnspecifedSequenceBeginIdx, input.m_numCols);
+            if (input.m_numCols < numTimeSteps)
+                pMBLayout->AddGap(s, input.m_numCols, numTimeSteps);
+        }
 
         if (type == MatrixType::DENSE)
-            matrix->SetValue(numRows, numCols, matrix->GetDeviceId(), buffer.m_buffer.data(), matrixFlagNormal);
+        {
+            const ElemType* data = requests[0]->m_inputs[i].m_buffer;
+            if (numSequences > 1)
+            {
+                m_packedValues.assign(numRows * numCols, 0);
+                for (size_t s = 0; s < numSequences; s++)
+                {
+                    const auto& input = requests[s]->m_inputs[i];
+                    for (size_t t = 0; t < input.m_numCols; t++)
+                        memcpy(&m_packedValues[(t * numSequences + s) * numRows], input.m_buffer + t * numRows, numRows * sizeof(ElemType));
+                }
+                data = m_packedValues.data();
+            }
+            // const cast: The matrix class takes this over without copying and could theoretically change the contents,
+            // though it doesn't in this case.
+            matrix->SetValue(numRows, numCols, matrix->GetDeviceId(), const_cast<ElemType*>(data), matrixFlagNormal);
+        }
         else if (type == MatrixType::SPARSE)
         {
+            const auto& first = requests[0]->m_inputs[i];
+            const ElemType* values = first.m_buffer;
+            const int* indices = first.m_indices;
+            const int* colIndices = first.m_colIndices;
+            size_t numValues = first.m_bufferSize;
+            if (numSequences > 1)
+            {
+                m_packedValues.clear();
+                m_packedIndices.clear();
+                m_packedColIndices.assign(1, 0);
+                for (size_t t = 0; t < numTimeSteps; t++)
+                {
+                    for (size_t s = 0; s < numSequences; s++)
+                    {
+                        const auto& input = requests[s]->m_inputs[i];
+                        if (t < input.m_numCols)
+                        {
+                            m_packedValues.insert(m_packedValues.end(), input.m_buffer + input.m_colIndices[t], input.m_buffer + input.m_colIndices[t + 1]);
+                            m_packedIndices.insert(m_packedIndices.end(), input.m_indices + input.m_colIndices[t], input.m_indices + input.m_colIndices[t + 1]);
+                        }
+                        m_packedColIndices.push_back((int)m_packedIndices.size());
+                    }
+                }
+                values = m_packedValues.data();
+                indices = m_packedIndices.data();
+                colIndices = m_packedColIndices.data();
+                numValues = m_packedValues.size();
+            }
             // In the sparse case the m_data layout is identical to CUDA's CSC layout
             // (see http://docs.nvidia.com/cuda/cusparse/#compressed-sparse-column-format-csc).
-            matrix->SetMatrixFromCSCFormat(buffer.m_colIndices.data(), buffer.m_indices.data(), buffer.m_buffer.data(),
-                                           buffer.m_buffer.size(), numRows, numCols);
+            matrix->SetMatrixFromCSCFormat(colIndices, indices, values, numValues, numRows, numCols);
         }
 
         ++i;
@@ -389,26 +512,91 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
             pMBLayout->InitAsFrameMode(1); // treat this as if we have one single sample
         }
 
-        const auto& seq = pMBLayout->GetAllSequences();
-        if (seq.size() != 1)
-            RuntimeError("Only 1 output sequence supported by this API");
-
-        ValueContainer<ElemType>& vec = outputs[i2].m_buffer;
-
         size_t numElements = outputMatrix->GetNumElements();
+        m_outputValues.resize(numElements);
+        if (numElements > 0)
+        {
+            ElemType* data = m_outputValues.data();
+            outputMatrix->CopyToArray(data, numElements);
+        }
 
-        if (vec.capacity() < numElements)
+        const auto& seq = pMBLayout->GetAllSequences();
+        if (numSequences == 1)
         {
-            // Bad luck - we can't reallocate memory of an external object at this point.
-            RuntimeError("Not enough space in output buffer for output '%ls'.", node->GetName().c_str());
+            // the request gets the entire output
+            if (node->HasMBLayout() && seq.size() != 1)
+                RuntimeError("Only 1 output sequence supported by this API");
+
+            try
+            {
+                requests[0]->m_setOutput(i2, m_outputValues.data(), numElements);
+            }
+            catch (...)
+            {
+                if (!requests[0]->m_error)
+                    requests[0]->m_error = std::current_exception();
+            }
+            continue;
         }
 
-        vec.resize(numElements);
-        ElemType* data = const_cast<ElemType*>(vec.data());
-        outputMatrix->CopyToArray(data, numElements);
+        // each request gets its own sequence
+        size_t numRows = outputMatrix->GetNumRows();
+        size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+        size_t numTimeSteps = pMBLayout->GetNumTimeSteps();
+        std::vector<bool> found(numSequences, false);
+        for (const auto& sequence : seq)
+        {
+            if (sequence.seqId == GAP_SEQUENCE_ID)
+                continue;
+            if (sequence.seqId >= numSequences || found[sequence.seqId])
+                RuntimeError("Output '%ls': Unexpected sequence %d in the output of a batched forward pass.", node->GetName().c_str(), (int)sequence.seqId);
+            found[sequence.seqId] = true;
+
+            size_t tBegin = (size_t)max(sequence.tBegin, (ptrdiff_t)0);
+            size_t tEnd = min(sequence.tEnd, numTimeSteps);
+            m_requestOutputValues.resize(numRows * (tEnd - tBegin));
+            for (size_t t = tBegin; t < tEnd; t++)
+                memcpy(&m_requestOutputValues[(t - tBegin) * numRows], &m_outputValues[(t * numParallelSequences + sequence.s) * numRows], numRows * sizeof(ElemType));
+
+            auto& request = requests[sequence.seqId];
+            try
+            {
+                request->m_setOutput(i2, m_requestOutputValues.data(), m_requestOutputValues.size());
+            }
+            catch (...)
+            {
+                if (!request->m_error)
+                    request->m_error = std::current_exception();
+            }
+        }
+        for (size_t s = 0; s < numSequences; s++)
+            if (!found[s])
+                RuntimeError("Output '%ls': The output of a batched forward pass is missing sequence %d.", node->GetName().c_str(), (int)s);
     }
 }
 
+template<typename ElemType>
+bool CNTKEvalExtended<ElemType>::CanBatchRequests() const
+{
+    for (const auto& node : m_outputNodes)
+    {
+        // without a dynamic axis the output is the same for all sequences, e.g. a sum over all samples
+        if (!node->HasMBLayout())
+            return false;
+    }
+    return true;
+}
+
+template<typename ElemType>
+template<template<typename> class ValueContainer>
+void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<ElemType, ValueContainer> >& inputs, std::vector<ValueBuffer<ElemType, ValueContainer> >& outputs, bool resetRNN)
+{
+    EvalRequest<ElemType> request = CreateRequest(inputs, outputs, resetRNN);
+    ForwardPassBatch({ &request });
+    if (request.m_error)
+        std::rethrow_exception(request.m_error);
+}
+
 template<typename ElemType>
 void CNTKEvalExtended<ElemType>::ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& outputs)
 {
@@ -459,4 +647,274 @@ extern "C" EVAL_API void GetEvalExtendedD(IEvaluateModelExtended<double>** peval
 
 template class CNTKEvalExtended<double>;
 template class CNTKEvalExtended<float>;
+
+// ----------------------------------------------------------------------------
+// Batched interface
+// ----------------------------------------------------------------------------
+
+template <typename ElemType>
+CNTKEvalBatched<ElemType>::CNTKEvalBatched() :
+    m_eval(new CNTKEvalExtended<ElemType>()),
+    m_maxBatchSize(32),
+    m_maxBatchLatency(std::chrono::milliseconds(2)),
+    m_batchRequests(true),
+    m_stopWorker(true),
+    m_numRequests(0),
+    m_numBatches(0)
+{
+    ResetBatchingStatistics();
+}
+
+template <typename ElemType>
+void CNTKEvalBatched<ElemType>::ReadBatchingParameters(const std::string& config)
+{
+    ConfigParameters parameters;
+    parameters.Parse(config);
+    m_maxBatchSize = parameters(L"maxBatchSize", m_maxBatchSize);
+    if (m_maxBatchSize < 1)
+        InvalidArgument("maxBatchSize must be at least 1.");
+
+    double maxBatchLatencyMs = parameters(L"maxBatchLatencyMs", std::chrono::duration<double, std::milli>(m_maxBatchLatency).count());
+    if (maxBatchLatencyMs < 0)
+        InvalidArgument("maxBatchLatencyMs must not be negative.");
+    m_maxBatchLatency = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(maxBatchLatencyMs));
+
+    // the statistics refer to the batching configuration
+    ResetBatchingStatistics();
+}
+
+template <typename ElemType>
+void CNTKEvalBatched<ElemType>::Init(const std::string& config)
+{
+    m_eval->Init(config);
+    ReadBatchingParameters(config);
+}
+
+template <typename ElemType>
+void CNTKEvalBatched<ElemType>::CreateNetwork(const std::string& networkDescription)
+{
+    StopWorker();
+    m_eval->CreateNetwork(networkDescription);
+    ReadBatchingParameters(networkDescription);
+}
+
+template <typename ElemType>
+void CNTKEvalBatched<ElemType>::StartForwardEvaluation(const std::vector<wstring>& outputs)
+{
+    // the network must not be used by the worker while it is being reconfigured
+    StopWorker();
+    m_eval->StartForwardEvaluation(outputs);
+    m_batchRequests = m_eval->CanBatchRequests();
+    StartWorker();
+}
+
+template <typename ElemType>
+void CNTKEvalBatched<ElemType>::StartWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopWorker = false;
+    }
+    m_worker = std::thread([this] { Worker(); });
+}
+
+// Stops the worker thread after it has evaluated all queued requests. Requests arriving from now on are rejected.
+template <typename ElemType>
+void CNTKEvalBatched<ElemType>::StopWorker()
+{
+    if (!m_worker.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopWorker = true;
+    }
+    m_requestArrived.notify_all();
+    m_worker.join();
+}
+
+template <typename ElemType>
+void CNTKEvalBatched<ElemType>::Worker()
+{
+    const size_t maxBatchSize = m_batchRequests ? m_maxBatchSize : 1;
+    std::vector<PendingRequest*> batch;
+    std::vector<EvalRequest<ElemType>*> requests;
+    for (;;)
+    {
+        batch.clear();
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_requestArrived.wait(lock, [this] { return m_stopWorker || !m_queue.empty(); });
+            if (m_queue.empty()) // we are asked to stop and all requests are done
+                return;
+
+            // give further requests a chance to arrive, until the batch is full or the oldest request has waited long enough
+            m_requestArrived.wait_until(lock, m_queue.front()->m_arrivalTime + m_maxBatchLatency,
+                                        [this, maxBatchSize] { return m_stopWorker || m_queue.size() >= maxBatchSize; });
+
+            do
+            {
+                batch.push_back(m_queue.front());
+                m_queue.pop_front();
+            } while (batch.size() < maxBatchSize && !m_queue.empty());
+        }
+
+        requests.clear();
+        for (auto pending : batch)
+            requests.push_back(&pending->m_request);
+        try
+        {
+            m_eval->ForwardPassBatch(requests);
+        }
+        catch (...)
+        {
+            for (auto request : requests)
+                if (!request->m_error)
+                    request->m_error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_statisticsMutex);
+            m_numBatches++;
+            if (m_batchSizeHistogram.size() <= batch.size())
+                m_batchSizeHistogram.resize(batch.size() + 1, 0);
+            m_batchSizeHistogram[batch.size()]++;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto pending : batch)
+                pending->m_done = true;
+        }
+        m_requestDone.notify_all();
+    }
+}
+
+template <typename ElemType>
+template <template<typename> class ValueContainer>
+void CNTKEvalBatched<ElemType>::ForwardPassT(const std::vector<ValueBuffer<ElemType, ValueContainer> >& inputs, std::vector<ValueBuffer<ElemType, ValueContainer> >& outputs, bool resetRNN)
+{
+    // Every request is a sequence of its own in a forward pass shared with other callers, so there is no RNN state of this caller to continue.
+    if (!resetRNN)
+        RuntimeError("ForwardPass() with resetRNN == false is not supported when requests are batched.");
+
+    PendingRequest pending;
+    pending.m_arrivalTime = Clock::now();
+    pending.m_done = false;
+    pending.m_request = m_eval->CreateRequest(inputs, outputs, resetRNN); // validates the inputs on the caller's thread
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        // the worker may already have returned, so the request would never be evaluated
+        if (m_stopWorker)
+            RuntimeError("ForwardPass() called before StartForwardEvaluation(), or while the evaluator is reconfigured or destroyed");
+        m_queue.push_back(&pending);
+        m_requestArrived.notify_one();
+        m_requestDone.wait(lock, [&pending] { return pending.m_done; });
+    }
+
+    double latency = std::chrono::duration<double, std::milli>(Clock::now() - pending.m_arrivalTime).count();
+    {
+        std::lock_guard<std::mutex> lock(m_statisticsMutex);
+        size_t bucket = 0;
+        while (bucket + 1 < m_latencyHistogram.size() && latency * 1000 >= (double)(1ull << bucket))
+            bucket++;
+        m_latencyHistogram[bucket]++;
+        if (m_latencies.size() < LatencyWindowSize)
+            m_latencies.push_back(latency);
+        else
+            m_latencies[m_numRequests % LatencyWindowSize] = latency;
+        m_numRequests++;
+    }
+
+    if (pending.m_request.m_error)
+        std::rethrow_exception(pending.m_request.m_error);
+}
+
+template <typename ElemType>
+void CNTKEvalBatched<ElemType>::ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& outputs)
+{
+    ForwardPassT(inputs, outputs, true);
+}
+
+template <typename ElemType>
+void CNTKEvalBatched<ElemType>::ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& outputs, bool resetRNN)
+{
+    ForwardPassT(inputs, outputs, resetRNN);
+}
+
+template <typename ElemType>
+void CNTKEvalBatched<ElemType>::ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& outputs)
+{
+    ForwardPassT(inputs, outputs, true);
+}
+
+template <typename ElemType>
+void CNTKEvalBatched<ElemType>::ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& outputs, bool resetRNN)
+{
+    ForwardPassT(inputs, outputs, resetRNN);
+}
+
+template <typename ElemType>
+void CNTKEvalBatched<ElemType>::GetBatchingStatistics(BatchingStatistics& statistics) const
+{
+    std::vector<double> latencies;
+    {
+        std::lock_guard<std::mutex> lock(m_statisticsMutex);
+        statistics.m_numRequests = m_numRequests;
+        statistics.m_numBatches = m_numBatches;
+        statistics.m_batchSizeHistogram = m_batchSizeHistogram;
+        statistics.m_latencyHistogram = m_latencyHistogram;
+        latencies = m_latencies;
+    }
+
+    auto percentile = [&latencies](double p)
+    {
+        if (latencies.empty())
+            return 0.0;
+        auto nth = latencies.begin() + min((size_t)(p * latencies.size()), latencies.size() - 1);
+        std::nth_element(latencies.begin(), nth, latencies.end());
+        return *nth;
+    };
+    statistics.m_latencyP50 = percentile(0.5);
+    statistics.m_latencyP90 = percentile(0.9);
+    statistics.m_latencyP99 = percentile(0.99);
+    statistics.m_latencyMax = percentile(1.0);
+}
+
+template <typename ElemType>
+void CNTKEvalBatched<ElemType>::ResetBatchingStatistics()
+{
+    std::lock_guard<std::mutex> lock(m_statisticsMutex);
+    m_numRequests = 0;
+    m_numBatches = 0;
+    m_batchSizeHistogram.assign(m_maxBatchSize + 1, 0);
+    m_latencyHistogram.assign(32, 0); // up to 2^31 microseconds
+    m_latencies.clear();
+}
+
+template <typename ElemType>
+void CNTKEvalBatched<ElemType>::Destroy()
+{
+    StopWorker();
+    m_eval->Destroy();
+    delete this;
+}
+
+template <typename ElemType>
+void EVAL_API GetEvalBatched(IEvaluateModelBatched<ElemType>** peval)
+{
+    *peval = new CNTKEvalBatched<ElemType>();
+}
+
+extern "C" EVAL_API void GetEvalBatchedF(IEvaluateModelBatched<float>** peval)
+{
+    GetEvalBatched(peval);
+}
+extern "C" EVAL_API void GetEvalBatchedD(IEvaluateModelBatched<double>** peval)
+{
+    GetEvalBatched(peval);
+}
+
+template class CNTKEvalBatched<double>;
+template class CNTKEvalBatched<float>;
 } } }
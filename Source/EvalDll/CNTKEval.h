@@ -13,6 +13,13 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <deque>
+#include <functional>
+#include <exception>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
 
 #include "Eval.h"
 #include "EvalReader.h"
@@ -86,6 +93,33 @@ public:
 // ------------------------------------------------------------------------
 // Extended interface
 // ------------------------------------------------------------------------
+
+// A single request for a forward pass, independent of the container type of the caller's buffers.
+// Several requests can be evaluated together by CNTKEvalExtended::ForwardPassBatch().
+template <typename ElemType>
+struct EvalRequest
+{
+    // Input data of the request, pointing into the caller's ValueBuffer. For dense inputs only m_buffer is used.
+    struct Input
+    {
+        const ElemType* m_buffer;
+        size_t m_bufferSize;
+        const int* m_indices;
+        size_t m_indicesSize;
+        const int* m_colIndices;
+        size_t m_colIndicesSize;
+        size_t m_numCols; // number of samples in the sequence
+    };
+    std::vector<Input> m_inputs;
+    bool m_resetRNN;
+
+    // Receives the value of output [i] for this request. Called once per output.
+    std::function<void(size_t i, const ElemType* data, size_t numElements)> m_setOutput;
+
+    // Set if the outputs could not be handed to m_setOutput (e.g. a buffer was too small).
+    std::exception_ptr m_error;
+};
+
 template <typename ElemType>
 class CNTKEvalExtended : public CNTKEvalBase<ElemType>, public IEvaluateModelExtended<ElemType>
 {
@@ -119,6 +153,21 @@ public:
         CNTKEvalBase<ElemType>::Init(config);
     }
 
+    // Validates the inputs and wraps inputs and outputs into a request for ForwardPassBatch().
+    // The buffers must stay alive until the request has been evaluated.
+    template<template<typename> class ValueContainer>
+    EvalRequest<ElemType> CreateRequest(const std::vector < ValueBuffer<ElemType, ValueContainer> >& inputs,
+                                        std::vector < ValueBuffer<ElemType, ValueContainer> >& outputs, bool resetRNN) const;
+
+    // Evaluates the requests in a single forward pass, each as a separate parallel sequence.
+    // Several requests must all reset the RNN state, and require CanBatchRequests().
+    // Errors while handing back the outputs of a request are stored in its m_error.
+    void ForwardPassBatch(const std::vector<EvalRequest<ElemType>*>& requests);
+
+    // Whether the outputs of several requests evaluated together can be split between them, i.e. all outputs
+    // have a dynamic axis. Valid after StartForwardEvaluation().
+    bool CanBatchRequests() const;
+
 private:
     static VariableLayout ToVariableLayout(const ComputationNodeBasePtr n);
     std::vector<ComputationNodeBasePtr> m_outputNodes;
@@ -127,9 +176,93 @@ private:
     StreamMinibatchInputs m_inputMatrices;
     bool m_started;
 
+    // buffers for packing the inputs and unpacking the outputs of several requests
+    std::vector<ElemType> m_packedValues;
+    std::vector<int> m_packedIndices;
+    std::vector<int> m_packedColIndices;
+    std::vector<ElemType> m_outputValues;
+    std::vector<ElemType> m_requestOutputValues;
+
     template<template<typename> class ValueContainer> 
     void ForwardPassT(const std::vector < ValueBuffer<ElemType, ValueContainer> >& inputs,
                       std::vector < ValueBuffer<ElemType, ValueContainer> >& outputs, bool resetRNN);
 
 };
+
+// ------------------------------------------------------------------------
+// Batched interface
+// ------------------------------------------------------------------------
+template <typename ElemType>
+class CNTKEvalBatched : public IEvaluateModelBatched<ElemType>
+{
+public:
+    CNTKEvalBatched();
+
+    virtual VariableSchema GetOutputSchema() const override { return m_eval->GetOutputSchema(); }
+
+    virtual void StartForwardEvaluation(const std::vector<wstring>& outputs) override;
+
+    virtual VariableSchema GetInputSchema() const override { return m_eval->GetInputSchema(); }
+
+    virtual void ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& output) override;
+
+    virtual void ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& output, bool resetRNN) override;
+
+    virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output) override;
+
+    virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output, bool resetRNN) override;
+
+    virtual void GetBatchingStatistics(BatchingStatistics& statistics) const override;
+
+    virtual void ResetBatchingStatistics() override;
+
+    virtual void Destroy() override;
+
+    virtual void CreateNetwork(const std::string& networkDescription) override;
+
+    virtual void Init(const std::string& config) override;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    // A request waiting in the queue.
+    struct PendingRequest
+    {
+        EvalRequest<ElemType> m_request;
+        Clock::time_point m_arrivalTime;
+        bool m_done;
+    };
+
+    void ReadBatchingParameters(const std::string& config);
+    void StartWorker();
+    void StopWorker();
+    void Worker();
+
+    template<template<typename> class ValueContainer>
+    void ForwardPassT(const std::vector < ValueBuffer<ElemType, ValueContainer> >& inputs,
+                      std::vector < ValueBuffer<ElemType, ValueContainer> >& outputs, bool resetRNN);
+
+    CNTKEvalExtended<ElemType>* m_eval; // does the actual evaluation, only called from the worker thread after StartForwardEvaluation()
+
+    size_t m_maxBatchSize;
+    Clock::duration m_maxBatchLatency;
+    bool m_batchRequests; // false if the outputs cannot be split between requests, see CNTKEvalExtended::CanBatchRequests()
+
+    // request queue, guarded by m_mutex
+    std::mutex m_mutex;
+    std::condition_variable m_requestArrived;
+    std::condition_variable m_requestDone;
+    std::deque<PendingRequest*> m_queue;
+    bool m_stopWorker; // set while no worker is running or it is being stopped; new requests are rejected
+    std::thread m_worker;
+
+    // statistics, guarded by m_statisticsMutex
+    static const size_t LatencyWindowSize = 16384;
+    mutable std::mutex m_statisticsMutex;
+    size_t m_numRequests;
+    size_t m_numBatches;
+    std::vector<size_t> m_batchSizeHistogram;
+    std::vector<size_t> m_latencyHistogram;
+    std::vector<double> m_latencies; // [i % LatencyWindowSize] latency of request i in milliseconds
+};
 } } }
@@ -3,6 +3,10 @@
 // Licensed under the MIT license. See LICENSE.md file in the project root for full licence information.
 //
 #include "stdafx.h"
+
+// Like BlockHandlerSSE, not available on ARM64.
+#if !defined(__aarch64__)
+
 #include <malloc.h>
 #include <xmmintrin.h>
 #include <emmintrin.h>
@@ -34,7 +38,7 @@ int BlockHandlerAVX::RowToColOffsetRewrittenB(int col, int kOffset, int blockSiz
 
 
 
-void BlockHandlerAVX::DumpM256(__m256i dumpMe)
+TARGET_AVX2 void BlockHandlerAVX::DumpM256(__m256i dumpMe)
 {
     union { int32_t i[8]; __m256i y; } u;
     u.y = dumpMe;
@@ -46,3 +50,5 @@ void BlockHandlerAVX::DumpM256(__m256i dumpMe)
 }
 
 }}}
+
+#endif
@@ -20,23 +20,23 @@ class MATH_API BlockHandlerAVX
 
     private:
         //USE SSE for the blocks of 8, borrowed from BlockHandlerSSE
-        FORCEINLINE static void kernelsse8x4(__m128i xmmRow0, __m128i xmmRow1, __m128i xmmRow2, __m128i xmmRow3, 
+        FORCEINLINE TARGET_AVX2 static void kernelsse8x4(__m128i xmmRow0, __m128i xmmRow1, __m128i xmmRow2, __m128i xmmRow3, 
                 short* B, __m128i* return1, __m128i* return2, __m128i* return3, __m128i* return4);
-        FORCEINLINE static void kernelavx16x4(__m256i xmmRow0B0a, __m256i xmmRow1B0a, __m256i xmmRow2B0a, __m256i xmmRow3B0a,
+        FORCEINLINE TARGET_AVX2 static void kernelavx16x4(__m256i xmmRow0B0a, __m256i xmmRow1B0a, __m256i xmmRow2B0a, __m256i xmmRow3B0a,
                 short* B, __m256i* return1, __m256i* return2, __m256i * return3, __m256i* return4);
-        FORCEINLINE static void kernelavx32x4(
+        FORCEINLINE TARGET_AVX2 static void kernelavx32x4(
                 __m256i xmmRow0B0a, __m256i xmmRow0B0b,
                 __m256i xmmRow1B0a, __m256i xmmRow1B0b,
                 __m256i xmmRow2B0a, __m256i xmmRow2B0b,
                 __m256i xmmRow3B0a, __m256i xmmRow3B0b,
                 short* B, __m256i* return1, __m256i* return2, __m256i * return3, __m256i* return4);
-        FORCEINLINE static void kernelavx64x4(
+        FORCEINLINE TARGET_AVX2 static void kernelavx64x4(
                 __m256i xmmRow0B0a, __m256i xmmRow0B0b, __m256i xmmRow0B0c, __m256i xmmRow0B0d,
                 __m256i xmmRow1B0a, __m256i xmmRow1B0b, __m256i xmmRow1B0c, __m256i xmmRow1B0d,
                 __m256i xmmRow2B0a, __m256i xmmRow2B0b, __m256i xmmRow2B0c, __m256i xmmRow2B0d,
                 __m256i xmmRow3B0a, __m256i xmmRow3B0b, __m256i xmmRow3B0c, __m256i xmmRow3B0d,
                 short* B, __m256i* return1, __m256i* return2, __m256i * return3, __m256i* return4);
-        FORCEINLINE static void kernelavx128x4(
+        FORCEINLINE TARGET_AVX2 static void kernelavx128x4(
                 __m256i xmmRow0B0a, __m256i xmmRow0B0b, __m256i xmmRow0B0c, __m256i xmmRow0B0d,
                 __m256i xmmRow0B0e, __m256i xmmRow0B0f, __m256i xmmRow0B0g, __m256i xmmRow0B0h,
                 __m256i xmmRow1B0a, __m256i xmmRow1B0b, __m256i xmmRow1B0c, __m256i xmmRow1B0d,
@@ -47,17 +47,17 @@ class MATH_API BlockHandlerAVX
                 __m256i xmmRow3B0e, __m256i xmmRow3B0f, __m256i xmmRow3B0g, __m256i xmmRow3B0h,
                 short* B, __m256i* return1, __m256i* return2, __m256i* return3, __m256i* return4);
 
-        FORCEINLINE static void kernelsse8x1(__m128i xmmRow0, 
+        FORCEINLINE TARGET_AVX2 static void kernelsse8x1(__m128i xmmRow0, 
                 short* B, __m128i* return1);
-        FORCEINLINE static void kernelavx16x1(__m256i xmmRow0B0a, 
+        FORCEINLINE TARGET_AVX2 static void kernelavx16x1(__m256i xmmRow0B0a, 
                 short* B, __m256i* return1 );
-        FORCEINLINE static void kernelavx32x1(
+        FORCEINLINE TARGET_AVX2 static void kernelavx32x1(
                 __m256i xmmRow0B0a, __m256i xmmRow0B0b,
                 short* B, __m256i* return1);
-        FORCEINLINE static void kernelavx64x1(
+        FORCEINLINE TARGET_AVX2 static void kernelavx64x1(
                 __m256i xmmRow0B0a, __m256i xmmRow0B0b, __m256i xmmRow0B0c, __m256i xmmRow0B0d,
                 short* B, __m256i* return1) ;
-        FORCEINLINE static void kernelavx128x1(
+        FORCEINLINE TARGET_AVX2 static void kernelavx128x1(
                 __m256i xmmRow0B0a, __m256i xmmRow0B0b, __m256i xmmRow0B0c, __m256i xmmRow0B0d,
                 __m256i xmmRow0B0e, __m256i xmmRow0B0f, __m256i xmmRow0B0g, __m256i xmmRow0B0h,
                 short* B, __m256i* return1);
@@ -67,38 +67,38 @@ class MATH_API BlockHandlerAVX
         //static class.
         static int RowToColOffsetRewrittenB(int col, int kOffset, int blockSize, int origCols);
         static int RowToColOffsetRewrittenA(int row, int kOffset, int blockSize, int rowsPerBlock, int origCols);
-        static void DumpM256(__m256i dumpMe);
+        TARGET_AVX2 static void DumpM256(__m256i dumpMe);
     public:
         typedef __m256i VectorT;
         typedef int16_t ScalarAT;
         typedef int16_t ScalarBT;
         typedef int32_t ScalarCT;
-        FORCEINLINE static void HandleBlock8x4(int currBlock, int startRow, int k, int n, short* newA, short* B, 
+        FORCEINLINE TARGET_AVX2 static void HandleBlock8x4(int currBlock, int startRow, int k, int n, short* newA, short* B, 
                 int blockCnt, __m128i* resultStorage);
-        FORCEINLINE static void HandleBlock32x4(int currBlock, int startRow, int k, int n, short* newA, short* B, 
+        FORCEINLINE TARGET_AVX2 static void HandleBlock32x4(int currBlock, int startRow, int k, int n, short* newA, short* B, 
                 int blockCnt, __m256i* resultStorage);
-        FORCEINLINE static void HandleBlock64x4(int currBlock, int startRow, int k, int n, short* newA, short* B, 
+        FORCEINLINE TARGET_AVX2 static void HandleBlock64x4(int currBlock, int startRow, int k, int n, short* newA, short* B, 
                 int blockCnt, __m256i* resultStorage);
-        FORCEINLINE static void HandleBlock128x4(int currBlock, int startRow, int k, int n, short* newA, short* B,
+        FORCEINLINE TARGET_AVX2 static void HandleBlock128x4(int currBlock, int startRow, int k, int n, short* newA, short* B,
                 int blockCnt, __m256i* resultStorage, VectorT* subtractMe);
 
-        FORCEINLINE static void HandleBlock8x1(int currBlock, int startRow, int k, int n, short* newA, short* B, 
+        FORCEINLINE TARGET_AVX2 static void HandleBlock8x1(int currBlock, int startRow, int k, int n, short* newA, short* B, 
                 int blockCnt, __m128i* resultStorage);
-        FORCEINLINE static void HandleBlock16x1(int currBlock, int startRow, int k, int n, short* newA, short* B,  
+        FORCEINLINE TARGET_AVX2 static void HandleBlock16x1(int currBlock, int startRow, int k, int n, short* newA, short* B,  
                 int blockCnt, __m256i* resultStorage);
-        FORCEINLINE static void HandleBlock64x1(int currBlock, int startRow, int k, int n, short* newA, short* B, 
+        FORCEINLINE TARGET_AVX2 static void HandleBlock64x1(int currBlock, int startRow, int k, int n, short* newA, short* B, 
                 int blockCnt, __m256i* resultStorage);
-        FORCEINLINE static void HandleBlock128x1(int currBlock, int startRow, int k, int n, short* newA, short* B,
+        FORCEINLINE TARGET_AVX2 static void HandleBlock128x1(int currBlock, int startRow, int k, int n, short* newA, short* B,
                 int blockCnt, __m256i* resultStorage, VectorT* subtractMe);
 
-        FORCEINLINE static void HandleBlock16x4(int currBlock, int startRow, int k, int n, short* newA, short* B,  
+        FORCEINLINE TARGET_AVX2 static void HandleBlock16x4(int currBlock, int startRow, int k, int n, short* newA, short* B,  
                 int blockCnt, __m256i* resultStorage);
 
 
 
         //FORCEINLINE static void HandleBlock128x4(int currBlock, int startRow, int m, int k, int n, short* newA, short* B, 
 
-        FORCEINLINE static void HandleBlock32x1(int currBlock, int startRow, int k, int n, short* newA, short* B, 
+        FORCEINLINE TARGET_AVX2 static void HandleBlock32x1(int currBlock, int startRow, int k, int n, short* newA, short* B, 
                 int blockCnt, __m256i* resultStorage);
 
         static VectorT* PrepareExtraB(const ScalarBT* /*prepareMe*/, int /*k*/, int /*n*/)
@@ -269,7 +269,7 @@ __m128i r3b0a = _mm_load_si128((__m128i*)currA + 3);\
 #define LOAD_8x1 \
     __m128i r0b0a = _mm_load_si128((__m128i*)currA);
 
-FORCEINLINE void BlockHandlerAVX::HandleBlock8x4(int currBlock, int startRow, int k, int n, short* newA, short* B, 
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::HandleBlock8x4(int currBlock, int startRow, int k, int n, short* newA, short* B, 
         int blockCnt, __m128i* resultStorage)
 {
     blockCnt; //warning 4100
@@ -293,10 +293,10 @@ FORCEINLINE void BlockHandlerAVX::HandleBlock8x4(int currBlock, int startRow, in
     }
 }
 
-FORCEINLINE void BlockHandlerAVX::HandleBlock8x1(int currBlock, int startRow, int k, int n, short* newA, short* B, 
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::HandleBlock8x1(int currBlock, int startRow, int k, int n, short* newA, short* B, 
         int /*blockCnt*/, __m128i* resultStorage)
 {
-    int aOffset = RowToColOffsetRewrittenA(startRow, currBlock, 8, 4, k);
+    int aOffset = RowToColOffsetRewrittenA(startRow, currBlock, 8, 1, k);
     short* currA = &newA[aOffset];
     LOAD_8x1;
     for (int c = 0; c < n; ++c)
@@ -312,7 +312,7 @@ FORCEINLINE void BlockHandlerAVX::HandleBlock8x1(int currBlock, int startRow, in
 
 
 
-FORCEINLINE void BlockHandlerAVX::HandleBlock16x4(int currBlock, int startRow, int k, int n, short* newA, short* B, 
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::HandleBlock16x4(int currBlock, int startRow, int k, int n, short* newA, short* B, 
         int /*blockCnt*/, __m256i* resultStorage) 
 {
     int aOffset = RowToColOffsetRewrittenA(startRow, currBlock, 16, 4, k);
@@ -342,7 +342,7 @@ FORCEINLINE void BlockHandlerAVX::HandleBlock16x4(int currBlock, int startRow, i
     }
 }
 
-FORCEINLINE void BlockHandlerAVX::HandleBlock16x1(int currBlock, int startRow, int k, int n, short* newA, short* B,  
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::HandleBlock16x1(int currBlock, int startRow, int k, int n, short* newA, short* B,  
         int /*blockCnt*/, __m256i* resultStorage) 
 {
     int aOffset = RowToColOffsetRewrittenA(startRow, currBlock, 16, 1, k);
@@ -369,7 +369,7 @@ FORCEINLINE void BlockHandlerAVX::HandleBlock16x1(int currBlock, int startRow, i
 
 
 
-FORCEINLINE void BlockHandlerAVX::HandleBlock32x4(int currBlock, int startRow, int k, int n, short* newA, short* B, 
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::HandleBlock32x4(int currBlock, int startRow, int k, int n, short* newA, short* B, 
         int /*blockCnt*/, __m256i* resultStorage)
 {
     int aOffset = RowToColOffsetRewrittenA(startRow, currBlock, 32, 4, k);
@@ -404,7 +404,7 @@ FORCEINLINE void BlockHandlerAVX::HandleBlock32x4(int currBlock, int startRow, i
     }
 }
 
-FORCEINLINE void BlockHandlerAVX::HandleBlock32x1(int currBlock, int startRow, int k, int n, short* newA, short* B, 
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::HandleBlock32x1(int currBlock, int startRow, int k, int n, short* newA, short* B, 
         int /*blockCnt*/, __m256i* resultStorage)
 {
     int aOffset = RowToColOffsetRewrittenA(startRow, currBlock, 32, 1, k);
@@ -427,7 +427,7 @@ FORCEINLINE void BlockHandlerAVX::HandleBlock32x1(int currBlock, int startRow, i
     }
 }
 
-FORCEINLINE void BlockHandlerAVX::HandleBlock64x4(int currBlock, int startRow, int k, int n, short* newA, short* B, 
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::HandleBlock64x4(int currBlock, int startRow, int k, int n, short* newA, short* B, 
         int /*blockCnt*/, __m256i* resultStorage)
 {
 
@@ -463,10 +463,10 @@ FORCEINLINE void BlockHandlerAVX::HandleBlock64x4(int currBlock, int startRow, i
     }
 }
 
-FORCEINLINE void BlockHandlerAVX::HandleBlock64x1(int currBlock, int startRow, int k, int n, short* newA, short* B, 
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::HandleBlock64x1(int currBlock, int startRow, int k, int n, short* newA, short* B, 
         int /*blockCnt*/, __m256i* resultStorage)
 {
-    int aOffset = RowToColOffsetRewrittenA(startRow, currBlock, 64, 4, k);
+    int aOffset = RowToColOffsetRewrittenA(startRow, currBlock, 64, 1, k);
     short* currA = &newA[aOffset];
     LOADAVX_64x1;
     //#pragma omp parallel for
@@ -494,7 +494,7 @@ FORCEINLINE void BlockHandlerAVX::HandleBlock64x1(int currBlock, int startRow, i
 
 
 
-FORCEINLINE void BlockHandlerAVX::HandleBlock128x4(int currBlock, int startRow, int k, int n, short* newA, short* B,  
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::HandleBlock128x4(int currBlock, int startRow, int k, int n, short* newA, short* B,  
         int blockCnt, __m256i* resultStorage, VectorT* /*subtractMe*/)
 {
 
@@ -549,11 +549,11 @@ FORCEINLINE void BlockHandlerAVX::HandleBlock128x4(int currBlock, int startRow,
 }
 
 
-FORCEINLINE void BlockHandlerAVX::HandleBlock128x1(int currBlock, int startRow, int k, int n, short* newA, short* B,  
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::HandleBlock128x1(int currBlock, int startRow, int k, int n, short* newA, short* B,  
         int blockCnt, __m256i* resultStorage, VectorT* /*subtractMe*/)
 {
-    int aOffset = RowToColOffsetRewrittenA(startRow, currBlock, 128, 4, k);
-    int aOffset2 = RowToColOffsetRewrittenA(startRow, currBlock + 1, 128, 4, k);
+    int aOffset = RowToColOffsetRewrittenA(startRow, currBlock, 128, 1, k);
+    int aOffset2 = RowToColOffsetRewrittenA(startRow, currBlock + 1, 128, 1, k);
     short* currA = &newA[aOffset];
     short* currA2 = &newA[aOffset2];
     LOADAVX_128x1;
@@ -578,14 +578,14 @@ FORCEINLINE void BlockHandlerAVX::HandleBlock128x1(int currBlock, int startRow,
         {
             kernelavx128x1(
                     r0b0a2, r0b0b2, r0b0c2, r0b0d2, r0b0e2, r0b0f2, r0b0g2, r0b0h2,
-                    currB2, &accum1);
+                    currB2, &accum2);
         }
 
         resultStorage[RowColToOffset(0, c, n)] = _mm256_add_epi32( resultStorage[RowColToOffset(0, c, n)], _mm256_add_epi32(accum1,  accum2));
     }
 }
 
-FORCEINLINE void BlockHandlerAVX::kernelsse8x1(__m128i xmmRow0,
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::kernelsse8x1(__m128i xmmRow0,
         short* B, __m128i* return1)
 {
     __m128i xmmCol0 = _mm_load_si128((__m128i*)B);
@@ -594,7 +594,7 @@ FORCEINLINE void BlockHandlerAVX::kernelsse8x1(__m128i xmmRow0,
 }
 
 
-FORCEINLINE void BlockHandlerAVX::kernelsse8x4(__m128i xmmRow0, __m128i xmmRow1, __m128i xmmRow2, __m128i xmmRow3, 
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::kernelsse8x4(__m128i xmmRow0, __m128i xmmRow1, __m128i xmmRow2, __m128i xmmRow3, 
         short* B, __m128i* return1, __m128i* return2, __m128i* return3, __m128i* return4)
 {
     __m128i xmmCol0 = _mm_load_si128((__m128i*)B);
@@ -609,7 +609,7 @@ FORCEINLINE void BlockHandlerAVX::kernelsse8x4(__m128i xmmRow0, __m128i xmmRow1,
     *return3 = result3;
     *return4 = result4;
 }
-FORCEINLINE void BlockHandlerAVX::kernelavx16x1(__m256i xmmRow0B0a, 
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::kernelavx16x1(__m256i xmmRow0B0a, 
         short* B, __m256i* return1)
 {
 
@@ -627,7 +627,7 @@ FORCEINLINE void BlockHandlerAVX::kernelavx16x1(__m256i xmmRow0B0a,
 
 
 
-FORCEINLINE void BlockHandlerAVX::kernelavx16x4(__m256i xmmRow0B0a, __m256i xmmRow1B0a, __m256i xmmRow2B0a, __m256i xmmRow3B0a, 
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::kernelavx16x4(__m256i xmmRow0B0a, __m256i xmmRow1B0a, __m256i xmmRow2B0a, __m256i xmmRow3B0a, 
         short* B, __m256i* return1, __m256i* return2, __m256i * return3, __m256i* return4)
 {
 
@@ -650,7 +650,7 @@ FORCEINLINE void BlockHandlerAVX::kernelavx16x4(__m256i xmmRow0B0a, __m256i xmmR
     *return4 = r3b0axc0b0a;
 }
 
-FORCEINLINE void BlockHandlerAVX::kernelavx32x1(
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::kernelavx32x1(
         __m256i xmmRow0B0a, __m256i xmmRow0B0b, 
         short* B, __m256i* return1)
 {
@@ -672,7 +672,7 @@ FORCEINLINE void BlockHandlerAVX::kernelavx32x1(
 
 
 
-FORCEINLINE void BlockHandlerAVX::kernelavx32x4(
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::kernelavx32x4(
         __m256i xmmRow0B0a, __m256i xmmRow0B0b, 
         __m256i xmmRow1B0a, __m256i xmmRow1B0b, 
         __m256i xmmRow2B0a, __m256i xmmRow2B0b, 
@@ -720,7 +720,7 @@ FORCEINLINE void BlockHandlerAVX::kernelavx32x4(
     *return4 = result4a;
 }
 
-FORCEINLINE void BlockHandlerAVX::kernelavx64x1(
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::kernelavx64x1(
         __m256i xmmRow0B0a, __m256i xmmRow0B0b, __m256i xmmRow0B0c, __m256i xmmRow0B0d,
         short* B, __m256i* return1)
 {
@@ -747,7 +747,7 @@ FORCEINLINE void BlockHandlerAVX::kernelavx64x1(
 
 
 
-FORCEINLINE void BlockHandlerAVX::kernelavx64x4(
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::kernelavx64x4(
         __m256i xmmRow0B0a, __m256i xmmRow0B0b, __m256i xmmRow0B0c, __m256i xmmRow0B0d,
         __m256i xmmRow1B0a, __m256i xmmRow1B0b, __m256i xmmRow1B0c, __m256i xmmRow1B0d,
         __m256i xmmRow2B0a, __m256i xmmRow2B0b, __m256i xmmRow2B0c, __m256i xmmRow2B0d,
@@ -811,7 +811,7 @@ FORCEINLINE void BlockHandlerAVX::kernelavx64x4(
     *return4 = result4ab;
 }
 
-FORCEINLINE void BlockHandlerAVX::kernelavx128x1(
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::kernelavx128x1(
         __m256i xmmRow0B0a, __m256i xmmRow0B0b, __m256i xmmRow0B0c, __m256i xmmRow0B0d,
         __m256i xmmRow0B0e, __m256i xmmRow0B0f, __m256i xmmRow0B0g, __m256i xmmRow0B0h,
         short* B, __m256i* return1)
@@ -850,7 +850,7 @@ FORCEINLINE void BlockHandlerAVX::kernelavx128x1(
     //std::cout << "Returning " << u.i[0] << " + " << u.i[4] << "(" << u.i[0] + u.i[4] << ") for first row" << std::endl;
 }
 
-FORCEINLINE void BlockHandlerAVX::kernelavx128x4(
+FORCEINLINE TARGET_AVX2 void BlockHandlerAVX::kernelavx128x4(
         __m256i xmmRow0B0a, __m256i xmmRow0B0b, __m256i xmmRow0B0c, __m256i xmmRow0B0d,
         __m256i xmmRow0B0e, __m256i xmmRow0B0f, __m256i xmmRow0B0g, __m256i xmmRow0B0h,
         __m256i xmmRow1B0a, __m256i xmmRow1B0b, __m256i xmmRow1B0c, __m256i xmmRow1B0d,
@@ -0,0 +1,280 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full licence information.
+//
+#pragma once
+#include "BlockMultiplierPlatform.h"
+#include <immintrin.h>
+#include <assert.h>
+#include <cstdint>
+#include "BlockMultiplierMatrixUtil.h"
+#define FOR_CNTK
+#ifdef FOR_CNTK
+#include "CommonMatrix.h"
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Block handlers using AVX-512 instructions (512-bit data path), for 16-bit and 8-bit matrices.
+// The handlers are compiled for AVX-512 through function target attributes and must only be used
+// on processors that support it, see BlockMultiplierDispatch.h for selecting a handler at runtime.
+//
+// Unlike BlockHandlerSSE and BlockHandlerAVX, the kernels are not spelled out per block size.
+// All block sizes share one kernel, parameterized by an "Ops" class for the element type and instruction set:
+//   Load(p, count)              loads count (at most ElementsPerVector) elements of B into a vector, zero padded
+//   LoadA(p, count)             the same for A, in whatever form Accumulate wants it
+//   Accumulate(accum, a, b)     adds the dot products of adjacent elements of a and b to the 32-bit lanes of accum
+// The blocks of 8 use 128-bit registers as BlockMultiplier keeps their partial sums in __m128i.
+
+// vpmaddwd on 16-bit elements (AVX-512BW).
+struct AVX512BWInt16Ops
+{
+    typedef int16_t ScalarT;
+    typedef __m512i AVectorT;
+    static const int ElementsPerVector = 32;
+    static const bool UsesVNNI = false;
+
+    TARGET_AVX512BW FORCEINLINE static __m512i Load(const int16_t* p, int count)
+    {
+        return count == ElementsPerVector ? _mm512_loadu_si512(p) : _mm512_maskz_loadu_epi16((__mmask32)((1ull << count) - 1), p);
+    }
+    TARGET_AVX512BW FORCEINLINE static AVectorT LoadA(const int16_t* p, int count) { return Load(p, count); }
+    TARGET_AVX512BW FORCEINLINE static __m512i Accumulate(__m512i accum, const AVectorT& a, __m512i b)
+    {
+        return _mm512_add_epi32(accum, _mm512_madd_epi16(a, b));
+    }
+};
+
+// vpdpwssd on 16-bit elements (AVX-512 VNNI), fuses the multiply and the accumulation.
+struct AVX512VNNIInt16Ops : public AVX512BWInt16Ops
+{
+    static const bool UsesVNNI = true;
+
+    TARGET_AVX512VNNI FORCEINLINE static __m512i Accumulate(__m512i accum, const AVectorT& a, __m512i b)
+    {
+        return _mm512_dpwssd_epi32(accum, a, b);
+    }
+};
+
+// 8-bit elements sign extended to 16 bit and multiplied with vpmaddwd (AVX-512BW).
+struct AVX512BWInt8Ops
+{
+    typedef int8_t ScalarT;
+    typedef __m512i AVectorT;
+    static const int ElementsPerVector = 32;
+    static const bool UsesVNNI = false;
+
+    TARGET_AVX512BW FORCEINLINE static __m512i Load(const int8_t* p, int count)
+    {
+        __m256i bytes = count == ElementsPerVector ? _mm256_loadu_si256((const __m256i*)p)
+                                                   : _mm512_castsi512_si256(_mm512_maskz_loadu_epi8((__mmask64)((1ull << count) - 1), p));
+        return _mm512_cvtepi8_epi16(bytes);
+    }
+    TARGET_AVX512BW FORCEINLINE static AVectorT LoadA(const int8_t* p, int count) { return Load(p, count); }
+    TARGET_AVX512BW FORCEINLINE static __m512i Accumulate(__m512i accum, const AVectorT& a, __m512i b)
+    {
+        return _mm512_add_epi32(accum, _mm512_madd_epi16(a, b));
+    }
+};
+
+// vpdpbusd on 8-bit elements (AVX-512 VNNI).
+// vpdpbusd multiplies unsigned bytes by signed bytes, so A is stored as |a| together with the mask of
+// its negative elements, and the corresponding elements of B are negated before the multiplication.
+// B must not contain -128 (which cannot be negated), i.e. it has to be quantized symmetrically;
+// BlockMultiplier::PrepareB clamps it to -127.
+struct AVX512VNNIInt8Ops
+{
+    typedef int8_t ScalarT;
+    struct AVectorT
+    {
+        __m512i abs;
+        __mmask64 negative;
+    };
+    static const int ElementsPerVector = 64;
+    static const bool UsesVNNI = true;
+
+    TARGET_AVX512VNNI FORCEINLINE static __m512i Load(const int8_t* p, int count)
+    {
+        return count == ElementsPerVector ? _mm512_loadu_si512(p) : _mm512_maskz_loadu_epi8((__mmask64)((1ull << count) - 1), p);
+    }
+    TARGET_AVX512VNNI FORCEINLINE static AVectorT LoadA(const int8_t* p, int count)
+    {
+        __m512i a = Load(p, count);
+        AVectorT ret;
+        ret.abs = _mm512_abs_epi8(a);
+        ret.negative = _mm512_movepi8_mask(a);
+        return ret;
+    }
+    TARGET_AVX512VNNI FORCEINLINE static __m512i Accumulate(__m512i accum, const AVectorT& a, __m512i b)
+    {
+        __m512i signedB = _mm512_mask_sub_epi8(b, a.negative, _mm512_setzero_si512(), b);
+        return _mm512_dpbusd_epi32(accum, a.abs, signedB);
+    }
+};
+
+// Offsets into the matrices rewritten by BlockMultiplier, same as in the other handlers.
+struct BlockHandlerAVX512Base
+{
+    FORCEINLINE static int RowToColOffsetRewrittenB(int col, int kOffset, int blockSize, int origCols)
+    {
+        return (origCols * blockSize * kOffset) + (col * blockSize);
+    }
+    FORCEINLINE static int RowToColOffsetRewrittenA(int row, int kOffset, int blockSize, int rowsPerBlock, int origCols)
+    {
+        int rowIdx = row / rowsPerBlock;
+        int offsetFromBlockBeginning = row % rowsPerBlock;
+        int colIdx = kOffset * rowsPerBlock * blockSize + (offsetFromBlockBeginning * blockSize);
+        return (rowIdx * (origCols / blockSize) * rowsPerBlock * blockSize) + colIdx;
+    }
+};
+
+// Multiplies rowsPerBlock rows of A by all columns of B for one block of blockSize elements of the common dimension,
+// adding the partial dot products to resultStorage. The rows of A stay in registers while we walk the columns of B.
+// The body is shared by the AVX-512BW and the VNNI kernels below, which differ only in the instruction
+// set the compiler may use (a VNNI kernel must never run on a processor without VNNI).
+#define AVX512_HANDLE_BLOCK_BODY                                                                                            \
+    const int numVectors = (blockSize + Ops::ElementsPerVector - 1) / Ops::ElementsPerVector;                              \
+    const int lastCount = blockSize - (numVectors - 1) * Ops::ElementsPerVector;                                           \
+    ScalarT* currA = &newA[BlockHandlerAVX512Base::RowToColOffsetRewrittenA(startRow, currBlock, blockSize, rowsPerBlock, k)]; \
+    AVectorT rowsA[rowsPerBlock][numVectors];                                                                              \
+    for (int r = 0; r < rowsPerBlock; ++r)                                                                                 \
+        for (int v = 0; v < numVectors; ++v)                                                                               \
+            rowsA[r][v] = Ops::LoadA(currA + r * blockSize + v * Ops::ElementsPerVector,                                   \
+                                     v == numVectors - 1 ? lastCount : Ops::ElementsPerVector);                            \
+    for (int c = 0; c < n; ++c)                                                                                            \
+    {                                                                                                                      \
+        ScalarT* currB = &B[BlockHandlerAVX512Base::RowToColOffsetRewrittenB(c, currBlock, blockSize, n)];                 \
+        __m512i accum[rowsPerBlock];                                                                                       \
+        for (int r = 0; r < rowsPerBlock; ++r)                                                                             \
+            accum[r] = resultStorage[RowColToOffset(r, c, n)];                                                             \
+        for (int v = 0; v < numVectors; ++v)                                                                               \
+        {                                                                                                                  \
+            __m512i colB = Ops::Load(currB + v * Ops::ElementsPerVector, v == numVectors - 1 ? lastCount : Ops::ElementsPerVector); \
+            for (int r = 0; r < rowsPerBlock; ++r)                                                                         \
+                accum[r] = Ops::Accumulate(accum[r], rowsA[r][v], colB);                                                   \
+        }                                                                                                                  \
+        for (int r = 0; r < rowsPerBlock; ++r)                                                                             \
+            resultStorage[RowColToOffset(r, c, n)] = accum[r];                                                             \
+    }
+
+template <class Ops, bool usesVNNI = Ops::UsesVNNI> struct BlockKernelAVX512
+{
+    typedef typename Ops::ScalarT ScalarT;
+    typedef typename Ops::AVectorT AVectorT;
+
+    template <int blockSize, int rowsPerBlock>
+    TARGET_AVX512BW static void HandleBlock(int currBlock, int startRow, int k, int n, ScalarT* newA, ScalarT* B, __m512i* resultStorage)
+    {
+        AVX512_HANDLE_BLOCK_BODY
+    }
+};
+
+template <class Ops> struct BlockKernelAVX512<Ops, true>
+{
+    typedef typename Ops::ScalarT ScalarT;
+    typedef typename Ops::AVectorT AVectorT;
+
+    template <int blockSize, int rowsPerBlock>
+    TARGET_AVX512VNNI static void HandleBlock(int currBlock, int startRow, int k, int n, ScalarT* newA, ScalarT* B, __m512i* resultStorage)
+    {
+        AVX512_HANDLE_BLOCK_BODY
+    }
+};
+
+#undef AVX512_HANDLE_BLOCK_BODY
+
+template <class Ops> class BlockHandlerAVX512
+{
+    private:
+        typedef typename Ops::ScalarT ScalarT;
+        typedef BlockKernelAVX512<Ops> KernelT;
+
+        // The blocks of 8 are multiplied with 128-bit vpmaddwd, the same for all Ops.
+        template <int rowsPerBlock>
+        TARGET_AVX512BW static void HandleBlock8(int currBlock, int startRow, int k, int n, ScalarT* newA, ScalarT* B, __m128i* resultStorage)
+        {
+            ScalarT* currA = &newA[BlockHandlerAVX512Base::RowToColOffsetRewrittenA(startRow, currBlock, 8, rowsPerBlock, k)];
+            __m128i rowsA[rowsPerBlock];
+            for (int r = 0; r < rowsPerBlock; ++r)
+                rowsA[r] = Load8(currA + r * 8);
+
+            for (int c = 0; c < n; ++c)
+            {
+                __m128i colB = Load8(&B[BlockHandlerAVX512Base::RowToColOffsetRewrittenB(c, currBlock, 8, n)]);
+                for (int r = 0; r < rowsPerBlock; ++r)
+                {
+                    __m128i& result = resultStorage[RowColToOffset(r, c, n)];
+                    result = _mm_add_epi32(result, _mm_madd_epi16(rowsA[r], colB));
+                }
+            }
+        }
+
+        // Loads eight elements as 16-bit integers.
+        TARGET_AVX512BW FORCEINLINE static __m128i Load8(const int16_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+        TARGET_AVX512BW FORCEINLINE static __m128i Load8(const int8_t* p) { return _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i*)p)); }
+
+    public:
+        typedef __m512i VectorT;
+        typedef ScalarT ScalarAT;
+        typedef ScalarT ScalarBT;
+        typedef int32_t ScalarCT;
+
+        // The 128 blocks are handed in blockCnt (at most two) at a time.
+        static void HandleBlock128x4(int currBlock, int startRow, int k, int n, ScalarT* newA, ScalarT* B, int blockCnt,
+                                     __m512i* resultStorage, VectorT* /*subtractMe*/)
+        {
+            for (int i = 0; i < blockCnt; ++i)
+                KernelT::template HandleBlock<128, 4>(currBlock + i, startRow, k, n, newA, B, resultStorage);
+        }
+        static void HandleBlock64x4(int currBlock, int startRow, int k, int n, ScalarT* newA, ScalarT* B, int /*blockCnt*/, __m512i* resultStorage)
+        {
+            KernelT::template HandleBlock<64, 4>(currBlock, startRow, k, n, newA, B, resultStorage);
+        }
+        static void HandleBlock32x4(int currBlock, int startRow, int k, int n, ScalarT* newA, ScalarT* B, int /*blockCnt*/, __m512i* resultStorage)
+        {
+            KernelT::template HandleBlock<32, 4>(currBlock, startRow, k, n, newA, B, resultStorage);
+        }
+        static void HandleBlock16x4(int currBlock, int startRow, int k, int n, ScalarT* newA, ScalarT* B, int /*blockCnt*/, __m512i* resultStorage)
+        {
+            KernelT::template HandleBlock<16, 4>(currBlock, startRow, k, n, newA, B, resultStorage);
+        }
+        static void HandleBlock8x4(int currBlock, int startRow, int k, int n, ScalarT* newA, ScalarT* B, int /*blockCnt*/, __m128i* resultStorage)
+        {
+            HandleBlock8<4>(currBlock, startRow, k, n, newA, B, resultStorage);
+        }
+        static void HandleBlock128x1(int currBlock, int startRow, int k, int n, ScalarT* newA, ScalarT* B, int blockCnt,
+                                     __m512i* resultStorage, VectorT* /*subtractMe*/)
+        {
+            for (int i = 0; i < blockCnt; ++i)
+                KernelT::template HandleBlock<128, 1>(currBlock + i, startRow, k, n, newA, B, resultStorage);
+        }
+        static void HandleBlock64x1(int currBlock, int startRow, int k, int n, ScalarT* newA, ScalarT* B, int /*blockCnt*/, __m512i* resultStorage)
+        {
+            KernelT::template HandleBlock<64, 1>(currBlock, startRow, k, n, newA, B, resultStorage);
+        }
+        static void HandleBlock32x1(int currBlock, int startRow, int k, int n, ScalarT* newA, ScalarT* B, int /*blockCnt*/, __m512i* resultStorage)
+        {
+            KernelT::template HandleBlock<32, 1>(currBlock, startRow, k, n, newA, B, resultStorage);
+        }
+        static void HandleBlock16x1(int currBlock, int startRow, int k, int n, ScalarT* newA, ScalarT* B, int /*blockCnt*/, __m512i* resultStorage)
+        {
+            KernelT::template HandleBlock<16, 1>(currBlock, startRow, k, n, newA, B, resultStorage);
+        }
+        static void HandleBlock8x1(int currBlock, int startRow, int k, int n, ScalarT* newA, ScalarT* B, int /*blockCnt*/, __m128i* resultStorage)
+        {
+            HandleBlock8<1>(currBlock, startRow, k, n, newA, B, resultStorage);
+        }
+
+        static VectorT* PrepareExtraB(const ScalarBT* /*prepareMe*/, int /*k*/, int /*n*/)
+        {
+            return nullptr;
+        }
+        static void FreePreparedB(VectorT* freeMe) { freeMe; assert(nullptr == freeMe); }
+};
+
+typedef BlockHandlerAVX512<AVX512BWInt16Ops> BlockHandlerAVX512BW;
+typedef BlockHandlerAVX512<AVX512VNNIInt16Ops> BlockHandlerAVX512VNNI;
+typedef BlockHandlerAVX512<AVX512BWInt8Ops> BlockHandlerAVX512BWInt8;
+typedef BlockHandlerAVX512<AVX512VNNIInt8Ops> BlockHandlerAVX512VNNIInt8;
+
+}}}
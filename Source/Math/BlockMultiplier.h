@@ -20,9 +20,8 @@
 #include <vector>
 #include "BlockMultiplierMatrixUtil.h"
 #include "BlockHandlerSSE.h"
-#ifdef SUPPORT_AVX2
 #include "BlockHandlerAVX.h"
-#endif
+#include "BlockHandlerAVX512.h"
 //#define STDTHREAD
 #define OPENMPTHREAD
 #ifdef STDTHREAD
@@ -73,9 +72,11 @@ template<typename BlockHandlerT>struct HandlerArgs
 // multiplication. Blocks of A and B (the LHS and RHS of the multiplication)
 // are then handed off to a class implementing the BlockHandlerT interface.
 // Implementations are provided for multiplying 16-bit integer matrices using
-// the SSE and AVX2 instruction sets. To compile for AVX2, you need to add the /arch:AVX2
-// flag to the compiler. Note that the AVX2 code only runs on Haswell or better processors,
-// will throw illegal instruction on other machines.
+// the SSE, AVX2, AVX-512BW and AVX-512 VNNI instruction sets, and 8-bit integer matrices
+// using AVX-512BW and AVX-512 VNNI. The AVX2 and AVX-512 handlers are compiled for their
+// instruction set regardless of the compiler flags and throw illegal instruction on processors
+// that don't support it, use CreateBlockMultiplier (BlockMultiplierDispatch.h) to get the
+// best handler for the processor at runtime.
 // To use the code, first call PrepareB, which rewrites B in block order and returns
 // a pointer to the rewritten block (don't forget to call FreePreparedB on it when you're done
 // multiplying by that matrix). Then you can call MultiplyMatrices().
@@ -90,7 +91,7 @@ template<typename BlockHandlerT> class BlockMultiplier
         typedef typename BlockHandlerT::ScalarBT ScalarBT;
         // Right now we always produce 32-bit integer results. This could be changed if necessary.
         typedef int32_t ScalarCT;
-        // The vectorized type of the block multiplier (e.g. __m128i for SSE, __m256 for AVX2).
+        // The vectorized type of the block multiplier (e.g. __m128i for SSE, __m256i for AVX2, __m512i for AVX-512).
         typedef typename BlockHandlerT::VectorT VectorT;
 
     private:
@@ -182,7 +183,7 @@ template<typename BlockHandlerT> class BlockMultiplier
         static void BlockHandler128x4Thread(HandlerArgs<BlockHandlerT> ha)
         {
             // Accumulate full row results locally b/f writing to C
-            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * ha.rowsPerBlock * ha.n, 16);
+            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * ha.rowsPerBlock * ha.n, 64);
             memset(resultStorage, 0, sizeof(VectorT) * ha.rowsPerBlock * ha.n);
             const int blocksAtOnce = 2;
 
@@ -200,10 +201,10 @@ template<typename BlockHandlerT> class BlockMultiplier
                 for (int c = 0; c < n; ++c)
                 {
                     //_mm_prefetch((char*)&(transC[RowColToOffset(c, startRow, m)]), _MM_HINT_T1);
-                    VectorT result1 = resultStorage[RowColToOffset(0, c, n)];
-                    VectorT result2 = resultStorage[RowColToOffset(1, c, n)];
-                    VectorT result3 = resultStorage[RowColToOffset(2, c, n)];
-                    VectorT result4 = resultStorage[RowColToOffset(3, c, n)];
+                    const VectorT& result1 = resultStorage[RowColToOffset(0, c, n)];
+                    const VectorT& result2 = resultStorage[RowColToOffset(1, c, n)];
+                    const VectorT& result3 = resultStorage[RowColToOffset(2, c, n)];
+                    const VectorT& result4 = resultStorage[RowColToOffset(3, c, n)];
                     int32_t firstHorizontal  = my_hadd(result1);
                     int32_t secondHorizontal = my_hadd(result2);
                     int32_t thirdHorizontal  = my_hadd(result3);
@@ -221,7 +222,7 @@ template<typename BlockHandlerT> class BlockMultiplier
 
         static void BlockHandler64x4Thread(HandlerArgs<BlockHandlerT> ha)
         {
-            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * 4 * ha.n, 16);
+            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * 4 * ha.n, 64);
             memset(resultStorage, 0, sizeof(VectorT) * 4 * ha.n);
             int32_t* transC = ha.transC;
 
@@ -235,10 +236,10 @@ template<typename BlockHandlerT> class BlockMultiplier
             {
                 for (int c = 0; c < n; ++c)
                 {
-                    VectorT result1 = resultStorage[RowColToOffset(0, c, n)];
-                    VectorT result2 = resultStorage[RowColToOffset(1, c, n)];
-                    VectorT result3 = resultStorage[RowColToOffset(2, c, n)];
-                    VectorT result4 = resultStorage[RowColToOffset(3, c, n)];
+                    const VectorT& result1 = resultStorage[RowColToOffset(0, c, n)];
+                    const VectorT& result2 = resultStorage[RowColToOffset(1, c, n)];
+                    const VectorT& result3 = resultStorage[RowColToOffset(2, c, n)];
+                    const VectorT& result4 = resultStorage[RowColToOffset(3, c, n)];
                     int32_t firstHorizontal  = my_hadd(result1);
                     int32_t secondHorizontal = my_hadd(result2);
                     int32_t thirdHorizontal  = my_hadd(result3);
@@ -254,7 +255,7 @@ template<typename BlockHandlerT> class BlockMultiplier
 
         static void BlockHandler32x4Thread(HandlerArgs<BlockHandlerT> ha)
         {
-            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * 4 * ha.n, 16);
+            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * 4 * ha.n, 64);
             memset(resultStorage, 0, sizeof(VectorT) * 4 * ha.n);
             int32_t* transC = ha.transC;
 
@@ -268,10 +269,10 @@ template<typename BlockHandlerT> class BlockMultiplier
             {
                 for (int c = 0; c < n; ++c)
                 {
-                    VectorT result1 = resultStorage[RowColToOffset(0, c, n)];
-                    VectorT result2 = resultStorage[RowColToOffset(1, c, n)];
-                    VectorT result3 = resultStorage[RowColToOffset(2, c, n)];
-                    VectorT result4 = resultStorage[RowColToOffset(3, c, n)];
+                    const VectorT& result1 = resultStorage[RowColToOffset(0, c, n)];
+                    const VectorT& result2 = resultStorage[RowColToOffset(1, c, n)];
+                    const VectorT& result3 = resultStorage[RowColToOffset(2, c, n)];
+                    const VectorT& result4 = resultStorage[RowColToOffset(3, c, n)];
                     int32_t firstHorizontal  = my_hadd(result1);
                     int32_t secondHorizontal = my_hadd(result2);
                     int32_t thirdHorizontal  = my_hadd(result3);
@@ -287,7 +288,7 @@ template<typename BlockHandlerT> class BlockMultiplier
 
         static void BlockHandler16x4Thread(HandlerArgs<BlockHandlerT> ha)
         {
-            VectorT* resultStorage = (VectorT*) ALIGNED_ALLOC(sizeof(VectorT) * 4 * ha.n, 16);
+            VectorT* resultStorage = (VectorT*) ALIGNED_ALLOC(sizeof(VectorT) * 4 * ha.n, 64);
             memset(resultStorage, 0, sizeof(VectorT) * 4 * ha.n);
             int32_t* transC = ha.transC;
             for (int currBlock = 0; currBlock < ha.blocks; ++currBlock)
@@ -300,10 +301,10 @@ template<typename BlockHandlerT> class BlockMultiplier
             {
                 for (int c = 0; c < n; ++c)
                 {
-                    VectorT result1 = resultStorage[RowColToOffset(0, c, n)];
-                    VectorT result2 = resultStorage[RowColToOffset(1, c, n)];
-                    VectorT result3 = resultStorage[RowColToOffset(2, c, n)];
-                    VectorT result4 = resultStorage[RowColToOffset(3, c, n)];
+                    const VectorT& result1 = resultStorage[RowColToOffset(0, c, n)];
+                    const VectorT& result2 = resultStorage[RowColToOffset(1, c, n)];
+                    const VectorT& result3 = resultStorage[RowColToOffset(2, c, n)];
+                    const VectorT& result4 = resultStorage[RowColToOffset(3, c, n)];
                     int32_t firstHorizontal  = my_hadd(result1);
                     int32_t secondHorizontal = my_hadd(result2);
                     int32_t thirdHorizontal  = my_hadd(result3);
@@ -319,7 +320,7 @@ template<typename BlockHandlerT> class BlockMultiplier
 
         static void BlockHandler8x4Thread(HandlerArgs<BlockHandlerT> ha)
         {
-            __m128i* resultStorage = (__m128i*)ALIGNED_ALLOC(sizeof(__m128i) * 4 * ha.n, 16);
+            __m128i* resultStorage = (__m128i*)ALIGNED_ALLOC(sizeof(__m128i) * 4 * ha.n, 64);
             memset(resultStorage, 0, sizeof(__m128i) * 4 * ha.n);
             int32_t* transC = ha.transC;
             //_mm_prefetch((char*)&(transC[RowColToOffset(c, ha.startRow, m)]), _MM_HINT_T1);
@@ -369,7 +370,7 @@ template<typename BlockHandlerT> class BlockMultiplier
             {
                 for (int c = 0; c < n; ++c)
                 {
-                    VectorT result1 = resultStorage[RowColToOffset(0, c, n)];
+                    const VectorT& result1 = resultStorage[RowColToOffset(0, c, n)];
                     int32_t firstHorizontal = my_hadd(result1);
                     transC[RowColToOffset(ha.startRow, c, n)] = firstHorizontal;
                 }
@@ -379,7 +380,7 @@ template<typename BlockHandlerT> class BlockMultiplier
 
         static void BlockHandler64x1Thread(HandlerArgs<BlockHandlerT> ha)
         {
-            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * ha.rowsPerBlock * ha.n, 16);
+            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * ha.rowsPerBlock * ha.n, 64);
             memset(resultStorage, 0, sizeof(VectorT) * ha.rowsPerBlock * ha.n);
             int32_t* transC = ha.transC;
 
@@ -393,7 +394,7 @@ template<typename BlockHandlerT> class BlockMultiplier
             {
                 for (int c = 0; c < n; ++c)
                 {
-                    VectorT result1 = resultStorage[RowColToOffset(0, c, n)];
+                    const VectorT& result1 = resultStorage[RowColToOffset(0, c, n)];
                     int32_t firstHorizontal = my_hadd(result1);
                     transC[RowColToOffset(ha.startRow, c, n)] += firstHorizontal;
                 }
@@ -403,7 +404,7 @@ template<typename BlockHandlerT> class BlockMultiplier
 
         static void BlockHandler32x1Thread(HandlerArgs<BlockHandlerT> ha)
         {
-            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * ha.rowsPerBlock * ha.n, 16);
+            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * ha.rowsPerBlock * ha.n, 64);
             memset(resultStorage, 0, sizeof(VectorT) * ha.rowsPerBlock * ha.n);
             int32_t* transC = ha.transC;
 
@@ -417,7 +418,7 @@ template<typename BlockHandlerT> class BlockMultiplier
             {
                 for (int c = 0; c < n; ++c)
                 {
-                    VectorT result1 = resultStorage[RowColToOffset(0, c, n)];
+                    const VectorT& result1 = resultStorage[RowColToOffset(0, c, n)];
                     int32_t firstHorizontal = my_hadd(result1);
                     transC[RowColToOffset(ha.startRow, c, n)] += firstHorizontal;
                 }
@@ -427,7 +428,7 @@ template<typename BlockHandlerT> class BlockMultiplier
 
         static void BlockHandler16x1Thread(HandlerArgs<BlockHandlerT> ha)
         {
-            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * ha.rowsPerBlock * ha.n, 16);
+            VectorT* resultStorage = (VectorT*)ALIGNED_ALLOC(sizeof(VectorT) * ha.rowsPerBlock * ha.n, 64);
             memset(resultStorage, 0, sizeof(VectorT) * ha.rowsPerBlock  * ha.n);
             int32_t* transC = ha.transC;
 
@@ -441,7 +442,7 @@ template<typename BlockHandlerT> class BlockMultiplier
             {
                 for (int c = 0; c < n; ++c)
                 {
-                    VectorT result1 = resultStorage[RowColToOffset(0, c, n)];
+                    const VectorT& result1 = resultStorage[RowColToOffset(0, c, n)];
                     int32_t firstHorizontal = my_hadd(result1);
                     transC[RowColToOffset(ha.startRow, c, n)] += firstHorizontal;
                 }
@@ -512,9 +513,8 @@ template<typename BlockHandlerT> class BlockMultiplier
             return _mm_extract_epi32(res2, 0);
         }
 
-#ifdef SUPPORT_AVX2
         //Same as above, for AVX registers
-        FORCEINLINE static __m256i my_adds_epi32(__m256i a, __m256i b)
+        TARGET_AVX2 FORCEINLINE static __m256i my_adds_epi32(__m256i a, __m256i b)
         {
             __m256i int_min = _mm256_set1_epi32(0x80000000);
             __m256i int_max = _mm256_set1_epi32(0x7FFFFFFF);
@@ -529,7 +529,8 @@ template<typename BlockHandlerT> class BlockMultiplier
         }
 
         //Same as above, for AVX registers
-        FORCEINLINE static int32_t my_hadd(__m256i hAddMe)
+        //The wide vectors are passed by reference, the callers are not necessarily compiled for AVX.
+        TARGET_AVX2 static int32_t my_hadd(const __m256i& hAddMe)
         {
             __m256i shuff1 = _mm256_shuffle_epi32(hAddMe, _MM_SHUFFLE(1, 0, 3, 2));
             __m256i res1 = my_adds_epi32(hAddMe, shuff1);
@@ -543,33 +544,35 @@ template<typename BlockHandlerT> class BlockMultiplier
             u.v = res3;
             return u.i[0];
         }
-#endif
+
+        //Same as above, for AVX-512 registers: saturated add of the two halves, then as for AVX.
+        TARGET_AVX512BW static int32_t my_hadd(const __m512i& hAddMe)
+        {
+            __m256i res = my_adds_epi32(_mm512_castsi512_si256(hAddMe), _mm512_extracti64x4_epi64(hAddMe, 1));
+            return my_hadd(res);
+        }
 
 
         int m_numThreads;
 
-        BlockMultiplier(int numThreads = 1) 
+        BlockMultiplier(int numThreads = 1) : m_pBlockHandlerBInfo(nullptr)
         {
             SetNumThreads(numThreads);
         }
 
+        // With OPENMPTHREAD the thread count only applies to the parallel loops of this object
+        // (num_threads clause), the process-wide OpenMP setting is left alone.
         void SetNumThreads(int threads)
         {
-            m_numThreads = threads;
+            m_numThreads = std::max(threads, 1);
 #ifdef STDTHREAD
-            m_pPool.reset(new StdThreadPool<HandlerArgs<BlockHandlerT>>(threads));
-#else
-#ifdef OPENMPTHREAD
-            m_oldNumThreads = omp_get_num_threads();
-            omp_set_num_threads(threads);
-#endif
+            m_pPool.reset(new StdThreadPool<HandlerArgs<BlockHandlerT>>(m_numThreads));
 #endif
         }
 
         ~BlockMultiplier()
         {
             BlockHandlerT::FreePreparedB(m_pBlockHandlerBInfo);
-            omp_set_num_threads(m_oldNumThreads);
         }
         static ScalarAT* CreateMatrixA(int m, int n, ScalarAT initVal = 0);
         static ScalarBT* CreateMatrixB(int m, int n, ScalarBT initVal = 0);
@@ -580,7 +583,6 @@ template<typename BlockHandlerT> class BlockMultiplier
         // For now we assume m, k and n are all multiples of kernelsize.
         void MultiplyMatrices(ScalarAT* A, int m, int k, ScalarBT* B, int n, int32_t* C, ScalarAT alpha = 1, ScalarBT beta = 0);
         static const int MAXRANGE = 1 << 13;
-        int m_oldNumThreads;
 };
 
 template<typename BlockHandlerT> typename BlockMultiplier<BlockHandlerT>::ScalarAT* BlockMultiplier<BlockHandlerT>::CreateMatrixA(int m, int n, ScalarAT initVal)
@@ -612,6 +614,20 @@ template<typename BlockHandlerT> FORCEINLINE int BlockMultiplier<BlockHandlerT>:
     return accum;
 }
 
+// The 8-bit handlers expect B in the symmetric range [-127, 127] (see IBlockMultiplier). -128 is clamped to -127,
+// by all of them alike, so that the result does not depend on the handler the processor supports.
+FORCEINLINE void ClampToSymmetricRange(int8_t* B, int size)
+{
+    for (int i = 0; i < size; ++i)
+    {
+        if (B[i] == INT8_MIN)
+            B[i] = -INT8_MAX;
+    }
+}
+FORCEINLINE void ClampToSymmetricRange(int16_t* /*B*/, int /*size*/)
+{
+}
+
 // Rewrites B in Block order so that memory accesses to B will be sequential.
 // See comments on RewriteBInBlockOrder for details.
 template<typename BlockHandlerT> typename BlockMultiplier<BlockHandlerT>::ScalarBT* BlockMultiplier<BlockHandlerT>::PrepareB(ScalarBT* oldB, int k, int n)
@@ -642,6 +658,7 @@ template<typename BlockHandlerT> typename BlockMultiplier<BlockHandlerT>::Scalar
         next = RewriteBInBlockOrder(oldB, next, k, n, blockSize, &offset);
     }
     assert(next - newB == k * n);
+    ClampToSymmetricRange(newB, k * n);
     m_pBlockHandlerBInfo = BlockHandlerT::PrepareExtraB(newB, k, n);
 
     return newB;
@@ -928,16 +945,18 @@ template<typename BlockHandlerT> void BlockMultiplier<BlockHandlerT>::MultiplyMa
                 {
 
 #ifdef OPENMPTHREAD
-#pragma omp parallel for
+#pragma omp parallel for num_threads(m_numThreads)
 #endif
                     for (int startRow = 0; startRow < m; startRow += 4)
                     {
-                        ha.startRow = startRow;
+                        // Each iteration needs its own copy, ha is shared between the threads.
+                        HandlerArgs<BlockHandlerT> rowArgs = ha;
+                        rowArgs.startRow = startRow;
 #ifdef STDTHREAD
-                        m_pPool->QueueAndWake(ha, currBlockInfo.fourFn);
+                        m_pPool->QueueAndWake(rowArgs, currBlockInfo.fourFn);
 #else
 #ifdef OPENMPTHREAD
-                        currBlockInfo.fourFn(ha);
+                        currBlockInfo.fourFn(rowArgs);
 #endif
 #endif
                     }
@@ -950,16 +969,17 @@ template<typename BlockHandlerT> void BlockMultiplier<BlockHandlerT>::MultiplyMa
                 else if (rowsPerBlock == 1)
                 {
 #ifdef OPENMPTHREAD
-#pragma omp parallel for
+#pragma omp parallel for num_threads(m_numThreads)
 #endif
                     for (int startRow = 0; startRow < m; ++startRow)
                     {
-                        ha.startRow = startRow;
+                        HandlerArgs<BlockHandlerT> rowArgs = ha;
+                        rowArgs.startRow = startRow;
 #ifdef STDTHREAD
-                        m_pPool->QueueAndWake(ha, currBlockInfo.oneFn);
+                        m_pPool->QueueAndWake(rowArgs, currBlockInfo.oneFn);
 #else
 #ifdef OPENMPTHREAD
-                        currBlockInfo.oneFn(ha);
+                        currBlockInfo.oneFn(rowArgs);
 #endif
 #endif
                     }
@@ -0,0 +1,167 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full licence information.
+//
+#include "stdafx.h"
+#include "Basics.h"
+#include "CPUFeatures.h"
+#include "BlockMultiplierDispatch.h"
+
+// The block handlers are only available on x86 (see BlockHandlerSSE.cpp).
+#ifdef CNTK_X86_CPU
+#include "BlockMultiplier.h"
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+const char* BlockHandlerTypeName(BlockHandlerType type)
+{
+    switch (type)
+    {
+    case BlockHandlerType::SSE:        return "SSE";
+    case BlockHandlerType::AVX2:       return "AVX2";
+    case BlockHandlerType::AVX512BW:   return "AVX512BW";
+    case BlockHandlerType::AVX512VNNI: return "AVX512VNNI";
+    case BlockHandlerType::Best:       return "Best";
+    }
+    return "Unknown";
+}
+
+#ifdef CNTK_X86_CPU
+
+template <typename BlockHandlerT>
+class DispatchedBlockMultiplier : public IBlockMultiplier<typename BlockHandlerT::ScalarAT>
+{
+    typedef typename BlockHandlerT::ScalarAT ScalarT;
+
+public:
+    DispatchedBlockMultiplier(BlockHandlerType type, int numThreads) : m_type(type), m_multiplier(numThreads) {}
+
+    BlockHandlerType GetHandlerType() const override { return m_type; }
+    void SetNumThreads(int numThreads) override { m_multiplier.SetNumThreads(numThreads); }
+
+    ScalarT* PrepareB(ScalarT* B, int k, int n) override { return m_multiplier.PrepareB(B, k, n); }
+    void FreePreparedB(ScalarT* preparedB) override { m_multiplier.FreeMatrix(preparedB); }
+    void MultiplyMatrices(ScalarT* A, int m, int k, ScalarT* preparedB, int n, int32_t* C) override
+    {
+        m_multiplier.MultiplyMatrices(A, m, k, preparedB, n, C);
+    }
+
+private:
+    BlockHandlerType m_type;
+    BlockMultiplier<BlockHandlerT> m_multiplier;
+};
+
+// The handlers from the fastest to the slowest.
+static const BlockHandlerType s_handlersByPreference[] = { BlockHandlerType::AVX512VNNI, BlockHandlerType::AVX512BW, BlockHandlerType::AVX2, BlockHandlerType::SSE };
+
+static bool IsInstructionSetSupported(BlockHandlerType type)
+{
+    const auto& cpu = CPUFeatures::Get();
+    switch (type)
+    {
+    case BlockHandlerType::SSE:        return true;
+    case BlockHandlerType::AVX2:       return cpu.HasAVX2();
+    case BlockHandlerType::AVX512BW:   return cpu.HasAVX512BW();
+    case BlockHandlerType::AVX512VNNI: return cpu.HasAVX512BW() && cpu.HasAVX512VNNI();
+    default:                           return false;
+    }
+}
+
+template <typename ScalarT>
+static BlockHandlerType ResolveBlockHandlerType(BlockHandlerType type)
+{
+    if (type != BlockHandlerType::Best)
+    {
+        if (!IsBlockHandlerSupported<ScalarT>(type))
+            RuntimeError("CreateBlockMultiplier: the %s block handler for %d-bit matrices is not supported on this processor.",
+                         BlockHandlerTypeName(type), (int)(8 * sizeof(ScalarT)));
+        return type;
+    }
+
+    for (auto candidate : s_handlersByPreference)
+    {
+        if (IsBlockHandlerSupported<ScalarT>(candidate))
+            return candidate;
+    }
+    RuntimeError("CreateBlockMultiplier: no block handler for %d-bit matrices is supported on this processor.", (int)(8 * sizeof(ScalarT)));
+}
+
+template <typename ScalarT>
+static bool IsAnyBlockHandlerSupported()
+{
+    for (auto candidate : s_handlersByPreference)
+    {
+        if (IsBlockHandlerSupported<ScalarT>(candidate))
+            return true;
+    }
+    return false;
+}
+
+template <>
+bool IsBlockHandlerSupported<int16_t>(BlockHandlerType type)
+{
+    if (type == BlockHandlerType::Best)
+        return IsAnyBlockHandlerSupported<int16_t>();
+    return IsInstructionSetSupported(type);
+}
+
+template <>
+bool IsBlockHandlerSupported<int8_t>(BlockHandlerType type)
+{
+    if (type == BlockHandlerType::Best)
+        return IsAnyBlockHandlerSupported<int8_t>();
+    return (type == BlockHandlerType::AVX512BW || type == BlockHandlerType::AVX512VNNI) && IsInstructionSetSupported(type);
+}
+
+template <>
+std::unique_ptr<IBlockMultiplier<int16_t>> CreateBlockMultiplier<int16_t>(BlockHandlerType type, int numThreads)
+{
+    type = ResolveBlockHandlerType<int16_t>(type);
+    switch (type)
+    {
+    case BlockHandlerType::AVX512VNNI: return std::make_unique<DispatchedBlockMultiplier<BlockHandlerAVX512VNNI>>(type, numThreads);
+    case BlockHandlerType::AVX512BW:   return std::make_unique<DispatchedBlockMultiplier<BlockHandlerAVX512BW>>(type, numThreads);
+    case BlockHandlerType::AVX2:       return std::make_unique<DispatchedBlockMultiplier<BlockHandlerAVX>>(type, numThreads);
+    default:                           return std::make_unique<DispatchedBlockMultiplier<BlockHandlerSSE>>(type, numThreads);
+    }
+}
+
+template <>
+std::unique_ptr<IBlockMultiplier<int8_t>> CreateBlockMultiplier<int8_t>(BlockHandlerType type, int numThreads)
+{
+    type = ResolveBlockHandlerType<int8_t>(type);
+    if (type == BlockHandlerType::AVX512VNNI)
+        return std::make_unique<DispatchedBlockMultiplier<BlockHandlerAVX512VNNIInt8>>(type, numThreads);
+    return std::make_unique<DispatchedBlockMultiplier<BlockHandlerAVX512BWInt8>>(type, numThreads);
+}
+
+#else
+
+template <>
+bool IsBlockHandlerSupported<int16_t>(BlockHandlerType)
+{
+    return false;
+}
+
+template <>
+bool IsBlockHandlerSupported<int8_t>(BlockHandlerType)
+{
+    return false;
+}
+
+template <>
+std::unique_ptr<IBlockMultiplier<int16_t>> CreateBlockMultiplier<int16_t>(BlockHandlerType, int)
+{
+    RuntimeError("CreateBlockMultiplier: block multipliers are only available on x86 processors.");
+}
+
+template <>
+std::unique_ptr<IBlockMultiplier<int8_t>> CreateBlockMultiplier<int8_t>(BlockHandlerType, int)
+{
+    RuntimeError("CreateBlockMultiplier: block multipliers are only available on x86 processors.");
+}
+
+#endif
+
+}}}
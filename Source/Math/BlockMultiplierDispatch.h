@@ -0,0 +1,59 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full licence information.
+//
+// BlockMultiplierDispatch.h -- selects the BlockMultiplier handler for the processor at runtime.
+//
+// BlockMultiplier<BlockHandlerT> fixes the instruction set at compile time. The functions below wrap the
+// instantiations for all handlers behind one interface and pick the fastest one the CPU supports (CPUID).
+//
+#pragma once
+#include <cstdint>
+#include <memory>
+#include "CommonMatrix.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+enum class BlockHandlerType
+{
+    SSE,        // BlockHandlerSSE, 16-bit only
+    AVX2,       // BlockHandlerAVX, 16-bit only
+    AVX512BW,   // BlockHandlerAVX512BW / BlockHandlerAVX512BWInt8
+    AVX512VNNI, // BlockHandlerAVX512VNNI / BlockHandlerAVX512VNNIInt8
+    Best        // the fastest handler supported by the processor
+};
+
+MATH_API const char* BlockHandlerTypeName(BlockHandlerType type);
+
+// Multiplies an (m x k) matrix A by a (k x n) matrix B into the 32-bit (m x n) matrix C, all stored row major.
+// B has to be rewritten by PrepareB first, which can be done once for multiple multiplications.
+// C is expected to be zeroed out (see BlockMultiplier::MultiplyMatrices).
+// For int8_t, the elements of B must be in the symmetric range [-127, 127], as produced by symmetric quantization:
+// the AVX-512 VNNI kernel negates elements of B, which -128 does not survive. PrepareB clamps -128 to -127 for
+// all handlers, so that the result is the same on every processor.
+template <typename ScalarT>
+class IBlockMultiplier
+{
+public:
+    virtual ~IBlockMultiplier() {}
+
+    virtual BlockHandlerType GetHandlerType() const = 0;
+    virtual void SetNumThreads(int numThreads) = 0;
+
+    virtual ScalarT* PrepareB(ScalarT* B, int k, int n) = 0;
+    virtual void FreePreparedB(ScalarT* preparedB) = 0;
+    virtual void MultiplyMatrices(ScalarT* A, int m, int k, ScalarT* preparedB, int n, int32_t* C) = 0;
+};
+
+// Returns whether the processor supports the given handler for ScalarT (int16_t or int8_t), or any handler if type is Best.
+template <typename ScalarT> bool IsBlockHandlerSupported(BlockHandlerType type);
+template <> MATH_API bool IsBlockHandlerSupported<int16_t>(BlockHandlerType type);
+template <> MATH_API bool IsBlockHandlerSupported<int8_t>(BlockHandlerType type);
+
+// Creates a multiplier for the given handler, or for the best supported one if type is Best.
+// Throws if the handler is not supported by the processor.
+template <typename ScalarT> std::unique_ptr<IBlockMultiplier<ScalarT>> CreateBlockMultiplier(BlockHandlerType type = BlockHandlerType::Best, int numThreads = 1);
+template <> MATH_API std::unique_ptr<IBlockMultiplier<int16_t>> CreateBlockMultiplier<int16_t>(BlockHandlerType type, int numThreads);
+template <> MATH_API std::unique_ptr<IBlockMultiplier<int8_t>> CreateBlockMultiplier<int8_t>(BlockHandlerType type, int numThreads);
+
+}}}
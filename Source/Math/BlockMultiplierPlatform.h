@@ -17,3 +17,14 @@
 #endif
 #endif
 
+// Handlers for instruction sets beyond the baseline are compiled for their instruction set
+// on a per-function basis, so that BlockMultiplier can pick a handler at runtime.
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512BW __attribute__((target("avx512f,avx512bw")))
+#define TARGET_AVX512VNNI __attribute__((target("avx512f,avx512bw,avx512vnni")))
+#else
+#define TARGET_AVX2
+#define TARGET_AVX512BW
+#define TARGET_AVX512VNNI
+#endif
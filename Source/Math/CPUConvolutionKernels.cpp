@@ -0,0 +1,406 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "CPUConvolutionKernels.h"
+#include <algorithm>
+#include <cstring>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// Winograd transform matrices (input transform B^T, kernel transform G, output transform A^T)
+// -----------------------------------------------------------------------
+
+template <int m>
+struct WinogradMatrices;
+
+// F(2x2, 3x3), interpolation points 0, 1, -1
+template <>
+struct WinogradMatrices<2>
+{
+    static const double BT[4][4];
+    static const double G[4][3];
+    static const double AT[2][4];
+};
+const double WinogradMatrices<2>::BT[4][4] = { { 1, 0, -1, 0 }, { 0, 1, 1, 0 }, { 0, -1, 1, 0 }, { 0, 1, 0, -1 } };
+const double WinogradMatrices<2>::G[4][3] = { { 1, 0, 0 }, { 0.5, 0.5, 0.5 }, { 0.5, -0.5, 0.5 }, { 0, 0, 1 } };
+const double WinogradMatrices<2>::AT[2][4] = { { 1, 1, 1, 0 }, { 0, 1, -1, -1 } };
+
+// F(4x4, 3x3), interpolation points 0, 1, -1, 2, -2
+template <>
+struct WinogradMatrices<4>
+{
+    static const double BT[6][6];
+    static const double G[6][3];
+    static const double AT[4][6];
+};
+const double WinogradMatrices<4>::BT[6][6] =
+{
+    { 4, 0, -5, 0, 1, 0 },
+    { 0, -4, -4, 1, 1, 0 },
+    { 0, 4, -4, -1, 1, 0 },
+    { 0, -2, -1, 2, 1, 0 },
+    { 0, 2, -1, -2, 1, 0 },
+    { 0, 4, 0, -5, 0, 1 }
+};
+const double WinogradMatrices<4>::G[6][3] =
+{
+    { 1.0 / 4, 0, 0 },
+    { -1.0 / 6, -1.0 / 6, -1.0 / 6 },
+    { -1.0 / 6, 1.0 / 6, -1.0 / 6 },
+    { 1.0 / 24, 1.0 / 12, 1.0 / 6 },
+    { 1.0 / 24, -1.0 / 12, 1.0 / 6 },
+    { 0, 0, 1 }
+};
+const double WinogradMatrices<4>::AT[4][6] =
+{
+    { 1, 1, 1, 1, 1, 0 },
+    { 0, 1, -1, 2, -2, 0 },
+    { 0, 1, 1, 4, 4, 0 },
+    { 0, 1, -1, 8, -8, 1 }
+};
+
+// -----------------------------------------------------------------------
+// Winograd F(m x m, 3 x 3)
+// -----------------------------------------------------------------------
+
+template <class ElemType, int m>
+void WinogradTransformKernel(const Conv2DShape& s, const ElemType* kernel, bool transposeAndFlip, ElemType* U)
+{
+    typedef WinogradMatrices<m> W;
+    const int alpha = WinogradTiles<m>::Alpha;
+    const size_t C = s.inC;
+    const size_t K = s.outC;
+
+#pragma omp parallel for
+    for (int k = 0; k < (int)K; k++)
+    {
+        for (size_t c = 0; c < C; c++)
+        {
+            // g[j][i]: row j (height), column i (width)
+            double g[3][3];
+            for (int j = 0; j < 3; j++)
+            {
+                for (int i = 0; i < 3; i++)
+                {
+                    // The kernel of the reverse convolution maps the forward output channels (here c) to the forward input channels (here k).
+                    g[j][i] = transposeAndFlip ? kernel[(c * K + k) * 9 + (2 - j) * 3 + (2 - i)]
+                                               : kernel[(k * C + c) * 9 + j * 3 + i];
+                }
+            }
+
+            double tmp[alpha][3];
+            for (int a = 0; a < alpha; a++)
+                for (int i = 0; i < 3; i++)
+                    tmp[a][i] = W::G[a][0] * g[0][i] + W::G[a][1] * g[1][i] + W::G[a][2] * g[2][i];
+
+            for (int a = 0; a < alpha; a++)
+                for (int b = 0; b < alpha; b++)
+                    U[((a * alpha + b) * K + k) * C + c] = (ElemType)(tmp[a][0] * W::G[b][0] + tmp[a][1] * W::G[b][1] + tmp[a][2] * W::G[b][2]);
+        }
+    }
+}
+
+template <class ElemType, int m>
+void WinogradTransformInput(const Conv2DShape& s, const ElemType* in, size_t numSamples, ElemType* V)
+{
+    typedef WinogradMatrices<m> W;
+    const int alpha = WinogradTiles<m>::Alpha;
+    const size_t tilesW = WinogradTiles<m>::TilesW(s);
+    const size_t tilesH = WinogradTiles<m>::TilesH(s);
+    const size_t P = numSamples * tilesW * tilesH;
+    const size_t C = s.inC;
+    const size_t planeSize = s.inW * s.inH;
+
+    // every iteration writes the tiles of one channel of one sample
+#pragma omp parallel for
+    for (int nc = 0; nc < (int)(numSamples * C); nc++)
+    {
+        size_t n = nc / C;
+        size_t c = nc % C;
+        const ElemType* plane = in + (n * C + c) * planeSize;
+        for (size_t ty = 0; ty < tilesH; ty++)
+        {
+            for (size_t tx = 0; tx < tilesW; tx++)
+            {
+                int x0 = (int)(tx * m) - s.padW;
+                int y0 = (int)(ty * m) - s.padH;
+                ElemType d[alpha][alpha];
+                for (int r = 0; r < alpha; r++)
+                {
+                    int y = y0 + r;
+                    for (int q = 0; q < alpha; q++)
+                    {
+                        int x = x0 + q;
+                        d[r][q] = (y >= 0 && y < (int)s.inH && x >= 0 && x < (int)s.inW) ? plane[y * s.inW + x] : 0;
+                    }
+                }
+
+                ElemType tmp[alpha][alpha];
+                for (int a = 0; a < alpha; a++)
+                {
+                    for (int q = 0; q < alpha; q++)
+                    {
+                        ElemType sum = 0;
+                        for (int r = 0; r < alpha; r++)
+                            sum += (ElemType)W::BT[a][r] * d[r][q];
+                        tmp[a][q] = sum;
+                    }
+                }
+
+                size_t p = (n * tilesH + ty) * tilesW + tx;
+                for (int a = 0; a < alpha; a++)
+                {
+                    for (int b = 0; b < alpha; b++)
+                    {
+                        ElemType sum = 0;
+                        for (int q = 0; q < alpha; q++)
+                            sum += tmp[a][q] * (ElemType)W::BT[b][q];
+                        V[((a * alpha + b) * C + c) * P + p] = sum;
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <class ElemType, int m>
+void WinogradTransformOutput(const Conv2DShape& s, const ElemType* M, size_t numSamples, bool accumulate, ElemType* out)
+{
+    typedef WinogradMatrices<m> W;
+    const int alpha = WinogradTiles<m>::Alpha;
+    const size_t tilesW = WinogradTiles<m>::TilesW(s);
+    const size_t tilesH = WinogradTiles<m>::TilesH(s);
+    const size_t P = numSamples * tilesW * tilesH;
+    const size_t K = s.outC;
+    const size_t planeSize = s.outW * s.outH;
+
+    // every iteration writes one channel of one sample
+#pragma omp parallel for
+    for (int nk = 0; nk < (int)(numSamples * K); nk++)
+    {
+        size_t n = nk / K;
+        size_t k = nk % K;
+        ElemType* plane = out + (n * K + k) * planeSize;
+        for (size_t ty = 0; ty < tilesH; ty++)
+        {
+            for (size_t tx = 0; tx < tilesW; tx++)
+            {
+                size_t p = (n * tilesH + ty) * tilesW + tx;
+                ElemType mm[alpha][alpha];
+                for (int a = 0; a < alpha; a++)
+                    for (int b = 0; b < alpha; b++)
+                        mm[a][b] = M[((a * alpha + b) * K + k) * P + p];
+
+                ElemType tmp[m][alpha];
+                for (int i = 0; i < m; i++)
+                {
+                    for (int b = 0; b < alpha; b++)
+                    {
+                        ElemType sum = 0;
+                        for (int a = 0; a < alpha; a++)
+                            sum += (ElemType)W::AT[i][a] * mm[a][b];
+                        tmp[i][b] = sum;
+                    }
+                }
+
+                size_t rows = std::min((size_t)m, s.outH - ty * m);
+                size_t cols = std::min((size_t)m, s.outW - tx * m);
+                for (size_t i = 0; i < rows; i++)
+                {
+                    ElemType* row = plane + (ty * m + i) * s.outW + tx * m;
+                    for (size_t j = 0; j < cols; j++)
+                    {
+                        ElemType sum = 0;
+                        for (int b = 0; b < alpha; b++)
+                            sum += tmp[i][b] * (ElemType)W::AT[j][b];
+                        row[j] = accumulate ? row[j] + sum : sum;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------
+// 1x1 convolution
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+void GatherConvolution1x1Input(const Conv2DShape& s, const ElemType* in, size_t numSamples, ElemType* gathered)
+{
+#pragma omp parallel for
+    for (int nc = 0; nc < (int)(numSamples * s.inC); nc++)
+    {
+        const ElemType* plane = in + nc * s.inW * s.inH;
+        ElemType* dst = gathered + nc * s.outW * s.outH;
+        for (size_t y = 0; y < s.outH; y++)
+        {
+            int yi = (int)(y * s.strideH) - s.padH;
+            for (size_t x = 0; x < s.outW; x++)
+            {
+                int xi = (int)(x * s.strideW) - s.padW;
+                *dst++ = (yi >= 0 && yi < (int)s.inH && xi >= 0 && xi < (int)s.inW) ? plane[yi * s.inW + xi] : 0;
+            }
+        }
+    }
+}
+
+template <class ElemType>
+void ScatterAddConvolution1x1Input(const Conv2DShape& s, const ElemType* gathered, size_t numSamples, ElemType* grad)
+{
+#pragma omp parallel for
+    for (int nc = 0; nc < (int)(numSamples * s.inC); nc++)
+    {
+        ElemType* plane = grad + nc * s.inW * s.inH;
+        const ElemType* src = gathered + nc * s.outW * s.outH;
+        for (size_t y = 0; y < s.outH; y++)
+        {
+            int yi = (int)(y * s.strideH) - s.padH;
+            for (size_t x = 0; x < s.outW; x++, src++)
+            {
+                int xi = (int)(x * s.strideW) - s.padW;
+                if (yi >= 0 && yi < (int)s.inH && xi >= 0 && xi < (int)s.inW)
+                    plane[yi * s.inW + xi] += *src;
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------
+// channel-wise convolution
+// -----------------------------------------------------------------------
+
+// Range [begin, end) of the output coordinates o for which o * stride - pad + offset is inside [0, inSize).
+static inline void ValidOutputRange(size_t outSize, size_t inSize, size_t stride, int pad, size_t offset, size_t& begin, size_t& end)
+{
+    int lo = pad - (int)offset;          // o * stride >= lo
+    int hi = (int)inSize - 1 + lo;       // o * stride <= hi
+    begin = lo <= 0 ? 0 : (size_t)((lo + (int)stride - 1) / (int)stride);
+    end = hi < 0 ? 0 : std::min(outSize, (size_t)(hi / (int)stride) + 1);
+    if (begin > end)
+        begin = end;
+}
+
+template <class ElemType>
+void ChannelwiseConvolutionForward(const Conv2DShape& s, const ElemType* in, const ElemType* kernel, size_t numSamples, ElemType* out)
+{
+    const size_t C = s.inC;
+    const size_t K = s.outC / s.inC;
+    const size_t inPlaneSize = s.inW * s.inH;
+    const size_t outPlaneSize = s.outW * s.outH;
+
+#pragma omp parallel for
+    for (int nc = 0; nc < (int)(numSamples * C); nc++)
+    {
+        size_t n = nc / C;
+        size_t c = nc % C;
+        const ElemType* inPlane = in + nc * inPlaneSize;
+        for (size_t k = 0; k < K; k++)
+        {
+            const ElemType* kern = kernel + k * s.kernelW * s.kernelH;
+            ElemType* outPlane = out + (n * s.outC + c + C * k) * outPlaneSize;
+            memset(outPlane, 0, outPlaneSize * sizeof(ElemType));
+            for (size_t j = 0; j < s.kernelH; j++)
+            {
+                size_t yBegin, yEnd;
+                ValidOutputRange(s.outH, s.inH, s.strideH, s.padH, j, yBegin, yEnd);
+                for (size_t i = 0; i < s.kernelW; i++)
+                {
+                    size_t xBegin, xEnd;
+                    ValidOutputRange(s.outW, s.inW, s.strideW, s.padW, i, xBegin, xEnd);
+                    ElemType w = kern[j * s.kernelW + i];
+                    ptrdiff_t xOffset = (ptrdiff_t)i - s.padW;
+                    for (size_t y = yBegin; y < yEnd; y++)
+                    {
+                        ElemType* outRow = outPlane + y * s.outW;
+                        const ElemType* inRow = inPlane + ((ptrdiff_t)(y * s.strideH + j) - s.padH) * s.inW;
+                        if (s.strideW == 1)
+                        {
+                            for (size_t x = xBegin; x < xEnd; x++)
+                                outRow[x] += w * inRow[x + xOffset];
+                        }
+                        else
+                        {
+                            for (size_t x = xBegin; x < xEnd; x++)
+                                outRow[x] += w * inRow[x * s.strideW + xOffset];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <class ElemType>
+void ChannelwiseConvolutionBackwardData(const Conv2DShape& s, const ElemType* srcGrad, const ElemType* kernel, size_t numSamples, ElemType* grad)
+{
+    const size_t C = s.inC;
+    const size_t K = s.outC / s.inC;
+    const size_t inPlaneSize = s.inW * s.inH;
+    const size_t outPlaneSize = s.outW * s.outH;
+
+    // every iteration owns one gradient plane, so there are no conflicting writes
+#pragma omp parallel for
+    for (int nc = 0; nc < (int)(numSamples * C); nc++)
+    {
+        size_t n = nc / C;
+        size_t c = nc % C;
+        ElemType* gradPlane = grad + nc * inPlaneSize;
+        for (size_t k = 0; k < K; k++)
+        {
+            const ElemType* kern = kernel + k * s.kernelW * s.kernelH;
+            const ElemType* srcPlane = srcGrad + (n * s.outC + c + C * k) * outPlaneSize;
+            for (size_t j = 0; j < s.kernelH; j++)
+            {
+                size_t yBegin, yEnd;
+                ValidOutputRange(s.outH, s.inH, s.strideH, s.padH, j, yBegin, yEnd);
+                for (size_t i = 0; i < s.kernelW; i++)
+                {
+                    size_t xBegin, xEnd;
+                    ValidOutputRange(s.outW, s.inW, s.strideW, s.padW, i, xBegin, xEnd);
+                    ElemType w = kern[j * s.kernelW + i];
+                    ptrdiff_t xOffset = (ptrdiff_t)i - s.padW;
+                    for (size_t y = yBegin; y < yEnd; y++)
+                    {
+                        const ElemType* srcRow = srcPlane + y * s.outW;
+                        ElemType* gradRow = gradPlane + ((ptrdiff_t)(y * s.strideH + j) - s.padH) * s.inW;
+                        if (s.strideW == 1)
+                        {
+                            for (size_t x = xBegin; x < xEnd; x++)
+                                gradRow[x + xOffset] += w * srcRow[x];
+                        }
+                        else
+                        {
+                            for (size_t x = xBegin; x < xEnd; x++)
+                                gradRow[x * s.strideW + xOffset] += w * srcRow[x];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+#define INSTANTIATE_WINOGRAD(ElemType, m)                                                                                       \
+    template void WinogradTransformKernel<ElemType, m>(const Conv2DShape&, const ElemType*, bool, ElemType*);                  \
+    template void WinogradTransformInput<ElemType, m>(const Conv2DShape&, const ElemType*, size_t, ElemType*);                 \
+    template void WinogradTransformOutput<ElemType, m>(const Conv2DShape&, const ElemType*, size_t, bool, ElemType*)
+
+INSTANTIATE_WINOGRAD(float, 2);
+INSTANTIATE_WINOGRAD(float, 4);
+INSTANTIATE_WINOGRAD(double, 2);
+INSTANTIATE_WINOGRAD(double, 4);
+
+template void GatherConvolution1x1Input<float>(const Conv2DShape&, const float*, size_t, float*);
+template void GatherConvolution1x1Input<double>(const Conv2DShape&, const double*, size_t, double*);
+template void ScatterAddConvolution1x1Input<float>(const Conv2DShape&, const float*, size_t, float*);
+template void ScatterAddConvolution1x1Input<double>(const Conv2DShape&, const double*, size_t, double*);
+template void ChannelwiseConvolutionForward<float>(const Conv2DShape&, const float*, const float*, size_t, float*);
+template void ChannelwiseConvolutionForward<double>(const Conv2DShape&, const double*, const double*, size_t, double*);
+template void ChannelwiseConvolutionBackwardData<float>(const Conv2DShape&, const float*, const float*, size_t, float*);
+template void ChannelwiseConvolutionBackwardData<double>(const Conv2DShape&, const double*, const double*, size_t, double*);
+
+}}}
@@ -0,0 +1,77 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPUConvolutionKernels.h -- 2D convolution kernels used by the CPU WinogradConvolutionEngine.
+//
+// All functions work on raw buffers in the CNTK CHW layout: a sample is [W x H x C] with W being the
+// fastest dimension, the samples of a minibatch follow each other. Kernel weights use the cuDNN layout,
+// i.e. the weights of output map k are a contiguous [kW x kH x C] block.
+//
+#pragma once
+
+#include <cstddef>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Sizes of a 2D convolution with full sharing. Output pixel (x, y) reads the input pixels starting at
+// (x * strideW - padW, y * strideH - padH); input pixels outside of the image are 0.
+struct Conv2DShape
+{
+    size_t inW, inH, inC;
+    size_t outW, outH, outC;
+    size_t kernelW, kernelH;
+    size_t strideW, strideH;
+    int padW, padH;
+};
+
+// Winograd minimal filtering F(m x m, 3 x 3) (Lavin and Gray, Fast Algorithms for Convolutional Neural Networks)
+// for 3x3 kernels and stride 1, with m = 2 or 4. Every m x m output tile is computed from an (m + 2) x (m + 2)
+// input tile, which turns the convolution into (m + 2)^2 independent GEMMs over the channels:
+//     M[xi, nu] = V[xi, nu] * U[xi, nu], [P x C] * [C x K] -> [P x K]
+// where P is the number of tiles, U are the transformed kernels and V the transformed input tiles, each
+// stored as (m + 2)^2 consecutive column-major matrices. The GEMMs are done by the caller.
+template <int m>
+struct WinogradTiles
+{
+    static const int Alpha = m + 2; // size of the input tile
+
+    static size_t TilesW(const Conv2DShape& s) { return (s.outW + m - 1) / m; }
+    static size_t TilesH(const Conv2DShape& s) { return (s.outH + m - 1) / m; }
+    static size_t TilesPerSample(const Conv2DShape& s) { return TilesW(s) * TilesH(s); }
+};
+
+// Computes U ([C x K] per (xi, nu)) from the kernel weights (kernelW == kernelH == 3).
+// With transposeAndFlip the kernel of the "reverse" convolution used for backpropagation to the input is
+// transformed instead: input and output channels are swapped and the kernel is rotated by 180 degrees.
+template <class ElemType, int m>
+void WinogradTransformKernel(const Conv2DShape& s, const ElemType* kernel, bool transposeAndFlip, ElemType* U);
+
+// Computes V ([P x C] per (xi, nu)) for the P tiles of numSamples samples.
+template <class ElemType, int m>
+void WinogradTransformInput(const Conv2DShape& s, const ElemType* in, size_t numSamples, ElemType* V);
+
+// Computes the output from M ([P x K] per (xi, nu)). Adds to the output if accumulate is set, otherwise overwrites it.
+template <class ElemType, int m>
+void WinogradTransformOutput(const Conv2DShape& s, const ElemType* M, size_t numSamples, bool accumulate, ElemType* out);
+
+// Copies the input pixels read by a 1x1 convolution into a [outW * outH x C] matrix per sample (zero where padded).
+// Not needed for stride 1 without padding, where the input itself has this layout.
+template <class ElemType>
+void GatherConvolution1x1Input(const Conv2DShape& s, const ElemType* in, size_t numSamples, ElemType* gathered);
+
+// Reverse of GatherConvolution1x1Input: adds the [outW * outH x C] gradients to the input pixels they were gathered from.
+template <class ElemType>
+void ScatterAddConvolution1x1Input(const Conv2DShape& s, const ElemType* gathered, size_t numSamples, ElemType* grad);
+
+// Channel-wise convolution: kernels of depth 1 that are applied to every input channel separately.
+// Output channel c + C * k is input channel c convolved with kernel k, so outC == inC * K.
+// The loops are blocked so that an input plane stays in cache while all K kernels are applied to it.
+template <class ElemType>
+void ChannelwiseConvolutionForward(const Conv2DShape& s, const ElemType* in, const ElemType* kernel, size_t numSamples, ElemType* out);
+
+// Backpropagation of ChannelwiseConvolutionForward to its input. Adds to grad.
+template <class ElemType>
+void ChannelwiseConvolutionBackwardData(const Conv2DShape& s, const ElemType* srcGrad, const ElemType* kernel, size_t numSamples, ElemType* grad);
+
+}}}
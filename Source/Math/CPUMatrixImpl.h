@@ -12,6 +12,7 @@
 
 #include "CPUMatrix.h"
 #include "TensorOps.h"
+#include "RNNCommon.h"
 #include <assert.h>
 #include <stdexcept>
 #include <omp.h>
@@ -1281,6 +1282,199 @@ void CPUMatrix<ElemType>::Adam(CPUMatrix<ElemType>& gradients, CPUMatrix<ElemTyp
     }
 }
 
+// Fused update of several parameters, see FusedUpdate and Matrix::FusedParameterUpdate().
+// The parameters are split into chunks of equal size, which are processed in parallel. The gradient of a chunk is
+// preprocessed into a per-thread buffer (skipped if there is nothing to do), followed by a single pass that updates
+// the smoothed gradients and the values in place.
+// The gradients themselves are left unchanged. adaMul is the multiplier of FSAdaGrad resp. the bias correction of Adam.
+template <class ElemType>
+/*static*/ void CPUMatrix<ElemType>::FusedParameterUpdate(const FusedUpdate& update, ElemType adaMul, const std::vector<CPUMatrix<ElemType>*>& values,
+                                                          const std::vector<CPUMatrix<ElemType>*>& gradients, const std::vector<CPUMatrix<ElemType>*>& smoothedGradients)
+{
+    const size_t numParameters = values.size();
+    if (gradients.size() != numParameters || smoothedGradients.size() != numParameters)
+        InvalidArgument("FusedParameterUpdate: The number of gradients and smoothed gradients does not match the number of parameters.");
+
+    size_t smoothedGradientFactor; // size of the smoothed gradients in multiples of the parameter size
+    switch (update.type)
+    {
+    case FusedUpdateType::SGD:
+        smoothedGradientFactor = 0;
+        break;
+    case FusedUpdateType::MomentumSGD:
+    case FusedUpdateType::Nesterov:
+        smoothedGradientFactor = 1;
+        break;
+    case FusedUpdateType::FSAdaGrad:
+    case FusedUpdateType::Adam:
+        smoothedGradientFactor = 2;
+        break;
+    default:
+        LogicError("FusedParameterUpdate: Unsupported update type %d.", (int) update.type);
+    }
+
+    // chunks of at most s_chunkSize elements of one parameter
+    struct Chunk
+    {
+        size_t parameter;
+        size_t begin;
+        size_t end;
+    };
+    const size_t s_chunkSize = 8192;
+    std::vector<Chunk> chunks;
+    for (size_t k = 0; k < numParameters; k++)
+    {
+        size_t n = values[k]->GetNumElements();
+        if (gradients[k]->GetNumElements() != n || (smoothedGradientFactor > 0 && smoothedGradients[k]->GetNumElements() != smoothedGradientFactor * n))
+            LogicError("FusedParameterUpdate: The gradient or smoothed gradient of parameter %d does not have the expected dimensions.", (int)k);
+        for (size_t begin = 0; begin < n; begin += s_chunkSize)
+            chunks.push_back(Chunk{ k, begin, std::min(begin + s_chunkSize, n) });
+    }
+
+    // the gradient of each parameter is scaled by gradientScale, and clipped to the threshold norm if required;
+    // this needs the norms of the gradients, and thus a pass over the gradients before the update
+    const bool clipToNorm = update.clippingThreshold != std::numeric_limits<double>::infinity() && !update.clippingWithTruncation;
+    std::vector<ElemType> gradientScales(numParameters, (ElemType) update.gradientScale);
+    if (clipToNorm)
+    {
+        std::vector<double> chunkSqrSums(chunks.size());
+#pragma omp parallel for
+        for (long c = 0; c < (long) chunks.size(); c++)
+        {
+            const auto& chunk = chunks[c];
+            const ElemType* grad = gradients[chunk.parameter]->Data();
+            double sqrSum = 0;
+            for (size_t i = chunk.begin; i < chunk.end; i++)
+                sqrSum += (double) grad[i] * (double) grad[i];
+            chunkSqrSums[c] = sqrSum;
+        }
+
+        std::vector<double> sqrSums(numParameters, 0);
+        for (size_t c = 0; c < chunks.size(); c++)
+            sqrSums[chunks[c].parameter] += chunkSqrSums[c];
+        for (size_t k = 0; k < numParameters; k++)
+        {
+            double norm = update.gradientScale * sqrt(sqrSums[k]);
+            if (norm > update.clippingThreshold)
+                gradientScales[k] = (ElemType) (update.gradientScale * update.clippingThreshold / norm);
+        }
+    }
+
+    const bool truncate = update.clippingThreshold != std::numeric_limits<double>::infinity() && update.clippingWithTruncation;
+    const ElemType threshold = (ElemType) update.clippingThreshold;
+    const ElemType l2Weight = (ElemType) update.l2RegularizationWeight;
+    const ElemType learnRatePerSample = (ElemType) update.learnRatePerSample;
+    const ElemType momentum = (ElemType) update.momentum;
+    const ElemType unitGainFactor = (ElemType) (update.unitGainMomentum ? (1.0 - update.momentum) : 1.0);
+    const ElemType adaWeight = (ElemType) update.varMomentum;
+
+#pragma omp parallel
+    {
+        // the preprocessed gradient of the current chunk, g' = clip(gradientScale * g) + l2Weight * w
+        std::vector<ElemType> buffer(s_chunkSize);
+
+#pragma omp for
+        for (long c = 0; c < (long) chunks.size(); c++)
+        {
+            // (local copies of everything the loops below use, so that the compiler can keep them in registers while val[] is written)
+            const size_t k = chunks[c].parameter;
+            const size_t n = values[k]->GetNumElements();
+            const size_t count = chunks[c].end - chunks[c].begin;
+            ElemType* val = values[k]->Data() + chunks[c].begin;
+            ElemType* smoothed = smoothedGradientFactor > 0 ? smoothedGradients[k]->Data() + chunks[c].begin : nullptr;
+            const ElemType gradientScale = gradientScales[k];
+            const ElemType lr = learnRatePerSample;
+            const ElemType mom = momentum;
+            const ElemType unitGain = unitGainFactor;
+            const ElemType adaW = adaWeight;
+            const ElemType adaMultiplier = adaMul;
+
+            const ElemType* grad = gradients[k]->Data() + chunks[c].begin;
+            if (gradientScale != 1 || truncate || l2Weight != 0)
+            {
+                ElemType* g = buffer.data();
+                for (size_t i = 0; i < count; i++)
+                    g[i] = gradientScale * grad[i];
+                if (truncate)
+                {
+                    const ElemType t = threshold;
+                    for (size_t i = 0; i < count; i++)
+                        g[i] = g[i] < -t ? -t : (g[i] > t ? t : g[i]);
+                }
+                if (l2Weight != 0)
+                {
+                    const ElemType l2 = l2Weight;
+                    for (size_t i = 0; i < count; i++)
+                        g[i] += l2 * val[i];
+                }
+                grad = g;
+            }
+
+            switch (update.type)
+            {
+            case FusedUpdateType::SGD:
+                for (size_t i = 0; i < count; i++)
+                    val[i] -= lr * grad[i];
+                break;
+            case FusedUpdateType::MomentumSGD:
+                for (size_t i = 0; i < count; i++)
+                {
+                    smoothed[i] = unitGain * lr * grad[i] + mom * smoothed[i];
+                    val[i] -= smoothed[i];
+                }
+                break;
+            case FusedUpdateType::Nesterov:
+                for (size_t i = 0; i < count; i++)
+                {
+                    ElemType g = unitGain * lr * grad[i];
+                    smoothed[i] = g + mom * smoothed[i];
+                    val[i] -= mom * smoothed[i] + g;
+                }
+                break;
+            case FusedUpdateType::FSAdaGrad:
+            {
+                ElemType* smoothAda = smoothed;
+                ElemType* smoothMom = smoothed + n;
+                for (size_t i = 0; i < count; i++)
+                {
+                    ElemType g = grad[i];
+                    ElemType adaSqr = adaW * smoothAda[i] + (1.0f - adaW) * g * g;
+                    smoothAda[i] = adaSqr;
+                    if (adaSqr != 0.0f)
+                    {
+                        ElemType w = adaMultiplier * ((ElemType) 1.0 / sqrt(adaSqr));
+                        g *= w > 10.0f ? (ElemType) 10.0f : w;
+                    }
+                    if (mom > 0.0f)
+                    {
+                        g = mom * smoothMom[i] + unitGain * g;
+                        smoothMom[i] = g;
+                    }
+                    val[i] -= g * lr;
+                }
+                break;
+            }
+            case FusedUpdateType::Adam:
+            {
+                ElemType* smoothAda = smoothed;
+                ElemType* smoothMom = smoothed + n;
+                for (size_t i = 0; i < count; i++)
+                {
+                    ElemType g = grad[i];
+                    ElemType adaSqr = adaW * smoothAda[i] + (1.0f - adaW) * g * g;
+                    smoothAda[i] = adaSqr;
+                    ElemType w = adaMultiplier * (ElemType) (1.0 / (sqrt(adaSqr) + 1e-8));
+                    g = mom * smoothMom[i] + unitGain * g;
+                    smoothMom[i] = g;
+                    val[i] -= g * w * lr;
+                }
+                break;
+            }
+            }
+        }
+    }
+}
+
 template <class ElemType>
 ElemType CPUMatrix<ElemType>::RmsProp(CPUMatrix<ElemType>& gradients,
                                       ElemType RMS_GAMMA,
@@ -1506,10 +1700,13 @@ size_t CPUMatrix<ElemType>::CopyToArray(ElemType*& arrayCopyTo, size_t& currentA
 }
 
 template <typename ElemType>
-void CPUMatrix<ElemType>::CopySection(size_t /*numRows*/, size_t /*numCols*/, ElemType* /*dst*/, size_t /*colStride*/) const
+void CPUMatrix<ElemType>::CopySection(size_t numRows, size_t numCols, ElemType* dst, size_t colStride) const
 {
-    // REVIEW alexeyk: currently not used by CPU, but implement when possible.
-    RuntimeError("Not implemented.");
+    if (numRows > GetNumRows() || numCols > GetNumCols() || numRows > colStride)
+        InvalidArgument("CopySection: The section of %d x %d elements does not fit the matrix or the destination.", (int) numRows, (int) numCols);
+
+    for (size_t j = 0; j < numCols; j++)
+        memcpy(dst + j * colStride, Data() + LocateColumn(j), numRows * sizeof(ElemType));
 }
 
 template <class ElemType>
@@ -4721,6 +4918,203 @@ void CPUMatrix<ElemType>::BatchNormalizationBackward(const CPUMatrix<ElemType>&
     RuntimeError("Batch normalization training on CPU is not yet implemented.");
 }
 
+// -----------------------------------------------------------------------
+// RNNForward -- CPU implementation of the cuDNN RNN stack (inference only)
+//
+// The data layout is the one of CuDnnRNNExecutor: the columns of inputX and of the output are grouped by frame,
+// frame t holding numSequencesForFrame[t] sequences, sorted from longest to shortest.
+// The parameters use the cuDNN 5 layout of the packed weight buffer, so that models trained on the GPU
+// evaluate on the CPU with the same parameters:
+//  - first the weight matrices of all pseudo-layers (layer 0 forward, layer 0 backward, layer 1 forward, ...),
+//    each consisting of the input weights W of all gates followed by the recurrent weights R of all gates;
+//    every gate matrix is stored row-major (hiddenSize x inputDim) or (hiddenSize x hiddenSize),
+//  - then the biases of all pseudo-layers, each the input biases bW of all gates followed by the recurrent biases bR.
+// Gate order: lstm: input, forget, new memory, output; gru: reset, update, new memory.
+//
+// The input projection of all time steps is done in a single GEMM per pseudo-layer. The recurrence then needs
+// one GEMM of the recurrent weights with the state per time step, followed by a fused elementwise kernel for the gates.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+static inline ElemType RNNSigmoid(ElemType x)
+{
+    return (ElemType)1 / ((ElemType)1 + exp(-x));
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::RNNForward(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame,
+                                     const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    enum class CellType { LSTM, GRU, ReLU, Tanh };
+    const CellType cellType =
+        (rnnAttributes.m_recurrentOp == L"lstm") ? CellType::LSTM :
+        (rnnAttributes.m_recurrentOp == L"gru")  ? CellType::GRU  :
+        (rnnAttributes.m_recurrentOp == L"rnnReLU") ? CellType::ReLU :
+        /*else*/                                    CellType::Tanh;
+    const size_t numGates = (cellType == CellType::LSTM) ? 4 : (cellType == CellType::GRU) ? 3 : 1;
+    const size_t hiddenSize = rnnAttributes.m_hiddenSize;
+    const size_t numDirections = rnnAttributes.m_bidirectional ? 2 : 1;
+    const size_t numLayers = rnnAttributes.m_numLayers;
+    const size_t gatesDim = numGates * hiddenSize;
+
+    if (yDim != numDirections * hiddenSize)
+        LogicError("RNNForward: Unexpected output dimension (%d).", (int)yDim);
+
+    const auto numParameters = rnnAttributes.GetNumParameters(xDim);
+    if (paramW.GetNumElements() != numParameters.first * numParameters.second)
+        LogicError("RNNForward: The parameter matrix has %d elements, but %d are expected.", (int)paramW.GetNumElements(), (int)(numParameters.first * numParameters.second));
+
+    // column offsets of the frames
+    const size_t numFrames = numSequencesForFrame.size();
+    vector<size_t> frameStart(numFrames + 1, 0);
+    for (size_t t = 0; t < numFrames; t++)
+        frameStart[t + 1] = frameStart[t] + numSequencesForFrame[t];
+    // For a recurrence over a spatial axis, OptimizedRNNStackNode passes the transposed data in a matrix of the original
+    // shape (rows = all but the minibatch axis), hence only the number of elements of the input is checked.
+    const size_t numCols = frameStart[numFrames];
+    if (xDim * numCols != inputX.GetNumElements())
+        LogicError("RNNForward: numSequencesForFrame accounts for %d columns of dimension %d, but the input has %d elements.", (int)numCols, (int)xDim, (int)inputX.GetNumElements());
+    const size_t maxBatchSize = numFrames > 0 ? *max_element(numSequencesForFrame.begin(), numSequencesForFrame.end()) : 0;
+
+    RequireSize(yDim, numCols);
+    reserve.RequireSize(0, 0); // only needed for training
+    if (numCols == 0)
+        return;
+
+    // workspace: outputs of the two most recent layers (except the last one, which goes into this matrix),
+    // input projections, recurrent projections, hidden and cell state
+    const size_t layerOutputSize = (numLayers > 1 ? 2 : 0) * yDim * numCols;
+    workspace.RequireSize(layerOutputSize + gatesDim * numCols + gatesDim * maxBatchSize + 2 * hiddenSize * maxBatchSize, 1);
+    ElemType* layerOutput[2] = { workspace.Data(), workspace.Data() + yDim * numCols };
+    ElemType* gates = workspace.Data() + layerOutputSize;
+    ElemType* recurrent = gates + gatesDim * numCols;
+    ElemType* h = recurrent + gatesDim * maxBatchSize;
+    ElemType* c = h + hiddenSize * maxBatchSize;
+
+    ElemType* weights = paramW.Data();
+    const ElemType* biases = weights;
+    for (size_t layer = 0, inputDim = xDim; layer < numLayers; layer++, inputDim = yDim)
+        biases += numDirections * gatesDim * (inputDim + hiddenSize);
+
+    const ElemType* layerInput = inputX.Data();
+    size_t inputDim = xDim;
+    for (size_t layer = 0; layer < numLayers; layer++)
+    {
+        ElemType* output = (layer == numLayers - 1) ? Data() : layerOutput[layer % 2];
+        for (size_t direction = 0; direction < numDirections; direction++)
+        {
+            ElemType* W = weights;
+            ElemType* R = W + gatesDim * inputDim;
+            const ElemType* bW = biases;
+            const ElemType* bR = bW + gatesDim;
+            weights = R + gatesDim * hiddenSize;
+            biases = bR + gatesDim;
+
+            // input projection of all frames at once; the row-major gate matrices are column-major (inputDim x gatesDim)
+            CPUMatrix<ElemType> matW(inputDim, gatesDim, W, matrixFlagDontOwnBuffer);
+            CPUMatrix<ElemType> matX(inputDim, numCols, const_cast<ElemType*>(layerInput), matrixFlagDontOwnBuffer);
+            CPUMatrix<ElemType> matGates(gatesDim, numCols, gates, matrixFlagDontOwnBuffer);
+            MultiplyAndWeightedAdd(1, matW, true, matX, false, 0, matGates);
+
+            // fold in the biases, except the recurrent bias of the GRU new memory gate, which is scaled by the reset gate
+            const size_t numFoldedRecurrentBiases = (cellType == CellType::GRU) ? 2 * hiddenSize : gatesDim;
+#pragma omp parallel for
+            for (long j = 0; j < (long)numCols; j++)
+            {
+                ElemType* g = gates + j * gatesDim;
+                for (size_t i = 0; i < gatesDim; i++)
+                    g[i] += bW[i] + (i < numFoldedRecurrentBiases ? bR[i] : (ElemType)0);
+            }
+
+            CPUMatrix<ElemType> matR(hiddenSize, gatesDim, R, matrixFlagDontOwnBuffer);
+            size_t numActive = 0; // number of sequences whose state has been initialized
+            for (size_t step = 0; step < numFrames; step++)
+            {
+                const size_t t = (direction == 0) ? step : numFrames - 1 - step;
+                const size_t batchSize = numSequencesForFrame[t];
+
+                // sequences that start in this frame (sequences are sorted by length, so these are the last ones) start from a zero state
+                if (batchSize > numActive)
+                {
+                    memset(h + numActive * hiddenSize, 0, (batchSize - numActive) * hiddenSize * sizeof(ElemType));
+                    memset(c + numActive * hiddenSize, 0, (batchSize - numActive) * hiddenSize * sizeof(ElemType));
+                }
+                bool hasState = numActive > 0;
+                numActive = batchSize;
+
+                if (hasState)
+                {
+                    CPUMatrix<ElemType> matH(hiddenSize, batchSize, h, matrixFlagDontOwnBuffer);
+                    CPUMatrix<ElemType> matRecurrent(gatesDim, batchSize, recurrent, matrixFlagDontOwnBuffer);
+                    MultiplyAndWeightedAdd(1, matR, true, matH, false, 0, matRecurrent);
+                }
+                else
+                    memset(recurrent, 0, gatesDim * batchSize * sizeof(ElemType));
+
+                // fused gate kernel
+#pragma omp parallel for if (batchSize * gatesDim > 4096)
+                for (long j = 0; j < (long)batchSize; j++)
+                {
+                    const ElemType* g = gates + (frameStart[t] + j) * gatesDim;
+                    const ElemType* r = recurrent + j * gatesDim;
+                    ElemType* hj = h + j * hiddenSize;
+                    ElemType* cj = c + j * hiddenSize;
+                    ElemType* y = output + (frameStart[t] + j) * yDim + direction * hiddenSize;
+                    switch (cellType)
+                    {
+                    case CellType::LSTM:
+                        for (size_t i = 0; i < hiddenSize; i++)
+                        {
+                            ElemType inputGate  = RNNSigmoid(g[i]                  + r[i]);
+                            ElemType forgetGate = RNNSigmoid(g[i + hiddenSize]     + r[i + hiddenSize]);
+                            ElemType newMemory  =       tanh(g[i + 2 * hiddenSize] + r[i + 2 * hiddenSize]);
+                            ElemType outputGate = RNNSigmoid(g[i + 3 * hiddenSize] + r[i + 3 * hiddenSize]);
+                            cj[i] = forgetGate * cj[i] + inputGate * newMemory;
+                            y[i] = hj[i] = outputGate * tanh(cj[i]);
+                        }
+                        break;
+                    case CellType::GRU:
+                        for (size_t i = 0; i < hiddenSize; i++)
+                        {
+                            ElemType resetGate  = RNNSigmoid(g[i]              + r[i]);
+                            ElemType updateGate = RNNSigmoid(g[i + hiddenSize] + r[i + hiddenSize]);
+                            ElemType newMemory  = tanh(g[i + 2 * hiddenSize] + resetGate * (r[i + 2 * hiddenSize] + bR[i + 2 * hiddenSize]));
+                            y[i] = hj[i] = (1 - updateGate) * newMemory + updateGate * hj[i];
+                        }
+                        break;
+                    case CellType::ReLU:
+                        for (size_t i = 0; i < hiddenSize; i++)
+                            y[i] = hj[i] = max(g[i] + r[i], (ElemType)0);
+                        break;
+                    case CellType::Tanh:
+                        for (size_t i = 0; i < hiddenSize; i++)
+                            y[i] = hj[i] = tanh(g[i] + r[i]);
+                        break;
+                    }
+                }
+            }
+        }
+        layerInput = output;
+        inputDim = yDim;
+    }
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::RNNBackwardData(const CPUMatrix<ElemType>& outputDY, const CPUMatrix<ElemType>& paramW, CPUMatrix<ElemType>& outputDX, const RnnAttributes& rnnAttributes,
+                                          CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    UNUSED(outputDY); UNUSED(paramW); UNUSED(outputDX); UNUSED(rnnAttributes); UNUSED(reserve); UNUSED(workspace);
+    RuntimeError("OptimizedRNNStack training on CPU is not yet implemented.");
+}
+
+template <class ElemType>
+void CPUMatrix<ElemType>::RNNBackwardWeights(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& outputY, CPUMatrix<ElemType>& dw, const RnnAttributes& rnnAttributes,
+                                             CPUMatrix<ElemType>& reserve, CPUMatrix<ElemType>& workspace)
+{
+    UNUSED(inputX); UNUSED(outputY); UNUSED(dw); UNUSED(rnnAttributes); UNUSED(reserve); UNUSED(workspace);
+    RuntimeError("OptimizedRNNStack training on CPU is not yet implemented.");
+}
+
 
 #pragma region Static BLAS Functions
 
@@ -6568,6 +6962,14 @@ void CPUMatrix<ElemType>::SetCompatibleMode()
 
 // To save time, this makes extensive use of templates and macros.
 
+// Asks the compiler to vectorize the following stride-1 loop even though the element function is a lambda.
+// 'omp simd' is OpenMP 4.0; with older OpenMP versions (MSVC) we rely on the auto-vectorizer.
+#if defined(_OPENMP) && _OPENMP >= 201307
+#define TENSOROP_SIMD_LOOP _Pragma("omp simd")
+#else
+#define TENSOROP_SIMD_LOOP
+#endif
+
 // -----------------------------------------------------------------------
 // function to compute the value for a given output location (perform reduction if needed)
 // -----------------------------------------------------------------------
@@ -6726,6 +7128,7 @@ struct TensorOpIteration
 
 // Special version for innermost loop with strides all being 1 and no further reduction. Compiler can use SSE.
 // This is a very common case, e.g. adding vectors or computing the Sigmoid.
+// The loop is not parallelized here, the threads are distributed over the whole tensor by TensorOpWithParallelRegularLoop().
 template <class ElemType, typename OPFN, typename ReductionOp>
 struct TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, 0 /*innermost loop*/>
 {
@@ -6739,20 +7142,18 @@ struct TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/,
         size_t K = regularOpDims[0];
         // special-case beta and alpha to allow the compiler to short-circuit it
         if (beta != 0)
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
+            TENSOROP_SIMD_LOOP
+            for (size_t k = 0; k < K; k++)
                 TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else if (alpha != 1)
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
+            TENSOROP_SIMD_LOOP
+            for (size_t k = 0; k < K; k++)
                 TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
+            TENSOROP_SIMD_LOOP
+            for (size_t k = 0; k < K; k++)
                 TensorOpIteration<ElemType, OPFN, ReductionOp, 3, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 3>{pa + k, pb + k, pc + k}, 1, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         // TODO: According to Amit, the VS compiler is not able to vectorize into lambdas. Solution: change the lambda to take an N, or to implement the loop inside (with 1 element by default).
-        // TODO: The signedness of k (required for omp) causes an extra sign-extend.
-        // TODO: OMP adds LOTS of overhead. Do we need a guard, a min size when to use it?
     }
 };
 // and unary
@@ -6768,16 +7169,16 @@ struct TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/,
         size_t K = regularOpDims[0];
         // special-case beta and alpha to allow the compiler to short-circuit it
         if (beta != 0)
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
+            TENSOROP_SIMD_LOOP
+            for (size_t k = 0; k < K; k++)
                 TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(beta, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else if (alpha != 1)
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
+            TENSOROP_SIMD_LOOP
+            for (size_t k = 0; k < K; k++)
                 TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
         else
-#pragma omp parallel for
-            for (int k = 0; k < (int) K; k++)
+            TENSOROP_SIMD_LOOP
+            for (size_t k = 0; k < K; k++)
                 TensorOpIteration<ElemType, OPFN, ReductionOp, 2, true /*vectorizable*/, -1 /*no reduction*/, -1 /*scalar*/>::Loop(0, array<ElemType*, 2>{pa + k, pb + k}, 1, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     }
 };
@@ -6877,6 +7278,108 @@ static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& po
     }
 }
 
+// Tensors with fewer elements per thread than this (counting the reduced ones) are not worth the OpenMP overhead.
+static const size_t TensorOpMinElementsPerThread = 16384;
+
+// Picks the dimension to split across threads: the outermost one that has at least one slice per thread,
+// otherwise the largest one. Returns -1 if all dimensions are 1.
+static inline int TensorOpPartitionDim(const SmallVector<size_t>& opDims, size_t numThreads)
+{
+    int best = -1;
+    for (int j = (int)opDims.size() - 1; j >= 0; j--)
+    {
+        if (opDims[j] >= numThreads)
+            return j;
+        if (opDims[j] > 1 && (best < 0 || opDims[j] > opDims[best]))
+            best = j;
+    }
+    return best;
+}
+
+// reduces the slice [begin, end) of the outermost reduction index m into the same 'double' aggregator as TensorOpReduction
+template <class ElemType, typename OPFN, typename ReductionOp, size_t N, int m>
+static double TensorOpReduceSlice(array<ElemType*, N> pointers, const OPFN& opfn, const ReductionOp& reductionOp,
+                                  const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides,
+                                  size_t begin, size_t end)
+{
+    for (size_t i = 0; i < N - 1; i++)
+        pointers[i] += (ptrdiff_t)begin * reducingStrides[i][(size_t)m];
+    double aggregate = TensorOpReduction<ElemType, OPFN, ReductionOp, N, m - 1>::Loop(pointers, opfn, reductionOp, reducingOpDims, reducingStrides);
+    for (size_t dim = begin + 1; dim < end; dim++)
+    {
+        for (size_t i = 0; i < N - 1; i++)
+            pointers[i] += reducingStrides[i][(size_t)m];
+        aggregate = reductionOp(aggregate, TensorOpReduction<ElemType, OPFN, ReductionOp, N, m - 1>::Loop(pointers, opfn, reductionOp, reducingOpDims, reducingStrides));
+    }
+    return aggregate;
+}
+
+// tensor operation with k+1 dimensions, distributed over the OpenMP threads
+//  - If there are regular dimensions, one of them is split into slices, one per thread. Every thread runs the
+//    single-threaded loop on its sub-tensor; the sub-tensors do not overlap in the output.
+//  - Otherwise (reduction to a scalar) the outermost reduction dimension is split. Every thread reduces its part into a 'double'
+//    partial result, as the single-threaded loop does, and the partial results are combined in thread order, so the result
+//    does not depend on timing.
+template <class ElemType, typename OPFN, typename ReductionOp, size_t N, int k>
+static void TensorOpWithParallelRegularLoop(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn, ReductionOp reductionOp,
+                                            const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+{
+    size_t numElements = 1;
+    for (size_t j = 0; j < regularOpDims.size(); j++)
+        numElements *= regularOpDims[j];
+    for (size_t j = 0; j < reducingOpDims.size(); j++)
+        numElements *= reducingOpDims[j];
+
+    size_t numThreads = min((size_t)omp_get_max_threads(), numElements / TensorOpMinElementsPerThread);
+    // (unsupported reduction ranks are reported by the single-threaded version)
+    if (numThreads <= 1 || omp_in_parallel() || reducingOpDims.size() > 2)
+        return TensorOpWithRegularLoop<ElemType, OPFN, ReductionOp, N, k>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+
+    bool splitRegular = k >= 0;
+    int splitDim = splitRegular ? TensorOpPartitionDim(regularOpDims, numThreads) : (int)reducingOpDims.size() - 1;
+    size_t splitSize = splitDim < 0 ? 1 : (splitRegular ? regularOpDims[splitDim] : reducingOpDims[splitDim]);
+    numThreads = min(numThreads, splitSize);
+    if (numThreads <= 1)
+        return TensorOpWithRegularLoop<ElemType, OPFN, ReductionOp, N, k>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+
+    vector<double> partialResults(splitRegular ? 0 : numThreads);
+#pragma omp parallel for num_threads((int)numThreads) schedule(static, 1)
+    for (int t = 0; t < (int)numThreads; t++)
+    {
+        size_t begin = splitSize * t / numThreads;
+        size_t end = splitSize * (t + 1) / numThreads;
+
+        if (splitRegular)
+        {
+            SmallVector<size_t> sliceDims = regularOpDims;
+            sliceDims[splitDim] = end - begin;
+            array<ElemType*, N> slicePointers = pointers;
+            for (size_t i = 0; i < N; i++)
+                slicePointers[i] += (ptrdiff_t)begin * regularStrides[i][splitDim];
+            TensorOpWithRegularLoop<ElemType, OPFN, ReductionOp, N, k>(beta, slicePointers, alpha, opfn, reductionOp, sliceDims, regularStrides, reducingOpDims, reducingStrides);
+        }
+        else if (splitDim == 1)
+            partialResults[t] = TensorOpReduceSlice<ElemType, OPFN, ReductionOp, N, 1>(pointers, opfn, reductionOp, reducingOpDims, reducingStrides, begin, end);
+        else
+            partialResults[t] = TensorOpReduceSlice<ElemType, OPFN, ReductionOp, N, 0>(pointers, opfn, reductionOp, reducingOpDims, reducingStrides, begin, end);
+    }
+
+    if (!splitRegular)
+    {
+        double aggregate = partialResults[0];
+        for (size_t t = 1; t < numThreads; t++)
+            aggregate = reductionOp(aggregate, partialResults[t]);
+        // scale and combine with previous value in target, as in the single-threaded version
+        ElemType val = static_cast<ElemType>(aggregate);
+        val *= alpha;
+        auto* pout = pointers.back();
+        if (beta != 0)
+            val += beta * *pout;
+        *pout = val;
+    }
+}
+
 // tensor operation, generalized in number of arguments, operation already provided as a lambda
 // This function now expands into different k.
 template <class ElemType, typename OPFN, typename ReductionOp, size_t N>
@@ -6891,15 +7394,15 @@ static void TensorOpWithFnAndReduction(ElemType beta, array<ElemType*, N> pointe
     switch (dims)
     {
     case 4:
-        return TensorOpWithRegularLoop<ElemType, OPFN, ReductionOp, N, 3>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithParallelRegularLoop<ElemType, OPFN, ReductionOp, N, 3>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 3:
-        return TensorOpWithRegularLoop<ElemType, OPFN, ReductionOp, N, 2>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithParallelRegularLoop<ElemType, OPFN, ReductionOp, N, 2>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 2:
-        return TensorOpWithRegularLoop<ElemType, OPFN, ReductionOp, N, 1>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithParallelRegularLoop<ElemType, OPFN, ReductionOp, N, 1>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 1:
-        return TensorOpWithRegularLoop<ElemType, OPFN, ReductionOp, N, 0>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithParallelRegularLoop<ElemType, OPFN, ReductionOp, N, 0>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 0:
-        return TensorOpWithRegularLoop<ElemType, OPFN, ReductionOp, N, -1>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+        return TensorOpWithParallelRegularLoop<ElemType, OPFN, ReductionOp, N, -1>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     default:
         LogicError("TensorOp: %d non-flattened input dimensions are not supported.", (int)dims);
     }
@@ -6919,6 +7422,8 @@ static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType
 // * It is not consitent with what we do on GPU, there we aggregate on ElemType.
 // * It costs performance.
 // TODO: apdapt e2e tests to run with aggregator of type ElemType.
+// The per-thread partial results of TensorOpWithParallelRegularLoop() are 'double' as well, so that the result of a
+// reduction does not depend on the number of threads beyond the order of the additions.
 #define CaseTensorOpWithFnAndReduction(oper)                                                  \
     case ElementWiseOperator::op##oper:                                                       \
     return TensorOpWithFnAndReduction(beta, pointers, alpha, opfn, [](double a, double b)     \
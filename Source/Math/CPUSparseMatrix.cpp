@@ -17,6 +17,9 @@
 #include <random>
 #include <chrono>
 #include <iostream>
+#include <atomic>
+#include <numeric>
+#include <algorithm>
 #ifdef LEAKDETECT
 #include <vld.h>
 #endif
@@ -870,6 +873,111 @@ void CPUSparseMatrix<ElemType>::Reset()
     SetBlockIdShift(0);
 }
 
+template <class ElemType>
+struct CPUSparseMatrix<ElemType>::CSRView
+{
+    // Structure of the CSC matrix the view was built for (relative to its first nonzero element).
+    vector<CPUSPARSE_INDEX_TYPE> m_columnStarts;
+    vector<CPUSPARSE_INDEX_TYPE> m_rowIndices;
+    size_t m_numRows;
+
+    vector<CPUSPARSE_INDEX_TYPE> m_rows;         // Rows with nonzero elements, in ascending order.
+    vector<CPUSPARSE_INDEX_TYPE> m_rowStarts;    // Position of the first element of each of m_rows, followed by the number of elements.
+    vector<CPUSPARSE_INDEX_TYPE> m_columns;      // Column of each element in the row-major order.
+    vector<CPUSPARSE_INDEX_TYPE> m_valueIndices; // Position of each element in the values of the matrix (relative to its first nonzero element).
+};
+
+static std::atomic<bool> s_csrViewCaching(true);
+
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::SetCSRViewCaching(bool enable)
+{
+    s_csrViewCaching = enable;
+}
+
+template <class ElemType>
+std::shared_ptr<const typename CPUSparseMatrix<ElemType>::CSRView> CPUSparseMatrix<ElemType>::GetCSRView() const
+{
+    if (GetFormat() != matrixFormatSparseCSC)
+        LogicError("CPUSparseMatrix::GetCSRView is only applicable to the sparse CSC format.");
+
+    // Note: NzCount() does not take the column offset of slice views into account.
+    const size_t numCols = GetNumCols();
+    const CPUSPARSE_INDEX_TYPE* columnStarts = SecondaryIndexLocation();
+    const CPUSPARSE_INDEX_TYPE* rowIndices = MajorIndexLocation();
+    const CPUSPARSE_INDEX_TYPE firstNonzero = columnStarts[0];
+    const size_t nz = columnStarts[numCols] - firstNonzero;
+
+    // The cached view is valid if the nonzero elements are at the same positions.
+    // Products with the same (const) matrix may run concurrently, hence the atomic access to the cache.
+    auto view = atomic_load(&m_csrView);
+    if (view && view->m_numRows == GetNumRows() && view->m_columnStarts.size() == numCols + 1 && view->m_rowIndices.size() == nz &&
+        equal(view->m_rowIndices.begin(), view->m_rowIndices.end(), rowIndices))
+    {
+        bool valid = true;
+        for (size_t j = 0; j <= numCols && valid; j++)
+            valid = view->m_columnStarts[j] == columnStarts[j] - firstNonzero;
+
+        if (valid)
+            return view;
+    }
+
+    auto result = make_shared<CSRView>();
+    result->m_numRows = GetNumRows();
+    result->m_columnStarts.resize(numCols + 1);
+    result->m_rowIndices.assign(rowIndices, rowIndices + nz);
+
+    vector<CPUSPARSE_INDEX_TYPE> columnOf(nz);
+    for (size_t j = 0; j < numCols; j++)
+    {
+        result->m_columnStarts[j] = columnStarts[j] - firstNonzero;
+        for (CPUSPARSE_INDEX_TYPE p = columnStarts[j] - firstNonzero; p < columnStarts[j + 1] - firstNonzero; p++)
+            columnOf[p] = (CPUSPARSE_INDEX_TYPE)j;
+    }
+    result->m_columnStarts[numCols] = (CPUSPARSE_INDEX_TYPE)nz;
+
+    // Sorting the elements by row. The sort is stable, so elements of a row stay ordered by column,
+    // which keeps the order of summation in the products the same as with the CSC matrix.
+    auto& order = result->m_valueIndices;
+    order.resize(nz);
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [rowIndices](CPUSPARSE_INDEX_TYPE a, CPUSPARSE_INDEX_TYPE b) { return rowIndices[a] < rowIndices[b]; });
+
+    result->m_columns.resize(nz);
+    for (size_t p = 0; p < nz; p++)
+    {
+        auto row = rowIndices[order[p]];
+        if (result->m_rows.empty() || result->m_rows.back() != row)
+        {
+            result->m_rows.push_back(row);
+            result->m_rowStarts.push_back((CPUSPARSE_INDEX_TYPE)p);
+        }
+        result->m_columns[p] = columnOf[order[p]];
+    }
+    result->m_rowStarts.push_back((CPUSPARSE_INDEX_TYPE)nz);
+
+    if (s_csrViewCaching)
+        atomic_store(&m_csrView, std::shared_ptr<const CSRView>(result));
+    return result;
+}
+
+// y[i * incy] += alpha * x[i * incx], i = 0..n-1
+// The contiguous case is written so that the compiler vectorizes it.
+template <class ElemType>
+static inline void ScaleAndAddVector(size_t n, ElemType alpha, const ElemType* x, size_t incx, ElemType* y, size_t incy)
+{
+    if (incx == 1 && incy == 1)
+    {
+        for (size_t i = 0; i < n; i++)
+            y[i] += alpha * x[i];
+    }
+    else
+    {
+        for (size_t i = 0; i < n; i++)
+            y[i * incy] += alpha * x[i * incx];
+    }
+}
+
 // Implements product of one sparse and one dense matrix updating a third dense matrix. Input matrices are optionally transposed.
 // NOTE: The only for using a class template instead of a function template was that I couldn't make the function template compile.
 template <class ElemType, bool denseTimesSparse /* false means SparseTimesDense */, bool transposeA, bool transposeB>
@@ -928,52 +1036,63 @@ public:
         // * checked that the matrices are compatible in size
         // * Initialized the output matrix c
 
-        // Now do the actual multiplication.
-        ElemType* valueBuffer = sparse.Buffer() + *sparse.SecondaryIndexLocation(); // Points to the value buffer of the current view (i.e. buffer containing values of non-zero elements).
-        int* rowIndexBuffer = sparse.MajorIndexLocation();                          // Points to the index buffer of the current view (i.e. buffer containing indices of non-zero elements).
-        size_t iNonzero = 0;                                                           // Number of nonzero elements handled so far for curent slice view.
-        int numPreviosNonzero = sparse.SecondaryIndexLocation()[0];                 // Total number of nonzero values handled in previous slices.
+        // Every nonzero element s of the sparse matrix adds s * (a row or column of the dense matrix) to a row or column of c.
+        // The row or column of c is given by the 'outer' index of the element (its row or column, depending on the case), the one of
+        // the dense matrix by the 'inner' index. Elements with the same outer index are processed by the same thread, so that the
+        // threads never update the same elements of c: if the outer index is the column, CSC already groups the elements by it,
+        // otherwise the CSR view of the sparse matrix is used.
+        // Below if-statements are evaluated at compile time.
+        const bool outerIndexIsColumn = (denseTimesSparse && !transposeB) || (!denseTimesSparse && transposeA);
 
-        // Loop over columns of the sparse matrix
-        for (size_t colSparse = 0; colSparse < sparse.GetNumCols(); colSparse++)
+        // Not worth forking threads for small products.
+        const size_t numNonzero = sparse.SecondaryIndexLocation()[sparse.GetNumCols()] - sparse.SecondaryIndexLocation()[0];
+        const bool runInParallel = numNonzero * outerDimensionDense >= 64 * 1024;
+
+        const ElemType* valueBuffer = sparse.Buffer() + *sparse.SecondaryIndexLocation(); // Points to the value buffer of the current view (i.e. buffer containing values of non-zero elements).
+        if (outerIndexIsColumn)
         {
-            size_t numNonzeroInSparseCol = sparse.SecondaryIndexLocation()[colSparse + 1] - numPreviosNonzero;
-            // Loop over the nonzero rows of the current column of the sparse matrix
-            for (; iNonzero < numNonzeroInSparseCol; iNonzero++)
+            const CPUSPARSE_INDEX_TYPE* columnStarts = sparse.SecondaryIndexLocation();
+            const CPUSPARSE_INDEX_TYPE* rowIndexBuffer = sparse.MajorIndexLocation(); // Points to the index buffer of the current view.
+            const CPUSPARSE_INDEX_TYPE firstNonzero = columnStarts[0];
+
+#pragma omp parallel for schedule(dynamic, 16) if (runInParallel)
+            for (int colSparse = 0; colSparse < (int)sparse.GetNumCols(); colSparse++)
             {
-                size_t rowSparse = rowIndexBuffer[iNonzero]; // RowLocation
-                ElemType sparseVal = valueBuffer[iNonzero];
-
-                // Determine the index of the 'outer' dimension of the sparse matrix and the common inner index.
-                size_t outerIndexSparse;
-                size_t innerIndex;
-                // Below if-statements are evaluated at compile time.
-                if      ( denseTimesSparse && !transposeB) { outerIndexSparse = colSparse; innerIndex = rowSparse; }
-                else if ( denseTimesSparse &&  transposeB) { outerIndexSparse = rowSparse; innerIndex = colSparse; }
-                else if (!denseTimesSparse && !transposeA) { outerIndexSparse = rowSparse; innerIndex = colSparse; }
-                else if (!denseTimesSparse &&  transposeA) { outerIndexSparse = colSparse; innerIndex = rowSparse; }
-
-                // Loop over the outer index of the dense matrix
-                for (size_t outerIndexDense = 0; outerIndexDense < outerDimensionDense; outerIndexDense++)
-                {
-                    // Determine the row index of the dense input matrix.
-                    // Below if-statements are evaluated at compile time.
-                    ElemType denseVal;
-                    if      ( denseTimesSparse && !transposeA) denseVal = dense(outerIndexDense,      innerIndex);
-                    else if ( denseTimesSparse &&  transposeA) denseVal = dense(     innerIndex, outerIndexDense);
-                    else if (!denseTimesSparse && !transposeB) denseVal = dense(     innerIndex, outerIndexDense);
-                    else if (!denseTimesSparse &&  transposeB) denseVal = dense(outerIndexDense,      innerIndex);
-                    
-
-                    // Update matrix c.
-                    if (denseTimesSparse)
-                        c(outerIndexDense, outerIndexSparse) += alpha * denseVal * sparseVal;
-                    else /*Sparse times dense */
-                        c(outerIndexSparse, outerIndexDense) += alpha * denseVal * sparseVal;
-                }
+                for (CPUSPARSE_INDEX_TYPE p = columnStarts[colSparse] - firstNonzero; p < columnStarts[colSparse + 1] - firstNonzero; p++)
+                    Update(alpha * valueBuffer[p], colSparse /*outerIndexSparse*/, rowIndexBuffer[p] /*innerIndex*/, dense, outerDimensionDense, c);
+            }
+        }
+        else
+        {
+            auto view = sparse.GetCSRView();
+
+#pragma omp parallel for schedule(dynamic, 16) if (runInParallel)
+            for (int i = 0; i < (int)view->m_rows.size(); i++)
+            {
+                for (CPUSPARSE_INDEX_TYPE p = view->m_rowStarts[i]; p < view->m_rowStarts[i + 1]; p++)
+                    Update(alpha * valueBuffer[view->m_valueIndices[p]], view->m_rows[i] /*outerIndexSparse*/, view->m_columns[p] /*innerIndex*/, dense, outerDimensionDense, c);
             }
         }
     }
+
+private:
+    // Adds scale times the row or column 'innerIndex' of the dense matrix to the row or column 'outerIndexSparse' of c.
+    static inline void Update(ElemType scale, size_t outerIndexSparse, size_t innerIndex, const CPUMatrix<ElemType>& dense, size_t outerDimensionDense, CPUMatrix<ElemType>& c)
+    {
+        // Matrices are column major, so columns are contiguous and rows have the stride of the number of rows.
+        // Below if-statements are evaluated at compile time.
+        const ElemType* denseVector;
+        size_t denseStride;
+        if      ( denseTimesSparse && !transposeA) { denseVector = dense.Data() + innerIndex * dense.GetNumRows(); denseStride = 1; }                 // dense(:, innerIndex)
+        else if ( denseTimesSparse &&  transposeA) { denseVector = dense.Data() + innerIndex;                      denseStride = dense.GetNumRows(); } // dense(innerIndex, :)
+        else if (!denseTimesSparse && !transposeB) { denseVector = dense.Data() + innerIndex;                      denseStride = dense.GetNumRows(); } // dense(innerIndex, :)
+        else                                       { denseVector = dense.Data() + innerIndex * dense.GetNumRows(); denseStride = 1; }                 // dense(:, innerIndex)
+
+        if (denseTimesSparse) // c(:, outerIndexSparse)
+            ScaleAndAddVector(outerDimensionDense, scale, denseVector, denseStride, c.Data() + outerIndexSparse * c.GetNumRows(), (size_t)1);
+        else /*Sparse times dense */ // c(outerIndexSparse, :)
+            ScaleAndAddVector(outerDimensionDense, scale, denseVector, denseStride, c.Data() + outerIndexSparse, c.GetNumRows());
+    }
 };
 
 // c = alpha * lhs * rhs + beta * c
@@ -1079,22 +1198,22 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
             memset(c.Data() + m * blockSizePrev, 0, sizeof(ElemType) * m * (blockSizeCurr - blockSizePrev));
         }
 
-        for (size_t rhsCol = 0; rhsCol < rhs.GetNumCols(); rhsCol++)
-        {
-            size_t start = rhs.SecondaryIndexLocation()[rhsCol];
-            size_t end = rhs.SecondaryIndexLocation()[rhsCol + 1];
+        // Each row of rhs updates its own block of c, so the rows are processed in parallel.
+        auto view = rhs.GetCSRView();
+        const ElemType* values = rhs.Buffer() + rhs.SecondaryIndexLocation()[0];
+        const bool runInParallel = view->m_columns.size() * m >= 64 * 1024;
 
-            for (size_t p = start; p < end; p++)
+#pragma omp parallel for schedule(dynamic, 4) if (runInParallel)
+        for (int i = 0; i < (int)view->m_rows.size(); i++)
+        {
+            ElemType* results = c.Buffer() + col2BlockId.find(view->m_rows[i])->second * m;
+            for (CPUSPARSE_INDEX_TYPE p = view->m_rowStarts[i]; p < view->m_rowStarts[i + 1]; p++)
             {
-                size_t rhsRow = rhs.MajorIndexLocation()[p];
-                ElemType val = rhs.Buffer()[p];
+                size_t rhsCol = view->m_columns[p];
+                ElemType val = values[view->m_valueIndices[p]];
 
-                ElemType* results = c.Buffer() + col2BlockId[rhsRow] * m;
-                #pragma omp parallel for
-                for (int lhsRow = 0; lhsRow < (int)m; lhsRow++)
-                {
-                    results[lhsRow] += alpha * lhs((size_t)lhsRow, rhsCol) * val;
-                }
+                // results += alpha * val * lhs(:, rhsCol)
+                ScaleAndAddVector(m, alpha * val, lhs.Data() + rhsCol * lhs.GetNumRows(), (size_t)1, results, (size_t)1);
             }
         }
     }
@@ -1438,6 +1557,191 @@ void CPUSparseMatrix<ElemType>::AdaDelta(CPUMatrix<ElemType>& c, CPUMatrix<ElemT
     }
 }
 
+// Lazy FSAdaGrad, Adam and RmsProp updates for block-sparse column gradients (e.g. the gradient of an embedding).
+// In contrast to the dense updates, which also decay the accumulators of the columns with zero gradient and keep
+// moving them along their momentum, only the columns that are present in the gradient are updated, together with
+// their accumulators in 'c'. The cost is thus proportional to the number of columns used by the minibatch, not to
+// the size of the model. The timestep that enters the update (adaMul, i.e. the FSAdaGrad multiplier resp. the Adam
+// bias correction) is still the one of the parameter as a whole, which is advanced once per minibatch by the caller.
+
+// c = [smoothAda; smoothMom], as in CPUMatrix::FSAdagrad()
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample,
+                                          ElemType momentum, ElemType adaWeight, ElemType adaMul, bool unitGainMomentum)
+{
+    size_t numColsNeeded = 2 * GetNumCols();
+
+    if (c.IsEmpty() || (c.GetNumCols() < numColsNeeded))
+    {
+        c.RequireSize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+    }
+
+    if (c.GetNumRows() != GetNumRows() || c.GetNumCols() != numColsNeeded)
+        LogicError("The matrix gradients does not have expected dimensions.");
+
+    if (functionValues.GetNumRows() != GetNumRows() || functionValues.GetNumCols() != GetNumCols())
+        LogicError("The matrix functionValues does not have expected dimensions.");
+
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        LogicError("Unsupported sparse format.");
+
+    const auto unitGainFactor = ElemType(unitGainMomentum ? (1.0 - momentum) : 1.0);
+    size_t n = GetNumElements();
+    size_t len = GetNumRows();
+    const ElemType* grad = Data();
+    ElemType* smoothAda = c.Data();
+    ElemType* smoothMom = c.Data() + n;
+    ElemType* val = functionValues.Data();
+
+#pragma omp parallel for
+    for (long j = 0; j < (long) GetBlockSize(); j++)
+    {
+        size_t i = GetBlockIds()[j] - GetBlockIdShift();
+        for (size_t r = 0; r < len; r++)
+        {
+            size_t denseIndex = i * len + r;
+            ElemType g = grad[j * len + r];
+            ElemType adaSqr = adaWeight * smoothAda[denseIndex] + (1.0f - adaWeight) * g * g;
+            smoothAda[denseIndex] = adaSqr;
+            if (adaSqr != 0.0f)
+            {
+                ElemType w = adaMul * ((ElemType) 1.0 / sqrt(adaSqr));
+                if (w > 10.0f)
+                    w = 10.0f;
+                g *= w;
+            }
+
+            if (momentum > 0.0f)
+            {
+                g = momentum * smoothMom[denseIndex] + unitGainFactor * g;
+                smoothMom[denseIndex] = g;
+            }
+
+            val[denseIndex] -= g * learnRatePerSample;
+        }
+    }
+}
+
+// c = [avars; signs; steps], as in CPUMatrix::RmsProp(). The gradient (this) is scaled in place.
+// The returned average multiplier is taken over the elements present in the gradient.
+template <class ElemType>
+ElemType CPUSparseMatrix<ElemType>::RmsProp(CPUMatrix<ElemType>& c, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX,
+                                            ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier)
+{
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        LogicError("Unsupported sparse format.");
+
+    const ElemType floor = 1e-6f;
+    size_t n = GetNumElements();
+    size_t len = GetNumRows();
+    ElemType* grad = Data();
+
+    size_t numColsNeeded = 3 * GetNumCols();
+    bool initialize = c.IsEmpty() || (c.GetNumCols() < numColsNeeded);
+    if (initialize)
+    {
+        c.RequireSize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+
+        // initialize the starting step size (the variances are initialized with the gradient below)
+        ElemType* steps = c.Data() + 2 * n;
+        for (size_t i = 0; i < n; i++)
+            steps[i] = ElemType(0.02);
+    }
+
+    if (c.GetNumRows() != GetNumRows() || c.GetNumCols() != numColsNeeded)
+        LogicError("The matrix gradients does not have expected dimensions.");
+
+    ElemType* avars = c.Data();         // accumulated variances for RMS scaling
+    ElemType* signs = c.Data() + n;     // sign of previous gradient
+    ElemType* steps = c.Data() + 2 * n; // current step size
+    const ElemType ONE_MINUS_GAMMA = ElemType(1.0) - RMS_GAMMA;
+
+    ElemType aveMultiplier = 0;
+#pragma omp parallel for reduction(+ : aveMultiplier)
+    for (long j = 0; j < (long) GetBlockSize(); j++)
+    {
+        size_t i = GetBlockIds()[j] - GetBlockIdShift();
+        for (size_t r = 0; r < len; r++)
+        {
+            size_t denseIndex = i * len + r;
+            ElemType& g = grad[j * len + r];
+            if (initialize)
+                avars[denseIndex] = g * g;
+
+            avars[denseIndex] = RMS_GAMMA * avars[denseIndex] + ONE_MINUS_GAMMA * (g * g);
+            const int grad_sign = (ElemType(0) < g) - (g < ElemType(0));
+
+            if (signs[denseIndex] * grad_sign > 0)
+                steps[denseIndex] = std::min(steps[denseIndex] * RMS_WGT_INC, RMS_WGT_MAX);
+            else
+                steps[denseIndex] = std::max(steps[denseIndex] * RMS_WGT_DEC, RMS_WGT_MIN);
+
+            ElemType a = steps[denseIndex] / sqrt(avars[denseIndex] + floor);
+            g *= a;
+            signs[denseIndex] = (ElemType) grad_sign;
+
+            aveMultiplier += a;
+        }
+    }
+
+    size_t nz = NzCount();
+    if (needAveMultiplier && nz > 0)
+        return aveMultiplier / nz;
+    else
+        return 1;
+}
+
+// c = [smoothAda; smoothMom], as in CPUMatrix::Adam()
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::Adam(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample,
+                                     ElemType momentum, ElemType adaWeight, ElemType adaMul, bool unitGainMomentum)
+{
+    size_t numColsNeeded = 2 * GetNumCols();
+
+    if (c.IsEmpty() || (c.GetNumCols() < numColsNeeded))
+    {
+        c.RequireSize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+    }
+
+    if (c.GetNumRows() != GetNumRows() || c.GetNumCols() != numColsNeeded)
+        LogicError("The matrix gradients does not have expected dimensions.");
+
+    if (functionValues.GetNumRows() != GetNumRows() || functionValues.GetNumCols() != GetNumCols())
+        LogicError("The matrix functionValues does not have expected dimensions.");
+
+    if (GetFormat() != MatrixFormat::matrixFormatSparseBlockCol)
+        LogicError("Unsupported sparse format.");
+
+    const auto unitGainFactor = ElemType(unitGainMomentum ? (1.0 - momentum) : 1.0);
+    size_t n = GetNumElements();
+    size_t len = GetNumRows();
+    const ElemType* grad = Data();
+    ElemType* smoothAda = c.Data();
+    ElemType* smoothMom = c.Data() + n;
+    ElemType* val = functionValues.Data();
+
+#pragma omp parallel for
+    for (long j = 0; j < (long) GetBlockSize(); j++)
+    {
+        size_t i = GetBlockIds()[j] - GetBlockIdShift();
+        for (size_t r = 0; r < len; r++)
+        {
+            size_t denseIndex = i * len + r;
+            ElemType g = grad[j * len + r];
+            ElemType adaSqr = adaWeight * smoothAda[denseIndex] + (1.0f - adaWeight) * g * g;
+            smoothAda[denseIndex] = adaSqr;
+            ElemType ada = sqrt(adaSqr);
+            ElemType w = adaMul * (ElemType)(1.0 / (ada + 1e-8));
+            g = momentum * smoothMom[denseIndex] + unitGainFactor * g;
+            smoothMom[denseIndex] = g;
+            val[denseIndex] -= g * w * learnRatePerSample;
+        }
+    }
+}
+
 template <class ElemType>
 CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::InplaceTruncateTop(const ElemType threshold)
 {
@@ -136,6 +136,17 @@ public:
 
     static void ColumnwiseScaleAndWeightedAdd(ElemType alpha, const CPUSparseMatrix<ElemType>& a, const CPUMatrix<ElemType>& v, ElemType beta, CPUMatrix<ElemType>& c);
 
+    // Row-major (CSR) index of the nonzero elements of a CSC matrix, used by the products that need the
+    // elements grouped by rows (e.g. with the transposed matrix in backprop).
+    struct CSRView;
+
+    // Returns the CSR view of the matrix. If caching is enabled, the view is kept with the matrix and reused
+    // as long as the positions of the nonzero elements do not change, the values are always read from the matrix.
+    std::shared_ptr<const CSRView> GetCSRView() const;
+
+    // This function does not depend on <ElemType>. The caching is enabled by default.
+    static void SetCSRViewCaching(bool enable);
+
     static void ScaleAndAdd(const ElemType alpha, const CPUSparseMatrix<ElemType>& lhs, CPUMatrix<ElemType>& c);
 
     static bool AreEqual(const CPUSparseMatrix<ElemType>& a, const CPUSparseMatrix<ElemType>& b, const ElemType threshold = 1e-8);
@@ -233,6 +244,11 @@ public:
     ElemType Adagrad(CPUMatrix<ElemType>& c, const bool needAveMultiplier);
     void AdaDelta(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learningRate, ElemType rho, ElemType epsilon);
 
+    // lazy updates: only the columns that are present in the (block-sparse column) gradient are updated, see CPUSparseMatrix.cpp
+    void FSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul, bool unitGainMomentum);
+    ElemType RmsProp(CPUMatrix<ElemType>& c, ElemType RMS_GAMMA, ElemType RMS_WGT_INC, ElemType RMS_WGT_MAX, ElemType RMS_WGT_DEC, ElemType RMS_WGT_MIN, const bool needAveMultiplier);
+    void Adam(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul, bool unitGainMomentum);
+
 public:
     CPUSparseMatrix<ElemType>& InplaceTruncateTop(const ElemType threshold);
     CPUSparseMatrix<ElemType>& InplaceTruncateBottom(const ElemType threshold);
@@ -244,6 +260,10 @@ public:
     ElemType SumOfAbsElements() const; // sum of all abs(elements)
     ElemType SumOfElements() const;    // sum of all elements
 
+private:
+    // Cached CSR view, see GetCSRView(). Only accessed through std::atomic_load/atomic_store.
+    mutable std::shared_ptr<const CSRView> m_csrView;
+
 public:
     void Print(const char* matrixName, ptrdiff_t rowStart, ptrdiff_t rowEnd, ptrdiff_t colStart, ptrdiff_t colEnd) const;
     void Print(const char* matrixName = NULL) const; // print whole matrix. can be expensive
@@ -20,6 +20,7 @@
 #include <memory>
 #include <unordered_map>
 #include <map>
+#include <limits>
 
 #pragma warning( disable: 4251 )
 typedef unsigned char byte;
@@ -220,6 +221,39 @@ enum MatrixFlags
     matrixFlagSetValueOnDevice = 1 << bitPosSetValueOnDevice, // SetValue() call has a buffer that is already on the device
 };
 
+// -----------------------------------------------------------------------
+// FusedUpdate -- describes an update of model parameters that Matrix::FusedParameterUpdate()
+// applies to many parameters at once, together with the preprocessing of their gradients:
+//     g' = clip(gradientScale * g) + l2RegularizationWeight * w
+// where clip() either truncates each element to [-clippingThreshold, clippingThreshold]
+// or scales the gradient of each parameter down to a Frobenius norm of clippingThreshold.
+// -----------------------------------------------------------------------
+
+enum class FusedUpdateType
+{
+    SGD,         // w -= lr * g' (the smoothed gradients are not used)
+    MomentumSGD, // see Matrix::MomentumSGDUpdate(), smoothed gradients of the size of w
+    Nesterov,    // see Matrix::NesterovAcceleratedMomentumSGDUpdate(), smoothed gradients of the size of w
+    FSAdaGrad,   // see Matrix::FSAdagradUpdate(), smoothed gradients of twice the size of w
+    Adam,        // see Matrix::AdamUpdate(), smoothed gradients of twice the size of w
+};
+
+struct FusedUpdate
+{
+    FusedUpdateType type = FusedUpdateType::SGD;
+    double learnRatePerSample = 0;
+    double momentum = 0;
+    bool unitGainMomentum = true;
+    double varMomentum = 0;          // FSAdaGrad and Adam
+    double smoothedCount = 0;        // FSAdaGrad and Adam: the smoothed count after this update
+    double targetAdagradAvDenom = 1; // FSAdaGrad
+
+    double gradientScale = 1;
+    double clippingThreshold = std::numeric_limits<double>::infinity();
+    bool clippingWithTruncation = true;
+    double l2RegularizationWeight = 0;
+};
+
 // -----------------------------------------------------------------------
 // BaseMatrixStorage -- base class for all matrix types (CPU, GPU) x (dense, sparse)
 // -----------------------------------------------------------------------
@@ -6,6 +6,10 @@
 #include "stdafx.h"
 #include "ConvolutionEngine.h"
 #include "CuDnnFactories.h"
+#include "CPUConvolutionKernels.h"
+#include <chrono>
+#include <map>
+#include <mutex>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -851,6 +855,406 @@ public:
     }
 };
 
+//------------------------------------------------------------------
+// Winograd convolution engine implementation.
+// A CPU engine for 2D convolutions with full sharing that avoids unrolling the input where possible:
+// * 3x3 kernels with stride 1 use Winograd minimal filtering F(2x2, 3x3) or F(4x4, 3x3)
+//   (Fast Algorithms for Convolutional Neural Networks; Lavin, Gray), which needs 2.25x-4x fewer
+//   multiplications and keeps only the transformed tiles (about 2-4x the input) in the workspace.
+// * 1x1 kernels are a plain GEMM per sample on the input itself.
+// * Channel-wise convolutions (kernel depth 1) use a direct, cache-blocked loop.
+// For the forward and backward data passes the applicable algorithms, including GEMM, are timed on the
+// first minibatch of each size and the fastest one is used from then on. The result is shared by all
+// engines with the same geometry. With forceDeterministicAlgorithms the choice does not depend on timing:
+// the fast algorithm for the geometry is always used. Backward kernel uses the GEMM (or, for [W x H x C]
+// channel-wise convos, the reference) engine.
+//------------------------------------------------------------------
+template <class ElemType>
+class WinogradConvolutionEngine : public GemmConvolutionEngine<ElemType>
+{
+public:
+    using Base = GemmConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    WinogradConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind,
+                              bool forceDeterministicAlgorithms, bool poolIncludePad)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad),
+        m_kind(GetConv2DShape(*geometry, m_shape)), m_forceDeterministicAlgorithms(forceDeterministicAlgorithms),
+        m_fwdAlgo(Algo::Gemm), m_fwdAlgoBatchSize(0), m_backDataAlgo(Algo::Gemm), m_backDataAlgoBatchSize(0)
+    {
+    }
+
+protected:
+    using Base::IsGpu;
+
+    using Base::m_geometry;
+    using Base::m_deviceId;
+    using Base::m_imageLayout;
+    using Base::m_maxTempMemSizeInSamples;
+
+    enum class Algo
+    {
+        Gemm,
+        Winograd2x2,
+        Winograd4x4,
+        Direct1x1,
+        Channelwise
+    };
+
+    static const char* AlgoName(Algo algo)
+    {
+        switch (algo)
+        {
+        case Algo::Gemm:        return "GEMM";
+        case Algo::Winograd2x2: return "Winograd F(2x2, 3x3)";
+        case Algo::Winograd4x4: return "Winograd F(4x4, 3x3)";
+        case Algo::Direct1x1:   return "direct 1x1";
+        case Algo::Channelwise: return "channel-wise";
+        }
+        return "unknown";
+    }
+
+    // Which of the fast algorithms a geometry qualifies for.
+    enum class Conv2DKind
+    {
+        None,
+        Kernel3x3,   // 3x3 kernel spanning all input channels, stride 1
+        Kernel1x1,   // 1x1 kernel spanning all input channels
+        Channelwise  // kernel depth 1, applied to every input channel
+    };
+
+    void EnsureCompatible() override
+    {
+        if (m_imageLayout != ImageLayoutKind::CHW)
+            LogicError("Winograd convolution engine supports only CHW/cudnn layout.");
+        if (IsGpu(m_deviceId))
+            LogicError("Winograd convolution engine supports only CPU device.");
+    }
+
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
+    {
+        Algo algo = SelectAlgo(/*backwardData=*/false, in.GetNumCols(), [&](Algo candidate)
+        {
+            RunForward(candidate, in, kernel, out, workspace);
+        });
+        RunForward(algo, in, kernel, out, workspace);
+    }
+
+    void BackwardDataCore(const Mat& srcGrad, const Mat& kernel, Mat& grad, bool accumulateGradient, Mat& workspace) override
+    {
+        // All algorithms add to grad, so they are timed on a scratch matrix.
+        std::unique_ptr<Mat> scratch;
+        Algo algo = SelectAlgo(/*backwardData=*/true, srcGrad.GetNumCols(), [&](Algo candidate)
+        {
+            if (!scratch)
+            {
+                scratch = std::make_unique<Mat>(grad.GetNumRows(), grad.GetNumCols(), m_deviceId);
+                scratch->SetValue(0);
+            }
+            RunBackwardData(candidate, srcGrad, kernel, *scratch, accumulateGradient, workspace);
+        });
+        RunBackwardData(algo, srcGrad, kernel, grad, accumulateGradient, workspace);
+    }
+
+    void BackwardKernelCore(const Mat& srcGrad, const Mat& in, Mat& kernelGrad, bool accumulateGradient, bool allowReuse, Mat& workspace) override
+    {
+        // The GEMM engine requires the kernel to span the last input dimension, which is not the case for [W x H x C] channel-wise convolutions.
+        size_t dimCount = m_geometry->InputShape().GetRank();
+        if (m_geometry->KernelShape()[dimCount - 1] != m_geometry->InputShape()[dimCount - 1])
+            ReferenceConvolutionEngine<ElemType>::BackwardKernelCore(srcGrad, in, kernelGrad, accumulateGradient, allowReuse, workspace);
+        else
+            Base::BackwardKernelCore(srcGrad, in, kernelGrad, accumulateGradient, allowReuse, workspace);
+    }
+
+    // The applicable algorithms, the preferred one first.
+    std::vector<Algo> GetCandidates(bool backwardData) const
+    {
+        std::vector<Algo> candidates;
+        switch (m_kind)
+        {
+        case Conv2DKind::Kernel3x3:
+            candidates = { Algo::Winograd4x4, Algo::Winograd2x2, Algo::Gemm };
+            break;
+        case Conv2DKind::Kernel1x1:
+            candidates = { Algo::Direct1x1, Algo::Gemm };
+            break;
+        case Conv2DKind::Channelwise:
+            // The GEMM engine cannot backpropagate to the input if the kernel does not span all channels.
+            candidates = { Algo::Channelwise };
+            if (!backwardData)
+                candidates.push_back(Algo::Gemm);
+            break;
+        default:
+            candidates = { Algo::Gemm };
+        }
+        return candidates;
+    }
+
+    // Returns the algorithm to use for the given pass and minibatch size, timing the candidates with run() if that has not been done yet.
+    // Timing is not reproducible, so with forceDeterministicAlgorithms the preferred candidate is used without it.
+    template <class RunFn>
+    Algo SelectAlgo(bool backwardData, size_t batchSize, const RunFn& run)
+    {
+        Algo& selected = backwardData ? m_backDataAlgo : m_fwdAlgo;
+        size_t& selectedBatchSize = backwardData ? m_backDataAlgoBatchSize : m_fwdAlgoBatchSize;
+        if (selectedBatchSize == batchSize)
+            return selected;
+
+        auto candidates = GetCandidates(backwardData);
+        if (candidates.size() == 1 || m_forceDeterministicAlgorithms)
+            selected = candidates[0];
+        else
+        {
+            auto key = (std::string)*m_geometry + (backwardData ? ", backward data" : ", forward") + ", batch " + std::to_string(batchSize);
+            std::lock_guard<std::mutex> lock(AlgoCacheMutex());
+            auto& cache = AlgoCache();
+            auto found = cache.find(key);
+            if (found != cache.end())
+                selected = found->second;
+            else
+            {
+                double bestTime = std::numeric_limits<double>::max();
+                for (auto candidate : candidates)
+                {
+                    run(candidate); // warm up, e.g. allocate the workspace
+                    auto start = std::chrono::high_resolution_clock::now();
+                    run(candidate);
+                    double time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+                    if (time < bestTime)
+                    {
+                        bestTime = time;
+                        selected = candidate;
+                    }
+                }
+                cache[key] = selected;
+
+                if (GetMathLibTraceLevel() > 0)
+                    fprintf(stderr, "Winograd convolution engine: using %s algorithm for %s.\n", AlgoName(selected), key.c_str());
+            }
+        }
+        selectedBatchSize = batchSize;
+        return selected;
+    }
+
+    void RunForward(Algo algo, const Mat& in, const Mat& kernel, Mat& out, Mat& workspace)
+    {
+        switch (algo)
+        {
+        case Algo::Winograd2x2:
+            return WinogradConvolve<2>(m_shape, in, kernel, /*transposeAndFlip=*/false, /*accumulate=*/false, out, workspace);
+        case Algo::Winograd4x4:
+            return WinogradConvolve<4>(m_shape, in, kernel, /*transposeAndFlip=*/false, /*accumulate=*/false, out, workspace);
+        case Algo::Direct1x1:
+            return Forward1x1(in, kernel, out, workspace);
+        case Algo::Channelwise:
+            return ChannelwiseConvolutionForward(m_shape, in.Data(), kernel.Data(), in.GetNumCols(), out.Data());
+        default:
+            return Base::ForwardCore(in, kernel, out, workspace);
+        }
+    }
+
+    void RunBackwardData(Algo algo, const Mat& srcGrad, const Mat& kernel, Mat& grad, bool accumulateGradient, Mat& workspace)
+    {
+        switch (algo)
+        {
+        case Algo::Winograd2x2:
+            return WinogradConvolve<2>(ReverseShape(m_shape), srcGrad, kernel, /*transposeAndFlip=*/true, /*accumulate=*/true, grad, workspace);
+        case Algo::Winograd4x4:
+            return WinogradConvolve<4>(ReverseShape(m_shape), srcGrad, kernel, /*transposeAndFlip=*/true, /*accumulate=*/true, grad, workspace);
+        case Algo::Direct1x1:
+            return BackwardData1x1(srcGrad, kernel, grad, workspace);
+        case Algo::Channelwise:
+            return ChannelwiseConvolutionBackwardData(m_shape, srcGrad.Data(), kernel.Data(), srcGrad.GetNumCols(), grad.Data());
+        default:
+            return Base::BackwardDataCore(srcGrad, kernel, grad, accumulateGradient, workspace);
+        }
+    }
+
+    // Backpropagation to the input of a 3x3 convolution with stride 1 is a 3x3 convolution of the gradients
+    // with the transposed and flipped kernel, padded such that every output pixel reaches all input pixels it contributed to.
+    static Conv2DShape ReverseShape(const Conv2DShape& s)
+    {
+        Conv2DShape r = s;
+        r.inW = s.outW; r.inH = s.outH; r.inC = s.outC;
+        r.outW = s.inW; r.outH = s.inH; r.outC = s.inC;
+        r.padW = (int)s.kernelW - 1 - s.padW;
+        r.padH = (int)s.kernelH - 1 - s.padH;
+        return r;
+    }
+
+    // The sub-batches are sized such that the transformed tiles of m_maxTempMemSizeInSamples samples fit into the workspace.
+    // Workspace: U, the transformed kernels [C x K], followed by V [P x C] and M [P x K], all (m + 2)^2 times.
+    template <int m>
+    void WinogradConvolve(const Conv2DShape& s, const Mat& in, const Mat& kernel, bool transposeAndFlip, bool accumulate, Mat& out, Mat& workspace)
+    {
+        const size_t alpha2 = WinogradTiles<m>::Alpha * WinogradTiles<m>::Alpha;
+        size_t batchSize = in.GetNumCols();
+        size_t subBatchSize = m_maxTempMemSizeInSamples == 0 ? batchSize : min(batchSize, m_maxTempMemSizeInSamples);
+        size_t tilesPerSample = WinogradTiles<m>::TilesPerSample(s);
+        size_t sizeU = alpha2 * s.inC * s.outC;
+        size_t sizeV = alpha2 * s.inC * tilesPerSample * subBatchSize;
+        size_t sizeM = alpha2 * s.outC * tilesPerSample * subBatchSize;
+        workspace.Resize(1, sizeU + sizeV + sizeM);
+
+        WinogradTransformKernel<ElemType, m>(s, kernel.Data(), transposeAndFlip, workspace.Data());
+
+        size_t inSampleSize = s.inW * s.inH * s.inC;
+        size_t outSampleSize = s.outW * s.outH * s.outC;
+        for (size_t start = 0; start < batchSize; start += subBatchSize)
+        {
+            size_t curBatchSize = min(subBatchSize, batchSize - start);
+            size_t numTiles = tilesPerSample * curBatchSize;
+
+            WinogradTransformInput<ElemType, m>(s, in.Data() + start * inSampleSize, curBatchSize, workspace.Data() + sizeU);
+            for (size_t i = 0; i < alpha2; i++)
+            {
+                auto u = workspace.ColumnSlice(i * s.inC * s.outC, s.inC * s.outC);
+                u.Reshape(s.inC, s.outC);
+                auto v = workspace.ColumnSlice(sizeU + i * s.inC * numTiles, s.inC * numTiles);
+                v.Reshape(numTiles, s.inC);
+                auto mm = workspace.ColumnSlice(sizeU + sizeV + i * s.outC * numTiles, s.outC * numTiles);
+                mm.Reshape(numTiles, s.outC);
+                Mat::Multiply(v, false, u, false, mm);
+            }
+            WinogradTransformOutput<ElemType, m>(s, workspace.Data() + sizeU + sizeV, curBatchSize, accumulate, out.Data() + start * outSampleSize);
+        }
+    }
+
+    // Input pixels only need to be gathered into the workspace if the convolution is strided or padded.
+    bool Is1x1Identity() const
+    {
+        return m_shape.inW == m_shape.outW && m_shape.inH == m_shape.outH && m_shape.padW == 0 && m_shape.padH == 0;
+    }
+
+    // [W'H' x C] * [C x K] -> [W'H' x K] for every sample.
+    void Forward1x1(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace)
+    {
+        size_t batchSize = in.GetNumCols();
+        size_t mapOutSize = m_shape.outW * m_shape.outH;
+        auto kern = kernel.ColumnSlice(0, kernel.GetNumCols());
+        kern.Reshape(m_shape.inC, m_shape.outC);
+
+        bool gather = !Is1x1Identity();
+        size_t subBatchSize = m_maxTempMemSizeInSamples == 0 ? batchSize : min(batchSize, m_maxTempMemSizeInSamples);
+        if (gather)
+            workspace.Resize(mapOutSize * m_shape.inC, subBatchSize);
+
+        for (size_t start = 0; start < batchSize; start += subBatchSize)
+        {
+            size_t curBatchSize = min(subBatchSize, batchSize - start);
+            if (gather)
+                GatherConvolution1x1Input(m_shape, in.ColumnSlice(start, curBatchSize).Data(), curBatchSize, workspace.Data());
+            for (size_t n = 0; n < curBatchSize; n++)
+            {
+                auto inSlice = gather ? workspace.ColumnSlice(n, 1) : in.ColumnSlice(start + n, 1);
+                inSlice.Reshape(mapOutSize, m_shape.inC);
+                auto outSlice = out.ColumnSlice(start + n, 1);
+                outSlice.Reshape(mapOutSize, m_shape.outC);
+                Mat::Multiply(inSlice, false, kern, false, outSlice);
+            }
+        }
+    }
+
+    // [W'H' x K] * [C x K]^T -> [W'H' x C], added to the gradients of the input pixels read in the forward pass.
+    void BackwardData1x1(const Mat& srcGrad, const Mat& kernel, Mat& grad, Mat& workspace)
+    {
+        size_t batchSize = srcGrad.GetNumCols();
+        size_t mapOutSize = m_shape.outW * m_shape.outH;
+        auto kern = kernel.ColumnSlice(0, kernel.GetNumCols());
+        kern.Reshape(m_shape.inC, m_shape.outC);
+
+        bool gather = !Is1x1Identity();
+        size_t subBatchSize = m_maxTempMemSizeInSamples == 0 ? batchSize : min(batchSize, m_maxTempMemSizeInSamples);
+        if (gather)
+            workspace.Resize(mapOutSize * m_shape.inC, subBatchSize);
+
+        for (size_t start = 0; start < batchSize; start += subBatchSize)
+        {
+            size_t curBatchSize = min(subBatchSize, batchSize - start);
+            for (size_t n = 0; n < curBatchSize; n++)
+            {
+                auto srcGradSlice = srcGrad.ColumnSlice(start + n, 1);
+                srcGradSlice.Reshape(mapOutSize, m_shape.outC);
+                auto gradSlice = gather ? workspace.ColumnSlice(n, 1) : grad.ColumnSlice(start + n, 1);
+                gradSlice.Reshape(mapOutSize, m_shape.inC);
+                if (gather)
+                    Mat::Multiply(srcGradSlice, false, kern, true, gradSlice);
+                else
+                    Mat::MultiplyAndAdd(srcGradSlice, false, kern, true, gradSlice);
+            }
+            if (gather)
+                ScatterAddConvolution1x1Input(m_shape, workspace.Data(), curBatchSize, grad.ColumnSlice(start, curBatchSize).Data());
+        }
+    }
+
+    static std::mutex& AlgoCacheMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::map<std::string, Algo>& AlgoCache()
+    {
+        static std::map<std::string, Algo> cache;
+        return cache;
+    }
+
+public:
+    // Describes the geometry as a 2D convolution if it is one that a fast algorithm applies to.
+    // Channel-wise convolutions may also be written as [W x H x C x 1] tensors with the maps in the last dimension.
+    static Conv2DKind GetConv2DShape(const ConvolveGeometry& g, Conv2DShape& s)
+    {
+        const auto& inT = g.InputShape();
+        const auto& kernT = g.KernelShape();
+        const auto& outT = g.OutputShape();
+        size_t dimCount = inT.GetRank();
+        if (dimCount != 3 && (dimCount != 4 || inT[3] != 1 || kernT[3] != 1 || g.GetLowerPad(3) != 0))
+            return Conv2DKind::None;
+        for (size_t i = 0; i < dimCount - 1; i++)
+        {
+            if (g.GetMapCount(i) != 1)
+                return Conv2DKind::None;
+        }
+        if (g.GetLowerPad(2) != 0)
+            return Conv2DKind::None;
+
+        s.inW = inT[0]; s.inH = inT[1]; s.inC = inT[2];
+        s.outW = outT[0]; s.outH = outT[1]; s.outC = outT.GetNumElements() / (s.outW * s.outH);
+        s.kernelW = kernT[0]; s.kernelH = kernT[1];
+        s.strideW = g.GetStride(0); s.strideH = g.GetStride(1);
+        s.padW = g.GetLowerPad(0); s.padH = g.GetLowerPad(1);
+
+        size_t mapCount = g.GetMapCount(dimCount - 1);
+        if (dimCount == 3 && kernT[2] == s.inC && s.outC == mapCount)
+        {
+            if (s.kernelW == 3 && s.kernelH == 3 && s.strideW == 1 && s.strideH == 1)
+                return Conv2DKind::Kernel3x3;
+            if (s.kernelW == 1 && s.kernelH == 1)
+                return Conv2DKind::Kernel1x1;
+        }
+        if (kernT[2] == 1 && g.GetStride(2) == 1 && s.outC == s.inC * mapCount)
+            return Conv2DKind::Channelwise;
+        return Conv2DKind::None;
+    }
+
+    static bool IsSupported(DEVICEID_TYPE deviceId, ConvolveGeometryPtr geometry, PoolKind poolKind)
+    {
+        Conv2DShape shape;
+        return poolKind == PoolKind::None && Base::IsSupported(deviceId, geometry) &&
+               GetConv2DShape(*geometry, shape) != Conv2DKind::None;
+    }
+
+private:
+    Conv2DShape m_shape;
+    Conv2DKind m_kind;
+    bool m_forceDeterministicAlgorithms;
+    Algo m_fwdAlgo;
+    size_t m_fwdAlgoBatchSize;      // minibatch size m_fwdAlgo was selected for, 0 if none
+    Algo m_backDataAlgo;
+    size_t m_backDataAlgoBatchSize; // minibatch size m_backDataAlgo was selected for, 0 if none
+};
+
 template <class ElemType>
 std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId,
                                                                                  ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind,
@@ -886,6 +1290,14 @@ std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create
         return CuDnnConvolutionEngineFactory<ElemType>::Create(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, forceDeterministicAlgorithms, poolIncludePad);
     }
 
+    if (isEnabled(ConvolutionEngineKind::Winograd) && WinogradConvolutionEngine<ElemType>::IsSupported(deviceId, geometry, poolKind))
+    {
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "%lsusing Winograd convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+        return std::make_unique<WinogradConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, forceDeterministicAlgorithms, poolIncludePad);
+    }
+
     if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
     {
         if (GetMathLibTraceLevel() > 0)
@@ -22,6 +22,8 @@ enum class ConvolutionEngineKind
     CuDnn     = 1 << 1, // cuDNN, works only for 2D/3D convos with full sharing.
     Legacy    = 1 << 2, // Legacy, for backwards compatibility. REVIEW alexeyk: implement sparse version and remove Legacy altogether.
     Gemm      = 1 << 3, // Uses convolution unrolling+GEMM technique. Works only for convos with full sharing.
+    Winograd  = 1 << 4, // CPU only. Winograd for 3x3 and direct convolution for 1x1 and channel-wise 2D convos, auto-selected against GEMM.
+                        // Opt-in: not part of All, as it may round differently from the other engines.
 
     All       = Reference | CuDnn | Legacy | Gemm
 };
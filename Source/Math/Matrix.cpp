@@ -1727,7 +1727,7 @@ void Matrix<ElemType>::FSAdagradUpdate(size_t mbSize,
                                    targetAdagradAvDenom_x_sqrtAdagradSqrFrames, unitGainMomentum); 
             SetDataLocation(GPU); 
         },
-        { NOT_IMPLEMENTED; },
+        { gradients.m_CPUSparseMatrix->FSAdagrad(*m_CPUMatrix, *functionValues.m_CPUMatrix, (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum, targetAdagradAvDenom_x_sqrtAdagradSqrFrames, unitGainMomentum); SetDataLocation(CPU); },
         { gradients.m_GPUSparseMatrix->FSAdagrad(*m_GPUMatrix, *functionValues.m_GPUMatrix, (ElemType)learnRatePerSample, (ElemType)meanMomentum, (ElemType)varMomentum, targetAdagradAvDenom_x_sqrtAdagradSqrFrames, unitGainMomentum); SetDataLocation(GPU); });
 
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
@@ -1758,7 +1758,10 @@ void Matrix<ElemType>::AdamUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>&
         biasCorrection, unitGainMomentum);
         SetDataLocation(GPU);
     },
-    { NOT_IMPLEMENTED; },
+    { gradients.m_CPUSparseMatrix->Adam(*m_CPUMatrix, *functionValues.m_CPUMatrix,
+        (ElemType)learnRatePerSample, (ElemType)meanMomentum,
+        (ElemType)varMomentum, biasCorrection, unitGainMomentum);
+        SetDataLocation(CPU); },
     { gradients.m_GPUSparseMatrix->Adam(*m_GPUMatrix, *functionValues.m_GPUMatrix, 
         (ElemType)learnRatePerSample, (ElemType)meanMomentum, 
         (ElemType)varMomentum, biasCorrection, unitGainMomentum); 
@@ -1767,6 +1770,36 @@ void Matrix<ElemType>::AdamUpdate(Matrix<ElemType>& gradients, Matrix<ElemType>&
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
 }
 
+// Fused update of several parameters, see FusedUpdate.
+// This is the same as the preprocessing of the gradients (Scale(), InplaceTruncate() or clipping to the FrobeniusNorm(), and
+// ScaleAndAdd() for L2 regularization) followed by SGDUpdate(), MomentumSGDUpdate() etc. for each parameter, except that
+// the gradients are not modified. It is done in one parallel pass over all parameters, so that models with many small
+// parameters do not pay for a sequence of small operations per parameter. Only implemented for dense matrices on the CPU.
+template <class ElemType>
+/*static*/ void Matrix<ElemType>::FusedParameterUpdate(const FusedUpdate& update, const std::vector<Matrix<ElemType>*>& values,
+                                                       const std::vector<Matrix<ElemType>*>& gradients, const std::vector<Matrix<ElemType>*>& smoothedGradients)
+{
+    ElemType adaMul = 1;
+    if (update.type == FusedUpdateType::FSAdaGrad)
+        adaMul = (ElemType)(update.targetAdagradAvDenom * sqrt(update.smoothedCount));
+    else if (update.type == FusedUpdateType::Adam)
+        adaMul = (ElemType)(sqrt(1 - pow(update.varMomentum, update.smoothedCount)) / (1 - pow(update.momentum, update.smoothedCount)));
+
+    auto getCPUMatrices = [](const std::vector<Matrix<ElemType>*>& matrices)
+    {
+        std::vector<CPUMatrix<ElemType>*> cpuMatrices;
+        for (auto matrix : matrices)
+        {
+            if (matrix->GetDeviceId() != CPUDEVICE || matrix->GetMatrixType() != MatrixType::DENSE)
+                NOT_IMPLEMENTED;
+            cpuMatrices.push_back(matrix->m_CPUMatrix.get());
+        }
+        return cpuMatrices;
+    };
+
+    CPUMatrix<ElemType>::FusedParameterUpdate(update, adaMul, getCPUMatrices(values), getCPUMatrices(gradients), getCPUMatrices(smoothedGradients));
+}
+
 template <class ElemType>
 ElemType Matrix<ElemType>::RmsProp(Matrix<ElemType>& gradients,
                                    ElemType RMS_GAMMA,
@@ -1781,7 +1814,7 @@ ElemType Matrix<ElemType>::RmsProp(Matrix<ElemType>& gradients,
     DISPATCH_MATRIX_ON_FLAG(&gradients, &gradients,
         { return m_CPUMatrix->RmsProp(*gradients.m_CPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier); SetDataLocation(CPU); },
         { return m_GPUMatrix->RmsProp(*gradients.m_GPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier); SetDataLocation(GPU); },
-        { NOT_IMPLEMENTED; },
+        { return gradients.m_CPUSparseMatrix->RmsProp(*m_CPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier); SetDataLocation(CPU); },
         { return gradients.m_GPUSparseMatrix->RmsProp(*m_GPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier); SetDataLocation(GPU); });
     // Note: Since both 'this' and gradients are changed, we must call SetDataLocation() on 'this' as well.
 }
@@ -4652,7 +4685,7 @@ void Matrix<ElemType>::RNNForward(const Matrix<ElemType> &inputX, const Matrix<E
 
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            NOT_IMPLEMENTED,
+                            m_CPUMatrix->RNNForward(*(inputX.m_CPUMatrix), *(paramW.m_CPUMatrix), xDim, yDim, numSequencesForFrame, rnnAttributes, *(reserve.m_CPUMatrix), *(workspace.m_CPUMatrix)),
                             m_GPUMatrix->RNNForward(*(inputX.m_GPUMatrix), *(paramW.m_GPUMatrix), xDim, yDim, numSequencesForFrame, rnnAttributes, *(reserve.m_GPUMatrix), *(workspace.m_GPUMatrix)),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
@@ -4667,7 +4700,7 @@ void Matrix<ElemType>::RNNBackwardData(const Matrix<ElemType>& outputDY, const M
     workspace._transferToDevice(GetDeviceId());
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            NOT_IMPLEMENTED,
+                            m_CPUMatrix->RNNBackwardData(*(outputDY.m_CPUMatrix), *(paramW.m_CPUMatrix), *(outputDX.m_CPUMatrix), rnnAttributes, *(reserve.m_CPUMatrix), *(workspace.m_CPUMatrix)),
                             m_GPUMatrix->RNNBackwardData(*(outputDY.m_GPUMatrix), *(paramW.m_GPUMatrix), *(outputDX.m_GPUMatrix), rnnAttributes, *(reserve.m_GPUMatrix), *(workspace.m_GPUMatrix)),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
@@ -4682,7 +4715,7 @@ void Matrix<ElemType>::RNNBackwardWeights(const Matrix<ElemType>& inputX, const
     workspace._transferToDevice(GetDeviceId());
     DISPATCH_MATRIX_ON_FLAG(this,
                             this,
-                            NOT_IMPLEMENTED,
+                            m_CPUMatrix->RNNBackwardWeights(*(inputX.m_CPUMatrix), *(outputY.m_CPUMatrix), *(dw.m_CPUMatrix), rnnAttributes, *(reserve.m_CPUMatrix), *(workspace.m_CPUMatrix)),
                             m_GPUMatrix->RNNBackwardWeights(*(inputX.m_GPUMatrix), *(outputY.m_GPUMatrix), *(dw.m_GPUMatrix), rnnAttributes, *(reserve.m_GPUMatrix), *(workspace.m_GPUMatrix)),
                             NOT_IMPLEMENTED,
                             NOT_IMPLEMENTED);
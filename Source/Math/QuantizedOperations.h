@@ -4,6 +4,12 @@
 //
 #pragma once
 #include "Quantizers.h"
+#include "BlockMultiplierDispatch.h"
+#include <algorithm>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -11,6 +17,13 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 // Quantized product of two dense matrices A and B, where each matrix has its own quantizer.
 // This class handles quantization of both matrices, product and de-quantization of the result.
 // Other implementations should inherit from this class or extract common methods to the base class and inherit from the base.
+//
+// The integer product is computed by the fastest BlockMultiplier the processor supports (see BlockMultiplierDispatch.h),
+// with a plain loop as the fallback. BlockMultiplier works on row-major matrices, so the column-major product C = A * B
+// is computed as C' = B' * A', with A' in the role of the block-ordered ("prepared") matrix. A is typically the weight
+// matrix: if it is constant, it is quantized and rewritten in block order only once.
+// For multithreading, the rows of A are split into panels with a multiplier each, which are multiplied in parallel,
+// so that even a single column of B (batch size 1) keeps all threads busy.
 template <class ElemType>
 class QuantizedMultiplier
 {
@@ -29,9 +42,26 @@ class QuantizedMultiplier
 
     bool m_firstPass;
 
-public: 
+    // Rows [firstRow, firstRow + numRows) of the quantized A, rewritten in block order.
+    // Each panel needs its own multiplier, since BlockMultiplier keeps data of the prepared matrix.
+    struct Panel
+    {
+        int firstRow;
+        int numRows;
+        std::unique_ptr<IBlockMultiplier<short>> multiplier;
+        short* preparedA;
+    };
+    vector<Panel> m_panels;
+    vector<int32_t> m_product;
+    bool m_useBlockMultiplier;
+
+    // Minimum number of rows of A per panel for the parallel split to pay off.
+    static const int s_minRowsPerPanel = 32;
+
+public:
     QuantizedMultiplier(shared_ptr<QuantizerBase<ElemType, short>> pQuantizerA, bool isAConstant, shared_ptr<QuantizerBase<ElemType, short>> pQuantizerB, bool isBConstant) :
-        m_pQuantizerA(pQuantizerA), m_pQuantizerB(pQuantizerB), m_isAConstant(isAConstant), m_isBConstant(isBConstant), m_firstPass(true)
+        m_pQuantizerA(pQuantizerA), m_pQuantizerB(pQuantizerB), m_isAConstant(isAConstant), m_isBConstant(isBConstant), m_firstPass(true),
+        m_useBlockMultiplier(IsBlockHandlerSupported<short>(BlockHandlerType::Best))
     {
         if (isAConstant && isBConstant)
             LogicError("Quantized multiplication is applied to two constant matrices -- it is highly inefficient. Better approach is to replace the operation with the resulting matrix.");
@@ -41,18 +71,24 @@ public:
     {
     };
 
+    ~QuantizedMultiplier()
+    {
+        FreePanels();
+    }
+
     // A[m,k]*B[k,n] = C[m,n]
     void Multiply(int m, int n, int k, ElemType* A, ElemType* B, ElemType* C)
     {
         // Quantize
-        if (!m_isAConstant || m_firstPass)
+        bool isANew = !m_isAConstant || m_firstPass || m_pMatA.size() != (size_t)m * k;
+        if (isANew)
         {
             m_pMatA.resize(m*k);
             ArrayRef<short> refMatA(m_pMatA.data(), m_pMatA.size());
             m_pQuantizerA->Quantize(ArrayRef<ElemType>(A, m_pMatA.size()), refMatA);
         }
-        
-        if (!m_isBConstant || m_firstPass)
+
+        if (!m_isBConstant || m_firstPass || m_pMatB.size() != (size_t)n * k)
         {
             m_pMatB.resize(n*k);
             ArrayRef<short> refMatB(m_pMatB.data(), m_pMatB.size());
@@ -62,19 +98,25 @@ public:
         m_firstPass = false;
 
         // Do multiply
-        // Naive inefficient product, just for demonstation
-        // TODO: replace with an efficient version, e.g. IPG, block multiplier, Eigen, gemmlowp, etc.
-        for (size_t i = 0; i < m; i++)
-            for (size_t j = 0; j < n; j++)
-            {
-                int dotProduct=0;
-                for (size_t l = 0; l < k; l++)
+        if (m_useBlockMultiplier)
+        {
+            if (isANew)
+                PreparePanels(m, k);
+            MultiplyPanels(m, n, k, C);
+        }
+        else
+        {
+            // CNTK is using column-major storage
+#pragma omp parallel for
+            for (int j = 0; j < n; j++)
+                for (int i = 0; i < m; i++)
                 {
-                    // CNTK is using column-major storage
-                    dotProduct += m_pMatA[i + l*m] * m_pMatB[l + k*j];
+                    int dotProduct = 0;
+                    for (int l = 0; l < k; l++)
+                        dotProduct += m_pMatA[i + (size_t)l * m] * m_pMatB[l + (size_t)k * j];
+                    C[i + (size_t)j * m] = (ElemType)dotProduct;
                 }
-                C[i + j*m] = (ElemType)dotProduct;
-            }
+        }
 
         // De-quantize
         int mn = m*n;
@@ -84,6 +126,90 @@ public:
 
     void SetIsAConstant(bool v) { m_isAConstant = v; }
     void SetIsBConstant(bool v) { m_isBConstant = v; }
+
+    // The constant matrices are quantized again on the next call (e.g. after the weights have been updated).
+    void InvalidateConstants() { m_firstPass = true; }
+
+    // Switches between the block multiplier and the plain loop (e.g. to compare them). A is quantized again on the next call.
+    void SetUseBlockMultiplier(bool v)
+    {
+        m_useBlockMultiplier = v && IsBlockHandlerSupported<short>(BlockHandlerType::Best);
+        m_firstPass = true;
+    }
+    bool UsesBlockMultiplier() const { return m_useBlockMultiplier; }
+
+private:
+    static int GetNumThreads()
+    {
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+    void FreePanels()
+    {
+        for (auto& panel : m_panels)
+            panel.multiplier->FreePreparedB(panel.preparedA);
+        m_panels.clear();
+    }
+
+    // Splits the quantized A into panels of rows and rewrites each of them in block order.
+    void PreparePanels(int m, int k)
+    {
+        FreePanels();
+
+        int numThreads = GetNumThreads();
+        int numPanels = std::max(1, std::min(numThreads, m / s_minRowsPerPanel));
+        // With a single panel, the multiplier parallelizes over the columns of B instead.
+        int threadsPerPanel = numPanels == 1 ? numThreads : 1;
+
+        // A' is the (k x m) row-major matrix with the memory layout of A, a panel is a range of its columns.
+        vector<short> panelA;
+        for (int p = 0; p < numPanels; p++)
+        {
+            Panel panel;
+            panel.firstRow = (int)((int64_t)m * p / numPanels);
+            panel.numRows = (int)((int64_t)m * (p + 1) / numPanels) - panel.firstRow;
+            panel.multiplier = CreateBlockMultiplier<short>(BlockHandlerType::Best, threadsPerPanel);
+
+            short* transposedA = m_pMatA.data();
+            if (numPanels > 1)
+            {
+                panelA.resize((size_t)k * panel.numRows);
+                for (int l = 0; l < k; l++)
+                    std::copy_n(m_pMatA.data() + (size_t)l * m + panel.firstRow, panel.numRows, panelA.data() + (size_t)l * panel.numRows);
+                transposedA = panelA.data();
+            }
+            panel.preparedA = panel.multiplier->PrepareB(transposedA, k, panel.numRows);
+            m_panels.push_back(std::move(panel));
+        }
+    }
+
+    // Multiplies the quantized matrices and stores the (not yet de-quantized) product in C.
+    void MultiplyPanels(int m, int n, int k, ElemType* C)
+    {
+        // The product of a panel is C' restricted to the rows of the panel, an (n x numRows) row-major matrix.
+        m_product.assign((size_t)m * n, 0);
+        int numPanels = (int)m_panels.size();
+
+#pragma omp parallel for if (numPanels > 1)
+        for (int p = 0; p < numPanels; p++)
+        {
+            auto& panel = m_panels[p];
+            int32_t* product = m_product.data() + (size_t)n * panel.firstRow;
+            panel.multiplier->MultiplyMatrices(m_pMatB.data(), n, k, panel.preparedA, panel.numRows, product);
+
+            for (int j = 0; j < n; j++)
+            {
+                const int32_t* source = product + (size_t)j * panel.numRows;
+                ElemType* target = C + (size_t)j * m + panel.firstRow;
+                for (int i = 0; i < panel.numRows; i++)
+                    target[i] = (ElemType)source[i];
+            }
+        }
+    }
 };
 
-}}}
\ No newline at end of file
+}}}
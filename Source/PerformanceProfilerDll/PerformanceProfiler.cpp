@@ -17,9 +17,11 @@
 #include "fileutil.h"
 #include "TimerUtility.h"
 #include <algorithm>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <stdio.h>
+#include <vector>
 #ifndef CPUONLY
 #include <cuda_runtime_api.h>
 #endif
@@ -91,6 +93,34 @@ struct CustomEventRecord
     unsigned int    threadId;
 };
 
+//
+// Aggregated time of a computation node, separately for forward [0] and backward [1] computation.
+// flops and bytes are the sums of the estimates passed to ProfilerNodeTimeEnd().
+//
+struct NodeEventRecord
+{
+    std::wstring    operationName;
+    int             cnt[2];       // event count
+    long long       sum[2];       // time (ticks)
+    double          flops[2];     // floating-point operations
+    double          bytes[2];     // memory traffic
+
+    NodeEventRecord() : cnt(), sum(), flops(), bytes() {}
+
+    void Add(const NodeEventRecord& other)
+    {
+        for (int pass = 0; pass < 2; pass++)
+        {
+            cnt[pass] += other.cnt[pass];
+            sum[pass] += other.sum[pass];
+            flops[pass] += other.flops[pass];
+            bytes[pass] += other.bytes[pass];
+        }
+    }
+
+    long long TotalTicks() const { return sum[0] + sum[1]; }
+};
+
 
 //
 // Global state of the profiler
@@ -103,6 +133,7 @@ struct ProfilerState
     std::wstring            profilerDir;                 // Directory where reports/logs are saved
     std::wstring            logSuffix;                   // Suffix to append to report/log file names
     FixedEventRecord        fixedEvents[profilerEvtMax]; // Profiling data for each fixed event
+    std::map<std::wstring, NodeEventRecord> nodeEvents;  // Profiling data for each computation node
     bool                    customEventBufferFull;       // Is custom event buffer full?
     unsigned long long      customEventBufferBytes;      // Number of bytes allocated for the custom event buffer
     unsigned long long      customEventOffset;           // Offset to current place in buffer
@@ -124,6 +155,8 @@ void FormatTimeStr(char* str, size_t strLen, double value);
 void FormatThroughputStr(char* str, size_t strLen, double value);
 void FormatBytesStr(char* str, size_t strLen, long long bytes);
 void ProfilerGenerateDetailFile(const std::wstring& fileName);
+void ProfilerGenerateNodeReport(const std::wstring& fileName, struct tm* timeInfo);
+void ProfilerGenerateChromeTrace(const std::wstring& fileName);
 
 
 double TicksToSeconds(long long ticks)
@@ -278,6 +311,36 @@ void PERF_PROFILER_API ProfilerTimeEnd(const long long stateId, const char* even
 }
 
 
+void PERF_PROFILER_API ProfilerNodeTimeEnd(const long long stateId, const wchar_t* nodeName, const wchar_t* operationName,
+    const bool backward, const double flops, const double bytes)
+{
+    // A nullptr state indicates that the profiler is globally disabled, and not initialized
+    if (g_profilerState == nullptr)
+        return;
+
+    long long endClock = Clock::GetTimeStamp();
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+
+        if (!g_profilerState->enabled)
+            return;
+
+        auto& record = g_profilerState->nodeEvents[nodeName];
+        if (record.operationName.empty())
+            record.operationName = operationName;
+
+        int pass = backward ? 1 : 0;
+        record.cnt[pass]++;
+        record.sum[pass] += endClock - stateId;
+        record.flops[pass] += flops;
+        record.bytes[pass] += bytes;
+    }
+
+    std::string eventDescription = msra::strfun::utf8(nodeName) + (backward ? " [backward]" : " [forward]");
+    ProfilerTimeRecordToBuffer(eventDescription.c_str(), stateId, endClock);
+}
+
+
 //
 // Conditionally sync the GPU if the syncGPU flag is set. This only needs to be excplicitly
 // called for custom events.
@@ -366,6 +429,17 @@ void PERF_PROFILER_API ProfilerClose()
     fileName = g_profilerState->profilerDir + L"/" + std::wstring(timeStr) + L"_detail_" + g_profilerState->logSuffix + L".csv";
     ProfilerGenerateDetailFile(fileName);
 
+    // Generate per-node report, if nodes were profiled
+    if (!g_profilerState->nodeEvents.empty())
+    {
+        fileName = g_profilerState->profilerDir + L"/" + std::wstring(timeStr) + L"_nodes_" + g_profilerState->logSuffix + L".txt";
+        ProfilerGenerateNodeReport(fileName, timeInfo);
+    }
+
+    // Generate the timeline of the detailed events for chrome://tracing
+    fileName = g_profilerState->profilerDir + L"/" + std::wstring(timeStr) + L"_trace_" + g_profilerState->logSuffix + L".json";
+    ProfilerGenerateChromeTrace(fileName);
+
     g_profilerState.reset();
 }
 
@@ -555,6 +629,126 @@ void ProfilerGenerateDetailFile(const std::wstring& fileName)
 }
 
 
+//
+// Generate per-node report: one line per node and one line per operation type, sorted by total time.
+//
+void ProfilerWriteNodeReportLine(FILE* f, const NodeEventRecord& record, long long totalTicks, const std::wstring& description)
+{
+    char str[32];
+    for (int pass = 0; pass < 2; pass++)
+    {
+        FormatTimeStr(str, sizeof(str), TicksToSeconds(record.sum[pass]));
+        fprintfOrDie(f, "%s %10d ", str, record.cnt[pass]);
+    }
+
+    double seconds = TicksToSeconds(record.TotalTicks());
+    FormatTimeStr(str, sizeof(str), seconds);
+    fprintfOrDie(f, "%s ", str);
+
+    double share = totalTicks > 0 ? 100.0 * record.TotalTicks() / totalTicks : 0.0;
+    double gflops = seconds > 0.0 ? (record.flops[0] + record.flops[1]) / seconds / 1e9 : 0.0;
+    double gbps = seconds > 0.0 ? (record.bytes[0] + record.bytes[1]) / seconds / 1e9 : 0.0;
+    fprintfOrDie(f, "%6.2f %% %10.2f %10.2f  %ls\n", share, gflops, gbps, description.c_str());
+}
+
+void ProfilerGenerateNodeReport(const std::wstring& fileName, struct tm* timeInfo)
+{
+    FILE* f = _wfopen(fileName.c_str(), L"wt");
+    if (f == NULL)
+    {
+        RuntimeError("Error: ProfilerGenerateNodeReport: Cannot create file <%ls>.\n", fileName.c_str());
+    }
+
+    fprintfOrDie(f, "CNTK Performance Profiler Node Report\n\n");
+    char timeStr[32];
+    strftime(timeStr, sizeof(timeStr), "%Y/%m/%d %H:%M:%S", timeInfo);
+    fprintfOrDie(f, "Time Stamp: %s\n\n", timeStr);
+    fprintfOrDie(f, "GFLOP/s and GB/s are based on estimates of the floating-point operations and the memory traffic of each node.\n\n");
+
+    std::map<std::wstring, NodeEventRecord> operationEvents;
+    std::vector<std::pair<std::wstring, const NodeEventRecord*>> nodeEvents;
+    long long totalTicks = 0;
+    for (const auto& nodeEvent : g_profilerState->nodeEvents)
+    {
+        operationEvents[nodeEvent.second.operationName].Add(nodeEvent.second);
+        nodeEvents.push_back(std::make_pair(nodeEvent.first + L" (" + nodeEvent.second.operationName + L")", &nodeEvent.second));
+        totalTicks += nodeEvent.second.TotalTicks();
+    }
+
+    auto byTotalTime = [](const std::pair<std::wstring, const NodeEventRecord*>& a, const std::pair<std::wstring, const NodeEventRecord*>& b)
+    {
+        return a.second->TotalTicks() > b.second->TotalTicks();
+    };
+
+    const char* header = "....Forward Time .....Count ...Backward Time .....Count ......Total Time ...Share ...GFLOP/s ......GB/s  %s\n\n";
+
+    std::vector<std::pair<std::wstring, const NodeEventRecord*>> operations;
+    for (const auto& operationEvent : operationEvents)
+        operations.push_back(std::make_pair(operationEvent.first, &operationEvent.second));
+    std::sort(operations.begin(), operations.end(), byTotalTime);
+
+    fprintfOrDie(f, header, "Operation");
+    for (const auto& operation : operations)
+        ProfilerWriteNodeReportLine(f, *operation.second, totalTicks, operation.first);
+
+    std::sort(nodeEvents.begin(), nodeEvents.end(), byTotalTime);
+
+    fprintfOrDie(f, "\n\n");
+    fprintfOrDie(f, header, "Node (Operation)");
+    for (const auto& nodeEvent : nodeEvents)
+        ProfilerWriteNodeReportLine(f, *nodeEvent.second, totalTicks, nodeEvent.first);
+
+    fclose(f);
+}
+
+
+//
+// Generate the detailed events in the Chrome trace event format (complete events, timestamps in microseconds).
+//
+void ProfilerGenerateChromeTrace(const std::wstring& fileName)
+{
+    FILE* f = _wfopen(fileName.c_str(), L"wt");
+    if (f == NULL)
+    {
+        RuntimeError("Error: ProfilerGenerateChromeTrace: Cannot create file <%ls>.\n", fileName.c_str());
+    }
+
+    fprintfOrDie(f, "{\"traceEvents\":[\n");
+
+    char* eventPtr = g_profilerState->customEventBuffer.get();
+    bool first = true;
+    std::string name;
+    while (eventPtr < (g_profilerState->customEventBuffer.get() + g_profilerState->customEventOffset))
+    {
+        char* descriptionStr = eventPtr;
+        eventPtr += strlen(descriptionStr) + 1;
+
+        CustomEventRecord* eventRecord = (CustomEventRecord*)eventPtr;
+        eventPtr += sizeof(CustomEventRecord);
+
+        // escape the description as a JSON string
+        name.clear();
+        for (const char* c = descriptionStr; *c; c++)
+        {
+            if (*c == '"' || *c == '\\')
+                name += '\\';
+            if ((unsigned char)*c >= 0x20)
+                name += *c;
+        }
+
+        fprintfOrDie(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            first ? "" : ",\n", name.c_str(), eventRecord->threadId,
+            1000000.0 * TicksToSeconds(eventRecord->beginClock),
+            1000000.0 * TicksToSeconds(eventRecord->endClock - eventRecord->beginClock));
+        first = false;
+    }
+
+    fprintfOrDie(f, "\n]}\n");
+
+    fclose(f);
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Scoped helpers.
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -26,6 +26,14 @@
 // and ProfilerThroughputBegin() calls should be used. The throughput APIs can only be used
 // with fixed events.
 //
+// The time spent in individual computation nodes is measured with ProfilerTimeBegin() and
+// ProfilerNodeTimeEnd(). Node events are aggregated per node and per operation type and written
+// to a separate node report, sorted by time. Together with the estimates of the floating-point
+// operations and bytes touched by each call, the report shows which nodes dominate the minibatch time.
+//
+// All events recorded in the custom event buffer are also written as a Chrome trace (JSON), which
+// can be opened in chrome://tracing to inspect the timeline per thread.
+//
 // CNTK specifics
 //
 // The profiler is turned off during the very first epoch to avoid polluting profile data with
@@ -106,6 +114,15 @@ long long PERF_PROFILER_API ProfilerTimeBegin();
 void PERF_PROFILER_API ProfilerTimeEnd(const long long stateId, const int eventId);
 void PERF_PROFILER_API ProfilerTimeEnd(const long long stateId, const char* eventDescription);
 
+//
+// Measure the time of a forward or backward computation of a computation node.
+// The stateId comes from ProfilerTimeBegin(). Events are aggregated by node name; flops and bytes are
+// estimates of the floating-point operations and of the memory traffic of this call.
+// The names are null-terminated strings, like the event descriptions, so no STL type crosses the DLL boundary.
+//
+void PERF_PROFILER_API ProfilerNodeTimeEnd(const long long stateId, const wchar_t* nodeName, const wchar_t* operationName,
+    const bool backward, const double flops, const double bytes);
+
 //
 // Conditionally sync the GPU if the syncGPU flag is set. This only needs to be excplicitly
 // called for custom events.
@@ -9,7 +9,9 @@
 #include "BinaryChunkDeserializer.h"
 #include "BinaryDataChunk.h"
 #include "FileHelper.h"
+#include "MemoryMappedFile.h"
 #include <vector>
+#include <algorithm>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -67,6 +69,9 @@ BinaryChunkDeserializer::BinaryChunkDeserializer(const BinaryConfigHelper& helpe
 {
     SetTraceLevel(helper.GetTraceLevel());
 
+    m_useMemoryMapping = helper.ShouldUseMemoryMapping();
+    m_numReadAheadChunks = helper.GetNumReadAheadChunks();
+
     Initialize(helper.GetRename(), helper.GetElementType());
 }
 
@@ -77,6 +82,8 @@ BinaryChunkDeserializer::BinaryChunkDeserializer(const std::wstring& filename) :
     m_file(nullptr),
     m_headerOffset(0),
     m_chunkTableOffset(0),
+    m_useMemoryMapping(false),
+    m_numReadAheadChunks(0),
     m_traceLevel(0)
 {
 }
@@ -150,6 +157,17 @@ void BinaryChunkDeserializer::Initialize(const std::map<std::wstring, std::wstri
     // Note it's possible in distributed reading mode to only want to read
     // a subset of the offsets table.
     ReadChunkTable(m_file);
+
+    if (m_useMemoryMapping)
+    {
+        m_mappedFile = make_shared<MemoryMappedFile>(m_filename);
+        // Chunks are requested in the randomized order, the readahead is driven by ReadAhead() instead.
+        m_mappedFile->AdviseRandomAccess();
+
+        if (m_traceLevel > 1)
+            fprintf(stderr, "BinaryChunkDeserializer: memory mapped '%ls' (%" PRIu64 " bytes).\n",
+                m_filename.c_str(), (uint64_t)m_mappedFile->Size());
+    }
 }
 
 ChunkDescriptions BinaryChunkDeserializer::GetChunkDescriptions()
@@ -177,10 +195,19 @@ void BinaryChunkDeserializer::GetSequencesForChunk(ChunkIdType chunkId, std::vec
     auto numberOfSequences = m_chunkTable->GetNumSequences(chunkId);
     unique_ptr<uint32_t[]> numSamplesPerSequence(new uint32_t[numberOfSequences]);
 
-    // Seek to the start of the chunk
-    CNTKBinaryFileHelper::SeekOrDie(m_file, offset, SEEK_SET);
-    // read 'numberOfSequences' unsigned ints
-    CNTKBinaryFileHelper::ReadOrDie(numSamplesPerSequence.get(), sizeof(uint32_t), numberOfSequences, m_file);
+    if (m_mappedFile)
+    {
+        if (offset + numberOfSequences * sizeof(uint32_t) > m_mappedFile->Size())
+            RuntimeError("Chunk %" PRIu32 " is out of bounds of the input file '%ls'.", chunkId, m_filename.c_str());
+        memcpy(numSamplesPerSequence.get(), m_mappedFile->Data() + offset, numberOfSequences * sizeof(uint32_t));
+    }
+    else
+    {
+        // Seek to the start of the chunk
+        CNTKBinaryFileHelper::SeekOrDie(m_file, offset, SEEK_SET);
+        // read 'numberOfSequences' unsigned ints
+        CNTKBinaryFileHelper::ReadOrDie(numSamplesPerSequence.get(), sizeof(uint32_t), numberOfSequences, m_file);
+    }
 
     auto startId = m_chunkTable->GetStartIndex(chunkId);
     for (decltype(numberOfSequences) i = 0; i < numberOfSequences; i++)
@@ -215,8 +242,30 @@ unique_ptr<byte[]> BinaryChunkDeserializer::ReadChunk(ChunkIdType chunkId)
 }
 
 
+void BinaryChunkDeserializer::ReadAhead(ChunkIdType chunkId)
+{
+    // The requested chunk is parsed right away, the following ones are most likely requested next
+    // when the data is not randomized or the randomization window is larger than a single chunk.
+    ChunkIdType lastChunkId = (ChunkIdType)std::min<size_t>(m_numChunks - 1, chunkId + m_numReadAheadChunks);
+    auto startOffset = m_chunkTable->GetDataStartOffset(chunkId);
+    auto endOffset = m_chunkTable->GetOffset(lastChunkId + 1);
+    m_mappedFile->AdviseWillNeed(startOffset, endOffset - startOffset);
+}
+
 ChunkPtr BinaryChunkDeserializer::GetChunk(ChunkIdType chunkId)
 {
+    if (m_mappedFile)
+    {
+        auto dataStartOffset = m_chunkTable->GetDataStartOffset(chunkId);
+        if (dataStartOffset + m_chunkTable->GetChunkSize(chunkId) > m_mappedFile->Size())
+            RuntimeError("Chunk %" PRIu32 " is out of bounds of the input file '%ls'.", chunkId, m_filename.c_str());
+
+        ReadAhead(chunkId);
+
+        // No copy: the sequences of the chunk point directly into the mapped file.
+        return make_shared<BinaryDataChunk>(chunkId, m_chunkTable->GetNumSequences(chunkId), m_mappedFile, dataStartOffset, m_deserializers);
+    }
+
     // Read the chunk into memory
     unique_ptr<byte[]> buffer = ReadChunk(chunkId);
 
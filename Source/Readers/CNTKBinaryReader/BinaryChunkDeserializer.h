@@ -108,6 +108,10 @@ private:
     // Reads a chunk from disk into buffer
     unique_ptr<byte[]> ReadChunk(ChunkIdType chunkId);
 
+    // Asks the OS to start reading the chunk and the next m_numReadAheadChunks chunks
+    // of the memory mapped file in the background.
+    void ReadAhead(ChunkIdType chunkId);
+
     BinaryChunkDeserializer(const wstring& filename);
 
     void SetTraceLevel(unsigned int traceLevel);
@@ -122,6 +126,12 @@ private:
     ChunkTablePtr m_chunkTable;
     void* m_chunkBuffer;
 
+    // If memory mapping is enabled, chunks point directly into the mapped input file
+    // instead of being copied into a newly allocated buffer.
+    bool m_useMemoryMapping;
+    size_t m_numReadAheadChunks;
+    MemoryMappedFilePtr m_mappedFile;
+
     
     uint32_t m_numChunks;
     uint32_t m_numInputs;
@@ -64,6 +64,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         m_filepath = msra::strfun::utf16(config(L"file"));
         m_keepDataInMemory = config(L"keepDataInMemory", false);
+        m_useMemoryMapping = config(L"useMemoryMapping", false);
+        m_numReadAheadChunks = config(L"readAheadChunks", (size_t)2);
 
         m_randomizationWindow = GetRandomizationWindowFromConfig(config);
         m_sampleBasedRandomizationWindow = config(L"sampleBasedRandomizationWindow", false);
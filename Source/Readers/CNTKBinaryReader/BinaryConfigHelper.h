@@ -34,6 +34,10 @@ public:
 
     bool ShouldKeepDataInMemory() const { return m_keepDataInMemory; }
 
+    bool ShouldUseMemoryMapping() const { return m_useMemoryMapping; }
+
+    size_t GetNumReadAheadChunks() const { return m_numReadAheadChunks; }
+
     ElementType GetElementType() const { return m_elementType; }
 
     DISABLE_COPY_AND_MOVE(BinaryConfigHelper);
@@ -48,6 +52,8 @@ private:
     bool m_sampleBasedRandomizationWindow;
     unsigned int m_traceLevel;
     bool m_keepDataInMemory; // if true the whole dataset is kept in memory
+    bool m_useMemoryMapping; // if true chunks are served directly from a read-only mapping of the input file
+    size_t m_numReadAheadChunks; // number of chunks following the requested one to prefetch when memory mapping is used
 };
 
 } } }
@@ -10,6 +10,7 @@
 #include "CorpusDescriptor.h"
 #include "BinaryChunkDeserializer.h"
 #include "BinaryDataDeserializer.h"
+#include "MemoryMappedFile.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 class BinaryDataChunk : public Chunk, public std::enable_shared_from_this<Chunk>
@@ -23,7 +24,25 @@ public:
         m_numSequences(numSequences), 
         m_buffer(std::move(buffer)), 
         m_deserializers(deserializer)
-    { }
+    {
+        m_chunkData = m_buffer.get();
+    }
+
+    // Creates a chunk that points directly into a memory mapped input file, no data is copied.
+    // The chunk keeps the mapping alive for as long as it (and the sequences pointing into it) exist.
+    explicit BinaryDataChunk(ChunkIdType chunkId,
+        size_t numSequences,
+        MemoryMappedFilePtr mappedFile,
+        size_t dataOffset,
+        std::vector<BinaryDataDeserializerPtr> deserializer)
+        : m_chunkId(chunkId),
+        m_numSequences(numSequences),
+        m_mappedFile(mappedFile),
+        m_deserializers(deserializer)
+    {
+        // The deserializers never write into the buffer, so handing out the read-only pages is safe.
+        m_chunkData = const_cast<char*>(m_mappedFile->Data()) + dataOffset;
+    }
 
     // Gets a sequence using its index inside the chunk.
     void GetSequence(size_t sequenceIdx, std::vector<SequenceDataPtr>& result) override
@@ -58,7 +77,7 @@ protected:
         size_t bytesProcessed = 0;
         // Now call all of the deserializers on the chunk, in order
         for (size_t i = 0; i < m_deserializers.size(); i++)
-            bytesProcessed += m_deserializers[i]->GetSequenceDataForChunk(m_numSequences, m_buffer.get() + bytesProcessed, m_data[i]);
+            bytesProcessed += m_deserializers[i]->GetSequenceDataForChunk(m_numSequences, (char*)m_chunkData + bytesProcessed, m_data[i]);
     }
 
     // chunk id (copied from the descriptor)
@@ -68,9 +87,16 @@ protected:
     // so we must tell the chunk where it starts.
     size_t m_numSequences;
 
-    // This is the actual chunk read from disk. We will call back to the deserializer for it to be deserialized
+    // This is the actual chunk read from disk. We will call back to the deserializer for it to be deserialized.
+    // Empty if the chunk points into a memory mapped file.
     unique_ptr<byte[]> m_buffer;
 
+    // The mapped input file, set only if the chunk has not been read into m_buffer.
+    MemoryMappedFilePtr m_mappedFile;
+
+    // Start of the chunk data, either in m_buffer or in m_mappedFile.
+    void* m_chunkData;
+
     // This is the deserializer who knows how to interpret the m_data chunk that we read in
     std::vector<BinaryDataDeserializerPtr> m_deserializers;
     
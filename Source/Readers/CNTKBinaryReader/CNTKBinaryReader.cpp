@@ -29,6 +29,9 @@ CNTKBinaryReader::CNTKBinaryReader(const ConfigParameters& config)
     {
         m_deserializer = shared_ptr<IDataDeserializer>(new BinaryChunkDeserializer(configHelper));
 
+        if (configHelper.ShouldUseMemoryMapping())
+            log << " | memory mapping the input file";
+
         if (configHelper.ShouldKeepDataInMemory())
         {
             m_deserializer = shared_ptr<IDataDeserializer>(new ChunkCache(m_deserializer));
@@ -0,0 +1,215 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// Fast path for parsing numbers in the CNTK text format.
+//
+// TextParser reads numbers character by character through a state machine that checks
+// for the end of the buffer and of the sequence after each character. When a number is known to be
+// terminated within the buffered input, the functions below parse it in one go: digit runs are
+// located with SSE4.2 string instructions (if available at runtime) and converted eight digits
+// at a time (SWAR). The result is bit-identical to the state machine in TextParser::TryReadRealNumber,
+// whenever that is not guaranteed (too many digits, malformed or truncated input) the functions
+// return false without consuming any input and the caller falls back to the state machine.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include "CPUFeatures.h"
+#ifdef CNTK_X86_CPU
+#include <nmmintrin.h>
+#endif
+
+#ifdef CNTK_X86_CPU
+#if defined(__GNUC__) && !defined(__SSE4_2__)
+#define TARGET_SSE42 __attribute__((target("sse4.2")))
+#else
+#define TARGET_SSE42
+#endif
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace FastNumberParser {
+
+// Returns the length of the run of decimal digits that starts at pos (bounded by end).
+typedef size_t (*ScanDigitsFunction)(const char* pos, const char* end);
+
+// Digit runs longer than this are not guaranteed to be accumulated exactly in a double,
+// such numbers are left to the state machine.
+const size_t MaxExactDigits = 15;
+
+// Maximum number of digits in a uint64 value that cannot overflow.
+const size_t MaxUint64Digits = 19;
+
+inline size_t ScanDigitsScalar(const char* pos, const char* end)
+{
+    const char* start = pos;
+    while (pos != end && '0' <= *pos && *pos <= '9')
+        ++pos;
+    return pos - start;
+}
+
+#ifdef CNTK_X86_CPU
+TARGET_SSE42 inline size_t ScanDigitsSSE42(const char* pos, const char* end)
+{
+    static const char digitRange[16] = { '0', '9' };
+    const __m128i range = _mm_loadu_si128((const __m128i*)digitRange);
+
+    const char* start = pos;
+    while (end - pos >= 16)
+    {
+        // Index of the first character outside of ['0', '9'], 16 if there is none.
+        int index = _mm_cmpestri(range, 2, _mm_loadu_si128((const __m128i*)pos), 16,
+                                 _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT);
+        pos += index;
+        if (index < 16)
+            return pos - start;
+    }
+
+    return (pos - start) + ScanDigitsScalar(pos, end);
+}
+#endif
+
+// Selects the fastest digit scanner supported by the CPU.
+inline ScanDigitsFunction SelectScanDigitsFunction()
+{
+#ifdef CNTK_X86_CPU
+    if (CPUFeatures::Get().HasSSE42())
+        return &ScanDigitsSSE42;
+#endif
+    return &ScanDigitsScalar;
+}
+
+// Converts exactly eight digit characters into their value (assumes little-endian byte order).
+inline uint64_t ParseEightDigits(const char* pos)
+{
+    uint64_t value;
+    memcpy(&value, pos, sizeof(value));
+    value = (value & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+    value = (value & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+    return (value & 0x0000FFFF0000FFFFULL) * 42949672960001ULL >> 32;
+}
+
+// Converts count (at most MaxUint64Digits) digit characters into their value.
+inline uint64_t ParseDigits(const char* pos, size_t count)
+{
+    uint64_t value = 0;
+    for (; count >= 8; count -= 8, pos += 8)
+        value = value * 100000000 + ParseEightDigits(pos);
+    for (; count > 0; --count, ++pos)
+        value = value * 10 + (*pos - '0');
+    return value;
+}
+
+inline bool IsSign(char c) { return c == '-' || c == '+'; }
+inline bool IsExponent(char c) { return c == 'e' || c == 'E'; }
+
+// Parses a floating point number in [pos, end). On success, pos is moved to the first character
+// after the number, exactly as the state machine would do.
+// Returns false and leaves pos unchanged if the number is not followed by
+// a terminating character before end, or cannot be parsed exactly.
+template <class ElemType>
+inline bool TryParseRealNumber(const char*& pos, const char* end, ElemType& value, ScanDigitsFunction scanDigits)
+{
+    static const double powersOf10[MaxExactDigits + 1] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+    };
+
+    const char* p = pos;
+    if (p == end)
+        return false;
+
+    bool negative = false;
+    if (IsSign(*p))
+    {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    size_t count = scanDigits(p, end);
+    if (count == 0 || count > MaxExactDigits || p + count == end)
+        return false;
+
+    double number = (double)ParseDigits(p, count);
+    p += count;
+
+    double coefficient;
+    if (*p == '.')
+    {
+        if (++p == end)
+            return false;
+
+        count = scanDigits(p, end);
+        if (count == 0)
+        {
+            // A period not followed by digits terminates the number.
+            value = static_cast<ElemType>(negative ? -number : number);
+            pos = p;
+            return true;
+        }
+
+        if (count > MaxExactDigits || p + count == end)
+            return false;
+
+        coefficient = number + (double)ParseDigits(p, count) / powersOf10[count];
+        p += count;
+
+        if (!IsExponent(*p))
+        {
+            value = static_cast<ElemType>(negative ? -coefficient : coefficient);
+            pos = p;
+            return true;
+        }
+
+        if (negative)
+            coefficient = -coefficient;
+    }
+    else if (IsExponent(*p))
+    {
+        coefficient = negative ? -number : number;
+    }
+    else
+    {
+        value = static_cast<ElemType>(negative ? -number : number);
+        pos = p;
+        return true;
+    }
+
+    // p points to the exponent symbol.
+    if (++p == end)
+        return false;
+
+    bool negativeExponent = false;
+    if (IsSign(*p))
+    {
+        negativeExponent = (*p == '-');
+        if (++p == end)
+            return false;
+    }
+
+    count = scanDigits(p, end);
+    if (count == 0 || count > MaxExactDigits || p + count == end)
+        return false;
+
+    double exponent = (double)ParseDigits(p, count);
+    value = static_cast<ElemType>(coefficient * pow(10.0, negativeExponent ? -exponent : exponent));
+    pos = p + count;
+    return true;
+}
+
+// Parses an unsigned integer in [pos, end), same contract as TryParseRealNumber.
+inline bool TryParseUint64(const char*& pos, const char* end, size_t& value, ScanDigitsFunction scanDigits)
+{
+    size_t count = scanDigits(pos, end);
+    if (count == 0 || count > MaxUint64Digits || pos + count == end)
+        return false;
+
+    value = (size_t)ParseDigits(pos, count);
+    pos += count;
+    return true;
+}
+
+}}}}
@@ -124,6 +124,8 @@ TextConfigHelper::TextConfigHelper(const ConfigParameters& config)
     m_chunkSizeBytes = config(L"chunkSizeInBytes", g_32MB); // 32 MB by default
     m_keepDataInMemory = config(L"keepDataInMemory", false);
     m_frameMode = config(L"frameMode", false);
+    m_numIndexingThreads = config(L"numIndexingThreads", (size_t)1);
+    m_cacheIndex = config(L"cacheIndex", false);
 
     m_randomizationWindow = GetRandomizationWindowFromConfig(config);
     m_sampleBasedRandomizationWindow = config(L"sampleBasedRandomizationWindow", false);
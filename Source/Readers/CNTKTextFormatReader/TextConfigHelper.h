@@ -41,6 +41,10 @@ public:
 
     bool IsInFrameMode() const { return m_frameMode; }
 
+    size_t GetNumIndexingThreads() const { return m_numIndexingThreads; }
+
+    bool ShouldCacheIndex() const { return m_cacheIndex; }
+
     ElementType GetElementType() const { return m_elementType; }
 
     DISABLE_COPY_AND_MOVE(TextConfigHelper);
@@ -59,6 +63,8 @@ private:
     size_t m_chunkSizeBytes; // chunks size in bytes
     bool m_keepDataInMemory; // if true the whole dataset is kept in memory
     bool m_frameMode; // if true, the maximum expected sequence length in the dataset is one sample.
+    size_t m_numIndexingThreads; // number of threads used to index the input file (1 = sequential indexing)
+    bool m_cacheIndex; // if true the index is persisted next to the input file and reused on subsequent runs
 };
 
 } } }
@@ -68,6 +68,8 @@ TextParser(corpus, helper.GetFilePath(), helper.GetStreams(), primary)
     SetMaxAllowedErrors(helper.GetMaxAllowedErrors());
     SetChunkSize(helper.GetChunkSize());
     SetSkipSequenceIds(helper.ShouldSkipSequenceIds());
+    SetNumIndexingThreads(helper.GetNumIndexingThreads());
+    SetCacheIndex(helper.ShouldCacheIndex());
 
     Initialize();
 }
@@ -91,6 +93,9 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     m_hadWarnings(false),
     m_numAllowedErrors(0),
     m_skipSequenceIds(false),
+    m_numIndexingThreads(1),
+    m_cacheIndex(false),
+    m_scanDigits(FastNumberParser::SelectScanDigitsFunction()),
     m_numRetries(5),
     m_corpus(corpus)
 {
@@ -169,11 +174,18 @@ void TextParser<ElemType>::Initialize()
         }
 
         m_indexer = make_unique<Indexer>(m_file, m_primary, m_skipSequenceIds, NAME_PREFIX, m_chunkSizeBytes);
-        m_indexer->Build(m_corpus);
+        BuildIndex();
     });
 
     assert(m_indexer != nullptr);
 
+    // Parallel and cached indexing do not read through m_file, move it to the end
+    // as sequential indexing does, so that the first sequence load always seeks.
+    if (_fseeki64(m_file, 0, SEEK_END) != 0)
+    {
+        RuntimeError("Error seeking to the end of the input file (%ls).", m_filename.c_str());
+    }
+
     int64_t position = _ftelli64(m_file);
     if (position < 0)
     {
@@ -183,6 +195,42 @@ void TextParser<ElemType>::Initialize()
     m_fileOffsetEnd = m_fileOffsetStart = static_cast<size_t>(position);
 }
 
+template <class ElemType>
+void TextParser<ElemType>::BuildIndex()
+{
+    const wstring cacheFilename = m_filename + L".index";
+    if (m_cacheIndex && m_indexer->TryLoadFromCache(m_corpus, m_filename, cacheFilename))
+    {
+        if (m_traceLevel >= Info)
+        {
+            fprintf(stderr, "INFO: Loaded the index of the input file (%ls) from the cache (%ls).\n",
+                m_filename.c_str(), cacheFilename.c_str());
+        }
+        return;
+    }
+
+    if (m_numIndexingThreads > 1)
+        m_indexer->BuildInParallel(m_corpus, m_filename, m_numIndexingThreads);
+    else
+        m_indexer->Build(m_corpus);
+
+    if (!m_cacheIndex)
+        return;
+
+    // Failing to write the cache (e.g., the input is on a read-only share) is not fatal.
+    try
+    {
+        m_indexer->SaveToCache(m_corpus, m_filename, cacheFilename);
+    }
+    catch (const std::exception& e)
+    {
+        if (ShouldWarn())
+        {
+            fprintf(stderr, "WARNING: Could not write the index cache (%ls): %s\n", cacheFilename.c_str(), e.what());
+        }
+    }
+}
+
 template <class ElemType>
 ChunkDescriptions TextParser<ElemType>::GetChunkDescriptions()
 {
@@ -949,6 +997,18 @@ void TextParser<ElemType>::SkipToNextInput(size_t& bytesToRead)
 template <class ElemType>
 bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
 {
+    if (m_scanDigits != nullptr)
+    {
+        // Fast path, see TryReadRealNumber.
+        const char* pos = m_pos;
+        if (FastNumberParser::TryParseUint64(pos, m_pos + min(bytesToRead, (size_t)(m_bufferEnd - m_pos)), value, m_scanDigits))
+        {
+            bytesToRead -= pos - m_pos;
+            m_pos = pos;
+            return true;
+        }
+    }
+
     value = 0;
     bool found = false;
     while (bytesToRead && CanRead())
@@ -1019,6 +1079,20 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
 template <class ElemType>
 bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRead)
 {
+    if (m_scanDigits != nullptr)
+    {
+        // Fast path: parses the number directly from the buffer if it is terminated before
+        // the end of the buffered data (and of the current sequence). Otherwise, or if the number
+        // cannot be parsed exactly, nothing is consumed and the state machine below takes over.
+        const char* pos = m_pos;
+        if (FastNumberParser::TryParseRealNumber(pos, m_pos + min(bytesToRead, (size_t)(m_bufferEnd - m_pos)), value, m_scanDigits))
+        {
+            bytesToRead -= pos - m_pos;
+            m_pos = pos;
+            return true;
+        }
+    }
+
     State state = State::Init;
     double coefficient = .0, number = .0, divider = .0;
     bool negative = false;
@@ -1280,6 +1354,24 @@ void TextParser<ElemType>::SetNumRetries(unsigned int numRetries)
     m_numRetries = numRetries;
 }
 
+template <class ElemType>
+void TextParser<ElemType>::SetNumIndexingThreads(size_t numThreads)
+{
+    m_numIndexingThreads = numThreads;
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SetCacheIndex(bool cacheIndex)
+{
+    m_cacheIndex = cacheIndex;
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SetUseFastNumberParser(bool useFastParser)
+{
+    m_scanDigits = useFastParser ? FastNumberParser::SelectScanDigitsFunction() : nullptr;
+}
+
 template <class ElemType>
 std::wstring TextParser<ElemType>::GetFileInfo()
 {
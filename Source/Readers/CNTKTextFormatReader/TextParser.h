@@ -10,6 +10,7 @@
 #include "TextConfigHelper.h"
 #include "Indexer.h"
 #include "CorpusDescriptor.h"
+#include "FastNumberParser.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -120,6 +121,12 @@ private:
     bool m_hadWarnings;
     unsigned int m_numAllowedErrors;
     bool m_skipSequenceIds;
+    size_t m_numIndexingThreads; // when greater than one, the input file is indexed in parallel
+    bool m_cacheIndex; // when true, the index is loaded from/saved to a cache file next to the input file
+
+    // Digit scanner used by the fast number parsing path (selected at runtime based on the CPU features),
+    // nullptr if the fast path is disabled and all numbers go through the state machine.
+    FastNumberParser::ScanDigitsFunction m_scanDigits;
     unsigned int m_numRetries; // specifies the number of times an unsuccessful
                                // file operation should be repeated (default value is 5).
 
@@ -193,6 +200,15 @@ private:
 
     void SetNumRetries(unsigned int numRetries);
 
+    void SetNumIndexingThreads(size_t numThreads);
+
+    void SetCacheIndex(bool cacheIndex);
+
+    void SetUseFastNumberParser(bool useFastParser);
+
+    // Builds the index, either by scanning the input file or by loading it from the cache.
+    void BuildIndex();
+
     friend class CNTKTextFormatReaderTestRunner<ElemType>;
 
     DISABLE_COPY_AND_MOVE(TextParser);
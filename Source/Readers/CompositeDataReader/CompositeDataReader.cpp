@@ -170,6 +170,11 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
 
     // Check whether to use local timeline, by default we use it for better performance.
     bool localTimeline = config(L"localTimeline", true);
+
+    // Size of the pool (in minibatches) in which sequences are grouped by length, 0 to switch bucketing off.
+    // Only applies when packing full sequences.
+    size_t bucketingWindow = config(L"bucketingWindow", 0);
+
     switch (m_packingMode)
     {
     case PackingMode::sample:
@@ -186,7 +191,8 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
             m_streams,
             numAlternatingBuffers,
             localTimeline,
-            m_corpus);
+            m_corpus,
+            bucketingWindow);
         break;
     case PackingMode::truncated:
     {
@@ -67,18 +67,28 @@ protected:
     vector<char> m_buffer;   // Buffer for the whole chunk
     vector<bool> m_valid;    // Bit mask whether the parsed sequence is valid.
     MLFUtteranceParser m_parser;
+    MemoryMappedFilePtr m_cache; // Parsed labels, if the index was loaded from the cache.
 
     const MLFDeserializer& m_deserializer;
     const ChunkDescriptor& m_descriptor;     // Current chunk descriptor.
 
-    ChunkBase(const MLFDeserializer& deserializer, const ChunkDescriptor& descriptor, const wstring& fileName, const StateTablePtr& states)
+    ChunkBase(const MLFDeserializer& deserializer, const ChunkDescriptor& descriptor, const wstring& fileName, const StateTablePtr& states, const MemoryMappedFilePtr& cache)
         : m_parser(states),
+          m_cache(cache),
           m_descriptor(descriptor),
           m_deserializer(deserializer)
     {
-        if (descriptor.m_sequences.empty() || !descriptor.m_byteSize)
+        // With the cache, chunks consisting only of invalid utterances do not have any data.
+        if (descriptor.m_sequences.empty() || (!descriptor.m_byteSize && !m_cache))
             LogicError("Empty chunks are not supported.");
 
+        // all sequences are valid by default.
+        m_valid.resize(m_descriptor.m_numberOfSequences, true);
+
+        // The labels are already parsed, nothing to read.
+        if (m_cache)
+            return;
+
         auto f = shared_ptr<FILE>(fopenOrDie(fileName, L"rbS"), [](FILE *f) { if (f) fclose(f); });
         size_t sizeInBytes =
             descriptor.m_sequences.back().OffsetInChunk() + descriptor.m_sequences.back().SizeInBytes();
@@ -95,9 +105,26 @@ protected:
             RuntimeError("Error seeking to position '%" PRId64 "' in the input file '%ls', error code '%d'", chunkOffset, fileName.c_str(), rc);
 
         freadOrDie(m_buffer.data(), 1, sizeInBytes, f.get());
+    }
 
-        // all sequences are valid by default.
-        m_valid.resize(m_descriptor.m_numberOfSequences, true);
+    // Retrieves the label ranges of the utterance, either from the cache or by parsing the chunk buffer.
+    bool ReadUtterance(const SequenceDescriptor& sequence, vector<MLFFrameRange>& utterance)
+    {
+        if (m_cache)
+        {
+            // Utterances that could not be parsed are stored without ranges.
+            if (!sequence.SizeInBytes())
+                return false;
+
+            auto start = reinterpret_cast<const MLFFrameRange*>(m_cache->Data() + m_descriptor.m_offset + sequence.OffsetInChunk());
+            utterance.assign(start, start + sequence.SizeInBytes() / sizeof(MLFFrameRange));
+            return true;
+        }
+
+        auto start = m_buffer.data() + sequence.OffsetInChunk();
+        auto end = start + sequence.SizeInBytes();
+        auto absoluteOffset = m_descriptor.m_offset + sequence.OffsetInChunk();
+        return m_parser.Parse(boost::make_iterator_range(start, end), utterance, absoluteOffset);
     }
 
     string KeyOf(const SequenceDescriptor& s)
@@ -119,8 +146,8 @@ class MLFDeserializer::SequenceChunk : public MLFDeserializer::ChunkBase
     vector<vector<MLFFrameRange>> m_sequences; // Each sequence is a vector of sequential frame ranges.
 
 public:
-    SequenceChunk(const MLFDeserializer& parent, const ChunkDescriptor& descriptor, const wstring& fileName, StateTablePtr states)
-        : ChunkBase(parent, descriptor, fileName, states)
+    SequenceChunk(const MLFDeserializer& parent, const ChunkDescriptor& descriptor, const wstring& fileName, StateTablePtr states, const MemoryMappedFilePtr& cache)
+        : ChunkBase(parent, descriptor, fileName, states, cache)
     {
         m_sequences.resize(m_descriptor.m_numberOfSequences);
 
@@ -133,12 +160,8 @@ public:
 
     void CacheSequence(const SequenceDescriptor& sequence, size_t index)
     {
-        auto start = m_buffer.data() + sequence.OffsetInChunk();
-        auto end = start + sequence.SizeInBytes();
-
         vector<MLFFrameRange> utterance;
-        auto absoluteOffset = m_descriptor.m_offset + sequence.OffsetInChunk();
-        bool parsed = m_parser.Parse(boost::make_iterator_range(start, end), utterance, absoluteOffset);
+        bool parsed = ReadUtterance(sequence, utterance);
         if (!parsed) // cannot parse
         {
             fprintf(stderr, "WARNING: Cannot parse the utterance '%s'\n", KeyOf(sequence).c_str());
@@ -209,8 +232,8 @@ class MLFDeserializer::FrameChunk : public MLFDeserializer::ChunkBase
     vector<ClassIdType> m_classIds;
 
 public:
-    FrameChunk(const MLFDeserializer& parent, const ChunkDescriptor& descriptor, const wstring& fileName, StateTablePtr states)
-        : ChunkBase(parent, descriptor, fileName, states)
+    FrameChunk(const MLFDeserializer& parent, const ChunkDescriptor& descriptor, const wstring& fileName, StateTablePtr states, const MemoryMappedFilePtr& cache)
+        : ChunkBase(parent, descriptor, fileName, states, cache)
     {
         // Preallocate a big array for filling in class ids for the whole chunk.
         m_classIds.resize(m_descriptor.m_numberOfSamples);
@@ -254,12 +277,8 @@ public:
     // Parses and caches sequence in the buffer for GetSequence fast retrieval.
     void CacheSequence(const SequenceDescriptor& sequence, size_t index)
     {
-        auto start = m_buffer.data() + sequence.OffsetInChunk();
-        auto end = start + sequence.SizeInBytes();
-
         vector<MLFFrameRange> utterance;
-        auto absoluteOffset = m_descriptor.m_offset + sequence.OffsetInChunk();
-        bool parsed = m_parser.Parse(boost::make_iterator_range(start, end), utterance, absoluteOffset);
+        bool parsed = ReadUtterance(sequence, utterance);
         if (!parsed)
         {
             m_valid[index] = false;
@@ -311,6 +330,9 @@ MLFDeserializer::MLFDeserializer(CorpusDescriptorPtr corpus, const ConfigParamet
     if (m_frameMode && m_withPhoneBoundaries)
         LogicError("frameMode and phoneBoundaries are mutually exclusive options.");
 
+    m_numIndexingThreads = streamConfig(L"numIndexingThreads", (size_t)1);
+    m_cacheIndex = streamConfig(L"cacheIndex", false);
+
     wstring labelMappingFile = streamConfig(L"labelMappingFile", L"");
     InitializeChunkDescriptions(corpus, config, labelMappingFile);
     InitializeStream(inputName);
@@ -345,6 +367,9 @@ MLFDeserializer::MLFDeserializer(CorpusDescriptorPtr corpus, const ConfigParamet
 
     m_withPhoneBoundaries = labelConfig(L"phoneBoundaries", "false");
 
+    m_numIndexingThreads = labelConfig(L"numIndexingThreads", (size_t)1);
+    m_cacheIndex = labelConfig(L"cacheIndex", false);
+
     wstring labelMappingFile = labelConfig(L"labelMappingFile", L"");
     InitializeChunkDescriptions(corpus, config, labelMappingFile);
     InitializeStream(name);
@@ -370,9 +395,7 @@ void MLFDeserializer::InitializeChunkDescriptions(CorpusDescriptorPtr corpus, co
         shared_ptr<MLFIndexer> indexer;
         attempt(5, [this, &indexer, path, corpus]()
         {
-            auto file = shared_ptr<FILE>(fopenOrDie(path, L"rbS"), [](FILE *f) { if (f) fclose(f); });
-            indexer = make_shared<MLFIndexer>(file.get(), m_frameMode, m_chunkSizeBytes);
-            indexer->Build(corpus);
+            indexer = BuildIndex(corpus, path);
         });
 
         m_mlfFiles.push_back(path);
@@ -412,6 +435,45 @@ void MLFDeserializer::InitializeChunkDescriptions(CorpusDescriptorPtr corpus, co
         InitializeReadOnlyArrayOfLabels();
 }
 
+MLFIndexerPtr MLFDeserializer::BuildIndex(CorpusDescriptorPtr corpus, const wstring& path)
+{
+    auto file = shared_ptr<FILE>(fopenOrDie(path, L"rbS"), [](FILE *f) { if (f) fclose(f); });
+    auto indexer = make_shared<MLFIndexer>(file.get(), m_frameMode, m_chunkSizeBytes);
+
+    const wstring cacheFilename = path + L".cache";
+    if (m_cacheIndex && indexer->TryLoadFromCache(corpus, path, cacheFilename, m_stateTable))
+    {
+        fprintf(stderr, "MLFDeserializer: loaded the index and labels of '%ls' from the cache '%ls'\n", path.c_str(), cacheFilename.c_str());
+        return indexer;
+    }
+
+    if (m_numIndexingThreads > 1)
+        indexer->BuildInParallel(corpus, path, m_numIndexingThreads);
+    else
+        indexer->Build(corpus);
+
+    if (!m_cacheIndex)
+        return indexer;
+
+    // Failing to write the cache (e.g., the MLF is on a read-only share) is not fatal.
+    try
+    {
+        indexer->SaveToCache(path, cacheFilename, m_stateTable, m_numIndexingThreads);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "WARNING: Could not write the MLF cache '%ls': %s\n", cacheFilename.c_str(), e.what());
+        return indexer;
+    }
+
+    // Switching to the cache right away, so that this run does not parse the labels again either.
+    auto cachedIndexer = make_shared<MLFIndexer>(file.get(), m_frameMode, m_chunkSizeBytes);
+    if (cachedIndexer->TryLoadFromCache(corpus, path, cacheFilename, m_stateTable))
+        return cachedIndexer;
+
+    return indexer;
+}
+
 void MLFDeserializer::InitializeReadOnlyArrayOfLabels()
 {
     m_categories.reserve(m_dimension);
@@ -476,12 +538,14 @@ ChunkPtr MLFDeserializer::GetChunk(ChunkIdType chunkId)
     attempt(5, [this, &result, chunkId]()
     {
         auto chunk = m_chunks[chunkId];
-        auto& fileName = m_mlfFiles[m_chunkToFileIndex[chunk]];
+        auto fileIndex = m_chunkToFileIndex[chunk];
+        auto& fileName = m_mlfFiles[fileIndex];
+        const auto& cache = m_indexers[fileIndex].second->GetCache();
 
         if (m_frameMode)
-            result = make_shared<FrameChunk>(*this, *chunk, fileName, m_stateTable);
+            result = make_shared<FrameChunk>(*this, *chunk, fileName, m_stateTable, cache);
         else
-            result = make_shared<SequenceChunk>(*this, *chunk, fileName, m_stateTable);
+            result = make_shared<SequenceChunk>(*this, *chunk, fileName, m_stateTable, cache);
     });
 
     return result;
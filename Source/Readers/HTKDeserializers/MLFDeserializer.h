@@ -44,6 +44,9 @@ private:
     // Initializes chunk descriptions.
     void InitializeChunkDescriptions(CorpusDescriptorPtr corpus, const ConfigHelper& config, const std::wstring& stateListPath);
 
+    // Builds (or restores from the cache) the index of a single MLF file.
+    MLFIndexerPtr BuildIndex(CorpusDescriptorPtr corpus, const std::wstring& path);
+
     // Initializes a single stream this deserializer exposes.
     void InitializeStream(const std::wstring& name);
 
@@ -82,6 +85,12 @@ private:
 
     StateTablePtr m_stateTable;
 
+    // Number of threads used to index (and to parse, when caching) MLF files.
+    size_t m_numIndexingThreads;
+
+    // Flag that indicates whether the index and the parsed labels should be cached next to the MLF files.
+    bool m_cacheIndex;
+
     std::vector<std::pair<std::wstring, MLFIndexerPtr>> m_indexers;
     std::vector<std::wstring> m_mlfFiles;
 };
@@ -7,6 +7,8 @@
 #define _SCL_SECURE_NO_WARNINGS
 #include "MLFIndexer.h"
 #include "MLFUtils.h"
+#include "ExceptionCapture.h"
+#include "ReaderUtil.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -200,13 +202,24 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         boost::split(lines, range, boost::is_any_of("\r\n"));
     }
 
-    // Tries to parse sequence key
-    // In MLF a sequence key should be in quotes. During parsing the extension should be removed.
+    // Tries to parse sequence key and to convert it to id.
     bool MLFIndexer::TryParseSequenceKey(const boost::iterator_range<char*>& line, size_t& id, function<size_t(const string&)> keyToId)
     {
         id = 0;
 
-        string key(line.begin(), line.end());
+        string key;
+        if (!TryParseSequenceKey(line.begin(), line.end(), key))
+            return false;
+
+        id = keyToId(key);
+        return true;
+    }
+
+    // Tries to parse sequence key
+    // In MLF a sequence key should be in quotes. During parsing the extension should be removed.
+    bool MLFIndexer::TryParseSequenceKey(const char* begin, const char* end, string& key)
+    {
+        key.assign(begin, end);
         boost::trim_right(key);
 
         if (key.size() <= 2 || key.front() != '"' || key.back() != '"')
@@ -218,8 +231,372 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         // Remove extension if specified.
         key = key.substr(0, key.find_last_of("."));
+        return true;
+    }
 
-        id = keyToId(key);
+    // An utterance found by a parallel indexing thread in its range of the MLF file.
+    struct MLFIndexedUtterance
+    {
+        string m_key;               // key without quotes and extension, or the key line if it cannot be parsed
+        bool m_isValid;
+        uint32_t m_numberOfSamples;
+        size_t m_startOffset;       // offset of the key line in the file
+        size_t m_endOffset;         // offset after the "." line in the file
+    };
+
+    static inline bool IsLineDelimiter(char c)
+    {
+        return c == '\r' || c == '\n';
+    }
+
+    // Returns the end of the line that starts at pos.
+    // Same as for Build, both CR and LF delimit lines.
+    static size_t FindLineEnd(const char* data, size_t size, size_t pos)
+    {
+        while (pos < size && !IsLineDelimiter(data[pos]))
+            ++pos;
+        return pos;
+    }
+
+    // Returns the offset right after the first end of utterance ("." line) that starts in [offset, size).
+    static size_t FindUtteranceStart(const char* data, size_t size, size_t offset)
+    {
+        if (offset > 0 && !IsLineDelimiter(data[offset - 1]))
+            offset = FindLineEnd(data, size, offset);
+
+        while (offset < size)
+        {
+            size_t end = FindLineEnd(data, size, offset);
+            if (end == offset + 1 && data[offset] == '.')
+                return end;
+            offset = end + 1;
+        }
+
+        return size;
+    }
+
+    // Scans the utterances that start in [begin, end) of the MLF file, following the same state machine as Build.
+    // The range starts at the beginning of the file or right after the end of an utterance.
+    static void IndexUtterances(const char* data, size_t size, size_t begin, size_t end, vector<MLFIndexedUtterance>& result)
+    {
+        enum class State
+        {
+            Header,
+            UtteranceKey,
+            UtteranceFrames
+        };
+
+        State currentState = begin == 0 ? State::Header : State::UtteranceKey;
+        MLFIndexedUtterance current{};
+        size_t lastLineBegin = 0, lastLineEnd = 0; // Last non empty line, needed to parse information about last frame.
+        vector<boost::iterator_range<char*>> tokens;
+        for (size_t pos = begin; pos < end;)
+        {
+            size_t lineEnd = FindLineEnd(data, size, pos);
+            size_t lineBegin = pos;
+            pos = lineEnd + 1;
+
+            if (lineBegin == lineEnd) // Skip all empty lines.
+                continue;
+
+            switch (currentState)
+            {
+            case State::Header:
+            {
+                if (string(data + lineBegin, data + lineEnd) != "#!MLF!#")
+                    RuntimeError("Expected MLF header was not found.");
+                currentState = State::UtteranceKey;
+            }
+            break;
+            case State::UtteranceKey:
+            {
+                if (string(data + lineBegin, data + lineEnd) == "#!MLF!#")
+                    continue;
+
+                current = MLFIndexedUtterance{};
+                current.m_startOffset = lineBegin;
+                current.m_isValid = MLFIndexer::TryParseSequenceKey(data + lineBegin, data + lineEnd, current.m_key);
+                if (!current.m_isValid)
+                    current.m_key.assign(data + lineBegin, data + lineEnd);
+                currentState = State::UtteranceFrames;
+            }
+            break;
+            case State::UtteranceFrames:
+            {
+                if (lineEnd != lineBegin + 1 || data[lineBegin] != '.')
+                    break; // Still current utterance.
+
+                // A single . on a line means we found the end of the utterance.
+                // The number of frames is taken from the last non empty line.
+                current.m_endOffset = lineEnd;
+                tokens.clear();
+                auto container = boost::make_iterator_range(const_cast<char*>(data) + lastLineBegin, const_cast<char*>(data) + lastLineEnd);
+                boost::split(tokens, container, boost::is_any_of(" "));
+                auto range = MLFFrameRange::ParseFrameRange(tokens, current.m_endOffset);
+                current.m_numberOfSamples = static_cast<uint32_t>(range.second);
+
+                result.push_back(move(current));
+                currentState = State::UtteranceKey;
+            }
+            break;
+            default:
+                LogicError("Unexpected MLF state.");
+            }
+
+            lastLineBegin = lineBegin;
+            lastLineEnd = lineEnd;
+        }
+    }
+
+    void MLFIndexer::BuildInParallel(CorpusDescriptorPtr corpus, const wstring& filename, size_t numThreads, size_t minRangeSize)
+    {
+        if (!m_index.IsEmpty())
+            return;
+
+        size_t fileSize = filesize(m_file);
+        if (fileSize == 0)
+            RuntimeError("Input file is empty");
+
+        MemoryMappedFile file(filename);
+        const char* data = file.Data();
+        size_t size = min(file.Size(), fileSize);
+
+        m_index.Reserve(size);
+
+        // A few ranges per thread balance the load when utterances are not uniformly distributed.
+        numThreads = max<size_t>(numThreads, 1);
+        size_t numRanges = min(numThreads * 4, max<size_t>(1, size / max<size_t>(minRangeSize, 1)));
+        size_t rangeSize = (size + numRanges - 1) / numRanges;
+
+        // Range r covers the utterances that start between starts[r] and starts[r + 1].
+        vector<size_t> starts(numRanges + 1, size);
+        starts[0] = 0;
+#pragma omp parallel for schedule(dynamic) num_threads((int)numThreads)
+        for (int r = 1; r < (int)numRanges; ++r)
+            starts[r] = FindUtteranceStart(data, size, r * rangeSize);
+
+        for (size_t r = 1; r < numRanges; ++r)
+            starts[r] = max(starts[r], starts[r - 1]);
+
+        vector<vector<MLFIndexedUtterance>> ranges(numRanges);
+        ExceptionCapture capture;
+#pragma omp parallel for schedule(dynamic) num_threads((int)numThreads)
+        for (int i = 0; i < (int)numRanges; ++i)
+        {
+            capture.SafeRun([&](int r)
+            {
+                IndexUtterances(data, size, starts[r], starts[r + 1], ranges[r]);
+            }, i);
+        }
+        capture.RethrowIfHappened();
+
+        // Keys are mapped to ids in file order, as in Build.
+        for (auto& range : ranges)
+        {
+            for (const auto& utterance : range)
+            {
+                if (utterance.m_isValid)
+                    m_index.AddSequence(SequenceDescriptor{ KeyType{ corpus->KeyToId(utterance.m_key), 0 }, utterance.m_numberOfSamples }, utterance.m_startOffset, utterance.m_endOffset);
+                else
+                    fprintf(stderr, "WARNING: Cannot parse the utterance '%s' at offset (%" PRIu64 ")\n", utterance.m_key.c_str(), (uint64_t)utterance.m_startOffset);
+            }
+
+            range.clear();
+            range.shrink_to_fit();
+        }
+
+        m_fileOffsetStart = size;
+        m_done = true;
+    }
+
+    // Header of the MLF cache file. The cache is only valid for the MLF file
+    // with the same size and modification time, parsed with the same state list.
+    // The header is followed by the utterances, their label ranges and their keys.
+    struct MLFCacheHeader
+    {
+        uint64_t m_magic;
+        uint32_t m_version;
+        uint32_t m_reserved;
+        uint64_t m_fileSize;
+        int64_t m_modificationTime;
+        uint64_t m_stateTableHash;
+        uint64_t m_numberOfUtterances;
+        uint64_t m_numberOfRanges;
+        uint64_t m_keysSize;
+
+        bool operator==(const MLFCacheHeader& other) const
+        {
+            return m_magic == other.m_magic && m_version == other.m_version && m_fileSize == other.m_fileSize &&
+                m_modificationTime == other.m_modificationTime && m_stateTableHash == other.m_stateTableHash;
+        }
+    };
+
+    // A cached utterance: its key, number of frames and label ranges.
+    struct MLFCacheUtterance
+    {
+        uint64_t m_firstRange;      // index of the first label range of the utterance
+        uint64_t m_keyOffset;       // offset of the key in the key section
+        uint32_t m_numberOfRanges;  // 0 if the utterance could not be parsed
+        uint32_t m_numberOfSamples;
+        uint32_t m_keySize;
+        uint32_t m_reserved;
+    };
+
+    // Label ranges are stored (and memory mapped) as is.
+    static_assert(std::is_trivially_copyable<MLFFrameRange>::value && sizeof(MLFFrameRange) == 12 && sizeof(MLFCacheUtterance) % alignof(MLFFrameRange) == 0,
+        "Unexpected layout of MLFFrameRange.");
+
+    static const uint64_t s_mlfCacheMagic = 0x65686361635f6b74U; // "tk_cache"
+    static const uint32_t s_mlfCacheVersion = 1;
+
+    // FNV-1a hash of the state names in the order of their ids, 0 if there is no state list.
+    static uint64_t GetStateTableHash(const StateTablePtr& states)
+    {
+        if (!states)
+            return 0;
+
+        vector<const string*> names(states->States().size());
+        for (const auto& state : states->States())
+            names[state.second] = &state.first;
+
+        uint64_t hash = 14695981039346656037U;
+        for (const auto& name : names)
+        {
+            for (char c : *name + '\n')
+                hash = (hash ^ (unsigned char)c) * 1099511628211U;
+        }
+        return hash;
+    }
+
+    bool MLFIndexer::TryLoadFromCache(CorpusDescriptorPtr corpus, const wstring& filename, const wstring& cacheFilename, const StateTablePtr& states)
+    {
+        if (!m_index.IsEmpty() || !fexists(cacheFilename))
+            return false;
+
+        MLFCacheHeader expected = {};
+        expected.m_magic = s_mlfCacheMagic;
+        expected.m_version = s_mlfCacheVersion;
+        expected.m_stateTableHash = GetStateTableHash(states);
+        if (!GetFileSizeAndModificationTime(filename, expected.m_fileSize, expected.m_modificationTime))
+            return false;
+
+        // An empty file cannot be memory mapped.
+        uint64_t cacheSize;
+        int64_t cacheModificationTime;
+        if (!GetFileSizeAndModificationTime(cacheFilename, cacheSize, cacheModificationTime) || cacheSize < sizeof(MLFCacheHeader))
+            return false;
+
+        auto cache = make_shared<MemoryMappedFile>(cacheFilename);
+        if (cache->Size() < sizeof(MLFCacheHeader))
+            return false;
+
+        const auto& header = *reinterpret_cast<const MLFCacheHeader*>(cache->Data());
+        size_t rangesOffset = sizeof(MLFCacheHeader) + header.m_numberOfUtterances * sizeof(MLFCacheUtterance);
+        size_t keysOffset = rangesOffset + header.m_numberOfRanges * sizeof(MLFFrameRange);
+        if (!(header == expected) || header.m_numberOfUtterances > cache->Size() || header.m_numberOfRanges > cache->Size() ||
+            header.m_keysSize > cache->Size() || cache->Size() != keysOffset + header.m_keysSize)
+            return false;
+
+        // A corrupted cache must not make us read outside of the mapping.
+        const auto* utterances = reinterpret_cast<const MLFCacheUtterance*>(cache->Data() + sizeof(MLFCacheHeader));
+        for (uint64_t i = 0; i < header.m_numberOfUtterances; ++i)
+        {
+            const auto& u = utterances[i];
+            if (u.m_firstRange > header.m_numberOfRanges || u.m_numberOfRanges > header.m_numberOfRanges - u.m_firstRange ||
+                u.m_keyOffset > header.m_keysSize || u.m_keySize > header.m_keysSize - u.m_keyOffset)
+                return false;
+        }
+
+        m_index.Reserve(header.m_numberOfRanges * sizeof(MLFFrameRange));
+
+        // Replaying the utterances maps the keys to ids and rebuilds the chunks for the current chunk size.
+        const char* keys = cache->Data() + keysOffset;
+        for (uint64_t i = 0; i < header.m_numberOfUtterances; ++i)
+        {
+            const auto& u = utterances[i];
+            size_t id = corpus->KeyToId(string(keys + u.m_keyOffset, u.m_keySize));
+            size_t offset = rangesOffset + u.m_firstRange * sizeof(MLFFrameRange);
+            m_index.AddSequence(SequenceDescriptor{ KeyType{ id, 0 }, u.m_numberOfSamples }, offset, offset + u.m_numberOfRanges * sizeof(MLFFrameRange));
+        }
+
+        m_cache = cache;
+        m_fileOffsetStart = header.m_fileSize;
+        m_done = true;
         return true;
     }
+
+    void MLFIndexer::SaveToCache(const wstring& filename, const wstring& cacheFilename, const StateTablePtr& states, size_t numThreads) const
+    {
+        if (m_index.IsEmpty() || m_cache)
+            return;
+
+        MLFCacheHeader header = {};
+        header.m_magic = s_mlfCacheMagic;
+        header.m_version = s_mlfCacheVersion;
+        header.m_stateTableHash = GetStateTableHash(states);
+        if (!GetFileSizeAndModificationTime(filename, header.m_fileSize, header.m_modificationTime))
+            RuntimeError("Could not retrieve the size and modification time of the MLF file '%ls'.", filename.c_str());
+
+        vector<const SequenceDescriptor*> sequences;
+        vector<size_t> sequenceOffsets;
+        for (const auto& chunk : m_index.m_chunks)
+        {
+            for (const auto& sequence : chunk.m_sequences)
+            {
+                sequences.push_back(&sequence);
+                sequenceOffsets.push_back(chunk.m_offset + sequence.OffsetInChunk());
+            }
+        }
+
+        // Parse all utterances.
+        MemoryMappedFile file(filename);
+        MLFUtteranceParser parser(states);
+        vector<vector<MLFFrameRange>> ranges(sequences.size());
+        vector<string> keys(sequences.size());
+        ExceptionCapture capture;
+#pragma omp parallel for schedule(dynamic) num_threads((int)max<size_t>(numThreads, 1))
+        for (int i = 0; i < (int)sequences.size(); ++i)
+        {
+            capture.SafeRun([&](int j)
+            {
+                auto begin = const_cast<char*>(file.Data()) + sequenceOffsets[j];
+                auto end = begin + sequences[j]->SizeInBytes();
+                if (!TryParseSequenceKey(begin, begin + FindLineEnd(begin, end - begin, 0), keys[j]))
+                    LogicError("Indexed MLF utterance at offset %" PRIu64 " does not start with a valid key.", (uint64_t)sequenceOffsets[j]);
+
+                if (!parser.Parse(boost::make_iterator_range(begin, end), ranges[j], sequenceOffsets[j]))
+                    ranges[j].clear(); // Cannot be parsed, stays invalid.
+            }, i);
+        }
+        capture.RethrowIfHappened();
+
+        header.m_numberOfUtterances = sequences.size();
+        vector<MLFCacheUtterance> utterances(sequences.size());
+        for (size_t i = 0; i < sequences.size(); ++i)
+        {
+            utterances[i] = MLFCacheUtterance{ header.m_numberOfRanges, header.m_keysSize, (uint32_t)ranges[i].size(), sequences[i]->m_numberOfSamples, (uint32_t)keys[i].size(), 0 };
+            header.m_numberOfRanges += ranges[i].size();
+            header.m_keysSize += keys[i].size();
+        }
+
+        // Write into a temporary file first, so that a concurrently starting job never sees a partial cache.
+        wstring tempFilename = cacheFilename + L".tmp";
+        FILE* f = fopenOrDie(tempFilename, L"wbS");
+        fwriteOrDie(&header, sizeof(header), 1, f);
+        if (!utterances.empty())
+            fwriteOrDie(utterances.data(), sizeof(MLFCacheUtterance), utterances.size(), f);
+        for (const auto& r : ranges)
+        {
+            if (!r.empty())
+                fwriteOrDie(r.data(), sizeof(MLFFrameRange), r.size(), f);
+        }
+        for (const auto& k : keys)
+        {
+            if (!k.empty())
+                fwriteOrDie(k.data(), 1, k.size(), f);
+        }
+
+        fcloseOrDie(f);
+        renameOrDie(tempFilename, cacheFilename);
+    }
 }}}
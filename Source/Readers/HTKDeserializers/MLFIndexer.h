@@ -9,6 +9,8 @@
 #include <boost/noncopyable.hpp>
 
 #include "Indexer.h"
+#include "MemoryMappedFile.h"
+#include "MLFUtils.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -19,9 +21,34 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         void Build(CorpusDescriptorPtr corpus);
 
+        // Same as Build, but splits the (memory mapped) MLF file into byte ranges of at least
+        // minRangeSize bytes, which are scanned by numThreads threads concurrently.
+        // Each range is resynchronized after the first end of utterance ("." line) inside it.
+        // The resulting index is identical to the one produced by Build.
+        void BuildInParallel(CorpusDescriptorPtr corpus, const std::wstring& filename, size_t numThreads,
+                             size_t minRangeSize = 16 * 1024 * 1024);
+
+        // Tries to restore the index from the binary cache file previously written by SaveToCache.
+        // The cache is only accepted if it was created for the MLF file of the same size and modification time
+        // with the same state list. Returns false if there's no usable cache.
+        // On success the cache stays memory mapped (see GetCache()), and the offsets of the index refer to
+        // the parsed label ranges of the utterances in the cache rather than to the MLF file.
+        bool TryLoadFromCache(CorpusDescriptorPtr corpus, const std::wstring& filename, const std::wstring& cacheFilename, const StateTablePtr& states);
+
+        // Parses all utterances of the index (on numThreads threads) and persists their keys and label ranges
+        // (state ids and frame boundaries) into the cache file, so that subsequent runs can skip both indexing and parsing.
+        void SaveToCache(const std::wstring& filename, const std::wstring& cacheFilename, const StateTablePtr& states, size_t numThreads) const;
+
         // Returns input data index (chunk and sequence metadata)
         const Index& GetIndex() const { return m_index; }
 
+        // Returns the memory mapped cache the index was loaded from, nullptr if the index was built from the MLF file.
+        const MemoryMappedFilePtr& GetCache() const { return m_cache; }
+
+        // Parses the sequence key from the key line of an utterance.
+        // In MLF a sequence key should be in quotes. During parsing the extension is removed.
+        static bool TryParseSequenceKey(const char* begin, const char* end, std::string& key);
+
     private:
         enum class State
         {
@@ -42,6 +69,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         std::string m_lastNonEmptyLine;           // Last non empty estring, used for parsing sequence length.
 
+        MemoryMappedFilePtr m_cache;              // Cache the index was loaded from, if any.
+
         // fills up the buffer with data from file, all previously buffered data
         // will be overwritten.
         void RefillBuffer();
@@ -24,7 +24,10 @@ public:
     virtual ~ByteReader() = default;
 
     virtual void Register(const MultiMap& sequences) = 0;
-    virtual cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) = 0;
+
+    // Reads and decodes the image. If decodeMinSide is not 0, JPEG images may be decoded at a reduced
+    // resolution, as long as their smaller side stays at least decodeMinSide pixels (see GetImageDecodeFlags).
+    virtual cv::Mat Read(size_t seqId, const std::string& path, bool grayscale, size_t decodeMinSide) = 0;
 
     DISABLE_COPY_AND_MOVE(ByteReader);
 };
@@ -36,7 +39,7 @@ public:
     {}
 
     void Register(const MultiMap&) override {}
-    cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) override;
+    cv::Mat Read(size_t seqId, const std::string& path, bool grayscale, size_t decodeMinSide) override;
 
     std::string m_expandDirectory;
 };
@@ -48,7 +51,7 @@ public:
     ZipByteReader(const std::string& zipPath);
 
     void Register(const std::map<std::string, std::vector<size_t>>& sequences) override;
-    cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) override;
+    cv::Mat Read(size_t seqId, const std::string& path, bool grayscale, size_t decodeMinSide) override;
 
 private:
     using ZipPtr = std::unique_ptr<zip_t, void(*)(zip_t*)>;
@@ -0,0 +1,283 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <algorithm>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "DecodedImageCache.h"
+#include "TimerUtility.h"
+#include "StringUtil.h"
+#include "fileutil.h"
+#include "ReaderUtil.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Header of an image in the disk cache, followed by the image key and the pixels.
+struct DecodedImageHeader
+{
+    uint32_t m_magic;
+    int32_t m_rows;
+    int32_t m_cols;
+    int32_t m_type;
+    uint32_t m_keySize;
+};
+
+static const uint32_t s_decodedImageMagic = 0x31474d49; // "IMG1"
+
+static size_t SizeInBytes(const cv::Mat& image)
+{
+    return image.total() * image.elemSize();
+}
+
+DecodedImageCache::DecodedImageCache(size_t maxMemoryBytes, const std::string& directory, size_t maxDiskBytes)
+    : m_memoryBytes(0),
+      m_maxMemoryBytes(maxMemoryBytes),
+      m_directory(directory),
+      m_diskBytes(0),
+      m_maxDiskBytes(maxDiskBytes),
+      m_tempFileCounter(0),
+      m_memoryHits(0),
+      m_diskHits(0),
+      m_misses(0),
+      m_decodeMicroseconds(0),
+      m_diskReadMicroseconds(0)
+{
+    if (!m_directory.empty())
+    {
+        msra::files::make_intermediate_dirs(msra::strfun::utf16(DiskFileName("")));
+        LoadDiskFiles();
+    }
+}
+
+// Accounts for the images already in the directory, the oldest ones are the first to be evicted.
+void DecodedImageCache::LoadDiskFiles()
+{
+    std::vector<std::pair<int64_t, std::string>> files;
+    for (const auto& name : msra::files::get_all_files_from_directory(msra::strfun::utf16(m_directory)))
+    {
+        auto fileName = m_directory + "/" + msra::strfun::utf8(name);
+        uint64_t size;
+        int64_t modificationTime;
+        if (fileName.size() > 4 && fileName.compare(fileName.size() - 4, 4, ".img") == 0 &&
+            GetFileSizeAndModificationTime(msra::strfun::utf16(fileName), size, modificationTime))
+        {
+            files.push_back(std::make_pair(modificationTime, fileName));
+            m_diskFiles[fileName].first = size;
+        }
+    }
+
+    std::sort(files.begin(), files.end());
+    for (const auto& file : files)
+    {
+        m_diskLru.push_front(file.second);
+        m_diskFiles[file.second].second = m_diskLru.begin();
+        m_diskBytes += m_diskFiles[file.second].first;
+    }
+
+    std::lock_guard<std::mutex> lock(m_diskLock);
+    EvictFromDisk(0);
+}
+
+// Deletes the least recently used images until another 'size' bytes fit into the disk budget.
+// Must be called with m_diskLock held.
+void DecodedImageCache::EvictFromDisk(size_t size)
+{
+    while (m_diskBytes + size > m_maxDiskBytes && !m_diskLru.empty())
+    {
+        auto evicted = m_diskFiles.find(m_diskLru.back());
+        m_diskBytes -= evicted->second.first;
+        remove(evicted->first.c_str());
+        m_diskFiles.erase(evicted);
+        m_diskLru.pop_back();
+    }
+}
+
+bool DecodedImageCache::TryGet(size_t sequenceId, const std::string& imageKey, cv::Mat& image)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto found = m_images.find(sequenceId);
+        if (found != m_images.end())
+        {
+            m_lru.splice(m_lru.begin(), m_lru, found->second.second);
+            image = found->second.first.clone();
+            m_memoryHits++;
+            return true;
+        }
+    }
+
+    if (m_directory.empty())
+        return false;
+
+    Timer timer;
+    timer.Start();
+    if (!TryReadFromDisk(imageKey, image))
+        return false;
+    timer.Stop();
+
+    m_diskReadMicroseconds += static_cast<uint64_t>(timer.ElapsedSeconds() * 1e6);
+    m_diskHits++;
+
+    AddToMemory(sequenceId, image);
+    return true;
+}
+
+void DecodedImageCache::Add(size_t sequenceId, const std::string& imageKey, const cv::Mat& image, double decodeSeconds)
+{
+    m_misses++;
+    m_decodeMicroseconds += static_cast<uint64_t>(decodeSeconds * 1e6);
+
+    if (!image.data)
+        return;
+
+    AddToMemory(sequenceId, image);
+
+    if (!m_directory.empty())
+        WriteToDisk(imageKey, image);
+}
+
+void DecodedImageCache::AddToMemory(size_t sequenceId, const cv::Mat& image)
+{
+    size_t size = SizeInBytes(image);
+    if (size > m_maxMemoryBytes)
+        return;
+
+    // The copy is made outside of the lock.
+    cv::Mat copy = image.clone();
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_images.find(sequenceId) != m_images.end())
+        return; // Has been added by another thread in the meantime.
+
+    // Evicting least recently used images.
+    while (m_memoryBytes + size > m_maxMemoryBytes && !m_lru.empty())
+    {
+        auto evicted = m_images.find(m_lru.back());
+        m_memoryBytes -= SizeInBytes(evicted->second.first);
+        m_images.erase(evicted);
+        m_lru.pop_back();
+    }
+
+    m_lru.push_front(sequenceId);
+    m_images.insert(std::make_pair(sequenceId, std::make_pair(copy, m_lru.begin())));
+    m_memoryBytes += size;
+}
+
+// The name of the file is derived from the image key (the path of the original image and the decoding options);
+// the key itself is stored in the file to detect collisions.
+std::string DecodedImageCache::DiskFileName(const std::string& imageKey) const
+{
+    uint64_t hash = 14695981039346656037U;
+    for (char c : imageKey)
+        hash = (hash ^ (unsigned char)c) * 1099511628211U;
+
+    char name[32];
+    sprintf(name, "%016" PRIx64 ".img", hash);
+    return m_directory + "/" + name;
+}
+
+bool DecodedImageCache::TryReadFromDisk(const std::string& imageKey, cv::Mat& image)
+{
+    auto fileName = DiskFileName(imageKey);
+    auto f = std::shared_ptr<FILE>(fopen(fileName.c_str(), "rb"), [](FILE* f) { if (f) fclose(f); });
+    if (!f)
+        return false;
+
+    DecodedImageHeader header;
+    if (fread(&header, sizeof(header), 1, f.get()) != 1 || header.m_magic != s_decodedImageMagic || header.m_keySize != imageKey.size())
+        return false;
+
+    std::string storedKey(header.m_keySize, '\0');
+    if (!storedKey.empty() && fread(&storedKey[0], 1, storedKey.size(), f.get()) != storedKey.size())
+        return false;
+
+    if (storedKey != imageKey)
+        return false;
+
+    cv::Mat result(header.m_rows, header.m_cols, header.m_type);
+    size_t size = SizeInBytes(result);
+    if (fread(result.data, 1, size, f.get()) != size)
+        return false;
+
+    image = result;
+
+    std::lock_guard<std::mutex> lock(m_diskLock);
+    auto found = m_diskFiles.find(fileName);
+    if (found != m_diskFiles.end())
+        m_diskLru.splice(m_diskLru.begin(), m_diskLru, found->second.second);
+    return true;
+}
+
+// Failures to write into the disk cache are not fatal, the image is simply decoded again next time.
+void DecodedImageCache::WriteToDisk(const std::string& imageKey, const cv::Mat& image)
+{
+    auto fileName = DiskFileName(imageKey);
+    if (fexists(fileName))
+        return;
+
+    cv::Mat data = image.isContinuous() ? image : image.clone();
+    size_t size = SizeInBytes(data);
+    size_t total = sizeof(DecodedImageHeader) + imageKey.size() + size;
+    if (total > m_maxDiskBytes)
+        return;
+
+    // Making room for the image; the space is reserved before the file is written.
+    {
+        std::lock_guard<std::mutex> lock(m_diskLock);
+        if (m_diskFiles.find(fileName) != m_diskFiles.end())
+            return; // Is being written by another thread.
+
+        EvictFromDisk(total);
+        m_diskLru.push_front(fileName);
+        m_diskFiles[fileName] = std::make_pair(total, m_diskLru.begin());
+        m_diskBytes += total;
+    }
+
+    // Writing into a temporary file first, so that readers never see a partial image.
+    auto tempFileName = fileName + "." + std::to_string(m_tempFileCounter++) + ".tmp";
+    bool written = false;
+    FILE* f = fopen(tempFileName.c_str(), "wb");
+    if (f)
+    {
+        DecodedImageHeader header = { s_decodedImageMagic, data.rows, data.cols, data.type(), static_cast<uint32_t>(imageKey.size()) };
+        written = fwrite(&header, sizeof(header), 1, f) == 1 &&
+                  fwrite(imageKey.data(), 1, imageKey.size(), f) == imageKey.size() &&
+                  fwrite(data.data, 1, size, f) == size;
+        written = fclose(f) == 0 && written;
+        written = written && rename(tempFileName.c_str(), fileName.c_str()) == 0;
+        if (!written)
+            remove(tempFileName.c_str());
+    }
+
+    if (written)
+        return;
+
+    // Releasing the space reserved for the image, unless it has been evicted in the meantime.
+    std::lock_guard<std::mutex> lock(m_diskLock);
+    auto reserved = m_diskFiles.find(fileName);
+    if (reserved != m_diskFiles.end())
+    {
+        m_diskBytes -= reserved->second.first;
+        m_diskLru.erase(reserved->second.second);
+        m_diskFiles.erase(reserved);
+    }
+}
+
+void DecodedImageCache::PrintStatistics() const
+{
+    size_t hits = m_memoryHits + m_diskHits;
+    double averageDecodeSeconds = m_misses ? m_decodeMicroseconds / 1e6 / m_misses : 0;
+    double savedSeconds = hits * averageDecodeSeconds - m_diskReadMicroseconds / 1e6;
+
+    fprintf(stderr, "DecodedImageCache: %" PRIu64 " memory hits, %" PRIu64 " disk hits, %" PRIu64 " decoded images "
+        "(%.3g seconds decoding, %.3g ms per image), estimated %.3g seconds of decoding saved\n",
+        (uint64_t)m_memoryHits, (uint64_t)m_diskHits, (uint64_t)m_misses.load(),
+        m_decodeMicroseconds / 1e6, averageDecodeSeconds * 1e3, std::max(savedSeconds, 0.0));
+}
+
+}}}
@@ -0,0 +1,76 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Cache of decoded images shared across epochs, so that an image is decoded only once
+// as long as it fits into the memory budget.
+// Images are kept in memory in the LRU order; optionally, decoded images are also written
+// as raw pixels into a directory, which serves the images evicted from memory (and later runs).
+// On disk images are identified by a key, which should include the path of the original image and
+// the decoding options. The disk budget covers the images found in the directory on construction
+// (e.g. written by earlier runs) as well as the ones written since; when it is exceeded, the least recently
+// used images are deleted, starting with the oldest files found on construction.
+// All methods are thread safe.
+class DecodedImageCache
+{
+public:
+    DecodedImageCache(size_t maxMemoryBytes, const std::string& directory, size_t maxDiskBytes);
+
+    // Retrieves a copy of the cached image, so that transforms are free to modify it in place.
+    bool TryGet(size_t sequenceId, const std::string& imageKey, cv::Mat& image);
+
+    // Adds a copy of the decoded image that took decodeSeconds to read and decode.
+    void Add(size_t sequenceId, const std::string& imageKey, const cv::Mat& image, double decodeSeconds);
+
+    // Prints the hit counts and the estimated decode time saved.
+    void PrintStatistics() const;
+
+private:
+    bool TryReadFromDisk(const std::string& imageKey, cv::Mat& image);
+    void WriteToDisk(const std::string& imageKey, const cv::Mat& image);
+    std::string DiskFileName(const std::string& imageKey) const;
+
+    void LoadDiskFiles();
+    void EvictFromDisk(size_t size);
+
+    void AddToMemory(size_t sequenceId, const cv::Mat& image);
+
+    std::mutex m_lock;
+
+    // Sequence ids in the order of use, most recently used first.
+    std::list<size_t> m_lru;
+    std::unordered_map<size_t, std::pair<cv::Mat, std::list<size_t>::iterator>> m_images;
+    size_t m_memoryBytes;
+    const size_t m_maxMemoryBytes;
+
+    const std::string m_directory;
+    std::mutex m_diskLock;
+
+    // Files in the directory in the order of use, most recently used first, with their sizes.
+    std::list<std::string> m_diskLru;
+    std::unordered_map<std::string, std::pair<size_t, std::list<std::string>::iterator>> m_diskFiles;
+    size_t m_diskBytes;
+    const size_t m_maxDiskBytes;
+    std::atomic<size_t> m_tempFileCounter;
+
+    // Statistics.
+    std::atomic<size_t> m_memoryHits;
+    std::atomic<size_t> m_diskHits;
+    std::atomic<size_t> m_misses;
+    std::atomic<uint64_t> m_decodeMicroseconds;   // Time spent decoding the missed images.
+    std::atomic<uint64_t> m_diskReadMicroseconds; // Time spent reading the images from the disk cache.
+};
+
+}}}
@@ -61,6 +61,7 @@ private:
 // that allows composition of deserializers and transforms on inputs.
 ImageDataDeserializer::ImageDataDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary) : ImageDeserializerBase(corpus, config, primary)
 {
+    InitializeDecoding(config);
     CreateSequenceDescriptions(corpus, config(L"file"), m_labelGenerator->LabelDimension(), m_multiViewCrop);
 }
 
@@ -76,6 +77,7 @@ ImageDataDeserializer::ImageDataDeserializer(const ConfigParameters& config)
     const auto& feature = m_streams[configHelper.GetFeatureStreamId()];
 
     m_verbosity = config(L"verbosity", 0);
+    InitializeDecoding(config);
 
     string precision = (ConfigValue)config("precision", "float");
     m_precision = AreEqualIgnoreCase(precision, "float") ? ElementType::tfloat : ElementType::tdouble;
@@ -108,6 +110,25 @@ ImageDataDeserializer::ImageDataDeserializer(const ConfigParameters& config)
     CreateSequenceDescriptions(std::make_shared<CorpusDescriptor>(false), configHelper.GetMapPath(), labelDimension, configHelper.IsMultiViewCrop());
 }
 
+ImageDataDeserializer::~ImageDataDeserializer()
+{
+    if (m_imageCache)
+        m_imageCache->PrintStatistics();
+}
+
+void ImageDataDeserializer::InitializeDecoding(const ConfigParameters& config)
+{
+    // JPEG images can be decoded at 1/2, 1/4 or 1/8 of their resolution, if the following
+    // transforms do not need more than decodeMinSide pixels for the smaller side of the image.
+    m_decodeMinSide = config(L"decodeMinSide", (size_t)0);
+
+    size_t cacheSizeInMB = config(L"imageCacheSizeInMB", (size_t)0);
+    string cacheDirectory = (ConfigValue)config("imageCacheDirectory", "");
+    size_t cacheDiskSizeInMB = config(L"imageCacheDiskSizeInMB", (size_t)10240);
+    if (cacheSizeInMB > 0 || !cacheDirectory.empty())
+        m_imageCache = make_unique<DecodedImageCache>(cacheSizeInMB * 1024 * 1024, cacheDirectory, cacheDiskSizeInMB * 1024 * 1024);
+}
+
 // Descriptions of chunks exposed by the image reader.
 ChunkDescriptions ImageDataDeserializer::GetChunkDescriptions()
 {
@@ -286,18 +307,54 @@ cv::Mat ImageDataDeserializer::ReadImage(size_t seqId, const std::string& path,
 {
     assert(!path.empty());
 
+    if (!m_imageCache)
+        return DecodeImage(seqId, path, grayscale);
+
+    // Images with several copies (multi view) or read in every epoch are decoded only once.
+    auto imageKey = path + "|" + std::to_string(grayscale) + "|" + std::to_string(m_decodeMinSide);
+    cv::Mat image;
+    if (m_imageCache->TryGet(seqId, imageKey, image))
+        return image;
+
+    Timer timer;
+    timer.Start();
+    image = DecodeImage(seqId, path, grayscale);
+    timer.Stop();
+
+    m_imageCache->Add(seqId, imageKey, image, timer.ElapsedSeconds());
+    return image;
+}
+
+cv::Mat ImageDataDeserializer::DecodeImage(size_t seqId, const std::string& path, bool grayscale)
+{
     ImageDataDeserializer::SeqReaderMap::const_iterator r;
     if (m_readers.empty() || (r = m_readers.find(seqId)) == m_readers.end())
-        return m_defaultReader->Read(seqId, path, grayscale);
-    return (*r).second->Read(seqId, path, grayscale);
+        return m_defaultReader->Read(seqId, path, grayscale, m_decodeMinSide);
+    return (*r).second->Read(seqId, path, grayscale, m_decodeMinSide);
 }
 
-cv::Mat FileByteReader::Read(size_t, const std::string& seqPath, bool grayscale)
+cv::Mat FileByteReader::Read(size_t, const std::string& seqPath, bool grayscale, size_t decodeMinSide)
 {
     assert(!seqPath.empty());
     auto path = Expand3Dots(seqPath, m_expandDirectory);
 
-    return cv::imread(path, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+    if (decodeMinSide == 0)
+        return cv::imread(path, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+
+    // The decoding flags depend on the header of the image, so reading the file ourselves.
+    auto f = std::shared_ptr<FILE>(fopen(path.c_str(), "rb"), [](FILE* f) { if (f) fclose(f); });
+    if (!f)
+        return cv::Mat();
+
+    std::vector<unsigned char> contents;
+    unsigned char buffer[64 * 1024];
+    for (size_t read; (read = fread(buffer, 1, sizeof(buffer), f.get())) > 0;)
+        contents.insert(contents.end(), buffer, buffer + read);
+
+    if (contents.empty())
+        return cv::Mat();
+
+    return cv::imdecode(contents, GetImageDecodeFlags(contents.data(), contents.size(), grayscale, decodeMinSide));
 }
 
 bool ImageDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
@@ -10,6 +10,7 @@
 #include "ByteReader.h"
 #include <unordered_map>
 #include "CorpusDescriptor.h"
+#include "DecodedImageCache.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -28,6 +29,8 @@ public:
     // TODO: This constructor should be deprecated in the future. Compositional config should be used instead.
     explicit ImageDataDeserializer(const ConfigParameters& config);
 
+    ~ImageDataDeserializer();
+
     // Gets sequences by specified ids. Order of returned sequences corresponds to the order of provided ids.
     virtual ChunkPtr GetChunk(ChunkIdType chunkId) override;
 
@@ -44,6 +47,9 @@ private:
     // Creates a set of sequence descriptions.
     void CreateSequenceDescriptions(CorpusDescriptorPtr corpus, std::string mapPath, size_t labelDimension, bool isMultiCrop);
 
+    // Reads the options for decoding and caching of images.
+    void InitializeDecoding(const ConfigParameters& config);
+
     // Image sequence descriptions. Currently, a sequence contains a single sample only.
     struct ImageSequenceDescription : public SequenceDescription
     {
@@ -62,12 +68,19 @@ private:
     using ReaderSequenceMap = std::map<std::string, std::map<std::string, std::vector<size_t>>>;
     void RegisterByteReader(size_t seqId, const std::string& path, PathReaderMap& knownReaders, ReaderSequenceMap& readerSequences, const std::string& expandDirectory);
     cv::Mat ReadImage(size_t seqId, const std::string& path, bool grayscale);
+    cv::Mat DecodeImage(size_t seqId, const std::string& path, bool grayscale);
 
     // REVIEW alexeyk: can potentially use vector instead of map. Need to handle default reader and resizing though.
     using SeqReaderMap = std::unordered_map<size_t, std::shared_ptr<ByteReader>>;
     SeqReaderMap m_readers;
 
     std::unique_ptr<FileByteReader> m_defaultReader;
+
+    // Minimal size of the smaller side of decoded JPEG images, 0 to always decode at the full resolution.
+    size_t m_decodeMinSide;
+
+    // Cache of decoded images, null if disabled.
+    std::unique_ptr<DecodedImageCache> m_imageCache;
 };
 
 }}}
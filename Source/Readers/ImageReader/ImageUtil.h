@@ -52,6 +52,70 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         return resultType;
     }
 
+    // Reads the dimensions of a JPEG image from its frame header, without decoding it.
+    inline bool TryGetJpegSize(const unsigned char* data, size_t size, int& width, int& height)
+    {
+        if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+            return false;
+
+        size_t pos = 2;
+        while (pos + 4 <= size)
+        {
+            if (data[pos] != 0xFF)
+                return false;
+
+            unsigned char marker = data[pos + 1];
+            if (marker == 0xFF) // Fill byte.
+            {
+                pos++;
+                continue;
+            }
+
+            // Markers without a segment.
+            if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8))
+            {
+                pos += 2;
+                continue;
+            }
+
+            if (marker == 0xD9 || marker == 0xDA) // End of image or start of scan before a frame header.
+                return false;
+
+            size_t length = (data[pos + 2] << 8) | data[pos + 3];
+            // Start of frame markers, except for DHT (C4), JPG (C8) and DAC (CC).
+            if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+            {
+                if (pos + 9 > size)
+                    return false;
+                height = (data[pos + 5] << 8) | data[pos + 6];
+                width = (data[pos + 7] << 8) | data[pos + 8];
+                return width > 0 && height > 0;
+            }
+
+            pos += 2 + length;
+        }
+        return false;
+    }
+
+    // Returns the OpenCV flags for decoding the encoded image. If minSide is not 0 and the image is a JPEG,
+    // it is decoded at the largest reduced DCT scale (1/2, 1/4 or 1/8) that keeps its smaller side at least minSide,
+    // which is several times faster than decoding the full resolution image and scaling it down afterwards.
+    inline int GetImageDecodeFlags(const unsigned char* data, size_t size, bool grayscale, size_t minSide)
+    {
+        int width = 0, height = 0;
+        if (minSide > 0 && TryGetJpegSize(data, size, width, height))
+        {
+            size_t side = static_cast<size_t>(std::min(width, height));
+            if (side >= 8 * minSide)
+                return grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8;
+            if (side >= 4 * minSide)
+                return grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4;
+            if (side >= 2 * minSide)
+                return grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2;
+        }
+        return grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
+    }
+
     // A helper interface to generate a typed label in a sparse format for categories.
     // It is represented as an array indexed by the category, containing zero values for all categories the sequence does not belong to,
     // and a single one for a category it belongs to: [ 0 .. 0.. 1 .. 0 ]
@@ -6,7 +6,11 @@
 #define __STDC_FORMAT_MACROS
 #define _CRT_SECURE_NO_WARNINGS
 #include <inttypes.h>
+#include <algorithm>
 #include "Indexer.h"
+#include "MemoryMappedFile.h"
+#include "ExceptionCapture.h"
+#include "ReaderUtil.h"
 
 using std::string;
 
@@ -26,6 +30,7 @@ Indexer::Indexer(FILE* file, bool primary, bool skipSequenceIds, char streamPref
     m_pos(nullptr),
     m_done(false),
     m_hasSequenceIds(!skipSequenceIds),
+    m_skipSequenceIds(skipSequenceIds),
     m_index(chunkSize, primary)
 {
     if (m_file == nullptr)
@@ -237,6 +242,361 @@ bool Indexer::TryGetSymbolicSequenceId(size_t& id, std::function<size_t(const st
     return false;
 }
 
+// Sequence boundaries found by a parallel indexing thread in its range of the input file.
+struct IndexedRange
+{
+    struct Sequence
+    {
+        size_t m_id;                  // numeric sequence id (or the line number in lines mode)
+        std::string m_key;            // symbolic sequence key, only when the corpus uses symbolic keys
+        uint32_t m_numberOfSamples;
+        size_t m_startOffset;         // offset of the first line of the sequence in the file
+    };
+
+    std::vector<Sequence> m_sequences;
+
+    // Number of lines without a sequence id that precede the first sequence in the range,
+    // they are continuation of the last sequence of the previous range.
+    uint32_t m_numberOfLeadingSamples = 0;
+};
+
+// Returns the offset of the first line that starts in [offset, size).
+static size_t FindLineStart(const char* data, size_t size, size_t offset, size_t firstLineOffset)
+{
+    if (offset <= firstLineOffset || data[offset - 1] == ROW_DELIMITER)
+        return std::max(offset, firstLineOffset);
+
+    auto newLine = (const char*)memchr(data + offset, ROW_DELIMITER, size - offset);
+    return newLine ? (newLine - data) + 1 : size;
+}
+
+// Mirrors Indexer::TryGetNumericSequenceId.
+static bool TryParseNumericSequenceId(const char* pos, const char* end, size_t& id)
+{
+    bool found = false;
+    id = 0;
+    for (; pos != end; ++pos)
+    {
+        char c = *pos;
+        if (!isdigit(c))
+            return found;
+
+        id = id * 10 + (c - '0');
+        found = true;
+    }
+
+    // reached EOF, see TryGetNumericSequenceId.
+    return false;
+}
+
+// Mirrors Indexer::TryGetSymbolicSequenceId, but returns the key instead of converting it to an id.
+static bool TryParseSymbolicSequenceKey(const char* pos, const char* end, std::string& key)
+{
+    const char* start = pos;
+    while (pos != end && !isspace(*pos))
+        ++pos;
+
+    if (pos == end || pos == start)
+        return false;
+
+    key.assign(start, pos);
+    return true;
+}
+
+// Scans all lines that start in [begin, end) of the input file.
+static void IndexRange(const char* data, size_t size, size_t begin, size_t end, size_t firstLineOffset,
+                       bool hasSequenceIds, bool numericKeys, IndexedRange& result)
+{
+    size_t pos = FindLineStart(data, size, begin, firstLineOffset);
+
+    bool inSequence = false;
+    IndexedRange::Sequence current{};
+    size_t id = 0;
+    std::string key;
+    while (pos < end)
+    {
+        auto newLine = (const char*)memchr(data + pos, ROW_DELIMITER, size - pos);
+        size_t nextLine = newLine ? (newLine - data) + 1 : size;
+
+        if (!hasSequenceIds)
+        {
+            // Every line is a sequence, the line number is assigned when the ranges are merged.
+            result.m_sequences.push_back(IndexedRange::Sequence{ 0, std::string(), 1, pos });
+            pos = nextLine;
+            continue;
+        }
+
+        bool found = numericKeys ?
+            TryParseNumericSequenceId(data + pos, data + size, id) :
+            TryParseSymbolicSequenceKey(data + pos, data + size, key);
+
+        if (found && (!inSequence || (numericKeys ? id != current.m_id : key != current.m_key)))
+        {
+            if (inSequence)
+                result.m_sequences.push_back(std::move(current));
+
+            current = IndexedRange::Sequence{ id, numericKeys ? std::string() : key, 0, pos };
+            inSequence = true;
+        }
+
+        if (inSequence)
+            current.m_numberOfSamples++;
+        else
+            result.m_numberOfLeadingSamples++;
+
+        pos = nextLine;
+    }
+
+    if (inSequence)
+        result.m_sequences.push_back(std::move(current));
+}
+
+void Indexer::BuildInParallel(CorpusDescriptorPtr corpus, const std::wstring& filename, size_t numThreads, size_t minRangeSize)
+{
+    if (!m_index.IsEmpty())
+    {
+        return;
+    }
+
+    size_t fileSize = filesize(m_file);
+    if (fileSize == 0)
+    {
+        RuntimeError("Input file is empty");
+    }
+
+    MemoryMappedFile file(filename);
+    const char* data = file.Data();
+    size_t size = std::min(file.Size(), fileSize);
+
+    m_index.Reserve(size);
+
+    // Skip UTF-8 BOM, same as Build.
+    size_t firstLineOffset = 0;
+    if (size > 3 && data[0] == '\xEF' && data[1] == '\xBB' && data[2] == '\xBF')
+        firstLineOffset = 3;
+
+    bool numericKeys = corpus->IsNumericSequenceKeys();
+    if (!m_hasSequenceIds || data[firstLineOffset] == m_streamPrefix)
+    {
+        if (!numericKeys)
+            RuntimeError("Corpus expects non-numeric sequence keys but the CTF input file does not have them.");
+
+        m_hasSequenceIds = false;
+    }
+
+    // A few ranges per thread balance the load when sequences are not uniformly distributed.
+    numThreads = std::max<size_t>(numThreads, 1);
+    size_t numRanges = std::min(numThreads * 4, std::max<size_t>(1, (size - firstLineOffset) / std::max<size_t>(minRangeSize, 1)));
+    size_t rangeSize = (size - firstLineOffset + numRanges - 1) / numRanges;
+
+    std::vector<IndexedRange> ranges(numRanges);
+    ExceptionCapture capture;
+#pragma omp parallel for schedule(dynamic) num_threads((int)numThreads)
+    for (int i = 0; i < (int)numRanges; ++i)
+    {
+        capture.SafeRun([&](int r)
+        {
+            size_t begin = firstLineOffset + r * rangeSize;
+            size_t end = std::min(size, begin + rangeSize);
+            IndexRange(data, size, begin, end, firstLineOffset, m_hasSequenceIds, numericKeys, ranges[r]);
+        }, i);
+    }
+    capture.RethrowIfHappened();
+
+    if (ranges.front().m_numberOfLeadingSamples > 0)
+    {
+        RuntimeError("Expected a sequence id at the offset %" PRIu64 ", none was found.", (uint64_t)firstLineOffset);
+    }
+
+    // Merge the ranges in file order, every sequence ends where the next one starts.
+    bool hasPending = false;
+    IndexedRange::Sequence pending{};
+    size_t lineNumber = 0;
+    auto addPending = [&](size_t endOffset)
+    {
+        size_t id = m_hasSequenceIds ? (numericKeys ? pending.m_id : corpus->KeyToId(pending.m_key)) : lineNumber++;
+        m_index.AddSequence(SequenceDescriptor{ KeyType{ id, 0 }, pending.m_numberOfSamples }, pending.m_startOffset, endOffset);
+    };
+
+    for (auto& range : ranges)
+    {
+        if (hasPending)
+            pending.m_numberOfSamples += range.m_numberOfLeadingSamples;
+
+        for (size_t i = 0; i < range.m_sequences.size(); ++i)
+        {
+            auto& sequence = range.m_sequences[i];
+            if (hasPending && i == 0 && m_hasSequenceIds &&
+                (numericKeys ? sequence.m_id == pending.m_id : sequence.m_key == pending.m_key))
+            {
+                // The same sequence continues across the range boundary.
+                pending.m_numberOfSamples += sequence.m_numberOfSamples;
+                continue;
+            }
+
+            if (hasPending)
+                addPending(sequence.m_startOffset);
+
+            pending = std::move(sequence);
+            hasPending = true;
+        }
+
+        range.m_sequences.clear();
+        range.m_sequences.shrink_to_fit();
+    }
+
+    if (hasPending)
+        addPending(size);
+
+    m_fileOffsetStart = m_fileOffsetEnd = size;
+}
+
+// Header of the index cache file. The cache is only valid for the input file
+// with the same size and modification time, indexed with the same parameters.
+struct IndexCacheHeader
+{
+    uint64_t m_magic;
+    uint32_t m_version;
+    uint32_t m_flags;
+    uint64_t m_fileSize;
+    int64_t m_modificationTime;
+    uint64_t m_numberOfSequences;
+
+    bool operator==(const IndexCacheHeader& other) const
+    {
+        return m_magic == other.m_magic && m_version == other.m_version && m_flags == other.m_flags &&
+            m_fileSize == other.m_fileSize && m_modificationTime == other.m_modificationTime;
+    }
+};
+
+// A cached sequence: its key, number of samples and location in the input file.
+struct IndexCacheEntry
+{
+    uint64_t m_key;
+    uint64_t m_offset;
+    uint32_t m_size;
+    uint32_t m_numberOfSamples;
+};
+
+static const uint64_t s_indexCacheMagic = 0x7865646e695f6b74U; // "tk_index"
+static const uint32_t s_indexCacheVersion = 1;
+enum IndexCacheFlags : uint32_t
+{
+    skipSequenceIds = 1,
+    hasSequenceIds = 2,
+};
+
+bool Indexer::TryLoadFromCache(CorpusDescriptorPtr corpus, const std::wstring& filename, const std::wstring& cacheFilename)
+{
+    if (!m_index.IsEmpty() || !corpus->IsNumericSequenceKeys() || !fexists(cacheFilename))
+        return false;
+
+    IndexCacheHeader expected = {};
+    expected.m_magic = s_indexCacheMagic;
+    expected.m_version = s_indexCacheVersion;
+    expected.m_flags = m_skipSequenceIds ? skipSequenceIds : 0;
+    uint64_t cacheSize;
+    int64_t cacheModificationTime;
+    if (!GetFileSizeAndModificationTime(filename, expected.m_fileSize, expected.m_modificationTime) ||
+        !GetFileSizeAndModificationTime(cacheFilename, cacheSize, cacheModificationTime) || cacheSize < sizeof(IndexCacheHeader))
+        return false;
+
+    // The cache is only an optimization: whatever is wrong with it, the input file is indexed instead.
+    FILE* f = _wfopen(cacheFilename.c_str(), L"rb");
+    if (f == nullptr)
+        return false;
+
+    IndexCacheHeader header = {};
+    bool valid = fread(&header, sizeof(header), 1, f) == 1;
+    // hasSequenceIds is the result of indexing, not its input.
+    bool cachedHasSequenceIds = (header.m_flags & hasSequenceIds) != 0;
+    header.m_flags &= ~hasSequenceIds;
+    uint64_t entriesSize = cacheSize - sizeof(IndexCacheHeader);
+    valid = valid && header == expected &&
+        entriesSize % sizeof(IndexCacheEntry) == 0 && header.m_numberOfSequences == entriesSize / sizeof(IndexCacheEntry);
+
+    if (valid)
+    {
+        try
+        {
+            m_index.Reserve(header.m_fileSize);
+
+            // Replaying the sequences rebuilds the chunks (and the key map) for the current chunk size.
+            // The sequences follow each other in the input file.
+            const size_t batchSize = 64 * 1024;
+            std::vector<IndexCacheEntry> entries(batchSize);
+            uint64_t previousEnd = 0;
+            for (uint64_t read = 0; valid && read < header.m_numberOfSequences;)
+            {
+                size_t count = (size_t)std::min<uint64_t>(batchSize, header.m_numberOfSequences - read);
+                valid = fread(entries.data(), sizeof(IndexCacheEntry), count, f) == count;
+                for (size_t i = 0; valid && i < count; ++i)
+                {
+                    const auto& e = entries[i];
+                    valid = e.m_offset >= previousEnd && e.m_offset + e.m_size <= header.m_fileSize;
+                    if (valid)
+                        m_index.AddSequence(SequenceDescriptor{ KeyType{ e.m_key, 0 }, e.m_numberOfSamples }, e.m_offset, e.m_offset + e.m_size);
+                    previousEnd = e.m_offset + e.m_size;
+                }
+                read += count;
+            }
+        }
+        catch (const std::exception&)
+        {
+            valid = false;
+        }
+    }
+    fclose(f);
+
+    if (!valid)
+    {
+        m_index.Clear();
+        return false;
+    }
+
+    m_hasSequenceIds = cachedHasSequenceIds;
+    m_fileOffsetStart = m_fileOffsetEnd = header.m_fileSize;
+    return true;
+}
+
+void Indexer::SaveToCache(CorpusDescriptorPtr corpus, const std::wstring& filename, const std::wstring& cacheFilename) const
+{
+    if (m_index.IsEmpty() || !corpus->IsNumericSequenceKeys())
+        return;
+
+    IndexCacheHeader header = {};
+    header.m_magic = s_indexCacheMagic;
+    header.m_version = s_indexCacheVersion;
+    header.m_flags = (m_skipSequenceIds ? skipSequenceIds : 0) | (m_hasSequenceIds ? hasSequenceIds : 0);
+    if (!GetFileSizeAndModificationTime(filename, header.m_fileSize, header.m_modificationTime))
+        RuntimeError("Could not retrieve the size and modification time of the input file '%ls'.", filename.c_str());
+
+    for (const auto& chunk : m_index.m_chunks)
+        header.m_numberOfSequences += chunk.m_sequences.size();
+
+    // Write into a temporary file first, so that a concurrently starting job never sees a partial cache.
+    std::wstring tempFilename = cacheFilename + L".tmp";
+    FILE* f = fopenOrDie(tempFilename, L"wbS");
+    fwriteOrDie(&header, sizeof(header), 1, f);
+
+    std::vector<IndexCacheEntry> entries;
+    for (const auto& chunk : m_index.m_chunks)
+    {
+        entries.resize(chunk.m_sequences.size());
+        for (size_t i = 0; i < chunk.m_sequences.size(); ++i)
+        {
+            const auto& sequence = chunk.m_sequences[i];
+            entries[i] = IndexCacheEntry{ sequence.m_key.m_sequence, chunk.m_offset + sequence.OffsetInChunk(),
+                                          sequence.SizeInBytes(), sequence.m_numberOfSamples };
+        }
+        if (!entries.empty())
+            fwriteOrDie(entries.data(), sizeof(IndexCacheEntry), entries.size(), f);
+    }
+
+    fcloseOrDie(f);
+    renameOrDie(tempFilename, cacheFilename);
+}
+
 void Index::AddSequence(SequenceDescriptor&& sd, size_t startOffsetInFile, size_t endOffsetInFile)
 {
     sd.SetSize(endOffsetInFile - startOffsetInFile);
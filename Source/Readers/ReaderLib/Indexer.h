@@ -122,6 +122,13 @@ struct Index
         return m_chunks.empty();
     }
 
+    // Removes all chunks and sequences.
+    void Clear()
+    {
+        m_chunks.clear();
+        m_keyToSequenceInChunk.clear();
+    }
+
     DISABLE_COPY_AND_MOVE(Index);
 };
 
@@ -139,6 +146,25 @@ public:
     // sequences.
     void Build(CorpusDescriptorPtr corpus);
 
+    // Same as Build, but splits the (memory mapped) input file into byte ranges of at least
+    // minRangeSize bytes, which are scanned by numThreads threads concurrently.
+    // Each range is resynchronized on the first line that starts inside it, sequences that
+    // span several ranges are stitched together when the partial results are merged.
+    // The resulting index is identical to the one produced by Build.
+    void BuildInParallel(CorpusDescriptorPtr corpus, const std::wstring& filename, size_t numThreads,
+                         size_t minRangeSize = 16 * 1024 * 1024);
+
+    // Tries to restore the index from the cache file previously written by SaveToCache.
+    // The cache is only accepted if it was created for the input file of the same size and
+    // modification time with the same indexing parameters. Returns false, leaving the index empty,
+    // if there's no usable cache, also if the cache file is truncated or damaged.
+    bool TryLoadFromCache(CorpusDescriptorPtr corpus, const std::wstring& filename, const std::wstring& cacheFilename);
+
+    // Persists the sequence boundaries of the index into the cache file, so that
+    // subsequent runs can skip indexing altogether.
+    // Only numeric sequence keys can be cached, symbolic keys are mapped to ids by the corpus at runtime.
+    void SaveToCache(CorpusDescriptorPtr corpus, const std::wstring& filename, const std::wstring& cacheFilename) const;
+
     // Returns input data index (chunk and sequence metadata)
     const Index& GetIndex() const { return m_index; }
 
@@ -164,6 +190,8 @@ private:
     bool m_hasSequenceIds; // true, when input contains one sequence per line 
                            // or when sequence id column was ignored during indexing.
 
+    const bool m_skipSequenceIds; // value of the skipSequenceIds parameter, the index cache depends on it.
+
     // a collection of chunk descriptors and sequence keys.
     Index m_index;
 
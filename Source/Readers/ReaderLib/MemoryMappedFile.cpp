@@ -0,0 +1,154 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <algorithm>
+#include "MemoryMappedFile.h"
+#ifndef __WINDOWS__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef __WINDOWS__
+
+MemoryMappedFile::MemoryMappedFile(const std::wstring& filename) :
+    m_filename(filename),
+    m_data(nullptr),
+    m_size(0),
+    m_fileHandle(INVALID_HANDLE_VALUE),
+    m_mappingHandle(nullptr)
+{
+    m_fileHandle = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_fileHandle == INVALID_HANDLE_VALUE)
+        RuntimeError("Unable to open file '%ls' for memory mapping, error %x.", filename.c_str(), GetLastError());
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_fileHandle, &size))
+    {
+        CloseHandle(m_fileHandle);
+        RuntimeError("Unable to retrieve the size of file '%ls', error %x.", filename.c_str(), GetLastError());
+    }
+    m_size = (size_t)size.QuadPart;
+
+    m_mappingHandle = CreateFileMapping(m_fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_mappingHandle == nullptr)
+    {
+        CloseHandle(m_fileHandle);
+        RuntimeError("Unable to create a mapping for file '%ls', error %x.", filename.c_str(), GetLastError());
+    }
+
+    m_data = (char*)MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (m_data == nullptr)
+    {
+        CloseHandle(m_mappingHandle);
+        CloseHandle(m_fileHandle);
+        RuntimeError("Unable to memory map file '%ls', error %x.", filename.c_str(), GetLastError());
+    }
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    if (m_data != nullptr)
+        UnmapViewOfFile(m_data);
+    if (m_mappingHandle != nullptr)
+        CloseHandle(m_mappingHandle);
+    if (m_fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(m_fileHandle);
+}
+
+// PrefetchVirtualMemory is only available as of Windows 8, it is therefore looked up at runtime;
+// on Windows 7 the hint is a no-op.
+void MemoryMappedFile::AdviseWillNeed(size_t offset, size_t size) const
+{
+    if (offset >= m_size || size == 0)
+        return;
+
+    struct MemoryRangeEntry // (WIN32_MEMORY_RANGE_ENTRY)
+    {
+        void* virtualAddress;
+        size_t numberOfBytes;
+    };
+    typedef BOOL(WINAPI * PrefetchVirtualMemoryFunction)(HANDLE, ULONG_PTR, MemoryRangeEntry*, ULONG);
+    static const auto prefetchVirtualMemory = (PrefetchVirtualMemoryFunction)GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "PrefetchVirtualMemory");
+    if (prefetchVirtualMemory == nullptr)
+        return;
+
+    MemoryRangeEntry range = { m_data + offset, std::min(size, m_size - offset) };
+
+    // Only a hint, errors are intentionally ignored.
+    prefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+void MemoryMappedFile::AdviseRandomAccess() const
+{
+}
+
+#else
+
+MemoryMappedFile::MemoryMappedFile(const std::wstring& filename) :
+    m_filename(filename),
+    m_data(nullptr),
+    m_size(0),
+    m_fileDescriptor(-1)
+{
+    m_fileDescriptor = open(msra::strfun::utf8(filename).c_str(), O_RDONLY);
+    if (m_fileDescriptor == -1)
+        RuntimeError("Unable to open file '%ls' for memory mapping: %s.", filename.c_str(), strerror(errno));
+
+    struct stat sb;
+    if (fstat(m_fileDescriptor, &sb) == -1)
+    {
+        close(m_fileDescriptor);
+        RuntimeError("Unable to retrieve the size of file '%ls': %s.", filename.c_str(), strerror(errno));
+    }
+    m_size = (size_t)sb.st_size;
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_fileDescriptor, 0);
+    if (data == MAP_FAILED)
+    {
+        close(m_fileDescriptor);
+        RuntimeError("Unable to memory map file '%ls': %s.", filename.c_str(), strerror(errno));
+    }
+    m_data = (char*)data;
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    if (m_data != nullptr)
+        munmap(m_data, m_size);
+    if (m_fileDescriptor != -1)
+        close(m_fileDescriptor);
+}
+
+void MemoryMappedFile::AdviseWillNeed(size_t offset, size_t size) const
+{
+    if (offset >= m_size || size == 0)
+        return;
+
+    // madvise requires a page aligned start address.
+    static const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t alignedOffset = offset - offset % pageSize;
+    size_t length = std::min(offset + size, m_size) - alignedOffset;
+
+    // Only a hint, errors are intentionally ignored.
+    madvise(m_data + alignedOffset, length, MADV_WILLNEED);
+}
+
+void MemoryMappedFile::AdviseRandomAccess() const
+{
+    madvise(m_data, m_size, MADV_RANDOM);
+}
+
+#endif
+
+}}}
@@ -0,0 +1,58 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include "Basics.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A read-only, shared memory mapping of a complete file.
+// Deserializers can hand out pointers into the mapping instead of copying
+// the data into freshly allocated buffers. The pages are owned by the OS page cache,
+// so several readers (or processes) mapping the same file share the physical memory.
+// The mapping is kept alive as long as there is a shared pointer to this object,
+// chunks that point into the mapping should therefore hold a reference to it.
+class MemoryMappedFile
+{
+public:
+    explicit MemoryMappedFile(const std::wstring& filename);
+    ~MemoryMappedFile();
+
+    // Start of the mapped region (the beginning of the file).
+    const char* Data() const { return m_data; }
+
+    // Size of the mapped region in bytes (the size of the file).
+    size_t Size() const { return m_size; }
+
+    // Hints the OS that the given range will be accessed soon,
+    // so that it can start asynchronous readahead of the corresponding pages.
+    // The hint is best effort: the function never fails.
+    void AdviseWillNeed(size_t offset, size_t size) const;
+
+    // Hints the OS that the file is going to be accessed in random order,
+    // which disables the default sequential readahead of the whole mapping.
+    void AdviseRandomAccess() const;
+
+private:
+    std::wstring m_filename;
+    char* m_data;
+    size_t m_size;
+
+#ifdef __WINDOWS__
+    void* m_fileHandle;
+    void* m_mappingHandle;
+#else
+    int m_fileDescriptor;
+#endif
+
+    DISABLE_COPY_AND_MOVE(MemoryMappedFile);
+};
+
+typedef std::shared_ptr<MemoryMappedFile> MemoryMappedFilePtr;
+
+}}}
@@ -18,6 +18,13 @@ public:
     virtual void SetConfiguration(const ReaderConfiguration& config, const std::vector<MemoryProviderPtr>& memoryProviders) = 0;
 
     virtual Minibatch ReadMinibatch() = 0;
+
+    // Returns the position in the global timeline of the first sequence not yet returned by ReadMinibatch(). The returned value is in samples.
+    virtual size_t GetCurrentSamplePosition() = 0;
+
+    // Sets the position in the global timeline from which ReadMinibatch() continues.
+    virtual void SetCurrentSamplePosition(size_t currentSamplePosition) = 0;
+
     virtual ~Packer() {}
 };
 
@@ -97,6 +97,17 @@ protected:
 public:
     // Sets current epoch configuration.
     virtual void SetConfiguration(const ReaderConfiguration& config, const std::vector<MemoryProviderPtr>& memoryProviders) override;
+
+    // By default the packer is at the position of the sequence enumerator.
+    virtual size_t GetCurrentSamplePosition() override
+    {
+        return m_sequenceEnumerator->GetCurrentSamplePosition();
+    }
+
+    virtual void SetCurrentSamplePosition(size_t currentSamplePosition) override
+    {
+        m_sequenceEnumerator->SetCurrentSamplePosition(currentSamplePosition);
+    }
 };
 
 inline void PackerBase::PackSparseSampleAsDense(char* destination, SparseSequenceDataPtr sequence,
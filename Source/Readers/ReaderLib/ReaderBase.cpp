@@ -63,14 +63,15 @@ Minibatch ReaderBase::ReadMinibatch()
     return m_packer->ReadMinibatch();
 }
 
+// The position is taken from the packer, which may hold sequences it has already read from the sequence enumerator.
 size_t ReaderBase::GetCurrentSamplePosition()
 {
-    return m_sequenceEnumerator->GetCurrentSamplePosition();
+    return m_packer->GetCurrentSamplePosition();
 }
 
 void ReaderBase::SetCurrentSamplePosition(size_t currentSamplePosition)
 {
-    m_sequenceEnumerator->SetCurrentSamplePosition(currentSamplePosition);
+    m_packer->SetCurrentSamplePosition(currentSamplePosition);
 }
 
 void ReaderBase::SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>&)
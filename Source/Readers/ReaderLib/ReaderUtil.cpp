@@ -3,8 +3,10 @@
 // Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
 //
 
+#include <sys/stat.h>
 #include "Config.h"
 #include "DataReader.h"
+#include "ReaderUtil.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
     
@@ -34,4 +36,20 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         return randomizeAuto;
     }
 
+    bool GetFileSizeAndModificationTime(const std::wstring& filename, uint64_t& size, int64_t& time)
+    {
+#ifdef _WIN32
+        struct _stat64 buf;
+        if (_wstat64(filename.c_str(), &buf) != 0)
+            return false;
+#else
+        struct stat buf;
+        if (stat(msra::strfun::utf8(filename).c_str(), &buf) != 0)
+            return false;
+#endif
+        size = (uint64_t)buf.st_size;
+        time = (int64_t)buf.st_mtime;
+        return true;
+    }
+
 }}}
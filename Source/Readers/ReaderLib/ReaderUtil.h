@@ -14,6 +14,10 @@ class ConfigParameters;
 
 size_t GetRandomizationWindowFromConfig(const ConfigParameters& config);
 
+// Retrieves the size and the modification time of the file, used to check whether a cache derived
+// from the file is still valid. Returns false if the file cannot be accessed.
+bool GetFileSizeAndModificationTime(const std::wstring& filename, uint64_t& size, int64_t& time);
+
 // Returns the size of the type.
 inline size_t GetSizeByType(ElementType type)
 {
@@ -11,6 +11,7 @@
 #include <inttypes.h>
 #include "SequencePacker.h"
 #include "ReaderUtil.h"
+#include "RandomOrdering.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -38,12 +39,17 @@ MBLayoutPtr SequencePacker::CreateMBLayout(const StreamBatch& batch)
 
 Minibatch SequencePacker::ReadMinibatch()
 {
-    auto sequences = m_sequenceEnumerator->GetNextSequences(m_globalMinibatchSizeInSamples, m_localMinibatchSizeInSamples);
+    auto sequences = m_bucketingWindow > 0 ?
+        GetNextBucket() :
+        m_sequenceEnumerator->GetNextSequences(m_globalMinibatchSizeInSamples, m_localMinibatchSizeInSamples);
     const auto& batch = sequences.m_data;
 
     Minibatch minibatch(sequences.m_endOfSweep, sequences.m_endOfEpoch);
     if (batch.empty())
+    {
+        UpdatePaddingStatistics(minibatch);
         return minibatch;
+    }
 
     auto& currentBuffer = m_streamBuffers[m_currentBufferIndex];
 
@@ -70,11 +76,160 @@ Minibatch SequencePacker::ReadMinibatch()
     }
 
     EstablishIdToKey(minibatch, sequences);
+    UpdatePaddingStatistics(minibatch);
 
     m_currentBufferIndex = (m_currentBufferIndex + 1) % m_numberOfBuffers;
     return minibatch;
 }
 
+Sequences SequencePacker::GetNextBucket()
+{
+    // Discard the rest of the pool if the sequence enumerator has been repositioned since the pool was filled.
+    if (m_nextBucket < m_buckets.size() && m_sequenceEnumerator->GetCurrentSamplePosition() != m_poolSamplePosition)
+    {
+        m_buckets.clear();
+        m_nextBucket = 0;
+    }
+
+    if (m_nextBucket == m_buckets.size())
+    {
+        // Refill the pool with sequences worth of m_bucketingWindow minibatches.
+        auto scale = [this](size_t sampleCount) { return sampleCount > SIZE_MAX / m_bucketingWindow ? SIZE_MAX : sampleCount * m_bucketingWindow; };
+        m_poolStartPosition = m_sequenceEnumerator->GetCurrentSamplePosition();
+        m_pool = m_sequenceEnumerator->GetNextSequences(scale(m_globalMinibatchSizeInSamples), scale(m_localMinibatchSizeInSamples));
+        m_poolSamplePosition = m_sequenceEnumerator->GetCurrentSamplePosition();
+
+        size_t numSequences = m_pool.m_data.empty() ? 0 : m_pool.m_data.front().size();
+        m_poolLengths.assign(numSequences, 0);
+        for (const auto& streamSequences : m_pool.m_data)
+        {
+            for (size_t i = 0; i < numSequences; ++i)
+                m_poolLengths[i] = std::max<size_t>(m_poolLengths[i], streamSequences[i]->m_numberOfSamples);
+        }
+
+        m_buckets.assign(1, std::vector<size_t>(numSequences));
+        std::iota(m_buckets.front().begin(), m_buckets.front().end(), 0);
+        m_nextBucket = 0;
+        CreateBuckets();
+
+        if (m_buckets.empty())
+        {
+            // No data, only the end of sweep/epoch flags.
+            Sequences result;
+            result.m_endOfSweep = m_pool.m_endOfSweep;
+            result.m_endOfEpoch = m_pool.m_endOfEpoch;
+            return result;
+        }
+    }
+
+    const auto& bucket = m_buckets[m_nextBucket++];
+
+    Sequences result;
+    result.m_data.resize(m_pool.m_data.size());
+    for (size_t streamIndex = 0; streamIndex < m_pool.m_data.size(); ++streamIndex)
+    {
+        result.m_data[streamIndex].reserve(bucket.size());
+        for (auto i : bucket)
+            result.m_data[streamIndex].push_back(m_pool.m_data[streamIndex][i]);
+    }
+
+    // The end of sweep/epoch flags of the pool go with its last bucket.
+    if (m_nextBucket == m_buckets.size())
+    {
+        result.m_endOfSweep = m_pool.m_endOfSweep;
+        result.m_endOfEpoch = m_pool.m_endOfEpoch;
+        m_pool = Sequences();
+    }
+
+    return result;
+}
+
+size_t SequencePacker::GetCurrentSamplePosition()
+{
+    // The sequences left in the pool have been read from the sequence enumerator, but not returned yet.
+    if (m_nextBucket < m_buckets.size())
+        return m_poolStartPosition;
+
+    return PackerBase::GetCurrentSamplePosition();
+}
+
+void SequencePacker::SetCurrentSamplePosition(size_t currentSamplePosition)
+{
+    // Keep the pool if the packer is already at the position, e.g. when the reader is reconfigured with the position it reported.
+    if (m_nextBucket < m_buckets.size() && currentSamplePosition == m_poolStartPosition)
+        return;
+
+    m_pool = Sequences();
+    m_buckets.clear();
+    m_nextBucket = 0;
+    PackerBase::SetCurrentSamplePosition(currentSamplePosition);
+}
+
+void SequencePacker::CreateBuckets()
+{
+    std::vector<size_t> remaining;
+    for (size_t i = m_nextBucket; i < m_buckets.size(); ++i)
+        remaining.insert(remaining.end(), m_buckets[i].begin(), m_buckets[i].end());
+
+    std::sort(remaining.begin(), remaining.end(), [this](size_t a, size_t b)
+    {
+        return m_poolLengths[a] < m_poolLengths[b] || (m_poolLengths[a] == m_poolLengths[b] && a < b);
+    });
+
+    // Buckets have the size of a minibatch of this worker, containing at least one sequence.
+    size_t bucketSizeInSamples = m_useLocalTimeline ?
+        m_localMinibatchSizeInSamples :
+        std::max<size_t>(1, m_globalMinibatchSizeInSamples / m_config.m_numberOfWorkers);
+
+    m_buckets.clear();
+    m_nextBucket = 0;
+    size_t numSamples = 0;
+    for (auto i : remaining)
+    {
+        if (m_buckets.empty() || numSamples + m_poolLengths[i] > bucketSizeInSamples)
+        {
+            m_buckets.push_back(std::vector<size_t>());
+            numSamples = 0;
+        }
+
+        m_buckets.back().push_back(i);
+        numSamples += m_poolLengths[i];
+    }
+
+    // Return the buckets in random order, so that the sequence length does not grow monotonously over the pool.
+    std::mt19937_64 rng(m_poolSamplePosition);
+    RandomShuffleMT(m_buckets, rng);
+}
+
+void SequencePacker::UpdatePaddingStatistics(const Minibatch& minibatch)
+{
+    if (m_resetPaddingStatistics)
+    {
+        m_numPackedSamples = m_numLayoutSamples = m_numPackedMinibatches = 0;
+        m_resetPaddingStatistics = false;
+    }
+
+    if (!minibatch.m_data.empty())
+    {
+        const auto& layout = minibatch.m_data.front()->m_layout;
+        m_numPackedSamples += layout->GetActualNumSamples();
+        m_numLayoutSamples += layout->GetNumCols();
+        m_numPackedMinibatches++;
+    }
+
+    if (minibatch.m_endOfEpoch)
+    {
+        if (m_bucketingWindow > 0 && m_numPackedMinibatches > 0)
+            fprintf(stderr, "SequencePacker: padding efficiency with bucketing %.2f%% (%" PRIu64 " samples in %" PRIu64 " minibatch slots, %" PRIu64 " minibatches)\n",
+                    100.0 * GetPaddingEfficiency(),
+                    m_numPackedSamples,
+                    m_numLayoutSamples,
+                    m_numPackedMinibatches);
+
+        m_resetPaddingStatistics = true;
+    }
+}
+
 void SequencePacker::SetConfiguration(const ReaderConfiguration& config, const std::vector<MemoryProviderPtr>& memoryProviders)
 {
     PackerBase::SetConfiguration(config, memoryProviders);
@@ -100,6 +255,10 @@ void SequencePacker::SetConfiguration(const ReaderConfiguration& config, const s
         // Set global and minibatch local minibatch size as in config.
         m_globalMinibatchSizeInSamples = m_localMinibatchSizeInSamples = m_config.m_minibatchSizeInSamples;
     }
+
+    // Re-cut the rest of the bucketing pool if the minibatch size changes in the middle of it.
+    if (m_nextBucket < m_buckets.size())
+        CreateBuckets();
 }
 
 void SequencePacker::CheckSampleShape(const std::vector<SequenceDataPtr>& minibatch, StreamDescriptionPtr outputStream)
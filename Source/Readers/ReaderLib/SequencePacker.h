@@ -11,6 +11,15 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 // This packer generates minibatches containing full sequences packed for 
 // efficient (concurrent) consumption on a GPU.
+//
+// Optionally (bucketingWindow > 0) the packer groups sequences of similar length into the same minibatch,
+// which reduces the gaps in the MBLayout when sequence lengths vary a lot:
+//     1) sequences worth of bucketingWindow minibatches are read from the sequence enumerator into a pool,
+//     2) the pool is sorted by sequence length and cut into buckets not exceeding the minibatch size in samples,
+//     3) the buckets are shuffled and returned one per minibatch; when the pool is exhausted, it is refilled.
+// Because the pool is read ahead, the packer reports the position of the pool as its sample position (used for
+// checkpointing) until the pool is exhausted. Restoring from that position reads the whole pool again, so no sequence
+// is skipped, but the sequences of the pool that were returned before the checkpoint are returned once more.
 class SequencePacker : public PackerBase
 {
 public:
@@ -19,17 +28,37 @@ public:
         const std::vector<StreamDescriptionPtr>& streams,
         size_t numberOfBuffers = 2,
         bool useLocalTimeline = false,
-        CorpusDescriptorPtr corpus = nullptr) :
+        CorpusDescriptorPtr corpus = nullptr,
+        size_t bucketingWindow = 0) :
         PackerBase(corpus, sequenceEnumerator, streams, numberOfBuffers),
         m_useLocalTimeline(useLocalTimeline),
         m_globalMinibatchSizeInSamples(0),
-        m_localMinibatchSizeInSamples(0)
+        m_localMinibatchSizeInSamples(0),
+        m_bucketingWindow(bucketingWindow),
+        m_nextBucket(0),
+        m_poolStartPosition(SIZE_MAX),
+        m_poolSamplePosition(SIZE_MAX),
+        m_numPackedSamples(0),
+        m_numLayoutSamples(0),
+        m_numPackedMinibatches(0),
+        m_resetPaddingStatistics(false)
     {}
 
     virtual Minibatch ReadMinibatch() override;
 
     void SetConfiguration(const ReaderConfiguration& config, const std::vector<MemoryProviderPtr>& memoryProviders) override;
 
+    size_t GetCurrentSamplePosition() override;
+
+    void SetCurrentSamplePosition(size_t currentSamplePosition) override;
+
+    // Returns the fraction of the minibatch layouts occupied by actual samples (as opposed to gaps)
+    // in the current epoch, or in the last one if it has just ended.
+    double GetPaddingEfficiency() const
+    {
+        return m_numLayoutSamples == 0 ? 1.0 : (double)m_numPackedSamples / m_numLayoutSamples;
+    }
+
 protected:
     virtual MBLayoutPtr PackDenseStream(const StreamBatch& batch, size_t streamIndex);
 
@@ -51,6 +80,40 @@ protected:
     // A minibatch size for this worker in global samples.
     size_t m_globalMinibatchSizeInSamples;
 
+private:
+    // Returns the sequences of the next bucket, refilling the bucketing pool if needed.
+    Sequences GetNextBucket();
+
+    // Cuts the remaining sequences of the bucketing pool into buckets of the current minibatch size.
+    void CreateBuckets();
+
+    // Updates the padding statistics with the layout of the packed minibatch.
+    void UpdatePaddingStatistics(const Minibatch& minibatch);
+
+    // Size of the bucketing pool in minibatches, 0 if bucketing is disabled.
+    size_t m_bucketingWindow;
+
+    // Sequences read ahead from the sequence enumerator, together with the end of sweep/epoch flags
+    // that apply to the last bucket.
+    Sequences m_pool;
+
+    // Lengths of the pool sequences in samples (maximum over streams).
+    std::vector<size_t> m_poolLengths;
+
+    // Buckets of indices into the pool, returned in order starting at m_nextBucket.
+    std::vector<std::vector<size_t>> m_buckets;
+    size_t m_nextBucket;
+
+    // Sample position of the sequence enumerator before and after the pool has been filled.
+    // If the position changes (new epoch, restore from checkpoint), the pool is discarded.
+    size_t m_poolStartPosition;
+    size_t m_poolSamplePosition;
+
+    // Padding statistics of the current epoch, reset with the first minibatch of the next one.
+    size_t m_numPackedSamples;
+    size_t m_numLayoutSamples;
+    size_t m_numPackedMinibatches;
+    bool m_resetPaddingStatistics;
 };
 
 typedef std::shared_ptr<SequencePacker> SequencePackerPtr;
@@ -0,0 +1,206 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// AsyncCheckpointWriter.h -- writing models and checkpoints on a background thread while training continues.
+//
+// At the end of an epoch SGD takes a snapshot of the parameters and of the learner state into host memory
+// (HostMatrixSnapshot), which only costs a device-to-host copy, serializes the model and the checkpoint
+// from it into memory, and hands writing the files to the AsyncCheckpointWriter. Files are written under
+// a temporary name and renamed when complete, so a model or checkpoint file is never seen half written.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "Matrix.h"
+#include "CUDAPageLockedMemAllocator.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Copies of a set of matrices in host memory.
+// The dense matrices are copied into a single buffer, which is page-locked if the matrices
+// live on a GPU so that the device-to-host copy runs at full bus speed. Matrices in other
+// formats are deep copied to the CPU.
+template <class ElemType>
+class HostMatrixSnapshot
+{
+public:
+    HostMatrixSnapshot(const std::vector<const Matrix<ElemType>*>& matrices, DEVICEID_TYPE deviceId) :
+        m_buffer(nullptr), m_pinned(false), m_deviceId(deviceId)
+    {
+        size_t totalSize = 0;
+        for (auto matrix : matrices)
+        {
+            if (matrix->GetMatrixType() == MatrixType::DENSE)
+                totalSize += matrix->GetNumElements();
+        }
+
+        if (totalSize > 0)
+        {
+            if (m_deviceId >= 0)
+            {
+                m_buffer = (ElemType*)CUDAPageLockedMemAllocator::Malloc(totalSize * sizeof(ElemType), m_deviceId);
+                m_pinned = (m_buffer != nullptr);
+            }
+            if (!m_buffer)
+                m_buffer = new ElemType[totalSize];
+        }
+
+        ElemType* pos = m_buffer;
+        m_copies.reserve(matrices.size());
+        for (auto matrix : matrices)
+        {
+            size_t rows = matrix->GetNumRows(), cols = matrix->GetNumCols();
+            if (matrix->GetMatrixType() != MatrixType::DENSE)
+                m_copies.push_back(std::make_shared<Matrix<ElemType>>(*matrix, CPUDEVICE));
+            else if (rows * cols == 0)
+                m_copies.push_back(std::make_shared<Matrix<ElemType>>(rows, cols, CPUDEVICE));
+            else
+            {
+                matrix->CopySection(rows, cols, pos, rows);
+                m_copies.push_back(std::make_shared<Matrix<ElemType>>(rows, cols, pos, CPUDEVICE, matrixFlagDontOwnBuffer));
+                pos += rows * cols;
+            }
+        }
+    }
+
+    ~HostMatrixSnapshot()
+    {
+        m_copies.clear(); // the views must go before the buffer they point into
+        if (m_pinned)
+            CUDAPageLockedMemAllocator::Free(m_buffer, m_deviceId);
+        else
+            delete[] m_buffer;
+    }
+
+    size_t Size() const { return m_copies.size(); }
+
+    // The copy of the i-th matrix, valid for the lifetime of this object.
+    const std::shared_ptr<Matrix<ElemType>>& operator[](size_t i) const { return m_copies[i]; }
+
+private:
+    ElemType* m_buffer;
+    bool m_pinned;
+    DEVICEID_TYPE m_deviceId;
+    std::vector<std::shared_ptr<Matrix<ElemType>>> m_copies;
+
+    DISABLE_COPY_AND_MOVE(HostMatrixSnapshot);
+};
+
+// Runs write tasks one after another on a single background thread, in submission order.
+// An exception thrown by a task is kept and rethrown to the training thread by the next
+// call to Submit() or WaitForAll(), so a failed save still stops training.
+class AsyncCheckpointWriter
+{
+public:
+    typedef std::function<void()> Task;
+
+    // maxPending bounds the number of tasks (and hence serialized models held in memory) that are queued or running.
+    explicit AsyncCheckpointWriter(size_t maxPending) :
+        m_maxPending(maxPending == 0 ? 1 : maxPending),
+        m_numPending(0),
+        m_stop(false)
+    {
+        m_thread = std::thread([this] { WorkerLoop(); });
+    }
+
+    ~AsyncCheckpointWriter()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_done.wait(lock, [this] { return m_numPending == 0; });
+            m_stop = true;
+        }
+        m_wakeUp.notify_all();
+        m_thread.join();
+    }
+
+    // Queues a task; blocks while maxPending tasks are outstanding.
+    void Submit(Task&& task)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_done.wait(lock, [this] { return m_numPending < m_maxPending; });
+            RethrowIfFailed();
+            m_tasks.push_back(std::move(task));
+            m_numPending++;
+        }
+        m_wakeUp.notify_one();
+    }
+
+    // Blocks until all submitted tasks have completed.
+    void WaitForAll()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_numPending == 0; });
+        RethrowIfFailed();
+    }
+
+private:
+    // must be called with m_mutex held
+    void RethrowIfFailed()
+    {
+        if (m_error)
+        {
+            std::exception_ptr error = m_error;
+            m_error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    void WorkerLoop()
+    {
+        for (;;)
+        {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wakeUp.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+                if (m_tasks.empty())
+                    return;
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+
+            std::exception_ptr error;
+            try
+            {
+                task();
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            task = nullptr; // release the memory held by the task before signaling completion
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (error && !m_error)
+                    m_error = error;
+                m_numPending--;
+            }
+            m_done.notify_all();
+        }
+    }
+
+    const size_t m_maxPending;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::condition_variable m_done;
+    std::deque<Task> m_tasks;
+    size_t m_numPending;         // queued or running tasks, guarded by m_mutex
+    std::exception_ptr m_error;  // first failure not yet reported, guarded by m_mutex
+    bool m_stop;
+};
+
+}}}
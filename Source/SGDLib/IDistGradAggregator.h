@@ -19,6 +19,20 @@ public:
     // Returns a boolean indicating if any samples were processed
     virtual bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool resetState) = 0;
 
+    // Aggregators that can overlap the aggregation with backprop return true here. They are then told through
+    // OnGradientReady() as soon as backprop has completed gradients[gradientIndex] of the next AggregateGradients() call,
+    // which finishes the aggregation. OnGradientReady() may be called concurrently and is never called before
+    // the first AggregateGradients() call. The gradient must not change anymore after OnGradientReady(); hence
+    // it is not called for minibatches that are split into sub-minibatches, whose gradients are accumulated after the backprop.
+    virtual bool SupportsOverlappedAggregation() const
+    {
+        return false;
+    }
+
+    virtual void OnGradientReady(size_t /*gradientIndex*/)
+    {
+    }
+
     size_t NumProc()
     {
         return m_mpi->NumNodesInUse();
@@ -182,6 +182,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         m_enableDistributedMBReading = true;
     }
 
+    net->SetNodeProfiling(m_profileNodes);
+
     // determine evaluationNodes from GetEvalCriterionNodes(), ensuring each criterion is only logged once
     std::vector<ComputationNodeBasePtr> evaluationNodes;
     {
@@ -353,6 +355,14 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
         InitModelAggregationHandler(m_syncStatsTrace, net->GetDeviceId());
     }
 
+    // The model aggregation helpers write their own state into the checkpoint from the live objects,
+    // which can't be deferred, so asynchronous checkpointing is not supported with them.
+    m_checkpointWriter.reset();
+    if (m_asyncCheckpoint && !m_pMASGDHelper && ((m_mpi == nullptr) || m_mpi->IsMainNode()))
+        m_checkpointWriter.reset(new AsyncCheckpointWriter(m_maxPendingCheckpoints));
+    else if (m_asyncCheckpoint && m_pMASGDHelper)
+        LOGPRINTF(stderr, "asyncCheckpoint is not supported with model averaging or block momentum, checkpoints are written synchronously.\n");
+
     // precompute mean and invStdDev nodes and save initial model
     // When no precompute, only save if we did not load the model from a 
     // checkpoint but instead built it from a network description
@@ -513,7 +523,10 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                 // In case of parallel training only the main node should we saving the model to prevent
                 // the parallel training nodes from colliding to write the same file
                 if ((m_mpi == nullptr) || m_mpi->IsMainNode())
+                {
+                    WaitForPendingCheckpoints();
                     net->Save(m_modelPath);
+                }
             }
             break;
         }
@@ -709,6 +722,9 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                     // roll back
                     auto bestModelPath = GetModelNameForEpoch(i - m_learnRateAdjustInterval);
                     LOGPRINTF(stderr, "Loading (rolling back to) previous model with best training-criterion value: %ls.\n", bestModelPath.c_str());
+                    // the model may still be being written by the main node
+                    WaitForPendingCheckpoints();
+                    SynchronizeWorkers();
                     net->RereadPersistableParameters<ElemType>(bestModelPath);
                     LoadCheckPointInfo(i - m_learnRateAdjustInterval,
                                        /*out*/ totalTrainingSamplesSeen,
@@ -736,7 +752,10 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                         // In case of parallel training only the main node should we saving the model to prevent
                         // the parallel training nodes from colliding to write the same file
                         if ((m_mpi == nullptr) || m_mpi->IsMainNode())
+                        {
+                            WaitForPendingCheckpoints();
                             net->Save(GetModelNameForEpoch(i, true));
+                        }
 
                         LOGPRINTF(stderr, "Finished training and saved final model\n\n");
                         break;
@@ -806,11 +825,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
             }
             else
             {
-                SaveCheckPointInfo(i, totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, smoothedCounts, prevCriterion, chosenMinibatchSize);
-                auto modelName = GetModelNameForEpoch(i);
-                if (m_traceLevel > 0)
-                    LOGPRINTF(stderr, "SGD: Saving checkpoint model '%ls'\n", modelName.c_str());
-                net->Save(modelName);
+                vector<wstring> obsoleteFiles;
                 if (!m_keepCheckPointFiles)
                 {
                     // delete previous checkpoint file to save space
@@ -818,18 +833,34 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                     {
                         if (epochsSinceLastLearnRateAdjust != 1)
                         {
-                            _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
+                            obsoleteFiles.push_back(GetCheckPointFileNameForEpoch(i - 1));
                         }
                         if (epochsSinceLastLearnRateAdjust == m_learnRateAdjustInterval)
                         {
-                            _wunlink(GetCheckPointFileNameForEpoch(i - m_learnRateAdjustInterval).c_str());
+                            obsoleteFiles.push_back(GetCheckPointFileNameForEpoch(i - m_learnRateAdjustInterval));
                         }
                     }
                     else
                     {
-                        _wunlink(GetCheckPointFileNameForEpoch(i - 1).c_str());
+                        obsoleteFiles.push_back(GetCheckPointFileNameForEpoch(i - 1));
                     }
                 }
+
+                auto modelName = GetModelNameForEpoch(i);
+                if (m_traceLevel > 0)
+                    LOGPRINTF(stderr, "SGD: Saving checkpoint model '%ls'%s\n", modelName.c_str(), m_checkpointWriter ? " (asynchronously)" : "");
+                if (m_checkpointWriter)
+                {
+                    SaveModelAndCheckPointInfoAsync(net, modelName, i, totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, smoothedCounts,
+                                                    prevCriterion, chosenMinibatchSize, move(obsoleteFiles));
+                }
+                else
+                {
+                    SaveCheckPointInfo(i, totalTrainingSamplesSeen, learnRatePerSample, smoothedGradients, smoothedCounts, prevCriterion, chosenMinibatchSize);
+                    net->Save(modelName);
+                    for (const auto& file : obsoleteFiles)
+                        _wunlink(file.c_str());
+                }
             }
         }
         else
@@ -851,6 +882,7 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
 
     // Synchronize all ranks before proceeding to ensure that
     // rank 0 has finished writing the model file
+    WaitForPendingCheckpoints();
     // TODO[DataASGD]: should othet other rank waiting in async-mode
     SynchronizeWorkers();
 
@@ -938,6 +970,7 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     }
 
     std::vector<Matrix<ElemType>*> learnParamsGradients;
+    std::function<void(const ComputationNodeBasePtr&)> gradientReadyCallback; // lets the aggregator start while backprop is running
     Profiler profiler(m_numMBsToCUDAProfile);
 
     // resetting this, so profiling is performed for one epoch only
@@ -1146,20 +1179,9 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                     ComputationNetwork::BumpEvalTimeStamp(labelNodes);
                 }
 
-                // ===========================================================
-                // forward prop for evaluate eval nodes
-                // ===========================================================
-
-                // compute eval node first since when gradient is computed the forward function values
-                // may be changed and need to be recomputed when gradient and function value share the same matrix
-                net->ForwardProp(forwardPropRoots); // the bulk of this evaluation is reused in ComputeGradient() below
-
-                // ===========================================================
-                // backprop
-                // ===========================================================
-
-                if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
-                    net->Backprop(criterionNodes[0]);
+                // only compute gradient when learning rate is large enough
+                ForwardBackward(*net, forwardPropRoots, criterionNodes[0], learnRatePerSample > 0.01 * m_minLearnRate,
+                                actualNumSubminibatches, gradientReadyCallback);
 
                 // house-keeping for sub-minibatching
                 if (actualNumSubminibatches > 1)
@@ -1227,6 +1249,25 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                         learnParamsGradients.push_back(currParamsGradient);
                     }
                 }
+
+                if (m_distGradAgg->SupportsOverlappedAggregation())
+                {
+                    auto gradientIndex = make_shared<unordered_map<ComputationNodeBase*, size_t>>();
+                    for (const auto& node : learnableNodes)
+                    {
+                        auto iter = find(learnParamsGradients.begin(), learnParamsGradients.end(), &dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient());
+                        if (iter != learnParamsGradients.end())
+                            (*gradientIndex)[node.get()] = iter - learnParamsGradients.begin();
+                    }
+
+                    auto distGradAgg = m_distGradAgg;
+                    gradientReadyCallback = [distGradAgg, gradientIndex](const ComputationNodeBasePtr& node)
+                    {
+                        auto iter = gradientIndex->find(node.get());
+                        if (iter != gradientIndex->end())
+                            distGradAgg->OnGradientReady(iter->second);
+                    };
+                }
             }
 
             // hoist the criterion into CPU space for all-reduce
@@ -1532,6 +1573,9 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
     // --- END MAIN MINIBATCH LOOP
 
+    if (gradientReadyCallback)
+        net->SetGradientReadyCallback(nullptr);
+
     if (useModelAggregation )
     {
         m_pMASGDHelper->OnEpochEnd(learnableNodes, smoothedGradients, nSamplesSinceLastModelSync);
@@ -1598,6 +1642,34 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
     return numMBsRun;
 }
 
+// forward and backward pass of the current (sub-)minibatch of TrainOneEpoch()
+template <class ElemType>
+/*static*/ void SGD<ElemType>::ForwardBackward(ComputationNetwork& net, const std::vector<ComputationNodeBasePtr>& forwardPropRoots,
+                                               const ComputationNodeBasePtr& criterionNode, bool computeGradient, size_t numSubminibatches,
+                                               const std::function<void(const ComputationNodeBasePtr&)>& gradientReadyCallback)
+{
+    // ===========================================================
+    // forward prop for evaluate eval nodes
+    // ===========================================================
+
+    // compute eval node first since when gradient is computed the forward function values
+    // may be changed and need to be recomputed when gradient and function value share the same matrix
+    net.ForwardProp(forwardPropRoots); // the bulk of this evaluation is reused in ComputeGradient() below
+
+    // ===========================================================
+    // backprop
+    // ===========================================================
+
+    if (!computeGradient)
+        return;
+
+    // With sub-minibatches, the gradients are only final once TrainOneEpoch() has accumulated those of all
+    // sub-minibatches; the aggregation can then not overlap with the backprop.
+    if (gradientReadyCallback)
+        net.SetGradientReadyCallback(numSubminibatches == 1 ? gradientReadyCallback : nullptr);
+    net.Backprop(criterionNode);
+}
+
 // -----------------------------------------------------------------------
 // subroutines and helpers follow below
 // -----------------------------------------------------------------------
@@ -2192,7 +2264,7 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int numGradientBits, int d
         if (Globals::UseV2Aggregator()) // Currently used to check V2 against baselines.
             m_distGradAgg = std::make_shared<V2SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace, ::CNTK::MPICommunicator(m_packThresholdSizeInBytes));
         else
-            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace, m_packThresholdSizeInBytes);
+            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace, m_packThresholdSizeInBytes, m_gradientBucketSizeInBytes);
     }
 
     m_gradHeader.reset(DistGradHeader::Create(numEvalNodes), [](DistGradHeader* ptr) { DistGradHeader::Destroy(ptr); });
@@ -2385,46 +2457,131 @@ void SGD<ElemType>::SaveCheckPointInfo(const size_t epoch, const size_t totalSam
             File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
             // Buffer writes in memory then flush to filesystem, which reduces number of small writes
             fstream.Setvbuf();
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BVersion"); 
-            fstream << (size_t)CURRENT_CNTK_CHECKPOINT_VERSION; 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
+            SaveCheckPointInfo(fstream, totalSamplesSeen, learnRatePerSample, smoothedGradients, smoothedCounts, prevCriterion, minibatchSize);
+            // Ensuring that data is written
+            fstream.Flush();
+        }
+
+        _wunlink(checkPointFileName.c_str());
+        renameOrDie(tempFileName, checkPointFileName);
+    }
+}
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCKP");
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BLearnRate");
-            fstream << totalSamplesSeen << learnRatePerSample << prevCriterion;
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ELearnRate");
+template <class ElemType>
+void SGD<ElemType>::SaveCheckPointInfo(File& fstream, const size_t totalSamplesSeen,
+                                       const double learnRatePerSample,
+                                       const std::list<Matrix<ElemType>>& smoothedGradients,
+                                       const std::vector<double>& smoothedCounts,
+                                       const double prevCriterion,
+                                       const size_t minibatchSize)
+{
+    fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BVersion"); 
+    fstream << (size_t)CURRENT_CNTK_CHECKPOINT_VERSION; 
+    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BMinibatchSize");
-            fstream << minibatchSize;
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EMinibatchSize");
+    fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BCKP");
+    fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BLearnRate");
+    fstream << totalSamplesSeen << learnRatePerSample << prevCriterion;
+    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ELearnRate");
 
-            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+    fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BMinibatchSize");
+    fstream << minibatchSize;
+    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EMinibatchSize");
 
-            for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
-            {
-                const Matrix<ElemType>& smoothedGradientValues = *smoothedGradientIter;
-                fstream << smoothedGradientValues;
-            }
+    fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+    for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++)
+    {
+        const Matrix<ElemType>& smoothedGradientValues = *smoothedGradientIter;
+        fstream << smoothedGradientValues;
+    }
 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"BCount");
+    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
 
-            for (auto sc : smoothedCounts)
-                fstream << sc;
+    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"BCount");
 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECount");
+    for (auto sc : smoothedCounts)
+        fstream << sc;
 
-            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECKP");
-            if (m_pMASGDHelper)
-                m_pMASGDHelper->SaveToCheckPoint(fstream);
-            // Ensuring that data is written
-            fstream.Flush();
+    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECount");
+
+    fstream.PutMarker(FileMarker::fileMarkerEndSection, L"ECKP");
+    if (m_pMASGDHelper)
+        m_pMASGDHelper->SaveToCheckPoint(fstream);
+}
+
+// helper for SaveModelAndCheckPointInfoAsync(): write 'contents' into a temporary file, and rename it to 'fileName' when complete
+static void SaveFileFromMemory(const wstring& fileName, const vector<char>& contents)
+{
+    wstring tempFileName = fileName + L".tmp";
+    {
+        File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+        fwriteOrDie(contents.data(), 1, contents.size(), fstream);
+        fstream.Flush();
+    }
+    _wunlink(fileName.c_str());
+    renameOrDie(tempFileName, fileName);
+}
+
+template <class ElemType>
+void SGD<ElemType>::SaveModelAndCheckPointInfoAsync(const ComputationNetworkPtr& net, const wstring& modelName,
+                                                    const size_t epoch, const size_t totalSamplesSeen,
+                                                    const double learnRatePerSample,
+                                                    const std::list<Matrix<ElemType>>& smoothedGradients,
+                                                    const std::vector<double>& smoothedCounts,
+                                                    const double prevCriterion,
+                                                    const size_t minibatchSize,
+                                                    std::vector<wstring>&& obsoleteFiles)
+{
+    // The model and the checkpoint are serialized into memory here, on the training thread, so that they capture the state
+    // at the end of the epoch. Besides the parameters, nodes save state that changes while training continues, such as the
+    // batch-normalization statistics and random-number generator states. Only the file I/O runs in the background.
+    // The learnable parameters and the smoothed gradients are copied out first in one transfer (HostMatrixSnapshot).
+    vector<wstring> parameterNames;
+    vector<const Matrix<ElemType>*> matrices;
+    for (const auto& node : net->GetAllNodes())
+    {
+        auto parameter = dynamic_pointer_cast<LearnableParameter<ElemType>>(node);
+        if (parameter)
+        {
+            parameterNames.push_back(parameter->NodeName());
+            matrices.push_back(&parameter->Value());
         }
+    }
+    for (const auto& smoothedGradient : smoothedGradients)
+        matrices.push_back(&smoothedGradient);
 
-        _wunlink(checkPointFileName.c_str());
-        renameOrDie(tempFileName, checkPointFileName);
+    auto model = make_shared<vector<char>>();
+    auto checkPoint = make_shared<vector<char>>();
+    {
+        HostMatrixSnapshot<ElemType> snapshot(matrices, net->GetDeviceId());
+
+        map<wstring, MatrixBasePtr> parameterValues;
+        for (size_t k = 0; k < parameterNames.size(); k++)
+            parameterValues[parameterNames[k]] = snapshot[k];
+
+        list<Matrix<ElemType>> smoothedGradientValues;
+        for (size_t k = parameterNames.size(); k < snapshot.Size(); k++)
+            smoothedGradientValues.push_back(snapshot[k]->AsReference());
+
+        File checkPointStream(File::InMemory(), FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+        SaveCheckPointInfo(checkPointStream, totalSamplesSeen, learnRatePerSample, smoothedGradientValues, smoothedCounts, prevCriterion, minibatchSize);
+        *checkPoint = checkPointStream.GetMemoryContents();
+
+        File modelStream(File::InMemory(), FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+        net->Save(modelStream, parameterValues);
+        *model = modelStream.GetMemoryContents();
     }
+
+    auto checkPointFileName = GetCheckPointFileNameForEpoch(int(epoch));
+    auto obsolete = make_shared<vector<wstring>>(move(obsoleteFiles));
+    m_checkpointWriter->Submit([modelName, checkPointFileName, model, checkPoint, obsolete]()
+    {
+        SaveFileFromMemory(checkPointFileName, *checkPoint);
+        SaveFileFromMemory(modelName, *model);
+        for (const auto& file : *obsolete)
+            _wunlink(file.c_str());
+    });
 }
 
 template <class ElemType>
@@ -2783,6 +2940,9 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_numSubminiBatches = configSGD(L"numSubminibatches", (size_t) 1);
 
     m_packThresholdSizeInBytes = configSGD(L"packThresholdSizeInKB", DEFAULT_PACK_THRESHOLD_SIZE_IN_KB) * 1024;
+    // Gradients are all-reduced in buckets of this size as soon as backprop has completed them, overlapping
+    // communication and computation. Only used by the (non-async) FP32/FP64 aggregator. 0 disables it.
+    m_gradientBucketSizeInBytes = configSGD(L"gradientBucketSizeInKB", (size_t)0) * 1024;
 
     if (configAALR.Exists(L"numMiniBatch4LRSearch"))
     {
@@ -2830,6 +2990,9 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_numMBsToShowResult = configSGD(L"numMBsToShowResult", (size_t)10);
     m_firstMBsToShowResult = configSGD(L"firstMBsToShowResult", (size_t)0);
     m_numMBsToCUDAProfile = configSGD(L"numMBsToCUDAProfile", (size_t)0);
+    // Per-node timing of forward and backward computation. Requires the performance profiler (profilerEnabled=true),
+    // which then additionally writes a report of the time spent per node and per operation type.
+    m_profileNodes = configSGD(L"profileNodes", false);
 
     // Parameters that control logging of training progress in TensorBoard.
     // Directory to create TensorBoard event files in. If empty (default), the progress is not logged as event files.
@@ -20,6 +20,7 @@
 #include "Profiler.h"
 #include "MASGD.h"
 #include "ASGDHelper.h"
+#include "AsyncCheckpointWriter.h"
 using namespace std; // ugh! TODO: get rid of this from .h files!!!
 
 #define CNTK_CHECKPOINT_VERSION_1 1     // 1 -> no version number 
@@ -208,6 +209,9 @@ protected:
     // Threshold size in bytes for single gradient to do packing
     size_t m_packThresholdSizeInBytes;
 
+    // Size in bytes of the buckets whose aggregation is started during backprop (0: aggregate after backprop)
+    size_t m_gradientBucketSizeInBytes;
+
     LearningRateSearchAlgorithm m_autoLearnRateSearchType;
 
     AdaptationRegType m_adaptationRegType;
@@ -249,6 +253,7 @@ protected:
     size_t m_numMBsToShowResult = 0;
     size_t m_firstMBsToShowResult = 0;
     int m_numMBsToCUDAProfile;
+    bool m_profileNodes;
 
     std::wstring m_tensorBoardLogDir;
     size_t m_tensorBoardNumMBsToLogResult;
@@ -344,6 +349,10 @@ public:
           // TODO: The next few do not belong into SGD any more than the network or reader we operate on. Either move network and reader in here, or move these out.
           m_modelPath((const wstring&) configSGD(L"modelPath")),
           m_keepCheckPointFiles(configSGD(L"keepCheckPointFiles", false)),
+          // Write model and checkpoint files on a background thread from a snapshot of the parameters,
+          // so the next epoch does not wait for the disk. At most maxPendingCheckpoints saves are outstanding.
+          m_asyncCheckpoint(configSGD(L"asyncCheckpoint", false)),
+          m_maxPendingCheckpoints(configSGD(L"maxPendingCheckpoints", (size_t)1)),
           m_trainCriterionNodeName((const wstring&) configSGD(L"trainCriterionNodeName", L"")),
           m_evalCriterionNodeName ((const wstring&) configSGD(L"evalCriterionNodeName", L"")),
           m_traceNodeNamesReal    (configSGD(L"traceNodeNamesReal",     ConfigRecordType::Array(stringargvector()))),
@@ -516,6 +525,13 @@ public:
     // return -1 if nothing exists
     int DetermineStartEpoch(const bool makeMode);
 
+    // Forward and backward pass of one of the 'numSubminibatches' parts of a minibatch (1 if it is not split).
+    // gradientReadyCallback, if any, lets the gradient aggregation overlap with the backprop; it is only passed on to
+    // the network if the minibatch is not split, since the gradients of sub-minibatches are accumulated afterwards.
+    static void ForwardBackward(ComputationNetwork& net, const std::vector<ComputationNodeBasePtr>& forwardPropRoots,
+                                const ComputationNodeBasePtr& criterionNode, bool computeGradient, size_t numSubminibatches,
+                                const std::function<void(const ComputationNodeBasePtr&)>& gradientReadyCallback);
+
     wstring GetModelNameForEpoch(const int epoch, bool bLastModel = false);
 
 protected:
@@ -528,6 +544,31 @@ protected:
                             const double prevCriterion,
                             const size_t minibatchSize);
 
+    void SaveCheckPointInfo(File& fstream, const size_t totalSamplesSeen,
+                            const double learnRatePerSample,
+                            const std::list<Matrix<ElemType>>& smoothedGradients,
+                            const std::vector<double>& smoothedCounts,
+                            const double prevCriterion,
+                            const size_t minibatchSize);
+
+    // Saves the model and the checkpoint of the given epoch on m_checkpointWriter; they are serialized into memory before
+    // this returns, and written by the background thread. The files in 'obsoleteFiles' are deleted once both have been written.
+    void SaveModelAndCheckPointInfoAsync(const ComputationNetworkPtr& net, const wstring& modelName,
+                                         const size_t epoch, const size_t totalSamplesSeen,
+                                         const double learnRatePerSample,
+                                         const std::list<Matrix<ElemType>>& smoothedGradients,
+                                         const std::vector<double>& smoothedCounts,
+                                         const double prevCriterion,
+                                         const size_t minibatchSize,
+                                         std::vector<wstring>&& obsoleteFiles);
+
+    // Blocks until all asynchronous saves have completed (no-op if they are written synchronously).
+    void WaitForPendingCheckpoints()
+    {
+        if (m_checkpointWriter)
+            m_checkpointWriter->WaitForAll();
+    }
+
     bool TryLoadCheckPointInfo(const size_t epochNumber,
                                /*out*/ size_t& totalSamplesSeen,
                                /*out*/ double& learnRatePerSample,
@@ -565,6 +606,9 @@ public:
 protected:
     std::wstring m_modelPath;
     bool m_keepCheckPointFiles;
+    bool m_asyncCheckpoint;
+    size_t m_maxPendingCheckpoints;
+    std::unique_ptr<AsyncCheckpointWriter> m_checkpointWriter; // non-null if checkpoints are written asynchronously
 
     std::wstring m_trainCriterionNodeName;
     std::wstring m_evalCriterionNodeName;
@@ -11,6 +11,11 @@
 #include "CUDAPageLockedMemAllocator.h"
 #include "NcclComm.h"
 #include <future>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
 #include "GPUDataTransferer.h"
 #include "TimerUtility.h"
 #include "MatrixQuantizerImpl.h"
@@ -23,13 +28,26 @@ class SimpleDistGradAggregator : public IDistGradAggregator<ElemType>
     UsingIDistGradAggregatorMembers;
 
 public:
-    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int deviceId, int syncStatsTrace, size_t packThresholdSizeInBytes = DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES)
+    // bucketSizeInBytes > 0 enables the overlapping of the aggregation with backprop (not together with async aggregation)
+    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int deviceId, int syncStatsTrace, size_t packThresholdSizeInBytes = DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES,
+                             size_t bucketSizeInBytes = 0)
         : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_initialized(false), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace),
-        m_iterationCount(0), m_nccl(deviceId, mpi), m_packThresholdSizeInBytes(packThresholdSizeInBytes)
+        m_iterationCount(0), m_nccl(deviceId, mpi), m_packThresholdSizeInBytes(packThresholdSizeInBytes),
+        m_bucketSizeInBytes(useAsyncAggregation ? 0 : bucketSizeInBytes), m_numLaunchedBuckets(0), m_numCompletedBuckets(0), m_stopCommunication(false)
     {}
 
     ~SimpleDistGradAggregator()
     {
+        if (m_communicationThread.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_bucketMutex);
+                m_stopCommunication = true;
+            }
+            m_bucketWork.notify_all();
+            m_communicationThread.join();
+        }
+
         for (size_t i = 0; i < m_recvHeaders.size(); ++i)
             DistGradHeader::Destroy(m_recvHeaders[i]);
 
@@ -44,7 +62,12 @@ public:
         bool showSyncPerfStats = (m_syncStatsTrace > 0) && ((m_iterationCount % m_syncStatsTrace) == 0);
         m_iterationCount++;
 
-        if (m_useAsyncAggregation)
+        if (UseBuckets())
+        {
+            AggregateGradientsInBuckets(gradients, headerCPU, showSyncPerfStats);
+            return (headerCPU->numSamples != 0);
+        }
+        else if (m_useAsyncAggregation)
         {
             // If we are performing async gradient aggregation, let's wait for the pending gradient aggregation to finish
             // then swap the contents of the buffered gradients and the new gradient matrices and fire an async aggreagation
@@ -125,6 +148,23 @@ public:
         }
     }
 
+    bool SupportsOverlappedAggregation() const override
+    {
+        return UseBuckets();
+    }
+
+    // Launches the all-reduce of the bucket containing the gradient once all gradients of the bucket (and of all buckets before it) are ready.
+    void OnGradientReady(size_t gradientIndex) override
+    {
+        std::lock_guard<std::mutex> lock(m_bucketMutex);
+        if (!UseBuckets() || !m_initialized || gradientIndex >= m_gradientReady.size() || m_gradientReady[gradientIndex])
+            return;
+
+        m_gradientReady[gradientIndex] = true;
+        m_buckets[m_bucketIndex[gradientIndex]].numGradientsPending--;
+        LaunchReadyBuckets();
+    }
+
 private:
     std::shared_ptr<ElemType> AllocateIntermediateBuffer(int deviceID, size_t numElements)
     {
@@ -165,6 +205,17 @@ private:
                 m_allocator.reset(new CUDAPageLockedMemAllocator(deviceId));
             }
 
+            if (UseBuckets())
+            {
+                InitializeBuckets(gradients, deviceId);
+                if (m_mpi->IsMainNode())
+                {
+                    for (size_t i = 0; i < NumProc() - 1; ++i)
+                        m_recvHeaders.push_back(DistGradHeader::Create(numEvalNodes));
+                }
+                return;
+            }
+
             size_t packedGradientsSizeInElements = 0;
             for (size_t i = 0; i < gradients.size(); i++)
             {
@@ -249,6 +300,293 @@ private:
         }
     }
 
+    // -----------------------------------------------------------------------
+    // gradient bucketing
+    //
+    // The gradients are grouped into buckets of at most m_bucketSizeInBytes, in reverse order of the gradients vector,
+    // which is roughly the order in which backprop completes them. As soon as all gradients of a bucket are ready
+    // (OnGradientReady()), they are packed into a contiguous buffer and all-reduced on a communication thread,
+    // which overlaps the communication with the backprop of the remaining layers. AggregateGradients() launches
+    // whatever has not been launched yet, waits for all buckets and unpacks the results.
+    // Buckets are launched strictly in order, so that all workers issue the all-reduce operations in the same order.
+    // While buckets are in flight, MPI is only called from the communication thread (MPI_THREAD_SERIALIZED).
+    // -----------------------------------------------------------------------
+
+    bool UseBuckets() const
+    {
+        return m_bucketSizeInBytes > 0;
+    }
+
+    void InitializeBuckets(const std::vector<Matrix<ElemType>*>& gradients, int deviceId)
+    {
+        m_bucketedGradients = gradients;
+        m_bucketIndex.assign(gradients.size(), 0);
+        m_gradientReady.assign(gradients.size(), false);
+        for (size_t k = gradients.size(); k-- > 0;)
+        {
+            if (gradients[k]->GetMatrixType() != DENSE)
+                RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported!");
+
+            size_t sizeInBytes = sizeof(ElemType) * gradients[k]->GetNumElements();
+            if (m_buckets.empty() || (m_buckets.back().numElements * sizeof(ElemType) + sizeInBytes > m_bucketSizeInBytes))
+                m_buckets.push_back(GradientBucket());
+
+            auto& bucket = m_buckets.back();
+            bucket.gradientIndices.push_back(k);
+            bucket.numElements += gradients[k]->GetNumElements();
+            m_bucketIndex[k] = m_buckets.size() - 1;
+        }
+
+        for (auto& bucket : m_buckets)
+        {
+            // a bucket with a single gradient is reduced in place
+            if (bucket.gradientIndices.size() > 1)
+                bucket.packedGradients.reset(new Matrix<ElemType>(1, bucket.numElements, deviceId));
+
+            if (ShouldCopyDataToCPU(deviceId))
+            {
+                bucket.gpuDataTransferer = std::make_unique<GPUDataTransferer>(deviceId, /*useConcurrentStreams=*/true);
+                bucket.intermediateCPUBuffer = AllocateIntermediateBuffer(deviceId, bucket.numElements);
+            }
+            bucket.numGradientsPending = bucket.gradientIndices.size();
+        }
+
+        m_communicationThread = std::thread([this, deviceId] { CommunicationLoop(deviceId); });
+    }
+
+    // must be called with m_bucketMutex held
+    void LaunchReadyBuckets()
+    {
+        while (m_numLaunchedBuckets < m_buckets.size() && m_buckets[m_numLaunchedBuckets].numGradientsPending == 0)
+        {
+            auto& bucket = m_buckets[m_numLaunchedBuckets];
+            if (m_numLaunchedBuckets == 0)
+                m_bucketTimer.Start();
+
+            if (bucket.packedGradients)
+            {
+                size_t offset = 0;
+                for (size_t i : bucket.gradientIndices)
+                {
+                    auto gradient = m_bucketedGradients[i];
+                    bucket.packedGradients->ColumnSlice(offset, gradient->GetNumElements()).AssignValuesOf(gradient->Reshaped(1, gradient->GetNumElements()));
+                    offset += gradient->GetNumElements();
+                }
+            }
+
+            // marks the point on the compute stream after which the bucket data is complete
+            bucket.readyEvent.reset(MatrixComputeStreamEvent::Create(m_bucketedGradients[bucket.gradientIndices[0]]->GetDeviceId()));
+            m_bucketTimer.Stop();
+            bucket.launchTime = m_bucketTimer.ElapsedSeconds();
+
+            m_bucketQueue.push_back(m_numLaunchedBuckets++);
+            m_bucketWork.notify_one();
+        }
+    }
+
+    void CommunicationLoop(int deviceId)
+    {
+        if (deviceId != CPUDEVICE)
+            Matrix<ElemType>::SetDevice(deviceId);
+
+        for (;;)
+        {
+            size_t bucketIndex;
+            {
+                std::unique_lock<std::mutex> lock(m_bucketMutex);
+                m_bucketWork.wait(lock, [this] { return m_stopCommunication || !m_bucketQueue.empty(); });
+                if (m_stopCommunication)
+                    return;
+                bucketIndex = m_bucketQueue.front();
+                m_bucketQueue.pop_front();
+            }
+
+            Timer allReduceTimer;
+            allReduceTimer.Start();
+            std::exception_ptr error;
+            try
+            {
+                AllReduceBucket(bucketIndex, deviceId);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            allReduceTimer.Stop();
+
+            {
+                std::lock_guard<std::mutex> lock(m_bucketMutex);
+                m_buckets[bucketIndex].allReduceTime = allReduceTimer.ElapsedSeconds();
+                if (error && !m_bucketError)
+                    m_bucketError = error;
+                m_numCompletedBuckets++;
+            }
+            m_bucketsDone.notify_all();
+        }
+    }
+
+    void AllReduceBucket(size_t bucketIndex, int deviceId)
+    {
+        auto& bucket = m_buckets[bucketIndex];
+        ElemType* data = bucket.packedGradients ? bucket.packedGradients->Data() : m_bucketedGradients[bucket.gradientIndices[0]]->Data();
+
+        // wait until the computation of the bucket data has finished
+        bucket.readyEvent->SynchronizeEvent();
+        bucket.readyEvent.reset();
+
+        if (m_nccl.IsSupported())
+        {
+            m_nccl.AllReduce(data, data, bucket.numElements);
+            m_nccl.Sync();
+        }
+        else if (ShouldCopyDataToCPU(deviceId))
+        {
+            ElemType* cpuData = bucket.intermediateCPUBuffer.get();
+            bucket.gpuDataTransferer->CopyGPUToCPUAsync(data, bucket.numElements, cpuData);
+            bucket.gpuDataTransferer->WaitForCopyGPUToCPUAsync();
+            m_mpi->AllReduce(cpuData, bucket.numElements);
+            bucket.gpuDataTransferer->CopyCPUToGPUAsync(cpuData, bucket.numElements, data);
+            bucket.gpuDataTransferer->WaitForCopyCPUToGPUAsync();
+        }
+        else
+        {
+            m_mpi->AllReduce(data, bucket.numElements);
+        }
+    }
+
+    void AggregateGradientsInBuckets(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool showSyncPerfStats)
+    {
+        if (gradients != m_bucketedGradients)
+            LogicError("SimpleDistGradAggregator: The gradients to aggregate differ from the ones the buckets were formed for.");
+
+        Timer waitTimer;
+        if (showSyncPerfStats)
+            waitTimer.Start();
+
+        std::exception_ptr error;
+        {
+            std::unique_lock<std::mutex> lock(m_bucketMutex);
+            if (headerCPU->numSamples == 0)
+            {
+                // If the current node did not process any samples, the gradients should be zero'd
+                // (no backprop happened, so none of the buckets can have been launched)
+                assert(m_numLaunchedBuckets == 0);
+                for (auto gradient : gradients)
+                    gradient->SetValue(0);
+            }
+
+            // launch the remaining buckets: gradients not computed by the backprop, or aggregation without preceding OnGradientReady() calls
+            for (auto& bucket : m_buckets)
+                bucket.numGradientsPending = 0;
+            LaunchReadyBuckets();
+
+            m_bucketsDone.wait(lock, [this] { return m_numCompletedBuckets == m_buckets.size(); });
+
+            // reset for the next minibatch
+            error = m_bucketError;
+            m_bucketError = nullptr;
+            m_numLaunchedBuckets = 0;
+            m_numCompletedBuckets = 0;
+            for (auto& bucket : m_buckets)
+                bucket.numGradientsPending = bucket.gradientIndices.size();
+            m_gradientReady.assign(m_gradientReady.size(), false);
+        }
+        if (error)
+            std::rethrow_exception(error);
+
+        if (showSyncPerfStats)
+            waitTimer.Stop();
+
+        // Copy data back to the gradients from the packed buckets
+        for (auto& bucket : m_buckets)
+        {
+            if (!bucket.packedGradients)
+                continue;
+
+            size_t offset = 0;
+            for (size_t i : bucket.gradientIndices)
+            {
+                gradients[i]->AssignValuesOf(bucket.packedGradients->ColumnSlice(offset, gradients[i]->GetNumElements()).Reshaped(gradients[i]->GetNumRows(), gradients[i]->GetNumCols()));
+                offset += gradients[i]->GetNumElements();
+            }
+        }
+
+        std::vector<MPI_Request> recvHeaderRequests;
+        MPI_Request sendHeaderRequest;
+        StartHeaderAggregation(headerCPU, gradients.size(), recvHeaderRequests, sendHeaderRequest);
+        AggregateHeaders(headerCPU, recvHeaderRequests);
+        FinishHeaderAggregation(sendHeaderRequest);
+
+        if (showSyncPerfStats)
+        {
+            m_bucketTimer.Stop();
+            for (size_t b = 0; b < m_buckets.size(); b++)
+            {
+                fprintf(stderr, "Gradient bucket %d: %d gradients, %.1f KB, launched at %.6g, all-reduce time: %.6g\n",
+                        (int)b, (int)m_buckets[b].gradientIndices.size(), m_buckets[b].numElements * sizeof(ElemType) / 1024.0,
+                        m_buckets[b].launchTime, m_buckets[b].allReduceTime);
+            }
+            fprintf(stderr, "Gradient aggregation wait time after backprop: %.6g\n", waitTimer.ElapsedSeconds());
+            fprintf(stderr, "Actual gradient aggregation time: %.6g\n", m_bucketTimer.ElapsedSeconds());
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    // aggregation of the headers: the main node receives the headers of all other nodes, aggregates and broadcasts them
+    // -----------------------------------------------------------------------
+
+    void StartHeaderAggregation(DistGradHeader* headerCPU, size_t tag, std::vector<MPI_Request>& recvHeaderRequests, MPI_Request& sendHeaderRequest)
+    {
+        // Initiate receive of the header on the main node
+        recvHeaderRequests.resize(NumProc() - 1);
+        if (m_mpi->IsMainNode())
+        {
+            for (size_t j = 0; j < NumProc() - 1; ++j)
+            {
+                int source = (j >= MyRank()) ? (j + 1) : j;
+                m_mpi->Irecv(m_recvHeaders[j], m_recvHeaders[j]->Size(), MPI_CHAR, source, tag, &(recvHeaderRequests[j])) || MpiFail("MPI_Irecv");
+            }
+        }
+
+        // Send the headers from all nodes but the main node
+        if (!m_mpi->IsMainNode())
+            m_mpi->Isend(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), tag, &sendHeaderRequest) || MpiFail("MPI_Isend");
+    }
+
+    void AggregateHeaders(DistGradHeader* headerCPU, std::vector<MPI_Request>& recvHeaderRequests)
+    {
+        // On the main node wait for the headers to arrive and aggregate
+        if (m_mpi->IsMainNode())
+        {
+            size_t numNodesHeadersReceivedFrom = 0;
+            while (numNodesHeadersReceivedFrom < (NumProc() - 1))
+            {
+                int idx = MPI_UNDEFINED;
+                m_mpi->Waitany(recvHeaderRequests.size(), recvHeaderRequests.data(), &idx, MPI_STATUS_IGNORE) || MpiFail("MPI_Waitany");
+                if (idx == MPI_UNDEFINED)
+                {
+                    break;
+                }
+
+                numNodesHeadersReceivedFrom++;
+
+                headerCPU->Aggregate(m_recvHeaders[idx], true);
+            }
+
+            assert(numNodesHeadersReceivedFrom == (NumProc() - 1));
+        }
+
+        // Broadcast the aggregated header to all nodes
+        m_mpi->Bcast(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank());
+    }
+
+    void FinishHeaderAggregation(MPI_Request& sendHeaderRequest)
+    {
+        // Wait for completion of the async send requests
+        if (!m_mpi->IsMainNode())
+            m_mpi->Wait(&sendHeaderRequest, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+    }
+
     void AggregateGradientsImpl(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool showSyncPerfStats)
     {
         Timer aggregationTimer;
@@ -309,22 +647,10 @@ private:
             }
         }
 
-        // Initiate receive of the header on the main node
-        std::vector<MPI_Request> recvHeaderRequests(NumProc() - 1);
-        if (m_mpi->IsMainNode())
-        {
-            for (size_t j = 0; j < NumProc() - 1; ++j)
-            {
-                int source = (j >= MyRank()) ? (j + 1) : j;
-                // We use a tag of 'numGradMatrices' for the pre-aggregation header
-                m_mpi->Irecv(m_recvHeaders[j], m_recvHeaders[j]->Size(), MPI_CHAR, source, numGradMatrices, &(recvHeaderRequests[j])) || MpiFail("MPI_Irecv");
-            }
-        }
-
-        // Send the headers from all nodes but the main node
+        // We use a tag of 'numGradMatrices' for the pre-aggregation header
+        std::vector<MPI_Request> recvHeaderRequests;
         MPI_Request sendHeaderRequest;
-        if (!m_mpi->IsMainNode())
-            m_mpi->Isend(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), numGradMatrices, &sendHeaderRequest) || MpiFail("MPI_Isend");
+        StartHeaderAggregation(headerCPU, numGradMatrices, recvHeaderRequests, sendHeaderRequest);
 
         // Perform async allreduce on the gradient data
         std::vector<MPI_Request> allReduceRequests;
@@ -365,29 +691,7 @@ private:
             m_nccl.AllReduce(ncclReduceGradients);
         }
 
-        // On the main node wait for the headers to arrive and aggregate
-        if (m_mpi->IsMainNode())
-        {
-            size_t numNodesHeadersReceivedFrom = 0;
-            while (numNodesHeadersReceivedFrom < (NumProc() - 1))
-            {
-                int idx = MPI_UNDEFINED;
-                m_mpi->Waitany(recvHeaderRequests.size(), recvHeaderRequests.data(), &idx, MPI_STATUS_IGNORE) || MpiFail("MPI_Waitany");
-                if (idx == MPI_UNDEFINED)
-                {
-                    break;
-                }
-
-                numNodesHeadersReceivedFrom++;
-
-                headerCPU->Aggregate(m_recvHeaders[idx], true);
-            }
-
-            assert(numNodesHeadersReceivedFrom == (NumProc() - 1));
-        }
-
-        // Broadcast the aggregated header to all nodes
-        m_mpi->Bcast(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank());
+        AggregateHeaders(headerCPU, recvHeaderRequests);
 
         if (m_nccl.IsSupported())
         {
@@ -426,9 +730,7 @@ private:
             offset += gradients[i]->GetNumElements();
         }
 
-        // Wait for completion of the async send requests
-        if (!m_mpi->IsMainNode())
-            m_mpi->Wait(&sendHeaderRequest, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+        FinishHeaderAggregation(sendHeaderRequest);
 
         if (showSyncPerfStats)
         {
@@ -463,6 +765,37 @@ private:
     std::vector<size_t> m_packedGradientsIndex;
     std::vector<size_t> m_gradientIndexToAggregate;
 
+    // Gradient bucketing (see AggregateGradientsInBuckets()), enabled by a bucket size > 0 (tunable by define "gradientBucketSizeInKB=[value]")
+    struct GradientBucket
+    {
+        GradientBucket() : numElements(0), numGradientsPending(0), launchTime(0), allReduceTime(0) {}
+
+        std::vector<size_t> gradientIndices;
+        size_t numElements;
+        std::unique_ptr<Matrix<ElemType>> packedGradients;      // contiguous copy of the gradients, nullptr if the bucket holds a single gradient
+        std::shared_ptr<ElemType> intermediateCPUBuffer;        // only if the data is copied to the CPU for the all-reduce
+        std::unique_ptr<GPUDataTransferer> gpuDataTransferer;
+        std::unique_ptr<MatrixComputeStreamEvent> readyEvent;   // recorded when the bucket is launched
+        size_t numGradientsPending;                             // gradients not yet ready in the current minibatch
+        double launchTime;                                      // seconds after the launch of the first bucket
+        double allReduceTime;                                   // seconds spent on the communication thread, including copies
+    };
+    const size_t m_bucketSizeInBytes;
+    std::vector<GradientBucket> m_buckets;
+    std::vector<Matrix<ElemType>*> m_bucketedGradients;         // the gradients the buckets were formed for
+    std::vector<size_t> m_bucketIndex;                          // bucket of each gradient
+    std::vector<bool> m_gradientReady;
+    size_t m_numLaunchedBuckets;
+    size_t m_numCompletedBuckets;
+    std::deque<size_t> m_bucketQueue;                           // launched buckets waiting for the communication thread
+    std::exception_ptr m_bucketError;
+    Timer m_bucketTimer;
+    std::mutex m_bucketMutex;                                   // guards all of the above that changes per minibatch
+    std::condition_variable m_bucketWork;
+    std::condition_variable m_bucketsDone;
+    std::thread m_communicationThread;
+    bool m_stopCommunication;
+
     int m_syncStatsTrace;
 
     // Only used for controlling frequency of measuring/showing gradient aggregation perf stats
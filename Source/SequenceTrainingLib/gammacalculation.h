@@ -100,7 +100,6 @@ public:
     {
         // check total frame number to be added ?
         // int deviceid = loglikelihood.GetDeviceId();
-        size_t boundaryframenum;
         std::vector<size_t> validframes; // [s] cursor pointing to next utterance begin within a single parallel sequence [s]
         validframes.assign(samplesInRecurrentStep, 0);
         ElemType objectValue = 0.0;
@@ -126,15 +125,32 @@ public:
             assert(T == pMBLayout->GetNumTimeSteps());
         }
 
-        size_t mapi = 0; // parallel-sequence index for utterance [i]
-        // cal gamma for each utterance
+        // Per utterance, we copy its LLs into 'pred', run the lattice forward/backward, and copy the resulting gammas back.
+        // On the GPU, the LLs and gammas of one lattice at a time live on the device, so this is done one utterance after the other.
+        // On the CPU, all lattices are independent; we copy all LLs first, process the lattices concurrently, and then copy all gammas back.
+        struct utterance
+        {
+            size_t ts;         // first column in 'pred' and 'dengammas'
+            size_t numframes;
+            size_t mapi;       // parallel-sequence index
+            size_t firstframe; // time step of first frame within parallel sequence [mapi]
+            double numavlogp;
+            double denavlogp;
+        };
+        std::vector<utterance> utterances(lattices.size());
+
+        // copy the LLs of utterance [i] into 'pred'
         size_t ts = 0;
-        for (size_t i = 0; i < lattices.size(); i++)
+        auto prepareutterance = [&](size_t i)
         {
-            const size_t numframes = lattices[i]->getnumframes();
+            auto& utt = utterances[i];
+            utt.ts = ts;
+            utt.numframes = lattices[i]->getnumframes();
+            utt.mapi = 0;
+            utt.firstframe = 0;
+            const size_t numframes = utt.numframes;
 
-            msra::dbn::matrixstripe predstripe(pred, ts, numframes);           // logLLs for this utterance
-            msra::dbn::matrixstripe dengammasstripe(dengammas, ts, numframes); // denominator gammas
+            msra::dbn::matrixstripe predstripe(pred, ts, numframes); // logLLs for this utterance
 
             if (samplesInRecurrentStep == 1) // no sequence parallelism
             {
@@ -150,7 +166,9 @@ public:
             else // multiple parallel sequences
             {
                 // get number of frames for the utterance
-                mapi = extrauttmap[i]; // parallel-sequence index; in case of >1 utterance within this parallel sequence, this is in order of concatenation
+                size_t mapi = extrauttmap[i]; // parallel-sequence index; in case of >1 utterance within this parallel sequence, this is in order of concatenation
+                utt.mapi = mapi;
+                utt.firstframe = validframes[mapi];
 
                 // scan MBLayout for end of utterance
                 size_t mapframenum = SIZE_MAX; // duration of utterance [i] as determined from MBLayout
@@ -184,17 +202,24 @@ public:
                 {
                     parallellattice.setloglls(tempmatrix);
                 }
+                validframes[mapi] += numframes; // advance the cursor within the parallel sequence
             }
+            ts += numframes;
+        };
 
-            array_ref<size_t> uidsstripe(&uids[ts], numframes);
+        // lattice forward/backward for utterance [i]; only touches the utterance's stripes of 'pred', 'dengammas', 'uids', and 'boundaries'
+        auto computeutterance = [&](size_t i)
+        {
+            auto& utt = utterances[i];
+            const size_t numframes = utt.numframes;
 
-            if (doreferencealign)
-            {
-                boundaryframenum = numframes;
-            }
-            else
-                boundaryframenum = 0;
-            array_ref<size_t> boundariesstripe(&boundaries[ts], boundaryframenum);
+            msra::dbn::matrixstripe predstripe(pred, utt.ts, numframes);           // logLLs for this utterance
+            msra::dbn::matrixstripe dengammasstripe(dengammas, utt.ts, numframes); // denominator gammas
+
+            array_ref<size_t> uidsstripe(&uids[utt.ts], numframes);
+
+            const size_t boundaryframenum = doreferencealign ? numframes : 0;
+            array_ref<size_t> boundariesstripe(&boundaries[utt.ts], boundaryframenum);
 
             double numavlogp = 0;
             foreach_column (t, dengammasstripe) // we do not allocate memory for numgamma now, should be the same as numgammasstripe
@@ -203,23 +228,33 @@ public:
                 numavlogp += predstripe(s, t) / amf;
             }
             numavlogp /= numframes;
+            utt.numavlogp = numavlogp;
 
             // auto_timer dengammatimer;
-            double denavlogp = lattices[i]->second.forwardbackward(parallellattice,
-                                                                   (const msra::math::ssematrixbase&) predstripe, (const msra::asr::simplesenonehmm&) m_hset,
-                                                                   (msra::math::ssematrixbase&) dengammasstripe, (msra::math::ssematrixbase&) gammasbuffer /*empty, not used*/,
-                                                                   lmf, wp, amf, boostmmifactor, seqsMBRmode, uidsstripe, boundariesstripe);
-            objectValue += (ElemType)((numavlogp - denavlogp) * numframes);
+            utt.denavlogp = lattices[i]->second.forwardbackward(parallellattice,
+                                                                (const msra::math::ssematrixbase&) predstripe, (const msra::asr::simplesenonehmm&) m_hset,
+                                                                (msra::math::ssematrixbase&) dengammasstripe, (msra::math::ssematrixbase&) gammasbuffer /*empty, not used*/,
+                                                                lmf, wp, amf, boostmmifactor, seqsMBRmode, uidsstripe, boundariesstripe);
+        };
+
+        // copy the gammas of utterance [i] into 'gammafromlattice'
+        auto finishutterance = [&](size_t i)
+        {
+            const auto& utt = utterances[i];
+            const size_t numframes = utt.numframes;
+            const size_t mapi = utt.mapi;
+            objectValue += (ElemType)((utt.numavlogp - utt.denavlogp) * numframes);
 
             if (samplesInRecurrentStep == 1)
             {
-                tempmatrix = gammafromlattice.ColumnSlice(ts, numframes);
+                tempmatrix = gammafromlattice.ColumnSlice(utt.ts, numframes);
             }
 
             // copy gamma to tempmatrix
             if (m_deviceid == CPUDEVICE)
             {
-                CopyFromSSEMatrixToCNTKMatrix(dengammas, numrows, numframes, tempmatrix, gammafromlattice.GetDeviceId());
+                msra::dbn::matrixstripe dengammasstripe(dengammas, utt.ts, numframes);
+                CopyFromSSEMatrixToCNTKMatrix(dengammasstripe, numrows, numframes, tempmatrix, gammafromlattice.GetDeviceId());
             }
             else
                 parallellattice.getgamma(tempmatrix);
@@ -227,7 +262,7 @@ public:
             // set gamma for multi channel
             if (samplesInRecurrentStep > 1)
             {
-                Microsoft::MSR::CNTK::Matrix<ElemType> gammaFromLatticeForCurrentParallelUtterance = gammafromlattice.ColumnSlice(mapi + (validframes[mapi] * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
+                Microsoft::MSR::CNTK::Matrix<ElemType> gammaFromLatticeForCurrentParallelUtterance = gammafromlattice.ColumnSlice(mapi + (utt.firstframe * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
                 gammaFromLatticeForCurrentParallelUtterance.CopyColumnsStrided(tempmatrix, numframes, 1, samplesInRecurrentStep);
             }
 
@@ -235,17 +270,51 @@ public:
             {
                 for (size_t nframe = 0; nframe < numframes; nframe++)
                 {
-                    size_t uid = uidsstripe[nframe];
+                    size_t uid = uids[utt.ts + nframe];
                     if (samplesInRecurrentStep > 1)
-                        labels(uid, (nframe + validframes[mapi]) * samplesInRecurrentStep + mapi) = 1.0;
+                        labels(uid, (nframe + utt.firstframe) * samplesInRecurrentStep + mapi) = 1.0;
                     else
-                        labels(uid, ts + nframe) = 1.0;
+                        labels(uid, utt.ts + nframe) = 1.0;
                 }
             }
-            if (samplesInRecurrentStep > 1)
-                validframes[mapi] += numframes; // advance the cursor within the parallel sequence
-            fprintf(stderr, "dengamma value %f\n", denavlogp);
-            ts += numframes;
+            fprintf(stderr, "dengamma value %f\n", utt.denavlogp);
+        };
+
+        if (parallellattice.enabled())
+        {
+            for (size_t i = 0; i < lattices.size(); i++)
+            {
+                prepareutterance(i);
+                computeutterance(i);
+                finishutterance(i);
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < lattices.size(); i++)
+                prepareutterance(i);
+
+            // Large lattices are processed with parallel loops inside forwardbackward() if only one lattice is in flight.
+            std::exception_ptr error;
+#pragma omp parallel for schedule(dynamic, 1) if (lattices.size() > 1)
+            for (int i = 0; i < (int) lattices.size(); i++)
+            {
+                try
+                {
+                    computeutterance(i);
+                }
+                catch (...)
+                {
+#pragma omp critical
+                    if (!error)
+                        error = std::current_exception();
+                }
+            }
+            if (error)
+                std::rethrow_exception(error);
+
+            for (size_t i = 0; i < lattices.size(); i++)
+                finishutterance(i);
         }
         functionValues.SetValue(objectValue);
     }
@@ -15,6 +15,9 @@
 #include <unordered_map>
 #include <list>
 #include <stdexcept>
+#include <exception>
+#include <memory>
+#include <omp.h>
 
 using namespace std;
 
@@ -131,6 +134,181 @@ static bool islogzero(FLOAT v)
     return v < LOGZERO / 2;
 } // is this number to be considered 0
 
+// ---------------------------------------------------------------------------
+// helpers for parallel processing on the CPU
+// ---------------------------------------------------------------------------
+
+// run body(k) for k in [0, n), in parallel if requested; the first exception is rethrown on the calling thread
+template <class BODY>
+static void parallelforeach(size_t n, bool parallel, const BODY &body)
+{
+    std::exception_ptr error;
+#pragma omp parallel for schedule(dynamic, 16) if (parallel)
+    for (int k = 0; k < (int) n; k++)
+    {
+        try
+        {
+            body((size_t) k);
+        }
+        catch (...)
+        {
+#pragma omp critical
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+size_t lattice::parallelminedges = 4096;
+
+// number of chunks to split a loop over 'n' items into for parallel processing (1 = sequential)
+// When called from the parallel loop over the lattices of a minibatch, we stay sequential.
+/*static*/ size_t lattice::numparallelchunks(size_t n, size_t numedges)
+{
+    if (numedges < parallelminedges || omp_in_parallel())
+        return 1;
+    return min(n, (size_t) 4 * omp_get_max_threads());
+}
+
+// ---------------------------------------------------------------------------
+// latticelevels -- nodes of a lattice grouped into topological levels, for
+// running the lattice-level forward/backward recursions in parallel
+//
+// The forward level of a node is the length of the longest path from the start
+// node to it, so all its predecessors are on lower levels; the nodes within a
+// level can be processed concurrently. Likewise for the backward recursion with
+// the longest path to the end node. Each node accumulates its edges in the same
+// order as the sequential recursion (ascending edge index for alphas, descending
+// for betas), so the results are identical.
+// ---------------------------------------------------------------------------
+
+class latticelevels
+{
+    std::vector<size_t> fwnodes;      // nodes ordered by forward level, nodes without incoming edges excluded
+    std::vector<size_t> fwlevelbegin; // [level] -> first index into fwnodes; one extra entry at the end
+    std::vector<size_t> inedgebegin;  // [node] -> first index into inedges; one extra entry at the end
+    std::vector<size_t> inedges;      // edges grouped by end node, in ascending order within each node
+    std::vector<size_t> bwnodes;      // nodes ordered by backward level, nodes without outgoing edges excluded
+    std::vector<size_t> bwlevelbegin; // [level] -> first index into bwnodes; one extra entry at the end
+    std::vector<size_t> outedgebegin; // [node] -> first index into outedges; one extra entry at the end
+    std::vector<size_t> outedges;     // edges grouped by start node, in descending order within each node
+
+    // group the nodes with level >= 1 by level (counting sort)
+    static void sortbylevel(const std::vector<size_t> &levels, std::vector<size_t> &sortednodes, std::vector<size_t> &levelbegin)
+    {
+        const size_t numlevels = levels.empty() ? 1 : *std::max_element(levels.begin(), levels.end()) + 1;
+        levelbegin.assign(numlevels + 1, 0);
+        for (size_t level : levels)
+            levelbegin[level + 1]++;
+        levelbegin[1] = 0; // level 0 is excluded
+        for (size_t level = 1; level < numlevels; level++)
+            levelbegin[level + 1] += levelbegin[level];
+        levelbegin[0] = 0;
+        sortednodes.resize(levelbegin[numlevels]);
+        std::vector<size_t> pos(levelbegin.begin(), levelbegin.end() - 1);
+        for (size_t i = 0; i < levels.size(); i++)
+            if (levels[i] > 0)
+                sortednodes[pos[levels[i]]++] = i;
+    }
+
+public:
+    latticelevels(const std::vector<nodeinfo> &nodes, const std::vector<edgeinfowithscores> &edges)
+    {
+        const size_t numnodes = nodes.size();
+        std::vector<size_t> levels(numnodes, 0);
+
+        // forward levels; the start node of an edge is always final when we get to it (same assumption as the recursion itself)
+        inedgebegin.assign(numnodes + 1, 0);
+        for (size_t j = 0; j < edges.size(); j++)
+        {
+            const auto &e = edges[j];
+            levels[e.E] = max(levels[e.E], levels[e.S] + 1);
+            inedgebegin[e.E + 1]++;
+        }
+        for (size_t i = 0; i < numnodes; i++)
+            inedgebegin[i + 1] += inedgebegin[i];
+        inedges.resize(edges.size());
+        std::vector<size_t> inpos(inedgebegin.begin(), inedgebegin.end() - 1);
+        for (size_t j = 0; j < edges.size(); j++)
+            inedges[inpos[edges[j].E]++] = j;
+        sortbylevel(levels, fwnodes, fwlevelbegin);
+
+        // backward levels; the end node of an edge is always final when we get to it in reverse order
+        levels.assign(numnodes, 0);
+        outedgebegin.assign(numnodes + 1, 0);
+        for (size_t j = edges.size(); j-- > 0;)
+        {
+            const auto &e = edges[j];
+            levels[e.S] = max(levels[e.S], levels[e.E] + 1);
+            outedgebegin[e.S + 1]++;
+        }
+        for (size_t i = 0; i < numnodes; i++)
+            outedgebegin[i + 1] += outedgebegin[i];
+        outedges.resize(edges.size());
+        std::vector<size_t> pos(outedgebegin.begin(), outedgebegin.end() - 1);
+        for (size_t j = edges.size(); j-- > 0;)
+            outedges[pos[edges[j].S]++] = j;
+        sortbylevel(levels, bwnodes, bwlevelbegin);
+    }
+
+    // call f(j) for all edges such that all edges into a node are processed before any edge out of it
+    template <class EDGEFUNCTION>
+    void forward(const EDGEFUNCTION &f) const
+    {
+#pragma omp parallel
+        for (size_t level = 1; level + 1 < fwlevelbegin.size(); level++)
+        {
+#pragma omp for schedule(dynamic, 8)
+            for (int k = (int) fwlevelbegin[level]; k < (int) fwlevelbegin[level + 1]; k++)
+            {
+                const size_t i = fwnodes[k];
+                for (size_t k2 = inedgebegin[i]; k2 < inedgebegin[i + 1]; k2++)
+                    f(inedges[k2]);
+            }
+        }
+    }
+
+    // call f(j) for all edges such that all edges out of a node are processed before any edge into it
+    template <class EDGEFUNCTION>
+    void backward(const EDGEFUNCTION &f) const
+    {
+#pragma omp parallel
+        for (size_t level = 1; level + 1 < bwlevelbegin.size(); level++)
+        {
+#pragma omp for schedule(dynamic, 8)
+            for (int k = (int) bwlevelbegin[level]; k < (int) bwlevelbegin[level + 1]; k++)
+            {
+                const size_t i = bwnodes[k];
+                for (size_t k2 = outedgebegin[i]; k2 < outedgebegin[i + 1]; k2++)
+                    f(outedges[k2]);
+            }
+        }
+    }
+};
+
+// forward and backward edge loops of the lattice-level recursions, levelized if 'levels' is given
+template <class EDGEFUNCTION>
+static void foreachedgeforward(const latticelevels *levels, size_t numedges, const EDGEFUNCTION &f)
+{
+    if (levels)
+        levels->forward(f);
+    else
+        for (size_t j = 0; j < numedges; j++)
+            f(j);
+}
+
+template <class EDGEFUNCTION>
+static void foreachedgebackward(const latticelevels *levels, size_t numedges, const EDGEFUNCTION &f)
+{
+    if (levels)
+        levels->backward(f);
+    else
+        for (size_t j = numedges; j-- > 0;)
+            f(j);
+}
+
 // ---------------------------------------------------------------------------
 // other helpers go here
 // ---------------------------------------------------------------------------
@@ -517,6 +695,11 @@ double lattice::forwardbackwardlattice(const std::vector<float> &edgeacscores, p
     logbetas.assign(nodes.size(), LOGZERO);
     logbetas.back() = 0.0f;
 
+    // large lattices are processed level by level, with the nodes of a level in parallel
+    std::unique_ptr<latticelevels> levels;
+    if (numparallelchunks(nodes.size(), edges.size()) > 1)
+        levels.reset(new latticelevels(nodes, edges));
+
     // --- sMBR version
 
     if (sMBRmode)
@@ -529,10 +712,10 @@ double lattice::forwardbackwardlattice(const std::vector<float> &edgeacscores, p
         std::vector<double> logframescorrectedge(edges.size());  // raw counts of correct frames in each edge
 
         // forward pass
-        foreach_index (j, edges)
+        foreachedgeforward(levels.get(), edges.size(), [&](size_t j)
         {
             if (islogzero(edgeacscores[j])) // indicates that this edge is pruned
-                continue;
+                return;
             const auto &e = edges[j];
             const double inscore = logalphas[e.S];
             const double edgescore = (e.l * lmf + wp + edgeacscores[j]) / amf;
@@ -549,7 +732,7 @@ double lattice::forwardbackwardlattice(const std::vector<float> &edgeacscores, p
             logadd(loginaccs, logframescorrectedge[j]);
             double logpathacc = loginaccs + logalphas[e.S] + edgescore;
             logadd(logaccalphas[e.E], logpathacc);
-        }
+        });
         foreach_index (j, logaccalphas)
             logaccalphas[j] -= logalphas[j];
 
@@ -562,10 +745,10 @@ double lattice::forwardbackwardlattice(const std::vector<float> &edgeacscores, p
         }
 
         // backward pass and computation of state-conditioned frames-correct count
-        for (size_t j = edges.size() - 1; j + 1 > 0; j--)
+        foreachedgebackward(levels.get(), edges.size(), [&](size_t j)
         {
             if (islogzero(edgeacscores[j])) // indicates that this edge is pruned
-                continue;
+                return;
             const auto &e = edges[j];
             const double inscore = logbetas[e.E];
             const double edgescore = (e.l * lmf + wp + edgeacscores[j]) / amf;
@@ -588,7 +771,7 @@ double lattice::forwardbackwardlattice(const std::vector<float> &edgeacscores, p
             logadd(tmplogeframecorrect, logaccalphas[e.S]);
             logadd(tmplogeframecorrect, logaccbetas[e.E] - logbetas[e.E]);
             Eframescorrectbuf[j] = exp(tmplogeframecorrect);
-        }
+        });
         foreach_index (j, logaccbetas)
             logaccbetas[j] -= logbetas[j];
         const double totalbwscore = logbetas.front();
@@ -606,14 +789,14 @@ double lattice::forwardbackwardlattice(const std::vector<float> &edgeacscores, p
     // --- MMI version
 
     // forward pass
-    foreach_index (j, edges)
+    foreachedgeforward(levels.get(), edges.size(), [&](size_t j)
     {
         const auto &e = edges[j];
         const double inscore = logalphas[e.S];
         const double edgescore = (e.l * lmf + wp + edgeacscores[j]) / amf; // note: edgeacscores[j] == LOGZERO if edge was pruned
         const double pathscore = inscore + edgescore;
         logadd(logalphas[e.E], pathscore);
-    }
+    });
     const double totalfwscore = logalphas.back();
     if (islogzero(totalfwscore))
     {
@@ -623,7 +806,7 @@ double lattice::forwardbackwardlattice(const std::vector<float> &edgeacscores, p
 
     // backward pass
     // this also computes the word posteriors on the fly, since we are at it
-    for (size_t j = edges.size() - 1; j + 1 > 0; j--)
+    foreachedgebackward(levels.get(), edges.size(), [&](size_t j)
     {
         const auto &e = edges[j];
         const double inscore = logbetas[e.E];
@@ -638,7 +821,7 @@ double lattice::forwardbackwardlattice(const std::vector<float> &edgeacscores, p
         if (logpp > 0.0)
             logpp = 0.0;
         logpps[j] = logpp;
-    }
+    });
 
     const double totalbwscore = logbetas.front();
     if (fabs(totalfwscore - totalbwscore) / info.numframes > 1e-4)
@@ -952,7 +1135,11 @@ void lattice::forwardbackwardalign(parallelstate &parallelstate,
             parallelstate.getedgeacscores(edgeacscoresgpu);
             parallelstate.copyalignments(thisedgealignmentsgpu);
         }
-        foreach_index (j, edges)
+        // edges are aligned independently (each has its own abcs[j] and alignment), so we can do them in parallel,
+        // unless we are already running in parallel over the lattices of a minibatch, or verifying against the GPU
+        if (!softalignstates)
+            thisedgealignments.getalignmentsbuffer(); // allocated lazily by operator[], which must not happen concurrently
+        parallelforeach(edges.size(), !cpuverification && !omp_in_parallel(), [&](size_t j)
         {
             const edgeinfowithscores &e = edges[j];
             const size_t ts = nodes[e.S].t;
@@ -982,7 +1169,7 @@ void lattice::forwardbackwardalign(parallelstate &parallelstate,
                 if (fabs(edgeacscores[j] - edgeacscoresgpu[j]) > 1e-3)
                 {
                     fprintf(stderr, "edge %d, sil ? %d, edgeacscores / edgeacscoresgpu MISMATCH %f v.s. %f, diff %e\n",
-                            j, edgehassil ? 1 : 0, (float) edgeacscores[j], (float) edgeacscoresgpu[j],
+                            (int) j, edgehassil ? 1 : 0, (float) edgeacscores[j], (float) edgeacscoresgpu[j],
                             (float) (edgeacscores[j] - edgeacscoresgpu[j]));
                     fprintf(stderr, "aligntokens: ");
                     foreach_index (i, aligntokens)
@@ -992,10 +1179,10 @@ void lattice::forwardbackwardalign(parallelstate &parallelstate,
                 for (size_t t = ts; t < te; t++)
                 {
                     if (thisedgealignments[j][t - ts] != thisedgealignmentsgpu[j][t - ts])
-                        fprintf(stderr, "edge %d, sil ? %d, time %d, alignment / alignmentgpu MISMATCH %d v.s. %d\n", j, edgehassil ? 1 : 0, (int) (t - ts), thisedgealignments[j][t - ts], thisedgealignmentsgpu[j][t - ts]);
+                        fprintf(stderr, "edge %d, sil ? %d, time %d, alignment / alignmentgpu MISMATCH %d v.s. %d\n", (int) j, edgehassil ? 1 : 0, (int) (t - ts), thisedgealignments[j][t - ts], thisedgealignmentsgpu[j][t - ts]);
                 }
             }
-        }
+        });
     }
 }
 
@@ -1017,30 +1204,42 @@ void lattice::sMBRerrorsignal(parallelstate &parallelstate,
     }
 
     //  linear mode
-    foreach_coord (i, j, errorsignal)
-        errorsignal(i, j) = 0.0f; // Note: we don't actually put anything into the numgammas
-    foreach_index (j, edges)
+    // For large lattices, the frames are split into chunks that are processed in parallel. Each chunk visits the
+    // edges in the same order as the sequential loop, so the accumulation order per element does not change.
+    const size_t numframes = errorsignal.cols();
+    const size_t numchunks = numparallelchunks(numframes, edges.size());
+    parallelforeach(numchunks, numchunks > 1, [&](size_t chunk)
     {
-        const auto &e = edges[j];
-        if (nodes[e.S].t == nodes[e.E].t) // this happens for dummy !NULL edge at end of file
-            continue;
-        if (minlogpp > LOGZERO && origlogpps[j] < minlogpp) // this is pruned
-            continue;
+        const size_t t0 = numframes * chunk / numchunks;
+        const size_t t1 = numframes * (chunk + 1) / numchunks;
+        for (size_t t = t0; t < t1; t++)
+            for (size_t i = 0; i < errorsignal.rows(); i++)
+                errorsignal(i, t) = 0.0f; // Note: we don't actually put anything into the numgammas
+        foreach_index (j, edges)
+        {
+            const auto &e = edges[j];
+            if (nodes[e.S].t == nodes[e.E].t) // this happens for dummy !NULL edge at end of file
+                continue;
+            if (minlogpp > LOGZERO && origlogpps[j] < minlogpp) // this is pruned
+                continue;
 
-        size_t ts = nodes[e.S].t;
-        size_t te = nodes[e.E].t;
+            size_t ts = nodes[e.S].t;
+            size_t te = nodes[e.E].t;
+            if (te <= t0 || ts >= t1) // not in this chunk
+                continue;
 
-        const double diff = logEframescorrect[j] - logEframescorrecttotal;
-        // Note: the contribution of the states of an edge to their senones is the same for all states
-        // so we compute it once and add it to all; this will not be the case without hard alignments.
-        const double pp = exp(logpps[j]); // edge posterior
-        const float edgecorrect = (float) (pp * diff) / amf;
-        for (size_t t = ts; t < te; t++)
-        {
-            const size_t s = thisedgealignments[j][t - ts];
-            errorsignal(s, t) += edgecorrect;
+            const double diff = logEframescorrect[j] - logEframescorrecttotal;
+            // Note: the contribution of the states of an edge to their senones is the same for all states
+            // so we compute it once and add it to all; this will not be the case without hard alignments.
+            const double pp = exp(logpps[j]); // edge posterior
+            const float edgecorrect = (float) (pp * diff) / amf;
+            for (size_t t = max(ts, t0); t < min(te, t1); t++)
+            {
+                const size_t s = thisedgealignments[j][t - ts];
+                errorsignal(s, t) += edgecorrect;
+            }
         }
-    }
+    });
 }
 
 // compute the error signal for MMI mode
@@ -1059,56 +1258,69 @@ void lattice::mmierrorsignal(parallelstate &parallelstate, double minlogpp, cons
         return;
     }
 
-    for (size_t j = 0; j < (errorsignal).cols(); j++)
-        for (size_t i = 0; i < (errorsignal).rows(); i++)
-            errorsignal(i, j) = VIRGINLOGZERO; // set to zero  --note: may be in-place with logLLs, which now get overwritten
-
-    // size_t warnings = 0;   // [v-hansu] check code for mmi; search this comment to see all related codes
-    foreach_index (j, edges)
+    // For large lattices, the frames are split into chunks that are processed in parallel. Each chunk visits the
+    // edges in the same order as the sequential loop, so the accumulation order per element does not change.
+    const size_t numframes = errorsignal.cols();
+    const size_t numchunks = numparallelchunks(numframes, edges.size());
+    parallelforeach(numchunks, numchunks > 1, [&](size_t chunk)
     {
-        const auto &e = edges[j];
-        if (nodes[e.S].t == nodes[e.E].t) // this happens for dummy !NULL edge at end of file
-            continue;
-        if (minlogpp > LOGZERO && origlogpps[j] < minlogpp) // this is pruned
-            continue;
-
-        const auto &aligntokens = getaligninfo(j); // get alignment tokens
-        auto &loggammas = *abcs[j];
+        const size_t t0 = numframes * chunk / numchunks;
+        const size_t t1 = numframes * (chunk + 1) / numchunks;
+        for (size_t t = t0; t < t1; t++)
+            for (size_t i = 0; i < errorsignal.rows(); i++)
+                errorsignal(i, t) = VIRGINLOGZERO; // set to zero  --note: may be in-place with logLLs, which now get overwritten
 
-        const float edgelogP = (float) logpps[j];
-        // if (islogzero (edgelogP))               // we had a 0 prob
-        //    continue;
-
-        // accumulate this edge's gamma matrix into target posteriors
-        const size_t tedge = nodes[e.S].t;
-        size_t ts = 0;                 // time index into gamma matrix
-        size_t js = 0;                 // state index into gamma matrix
-        foreach_index (k, aligntokens) // we exploit that units have fixed boundaries
+        // size_t warnings = 0;   // [v-hansu] check code for mmi; search this comment to see all related codes
+        foreach_index (j, edges)
         {
-            const auto &unit = aligntokens[k];
-            const size_t te = ts + unit.frames;
-            const auto &hmm = hset.gethmm(unit.unit); // TODO: inline these expressions
-            const size_t n = hmm.getnumstates();
-            const size_t je = js + n;
-            // P(s) = P(s|e) * P(e)
-            for (size_t t = ts; t < te; t++)
+            const auto &e = edges[j];
+            if (nodes[e.S].t == nodes[e.E].t) // this happens for dummy !NULL edge at end of file
+                continue;
+            if (minlogpp > LOGZERO && origlogpps[j] < minlogpp) // this is pruned
+                continue;
+            if (nodes[e.E].t <= t0 || nodes[e.S].t >= t1) // not in this chunk
+                continue;
+
+            const auto &aligntokens = getaligninfo(j); // get alignment tokens
+            auto &loggammas = *abcs[j];
+
+            const float edgelogP = (float) logpps[j];
+            // if (islogzero (edgelogP))               // we had a 0 prob
+            //    continue;
+
+            // accumulate this edge's gamma matrix into target posteriors
+            const size_t tedge = nodes[e.S].t;
+            const size_t tbegin = max(tedge, t0) - tedge; // range of time indices into gamma matrix that fall into this chunk
+            const size_t tend = min((size_t) nodes[e.E].t, t1) - tedge;
+            size_t ts = 0;                 // time index into gamma matrix
+            size_t js = 0;                 // state index into gamma matrix
+            foreach_index (k, aligntokens) // we exploit that units have fixed boundaries
             {
-                const size_t tutt = t + tedge; // time index w.r.t. utterance
-                // double logsum = LOGZERO;         // [v-hansu] check code for mmi; search this comment to see all related codes
-                for (size_t i = 0; i < n; i++)
+                const auto &unit = aligntokens[k];
+                const size_t te = ts + unit.frames;
+                const auto &hmm = hset.gethmm(unit.unit); // TODO: inline these expressions
+                const size_t n = hmm.getnumstates();
+                const size_t je = js + n;
+                // P(s) = P(s|e) * P(e)
+                for (size_t t = max(ts, tbegin); t < min(te, tend); t++)
                 {
-                    const size_t j2 = js + i;             // state index for this unit in matrix
-                    const size_t s = hmm.getsenoneid(i); // state class index
-                    const float gammajt = loggammas(j2, t);
-                    const float statelogP = edgelogP + gammajt;
-                    logadd(errorsignal(s, tutt), statelogP);
+                    const size_t tutt = t + tedge; // time index w.r.t. utterance
+                    // double logsum = LOGZERO;         // [v-hansu] check code for mmi; search this comment to see all related codes
+                    for (size_t i = 0; i < n; i++)
+                    {
+                        const size_t j2 = js + i;             // state index for this unit in matrix
+                        const size_t s = hmm.getsenoneid(i); // state class index
+                        const float gammajt = loggammas(j2, t);
+                        const float statelogP = edgelogP + gammajt;
+                        logadd(errorsignal(s, tutt), statelogP);
+                    }
                 }
+                ts = te;
+                js = je;
             }
-            ts = te;
-            js = je;
+            assert(ts + 2 == loggammas.cols() && js == loggammas.rows());
         }
-        assert(ts + 2 == loggammas.cols() && js == loggammas.rows());
-    }
+    });
 
     // check normalizedness (is that an actual English word?)
     // also count non-zero probs
@@ -1130,8 +1342,12 @@ void lattice::mmierrorsignal(parallelstate &parallelstate, double minlogpp, cons
     fprintf(stderr, "forwardbackward: %.3f%% non-zero state posteriors\n", 100.0f - nonzerostates * 100.0f / errorsignal.rows() / errorsignal.cols());
 
     // convert to non-log posterior  --that's what we return
-    foreach_coord (i, j, errorsignal)
-        errorsignal(i, j) = expf(errorsignal(i, j));
+    parallelforeach(numchunks, numchunks > 1, [&](size_t chunk)
+    {
+        for (size_t t = numframes * chunk / numchunks; t < numframes * (chunk + 1) / numchunks; t++)
+            for (size_t i = 0; i < errorsignal.rows(); i++)
+                errorsignal(i, t) = expf(errorsignal(i, t));
+    });
 }
 
 // compute ground truth's score
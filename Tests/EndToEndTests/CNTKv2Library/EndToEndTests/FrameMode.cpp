@@ -112,6 +112,7 @@ void TestFrameMode()
     // Create a set of trainers.
     std::map<std::wstring, std::function<DistributedLearnerPtr(LearnerPtr)>> learners;
     learners[L"simple"] = [](LearnerPtr l) { return CreateDataParallelDistributedLearner(MPICommunicator(), l, 0); };
+    learners[L"sparsegradient"] = [](LearnerPtr l) { return CreateSparseGradientDistributedLearner(MPICommunicator(), l, 0, 0.1); };
 
     if (Is1bitSGDAvailable())
     {
@@ -235,3 +236,86 @@ void TestDistributedCheckpointing()
 
     sync->Barrier();
 }
+
+namespace
+{
+    class SparseGradientStatisticsWriter : public ProgressWriter
+    {
+    public:
+        SparseGradientStatisticsWriter() : ProgressWriter(0, 0, 0, 0, 0, 0) {}
+
+        void Write(const std::wstring& key, double value) override
+        {
+            m_values[key].push_back(value);
+        }
+
+        std::map<std::wstring, std::vector<double>> m_values;
+    };
+}
+
+void TestSparseGradientDistributedLearner()
+{
+    std::vector<DeviceDescriptor> devices;
+    if (ShouldRunOnCpu())
+        devices.push_back(DeviceDescriptor::CPUDevice());
+    if (ShouldRunOnGpu())
+        devices.push_back(DeviceDescriptor::GPUDevice(0));
+
+    auto sync = MPICommunicator();
+    const double sparsity = 0.1;
+
+    for (auto device : devices)
+    {
+        auto ff = BuildFeedForwardClassifier(device);
+
+        auto learner = SGDLearner(ff.output->Parameters(), LearningRatePerSampleSchedule(0.02));
+        auto distributedLearner = CreateSparseGradientDistributedLearner(MPICommunicator(), learner, 0, sparsity);
+        auto writer = std::make_shared<SparseGradientStatisticsWriter>();
+        auto trainer = CreateTrainer(ff.output, ff.trainingLoss, ff.prediction, { distributedLearner }, { writer });
+
+        auto minibatchSource = GetMinibatchSource(ff);
+        auto featureStreamInfo = minibatchSource->StreamInfo(g_featureStreamName);
+        auto labelStreamInfo = minibatchSource->StreamInfo(g_labelsStreamName);
+
+        for (size_t i = 0; i < numMinibatchesToTrain; i++)
+        {
+            auto minibatchData = minibatchSource->GetNextMinibatch(minibatchSize, device);
+            if (minibatchData.empty())
+                break;
+
+            unordered_map<Variable, MinibatchData> minibatch = { { ff.features, minibatchData[featureStreamInfo] }, { ff.labels, minibatchData[labelStreamInfo] } };
+            trainer->TrainMinibatch(minibatch, device);
+        }
+
+        // All workers apply the same aggregated gradients, so their parameters must be identical.
+        for (const auto& parameter : ff.output->Parameters())
+        {
+            auto value = MakeSharedObject<NDArrayView>(parameter.GetDataType(), parameter.Shape(), DeviceDescriptor::CPUDevice());
+            value->CopyFrom(*parameter.Value());
+
+            std::vector<NDArrayViewPtr> allValues;
+            sync->Concatenate(std::vector<NDArrayViewPtr>{ value }, allValues, sync->Workers());
+
+            const size_t size = parameter.Shape().TotalSize();
+            const float* data = allValues.front()->DataBuffer<float>();
+            for (size_t w = 1; w < sync->Workers().size(); w++)
+            {
+                if (!std::equal(data, data + size, data + w * size))
+                    ReportFailure("Parameter '%ls' differs between the workers", parameter.Name().c_str());
+            }
+        }
+
+        // The statistics are reported at the end of each sweep; each worker sends a tenth of each gradient.
+        const auto& ratios = writer->m_values[L"Sparse gradient compression ratio"];
+        if (ratios.empty() || ratios.size() != writer->m_values[L"Sparse gradient communication time per minibatch (ms)"].size())
+            ReportFailure("Unexpected number of sparse gradient statistics reports: %d", (int)ratios.size());
+
+        for (auto ratio : ratios)
+        {
+            if (ratio < 1 || ratio > 0.5 / sparsity)
+                ReportFailure("Unexpected sparse gradient compression ratio %g", ratio);
+        }
+    }
+
+    sync->Barrier();
+}
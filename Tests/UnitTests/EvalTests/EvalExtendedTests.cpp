@@ -7,6 +7,8 @@
 #include "ComputationNode.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <functional>
+#include <thread>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -227,6 +229,40 @@ BOOST_AUTO_TEST_CASE(EvalDenseTimesTest)
     eval->Destroy();
 }
 
+BOOST_AUTO_TEST_CASE(EvalQuantizedTimesTest)
+{
+    // The product is computed by a QuantizedTimes node. The bit shift of the input leaves it only 2 bits,
+    // so that the quantization error shows: { 1, 1, 3 } is quantized to { 0.75, 0.75, 3 }.
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "quantizeTimes = true \n"
+        "quantizeBitShiftA = 2 \n"
+        "quantizeBitShiftB = 13 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(3) \n"
+        "o1 = Times(Constant(0.5, rows=1, cols=3), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float> *eval;
+    eval = SetupNetworkAndGetLayouts(modelDefinition, inputLayouts, outputLayouts);
+
+    Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 1 });
+    Values<float> inputBuffer(1);
+    inputBuffer[0].m_buffer = { 1, 1, 3 };
+    eval->ForwardPass(inputBuffer, outputBuffer);
+
+    BOOST_REQUIRE_EQUAL(outputBuffer[0].m_buffer.size(), 1);
+    BOOST_CHECK_CLOSE(outputBuffer[0].m_buffer[0], 2.25f /* instead of 2.5 */, 0.1);
+
+    eval->Destroy();
+}
+
 BOOST_AUTO_TEST_CASE(EvalSparseTimesTest)
 {
     std::string modelDefinition =
@@ -415,5 +451,284 @@ BOOST_AUTO_TEST_CASE(EvalRNNTest)
     eval->Destroy();
 }
 
+IEvaluateModelBatched<float>* SetupBatchedNetwork(std::string modelDefinition, VariableSchema& outputLayouts)
+{
+    IEvaluateModelBatched<float>* eval;
+    GetEvalBatchedF(&eval);
+    eval->CreateNetwork(modelDefinition);
+    outputLayouts = eval->GetOutputSchema();
+    eval->StartForwardEvaluation({ outputLayouts[0].m_name });
+    outputLayouts = eval->GetOutputSchema();
+    return eval;
+}
+
+// Calls ForwardPass() from several threads at once. createRequest(k, r, inputBuffer, expected) returns the input of
+// request r of thread k and its expected output. Returns the number of requests whose output differs from the expected one.
+size_t RunConcurrentRequests(IEvaluateModelBatched<float>* eval, VariableSchema outputLayouts, size_t numThreads, size_t numRequestsPerThread,
+                             const std::function<void(size_t k, size_t r, Values<float>& inputBuffer, std::vector<float>& expected)>& createRequest)
+{
+    std::vector<std::thread> threads;
+    std::vector<size_t> numErrors(numThreads, 0);
+    for (size_t k = 0; k < numThreads; k++)
+    {
+        threads.push_back(std::thread([&, k]()
+        {
+            for (size_t r = 0; r < numRequestsPerThread; r++)
+            {
+                Values<float> inputBuffer(1);
+                std::vector<float> expected;
+                createRequest(k, r, inputBuffer, expected);
+                Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ expected.size() });
+                eval->ForwardPass(inputBuffer, outputBuffer);
+                if (outputBuffer[0].m_buffer != expected)
+                    numErrors[k]++;
+            }
+        }));
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    size_t numErrorsTotal = 0;
+    for (size_t k = 0; k < numThreads; k++)
+        numErrorsTotal += numErrors[k];
+    return numErrorsTotal;
+}
+
+// Checks that every request is counted once, and whether requests were evaluated together.
+void CheckBatchingStatistics(IEvaluateModelBatched<float>* eval, size_t numRequests, bool expectBatches)
+{
+    BatchingStatistics statistics;
+    eval->GetBatchingStatistics(statistics);
+    BOOST_CHECK_EQUAL(statistics.m_numRequests, numRequests);
+    size_t numBatchedRequests = 0;
+    size_t numLargerBatches = 0;
+    for (size_t n = 0; n < statistics.m_batchSizeHistogram.size(); n++)
+    {
+        numBatchedRequests += n * statistics.m_batchSizeHistogram[n];
+        if (n > 1)
+            numLargerBatches += statistics.m_batchSizeHistogram[n];
+    }
+    BOOST_CHECK_EQUAL(numBatchedRequests, numRequests);
+    if (expectBatches)
+    {
+        BOOST_CHECK_LT(statistics.m_numBatches, numRequests);
+        BOOST_CHECK_GT(numLargerBatches, (size_t)0);
+    }
+    else
+    {
+        BOOST_CHECK_EQUAL(statistics.m_numBatches, numRequests);
+        BOOST_CHECK_EQUAL(numLargerBatches, (size_t)0);
+    }
+    BOOST_CHECK(statistics.m_latencyP50 <= statistics.m_latencyP99);
+    BOOST_CHECK(statistics.m_latencyP99 <= statistics.m_latencyMax);
+}
+
+BOOST_AUTO_TEST_CASE(EvalBatchedDenseTimesTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "maxBatchSize = 4 \n"
+        "maxBatchLatencyMs = 20 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(4) \n"
+        "o1 = Times(Constant(2, rows=1, cols=4), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema outputLayouts;
+    IEvaluateModelBatched<float>* eval = SetupBatchedNetwork(modelDefinition, outputLayouts);
+
+    // Requests of different lengths from several threads, which get batched together.
+    const size_t numThreads = 8;
+    const size_t numRequestsPerThread = 10;
+    size_t numErrors = RunConcurrentRequests(eval, outputLayouts, numThreads, numRequestsPerThread,
+                                             [](size_t k, size_t r, Values<float>& inputBuffer, std::vector<float>& expected)
+    {
+        size_t length = 1 + (k + r) % 5;
+        for (size_t t = 0; t < length; t++)
+        {
+            float sum = 0;
+            for (size_t j = 0; j < 4; j++)
+            {
+                float value = (float)(k * 100 + r * 10 + t + j);
+                inputBuffer[0].m_buffer.push_back(value);
+                sum += value;
+            }
+            expected.push_back(2 * sum);
+        }
+    });
+    BOOST_CHECK_EQUAL(numErrors, (size_t)0);
+    CheckBatchingStatistics(eval, numThreads * numRequestsPerThread, /*expectBatches=*/true);
+
+    // Errors are reported to the caller of the failing request.
+    Values<float> inputBuffer(1);
+    inputBuffer[0].m_buffer = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 1 });
+    BOOST_REQUIRE_THROW(eval->ForwardPass(inputBuffer, outputBuffer), std::exception); // Not enough capacity in output.
+    inputBuffer[0].m_buffer = { 1, 2, 3 };
+    BOOST_REQUIRE_THROW(eval->ForwardPass(inputBuffer, outputBuffer), std::exception); // Not enough elements in the sample
+
+    BatchingStatistics statistics;
+    eval->ResetBatchingStatistics();
+    eval->GetBatchingStatistics(statistics);
+    BOOST_CHECK_EQUAL(statistics.m_numRequests, (size_t)0);
+
+    // Requests are rejected while the network is reconfigured, until the evaluation is started again.
+    eval->CreateNetwork(modelDefinition);
+    inputBuffer[0].m_buffer = { 1, 2, 3, 4 };
+    BOOST_REQUIRE_THROW(eval->ForwardPass(inputBuffer, outputBuffer), std::exception);
+    eval->StartForwardEvaluation({ outputLayouts[0].m_name });
+    eval->ForwardPass(inputBuffer, outputBuffer);
+    BOOST_CHECK_EQUAL(outputBuffer[0].m_buffer[0], 20.0f);
+
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalBatchedSparseTimesTest)
+{
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "maxBatchSize = 4 \n"
+        "maxBatchLatencyMs = 20 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = SparseInput(3) \n"
+        "o1 = Times(Constant(2, rows=1, cols=3), i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema outputLayouts;
+    IEvaluateModelBatched<float>* eval = SetupBatchedNetwork(modelDefinition, outputLayouts);
+
+    // Sparse requests of different lengths, with samples of 1 to 3 non-zero values.
+    const size_t numThreads = 8;
+    const size_t numRequestsPerThread = 10;
+    size_t numErrors = RunConcurrentRequests(eval, outputLayouts, numThreads, numRequestsPerThread,
+                                             [](size_t k, size_t r, Values<float>& inputBuffer, std::vector<float>& expected)
+    {
+        size_t length = 1 + (k + r) % 5;
+        auto& input = inputBuffer[0];
+        input.m_colIndices.push_back(0);
+        for (size_t t = 0; t < length; t++)
+        {
+            float sum = 0;
+            for (size_t j = 0; j < 1 + (k + t) % 3; j++)
+            {
+                float value = (float)(k * 100 + r * 10 + t + j);
+                input.m_buffer.push_back(value);
+                input.m_indices.push_back((int)j);
+                sum += value;
+            }
+            input.m_colIndices.push_back((int)input.m_indices.size());
+            expected.push_back(2 * sum);
+        }
+    });
+    BOOST_CHECK_EQUAL(numErrors, (size_t)0);
+    CheckBatchingStatistics(eval, numThreads * numRequestsPerThread, /*expectBatches=*/true);
+
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalBatchedRecurrenceTest)
+{
+    // o1 is the running sum of the input over the sequence
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "maxBatchSize = 4 \n"
+        "maxBatchLatencyMs = 20 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(2) \n"
+        "o1 = Plus(i1, PastValue(2, o1, timeStep=1, defaultHiddenActivity=0), tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema outputLayouts;
+    IEvaluateModelBatched<float>* eval = SetupBatchedNetwork(modelDefinition, outputLayouts);
+
+    // Every request starts from the initial state, independent of the other sequences in its batch.
+    const size_t numThreads = 8;
+    const size_t numRequestsPerThread = 10;
+    size_t numErrors = RunConcurrentRequests(eval, outputLayouts, numThreads, numRequestsPerThread,
+                                             [](size_t k, size_t r, Values<float>& inputBuffer, std::vector<float>& expected)
+    {
+        size_t length = 1 + (k + r) % 5;
+        std::vector<float> sum(2, 0);
+        for (size_t t = 0; t < length; t++)
+        {
+            for (size_t j = 0; j < 2; j++)
+            {
+                float value = (float)(k * 100 + r * 10 + t + j);
+                inputBuffer[0].m_buffer.push_back(value);
+                sum[j] += value;
+                expected.push_back(sum[j]);
+            }
+        }
+    });
+    BOOST_CHECK_EQUAL(numErrors, (size_t)0);
+    CheckBatchingStatistics(eval, numThreads * numRequestsPerThread, /*expectBatches=*/true);
+
+    // There is no state of a previous request of the caller to continue.
+    Values<float> inputBuffer(1);
+    inputBuffer[0].m_buffer = { 1, 2 };
+    Values<float> outputBuffer = outputLayouts.CreateBuffers<float>({ 1 });
+    BOOST_REQUIRE_THROW(eval->ForwardPass(inputBuffer, outputBuffer, false), std::exception);
+    eval->ForwardPass(inputBuffer, outputBuffer, true);
+    std::vector<float> expected = { 1, 2 };
+    BOOST_CHECK_EQUAL_COLLECTIONS(outputBuffer[0].m_buffer.begin(), outputBuffer[0].m_buffer.end(), expected.begin(), expected.end());
+
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalBatchedOutputWithoutDynamicAxisTest)
+{
+    // the output sums over all samples, so it cannot be split between requests
+    std::string modelDefinition =
+        "deviceId = -1 \n"
+        "precision = \"float\" \n"
+        "traceLevel = 1 \n"
+        "maxBatchSize = 4 \n"
+        "maxBatchLatencyMs = 20 \n"
+        "run=NDLNetworkBuilder \n"
+        "NDLNetworkBuilder=[ \n"
+        "i1 = Input(4) \n"
+        "o1 = SumElements(i1, tag=\"output\") \n"
+        "FeatureNodes = (i1) \n"
+        "] \n";
+
+    VariableSchema outputLayouts;
+    IEvaluateModelBatched<float>* eval = SetupBatchedNetwork(modelDefinition, outputLayouts);
+
+    const size_t numThreads = 8;
+    const size_t numRequestsPerThread = 5;
+    size_t numErrors = RunConcurrentRequests(eval, outputLayouts, numThreads, numRequestsPerThread,
+                                             [](size_t k, size_t r, Values<float>& inputBuffer, std::vector<float>& expected)
+    {
+        size_t length = 1 + (k + r) % 5;
+        float sum = 0;
+        for (size_t t = 0; t < length; t++)
+        {
+            for (size_t j = 0; j < 4; j++)
+            {
+                float value = (float)(k * 100 + r * 10 + t + j);
+                inputBuffer[0].m_buffer.push_back(value);
+                sum += value;
+            }
+        }
+        expected.push_back(sum);
+    });
+    BOOST_CHECK_EQUAL(numErrors, (size_t)0);
+    CheckBatchingStatistics(eval, numThreads * numRequestsPerThread, /*expectBatches=*/false);
+
+    eval->Destroy();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}}
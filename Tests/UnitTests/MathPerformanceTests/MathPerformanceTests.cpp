@@ -9,8 +9,11 @@
 //#include "Windows.h"
 #include "Matrix.h"
 #include "CPUMatrix.h"
+#include "CPUSparseMatrix.h"
 #include "TensorView.h"
 #include "Sequences.h"
+#include "BlockMultiplierDispatch.h"
+#include "ConvolutionEngine.h"
 #include <chrono>
 #include <iostream>
 #include <vector>
@@ -336,8 +339,306 @@ void MandSTest(int count, int devId)
     delete[] data3;
 }
 
+// Compares the throughput of the BlockMultiplier handlers (quantized GEMM) at each block size of the common
+// dimension, for all handlers the processor supports. With k equal to the block size only that block kernel runs.
+// The rows of A are processed four at a time (x4) if their number is a multiple of 4, otherwise one at a time (x1).
+template <typename ScalarT>
+void BlockMultiplierTest(int n, int iterations)
+{
+    const BlockHandlerType handlerTypes[] = { BlockHandlerType::SSE, BlockHandlerType::AVX2, BlockHandlerType::AVX512BW, BlockHandlerType::AVX512VNNI };
+    const int blockSizes[] = { 128, 64, 32, 16, 8 };
+    const int rowsPerBlockValues[] = { 4, 1 };
+
+    cout << "Testing BlockMultiplier with " << 8 * sizeof(ScalarT) << "-bit matrices" << endl;
+    for (int rowsPerBlock : rowsPerBlockValues)
+    {
+        int m = rowsPerBlock == 4 ? 256 : 255;
+        for (int k : blockSizes)
+        {
+            vector<ScalarT> A(m * k), B(k * n);
+            for (auto& a : A)
+                a = (ScalarT)(rand() % 63 - 31);
+            for (auto& b : B)
+                b = (ScalarT)(rand() % 63 - 31);
+            vector<int32_t> C(m * n);
+
+            for (auto handlerType : handlerTypes)
+            {
+                if (!IsBlockHandlerSupported<ScalarT>(handlerType))
+                    continue;
+
+                auto multiplier = CreateBlockMultiplier<ScalarT>(handlerType, 1);
+                ScalarT* preparedB = multiplier->PrepareB(B.data(), k, n);
+                multiplier->MultiplyMatrices(A.data(), m, k, preparedB, n, C.data()); // warm up
+
+                auto start = chrono::high_resolution_clock::now();
+                for (int i = 0; i < iterations; ++i)
+                    multiplier->MultiplyMatrices(A.data(), m, k, preparedB, n, C.data());
+                chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - start;
+                multiplier->FreePreparedB(preparedB);
+
+                double gops = 2.0 * m * k * n * iterations / elapsed.count() / 1e9;
+                cout << k << "x" << rowsPerBlock << " " << BlockHandlerTypeName(handlerType) << ": " << gops << " GOPS" << endl;
+            }
+        }
+    }
+}
+
+// Compares the CPU TensorOp throughput on one thread and on all threads for typical elementwise, broadcasting and
+// reduction shapes. Binary ops combine the layer with the other operand, which is broadcast; opCopy reduces the layer
+// to the other shape.
+template <class ElemType>
+void TensorOpThreadingTest(int iterations)
+{
+    struct TensorOpCase
+    {
+        const char* what;
+        TensorShape layerShape;
+        TensorShape otherShape;
+        ElementWiseOperator op;
+    };
+    const TensorOpCase cases[] =
+    {
+        { "elementwise addition",        TensorShape{ 512, 256, 32 },    TensorShape{ 512, 256, 32 }, ElementWiseOperator::opSum },
+        { "bias addition (FF)",          TensorShape{ 2048, 1024 },      TensorShape(2048),           ElementWiseOperator::opSum },
+        { "bias addition (convolution)", TensorShape{ 28, 28, 128, 32 }, TensorShape{ 1, 1, 128 },    ElementWiseOperator::opSum },
+        { "row broadcasting product",    TensorShape{ 2048, 1024 },      TensorShape{ 1, 1024 },      ElementWiseOperator::opElementwiseProduct },
+        { "bias gradient (FF)",          TensorShape{ 2048, 1024 },      TensorShape(2048),           ElementWiseOperator::opCopy },
+        { "bias gradient (convolution)", TensorShape{ 28, 28, 128, 32 }, TensorShape{ 1, 1, 128 },    ElementWiseOperator::opCopy },
+        { "column sums",                 TensorShape{ 2048, 1024 },      TensorShape{ 1, 1024 },      ElementWiseOperator::opCopy },
+        { "sum of all elements",         TensorShape{ 2048, 1024 },      TensorShape(1),              ElementWiseOperator::opCopy },
+    };
+
+    auto createTensor = [](const TensorShape& shape)
+    {
+        vector<ElemType> init(shape.GetNumElements());
+        for (auto& v : init)
+            v = (ElemType)(2.0 * rand() / RAND_MAX - 1);
+        return TensorView<ElemType>(make_shared<Matrix<ElemType>>(init.size(), 1, init.data(), CPUDEVICE), shape);
+    };
+
+    const int maxNumThreads = CPUMatrix<ElemType>::GetMaxNumThreads();
+    cout << "Testing CPU TensorOp with " << 8 * sizeof(ElemType) << "-bit elements, 1 vs. " << maxNumThreads << " threads" << endl;
+    for (const auto& testCase : cases)
+    {
+        auto input = createTensor(testCase.layerShape);
+        auto other = createTensor(testCase.otherShape);
+        bool isReduction = testCase.op == ElementWiseOperator::opCopy;
+        auto result = createTensor(isReduction ? testCase.otherShape : testCase.layerShape);
+
+        double elapsedSeconds[2];
+        for (int pass = 0; pass < 2; pass++)
+        {
+            CPUMatrix<ElemType>::SetNumThreads(pass == 0 ? 1 : maxNumThreads);
+            auto start = chrono::high_resolution_clock::now();
+            for (int i = 0; i < iterations; ++i)
+            {
+                if (isReduction)
+                    result.DoUnaryOpOf(0, input, 1, testCase.op, ElementWiseOperator::opSum);
+                else
+                    result.DoBinaryOpOf(0, input, other, 1, testCase.op, ElementWiseOperator::opSum);
+            }
+            elapsedSeconds[pass] = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count() / iterations;
+        }
+
+        double gelems = testCase.layerShape.GetNumElements() / elapsedSeconds[1] / 1e9;
+        cout << testCase.what << " [" << string(testCase.layerShape) << "] -> [" << string(result.GetShape()) << "]: "
+             << elapsedSeconds[0] * 1000 << " ms on 1 thread, " << elapsedSeconds[1] * 1000 << " ms on " << maxNumThreads
+             << " threads (" << gelems << " G elements/s, speed-up " << elapsedSeconds[0] / elapsedSeconds[1] << ")" << endl;
+    }
+    CPUMatrix<ElemType>::SetNumThreads(maxNumThreads);
+}
+
+// Compares the GEMM and Winograd convolution engines on the convolutions of ResNet-style models.
+template <class ElemType>
+void ConvolutionEngineTest(int batchSize, int iterations)
+{
+    struct ConvolutionCase
+    {
+        const char* what;
+        ConvolveGeometryPtr geometry;
+    };
+    auto conv2D = [](size_t size, size_t inC, size_t kernelSize, size_t outC, size_t stride)
+    {
+        return make_shared<ConvolveGeometry>(TensorShape(size, size, inC), TensorShape(kernelSize, kernelSize, inC), TensorShape(outC), TensorShape(stride, stride, inC),
+                                             ConvolveGeometry::BoolVec{ true }, ConvolveGeometry::BoolVec{ true, true, false }, TensorShape(0), TensorShape(0));
+    };
+    const ConvolutionCase cases[] =
+    {
+        { "3x3, 64 maps",           conv2D(56, 64, 3, 64, 1) },
+        { "3x3, 128 maps",          conv2D(28, 128, 3, 128, 1) },
+        { "3x3, 256 maps",          conv2D(14, 256, 3, 256, 1) },
+        { "3x3, 512 maps",          conv2D(7, 512, 3, 512, 1) },
+        { "1x1 bottleneck reduce",  conv2D(56, 256, 1, 64, 1) },
+        { "1x1 bottleneck expand",  conv2D(56, 64, 1, 256, 1) },
+        { "1x1 shortcut, stride 2", conv2D(56, 256, 1, 512, 2) },
+        { "3x3 channel-wise",       make_shared<ConvolveGeometry>(TensorShape(56, 56, 64, 1), TensorShape(3, 3, 1, 1), TensorShape(1), TensorShape(1),
+                                                                  ConvolveGeometry::BoolVec{ true }, ConvolveGeometry::BoolVec{ true, true, false, false }, TensorShape(0), TensorShape(0)) },
+    };
+    const ConvolutionEngineKind kinds[] = { ConvolutionEngineKind::Gemm, (ConvolutionEngineKind)((int)ConvolutionEngineKind::Winograd | (int)ConvolutionEngineKind::Gemm) };
+    const char* kindNames[] = { "GEMM", "Winograd" };
+
+    cout << "Testing CPU convolution engines with " << 8 * sizeof(ElemType) << "-bit elements, minibatch size " << batchSize << endl;
+    for (const auto& testCase : cases)
+    {
+        const auto& g = testCase.geometry;
+        Matrix<ElemType> in(g->InputShape().GetNumElements(), batchSize, CPUDEVICE);
+        Matrix<ElemType> kernel(g->KernelCount(), g->KernelShape().GetNumElements(), CPUDEVICE);
+        Matrix<ElemType> out(g->OutputShape().GetNumElements(), batchSize, CPUDEVICE);
+        Matrix<ElemType> grad(g->InputShape().GetNumElements(), batchSize, CPUDEVICE);
+        randomInitializeMatrix<ElemType>(in, -1, 1);
+        randomInitializeMatrix<ElemType>(kernel, -1, 1);
+        randomInitializeMatrix<ElemType>(out, -1, 1);
+        grad.SetValue(0);
+
+        cout << testCase.what << " " << string(*g) << ":" << endl;
+        for (int i = 0; i < 2; i++)
+        {
+            auto engine = ConvolutionEngine<ElemType>::Create(g, CPUDEVICE, ImageLayoutKind::CHW, 0, PoolKind::None, kinds[i]);
+            Matrix<ElemType> workspace(CPUDEVICE);
+
+            // The first pass selects the algorithms and allocates the workspace.
+            engine->Forward(in, kernel, out, workspace);
+            bool canBackpropToInput = i == 1 || g->KernelShape()[2] == g->InputShape()[2];
+            if (canBackpropToInput)
+                engine->BackwardData(out, kernel, grad, true, workspace);
+
+            auto start = chrono::high_resolution_clock::now();
+            for (int j = 0; j < iterations; j++)
+                engine->Forward(in, kernel, out, workspace);
+            double forwardSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count() / iterations;
+            start = chrono::high_resolution_clock::now();
+            for (int j = 0; canBackpropToInput && j < iterations; j++)
+                engine->BackwardData(out, kernel, grad, true, workspace);
+            double backwardSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count() / iterations;
+
+            cout << "    " << kindNames[i] << ": forward " << forwardSeconds * 1000 << " ms";
+            if (canBackpropToInput)
+                cout << ", backward data " << backwardSeconds * 1000 << " ms";
+            cout << ", workspace " << workspace.GetNumElements() * sizeof(ElemType) / (1024 * 1024) << " MB" << endl;
+        }
+    }
+}
+
+// Measures the sparse-dense products of an embedding layer with one-hot inputs over a vocabulary of 1M words,
+// on one thread and on all threads: the forward lookup in both weight layouts, and the gradient of the weights,
+// which is accumulated into a sparse block-column matrix.
+template <class ElemType>
+void SparseMultiplyTest(int embeddingDim, int batchSize, int iterations)
+{
+    const size_t vocabSize = 1024 * 1024;
+    vector<CPUSPARSE_INDEX_TYPE> columnStarts(batchSize + 1), rowIndices(batchSize);
+    vector<ElemType> values(batchSize, 1);
+    for (int j = 0; j < batchSize; j++)
+    {
+        columnStarts[j] = j;
+        rowIndices[j] = (CPUSPARSE_INDEX_TYPE)(((size_t)rand() * RAND_MAX + rand()) % vocabSize);
+    }
+    columnStarts[batchSize] = batchSize;
+    CPUSparseMatrix<ElemType> input(matrixFormatSparseCSC);
+    input.SetMatrixFromCSCFormat(columnStarts.data(), rowIndices.data(), values.data(), batchSize, vocabSize, batchSize);
+
+    CPUMatrix<ElemType> weights(embeddingDim, vocabSize);
+    CPUMatrix<ElemType> weightsTransposed(vocabSize, embeddingDim);
+    randomInitializeCPUMatrix<ElemType>(weights, -1, 1);
+    randomInitializeCPUMatrix<ElemType>(weightsTransposed, -1, 1);
+    CPUMatrix<ElemType> output(embeddingDim, batchSize);
+    CPUMatrix<ElemType> outputTransposed(batchSize, embeddingDim);
+    CPUMatrix<ElemType> outputGradient(embeddingDim, batchSize);
+    randomInitializeCPUMatrix<ElemType>(outputGradient, -1, 1);
+
+    const char* cases[] = { "W * onehot", "onehot^T * W", "W gradient, dW += G * onehot^T" };
+    const int maxNumThreads = CPUMatrix<ElemType>::GetMaxNumThreads();
+    cout << "Testing CPU sparse products with " << 8 * sizeof(ElemType) << "-bit elements, embedding dimension " << embeddingDim
+         << ", minibatch size " << batchSize << ", 1 vs. " << maxNumThreads << " threads" << endl;
+    for (int c = 0; c < 3; c++)
+    {
+        double elapsedSeconds[2];
+        for (int pass = 0; pass < 2; pass++)
+        {
+            CPUMatrix<ElemType>::SetNumThreads(pass == 0 ? 1 : maxNumThreads);
+            auto start = chrono::high_resolution_clock::now();
+            for (int i = 0; i < iterations; ++i)
+            {
+                if (c == 0)
+                    CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(1, weights, false, input, false, 0, output);
+                else if (c == 1)
+                    CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(1, input, true, weightsTransposed, false, 0, outputTransposed);
+                else
+                {
+                    // The CSR view of the input is built by the first product and reused by the following ones.
+                    CPUSparseMatrix<ElemType> weightsGradient(matrixFormatSparseBlockCol);
+                    CPUSparseMatrix<ElemType>::MultiplyAndAdd(1, outputGradient, false, input, true, weightsGradient);
+                }
+            }
+            elapsedSeconds[pass] = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count() / iterations;
+        }
+        cout << cases[c] << ": " << elapsedSeconds[0] * 1000 << " ms on 1 thread, " << elapsedSeconds[1] * 1000 << " ms on "
+             << maxNumThreads << " threads (speed-up " << elapsedSeconds[0] / elapsedSeconds[1] << ")" << endl;
+    }
+    CPUMatrix<ElemType>::SetNumThreads(maxNumThreads);
+}
+
+// Compares the float GEMM with the 16-bit quantized product of QuantizedTimesNode for typical inference layer sizes,
+// with a constant weight matrix (which is quantized and prepared only once) and a varying number of input columns.
+template <class ElemType>
+void QuantizedMultiplyTest(int iterations)
+{
+    const int layerSizes[][2] = { { 512, 512 }, { 1024, 1024 }, { 4096, 1024 } };
+    const int batchSizes[] = { 1, 8, 64 };
+
+    cout << "Testing quantized products with " << 8 * sizeof(ElemType) << "-bit elements on " << CPUMatrix<ElemType>::GetMaxNumThreads() << " threads" << endl;
+    for (const auto& layerSize : layerSizes)
+    {
+        // Values in [-1, 1]; with values of one sign, the 16-bit products would overflow the 32-bit accumulators.
+        CPUMatrix<ElemType> weights(layerSize[0], layerSize[1]);
+        randomInitializeCPUMatrix<ElemType>(weights, -1, 2);
+        for (int batchSize : batchSizes)
+        {
+            CPUMatrix<ElemType> input(layerSize[1], batchSize);
+            randomInitializeCPUMatrix<ElemType>(input, -1, 2);
+            CPUMatrix<ElemType> output(layerSize[0], batchSize);
+            CPUMatrix<ElemType> quantizedOutput(layerSize[0], batchSize);
+            auto multiplier = make_shared<QuantizedMultiplier<ElemType>>(make_shared<SymmetricQuantizer<ElemType, short>>(2), true, make_shared<SymmetricQuantizer<ElemType, short>>(2), false);
+
+            double elapsedSeconds[2];
+            for (int pass = 0; pass < 2; pass++)
+            {
+                auto& result = pass == 0 ? output : quantizedOutput;
+                auto quantizedMultiplier = pass == 0 ? nullptr : multiplier;
+                CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, weights, false, input, false, 0, result, quantizedMultiplier);
+                auto start = chrono::high_resolution_clock::now();
+                for (int i = 0; i < iterations; i++)
+                    CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, weights, false, input, false, 0, result, quantizedMultiplier);
+                elapsedSeconds[pass] = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count() / iterations;
+            }
+
+            quantizedOutput -= output;
+            cout << "[" << layerSize[0] << " x " << layerSize[1] << "] * [" << layerSize[1] << " x " << batchSize << "]: "
+                 << elapsedSeconds[0] * 1000 << " ms GEMM, " << elapsedSeconds[1] * 1000 << " ms quantized (speed-up " << elapsedSeconds[0] / elapsedSeconds[1]
+                 << ", relative error " << quantizedOutput.FrobeniusNorm() / output.FrobeniusNorm() << ")" << endl;
+        }
+    }
+}
+
 int wmain()
 {
+    cout << endl << "********************BlockMultiplier handlers TEST********************" << endl;
+    BlockMultiplierTest<int16_t>(1024, 100);
+    BlockMultiplierTest<int8_t>(1024, 100);
+
+    cout << endl << "********************CPU TensorOp multithreading TEST********************" << endl;
+    TensorOpThreadingTest<float>(20);
+    TensorOpThreadingTest<double>(20);
+
+    ConvolutionEngineTest<float>(1, 20);
+    ConvolutionEngineTest<float>(32, 5);
+
+    SparseMultiplyTest<float>(64, 256, 20);
+    SparseMultiplyTest<float>(256, 1024, 5);
+
+    QuantizedMultiplyTest<float>(20);
+
     // MandSTest<float>(100, 2);
 
     /*cout<<endl<<"********************Matrix SquareMultiplyAndWeightedAdd10TimesAvg TEST********************"<<endl;
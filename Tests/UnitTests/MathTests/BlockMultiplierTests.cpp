@@ -4,6 +4,7 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/BlockMultiplier.h"
+#include "../../../Source/Math/BlockMultiplierDispatch.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace TEST {
 
@@ -99,6 +100,11 @@ template<typename ScalarAT, typename ScalarBT, typename ScalarCT, typename Multi
 
     RandInitIntMatrix<ScalarAT>(refA, m, k, 63);
     RandInitIntMatrix<ScalarBT>(refB, k, n, 63);
+    // Center the values around zero so that negative operands are covered as well.
+    for (int i = 0; i < m * k; ++i)
+        refA[i] -= 31;
+    for (int i = 0; i < k * n; ++i)
+        refB[i] -= 31;
     memcpy(testA, refA, sizeof(ScalarAT) * m * k);
     memcpy(testB, refB, sizeof(ScalarBT) * k * n);
 
@@ -185,5 +191,130 @@ BOOST_AUTO_TEST_CASE(BlockMultiplyTestAllKFourRowsMultiThread)
     TestMultiplierSub<int16_t, int16_t, int32_t, BlockMultiplier<BlockHandlerSSE>>(4, 128 + 64 + 32 + 16 + 8 + 1, 1, 2);
 }
 
+// Runs the shapes above against a handler for a wider instruction set, if the processor supports it.
+template<typename ScalarT, typename BlockHandlerT> static void TestBlockHandler(BlockHandlerType type)
+{
+    if (!IsBlockHandlerSupported<ScalarT>(type))
+    {
+        BOOST_TEST_MESSAGE("Skipping the " << BlockHandlerTypeName(type) << " block handler, not supported by the processor.");
+        return;
+    }
+
+    const int allK = 128 + 64 + 32 + 16 + 8 + 1;
+    for (int numThreads = 1; numThreads <= 2; ++numThreads)
+    {
+        TestMultiplierSub<ScalarT, ScalarT, int32_t, BlockMultiplier<BlockHandlerT>>(8, 128, 8, numThreads);
+        TestMultiplierSub<ScalarT, ScalarT, int32_t, BlockMultiplier<BlockHandlerT>>(7, 128, 8, numThreads);
+        TestMultiplierSub<ScalarT, ScalarT, int32_t, BlockMultiplier<BlockHandlerT>>(1, allK, 1, numThreads);
+        TestMultiplierSub<ScalarT, ScalarT, int32_t, BlockMultiplier<BlockHandlerT>>(4, allK, 1, numThreads);
+        // several blocks of each size, and 128 blocks handed over one and two at a time
+        TestMultiplierSub<ScalarT, ScalarT, int32_t, BlockMultiplier<BlockHandlerT>>(12, 3 * 128 + allK, 17, numThreads);
+        TestMultiplierSub<ScalarT, ScalarT, int32_t, BlockMultiplier<BlockHandlerT>>(5, 3 * 128 + allK, 17, numThreads);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BlockMultiplyTestAVX2)
+{
+    TestBlockHandler<int16_t, BlockHandlerAVX>(BlockHandlerType::AVX2);
+}
+
+BOOST_AUTO_TEST_CASE(BlockMultiplyTestAVX512BW)
+{
+    TestBlockHandler<int16_t, BlockHandlerAVX512BW>(BlockHandlerType::AVX512BW);
+}
+
+BOOST_AUTO_TEST_CASE(BlockMultiplyTestAVX512VNNI)
+{
+    TestBlockHandler<int16_t, BlockHandlerAVX512VNNI>(BlockHandlerType::AVX512VNNI);
+}
+
+BOOST_AUTO_TEST_CASE(BlockMultiplyTestAVX512BWInt8)
+{
+    TestBlockHandler<int8_t, BlockHandlerAVX512BWInt8>(BlockHandlerType::AVX512BW);
+}
+
+BOOST_AUTO_TEST_CASE(BlockMultiplyTestAVX512VNNIInt8)
+{
+    TestBlockHandler<int8_t, BlockHandlerAVX512VNNIInt8>(BlockHandlerType::AVX512VNNI);
+}
+
+// The runtime dispatch picks a supported handler and computes the same result.
+BOOST_AUTO_TEST_CASE(BlockMultiplyTestDispatch)
+{
+    const int m = 9, k = 2 * 128 + 64 + 8 + 3, n = 11;
+    ReferenceMultiplier<int16_t, int16_t, int32_t> refMult;
+    int16_t* A = refMult.CreateMatrixA(m, k);
+    int16_t* B = refMult.CreateMatrixB(k, n);
+    int32_t* refC = refMult.CreateMatrixC(m, n);
+    RandInitIntMatrix<int16_t>(A, m, k, 63);
+    RandInitIntMatrix<int16_t>(B, k, n, 63);
+    refMult.MultiplyMatrices(A, m, k, B, n, refC);
+
+    auto multiplier = CreateBlockMultiplier<int16_t>(BlockHandlerType::Best, 2);
+    BOOST_TEST_MESSAGE("Best block handler: " << BlockHandlerTypeName(multiplier->GetHandlerType()));
+    BOOST_CHECK(IsBlockHandlerSupported<int16_t>(multiplier->GetHandlerType()));
+
+    int16_t* testA = CreateAlignedMatrix<int16_t>(m, k, 0);
+    memcpy(testA, A, sizeof(int16_t) * m * k);
+    int32_t* testC = CreateAlignedMatrix<int32_t>(m, n, 0);
+    int16_t* preparedB = multiplier->PrepareB(B, k, n);
+    multiplier->MultiplyMatrices(testA, m, k, preparedB, n, testC);
+    CompareMatricesAndDump(refC, testC, m, k, n);
+
+    multiplier->FreePreparedB(preparedB);
+    FreeAlignedMatrix(testA);
+    FreeAlignedMatrix(testC);
+    refMult.FreeMatrix(A);
+    refMult.FreeMatrix(B);
+    refMult.FreeMatrix(refC);
+}
+
+// 8-bit B is expected in the symmetric range [-127, 127]. -128 is treated as -127 by every handler,
+// including the VNNI one, which could otherwise not negate it for the negative elements of A.
+BOOST_AUTO_TEST_CASE(BlockMultiplyTestInt8SymmetricRange)
+{
+    const int m = 6, k = 128 + 64 + 5, n = 7;
+    ReferenceMultiplier<int8_t, int8_t, int32_t> refMult;
+    int8_t* A = refMult.CreateMatrixA(m, k);
+    int8_t* B = refMult.CreateMatrixB(k, n);
+    int8_t* clampedB = refMult.CreateMatrixB(k, n);
+    int32_t* refC = refMult.CreateMatrixC(m, n);
+    // A covers the full range including -128, a third of B is -128
+    for (int i = 0; i < m * k; ++i)
+        A[i] = (int8_t)(-128 + (i * 37) % 256);
+    for (int i = 0; i < k * n; ++i)
+    {
+        B[i] = i % 3 == 0 ? INT8_MIN : (int8_t)(-128 + (i * 53) % 256);
+        clampedB[i] = B[i] == INT8_MIN ? -INT8_MAX : B[i];
+    }
+    refMult.MultiplyMatrices(A, m, k, clampedB, n, refC);
+
+    for (auto type : { BlockHandlerType::AVX512BW, BlockHandlerType::AVX512VNNI, BlockHandlerType::Best })
+    {
+        if (!IsBlockHandlerSupported<int8_t>(type))
+        {
+            BOOST_TEST_MESSAGE("Skipping the " << BlockHandlerTypeName(type) << " block handler, not supported by the processor.");
+            continue;
+        }
+
+        auto multiplier = CreateBlockMultiplier<int8_t>(type, 1);
+        int8_t* testA = CreateAlignedMatrix<int8_t>(m, k, 0);
+        memcpy(testA, A, sizeof(int8_t) * m * k);
+        int32_t* testC = CreateAlignedMatrix<int32_t>(m, n, 0);
+        int8_t* preparedB = multiplier->PrepareB(B, k, n);
+        multiplier->MultiplyMatrices(testA, m, k, preparedB, n, testC);
+        CompareMatricesAndDump(refC, testC, m, k, n);
+
+        multiplier->FreePreparedB(preparedB);
+        FreeAlignedMatrix(testA);
+        FreeAlignedMatrix(testC);
+    }
+
+    refMult.FreeMatrix(A);
+    refMult.FreeMatrix(B);
+    refMult.FreeMatrix(clampedB);
+    refMult.FreeMatrix(refC);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}} //end namespaces
@@ -4,6 +4,7 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/CPUMatrix.h"
+#include "../../../Source/Math/RNNCommon.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -985,6 +986,145 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixOneHot, RandomSeedFixture)
     BOOST_CHECK(dirty_m.IsEqualTo(dirtyExpect, 1e-6));
 }
 
+// Compares the CPU RNN stack against a per-sequence, per-gate evaluation of the cuDNN equations,
+// addressing the parameters through the cuDNN layout (all weight matrices first, then all biases).
+BOOST_FIXTURE_TEST_CASE(CPUMatrixRNNForward, RandomSeedFixture)
+{
+    const size_t inputDim = 7, hiddenSize = 5, numLayers = 2;
+    const vector<size_t> sequenceLengths = { 6, 4, 4, 1 }; // sorted from longest to shortest, as packed by OptimizedRNNStackNode
+    const size_t numFrames = sequenceLengths[0];
+
+    vector<size_t> numSequencesForFrame(numFrames, 0);
+    vector<size_t> frameStart(numFrames + 1, 0);
+    for (size_t t = 0; t < numFrames; t++)
+    {
+        for (auto length : sequenceLengths)
+            numSequencesForFrame[t] += (length > t) ? 1 : 0;
+        frameStart[t + 1] = frameStart[t] + numSequencesForFrame[t];
+    }
+    const size_t numCols = frameStart[numFrames];
+
+    auto sigmoid = [](double x) { return 1 / (1 + exp(-x)); };
+    for (wstring recurrentOp : { L"lstm", L"gru", L"rnnTanh", L"rnnReLU" })
+    {
+        for (bool bidirectional : { false, true })
+        {
+            RnnAttributes attributes(bidirectional, numLayers, hiddenSize, recurrentOp, -1);
+            const size_t numGates = (recurrentOp == L"lstm") ? 4 : (recurrentOp == L"gru") ? 3 : 1;
+            const size_t numDirections = bidirectional ? 2 : 1;
+            const auto numParameters = attributes.GetNumParameters(inputDim);
+
+            DMatrix weights = DMatrix::RandomUniform(numParameters.first, numParameters.second, -0.5, 0.5, IncrementCounter());
+            DMatrix input = DMatrix::RandomUniform(inputDim, numCols, -1, 1, IncrementCounter());
+            DMatrix output, reserve, workspace;
+            output.RNNForward(input, weights, inputDim, numDirections * hiddenSize, numSequencesForFrame, attributes, reserve, workspace);
+            BOOST_REQUIRE_EQUAL(output.GetNumRows(), numDirections * hiddenSize);
+            BOOST_REQUIRE_EQUAL(output.GetNumCols(), numCols);
+
+            // reference: [sequence][frame] -> vector
+            vector<vector<vector<double>>> layerInput(sequenceLengths.size());
+            for (size_t j = 0; j < sequenceLengths.size(); j++)
+                for (size_t t = 0; t < sequenceLengths[j]; t++)
+                    layerInput[j].push_back(vector<double>(input.Data() + (frameStart[t] + j) * inputDim, input.Data() + (frameStart[t] + j + 1) * inputDim));
+
+            const double* w = weights.Data();
+            size_t weightOffset = 0, biasOffset = 0;
+            for (size_t layer = 0, dim = inputDim; layer < numLayers; layer++, dim = numDirections * hiddenSize)
+                biasOffset += numDirections * numGates * hiddenSize * (dim + hiddenSize);
+
+            size_t dim = inputDim;
+            for (size_t layer = 0; layer < numLayers; layer++)
+            {
+                vector<vector<vector<double>>> layerOutput(sequenceLengths.size());
+                for (size_t j = 0; j < sequenceLengths.size(); j++)
+                    layerOutput[j].assign(sequenceLengths[j], vector<double>(numDirections * hiddenSize));
+
+                for (size_t direction = 0; direction < numDirections; direction++)
+                {
+                    for (size_t j = 0; j < sequenceLengths.size(); j++)
+                    {
+                        vector<double> h(hiddenSize, 0), c(hiddenSize, 0);
+                        for (size_t step = 0; step < sequenceLengths[j]; step++)
+                        {
+                            size_t t = (direction == 0) ? step : sequenceLengths[j] - 1 - step;
+                            vector<vector<double>> wx(numGates, vector<double>(hiddenSize)), rh(numGates, vector<double>(hiddenSize));
+                            for (size_t k = 0; k < numGates; k++)
+                            {
+                                for (size_t r = 0; r < hiddenSize; r++)
+                                {
+                                    wx[k][r] = w[biasOffset + k * hiddenSize + r];
+                                    rh[k][r] = w[biasOffset + (numGates + k) * hiddenSize + r];
+                                    for (size_t i = 0; i < dim; i++)
+                                        wx[k][r] += w[weightOffset + (k * hiddenSize + r) * dim + i] * layerInput[j][t][i];
+                                    for (size_t i = 0; i < hiddenSize; i++)
+                                        rh[k][r] += w[weightOffset + numGates * hiddenSize * dim + (k * hiddenSize + r) * hiddenSize + i] * h[i];
+                                }
+                            }
+                            for (size_t r = 0; r < hiddenSize; r++)
+                            {
+                                if (recurrentOp == L"lstm")
+                                {
+                                    c[r] = sigmoid(wx[1][r] + rh[1][r]) * c[r] + sigmoid(wx[0][r] + rh[0][r]) * tanh(wx[2][r] + rh[2][r]);
+                                    h[r] = sigmoid(wx[3][r] + rh[3][r]) * tanh(c[r]);
+                                }
+                                else if (recurrentOp == L"gru")
+                                {
+                                    double z = sigmoid(wx[1][r] + rh[1][r]);
+                                    h[r] = (1 - z) * tanh(wx[2][r] + sigmoid(wx[0][r] + rh[0][r]) * rh[2][r]) + z * h[r];
+                                }
+                                else if (recurrentOp == L"rnnTanh")
+                                    h[r] = tanh(wx[0][r] + rh[0][r]);
+                                else
+                                    h[r] = max(wx[0][r] + rh[0][r], 0.0);
+                            }
+                            for (size_t r = 0; r < hiddenSize; r++)
+                                layerOutput[j][t][direction * hiddenSize + r] = h[r];
+                        }
+                    }
+                    weightOffset += numGates * hiddenSize * (dim + hiddenSize);
+                    biasOffset += 2 * numGates * hiddenSize;
+                }
+                layerInput = layerOutput;
+                dim = numDirections * hiddenSize;
+            }
+
+            for (size_t j = 0; j < sequenceLengths.size(); j++)
+                for (size_t t = 0; t < sequenceLengths[j]; t++)
+                    for (size_t r = 0; r < numDirections * hiddenSize; r++)
+                        BOOST_CHECK_SMALL(output(r, frameStart[t] + j) - layerInput[j][t][r], 1e-10);
+        }
+    }
+}
+
+// For a recurrence over a spatial axis, OptimizedRNNStackNode passes the data transposed to (inputDim x numSamples x width),
+// but in a matrix of the shape of its input ((inputDim * width) x numSamples). The result must be the one of the packed layout.
+BOOST_FIXTURE_TEST_CASE(CPUMatrixRNNForwardSpatialRecurrence, RandomSeedFixture)
+{
+    const size_t inputDim = 6, hiddenSize = 4, numLayers = 2, width = 5, numSamples = 3;
+    const vector<size_t> numSequencesForFrame(width, numSamples);
+
+    for (bool bidirectional : { false, true })
+    {
+        RnnAttributes attributes(bidirectional, numLayers, hiddenSize, L"lstm", /*axis=*/2);
+        const size_t outputDim = (bidirectional ? 2 : 1) * hiddenSize;
+        const auto numParameters = attributes.GetNumParameters(inputDim);
+        DMatrix weights = DMatrix::RandomUniform(numParameters.first, numParameters.second, -0.5, 0.5, IncrementCounter());
+
+        DMatrix packedInput = DMatrix::RandomUniform(inputDim, width * numSamples, -1, 1, IncrementCounter());
+        DMatrix packedOutput, reserve, workspace;
+        packedOutput.RNNForward(packedInput, weights, inputDim, outputDim, numSequencesForFrame, attributes, reserve, workspace);
+
+        DMatrix spatialInput(inputDim * width, numSamples);
+        memcpy(spatialInput.Data(), packedInput.Data(), packedInput.GetNumElements() * sizeof(double));
+        DMatrix spatialOutput(outputDim * width, numSamples);
+        spatialOutput.RNNForward(spatialInput, weights, inputDim, outputDim, numSequencesForFrame, attributes, reserve, workspace);
+
+        BOOST_REQUIRE_EQUAL(spatialOutput.GetNumElements(), outputDim * width * numSamples);
+        for (size_t i = 0; i < packedOutput.GetNumElements(); i++)
+            BOOST_CHECK_EQUAL(spatialOutput.Data()[i], packedOutput.Data()[i]);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -7,6 +7,7 @@
 #include <crtdefs.h>
 #endif
 #include "../../../Source/Math/CPUSparseMatrix.h"
+#include <omp.h>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -195,6 +196,109 @@ BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixOneHot, RandomSeedFixture)
     BOOST_CHECK(sm3(4, 3) == 1);
 }
 
+// Copies the nonzero elements of the dense matrix into the (empty) CSC matrix.
+static void AssignNonzeroElements(SparseMatrix& sm, const DenseMatrix& dm)
+{
+    foreach_coord(row, col, dm)
+    {
+        if (dm(row, col) != 0)
+        {
+            sm.SetValue(row, col, dm(row, col));
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyWithCSRView, RandomSeedFixture)
+{
+    // The products are large enough to run in parallel (nonzero elements times the outer dimension >= 64 * 1024).
+    const size_t m = 64;
+    const size_t n = 100;
+    const size_t k = 300;
+    const int maxNumThreads = omp_get_max_threads();
+    omp_set_num_threads(4);
+
+    DenseMatrix dm(n, k);
+    dm.SetUniformRandomValue(-9, 1, IncrementCounter());
+    dm.InplaceTruncateBottom(0);
+    SparseMatrix sm(MatrixFormat::matrixFormatSparseCSC, n, k, 0);
+    AssignNonzeroElements(sm, dm);
+    BOOST_REQUIRE_GE(sm.NzCount() * m, 64 * 1024);
+
+    // Checks the products that use the CSR view (dense * sparse^T and sparse * dense) against the dense ones.
+    auto checkProducts = [&](const SparseMatrix& sparse)
+    {
+        DenseMatrix dense = sparse.CopyColumnSliceToDense(0, sparse.GetNumCols());
+        DenseMatrix a(m, sparse.GetNumCols());
+        a.SetUniformRandomValue(-1, 1, IncrementCounter());
+        DenseMatrix b(sparse.GetNumCols(), m);
+        b.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+        DenseMatrix expected(m, sparse.GetNumRows());
+        DenseMatrix::MultiplyAndWeightedAdd(1, a, false, dense, true, 0, expected);
+        DenseMatrix result(m, sparse.GetNumRows());
+        SparseMatrix::MultiplyAndWeightedAdd(1, a, false, sparse, true, 0, result);
+        BOOST_CHECK(result.IsEqualTo(expected, c_epsilonFloatE4));
+
+        DenseMatrix expected2(sparse.GetNumRows(), m);
+        DenseMatrix::MultiplyAndWeightedAdd(1, dense, false, b, false, 0, expected2);
+        DenseMatrix result2(sparse.GetNumRows(), m);
+        SparseMatrix::MultiplyAndWeightedAdd(1, sparse, false, b, false, 0, result2);
+        BOOST_CHECK(result2.IsEqualTo(expected2, c_epsilonFloatE4));
+    };
+
+    checkProducts(sm);
+
+    // The product into a block column matrix (the gradient of an embedding) uses the view as well.
+    DenseMatrix a(m, k);
+    a.SetUniformRandomValue(-1, 1, IncrementCounter());
+    DenseMatrix expected(m, n);
+    DenseMatrix::MultiplyAndWeightedAdd(1, a, false, dm, true, 0, expected);
+    SparseMatrix blockCol(MatrixFormat::matrixFormatSparseBlockCol, m, n, 0);
+    SparseMatrix::MultiplyAndAdd(1, a, false, sm, true, blockCol);
+    foreach_coord(row, col, expected)
+    {
+        BOOST_CHECK(abs(blockCol(row, col) - expected(row, col)) < c_epsilonFloatE4);
+    }
+
+    // The view is reused as long as the structure does not change, and the values are always read from the matrix.
+    auto view = sm.GetCSRView();
+    BOOST_CHECK(sm.GetCSRView() == view);
+    for (size_t p = 0; p < sm.NzCount(); p++)
+        sm.Data()[p] *= 2;
+    checkProducts(sm);
+    BOOST_CHECK(sm.GetCSRView() == view);
+
+    // After the nonzero elements have moved, the view is rebuilt, also when the products on the same
+    // matrix run concurrently.
+    DenseMatrix dm2(n, k);
+    dm2.SetUniformRandomValue(-9, 1, IncrementCounter());
+    dm2.InplaceTruncateBottom(0);
+    sm.Reset();
+    AssignNonzeroElements(sm, dm2);
+
+    DenseMatrix expected2(n, m);
+    DenseMatrix b(k, m);
+    b.SetUniformRandomValue(-1, 1, IncrementCounter());
+    DenseMatrix::MultiplyAndWeightedAdd(1, dm2, false, b, false, 0, expected2);
+    std::vector<DenseMatrix> results(4);
+#pragma omp parallel for
+    for (int i = 0; i < (int)results.size(); i++)
+    {
+        results[i].Resize(n, m);
+        SparseMatrix::MultiplyAndWeightedAdd(1, sm, false, b, false, 0, results[i]);
+    }
+    for (const auto& result : results)
+        BOOST_CHECK(result.IsEqualTo(expected2, c_epsilonFloatE4));
+    BOOST_CHECK(sm.GetCSRView() != view);
+    checkProducts(sm);
+
+    // The view of a column slice takes the offset of its first nonzero element into account.
+    checkProducts(sm.ColumnSlice(100, 150));
+    checkProducts(sm.ColumnSlice(k - 1, 1));
+
+    omp_set_num_threads(maxNumThreads);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -50,6 +50,16 @@ size_t CountNans(const SingleMatrix& src)
     return n;
 }
 
+// Winograd F(4x4, 3x3) rounds differently from direct convolution in single precision. This applies only to the
+// 3x3 stride-1 convos of the Winograd engine, all other engines and geometries are held to the default tolerance.
+bool UsesWinogradTransform(ConvolutionEngineKind kind, const ConvolveGeometry& g)
+{
+    if (((int)kind & (int)ConvolutionEngineKind::Winograd) == 0)
+        return false;
+    const auto& kernel = g.KernelShape();
+    return kernel.GetRank() >= 2 && kernel[0] == 3 && kernel[1] == 3 && g.GetStride(0) == 1 && g.GetStride(1) == 1;
+}
+
 // Returns vector of engine config parameters: <kind, device, maxTempMemSizeInSamples>
 std::vector<std::tuple<ConvolutionEngineKind, DEVICEID_TYPE, size_t>> GetTestEngineConfigs()
 {
@@ -62,6 +72,12 @@ std::vector<std::tuple<ConvolutionEngineKind, DEVICEID_TYPE, size_t>> GetTestEng
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 0));
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 1));
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 3));
+
+    // Winograd engine, falls back to Gemm for the geometries it does not support. CPU only. Uses temp memory.
+    auto winograd = (ConvolutionEngineKind)((int)ConvolutionEngineKind::Winograd | (int)ConvolutionEngineKind::Gemm);
+    res.push_back(std::make_tuple(winograd, -1, 0));
+    res.push_back(std::make_tuple(winograd, -1, 1));
+    res.push_back(std::make_tuple(winograd, -1, 3));
     return res;
 }
 
@@ -121,6 +137,24 @@ std::vector<ConvolveGeometryPtr> GenerateConvTestConfigs()
         TensorShape(1, 1, 2), TensorShape(1), TensorShape(2, 2, 1),
         ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false},
         TensorShape(0, 0, 0), TensorShape(0)));
+
+    // 3x3 convolution with more tiles than fit into a single Winograd tile row.
+    res.push_back(std::make_shared<ConvolveGeometry>(TensorShape(13, 10, 4),
+        TensorShape(3, 3, 4), TensorShape(6), TensorShape(1),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false},
+        TensorShape(0), TensorShape(0)));
+
+    // 1x1 convolution with stride 1 (ResNet bottleneck).
+    res.push_back(std::make_shared<ConvolveGeometry>(TensorShape(7, 6, 8),
+        TensorShape(1, 1, 8), TensorShape(4), TensorShape(1),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{false},
+        TensorShape(0), TensorShape(0)));
+
+    // Channel-wise convolution: every input channel is convolved with each of 2 kernels of depth 1.
+    res.push_back(std::make_shared<ConvolveGeometry>(TensorShape(9, 7, 3, 1),
+        TensorShape(3, 3, 1, 1), TensorShape(2), TensorShape(2, 2, 1, 1),
+        ConvolveGeometry::BoolVec{true}, ConvolveGeometry::BoolVec{true, true, false, false},
+        TensorShape(0), TensorShape(0)));
     return res;
 }
 
@@ -224,6 +258,8 @@ BOOST_AUTO_TEST_CASE(ConvolutionForward)
 
             float relErr = Err<float>::Rel;
             float absErr = Err<float>::Abs;
+            if (UsesWinogradTransform(engKind, *g))
+                absErr = 1e-5f;
             std::string emsg;
 
             BOOST_REQUIRE_MESSAGE(!out.HasNan("out"), "out" << msgNan);
@@ -292,6 +328,8 @@ BOOST_AUTO_TEST_CASE(ConvolutionBackwardData)
 
             float relErr = Err<float>::Rel;
             float absErr = Err<float>::Abs;
+            if (UsesWinogradTransform(engKind, *g))
+                absErr = 1e-5f;
             std::string emsg;
 
             BOOST_REQUIRE_MESSAGE(!grad.HasNan("grad"), "grad" << msgNan);
@@ -70,6 +70,38 @@ public:
             func();
         }
     }
+
+    void MoveToCPU()
+    {
+        for (auto mat : { &matSG, &matSGsparse, &matM, &matMsparse, &matG, &matGsparseBSC })
+            mat->TransferToDeviceIfNotThere(CPUDEVICE, true);
+    }
+
+    // whether the columns of the gradient are present in the block-sparse gradient
+    std::vector<bool> GetUsedColumns()
+    {
+        std::vector<bool> usedColumns(dim2);
+        for (size_t j = 0; j < dim2; j++)
+            usedColumns[j] = matG.ColumnSlice(j, 1).SumOfAbsElements() != 0;
+        return usedColumns;
+    }
+
+    // The expected result of a lazy update with the block-sparse gradient: the columns present in the gradient are
+    // those of the dense update, the others keep their initial values. 'numParts' is the number of dim1 x dim2 matrices.
+    SingleMatrix ExpectedLazyUpdate(const SingleMatrix& denseResult, const SingleMatrix& initial, size_t numParts)
+    {
+        SingleMatrix expected(initial.DeepClone());
+        const auto usedColumns = GetUsedColumns();
+        for (size_t part = 0; part < numParts; part++)
+        {
+            for (size_t j = 0; j < dim2; j++)
+            {
+                if (usedColumns[j])
+                    expected.SetColumnSlice(denseResult.ColumnSlice(part * dim2 + j, 1), part * dim2 + j, 1);
+            }
+        }
+        return expected;
+    }
 };
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
@@ -115,5 +147,75 @@ BOOST_FIXTURE_TEST_CASE(AdaDeltaSparse, MatrixLearnerFixture)
     });
 }
 
+// tests the lazy FSAdagrad update of the CPU with a block-sparse gradient
+BOOST_FIXTURE_TEST_CASE(FSAdagradSparseLazyCPU, MatrixLearnerFixture)
+{
+    MoveToCPU();
+    const auto usedColumns = GetUsedColumns();
+    BOOST_REQUIRE(std::count(usedColumns.begin(), usedColumns.end(), false) > 0);
+
+    // nonzero accumulators, which the dense update also changes in the columns that are not in the gradient
+    matSG = SingleMatrix::RandomUniform(dim1, 2 * dim2, CPUDEVICE, 0.0f, 1.0f, IncrementCounter());
+    matSGsparse = SingleMatrix(matSG.DeepClone());
+
+    SingleMatrix initialM(matM.DeepClone());
+    SingleMatrix initialSG(matSG.DeepClone());
+
+    // run learner
+    double smoothedCount = 1000;
+    matSG.FSAdagradUpdate(dim2, matG, matM, smoothedCount, 0.0001, 1.0, 0.9, 0.9);
+
+    smoothedCount = 1000;
+    matSGsparse.FSAdagradUpdate(dim2, matGsparseBSC, matMsparse, smoothedCount, 0.0001, 1.0, 0.9, 0.9);
+
+    BOOST_CHECK(matSGsparse.IsEqualTo(ExpectedLazyUpdate(matSG, initialSG, 2), c_epsilonFloatE5));
+    BOOST_CHECK(matMsparse.IsEqualTo(ExpectedLazyUpdate(matM, initialM, 1), c_epsilonFloatE5));
+    BOOST_CHECK(!matM.IsEqualTo(matMsparse, c_epsilonFloatE5));
+}
+
+// tests the lazy Adam update of the CPU with a block-sparse gradient
+BOOST_FIXTURE_TEST_CASE(AdamSparseLazyCPU, MatrixLearnerFixture)
+{
+    MoveToCPU();
+
+    // nonzero accumulators, which the dense update also changes in the columns that are not in the gradient
+    matSG = SingleMatrix::RandomUniform(dim1, 2 * dim2, CPUDEVICE, 0.0f, 1.0f, IncrementCounter());
+    matSGsparse = SingleMatrix(matSG.DeepClone());
+
+    SingleMatrix initialM(matM.DeepClone());
+    SingleMatrix initialSG(matSG.DeepClone());
+
+    // run learner twice, so that the bias correction changes
+    double smoothedCount = 0;
+    double smoothedCountSparse = 0;
+    for (size_t i = 0; i < 2; i++)
+    {
+        matSG.AdamUpdate(matG, matM, smoothedCount, 0.0001, 0.9, 0.999, true);
+        matSGsparse.AdamUpdate(matGsparseBSC, matMsparse, smoothedCountSparse, 0.0001, 0.9, 0.999, true);
+    }
+
+    BOOST_CHECK_EQUAL(smoothedCount, smoothedCountSparse);
+    BOOST_CHECK(matSGsparse.IsEqualTo(ExpectedLazyUpdate(matSG, initialSG, 2), c_epsilonFloatE5));
+    BOOST_CHECK(matMsparse.IsEqualTo(ExpectedLazyUpdate(matM, initialM, 1), c_epsilonFloatE5));
+    BOOST_CHECK(!matM.IsEqualTo(matMsparse, c_epsilonFloatE5));
+}
+
+// tests the lazy RmsProp update of the CPU with a block-sparse gradient
+BOOST_FIXTURE_TEST_CASE(RmsPropSparseLazyCPU, MatrixLearnerFixture)
+{
+    MoveToCPU();
+
+    // initial state: zero variances and signs, starting step size 0.02
+    SingleMatrix initialSG = SingleMatrix::Zeros(dim1, 3 * dim2, CPUDEVICE);
+    initialSG.ColumnSlice(2 * dim2, dim2).SetValue(0.02f);
+
+    // run learner
+    matSG.RmsProp(matG, 0.99f, 1.2f, 10.0f, 0.75f, 0.1f, true);
+    float avgSparse = matSGsparse.RmsProp(matGsparseBSC, 0.99f, 1.2f, 10.0f, 0.75f, 0.1f, true);
+
+    BOOST_CHECK(matSGsparse.IsEqualTo(ExpectedLazyUpdate(matSG, initialSG, 3), c_epsilonFloatE4));
+    BOOST_CHECK(avgSparse > 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}}
@@ -5,6 +5,7 @@
 #include "stdafx.h"
 #include "../../../Source/Math/QuantizedOperations.h"
 #include "../../../Source/Math/Helpers.h"
+#include <random>
 
 using namespace Microsoft::MSR::CNTK;
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
@@ -50,6 +51,35 @@ BOOST_FIXTURE_TEST_CASE(MultiplyIntToShort, RandomSeedFixture)
         BOOST_CHECK_EQUAL(round(C_upd[i]), C_expected_upd[i]);
 }
 
+BOOST_FIXTURE_TEST_CASE(BlockMultiplierMatchesReference, RandomSeedFixture)
+{
+    // Sizes that exercise all block sizes of the common dimension, single and multiple panels, and n not a multiple of 4.
+    const int sizes[][3] = { { 5, 4, 3 }, { 64, 1, 128 + 64 + 32 + 16 + 8 + 3 }, { 300, 7, 512 }, { 257, 33, 100 } };
+    std::mt19937 rng(IncrementCounter());
+    std::uniform_real_distribution<float> distribution(-1, 1);
+    for (const auto& size : sizes)
+    {
+        int m = size[0], n = size[1], k = size[2];
+        std::vector<float> A(m * k), B(k * n), C(m * n), C_reference(m * n);
+        for (auto& a : A)
+            a = distribution(rng);
+        for (auto& b : B)
+            b = distribution(rng);
+
+        QuantizedMultiplier<float> mult(make_shared<SymmetricQuantizer<float, short>>(3), true, make_shared<SymmetricQuantizer<float, short>>(3), false);
+        QuantizedMultiplier<float> reference(make_shared<SymmetricQuantizer<float, short>>(3), true, make_shared<SymmetricQuantizer<float, short>>(3), false);
+        reference.SetUseBlockMultiplier(false);
+
+        // The second pass reuses the prepared A.
+        for (int pass = 0; pass < 2; pass++)
+        {
+            mult.Multiply(m, n, k, A.data(), B.data(), C.data());
+            reference.Multiply(m, n, k, A.data(), B.data(), C_reference.data());
+            for (size_t i = 0; i < C.size(); i++)
+                BOOST_REQUIRE_EQUAL(C[i], C_reference[i]);
+        }
+    }
+}
 
 BOOST_AUTO_TEST_SUITE_END()
 
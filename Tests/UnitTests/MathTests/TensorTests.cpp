@@ -7,11 +7,67 @@
 #include "TensorView.h"
 #include "Sequences.h"
 #include "TensorTestsHelper.h"
+#include <omp.h>
 
 using namespace Microsoft::MSR::CNTK;
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
 
+// Sums 'input' into a tensor of 'resultShape' on the CPU, with the given number of OpenMP threads.
+static vector<float> SumOnCPU(const vector<float>& input, const TensorShape& inputShape, const TensorShape& resultShape, int numThreads)
+{
+    let inputSob = make_shared<Matrix<float>>(input.size(), 1, const_cast<float*>(input.data()), CPUDEVICE);
+    let resultSob = make_shared<Matrix<float>>(resultShape.GetNumElements(), 1, CPUDEVICE);
+    TensorView<float> inputTensor(inputSob, inputShape);
+    TensorView<float> resultTensor(resultSob, resultShape);
+
+    int maxNumThreads = omp_get_max_threads();
+    omp_set_num_threads(numThreads);
+    resultTensor.DoCopyOf(0, inputTensor, 1);
+    omp_set_num_threads(maxNumThreads);
+    return vector<float>(resultSob->Data(), resultSob->Data() + resultSob->GetNumElements());
+}
+
+// A large reduction gives the same result whether it is split across threads or not, and keeps the
+// precision of the 'double' aggregator: the elements are all close to 1, so that a 'float' aggregator
+// would lose most of the contributions of the later elements.
+static void TestParallelReductionMatchesSerial(const TensorShape& inputShape, const TensorShape& resultShape)
+{
+    std::mt19937 rng(1);
+    boost::random::uniform_real_distribution<float> nd(0.5, 1.5);
+    vector<float> input(inputShape.GetNumElements());
+    generate(begin(input), end(input), [&] { return nd(rng); });
+
+    // reference computed in double; the reduced dimensions are the ones of size 1 in 'resultShape'
+    vector<double> expected(resultShape.GetNumElements(), 0);
+    for (size_t k = 0; k < input.size(); k++)
+    {
+        size_t index = 0;
+        size_t resultStride = 1;
+        size_t rest = k;
+        for (size_t i = 0; i < inputShape.GetRank(); i++)
+        {
+            size_t coordinate = rest % inputShape[i];
+            rest /= inputShape[i];
+            size_t resultDim = i < resultShape.GetRank() ? resultShape[i] : 1;
+            if (resultDim != 1)
+                index += coordinate * resultStride;
+            resultStride *= resultDim;
+        }
+        expected[index] += input[k];
+    }
+
+    let serial = SumOnCPU(input, inputShape, resultShape, 1);
+    let parallel = SumOnCPU(input, inputShape, resultShape, 4);
+    BOOST_REQUIRE_EQUAL(serial.size(), expected.size());
+    BOOST_REQUIRE_EQUAL(parallel.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        BOOST_CHECK_CLOSE(serial[i], expected[i], 1e-4 /*percent*/);
+        BOOST_CHECK_CLOSE(parallel[i], serial[i], 1e-4 /*percent*/);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE(MathTensorTests)
 
 BOOST_AUTO_TEST_CASE(ElementwiseAddition)
@@ -85,6 +141,17 @@ BOOST_AUTO_TEST_CASE(BiasGradient2)
     });
 }
 
+BOOST_AUTO_TEST_CASE(ParallelReductionToScalar)
+{
+    TestParallelReductionMatchesSerial(TensorShape{ 4096, 1024 }, TensorShape{ 1, 1 });
+}
+
+BOOST_AUTO_TEST_CASE(ParallelReductionToVector)
+{
+    TestParallelReductionMatchesSerial(TensorShape{ 64, 65536 }, TensorShape{ 64 });
+    TestParallelReductionMatchesSerial(TensorShape{ 65536, 64 }, TensorShape{ 1, 64 });
+}
+
 BOOST_AUTO_TEST_CASE(ColumnSliceMultAndAdd)
 {
     ColumnSliceMultAndAddTest<float>(2048, 2048, 256, 0);
@@ -0,0 +1,198 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/SGDLib/AsyncCheckpointWriter.h"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+static vector<float> ToVector(const Matrix<float>& matrix)
+{
+    return vector<float>(matrix.Data(), matrix.Data() + matrix.GetNumElements());
+}
+
+static void FillMatrix(Matrix<float>& matrix, float offset)
+{
+    for (size_t k = 0; k < matrix.GetNumElements(); k++)
+        matrix.Data()[k] = offset + k;
+}
+
+BOOST_AUTO_TEST_SUITE(AsyncCheckpointWriterTestSuite)
+
+BOOST_AUTO_TEST_CASE(HostMatrixSnapshotCopiesMatrices)
+{
+    Matrix<float> dense(3, 4, c_deviceId);
+    FillMatrix(dense, 1);
+    Matrix<float> empty(0, 5, c_deviceId);
+
+    // 4 x 3 sparse matrix with the elements (0,0)=1, (2,0)=2, (3,2)=3
+    Matrix<float> sparse(4, 3, c_deviceId, MatrixType::SPARSE, MatrixFormat::matrixFormatSparseCSC);
+    const CPUSPARSE_INDEX_TYPE columnStarts[] = { 0, 2, 2, 3 };
+    const CPUSPARSE_INDEX_TYPE rows[] = { 0, 2, 3 };
+    const float values[] = { 1, 2, 3 };
+    sparse.SetMatrixFromCSCFormat(columnStarts, rows, values, 3, 4, 3);
+    Matrix<float> sparseExpected(sparse.DeepClone());
+    sparseExpected.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, true);
+
+    auto denseExpected = ToVector(dense);
+    HostMatrixSnapshot<float> snapshot({ &dense, &empty, &sparse }, c_deviceId);
+
+    // the copies do not change with the matrices they were taken from
+    dense.SetValue(0);
+    sparse.Reset();
+
+    BOOST_REQUIRE_EQUAL(snapshot.Size(), 3);
+    BOOST_CHECK_EQUAL(snapshot[0]->GetNumRows(), 3);
+    BOOST_CHECK_EQUAL(snapshot[0]->GetNumCols(), 4);
+    auto denseCopy = ToVector(*snapshot[0]);
+    BOOST_CHECK_EQUAL_COLLECTIONS(denseCopy.begin(), denseCopy.end(), denseExpected.begin(), denseExpected.end());
+
+    BOOST_CHECK_EQUAL(snapshot[1]->GetNumRows(), 0);
+    BOOST_CHECK_EQUAL(snapshot[1]->GetNumCols(), 5);
+
+    BOOST_CHECK(snapshot[2]->GetMatrixType() == MatrixType::SPARSE);
+    Matrix<float> sparseCopy(snapshot[2]->DeepClone());
+    sparseCopy.SwitchToMatrixType(MatrixType::DENSE, MatrixFormat::matrixFormatDense, true);
+    BOOST_CHECK(sparseCopy.IsEqualTo(sparseExpected));
+}
+
+BOOST_AUTO_TEST_CASE(AsyncCheckpointWriterRunsTasksInOrder)
+{
+    const size_t numTasks = 20;
+    vector<size_t> executed;
+    atomic<bool> ranOnCallingThread(false);
+    auto callingThread = this_thread::get_id();
+    {
+        AsyncCheckpointWriter writer(/*maxPending=*/3);
+        for (size_t i = 0; i < numTasks; i++)
+        {
+            writer.Submit([&, i]()
+            {
+                if (this_thread::get_id() == callingThread)
+                    ranOnCallingThread = true;
+                executed.push_back(i);
+            });
+        }
+        writer.WaitForAll();
+        BOOST_CHECK_EQUAL(executed.size(), numTasks);
+
+        // tasks still pending when the writer is destroyed are completed
+        writer.Submit([&]() { executed.push_back(numTasks); });
+    }
+
+    BOOST_REQUIRE_EQUAL(executed.size(), numTasks + 1);
+    for (size_t i = 0; i <= numTasks; i++)
+        BOOST_CHECK_EQUAL(executed[i], i);
+    BOOST_CHECK(!ranOnCallingThread);
+}
+
+BOOST_AUTO_TEST_CASE(AsyncCheckpointWriterRethrowsErrors)
+{
+    AsyncCheckpointWriter writer(/*maxPending=*/2);
+    bool ranAfterError = false;
+    writer.Submit([]() { throw runtime_error("disk full"); });
+    writer.Submit([&]() { ranAfterError = true; });
+    BOOST_CHECK_THROW(writer.WaitForAll(), runtime_error);
+    BOOST_CHECK(ranAfterError);
+
+    // an error is reported once
+    writer.WaitForAll();
+
+    // and also to Submit()
+    writer.Submit([]() { throw runtime_error("disk full"); });
+    BOOST_CHECK_THROW(
+        {
+            // the failing task may still be running when the next one is submitted; then the error comes with the one after
+            writer.Submit([]() {});
+            writer.Submit([]() {});
+            writer.Submit([]() {});
+        },
+        runtime_error);
+    writer.WaitForAll();
+}
+
+BOOST_AUTO_TEST_CASE(AsyncCheckpointWriterBoundsPendingTasks)
+{
+    AsyncCheckpointWriter writer(/*maxPending=*/2);
+    atomic<bool> release(false);
+    atomic<bool> submittedThird(false);
+    auto blockingTask = [&]()
+    {
+        while (!release)
+            this_thread::sleep_for(chrono::milliseconds(1));
+    };
+    writer.Submit(blockingTask);
+    writer.Submit([]() {});
+
+    thread submitter([&]()
+    {
+        writer.Submit([]() {});
+        submittedThird = true;
+    });
+    this_thread::sleep_for(chrono::milliseconds(200));
+    BOOST_CHECK(!submittedThird);
+
+    release = true;
+    submitter.join();
+    BOOST_CHECK(submittedThird);
+    writer.WaitForAll();
+}
+
+// The model is serialized on the calling thread with the parameter values of the snapshot; later changes to
+// the network do not affect the file written in the background.
+BOOST_AUTO_TEST_CASE(ModelSerializedIntoMemoryIsWrittenAsOfSnapshot)
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto features = builder.CreateInputNode(L"features", TensorShape(4));
+    auto weights = builder.CreateLearnableParameter(L"W", 3, 4);
+    auto output = builder.Times(weights, features, 1, L"output");
+    net->AddToNodeGroup(L"output", output);
+    net->CompileNetwork();
+    FillMatrix(weights->Value(), 1);
+    auto expected = ToVector(weights->Value());
+
+    const wstring fileName = L"AsyncCheckpointWriterTest.model";
+    {
+        AsyncCheckpointWriter writer(/*maxPending=*/1);
+        auto contents = make_shared<vector<char>>();
+        {
+            HostMatrixSnapshot<float> snapshot({ &weights->Value() }, c_deviceId);
+            File fstream(File::InMemory(), FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+            net->Save(fstream, { { L"W", snapshot[0] } });
+            *contents = fstream.GetMemoryContents();
+        }
+        weights->Value().SetValue(-1);
+
+        writer.Submit([fileName, contents]()
+        {
+            File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+            fwriteOrDie(contents->data(), 1, contents->size(), fstream);
+        });
+        writer.WaitForAll();
+    }
+
+    auto loaded = ComputationNetwork::CreateFromFile<float>(c_deviceId, fileName);
+    auto loadedWeights = ToVector(dynamic_pointer_cast<ComputationNode<float>>(loaded->GetNodeFromName(L"W"))->Value());
+    BOOST_CHECK_EQUAL_COLLECTIONS(loadedWeights.begin(), loadedWeights.end(), expected.begin(), expected.end());
+    BOOST_CHECK(loaded->NodeNameExists(L"output"));
+    _wunlink(fileName.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,474 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/FusedElementwiseNodes.h"
+#include "../../../Source/ComputationNetworkLib/LinearAlgebraNodes.h"
+#include "Globals.h"
+#include "TestHelpers.h"
+#include <memory>
+#include <cmath>
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// Fused nodes are only supported on the CPU.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+static const float c_epsilonFloatE4 = 0.0001f;
+
+// Input node with given values, with or without MBLayout.
+template <class ElemType>
+class FusedInputNodeTest : public ComputationNode<ElemType>
+{
+    typedef ComputationNode<ElemType> Base;
+    UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"FusedInputTest"; }
+
+public:
+    FusedInputNodeTest(DEVICEID_TYPE deviceId, const wstring& name)
+        : Base(deviceId, name)
+    {
+    }
+
+    FusedInputNodeTest(const wstring& name, size_t numRows, const vector<ElemType>& data, MBLayoutPtr mbLayout)
+        : Base(c_deviceId, name)
+    {
+        this->LinkToMBLayout(mbLayout);
+        this->SetDims(TensorShape(numRows), mbLayout != nullptr);
+        this->CreateValueMatrixIfNull();
+        this->Value().Resize(numRows, data.size() / numRows);
+        copy(data.begin(), data.end(), this->Value().Data());
+        this->CreateGradientMatrixIfNull();
+        this->Gradient().Resize(numRows, data.size() / numRows);
+        this->Gradient().SetValue(0);
+    }
+
+    virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& /*fr*/) override
+    {
+    }
+
+    virtual void /*ComputationNode::*/ BackpropTo(const size_t /*inputIndex*/, const FrameRange& /*fr*/) override
+    {
+    }
+
+    Matrix<ElemType>& GetGradient() { return this->Gradient(); }
+};
+
+// Extends fused node to provide access to protected members.
+template <class ElemType>
+class FusedElementwiseNodeTest : public FusedElementwiseNode<ElemType>
+{
+public:
+    FusedElementwiseNodeTest(const vector<FusedElementwiseInstruction>& program)
+        : FusedElementwiseNode<ElemType>(c_deviceId, L"FusedElementwiseNodeTest", program, {})
+    {
+    }
+
+    void ForwardPass()
+    {
+        this->CreateValueMatrixIfNull();
+        this->Value().Resize(this->GetSampleMatrixNumRows(), this->GetMBLayout()->GetNumCols());
+        FrameRange fr(this->GetMBLayout());
+        this->BeginForwardProp();
+        this->ForwardProp(fr);
+        this->EndForwardProp();
+    }
+
+    void BackwardPass(const vector<ElemType>& outputGradient)
+    {
+        this->CreateGradientMatrixIfNull();
+        this->Gradient().Resize(this->GetSampleMatrixNumRows(), this->GetMBLayout()->GetNumCols());
+        copy(outputGradient.begin(), outputGradient.end(), this->Gradient().Data());
+        FrameRange fr(this->GetMBLayout());
+        for (size_t i = 0; i < this->GetNumInputs(); i++)
+            this->BackpropTo(i, fr);
+    }
+
+    const ElemType* GetOutput() { return this->Value().Data(); }
+    TensorShape GetOutputShape() { return this->GetSampleLayout(); }
+};
+
+template <class ElemType>
+void FusedElementwiseNodeForwardBackwardTestImpl()
+{
+    // Two sequences of 2 and 1 samples, i.e. the last column is a gap.
+    const size_t numRows = 3;
+    const size_t numCols = 4;
+    auto mbLayout = make_shared<MBLayout>();
+    mbLayout->Init(2, 2);
+    mbLayout->AddSequence(0, 0, 0, 2);
+    mbLayout->AddSequence(1, 1, 0, 1);
+    mbLayout->AddGap(1, 1, 2);
+    const size_t gapColumn = 3;
+
+    // y = Sigmoid(x + b) .* x - c, with the bias b broadcast over the columns and a scalar c
+    vector<ElemType> xData{ 0.5f, -1, 2, 1, 0, -0.5f, -2, 1.5f, 0.25f, 3, -3, 1 };
+    vector<ElemType> bData{ 0.1f, -0.2f, 0.3f };
+    vector<ElemType> cData{ 0.7f };
+    auto x = make_shared<FusedInputNodeTest<ElemType>>(L"x", numRows, xData, mbLayout);
+    auto b = make_shared<FusedInputNodeTest<ElemType>>(L"b", numRows, bData, nullptr);
+    auto c = make_shared<FusedInputNodeTest<ElemType>>(L"c", 1, cData, nullptr);
+
+    vector<FusedElementwiseInstruction> program{
+        { FusedElementwiseOp::Plus,         { 0, 1 } }, // [3] = x + b
+        { FusedElementwiseOp::Sigmoid,      { 3, 3 } }, // [4] = Sigmoid([3])
+        { FusedElementwiseOp::ElementTimes, { 4, 0 } }, // [5] = [4] .* x
+        { FusedElementwiseOp::Minus,        { 5, 2 } }, // [6] = [5] - c
+    };
+    auto fusedNode = make_shared<FusedElementwiseNodeTest<ElemType>>(program);
+    fusedNode->AttachInputs({ x, b, c });
+    fusedNode->Validate(true);
+    BOOST_REQUIRE_MESSAGE(fusedNode->GetOutputShape() == TensorShape(numRows), "Fused node has the wrong shape");
+
+    fusedNode->ForwardPass();
+
+    vector<ElemType> outputGradient{ 1, 2, -1, 0.5f, -0.5f, 1, 2, 0, 1, -1, 3, 2 };
+    fusedNode->BackwardPass(outputGradient);
+
+    // compute the expected values and gradients
+    vector<ElemType> expectedOutput(numRows * numCols);
+    vector<ElemType> expectedXGradient(numRows * numCols);
+    vector<ElemType> expectedBGradient(numRows, 0);
+    vector<ElemType> expectedCGradient(1, 0);
+    for (size_t j = 0; j < numCols; j++)
+    {
+        for (size_t i = 0; i < numRows; i++)
+        {
+            size_t k = j * numRows + i;
+            ElemType s = 1 / (1 + exp(-(xData[k] + bData[i])));
+            ElemType g = outputGradient[k];
+            expectedOutput[k] = s * xData[k] - cData[0];
+            expectedXGradient[k] = g * (s * (1 - s) * xData[k] + s);
+            // gaps must not contribute to the gradients of the broadcast inputs
+            if (j != gapColumn)
+            {
+                expectedBGradient[i] += g * s * (1 - s) * xData[k];
+                expectedCGradient[0] -= g;
+            }
+        }
+    }
+
+    BOOST_REQUIRE_MESSAGE(AreEqual(expectedOutput.data(), fusedNode->GetOutput(), expectedOutput.size(), c_epsilonFloatE4), "Fused node output is invalid");
+    BOOST_REQUIRE_MESSAGE(AreEqual(expectedXGradient.data(), x->GetGradient().Data(), expectedXGradient.size(), c_epsilonFloatE4), "Gradient of the full input is invalid");
+    BOOST_REQUIRE_MESSAGE(AreEqual(expectedBGradient.data(), b->GetGradient().Data(), expectedBGradient.size(), c_epsilonFloatE4), "Gradient of the broadcast input is invalid");
+    BOOST_REQUIRE_MESSAGE(AreEqual(expectedCGradient.data(), c->GetGradient().Data(), expectedCGradient.size(), c_epsilonFloatE4), "Gradient of the scalar input is invalid");
+}
+
+template <class ElemType>
+void FusedElementwiseNodeValidateTestImpl()
+{
+    // An input with MBLayout that is smaller than the output cannot be broadcast.
+    auto mbLayout = make_shared<MBLayout>();
+    mbLayout->InitAsFrameMode(2);
+    auto x = make_shared<FusedInputNodeTest<ElemType>>(L"x", 3, vector<ElemType>(6, 1), mbLayout);
+    auto y = make_shared<FusedInputNodeTest<ElemType>>(L"y", 1, vector<ElemType>(2, 1), mbLayout);
+
+    vector<FusedElementwiseInstruction> program{ { FusedElementwiseOp::Plus, { 0, 1 } } };
+    auto fusedNode = make_shared<FusedElementwiseNodeTest<ElemType>>(program);
+    fusedNode->AttachInputs({ x, y });
+    BOOST_REQUIRE_THROW(fusedNode->Validate(true), std::invalid_argument);
+}
+
+// Sets whether elementwise operations are fused, for the scope of a test.
+class ElementwiseFusionScope
+{
+public:
+    ElementwiseFusionScope(bool enable)
+        : m_fuseElementwiseOperations(Globals::ShouldFuseElementwiseOperations())
+    {
+        Globals::SetElementwiseFusion(enable);
+    }
+
+    ~ElementwiseFusionScope()
+    {
+        Globals::SetElementwiseFusion(m_fuseElementwiseOperations);
+    }
+
+private:
+    bool m_fuseElementwiseOperations;
+};
+
+static const size_t c_dim = 8;
+static const size_t c_numSamples = 5;
+static const wstring c_fusedTypeName = L"FusedElementwise";
+
+static Matrix<float>& GetValue(const ComputationNetworkPtr& net, const wstring& nodeName)
+{
+    return dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(nodeName))->Value();
+}
+
+static vector<float> ToVector(const Matrix<float>& matrix)
+{
+    return vector<float>(matrix.Data(), matrix.Data() + matrix.GetNumElements());
+}
+
+static void SetRandomValues(Matrix<float>& matrix, unsigned int seed)
+{
+    mt19937 rng(seed);
+    uniform_real_distribution<float> distribution(-1, 1);
+    for (size_t k = 0; k < matrix.GetNumElements(); k++)
+        matrix.Data()[k] = distribution(rng);
+}
+
+// plus = Times(W, features) + b
+// output = Tanh(Sigmoid(plus)) .* features
+// criterion = SquareError(labels, output + Exp(plus))
+// With 'plus' used twice and 'output' in a node group, the chain Sigmoid, Tanh, ElementTimes is fused into 'output',
+// and Exp, Plus into 'sum'.
+static ComputationNetworkPtr CreateNetwork()
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto features = builder.CreateInputNode(L"features", TensorShape(c_dim));
+    auto labels = builder.CreateInputNode(L"labels", TensorShape(c_dim));
+    auto w = builder.CreateLearnableParameter(L"W", c_dim, c_dim);
+    auto b = builder.CreateLearnableParameter(L"b", c_dim, 1);
+    auto plus = builder.Plus(builder.Times(w, features, 1, L"times"), b, L"plus");
+    auto output = builder.ElementTimes(builder.Tanh(builder.Sigmoid(plus, L"sigmoid"), L"tanh"), features, L"output");
+    auto criterion = builder.SquareError(labels, builder.Plus(output, builder.Exp(plus, L"exp"), L"sum"), L"criterion");
+    net->AddToNodeGroup(L"output", output);
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+
+    SetRandomValues(w->Value(), 1);
+    SetRandomValues(b->Value(), 2);
+    return net;
+}
+
+static void SetInputValues(const ComputationNetworkPtr& net)
+{
+    net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(c_numSamples);
+    unsigned int seed = 3;
+    for (auto name : { L"features", L"labels" })
+    {
+        auto& value = GetValue(net, name);
+        value.Resize(c_dim, c_numSamples);
+        SetRandomValues(value, seed++);
+    }
+}
+
+// Runs one forward and backward pass, returns the output, the criterion and the gradients of the parameters.
+static vector<vector<float>> RunTrainingStep(const ComputationNetworkPtr& net)
+{
+    auto criterion = net->GetNodeFromName(L"criterion");
+    net->AllocateAllMatrices(net->OutputNodes(), {}, criterion);
+    SetInputValues(net);
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    net->StartEvaluateMinibatchLoop(criterion);
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ net->GetNodeFromName(L"features"), net->GetNodeFromName(L"labels") });
+    net->ForwardProp(criterion);
+    net->Backprop(criterion);
+
+    vector<vector<float>> results{ ToVector(GetValue(net, L"output")), ToVector(GetValue(net, L"criterion")) };
+    for (auto name : { L"W", L"b" })
+        results.push_back(ToVector(dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(name))->Gradient()));
+    return results;
+}
+
+static vector<wstring> GetOriginalNodeNames(const ComputationNetworkPtr& net, const wstring& fusedNodeName)
+{
+    auto fusedNode = dynamic_pointer_cast<FusedElementwiseNodeBase>(net->GetNodeFromName(fusedNodeName));
+    BOOST_REQUIRE(fusedNode);
+    vector<wstring> names;
+    for (const auto& node : fusedNode->GetOriginalNodes())
+        names.push_back(node->NodeName());
+    return names;
+}
+
+// Checks that the network holds the nodes it was created with, and no fused nodes.
+static void CheckUnfused(const ComputationNetworkPtr& net)
+{
+    BOOST_CHECK(net->GetNodesWithType(c_fusedTypeName).empty());
+    for (auto name : { L"times", L"plus", L"sigmoid", L"tanh", L"output", L"exp", L"sum", L"criterion" })
+        BOOST_CHECK(net->NodeNameExists(name));
+    BOOST_CHECK(ComputationNetwork::IsNodePtr<ElementTimesNode<float>>(net->GetNodeFromName(L"output")));
+    BOOST_CHECK(net->GetNodeFromName(L"output")->GetInputs()[0] == net->GetNodeFromName(L"tanh"));
+    BOOST_CHECK(net->GetNodeFromName(L"tanh")->GetInputs()[0] == net->GetNodeFromName(L"sigmoid"));
+    BOOST_CHECK(net->GetNodeFromName(L"sum")->GetInputs()[1] == net->GetNodeFromName(L"exp"));
+}
+
+static void CheckEqual(const vector<vector<float>>& a, const vector<vector<float>>& b)
+{
+    BOOST_REQUIRE_EQUAL(a.size(), b.size());
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        BOOST_REQUIRE_EQUAL(a[i].size(), b[i].size());
+        BOOST_CHECK(AreEqual(a[i].data(), b[i].data(), a[i].size(), c_epsilonFloatE4));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(FusedElementwiseNodeTestSuite)
+
+BOOST_AUTO_TEST_CASE(FusedElementwiseNodeForwardBackwardTest)
+{
+    FusedElementwiseNodeForwardBackwardTestImpl<float>();
+    FusedElementwiseNodeForwardBackwardTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_CASE(FusedElementwiseNodeValidateTest)
+{
+    FusedElementwiseNodeValidateTestImpl<float>();
+    FusedElementwiseNodeValidateTestImpl<double>();
+}
+
+// Chains of elementwise nodes with a single consumer each are fused up to nodes that are used more than once or that
+// are accessed from outside; the fused node takes the name of the last node of the chain.
+BOOST_AUTO_TEST_CASE(FuseElementwiseNodesGroupsChains)
+{
+    ElementwiseFusionScope scope(true);
+    auto net = CreateNetwork();
+    BOOST_CHECK_EQUAL(net->GetNodesWithType(c_fusedTypeName).size(), 2);
+
+    auto outputNames = GetOriginalNodeNames(net, L"output");
+    vector<wstring> expectedOutputNames{ L"sigmoid", L"tanh", L"output" };
+    BOOST_CHECK(outputNames == expectedOutputNames);
+    auto sumNames = GetOriginalNodeNames(net, L"sum");
+    vector<wstring> expectedSumNames{ L"exp", L"sum" };
+    BOOST_CHECK(sumNames == expectedSumNames);
+
+    // the fused node is in the node group of the node it replaces, and the inputs of the chain are its inputs
+    BOOST_CHECK(net->OutputNodes()[0] == net->GetNodeFromName(L"output"));
+    BOOST_CHECK(ComputationNetwork::IsNodePtr<PlusNode<float>>(net->GetNodeFromName(L"plus")));
+    BOOST_CHECK(ComputationNetwork::IsNodePtr<TimesNode<float>>(net->GetNodeFromName(L"times")));
+    BOOST_CHECK(net->GetNodeFromName(L"criterion")->GetInputs()[1] == net->GetNodeFromName(L"sum"));
+
+    // the fused-away nodes cannot be accessed by name
+    BOOST_CHECK(!net->NodeNameExists(L"tanh"));
+    BOOST_CHECK_THROW(net->GetNodeFromName(L"tanh"), runtime_error);
+    BOOST_CHECK_THROW(net->GetNodeFromName(L"exp"), runtime_error);
+
+    // neither with fusion turned off for the network nor globally
+    auto unfused = make_shared<ComputationNetwork>(c_deviceId);
+    unfused->SetElementwiseFusion(false);
+    {
+        ComputationNetworkBuilder<float> builder(*unfused);
+        auto features = builder.CreateInputNode(L"features", TensorShape(c_dim));
+        unfused->AddToNodeGroup(L"output", builder.Tanh(builder.Sigmoid(features, L"sigmoid"), L"tanh"));
+        unfused->CompileNetwork();
+    }
+    BOOST_CHECK(unfused->GetNodesWithType(c_fusedTypeName).empty());
+    BOOST_CHECK(unfused->NodeNameExists(L"sigmoid"));
+
+    ElementwiseFusionScope disabled(false);
+    CheckUnfused(CreateNetwork());
+}
+
+BOOST_AUTO_TEST_CASE(FusedNetworkMatchesUnfused)
+{
+    vector<vector<float>> expected;
+    {
+        ElementwiseFusionScope scope(false);
+        expected = RunTrainingStep(CreateNetwork());
+    }
+    ElementwiseFusionScope scope(true);
+    auto net = CreateNetwork();
+    BOOST_REQUIRE_EQUAL(net->GetNodesWithType(c_fusedTypeName).size(), 2);
+    CheckEqual(expected, RunTrainingStep(net));
+}
+
+// criterion = SquareError(labels, (W1 features + W2 features) + W3 features), where the Plus chain is fused into a node without saved operations
+static vector<vector<float>> RunTrainingStepOfSum()
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto features = builder.CreateInputNode(L"features", TensorShape(c_dim));
+    auto labels = builder.CreateInputNode(L"labels", TensorShape(c_dim));
+    shared_ptr<ComputationNode<float>> sum;
+    for (size_t i = 1; i <= 3; i++)
+    {
+        auto w = builder.CreateLearnableParameter(L"W" + to_wstring(i), c_dim, c_dim);
+        SetRandomValues(w->Value(), (unsigned int)i);
+        auto times = builder.Times(w, features, 1, L"times" + to_wstring(i));
+        sum = sum ? builder.Plus(sum, times, L"sum" + to_wstring(i)) : times;
+    }
+    ComputationNodeBasePtr criterion = builder.SquareError(labels, sum, L"criterion");
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+    BOOST_CHECK_EQUAL(net->GetNodesWithType(c_fusedTypeName).size(), Globals::ShouldFuseElementwiseOperations() ? 1 : 0);
+
+    net->AllocateAllMatrices({}, {}, criterion);
+    SetInputValues(net);
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    net->StartEvaluateMinibatchLoop(criterion);
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ features, labels });
+    net->ForwardProp(criterion);
+    net->Backprop(criterion);
+
+    vector<vector<float>> results{ ToVector(GetValue(net, L"criterion")) };
+    for (auto name : { L"W1", L"W2", L"W3" })
+        results.push_back(ToVector(dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(name))->Gradient()));
+    return results;
+}
+
+BOOST_AUTO_TEST_CASE(FusedNodeWithoutSavedValuesMatchesUnfused)
+{
+    vector<vector<float>> expected;
+    {
+        ElementwiseFusionScope scope(false);
+        expected = RunTrainingStepOfSum();
+    }
+    ElementwiseFusionScope scope(true);
+    CheckEqual(expected, RunTrainingStepOfSum());
+}
+
+// A fused network is saved with the nodes it was created with, so that the model does not depend on whether it was fused.
+BOOST_AUTO_TEST_CASE(FusedNetworkIsSavedAsOriginalNodes)
+{
+    ElementwiseFusionScope scope(true);
+    auto net = CreateNetwork();
+    auto expected = RunTrainingStep(net);
+
+    const wstring fileName = L"FusedElementwiseNodeTest.model";
+    net->Save(fileName);
+    BOOST_CHECK_EQUAL(net->GetNodesWithType(c_fusedTypeName).size(), 2);
+
+    {
+        ElementwiseFusionScope disabled(false);
+        auto loaded = ComputationNetwork::CreateFromFile<float>(c_deviceId, fileName);
+        CheckUnfused(loaded);
+        CheckEqual(expected, RunTrainingStep(loaded));
+    }
+
+    // and fused again when loaded with fusion enabled
+    auto loaded = ComputationNetwork::CreateFromFile<float>(c_deviceId, fileName);
+    BOOST_CHECK_EQUAL(loaded->GetNodesWithType(c_fusedTypeName).size(), 2);
+    CheckEqual(expected, RunTrainingStep(loaded));
+    _wunlink(fileName.c_str());
+}
+
+// Editing the network restores the original nodes, so that they can be addressed by name; compiling fuses them again.
+BOOST_AUTO_TEST_CASE(EditingNetworkUnfusesNodes)
+{
+    ElementwiseFusionScope scope(true);
+    auto net = CreateNetwork();
+    BOOST_REQUIRE_EQUAL(net->GetNodesWithType(c_fusedTypeName).size(), 2);
+
+    net->RenameNode(L"tanh", L"tanh2");
+    BOOST_CHECK(net->GetNodesWithType(c_fusedTypeName).empty());
+    BOOST_CHECK(net->NodeNameExists(L"tanh2"));
+    BOOST_CHECK(!net->NodeNameExists(L"tanh"));
+    BOOST_CHECK(net->NodeNameExists(L"sigmoid"));
+    BOOST_CHECK(net->NodeNameExists(L"exp"));
+    BOOST_CHECK(ComputationNetwork::IsNodePtr<ElementTimesNode<float>>(net->GetNodeFromName(L"output")));
+    BOOST_CHECK(net->GetNodeFromName(L"output")->GetInputs()[0] == net->GetNodeFromName(L"tanh2"));
+
+    net->CompileNetwork();
+    BOOST_CHECK_EQUAL(net->GetNodesWithType(c_fusedTypeName).size(), 2);
+    auto outputNames = GetOriginalNodeNames(net, L"output");
+    vector<wstring> expectedOutputNames{ L"sigmoid", L"tanh2", L"output" };
+    BOOST_CHECK(outputNames == expectedOutputNames);
+    BOOST_CHECK_THROW(net->GetNodeFromName(L"tanh2"), runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+} } } }
@@ -0,0 +1,271 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "Matrix.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/SGDLib/SimpleDistGradAggregator.h"
+#include "../../../Source/SGDLib/SGD.h"
+#include <memory>
+#include <unordered_map>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+// small buckets, so that most of them hold several gradients and are packed
+static const size_t c_bucketSizeInBytes = 16 * sizeof(float);
+static const size_t c_numMinibatches = 3;
+static const vector<pair<size_t, size_t>> c_gradientDims = { { 3, 4 }, { 5, 1 }, { 2, 2 }, { 6, 1 }, { 4, 5 }, { 1, 3 } };
+
+static MPIWrapperPtr GetMPIWrapper()
+{
+    auto mpi = MPIWrapper::GetInstance();
+    return mpi ? mpi : MPIWrapper::GetInstance(/*create=*/true);
+}
+
+// the gradient contribution of a sub-minibatch
+static void ComputeGradient(Matrix<float>& gradient, size_t gradientIndex, size_t minibatch, size_t subminibatch)
+{
+    for (size_t k = 0; k < gradient.GetNumElements(); k++)
+        gradient.Data()[k] = (float)(1 + gradientIndex + 0.5 * k + 10 * minibatch + 100 * subminibatch);
+}
+
+// Aggregates the gradients of a few minibatches the way SGD does, each processed in 'numSubminibatches' parts whose gradients
+// are accumulated after their backprop. The aggregation overlaps with the backprop: the aggregator is told about each gradient
+// as soon as the backprop has completed it, unless there are sub-minibatches. Returns the aggregated gradients of the last minibatch.
+static vector<vector<float>> AggregateMinibatches(size_t numSubminibatches)
+{
+    SimpleDistGradAggregator<float> aggregator(GetMPIWrapper(), /*useAsyncAggregation=*/false, c_deviceId, /*syncStatsTrace=*/0,
+                                               DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES, c_bucketSizeInBytes);
+    BOOST_REQUIRE(aggregator.SupportsOverlappedAggregation());
+
+    vector<shared_ptr<Matrix<float>>> gradientMatrices;
+    vector<shared_ptr<Matrix<float>>> accumulators;
+    vector<Matrix<float>*> gradients;
+    for (auto dims : c_gradientDims)
+    {
+        gradientMatrices.push_back(make_shared<Matrix<float>>(dims.first, dims.second, c_deviceId));
+        accumulators.push_back(make_shared<Matrix<float>>(dims.first, dims.second, c_deviceId));
+        gradients.push_back(gradientMatrices.back().get());
+    }
+
+    auto header = DistGradHeader::Create(/*numEvalNode=*/0);
+    for (size_t minibatch = 0; minibatch < c_numMinibatches; minibatch++)
+    {
+        for (auto& accumulator : accumulators)
+            accumulator->SetValue(0);
+
+        for (size_t subminibatch = 0; subminibatch < numSubminibatches; subminibatch++)
+        {
+            // backprop completes the gradients in reverse order; the aggregator only learns about them after the first minibatch
+            for (size_t i = gradients.size(); i-- > 0;)
+            {
+                ComputeGradient(*gradients[i], i, minibatch, subminibatch);
+                if (minibatch > 0 && numSubminibatches == 1)
+                    aggregator.OnGradientReady(i);
+            }
+
+            if (numSubminibatches > 1)
+            {
+                for (size_t i = 0; i < gradients.size(); i++)
+                {
+                    *accumulators[i] += *gradients[i];
+                    gradients[i]->SetValue(0);
+                }
+            }
+        }
+        if (numSubminibatches > 1)
+        {
+            for (size_t i = 0; i < gradients.size(); i++)
+                gradients[i]->SetValue(*accumulators[i]);
+        }
+
+        header->numSamples = 8;
+        header->numSamplesWithLabel = 8;
+        header->criterion = 1;
+        aggregator.AggregateGradients(gradients, header, /*resetState=*/false);
+    }
+    DistGradHeader::Destroy(header);
+
+    vector<vector<float>> result;
+    for (auto gradient : gradients)
+        result.push_back(vector<float>(gradient->Data(), gradient->Data() + gradient->GetNumElements()));
+    return result;
+}
+
+// The result of the non-overlapped aggregation of the last minibatch on a single worker: the sum of the gradients of all sub-minibatches.
+static vector<vector<float>> GetExpectedGradients(size_t numSubminibatches)
+{
+    vector<vector<float>> result;
+    for (size_t i = 0; i < c_gradientDims.size(); i++)
+    {
+        Matrix<float> gradient(c_gradientDims[i].first, c_gradientDims[i].second, c_deviceId);
+        vector<float> sum(gradient.GetNumElements(), 0);
+        for (size_t subminibatch = 0; subminibatch < numSubminibatches; subminibatch++)
+        {
+            ComputeGradient(gradient, i, c_numMinibatches - 1, subminibatch);
+            for (size_t k = 0; k < sum.size(); k++)
+                sum[k] += gradient.Data()[k];
+        }
+        result.push_back(sum);
+    }
+    return result;
+}
+
+static void CheckEqual(const vector<vector<float>>& a, const vector<vector<float>>& b)
+{
+    BOOST_REQUIRE_EQUAL(a.size(), b.size());
+    for (size_t i = 0; i < a.size(); i++)
+        BOOST_CHECK_EQUAL_COLLECTIONS(a[i].begin(), a[i].end(), b[i].begin(), b[i].end());
+}
+
+BOOST_AUTO_TEST_SUITE(GradientAggregationTestSuite)
+
+BOOST_AUTO_TEST_CASE(OverlappedAggregationMatchesNonOverlapped)
+{
+    CheckEqual(AggregateMinibatches(/*numSubminibatches=*/1), GetExpectedGradients(/*numSubminibatches=*/1));
+}
+
+// The gradients of a minibatch split into sub-minibatches are only final after the last backprop, once those of all
+// sub-minibatches have been accumulated; the aggregator is then not told about them during the backprop.
+BOOST_AUTO_TEST_CASE(OverlappedAggregationMatchesNonOverlappedWithSubminibatches)
+{
+    CheckEqual(AggregateMinibatches(/*numSubminibatches=*/3), GetExpectedGradients(/*numSubminibatches=*/3));
+}
+
+// Trains a few minibatches of criterion = SquareError(labels, Sum_i W_i features) through SGD::ForwardBackward(), with the
+// gradient-ready callback of SGD. As in SGD, the gradients of the sub-minibatches are accumulated after each backprop.
+// Returns the aggregated gradients of the last minibatch; 'numGradientsReady' counts the calls of the callback.
+static vector<vector<float>> TrainMinibatches(size_t numSubminibatches, bool overlapAggregation, size_t& numGradientsReady)
+{
+    const size_t dim = 4;
+    const size_t numParameters = 3;
+    const size_t numSamples = 2;
+
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto features = builder.CreateInputNode(L"features", TensorShape(dim));
+    auto labels = builder.CreateInputNode(L"labels", TensorShape(dim));
+    vector<shared_ptr<ComputationNode<float>>> parameters;
+    shared_ptr<ComputationNode<float>> output;
+    for (size_t i = 0; i < numParameters; i++)
+    {
+        parameters.push_back(builder.CreateLearnableParameter(L"W" + to_wstring(i), dim, dim));
+        auto times = builder.Times(parameters.back(), features, 1, L"times" + to_wstring(i));
+        output = output ? builder.Plus(output, times, L"plus" + to_wstring(i)) : times;
+    }
+    ComputationNodeBasePtr criterion = builder.SquareError(labels, output, L"criterion");
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {}, criterion);
+    for (size_t i = 0; i < numParameters; i++)
+        ComputeGradient(parameters[i]->Value(), i, /*minibatch=*/0, /*subminibatch=*/0);
+    net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(numSamples);
+
+    // run a first pass to size the gradients
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    net->StartEvaluateMinibatchLoop(criterion);
+    vector<Matrix<float>*> gradients;
+    vector<shared_ptr<Matrix<float>>> accumulators;
+    unordered_map<ComputationNodeBase*, size_t> gradientIndex;
+    for (const auto& input : { features, labels })
+    {
+        input->Value().Resize(dim, numSamples);
+        input->Value().SetValue(0.1f);
+    }
+    net->ForwardProp(criterion);
+    net->Backprop(criterion);
+    for (size_t i = 0; i < numParameters; i++)
+    {
+        gradientIndex[parameters[i].get()] = i;
+        gradients.push_back(&parameters[i]->Gradient());
+        accumulators.push_back(make_shared<Matrix<float>>(dim, dim, c_deviceId));
+    }
+
+    SimpleDistGradAggregator<float> aggregator(GetMPIWrapper(), /*useAsyncAggregation=*/false, c_deviceId, /*syncStatsTrace=*/0,
+                                               DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES, c_bucketSizeInBytes);
+    numGradientsReady = 0;
+    function<void(const ComputationNodeBasePtr&)> gradientReadyCallback = [&](const ComputationNodeBasePtr& node)
+    {
+        auto iter = gradientIndex.find(node.get());
+        if (iter != gradientIndex.end())
+        {
+            numGradientsReady++;
+            aggregator.OnGradientReady(iter->second);
+        }
+    };
+
+    auto header = DistGradHeader::Create(/*numEvalNode=*/0);
+    for (size_t minibatch = 0; minibatch < c_numMinibatches; minibatch++)
+    {
+        for (auto& accumulator : accumulators)
+            accumulator->SetValue(0);
+
+        for (size_t subminibatch = 0; subminibatch < numSubminibatches; subminibatch++)
+        {
+            ComputeGradient(features->Value(), 0, minibatch, subminibatch);
+            ComputeGradient(labels->Value(), 1, minibatch, subminibatch);
+            ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ features, labels });
+
+            // the aggregator is only told about gradients after the first AggregateGradients() call
+            bool overlap = overlapAggregation && minibatch > 0;
+            SGD<float>::ForwardBackward(*net, { criterion }, criterion, /*computeGradient=*/true, numSubminibatches, overlap ? gradientReadyCallback : nullptr);
+
+            if (numSubminibatches > 1)
+            {
+                for (size_t i = 0; i < gradients.size(); i++)
+                {
+                    *accumulators[i] += *gradients[i];
+                    gradients[i]->SetValue(0);
+                }
+            }
+        }
+        if (numSubminibatches > 1)
+        {
+            for (size_t i = 0; i < gradients.size(); i++)
+                gradients[i]->SetValue(*accumulators[i]);
+        }
+
+        header->numSamples = numSamples * numSubminibatches;
+        header->numSamplesWithLabel = numSamples * numSubminibatches;
+        header->criterion = 1;
+        aggregator.AggregateGradients(gradients, header, /*resetState=*/false);
+    }
+    DistGradHeader::Destroy(header);
+    net->SetGradientReadyCallback(nullptr);
+
+    vector<vector<float>> result;
+    for (auto gradient : gradients)
+        result.push_back(vector<float>(gradient->Data(), gradient->Data() + gradient->GetNumElements()));
+    return result;
+}
+
+// SGD overlaps the aggregation with the backprop of whole minibatches, but not with that of sub-minibatches.
+BOOST_AUTO_TEST_CASE(SGDOverlapsAggregationOnlyWithoutSubminibatches)
+{
+    for (size_t numSubminibatches : { 1, 3 })
+    {
+        size_t numGradientsReady;
+        auto nonOverlapped = TrainMinibatches(numSubminibatches, /*overlapAggregation=*/false, numGradientsReady);
+        BOOST_CHECK_EQUAL(numGradientsReady, 0);
+
+        auto overlapped = TrainMinibatches(numSubminibatches, /*overlapAggregation=*/true, numGradientsReady);
+        if (numSubminibatches == 1)
+            BOOST_CHECK_GT(numGradientsReady, 0);
+        else
+            BOOST_CHECK_EQUAL(numGradientsReady, 0);
+        CheckEqual(overlapped, nonOverlapped);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
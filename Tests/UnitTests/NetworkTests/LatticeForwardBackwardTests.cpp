@@ -0,0 +1,138 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "latticearchive.h"
+#include <omp.h>
+#include <random>
+
+using namespace msra::lattices;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const size_t c_numNodes = 60;
+static const size_t c_numSenones = 5;
+
+// results of the lattice-level forward/backward
+struct LatticeForwardBackwardResult
+{
+    double logLikelihood;
+    vector<double> logAlphas;
+    vector<double> logBetas;
+    vector<double> logPosteriors;
+    vector<double> logFramesCorrect; // sMBR only
+    double logFramesCorrectTotal;    // sMBR only
+};
+
+// Builds lattices and runs the (private) lattice-level forward/backward on them.
+struct LatticeTestRunner
+{
+    // A small random lattice with one node per frame, in which every node has a few incoming edges from the nodes
+    // just before it. The edges are sorted by end node, as in lattices read from disk, and come with random alignments.
+    lattice L;
+    vector<float> edgeAcScores;
+    vector<size_t> uids; // reference senone of each frame (sMBR)
+    unique_ptr<lattice::edgealignments> alignments;
+
+    LatticeTestRunner()
+    {
+        mt19937 rng(1);
+        uniform_real_distribution<float> scoreDistribution(-20, -1);
+        uniform_int_distribution<size_t> senoneDistribution(0, c_numSenones - 1);
+
+        for (size_t i = 0; i < c_numNodes; i++)
+            L.nodes.push_back(nodeinfo(i));
+        for (size_t i = 1; i < c_numNodes; i++)
+        {
+            for (size_t s = (i > 4 ? i - 4 : 0); s < i; s++)
+            {
+                if (s + 1 != i && rng() % 2 == 0) // keep the edge from the previous node, so that every node is reachable
+                    continue;
+                L.edges.push_back(edgeinfowithscores(s, i, /*a=*/0, /*l=*/scoreDistribution(rng), /*firstalign=*/0));
+                edgeAcScores.push_back(scoreDistribution(rng));
+            }
+        }
+        L.info.numnodes = L.nodes.size();
+        L.info.numedges = L.edges.size();
+        L.info.numframes = c_numNodes - 1;
+
+        alignments.reset(new lattice::edgealignments(L));
+        for (size_t j = 0; j < L.edges.size(); j++)
+        {
+            auto edgeAlignment = (*alignments)[j];
+            for (size_t t = 0; t < edgeAlignment.size(); t++)
+                edgeAlignment[t] = (unsigned short) senoneDistribution(rng);
+        }
+        for (size_t t = 0; t < L.info.numframes; t++)
+            uids.push_back(senoneDistribution(rng));
+    }
+
+    // runs the forward/backward on the CPU, with the recursions levelized and parallelized if 'parallel' is set
+    LatticeForwardBackwardResult ForwardBackward(bool sMBRmode, bool parallel)
+    {
+        size_t parallelMinEdges = lattice::parallelminedges;
+        int maxNumThreads = omp_get_max_threads();
+        if (parallel)
+        {
+            lattice::parallelminedges = 0;
+            omp_set_num_threads(4);
+        }
+        else
+            lattice::parallelminedges = SIZE_MAX;
+
+        LatticeForwardBackwardResult result;
+        lattice::parallelstate parallelState; // not enabled, as there is no GPU
+        const_array_ref<size_t> uidsRef(uids.data(), uids.size());
+        vector<double> framesCorrectBuffer;
+        result.logLikelihood = L.forwardbackwardlattice(edgeAcScores, parallelState, result.logPosteriors, result.logAlphas, result.logBetas,
+                                                        /*lmf=*/14.0f, /*wp=*/0.5f, /*amf=*/14.0f, /*boostingfactor=*/0.0f, sMBRmode,
+                                                        uidsRef, *alignments, result.logFramesCorrect, framesCorrectBuffer, result.logFramesCorrectTotal);
+
+        lattice::parallelminedges = parallelMinEdges;
+        omp_set_num_threads(maxNumThreads);
+        return result;
+    }
+};
+
+static void CheckEqual(const LatticeForwardBackwardResult& serial, const LatticeForwardBackwardResult& parallel)
+{
+    // each node accumulates its edges in the same order in either case, so the results are identical
+    BOOST_CHECK_EQUAL(serial.logLikelihood, parallel.logLikelihood);
+    BOOST_CHECK_EQUAL_COLLECTIONS(serial.logAlphas.begin(), serial.logAlphas.end(), parallel.logAlphas.begin(), parallel.logAlphas.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(serial.logBetas.begin(), serial.logBetas.end(), parallel.logBetas.begin(), parallel.logBetas.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(serial.logPosteriors.begin(), serial.logPosteriors.end(), parallel.logPosteriors.begin(), parallel.logPosteriors.end());
+}
+
+BOOST_AUTO_TEST_SUITE(LatticeForwardBackwardTestSuite)
+
+BOOST_AUTO_TEST_CASE(ParallelLatticeForwardBackwardMatchesSerialMMI)
+{
+    LatticeTestRunner runner;
+    auto serial = runner.ForwardBackward(/*sMBRmode=*/false, /*parallel=*/false);
+    auto parallel = runner.ForwardBackward(/*sMBRmode=*/false, /*parallel=*/true);
+
+    BOOST_REQUIRE(serial.logLikelihood > LOGZERO);
+    BOOST_CHECK_EQUAL(serial.logAlphas.size(), c_numNodes);
+    BOOST_CHECK_CLOSE(serial.logAlphas.back(), serial.logBetas.front(), 1e-8);
+    CheckEqual(serial, parallel);
+}
+
+BOOST_AUTO_TEST_CASE(ParallelLatticeForwardBackwardMatchesSerialSMBR)
+{
+    LatticeTestRunner runner;
+    auto serial = runner.ForwardBackward(/*sMBRmode=*/true, /*parallel=*/false);
+    auto parallel = runner.ForwardBackward(/*sMBRmode=*/true, /*parallel=*/true);
+
+    BOOST_REQUIRE(serial.logLikelihood > LOGZERO);
+    CheckEqual(serial, parallel);
+    BOOST_CHECK_EQUAL(serial.logFramesCorrectTotal, parallel.logFramesCorrectTotal);
+    BOOST_CHECK_EQUAL_COLLECTIONS(serial.logFramesCorrect.begin(), serial.logFramesCorrect.end(), parallel.logFramesCorrect.begin(), parallel.logFramesCorrect.end());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
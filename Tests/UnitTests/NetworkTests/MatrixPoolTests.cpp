@@ -0,0 +1,150 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+// per-sample size of the buffer that scales with the minibatch size, and size of the one that does not
+static const size_t c_sampleSize = 10;
+static const size_t c_fixedSize = 50;
+
+static size_t GetReservedNumSamples(size_t numSamples)
+{
+    MatrixPool pool;
+    BOOST_REQUIRE(pool.ReserveForMinibatch(numSamples));
+    return pool.GetStatistics().reservedNumSamples;
+}
+
+// Two matrices in use at the same time, so that each gets a buffer of its own: one that scales with the minibatch
+// size, and one of fixed size. Sharing a buffer with a smaller request does not change the reservation.
+struct MatrixPoolTestRunner
+{
+    MatrixPool pool;
+    shared_ptr<Matrix<float>> scaled;
+    shared_ptr<Matrix<float>> fixed;
+    shared_ptr<Matrix<float>> smaller;
+
+    MatrixPoolTestRunner()
+    {
+        pool.RequestAllocate(c_deviceId, &scaled, c_sampleSize, /*mbScale=*/true, /*isWorkSpace=*/false);
+        pool.RequestAllocate(c_deviceId, &fixed, c_fixedSize, /*mbScale=*/false, /*isWorkSpace=*/false);
+        pool.RequestRelease(&scaled);
+        pool.RequestAllocate(c_deviceId, &smaller, c_sampleSize / 2, /*mbScale=*/true, /*isWorkSpace=*/false);
+        pool.RequestRelease(&smaller);
+        pool.RequestRelease(&fixed);
+        pool.OptimizedMemoryAllocation();
+        BOOST_REQUIRE(scaled == smaller);
+        BOOST_REQUIRE(scaled != fixed);
+    }
+
+    // prepares the pool for a minibatch and resizes the matrices as the nodes would; returns whether the buffers were grown
+    bool RunMinibatch(size_t numSamples)
+    {
+        bool grown = pool.ReserveForMinibatch(numSamples);
+        smaller->Resize(c_sampleSize / 2, numSamples);
+        scaled->Resize(c_sampleSize, numSamples);
+        fixed->Resize(c_fixedSize, 1);
+        return grown;
+    }
+};
+
+BOOST_AUTO_TEST_SUITE(MatrixPoolTestSuite)
+
+// Four size classes per power of two, and sizes up to 8 are exact.
+BOOST_AUTO_TEST_CASE(MatrixPoolRoundsUpToSizeClasses)
+{
+    const vector<pair<size_t, size_t>> expected = {
+        { 1, 1 }, { 2, 2 }, { 3, 3 }, { 7, 7 }, { 8, 8 }, { 9, 10 }, { 15, 16 }, { 16, 16 }, { 17, 20 },
+        { 31, 32 }, { 32, 32 }, { 33, 40 }, { 100, 112 }, { 1024, 1024 }, { 1025, 1280 }, { 1280, 1280 }, { 1281, 1536 },
+    };
+    for (const auto& numSamplesAndReserved : expected)
+        BOOST_CHECK_EQUAL(GetReservedNumSamples(numSamplesAndReserved.first), numSamplesAndReserved.second);
+
+    // never less than requested, and at most 25% more
+    for (size_t numSamples = 1; numSamples < 5000; numSamples += 7)
+    {
+        size_t reserved = GetReservedNumSamples(numSamples);
+        BOOST_CHECK_GE(reserved, numSamples);
+        BOOST_CHECK_LE((reserved - numSamples) * 4, numSamples);
+    }
+
+    MatrixPool pool;
+    BOOST_CHECK(!pool.ReserveForMinibatch(0));
+    BOOST_CHECK_EQUAL(pool.GetStatistics().reservedNumSamples, 0);
+}
+
+// Minibatches of varying size up to the reserved one are processed in the same buffers.
+BOOST_AUTO_TEST_CASE(MatrixPoolReservationAvoidsReallocation)
+{
+    MatrixPoolTestRunner runner;
+    BOOST_CHECK(runner.RunMinibatch(20));
+    const float* scaledData = runner.scaled->Data();
+    const float* fixedData = runner.fixed->Data();
+
+    for (size_t numSamples : { 7, 18, 20, 1, 19, 13 })
+    {
+        BOOST_CHECK(!runner.RunMinibatch(numSamples));
+        BOOST_CHECK(runner.scaled->Data() == scaledData);
+        BOOST_CHECK(runner.fixed->Data() == fixedData);
+    }
+
+    // a larger minibatch grows the buffer once for its size class, up to 24 samples
+    BOOST_CHECK(runner.RunMinibatch(21));
+    scaledData = runner.scaled->Data();
+    BOOST_CHECK(runner.fixed->Data() == fixedData);
+    for (size_t numSamples : { 24, 22, 5 })
+    {
+        BOOST_CHECK(!runner.RunMinibatch(numSamples));
+        BOOST_CHECK(runner.scaled->Data() == scaledData);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(MatrixPoolReportsStatistics)
+{
+    MatrixPoolTestRunner runner;
+    const auto& statistics = runner.pool.GetStatistics();
+    BOOST_CHECK_EQUAL(statistics.numReservations, 0);
+    BOOST_CHECK_EQUAL(statistics.reservedBytes, 0);
+    BOOST_CHECK_EQUAL(statistics.GetFragmentation(), 0.0);
+
+    runner.RunMinibatch(20);
+    BOOST_CHECK_EQUAL(statistics.numBuffers, 2);
+    BOOST_CHECK_EQUAL(statistics.numReservations, 1);
+    BOOST_CHECK_EQUAL(statistics.largestNumSamples, 20);
+    BOOST_CHECK_EQUAL(statistics.reservedNumSamples, 20);
+    BOOST_CHECK_EQUAL(statistics.reservedBytes, (c_sampleSize * 20 + c_fixedSize) * sizeof(float));
+    BOOST_CHECK_EQUAL(statistics.usedBytes, statistics.reservedBytes);
+    BOOST_CHECK_EQUAL(statistics.GetFragmentation(), 0.0);
+
+    runner.RunMinibatch(21);
+    BOOST_CHECK_EQUAL(statistics.numReservations, 2);
+    BOOST_CHECK_EQUAL(statistics.largestNumSamples, 21);
+    BOOST_CHECK_EQUAL(statistics.reservedNumSamples, 24);
+    const size_t peakReservedBytes = (c_sampleSize * 24 + c_fixedSize) * sizeof(float);
+    BOOST_CHECK_EQUAL(statistics.reservedBytes, peakReservedBytes);
+    BOOST_CHECK_EQUAL(statistics.peakReservedBytes, peakReservedBytes);
+
+    // a smaller minibatch uses only part of the reservation
+    runner.RunMinibatch(5);
+    BOOST_CHECK_EQUAL(statistics.numReservations, 2);
+    BOOST_CHECK_EQUAL(statistics.largestNumSamples, 21);
+    BOOST_CHECK_EQUAL(statistics.reservedBytes, peakReservedBytes);
+    BOOST_CHECK_EQUAL(statistics.peakReservedBytes, peakReservedBytes);
+    const size_t usedBytes = (c_sampleSize * 5 + c_fixedSize) * sizeof(float);
+    BOOST_CHECK_EQUAL(statistics.usedBytes, usedBytes);
+    BOOST_CHECK_CLOSE(statistics.GetFragmentation(), 1.0 - (double)usedBytes / peakReservedBytes, 1e-10);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,120 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/PerformanceProfilerDll/PerformanceProfiler.h"
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <sstream>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+static const size_t c_dim = 4;
+static const size_t c_numSamples = 3;
+static const size_t c_numPasses = 3;
+
+// criterion = SquareError(labels, Sigmoid(W features)), trained for a few minibatches with per-node profiling
+static void RunProfiledTraining()
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto features = builder.CreateInputNode(L"features", TensorShape(c_dim));
+    auto labels = builder.CreateInputNode(L"labels", TensorShape(c_dim));
+    auto weights = builder.CreateLearnableParameter(L"W", c_dim, c_dim);
+    auto output = builder.Sigmoid(builder.Times(weights, features, 1, L"times"), L"sigmoid");
+    ComputationNodeBasePtr criterion = builder.SquareError(labels, output, L"criterion");
+    net->AddToNodeGroup(L"criterion", criterion);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {}, criterion);
+    net->SetNodeProfiling(true);
+
+    weights->Value().SetValue(0.1f);
+    net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(c_numSamples);
+    for (const auto& input : { features, labels })
+    {
+        input->Value().Resize(c_dim, c_numSamples);
+        input->Value().SetValue(0.5f);
+    }
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    net->StartEvaluateMinibatchLoop(criterion);
+    for (size_t pass = 0; pass < c_numPasses; pass++)
+    {
+        ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ features, labels });
+        net->ForwardProp(criterion);
+        net->Backprop(criterion);
+    }
+}
+
+// returns the contents of the only file in the directory whose name contains the given part
+static string ReadProfilerFile(const boost::filesystem::path& directory, const string& namePart)
+{
+    vector<boost::filesystem::path> files;
+    for (boost::filesystem::directory_iterator iter(directory); iter != boost::filesystem::directory_iterator(); ++iter)
+    {
+        if (iter->path().filename().string().find(namePart) != string::npos)
+            files.push_back(iter->path());
+    }
+    BOOST_REQUIRE_EQUAL(files.size(), 1);
+
+    ifstream stream(files.front().string());
+    stringstream contents;
+    contents << stream.rdbuf();
+    return contents.str();
+}
+
+static size_t CountLines(const string& text, const string& part)
+{
+    size_t count = 0;
+    string line;
+    istringstream stream(text);
+    while (getline(stream, line))
+    {
+        if (line.find(part) != string::npos)
+            count++;
+    }
+    return count;
+}
+
+BOOST_AUTO_TEST_SUITE(NodeProfilingTestSuite)
+
+BOOST_AUTO_TEST_CASE(NodeProfilingRecordsAndReportsNodes)
+{
+    auto profilerDir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("NodeProfilingTests-%%%%-%%%%");
+    ProfilerInit(profilerDir.wstring(), /*customEventBufferBytes=*/1024 * 1024, L"nodes", /*syncGpu=*/false);
+    ProfilerEnable(true);
+    RunProfiledTraining();
+    ProfilerClose();
+
+    // every forward and backward computation of a node is an event of the detail log
+    auto detail = ReadProfilerFile(profilerDir, "_detail_");
+    for (auto name : { "times", "sigmoid", "criterion" })
+    {
+        BOOST_CHECK_EQUAL(CountLines(detail, string("\"") + name + " [forward]\""), c_numPasses);
+        BOOST_CHECK_EQUAL(CountLines(detail, string("\"") + name + " [backward]\""), c_numPasses);
+    }
+
+    // and the per-node report lists every operation, and every node with its operation
+    auto report = ReadProfilerFile(profilerDir, "_nodes_");
+    for (auto operation : { "Times", "Sigmoid", "SquareError" })
+        BOOST_CHECK_EQUAL(CountLines(report, string("  ") + operation), 1);
+    BOOST_CHECK_EQUAL(CountLines(report, "  times (Times)"), 1);
+    BOOST_CHECK_EQUAL(CountLines(report, "  sigmoid (Sigmoid)"), 1);
+    BOOST_CHECK_EQUAL(CountLines(report, "  criterion (SquareError)"), 1);
+
+    boost::filesystem::remove_all(profilerDir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,291 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "WorkStealingThreadPool.h"
+#include "Globals.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <set>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// Nodes are only executed in parallel on the CPU.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+static const size_t c_numBranches = 6;
+static const size_t c_dim = 16;
+static const size_t c_numSamples = 5;
+static const size_t c_numOutputs = 2;
+
+// Sets the number of node execution threads for the scope of a test, with value sharing enabled and without fusing the elementwise nodes.
+class ParallelExecutionScope
+{
+public:
+    ParallelExecutionScope(size_t numThreads)
+        : m_numThreads(Globals::GetNumNodeExecutionThreads()),
+          m_shareNodeValueMatrices(Globals::ShouldEnableShareNodeValueMatrices()),
+          m_fuseElementwiseOperations(Globals::ShouldFuseElementwiseOperations())
+    {
+        Globals::SetNumNodeExecutionThreads(numThreads);
+        Globals::SetShareNodeValueMatrices(true);
+        Globals::SetElementwiseFusion(false);
+    }
+
+    ~ParallelExecutionScope()
+    {
+        Globals::SetNumNodeExecutionThreads(m_numThreads);
+        Globals::SetShareNodeValueMatrices(m_shareNodeValueMatrices);
+        Globals::SetElementwiseFusion(m_fuseElementwiseOperations);
+    }
+
+private:
+    size_t m_numThreads;
+    bool m_shareNodeValueMatrices;
+    bool m_fuseElementwiseOperations;
+};
+
+// Independent branches, each Tanh(Sigmoid(W_i x)) with an own parameter, summed up into the output.
+// The branches can run concurrently, while in the sequential evaluation order each branch can reuse the matrices of the previous one.
+// With several outputs, each sums up a consecutive range of the branches, and there is no criterion.
+static ComputationNetworkPtr CreateBranchingNetwork(size_t numOutputs = 1)
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto features = builder.CreateInputNode(L"features", TensorShape(c_dim));
+    auto labels = builder.CreateInputNode(L"labels", TensorShape(c_dim));
+    vector<shared_ptr<ComputationNode<float>>> outputs(numOutputs);
+    for (size_t i = 0; i < c_numBranches; i++)
+    {
+        auto suffix = to_wstring(i);
+        auto weights = builder.CreateLearnableParameter(L"W" + suffix, c_dim, c_dim);
+        auto branch = builder.Tanh(builder.Sigmoid(builder.Times(weights, features, 1, L"times" + suffix), L"sigmoid" + suffix), L"tanh" + suffix);
+        auto& output = outputs[i * numOutputs / c_numBranches];
+        output = output ? builder.Plus(output, branch, L"plus" + suffix) : branch;
+    }
+    for (const auto& output : outputs)
+        net->AddToNodeGroup(L"output", output);
+    if (numOutputs == 1)
+        net->AddToNodeGroup(L"criterion", builder.SquareError(labels, outputs.front(), L"criterion"));
+    net->CompileNetwork();
+
+    mt19937 rng(1);
+    uniform_real_distribution<float> distribution(-1, 1);
+    for (size_t i = 0; i < c_numBranches; i++)
+    {
+        auto& weights = dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(L"W" + to_wstring(i)))->Value();
+        for (size_t k = 0; k < weights.GetNumElements(); k++)
+            weights.Data()[k] = distribution(rng);
+    }
+
+    auto mbLayout = net->GetMBLayoutPtrOfNetwork();
+    mbLayout->InitAsFrameMode(c_numSamples);
+    for (auto name : { L"features", L"labels" })
+    {
+        auto& value = dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(name))->Value();
+        value.Resize(c_dim, c_numSamples);
+        for (size_t k = 0; k < value.GetNumElements(); k++)
+            value.Data()[k] = distribution(rng);
+    }
+    return net;
+}
+
+static vector<float> ToVector(const Matrix<float>& matrix)
+{
+    return vector<float>(matrix.Data(), matrix.Data() + matrix.GetNumElements());
+}
+
+// Runs one forward and backward pass, returns the criterion and the gradients of all parameters.
+static vector<vector<float>> RunTrainingStep(size_t numThreads)
+{
+    ParallelExecutionScope scope(numThreads);
+    auto net = CreateBranchingNetwork();
+    auto criterion = net->GetNodeFromName(L"criterion");
+    net->AllocateAllMatrices({}, {}, criterion);
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    net->StartEvaluateMinibatchLoop(criterion);
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ net->GetNodeFromName(L"features"), net->GetNodeFromName(L"labels") });
+    net->ForwardProp(criterion);
+    net->Backprop(criterion);
+
+    vector<vector<float>> results{ ToVector(dynamic_pointer_cast<ComputationNode<float>>(criterion)->Value()) };
+    for (size_t i = 0; i < c_numBranches; i++)
+        results.push_back(ToVector(dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(L"W" + to_wstring(i)))->Gradient()));
+    return results;
+}
+
+// Allocates the matrices for evaluating the output only, returns the value matrices of the nodes of each branch.
+static vector<vector<const MatrixBase*>> GetBranchValueMatrices(size_t numThreads)
+{
+    ParallelExecutionScope scope(numThreads);
+    auto net = CreateBranchingNetwork();
+    net->AllocateAllMatrices(net->OutputNodes(), {}, nullptr);
+
+    vector<vector<const MatrixBase*>> matrices(c_numBranches);
+    for (size_t i = 0; i < c_numBranches; i++)
+    {
+        for (auto name : { L"times", L"sigmoid", L"tanh" })
+            matrices[i].push_back(net->GetNodeFromName(name + to_wstring(i))->ValuePtr().get());
+    }
+    return matrices;
+}
+
+// Computes all outputs with one ForwardProp() of several nodes, returns their values and the value matrices of the nodes of each branch.
+static vector<vector<float>> EvaluateOutputs(size_t numThreads, vector<vector<const MatrixBase*>>& branchMatrices)
+{
+    ParallelExecutionScope scope(numThreads);
+    auto net = CreateBranchingNetwork(c_numOutputs);
+    const auto& outputs = net->OutputNodes();
+    BOOST_REQUIRE_EQUAL(outputs.size(), c_numOutputs);
+    net->AllocateAllMatrices(outputs, {}, nullptr);
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::inferring);
+    net->StartEvaluateMinibatchLoop(outputs);
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ net->GetNodeFromName(L"features") });
+    net->ForwardProp(outputs);
+
+    vector<vector<float>> results;
+    for (const auto& output : outputs)
+        results.push_back(ToVector(dynamic_pointer_cast<ComputationNode<float>>(output)->Value()));
+
+    branchMatrices.assign(c_numBranches, vector<const MatrixBase*>());
+    for (size_t i = 0; i < c_numBranches; i++)
+    {
+        for (auto name : { L"times", L"sigmoid", L"tanh" })
+            branchMatrices[i].push_back(net->GetNodeFromName(name + to_wstring(i))->ValuePtr().get());
+    }
+    return results;
+}
+
+static size_t CountDistinctMatrices(const vector<vector<const MatrixBase*>>& matrices)
+{
+    set<const MatrixBase*> distinct;
+    for (const auto& branchMatrices : matrices)
+        distinct.insert(branchMatrices.begin(), branchMatrices.end());
+    return distinct.size();
+}
+
+BOOST_AUTO_TEST_SUITE(ParallelExecutionTestSuite)
+
+BOOST_AUTO_TEST_CASE(WorkStealingThreadPoolRunsAllTasks)
+{
+    const size_t numThreads = 4;
+    const size_t numRootTasks = 64;
+    const size_t numChildTasks = 16;
+
+    WorkStealingThreadPool threadPool(numThreads);
+    BOOST_REQUIRE_EQUAL(threadPool.GetNumThreads(), numThreads);
+    BOOST_CHECK_EQUAL(WorkStealingThreadPool::GetCurrentWorkerIndex(), -1);
+
+    atomic<size_t> numExecuted(0);
+    atomic<size_t> numPending(numRootTasks * (1 + numChildTasks));
+    atomic<bool> invalidWorkerIndex(false);
+    mutex doneMutex;
+    condition_variable allDone;
+
+    auto finishTask = [&]()
+    {
+        int worker = WorkStealingThreadPool::GetCurrentWorkerIndex();
+        if (worker < 0 || worker >= (int)numThreads)
+            invalidWorkerIndex = true;
+        numExecuted++;
+        if (--numPending == 0)
+        {
+            lock_guard<mutex> lock(doneMutex);
+            allDone.notify_all();
+        }
+    };
+
+    // tasks submitted from within the pool go to the queue of the submitting worker, from where the others steal them
+    for (size_t i = 0; i < numRootTasks; i++)
+    {
+        threadPool.Submit([&]()
+        {
+            for (size_t k = 0; k < numChildTasks; k++)
+                threadPool.Submit([&]() { finishTask(); });
+            finishTask();
+        });
+    }
+
+    unique_lock<mutex> lock(doneMutex);
+    BOOST_REQUIRE(allDone.wait_for(lock, chrono::seconds(60), [&]() { return numPending == 0; }));
+    BOOST_CHECK_EQUAL(numExecuted.load(), numRootTasks * (1 + numChildTasks));
+    BOOST_CHECK(!invalidWorkerIndex);
+}
+
+BOOST_AUTO_TEST_CASE(ParallelExecutionMatchesSequentialExecution)
+{
+    auto sequential = RunTrainingStep(/*numThreads=*/0);
+    auto parallel = RunTrainingStep(/*numThreads=*/4);
+
+    // every node computes the same values in either case, and the gradient contributions are accumulated in the same order
+    BOOST_REQUIRE_EQUAL(sequential.size(), parallel.size());
+    for (size_t i = 0; i < sequential.size(); i++)
+    {
+        BOOST_REQUIRE_EQUAL(sequential[i].size(), parallel[i].size());
+        BOOST_CHECK_EQUAL_COLLECTIONS(sequential[i].begin(), sequential[i].end(), parallel[i].begin(), parallel[i].end());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentNodesDoNotShareMatrices)
+{
+    // executed sequentially, the branches reuse the matrices of each other
+    auto sequential = GetBranchValueMatrices(/*numThreads=*/0);
+    BOOST_CHECK_LT(CountDistinctMatrices(sequential), c_numBranches);
+
+    // executed in parallel, the branches may run concurrently and must not share a matrix
+    auto parallel = GetBranchValueMatrices(/*numThreads=*/4);
+    for (size_t i = 0; i < c_numBranches; i++)
+    {
+        for (size_t j = i + 1; j < c_numBranches; j++)
+        {
+            for (auto matrix : parallel[i])
+                BOOST_CHECK(find(parallel[j].begin(), parallel[j].end(), matrix) == parallel[j].end());
+        }
+    }
+
+    // but the nodes within a branch are still executed in order, and share matrices
+    BOOST_CHECK_LT(CountDistinctMatrices(parallel), 3 * c_numBranches);
+}
+
+// ForwardProp() of several nodes computes them in one traversal, in which the nodes of different outputs may run concurrently.
+BOOST_AUTO_TEST_CASE(ParallelExecutionOfSeveralOutputs)
+{
+    vector<vector<const MatrixBase*>> sequentialMatrices;
+    auto sequential = EvaluateOutputs(/*numThreads=*/0, sequentialMatrices);
+
+    // the thread pool follows the configured number of threads from one pass to the next
+    for (size_t numThreads : { 4, 2 })
+    {
+        vector<vector<const MatrixBase*>> parallelMatrices;
+        auto parallel = EvaluateOutputs(numThreads, parallelMatrices);
+        BOOST_REQUIRE_EQUAL(sequential.size(), parallel.size());
+        for (size_t i = 0; i < sequential.size(); i++)
+            BOOST_CHECK_EQUAL_COLLECTIONS(sequential[i].begin(), sequential[i].end(), parallel[i].begin(), parallel[i].end());
+
+        // branches of different outputs are independent as well, and must not share a matrix
+        for (size_t i = 0; i < c_numBranches; i++)
+        {
+            for (size_t j = i + 1; j < c_numBranches; j++)
+            {
+                for (auto matrix : parallelMatrices[i])
+                    BOOST_CHECK(find(parallelMatrices[j].begin(), parallelMatrices[j].end(), matrix) == parallelMatrices[j].end());
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,162 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ComputationNetwork.h"
+#include "../../../Source/ComputationNetworkLib/ComputationNetworkBuilder.h"
+#include "../../../Source/ComputationNetworkLib/LinearAlgebraNodes.h"
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// Quantized products are only computed on the CPU.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+static const size_t c_inputDim = 64;
+static const size_t c_hiddenDim = 48;
+static const size_t c_outputDim = 16;
+static const size_t c_numSamples = 5;
+
+static void SetRandomValues(Matrix<float>& matrix, unsigned int seed)
+{
+    mt19937 rng(seed);
+    uniform_real_distribution<float> distribution(-1, 1);
+    for (size_t k = 0; k < matrix.GetNumElements(); k++)
+        matrix.Data()[k] = distribution(rng);
+}
+
+static Matrix<float>& GetValue(const ComputationNetworkPtr& net, const wstring& nodeName)
+{
+    return dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(nodeName))->Value();
+}
+
+// output = Times(W2, Tanh(Times(W1, features))), and the product of the parameters W1 * V, which is not quantized.
+static ComputationNetworkPtr CreateNetwork(bool quantize)
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto features = builder.CreateInputNode(L"features", TensorShape(c_inputDim));
+    auto w1 = builder.CreateLearnableParameter(L"W1", c_hiddenDim, c_inputDim);
+    auto w2 = builder.CreateLearnableParameter(L"W2", c_outputDim, c_hiddenDim);
+    auto v = builder.CreateLearnableParameter(L"V", c_inputDim, 1);
+    auto hidden = builder.Times(w1, features, 1, L"hidden");
+    auto output = builder.Times(w2, builder.Tanh(hidden, L"tanh"), 1, L"output");
+    auto parameterProduct = builder.Times(w1, v, 1, L"parameterProduct");
+    net->AddToNodeGroup(L"output", output);
+    net->AddToNodeGroup(L"output", parameterProduct);
+    net->CompileNetwork();
+
+    SetRandomValues(w1->Value(), 1);
+    SetRandomValues(w2->Value(), 2);
+    SetRandomValues(v->Value(), 3);
+
+    if (quantize)
+        BOOST_REQUIRE_EQUAL(net->QuantizeTimesNodes<float>(/*bitShiftA=*/2, /*bitShiftB=*/2), 2);
+
+    net->AllocateAllMatrices(net->OutputNodes(), {}, nullptr);
+    net->GetMBLayoutPtrOfNetwork()->InitAsFrameMode(c_numSamples);
+    auto& featureValues = GetValue(net, L"features");
+    featureValues.Resize(c_inputDim, c_numSamples);
+    SetRandomValues(featureValues, 4);
+    return net;
+}
+
+static vector<float> Evaluate(const ComputationNetworkPtr& net)
+{
+    auto output = net->GetNodeFromName(L"output");
+    net->StartEvaluateMinibatchLoop(output);
+    ComputationNetwork::BumpEvalTimeStamp(vector<ComputationNodeBasePtr>{ net->GetNodeFromName(L"features") });
+    net->ForwardProp(output);
+    auto& value = GetValue(net, L"output");
+    return vector<float>(value.Data(), value.Data() + value.GetNumElements());
+}
+
+// Relative error of the quantized output, in the Frobenius norm.
+static double RelativeError(const vector<float>& expected, const vector<float>& actual)
+{
+    BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+    double error = 0, norm = 0;
+    for (size_t k = 0; k < expected.size(); k++)
+    {
+        error += (expected[k] - actual[k]) * (expected[k] - actual[k]);
+        norm += expected[k] * expected[k];
+    }
+    return sqrt(error / norm);
+}
+
+BOOST_AUTO_TEST_SUITE(QuantizedTimesNodeTestSuite)
+
+BOOST_AUTO_TEST_CASE(QuantizeTimesNodesReplacesProductsWithParameters)
+{
+    auto net = CreateNetwork(/*quantize=*/true);
+    BOOST_CHECK(ComputationNetwork::IsNodePtr<QuantizedTimesNode<float>>(net->GetNodeFromName(L"hidden")));
+    BOOST_CHECK(ComputationNetwork::IsNodePtr<QuantizedTimesNode<float>>(net->GetNodeFromName(L"output")));
+    BOOST_CHECK(ComputationNetwork::IsNodePtr<TimesNode<float>>(net->GetNodeFromName(L"parameterProduct")));
+
+    // the quantized nodes take the place of the Times nodes, also in the node groups
+    BOOST_CHECK(net->OutputNodes()[0] == net->GetNodeFromName(L"output"));
+    BOOST_CHECK(net->GetNodeFromName(L"tanh")->GetInputs()[0] == net->GetNodeFromName(L"hidden"));
+
+    auto expected = Evaluate(CreateNetwork(/*quantize=*/false));
+    BOOST_CHECK_LT(RelativeError(expected, Evaluate(net)), 0.02);
+}
+
+// The parameters are quantized once, but again after their values have changed (e.g. when they are shared with
+// a network that is trained); an update of the values bumps the eval time stamp of the parameter.
+BOOST_AUTO_TEST_CASE(QuantizedTimesNodeFollowsParameterUpdates)
+{
+    auto net = CreateNetwork(/*quantize=*/true);
+    auto reference = CreateNetwork(/*quantize=*/false);
+    BOOST_CHECK_LT(RelativeError(Evaluate(reference), Evaluate(net)), 0.02);
+
+    // the same output without an update
+    auto before = Evaluate(net);
+    auto again = Evaluate(net);
+    BOOST_CHECK_EQUAL_COLLECTIONS(before.begin(), before.end(), again.begin(), again.end());
+
+    for (const auto& network : { net, reference })
+    {
+        for (auto name : { L"W1", L"W2" })
+        {
+            SetRandomValues(GetValue(network, name), 5);
+            network->GetNodeFromName(name)->BumpEvalTimeStamp();
+        }
+    }
+
+    auto expected = Evaluate(reference);
+    BOOST_CHECK_GT(RelativeError(expected, before), 0.5);
+    BOOST_CHECK_LT(RelativeError(expected, Evaluate(net)), 0.02);
+}
+
+// A product with sparse data would fall back to the unquantized sparse product, so it is not replaced.
+BOOST_AUTO_TEST_CASE(QuantizeTimesNodesSkipsProductsWithSparseData)
+{
+    auto net = make_shared<ComputationNetwork>(c_deviceId);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto features = builder.CreateInputNode(L"features", TensorShape(c_inputDim));
+    auto sparseFeatures = builder.CreateSparseInputNode(L"sparseFeatures", TensorShape(c_inputDim));
+    auto w1 = builder.CreateLearnableParameter(L"W1", c_hiddenDim, c_inputDim);
+    auto w2 = builder.CreateLearnableParameter(L"W2", c_hiddenDim, c_inputDim);
+    auto output = builder.Plus(builder.Times(w1, features, 1, L"dense"), builder.Times(w2, sparseFeatures, 1, L"sparse"), L"output");
+    net->AddToNodeGroup(L"output", output);
+    net->CompileNetwork();
+
+    BOOST_CHECK_EQUAL(net->QuantizeTimesNodes<float>(/*bitShiftA=*/2, /*bitShiftB=*/2), 1);
+    BOOST_CHECK(ComputationNetwork::IsNodePtr<QuantizedTimesNode<float>>(net->GetNodeFromName(L"dense")));
+    BOOST_CHECK(ComputationNetwork::IsNodePtr<TimesNode<float>>(net->GetNodeFromName(L"sparse")));
+    BOOST_CHECK(dynamic_pointer_cast<QuantizedTimesNode<float>>(net->GetNodeFromName(L"dense"))->IsQuantized());
+
+    // a QuantizedTimes node with sparse data, e.g. from BrainScript, computes the unquantized product
+    auto sparseQuantized = builder.QuantizedTimes(w2, sparseFeatures, /*bitShiftA=*/2, /*bitShiftB=*/2, 1, L"sparseQuantized");
+    BOOST_CHECK(!dynamic_pointer_cast<QuantizedTimesNode<float>>(sparseQuantized)->IsQuantized());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
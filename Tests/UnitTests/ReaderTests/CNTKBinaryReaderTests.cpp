@@ -93,6 +93,24 @@ BOOST_AUTO_TEST_CASE(CNTKBinaryReader_50x20_jagged_sequences_dense)
         1);
 };
 
+// Same as above, but the chunks are served from a memory mapped file
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_50x20_jagged_sequences_dense_memory_mapped)
+{
+    HelperRunReaderTest<double>(
+        testDataPath() + "/Config/CNTKBinaryReader/test.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/50x20_jagged_sequences_dense.txt",
+        testDataPath() + "/Control/CNTKBinaryReader/50x20_jagged_sequences_dense_memory_mapped_Output.txt",
+        "50x20_jagged_sequences_dense_memory_mapped",
+        "reader",
+        508,  // epoch size
+        508,  // mb size 
+        1,  // num epochs
+        1,
+        0,
+        0,
+        1);
+};
+
 // 10 sequences with 10 samples each (no randomization)
 BOOST_AUTO_TEST_CASE(CNTKBinaryReader_10x10_sparse)
 {
@@ -131,6 +149,25 @@ BOOST_AUTO_TEST_CASE(CNTKBinaryReader_50x20_jagged_sequences_sparse)
         true);
 };
 
+// Same as above, but the chunks are served from a memory mapped file
+BOOST_AUTO_TEST_CASE(CNTKBinaryReader_50x20_jagged_sequences_sparse_memory_mapped)
+{
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/CNTKBinaryReader/test.cntk",
+        testDataPath() + "/Control/CNTKTextFormatReader/50x20_jagged_sequences_sparse.txt",
+        testDataPath() + "/Control/CNTKBinaryReader/50x20_jagged_sequences_sparse_memory_mapped_Output.txt",
+        "50x20_jagged_sequences_sparse_memory_mapped",
+        "reader",
+        564,  // epoch size
+        564,  // mb size 
+        1,  // num epochs
+        1,
+        0,
+        0,
+        1,
+        true);
+};
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
@@ -13,6 +13,8 @@
 #define _fileno fileno
 #endif
 #include <cstdio>
+#include <chrono>
+#include <random>
 #include <boost/scope_exit.hpp>
 #include "Common/ReaderTestHelper.h"
 #include "TextParser.h"
@@ -33,13 +35,14 @@ public:
     ChunkPtr m_chunk;
 
     CNTKTextFormatReaderTestRunner(const string& filename,
-        const vector<StreamDescriptor>& streams, unsigned int maxErrors) :
+        const vector<StreamDescriptor>& streams, unsigned int maxErrors, bool useFastNumberParser = true) :
         m_parser(std::make_shared<CorpusDescriptor>(true), wstring(filename.begin(), filename.end()), streams, true)
     {
         m_parser.SetMaxAllowedErrors(maxErrors);
         m_parser.SetTraceLevel(TextParser<ElemType>::TraceLevel::Info);
         m_parser.SetChunkSize(SIZE_MAX);
         m_parser.SetNumRetries(0);
+        m_parser.SetUseFastNumberParser(useFastNumberParser);
         m_parser.Initialize();
     }
     // Retrieves a chunk of data.
@@ -879,6 +882,209 @@ BOOST_AUTO_TEST_CASE(CNTKTextFormatReaderNoFirstMinibatchData)
         2);
 };
 
+// Indexing the input in parallel (using tiny ranges to force sequences spanning
+// several ranges) and restoring the index from the cache must produce the same index as
+// the sequential indexer.
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_parallel_and_cached_indexing)
+{
+    auto checkIndicesEqual = [](const Index& expected, const Index& actual)
+    {
+        BOOST_REQUIRE_EQUAL(expected.m_chunks.size(), actual.m_chunks.size());
+        BOOST_REQUIRE(expected.m_keyToSequenceInChunk == actual.m_keyToSequenceInChunk);
+        for (size_t i = 0; i < expected.m_chunks.size(); ++i)
+        {
+            const auto& e = expected.m_chunks[i];
+            const auto& a = actual.m_chunks[i];
+            BOOST_REQUIRE_EQUAL(e.m_id, a.m_id);
+            BOOST_REQUIRE_EQUAL(e.m_offset, a.m_offset);
+            BOOST_REQUIRE_EQUAL(e.m_byteSize, a.m_byteSize);
+            BOOST_REQUIRE_EQUAL(e.m_numberOfSamples, a.m_numberOfSamples);
+            BOOST_REQUIRE_EQUAL(e.m_sequences.size(), a.m_sequences.size());
+            for (size_t j = 0; j < e.m_sequences.size(); ++j)
+            {
+                BOOST_REQUIRE_EQUAL(e.m_sequences[j].m_key.m_sequence, a.m_sequences[j].m_key.m_sequence);
+                BOOST_REQUIRE_EQUAL(e.m_sequences[j].m_numberOfSamples, a.m_sequences[j].m_numberOfSamples);
+                BOOST_REQUIRE_EQUAL(e.m_sequences[j].OffsetInChunk(), a.m_sequences[j].OffsetInChunk());
+                BOOST_REQUIRE_EQUAL(e.m_sequences[j].SizeInBytes(), a.m_sequences[j].SizeInBytes());
+            }
+        }
+    };
+
+    auto corpus = std::make_shared<CorpusDescriptor>(true);
+    const size_t chunkSize = 1024;
+    for (string filename : { "50x20_jagged_sequences_dense.txt", "100x100_jagged_sparse.txt", "MNIST_dense.txt", "contains_blank_lines.txt" })
+    {
+        wstring wfilename(filename.begin(), filename.end());
+        FILE* sequentialFile = fopenOrDie(filename, "rbS");
+        FILE* parallelFile = fopenOrDie(filename, "rbS");
+        FILE* cachedFile = fopenOrDie(filename, "rbS");
+        BOOST_SCOPE_EXIT(sequentialFile, parallelFile, cachedFile)
+        {
+            fclose(sequentialFile);
+            fclose(parallelFile);
+            fclose(cachedFile);
+        }
+        BOOST_SCOPE_EXIT_END
+
+        Indexer sequential(sequentialFile, false, false, '|', chunkSize);
+        sequential.Build(corpus);
+
+        for (size_t rangeSize : { 1, 100, 4096 })
+        {
+            FILE* f = fopenOrDie(filename, "rbS");
+            Indexer parallel(f, false, false, '|', chunkSize);
+            parallel.BuildInParallel(corpus, wfilename, 4, rangeSize);
+            fclose(f);
+
+            BOOST_REQUIRE_EQUAL(sequential.HasSequenceIds(), parallel.HasSequenceIds());
+            checkIndicesEqual(sequential.GetIndex(), parallel.GetIndex());
+        }
+
+        wstring cacheFilename = wfilename + L".index_Output";
+        sequential.SaveToCache(corpus, wfilename, cacheFilename);
+
+        Indexer cached(cachedFile, false, false, '|', chunkSize);
+        BOOST_REQUIRE(cached.TryLoadFromCache(corpus, wfilename, cacheFilename));
+        BOOST_REQUIRE_EQUAL(sequential.HasSequenceIds(), cached.HasSequenceIds());
+        checkIndicesEqual(sequential.GetIndex(), cached.GetIndex());
+
+        // The cache must not be used when the indexing parameters differ.
+        Indexer mismatched(parallelFile, false, true, '|', chunkSize);
+        BOOST_REQUIRE(!mismatched.TryLoadFromCache(corpus, wfilename, cacheFilename));
+
+        // Nor when it is empty, truncated or damaged; then the index remains empty, so that the file is indexed instead.
+        string narrowCacheFilename(cacheFilename.begin(), cacheFilename.end());
+        vector<char> cache;
+        {
+            ifstream in(narrowCacheFilename, ifstream::binary);
+            cache.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        }
+        auto tryLoadDamaged = [&](const vector<char>& contents)
+        {
+            {
+                ofstream out(narrowCacheFilename, ofstream::out | ofstream::binary | ofstream::trunc);
+                out.write(contents.data(), contents.size());
+            }
+            FILE* f = fopenOrDie(filename, "rbS");
+            Indexer damaged(f, false, false, '|', chunkSize);
+            bool loaded = damaged.TryLoadFromCache(corpus, wfilename, cacheFilename);
+            fclose(f);
+            BOOST_REQUIRE_EQUAL(loaded, !damaged.GetIndex().IsEmpty());
+            return loaded;
+        };
+
+        BOOST_CHECK(!tryLoadDamaged({}));
+        BOOST_CHECK(!tryLoadDamaged(vector<char>(cache.begin(), cache.begin() + 20)));
+        BOOST_CHECK(!tryLoadDamaged(vector<char>(cache.begin(), cache.end() - 1)));
+        auto damagedCache = cache;
+        damagedCache.insert(damagedCache.end(), 24, 0);
+        BOOST_CHECK(!tryLoadDamaged(damagedCache));
+
+        // The first sequence ends past the end of the input file. The sequences follow the 40 byte header,
+        // the second field of a sequence is its offset in the input file.
+        damagedCache = cache;
+        uint64_t offset = UINT64_MAX / 2;
+        memcpy(damagedCache.data() + 48, &offset, sizeof(offset));
+        BOOST_CHECK(!tryLoadDamaged(damagedCache));
+
+        BOOST_CHECK(tryLoadDamaged(cache));
+
+        boost::filesystem::remove(cacheFilename);
+    }
+};
+
+// Microbenchmark: parses the same dense and sparse input with the scalar state machine and
+// with the fast number parsing path, checks that the results are identical and reports rows/sec.
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_fast_number_parser_benchmark)
+{
+    const size_t numRows = 20000;
+    const size_t denseDim = 100;
+    const size_t sparseDim = 100000;
+    const size_t sparseNnz = 30;
+
+    vector<StreamDescriptor> streams(2);
+    streams[0].m_alias = "D";
+    streams[0].m_name = L"D";
+    streams[0].m_storageType = StorageType::dense;
+    streams[0].m_sampleDimension = denseDim;
+    streams[1].m_alias = "S";
+    streams[1].m_name = L"S";
+    streams[1].m_storageType = StorageType::sparse_csc;
+    streams[1].m_sampleDimension = sparseDim;
+
+    string denseFilename = "fast_number_parser_dense_Output.txt";
+    string sparseFilename = "fast_number_parser_sparse_Output.txt";
+    {
+        std::mt19937 rng(0);
+        std::uniform_real_distribution<double> values(-1000, 1000);
+        std::ofstream dense(denseFilename, std::ofstream::out);
+        std::ofstream sparse(sparseFilename, std::ofstream::out);
+        dense.precision(7);
+        sparse.precision(7);
+        for (size_t row = 0; row < numRows; ++row)
+        {
+            dense << "|D";
+            for (size_t i = 0; i < denseDim; ++i)
+                dense << " " << values(rng);
+            dense << "\n";
+
+            sparse << "|S";
+            for (size_t i = 0; i < sparseNnz; ++i)
+                sparse << " " << (rng() % sparseDim) << ":" << values(rng);
+            sparse << "\n";
+        }
+    }
+
+    BOOST_SCOPE_EXIT(denseFilename, sparseFilename)
+    {
+        boost::filesystem::remove(denseFilename);
+        boost::filesystem::remove(sparseFilename);
+    }
+    BOOST_SCOPE_EXIT_END
+
+    for (const auto& filename : { denseFilename, sparseFilename })
+    {
+        CNTKTextFormatReaderTestRunner<float> scalar(filename, streams, 0, false);
+        CNTKTextFormatReaderTestRunner<float> fast(filename, streams, 0, true);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        scalar.LoadChunk();
+        double scalarSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        start = std::chrono::high_resolution_clock::now();
+        fast.LoadChunk();
+        double fastSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        fprintf(stderr, "%s: scalar parser %.0f rows/sec, fast parser %.0f rows/sec (%.2fx)\n",
+            filename.c_str(), numRows / scalarSeconds, numRows / fastSeconds, scalarSeconds / fastSeconds);
+
+        bool isDense = (filename == denseFilename);
+        for (size_t row = 0; row < numRows; ++row)
+        {
+            vector<SequenceDataPtr> expected, actual;
+            scalar.m_chunk->GetSequence(row, expected);
+            fast.m_chunk->GetSequence(row, actual);
+            BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+
+            auto& e = expected[isDense ? 0 : 1];
+            auto& a = actual[isDense ? 0 : 1];
+            if (isDense)
+            {
+                BOOST_REQUIRE_EQUAL(0, memcmp(e->GetDataBuffer(), a->GetDataBuffer(), denseDim * sizeof(float)));
+            }
+            else
+            {
+                auto& es = static_cast<SparseSequenceData&>(*e);
+                auto& as = static_cast<SparseSequenceData&>(*a);
+                BOOST_REQUIRE_EQUAL(es.m_totalNnzCount, as.m_totalNnzCount);
+                BOOST_REQUIRE(es.m_nnzCounts == as.m_nnzCounts);
+                BOOST_REQUIRE_EQUAL(0, memcmp(es.m_indices, as.m_indices, es.m_totalNnzCount * sizeof(IndexType)));
+                BOOST_REQUIRE_EQUAL(0, memcmp(e->GetDataBuffer(), a->GetDataBuffer(), es.m_totalNnzCount * sizeof(float)));
+            }
+        }
+    }
+};
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
@@ -5,6 +5,8 @@
 #include "stdafx.h"
 #include "Common/ReaderTestHelper.h"
 #include "CPUMatrix.h"
+#include "../../../Source/Readers/HTKDeserializers/MLFIndexer.h"
+#include <random>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -846,6 +848,225 @@ BOOST_AUTO_TEST_CASE(HTKIVectorBptt)
 
 BOOST_AUTO_TEST_SUITE_END()
 
+BOOST_AUTO_TEST_SUITE(MLFIndexerTestSuite)
+
+// Writes an MLF file with utterances of random length in the 4-column format (start, end, state name, state id),
+// which does not need a state list. Some utterances are separated by empty lines.
+static void WriteMLF(const string& filename, size_t numUtterances)
+{
+    std::mt19937 rng(0);
+    std::ofstream mlf(filename, std::ofstream::out | std::ofstream::binary);
+    mlf << "#!MLF!#\n";
+    for (size_t i = 0; i < numUtterances; ++i)
+    {
+        mlf << "\"utterance" << i << ".lab\"\n";
+        size_t numRanges = 1 + rng() % 20;
+        for (size_t r = 0, frame = 0; r < numRanges; ++r)
+        {
+            size_t numFrames = 1 + rng() % 10;
+            size_t state = rng() % 5;
+            mlf << frame << " " << frame + numFrames << " s" << state << " " << state << "\n";
+            frame += numFrames;
+        }
+        mlf << ".\n";
+        if (i % 7 == 0)
+            mlf << "\n";
+    }
+}
+
+static void CheckIndicesEqual(const Index& expected, const Index& actual)
+{
+    BOOST_REQUIRE_EQUAL(expected.m_chunks.size(), actual.m_chunks.size());
+    BOOST_REQUIRE(expected.m_keyToSequenceInChunk == actual.m_keyToSequenceInChunk);
+    for (size_t i = 0; i < expected.m_chunks.size(); ++i)
+    {
+        const auto& e = expected.m_chunks[i];
+        const auto& a = actual.m_chunks[i];
+        BOOST_REQUIRE_EQUAL(e.m_offset, a.m_offset);
+        BOOST_REQUIRE_EQUAL(e.m_byteSize, a.m_byteSize);
+        BOOST_REQUIRE_EQUAL(e.m_numberOfSamples, a.m_numberOfSamples);
+        BOOST_REQUIRE_EQUAL(e.m_sequences.size(), a.m_sequences.size());
+        for (size_t j = 0; j < e.m_sequences.size(); ++j)
+        {
+            BOOST_REQUIRE_EQUAL(e.m_sequences[j].m_key.m_sequence, a.m_sequences[j].m_key.m_sequence);
+            BOOST_REQUIRE_EQUAL(e.m_sequences[j].m_numberOfSamples, a.m_sequences[j].m_numberOfSamples);
+            BOOST_REQUIRE_EQUAL(e.m_sequences[j].OffsetInChunk(), a.m_sequences[j].OffsetInChunk());
+            BOOST_REQUIRE_EQUAL(e.m_sequences[j].SizeInBytes(), a.m_sequences[j].SizeInBytes());
+        }
+    }
+}
+
+// Returns the sequences of the index in order, with their offsets in the indexed file.
+static vector<pair<const SequenceDescriptor*, size_t>> GetSequences(const Index& index)
+{
+    vector<pair<const SequenceDescriptor*, size_t>> result;
+    for (const auto& chunk : index.m_chunks)
+    {
+        for (const auto& sequence : chunk.m_sequences)
+            result.push_back(make_pair(&sequence, chunk.m_offset + sequence.OffsetInChunk()));
+    }
+    return result;
+}
+
+// Indexing the MLF in parallel (using tiny ranges to force utterances spanning several ranges) must produce
+// the same index as the sequential indexer. The cache must restore the same utterances with the parsed labels.
+BOOST_AUTO_TEST_CASE(MLFIndexer_parallel_and_cached_indexing)
+{
+    const string filename = "MLFIndexer_Output.mlf";
+    const wstring wfilename(filename.begin(), filename.end());
+    const wstring cacheFilename = wfilename + L".cache";
+    const size_t chunkSize = 4096;
+    WriteMLF(filename, 500);
+
+    auto corpus = std::make_shared<CorpusDescriptor>(false);
+    FILE* sequentialFile = fopenOrDie(filename, "rbS");
+    MLFIndexer sequential(sequentialFile, /*frameMode=*/false, chunkSize);
+    sequential.Build(corpus);
+    fclose(sequentialFile);
+    BOOST_REQUIRE_EQUAL(GetSequences(sequential.GetIndex()).size(), 500);
+    BOOST_REQUIRE_GT(sequential.GetIndex().m_chunks.size(), 1);
+
+    for (size_t rangeSize : { 1, 100, 4096, 1024 * 1024 })
+    {
+        FILE* f = fopenOrDie(filename, "rbS");
+        MLFIndexer parallel(f, /*frameMode=*/false, chunkSize);
+        parallel.BuildInParallel(corpus, wfilename, 4, rangeSize);
+        fclose(f);
+
+        CheckIndicesEqual(sequential.GetIndex(), parallel.GetIndex());
+    }
+
+    sequential.SaveToCache(wfilename, cacheFilename, nullptr, 4);
+
+    FILE* cachedFile = fopenOrDie(filename, "rbS");
+    MLFIndexer cached(cachedFile, /*frameMode=*/false, chunkSize);
+    BOOST_REQUIRE(cached.TryLoadFromCache(corpus, wfilename, cacheFilename, nullptr));
+    fclose(cachedFile);
+    BOOST_REQUIRE(cached.GetCache() != nullptr);
+
+    // The offsets of the cached index refer to the label ranges in the cache, so only the utterances are compared.
+    std::vector<char> mlf;
+    {
+        std::ifstream in(filename, std::ifstream::binary);
+        mlf.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    auto expected = GetSequences(sequential.GetIndex());
+    auto actual = GetSequences(cached.GetIndex());
+    BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+    MLFUtteranceParser parser(nullptr);
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        BOOST_REQUIRE_EQUAL(expected[i].first->m_key.m_sequence, actual[i].first->m_key.m_sequence);
+        BOOST_REQUIRE_EQUAL(expected[i].first->m_numberOfSamples, actual[i].first->m_numberOfSamples);
+
+        vector<MLFFrameRange> expectedRanges;
+        auto begin = mlf.data() + expected[i].second;
+        BOOST_REQUIRE(parser.Parse(boost::make_iterator_range(begin, begin + expected[i].first->SizeInBytes()), expectedRanges, expected[i].second));
+
+        const auto* actualRanges = reinterpret_cast<const MLFFrameRange*>(cached.GetCache()->Data() + actual[i].second);
+        BOOST_REQUIRE_EQUAL(actual[i].first->SizeInBytes(), expectedRanges.size() * sizeof(MLFFrameRange));
+        for (size_t j = 0; j < expectedRanges.size(); ++j)
+        {
+            BOOST_REQUIRE_EQUAL(expectedRanges[j].FirstFrame(), actualRanges[j].FirstFrame());
+            BOOST_REQUIRE_EQUAL(expectedRanges[j].NumFrames(), actualRanges[j].NumFrames());
+            BOOST_REQUIRE_EQUAL(expectedRanges[j].ClassId(), actualRanges[j].ClassId());
+        }
+    }
+
+    boost::filesystem::remove(cacheFilename);
+    boost::filesystem::remove(filename);
+}
+
+// A cache that does not belong to the MLF file, or that is damaged, is not used.
+BOOST_AUTO_TEST_CASE(MLFIndexer_stale_or_corrupt_cache)
+{
+    const string filename = "MLFIndexer_stale_Output.mlf";
+    const wstring wfilename(filename.begin(), filename.end());
+    const string narrowCacheFilename = filename + ".cache";
+    const wstring cacheFilename(narrowCacheFilename.begin(), narrowCacheFilename.end());
+    const string stateListFilename = "MLFIndexer_stale_Output.states";
+    WriteMLF(filename, 50);
+
+    auto corpus = std::make_shared<CorpusDescriptor>(false);
+    {
+        FILE* f = fopenOrDie(filename, "rbS");
+        MLFIndexer indexer(f, /*frameMode=*/false);
+        indexer.Build(corpus);
+        fclose(f);
+        indexer.SaveToCache(wfilename, cacheFilename, nullptr, 1);
+    }
+
+    std::vector<char> cache;
+    {
+        std::ifstream in(narrowCacheFilename, std::ifstream::binary);
+        cache.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    auto writeCache = [&](const std::vector<char>& contents)
+    {
+        std::ofstream out(narrowCacheFilename, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+        out.write(contents.data(), contents.size());
+    };
+
+    auto tryLoad = [&](const StateTablePtr& states)
+    {
+        FILE* f = fopenOrDie(filename, "rbS");
+        MLFIndexer indexer(f, /*frameMode=*/false);
+        bool loaded = indexer.TryLoadFromCache(corpus, wfilename, cacheFilename, states);
+        fclose(f);
+        BOOST_REQUIRE_EQUAL(loaded, !indexer.GetIndex().IsEmpty());
+        return loaded;
+    };
+
+    BOOST_REQUIRE(tryLoad(nullptr));
+
+    // Created for another state list.
+    {
+        std::ofstream states(stateListFilename);
+        for (size_t i = 0; i < 5; ++i)
+            states << "s" << i << "\n";
+    }
+    auto states = std::make_shared<StateTable>();
+    states->ReadStateList(wstring(stateListFilename.begin(), stateListFilename.end()));
+    BOOST_CHECK(!tryLoad(states));
+
+    // The MLF file has been modified since.
+    auto modificationTime = boost::filesystem::last_write_time(filename);
+    boost::filesystem::last_write_time(filename, modificationTime + 10);
+    BOOST_CHECK(!tryLoad(nullptr));
+    boost::filesystem::last_write_time(filename, modificationTime);
+    BOOST_REQUIRE(tryLoad(nullptr));
+
+    // Empty, truncated, or with a damaged header.
+    writeCache({});
+    BOOST_CHECK(!tryLoad(nullptr));
+
+    writeCache(std::vector<char>(cache.begin(), cache.end() - 1));
+    BOOST_CHECK(!tryLoad(nullptr));
+
+    auto damaged = cache;
+    damaged[0] ^= 0xff;
+    writeCache(damaged);
+    BOOST_CHECK(!tryLoad(nullptr));
+
+    // The label ranges of the first utterance point past the end of the cache. The utterance records follow
+    // the 72 byte header, the first field of a record is the index of its first label range.
+    damaged = cache;
+    uint64_t firstRange = UINT64_MAX / 2;
+    memcpy(damaged.data() + 72, &firstRange, sizeof(firstRange));
+    writeCache(damaged);
+    BOOST_CHECK(!tryLoad(nullptr));
+
+    writeCache(cache);
+    BOOST_CHECK(tryLoad(nullptr));
+
+    boost::filesystem::remove(cacheFilename);
+    boost::filesystem::remove(filename);
+    boost::filesystem::remove(stateListFilename);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
 }
 
 }}}
@@ -379,6 +379,115 @@ BOOST_AUTO_TEST_CASE(ImageReaderMultiView)
         1);
 }
 
+BOOST_AUTO_TEST_CASE(ImageReaderMultiViewWithImageCache)
+{
+    // All copies but the first one of each image come from the cache, the output must stay the same.
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/ImageReaderMultiView_Config.cntk",
+        testDataPath() + "/Control/ImageReaderMultiView_Control.txt",
+        testDataPath() + "/Control/ImageReaderMultiView_Output.txt",
+        "MultiView_Test",
+        "reader",
+        10,
+        10,
+        1,
+        1,
+        0,
+        0,
+        1,
+        false,
+        false,
+        true,
+        { L"MultiView_Test=[reader=[imageCacheSizeInMB=1]]" });
+}
+
+BOOST_AUTO_TEST_CASE(ImageReaderReducedDecoding)
+{
+    // The 4x8 images are decoded at 1/4 of their resolution and scaled back up; as they are of a single color,
+    // the output must stay the same.
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/ImageReaderSimple_Config.cntk",
+        testDataPath() + "/Control/ImageReaderSimple_Control.txt",
+        testDataPath() + "/Control/ImageReaderSimple_Output.txt",
+        "Simple_Test",
+        "reader",
+        4,
+        4,
+        1,
+        1,
+        0,
+        0,
+        1,
+        false,
+        false,
+        true,
+        { L"Simple_Test=[reader=[decodeMinSide=1]]" });
+}
+
+static uintmax_t GetDirectorySize(const boost::filesystem::path& directory, size_t& numFiles)
+{
+    uintmax_t size = 0;
+    numFiles = 0;
+    for (boost::filesystem::directory_iterator it(directory); it != boost::filesystem::directory_iterator(); ++it)
+    {
+        size += boost::filesystem::file_size(it->path());
+        numFiles++;
+    }
+    return size;
+}
+
+BOOST_AUTO_TEST_CASE(ImageReaderDiskImageCache)
+{
+    const boost::filesystem::path cacheDirectory("ImageReaderDiskImageCache");
+    boost::filesystem::remove_all(cacheDirectory);
+    boost::filesystem::create_directories(cacheDirectory);
+
+    // An image left by an earlier run, which fills up most of the 1MB budget.
+    const boost::filesystem::path staleFile = cacheDirectory / "0000000000000000.img";
+    {
+        std::ofstream stale(staleFile.string(), std::ios::binary);
+        stale << std::string(1024 * 1024 - 64, '\0');
+    }
+    boost::filesystem::last_write_time(staleFile, boost::filesystem::last_write_time(staleFile) - 3600);
+
+    auto run = [&]()
+    {
+        HelperRunReaderTest<float>(
+            testDataPath() + "/Config/ImageReaderSimple_Config.cntk",
+            testDataPath() + "/Control/ImageReaderSimple_Control.txt",
+            testDataPath() + "/Control/ImageReaderSimple_Output.txt",
+            "Simple_Test",
+            "reader",
+            4,
+            4,
+            1,
+            1,
+            0,
+            0,
+            1,
+            false,
+            false,
+            true,
+            { L"Simple_Test=[reader=[imageCacheDirectory=ImageReaderDiskImageCache;imageCacheDiskSizeInMB=1]]" });
+    };
+
+    // The stale image counts towards the budget, and is deleted to make room for the decoded ones.
+    run();
+    BOOST_CHECK(!boost::filesystem::exists(staleFile));
+    size_t numFiles;
+    auto size = GetDirectorySize(cacheDirectory, numFiles);
+    BOOST_CHECK_EQUAL(numFiles, 4);
+    BOOST_CHECK_LE(size, 1024 * 1024);
+
+    // All images now come from the disk, the output must stay the same.
+    run();
+    size_t numFilesAfterRerun;
+    BOOST_CHECK_EQUAL(GetDirectorySize(cacheDirectory, numFilesAfterRerun), size);
+    BOOST_CHECK_EQUAL(numFilesAfterRerun, 4);
+
+    boost::filesystem::remove_all(cacheDirectory);
+}
+
 BOOST_AUTO_TEST_CASE(ImageReaderIntensityTransform)
 {
     HelperRunReaderTest<float>(
@@ -1635,6 +1635,133 @@ BOOST_AUTO_TEST_CASE(SequencePackerSmallChunksWithSequences)
 }
 
 
+BOOST_AUTO_TEST_CASE(SequencePackerWithBucketing)
+{
+    size_t chunkSizeInSamples = 998;
+    size_t sweepNumberOfSamples = 21335;
+    uint32_t maxSequenceLength = 300;
+    size_t randomizationWindow = chunkSizeInSamples * 5;
+    size_t bucketingWindow = 8;
+
+    auto deserializer = make_shared<SequentialDeserializer>(0, chunkSizeInSamples, sweepNumberOfSamples, maxSequenceLength);
+
+    {
+        auto blockRandomizer = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true);
+        PackerPtr packer = std::make_shared<SequencePacker>(blockRandomizer, deserializer->GetStreamDescriptions(), 1, true, nullptr, bucketingWindow);
+
+        CheckPackerOnDataSet(packer, blockRandomizer, deserializer, 1, sweepNumberOfSamples * 2, 2, sweepNumberOfSamples, 1024, false);
+        CheckPackerOnDataSet(packer, blockRandomizer, deserializer, 5, sweepNumberOfSamples * 2 / 5, 2, sweepNumberOfSamples, 1024, false);
+        CheckPackerOnDataSet(packer, blockRandomizer, deserializer, 5, sweepNumberOfSamples * 2 / 5, 2, sweepNumberOfSamples, 333, false);
+    }
+
+    {
+        auto noRandomizer = make_shared<NoRandomizer>(deserializer, true);
+        PackerPtr packer = std::make_shared<SequencePacker>(noRandomizer, deserializer->GetStreamDescriptions(), 1, true, nullptr, bucketingWindow);
+
+        CheckPackerOnDataSet(packer, noRandomizer, deserializer, 1, sweepNumberOfSamples * 2, 2, sweepNumberOfSamples, 1024, false);
+        CheckPackerOnDataSet(packer, noRandomizer, deserializer, 5, sweepNumberOfSamples * 2 / 5, 2, sweepNumberOfSamples, 333, false);
+    }
+
+    // Grouping sequences by length has to reduce the gaps in the minibatch layouts.
+    auto getPaddingEfficiency = [&](size_t window)
+    {
+        auto blockRandomizer = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true);
+        auto packer = std::make_shared<SequencePacker>(blockRandomizer, deserializer->GetStreamDescriptions(), 1, true, nullptr, window);
+
+        std::map<pair<size_t, size_t>, CorpusSubset> allData;
+        RunAllWorkers(1, deserializer->Corpus(), allData, packer, blockRandomizer, 1, sweepNumberOfSamples, 1024, false);
+        return packer->GetPaddingEfficiency();
+    };
+
+    auto efficiencyWithoutBucketing = getPaddingEfficiency(0);
+    auto efficiencyWithBucketing = getPaddingEfficiency(bucketingWindow);
+    BOOST_REQUIRE_LT(efficiencyWithoutBucketing, efficiencyWithBucketing);
+    BOOST_REQUIRE_GT(efficiencyWithBucketing, 0.8);
+}
+
+// Reads up to maxNumMinibatches minibatches or till the end of the epoch, returns the keys of the packed sequences in order.
+std::vector<size_t> ReadSequenceKeys(PackerPtr packer, size_t maxNumMinibatches)
+{
+    std::vector<size_t> keys;
+    for (size_t i = 0; i < maxNumMinibatches; ++i)
+    {
+        auto minibatch = packer->ReadMinibatch();
+        if (!minibatch.m_data.empty())
+        {
+            auto layout = minibatch.m_data.front()->m_layout;
+            auto data = (float*)minibatch.m_data.front()->m_data;
+            for (const auto& s : layout->GetAllSequences())
+            {
+                if (s.seqId != GAP_SEQUENCE_ID)
+                    keys.push_back((size_t)data[layout->GetNumParallelSequences() * s.tBegin + s.s]);
+            }
+        }
+
+        if (minibatch.m_endOfEpoch)
+            break;
+    }
+
+    return keys;
+}
+
+BOOST_AUTO_TEST_CASE(SequencePackerWithBucketingCheckpoint)
+{
+    size_t chunkSizeInSamples = 998;
+    size_t sweepNumberOfSamples = 21335;
+    uint32_t maxSequenceLength = 300;
+    size_t randomizationWindow = chunkSizeInSamples * 5;
+    size_t bucketingWindow = 8;
+
+    auto deserializer = make_shared<SequentialDeserializer>(0, chunkSizeInSamples, sweepNumberOfSamples, maxSequenceLength);
+
+    EpochConfiguration config;
+    config.m_minibatchSizeInSamples = 1024;
+    config.m_truncationSize = 0;
+    config.m_epochIndex = 0;
+    config.m_totalEpochSizeInSamples = sweepNumberOfSamples;
+    config.m_numberOfWorkers = 1;
+    config.m_workerRank = 0;
+
+    auto createPacker = [&](SequenceEnumeratorPtr& randomizer)
+    {
+        randomizer = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true);
+        PackerPtr packer = std::make_shared<SequencePacker>(randomizer, deserializer->GetStreamDescriptions(), 1, true, nullptr, bucketingWindow);
+        packer->SetConfiguration(config, std::vector<MemoryProviderPtr> { std::make_shared<HeapMemoryProvider>() });
+        randomizer->StartEpoch(config);
+        return packer;
+    };
+
+    // Take the checkpoint in the middle of the first pool.
+    SequenceEnumeratorPtr randomizer;
+    auto packer = createPacker(randomizer);
+    auto before = ReadSequenceKeys(packer, bucketingWindow / 2);
+    auto checkpoint = packer->GetCurrentSamplePosition();
+    BOOST_REQUIRE_LT(checkpoint, randomizer->GetCurrentSamplePosition());
+
+    // Setting the position the packer is at, as when the reader is reconfigured, keeps the pool.
+    packer->SetCurrentSamplePosition(checkpoint);
+    auto after = ReadSequenceKeys(packer, SIZE_MAX);
+
+    std::vector<size_t> epoch(before);
+    epoch.insert(epoch.end(), after.begin(), after.end());
+    std::vector<size_t> expectedEpoch;
+    for (const auto& s : deserializer->Corpus())
+        expectedEpoch.push_back(s.first);
+    std::sort(epoch.begin(), epoch.end());
+    BOOST_REQUIRE_EQUAL_COLLECTIONS(epoch.begin(), epoch.end(), expectedEpoch.begin(), expectedEpoch.end());
+
+    // A new reader restored from the checkpoint returns the whole first pool again, in the same order, followed by the rest of the epoch.
+    auto restoredPacker = createPacker(randomizer);
+    restoredPacker->SetCurrentSamplePosition(checkpoint);
+    auto restored = ReadSequenceKeys(restoredPacker, SIZE_MAX);
+
+    BOOST_REQUIRE_GT(restored.size(), after.size());
+    size_t numReplayed = restored.size() - after.size();
+    BOOST_REQUIRE_LE(numReplayed, before.size());
+    BOOST_CHECK_EQUAL_COLLECTIONS(restored.begin(), restored.begin() + numReplayed, before.end() - numReplayed, before.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(restored.begin() + numReplayed, restored.end(), after.begin(), after.end());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
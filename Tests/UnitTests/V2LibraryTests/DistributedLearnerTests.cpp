@@ -0,0 +1,397 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "CNTKLibrary.h"
+#include "Common.h"
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+
+using namespace CNTK;
+using namespace std;
+
+namespace CNTK { namespace Test {
+
+// The collectives of a group of in-process workers, each running in its own thread.
+class InProcessCollectives
+{
+public:
+    explicit InProcessCollectives(size_t numWorkers)
+        : m_numWorkers(numWorkers), m_inputs(numWorkers), m_arrived(0), m_generation(0)
+    {}
+
+    size_t NumWorkers() const { return m_numWorkers; }
+
+    void Barrier()
+    {
+        unique_lock<mutex> lock(m_mutex);
+        auto generation = m_generation;
+        if (++m_arrived == m_numWorkers)
+        {
+            m_arrived = 0;
+            m_generation++;
+            m_condition.notify_all();
+        }
+        else
+            m_condition.wait(lock, [&] { return m_generation != generation; });
+    }
+
+    void Concatenate(size_t rank, const vector<NDArrayViewPtr>& input, vector<NDArrayViewPtr>& output)
+    {
+        m_inputs[rank] = input;
+        Barrier();
+
+        // Like an MPI allgather, requires the same sizes on all workers; every worker checks all of them, so that
+        // all of them fail together instead of waiting for each other.
+        bool sizesMatch = true;
+        for (size_t w = 0; w < m_numWorkers; w++)
+        {
+            sizesMatch = sizesMatch && m_inputs[w].size() == input.size();
+            for (size_t i = 0; sizesMatch && i < input.size(); i++)
+                sizesMatch = m_inputs[w][i]->Shape().TotalSize() == input[i]->Shape().TotalSize() && m_inputs[w][i]->GetDataType() == input[i]->GetDataType();
+        }
+
+        if (sizesMatch)
+        {
+            output.resize(input.size());
+            for (size_t i = 0; i < input.size(); i++)
+            {
+                auto size = input[i]->Shape().TotalSize();
+                output[i] = MakeSharedObject<NDArrayView>(input[i]->GetDataType(), NDShape{ size * m_numWorkers }, DeviceDescriptor::CPUDevice());
+                for (size_t w = 0; w < m_numWorkers; w++)
+                {
+                    if (input[i]->GetDataType() == DataType::Float)
+                        memcpy(output[i]->WritableDataBuffer<float>() + w * size, m_inputs[w][i]->DataBuffer<float>(), size * sizeof(float));
+                    else
+                        memcpy(output[i]->WritableDataBuffer<double>() + w * size, m_inputs[w][i]->DataBuffer<double>(), size * sizeof(double));
+                }
+            }
+        }
+
+        Barrier();
+        if (!sizesMatch)
+            RuntimeError("Concatenate: the workers passed inputs of different sizes.");
+    }
+
+    void AggregateInPlace(size_t rank, const vector<NDArrayViewPtr>& values)
+    {
+        m_inputs[rank] = values;
+        Barrier();
+
+        vector<vector<double>> sums(values.size());
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            sums[i].assign(values[i]->Shape().TotalSize(), 0);
+            for (size_t w = 0; w < m_numWorkers; w++)
+            {
+                for (size_t j = 0; j < sums[i].size(); j++)
+                    sums[i][j] += values[i]->GetDataType() == DataType::Float ? m_inputs[w][i]->DataBuffer<float>()[j] : m_inputs[w][i]->DataBuffer<double>()[j];
+            }
+        }
+
+        Barrier();
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            for (size_t j = 0; j < sums[i].size(); j++)
+            {
+                if (values[i]->GetDataType() == DataType::Float)
+                    values[i]->WritableDataBuffer<float>()[j] = static_cast<float>(sums[i][j]);
+                else
+                    values[i]->WritableDataBuffer<double>()[j] = sums[i][j];
+            }
+        }
+        Barrier();
+    }
+
+private:
+    const size_t m_numWorkers;
+    vector<vector<NDArrayViewPtr>> m_inputs;
+    mutex m_mutex;
+    condition_variable m_condition;
+    size_t m_arrived;
+    size_t m_generation;
+};
+
+// A communicator for one of the in-process workers, that stands in for the MPI communicator.
+class InProcessCommunicator : public DistributedCommunicator
+{
+public:
+    InProcessCommunicator(const shared_ptr<InProcessCollectives>& collectives, size_t rank)
+        : m_collectives(collectives), m_rank(rank)
+    {
+        for (size_t i = 0; i < collectives->NumWorkers(); i++)
+        {
+            DistributedWorkerDescriptor worker;
+            worker.m_globalRank = i;
+            worker.m_hostId = L"localhost";
+            m_workers.insert(worker);
+            if (i == rank)
+                m_currentWorker = worker;
+        }
+    }
+
+    const unordered_set<DistributedWorkerDescriptor>& Workers() const override { return m_workers; }
+    const DistributedWorkerDescriptor& CurrentWorker() const override { return m_currentWorker; }
+
+    DistributedCommunicatorPtr SubGroup(const unordered_set<DistributedWorkerDescriptor>&) const override { NOT_IMPLEMENTED; }
+    void Concatenate(const vector<ValuePtr>&, vector<ValuePtr>&, const unordered_set<DistributedWorkerDescriptor>&) override { NOT_IMPLEMENTED; }
+    void Gather(const Dictionary&, vector<DictionaryPtr>&, const unordered_set<DistributedWorkerDescriptor>&) override { NOT_IMPLEMENTED; }
+    void Aggregate(const vector<NDArrayViewPtr>&, vector<NDArrayViewPtr>&, const unordered_set<DistributedWorkerDescriptor>&) override { NOT_IMPLEMENTED; }
+
+    void Concatenate(const vector<NDArrayViewPtr>& input, vector<NDArrayViewPtr>& output, const unordered_set<DistributedWorkerDescriptor>&) override
+    {
+        m_collectives->Concatenate(m_rank, input, output);
+    }
+
+    void AggregateInPlace(const vector<NDArrayViewPtr>& values, const unordered_set<DistributedWorkerDescriptor>&) override
+    {
+        m_collectives->AggregateInPlace(m_rank, values);
+    }
+
+    void Barrier() override { m_collectives->Barrier(); }
+
+private:
+    shared_ptr<InProcessCollectives> m_collectives;
+    size_t m_rank;
+    unordered_set<DistributedWorkerDescriptor> m_workers;
+    DistributedWorkerDescriptor m_currentWorker;
+};
+
+class StatisticsWriter : public ProgressWriter
+{
+public:
+    StatisticsWriter() : ProgressWriter(0, 0, 0, 0, 0, 0) {}
+
+    void Write(const wstring& key, double value) override { m_values[key].push_back(value); }
+
+    map<wstring, vector<double>> m_values;
+};
+
+static const size_t numWorkers = 3;
+static const size_t numMinibatches = 20;
+static const size_t numSamplesPerWorker = 4;
+static const vector<NDShape> parameterShapes = { { 50, 40 }, { 7 }, { 1 } };
+
+static NDArrayViewPtr WorkerGradient(size_t worker, size_t minibatch, size_t parameter)
+{
+    return NDArrayView::RandomUniform<float>(parameterShapes[parameter], -1, 1, (unsigned long)(1000 * worker + 100 * minibatch + parameter), DeviceDescriptor::CPUDevice());
+}
+
+static vector<Parameter> CreateWorkerParameters()
+{
+    vector<Parameter> parameters;
+    for (size_t i = 0; i < parameterShapes.size(); i++)
+        parameters.push_back(Parameter(NDArrayView::RandomUniform<float>(parameterShapes[i], -1, 1, (unsigned long)i, DeviceDescriptor::CPUDevice()), L"parameter_" + to_wstring(i)));
+    return parameters;
+}
+
+static vector<vector<float>> ParameterValues(const vector<Parameter>& parameters)
+{
+    vector<vector<float>> values;
+    for (const auto& parameter : parameters)
+    {
+        auto data = parameter.Value()->DataBuffer<float>();
+        values.push_back(vector<float>(data, data + parameter.Shape().TotalSize()));
+    }
+    return values;
+}
+
+// Trains the same parameters on all workers, each with its own gradients; returns the parameter values of each worker.
+static vector<vector<vector<float>>> TrainWorkers(double sparsity, double threshold, vector<shared_ptr<StatisticsWriter>>& writers,
+                                                  const function<void(size_t, size_t, unordered_map<Parameter, NDArrayViewPtr>&)>& modifyGradients = nullptr)
+{
+    // The distributed learners order the gradients by parameter uid. Separate processes create the same uids; here
+    // the uids of each worker start at the same last digit and have the same number of digits, so they sort alike.
+    vector<vector<Parameter>> parameters(numWorkers);
+    for (size_t w = 0; w < numWorkers; w++)
+    {
+        while (Parameter(NDShape{ 1 }, DataType::Float, 0.0, DeviceDescriptor::CPUDevice()).Uid().back() != L'9')
+            ;
+        parameters[w] = CreateWorkerParameters();
+    }
+
+    auto collectives = make_shared<InProcessCollectives>(numWorkers);
+    vector<vector<vector<float>>> values(numWorkers);
+    vector<exception_ptr> errors(numWorkers);
+    writers.clear();
+    for (size_t w = 0; w < numWorkers; w++)
+        writers.push_back(make_shared<StatisticsWriter>());
+
+    vector<thread> workers;
+    for (size_t w = 0; w < numWorkers; w++)
+    {
+        workers.emplace_back([&, w]()
+        {
+            try
+            {
+                auto device = DeviceDescriptor::CPUDevice();
+                auto learner = CreateSparseGradientDistributedLearner(make_shared<InProcessCommunicator>(collectives, w),
+                                                                      SGDLearner(parameters[w], LearningRatePerMinibatchSchedule(0.1)), 0, sparsity, threshold);
+                learner->AddProgressWriters({ writers[w] });
+
+                for (size_t m = 0; m < numMinibatches; m++)
+                {
+                    unordered_map<Parameter, NDArrayViewPtr> gradients;
+                    for (size_t i = 0; i < parameterShapes.size(); i++)
+                        gradients[parameters[w][i]] = WorkerGradient(w, m, i);
+                    if (modifyGradients)
+                        modifyGradients(w, m, gradients);
+
+                    MinibatchInfo info{ false, m % 10 == 9, numSamplesPerWorker,
+                                        MakeSharedObject<NDArrayView>(1.0f, NDShape{}, device), MakeSharedObject<NDArrayView>(2.0f, NDShape{}, device) };
+                    learner->Update(gradients, info);
+
+                    if (info.numberOfSamples != numWorkers * numSamplesPerWorker)
+                        RuntimeError("The number of samples was not aggregated.");
+                }
+
+                values[w] = ParameterValues(parameters[w]);
+            }
+            catch (...)
+            {
+                errors[w] = current_exception();
+            }
+        });
+    }
+
+    for (auto& worker : workers)
+        worker.join();
+
+    for (auto& error : errors)
+    {
+        if (error)
+            rethrow_exception(error);
+    }
+
+    return values;
+}
+
+// The result of training with the sum of the gradients of all workers.
+static vector<vector<float>> TrainDense()
+{
+    auto parameters = CreateWorkerParameters();
+    auto learner = SGDLearner(parameters, LearningRatePerMinibatchSchedule(0.1));
+    for (size_t m = 0; m < numMinibatches; m++)
+    {
+        unordered_map<Parameter, NDArrayViewPtr> gradients;
+        for (size_t i = 0; i < parameterShapes.size(); i++)
+        {
+            auto sum = MakeSharedObject<NDArrayView>(0.0f, parameterShapes[i], DeviceDescriptor::CPUDevice());
+            for (size_t w = 0; w < numWorkers; w++)
+            {
+                auto gradient = WorkerGradient(w, m, i);
+                for (size_t j = 0; j < parameterShapes[i].TotalSize(); j++)
+                    sum->WritableDataBuffer<float>()[j] += gradient->DataBuffer<float>()[j];
+            }
+            gradients[parameters[i]] = sum;
+        }
+        learner->Update(gradients, numWorkers * numSamplesPerWorker);
+    }
+    return ParameterValues(parameters);
+}
+
+static double MaxDifference(const vector<vector<float>>& a, const vector<vector<float>>& b)
+{
+    double difference = 0;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        for (size_t j = 0; j < a[i].size(); j++)
+            difference = max(difference, (double)fabs(a[i][j] - b[i][j]));
+    }
+    return difference;
+}
+
+static void CheckWorkersInSync(const vector<vector<vector<float>>>& values)
+{
+    for (size_t w = 1; w < numWorkers; w++)
+        BOOST_CHECK_EQUAL(MaxDifference(values[0], values[w]), 0);
+}
+
+BOOST_AUTO_TEST_SUITE(DistributedLearnerSuite)
+
+BOOST_AUTO_TEST_CASE(SparseGradientWithoutSparsityMatchesDenseAggregation)
+{
+    vector<shared_ptr<StatisticsWriter>> writers;
+    auto values = TrainWorkers(1.0, 0, writers);
+
+    CheckWorkersInSync(values);
+    BOOST_CHECK_LT(MaxDifference(values[0], TrainDense()), 1e-5);
+}
+
+BOOST_AUTO_TEST_CASE(SparseGradientTopK)
+{
+    vector<shared_ptr<StatisticsWriter>> writers;
+    auto values = TrainWorkers(0.01, 0, writers);
+    CheckWorkersInSync(values);
+
+    // one statistics report per sweep; k is 20, 1 and 1 entries of the 2008, each sent as an index and a value
+    for (const auto& writer : writers)
+    {
+        const auto& ratios = writer->m_values[L"Sparse gradient compression ratio"];
+        BOOST_REQUIRE_EQUAL(ratios.size(), 2);
+        BOOST_CHECK_CLOSE(ratios.back(), 2008.0 / (2 * 22), 1e-6);
+        BOOST_CHECK_EQUAL(writer->m_values[L"Sparse gradient communication time per minibatch (ms)"].size(), 2);
+    }
+
+    // the entries that are not sent stay in the residuals, so the result differs from, but approaches, the dense one
+    BOOST_CHECK_GT(MaxDifference(values[0], TrainDense()), 0);
+}
+
+BOOST_AUTO_TEST_CASE(SparseGradientThreshold)
+{
+    vector<shared_ptr<StatisticsWriter>> writers;
+    auto values = TrainWorkers(0.01, 1.5, writers);
+    CheckWorkersInSync(values);
+
+    const auto& ratios = writers[0]->m_values[L"Sparse gradient compression ratio"];
+    BOOST_REQUIRE_EQUAL(ratios.size(), 2);
+    BOOST_CHECK_GT(ratios.back(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(SparseGradientTopKWithNaNs)
+{
+    // One worker selects fewer than k entries of the first parameter because of NaNs in its residual;
+    // all workers must still exchange buffers of the same size.
+    vector<shared_ptr<StatisticsWriter>> writers;
+    auto values = TrainWorkers(0.01, 0, writers, [](size_t worker, size_t minibatch, unordered_map<Parameter, NDArrayViewPtr>& gradients)
+    {
+        if (worker != 1 || minibatch != 0)
+            return;
+
+        for (auto& gradient : gradients)
+        {
+            if (gradient.first.Shape() == parameterShapes[0])
+            {
+                auto data = gradient.second->WritableDataBuffer<float>();
+                for (size_t j = 0; j < parameterShapes[0].TotalSize(); j += 2)
+                    data[j] = numeric_limits<float>::quiet_NaN();
+            }
+        }
+    });
+
+    // the other parameters are not affected by the NaNs
+    for (size_t w = 1; w < numWorkers; w++)
+    {
+        for (size_t i = 1; i < parameterShapes.size(); i++)
+            BOOST_CHECK(values[0][i] == values[w][i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(SparseGradientInvalidArguments)
+{
+    auto parameters = CreateWorkerParameters();
+    auto communicator = make_shared<InProcessCommunicator>(make_shared<InProcessCollectives>(1), 0);
+    auto learner = SGDLearner(parameters, LearningRatePerMinibatchSchedule(0.1));
+
+    VerifyException([&]() { CreateSparseGradientDistributedLearner(communicator, learner, 0, 0); }, "Was able to create a learner with zero sparsity.");
+    VerifyException([&]() { CreateSparseGradientDistributedLearner(communicator, learner, 0, 1.5); }, "Was able to create a learner with sparsity above 1.");
+    VerifyException([&]() { CreateSparseGradientDistributedLearner(communicator, learner, 0, 0.1, -1); }, "Was able to create a learner with a negative threshold.");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}
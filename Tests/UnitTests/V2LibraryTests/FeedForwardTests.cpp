@@ -450,6 +450,45 @@ void TestTimesReduceSequenceAxis(
     }
 }
 
+// Evaluates Times(W, input) with W = { 0.5, 0.5, 0.5 } and input = { 1, 1, 3 }, returns the output.
+static float EvaluateTimes(const FunctionPtr& timesFunc, const Variable& inputVar, bool retainBackwardState)
+{
+    std::vector<float> inputData = { 1, 1, 3 };
+    auto inputValue = MakeSharedObject<Value>(MakeSharedObject<NDArrayView>(inputVar.Shape().AppendShape({ 1, 1 }), inputData, true));
+    std::unordered_map<Variable, ValuePtr> outputs = { { timesFunc->Output(), nullptr } };
+    std::unordered_set<Variable> outputsToRetainBackwardStateFor;
+    if (retainBackwardState)
+        outputsToRetainBackwardStateFor.insert(timesFunc->Output());
+    timesFunc->Forward({ { inputVar, inputValue } }, outputs, DeviceDescriptor::CPUDevice(), outputsToRetainBackwardStateFor);
+
+    NDArrayView cpuOutput(DataType::Float, outputs[timesFunc->Output()]->Shape(), DeviceDescriptor::CPUDevice());
+    cpuOutput.CopyFrom(*outputs[timesFunc->Output()]->Data());
+    return cpuOutput.DataBuffer<float>()[0];
+}
+
+// With evaluation quantization, the products of parameters and data in networks that are only evaluated are quantized.
+// The bit shift of the input leaves it only 2 bits, so that the quantization error shows: { 1, 1, 3 } is quantized to { 0.75, 0.75, 3 }.
+void TestQuantizedTimesForEvaluation()
+{
+    Internal::SetEvaluationQuantization(true, /*bitShiftA=*/2, /*bitShiftB=*/13);
+
+    auto device = DeviceDescriptor::CPUDevice();
+    Parameter timesParam(MakeSharedObject<NDArrayView>(0.5f, NDShape({ 1, 3 }), device), L"timesParameters");
+    auto inputVar = InputVariable({ 3 }, DataType::Float, L"input");
+    auto evaluatedFunc = Times(timesParam, inputVar);
+    FloatingPointCompare(EvaluateTimes(evaluatedFunc, inputVar, false), 2.25f, "Quantized product does not match the expected result");
+
+    // A network that shares the parameter is trained, its product is not quantized.
+    auto trainedFunc = Times(timesParam, inputVar);
+    FloatingPointCompare(EvaluateTimes(trainedFunc, inputVar, true), 2.5f, "Product computed for training does not match the expected result");
+
+    // The evaluated network quantizes the parameter again after its value has changed.
+    timesParam.SetValue(MakeSharedObject<NDArrayView>(1.0f, NDShape({ 1, 3 }), device));
+    FloatingPointCompare(EvaluateTimes(evaluatedFunc, inputVar, false), 4.5f, "Quantized product does not follow the update of the parameter");
+
+    Internal::SetEvaluationQuantization(false);
+}
+
 BOOST_AUTO_TEST_SUITE(FeedForwardSuite)
 
 BOOST_AUTO_TEST_CASE(FFTimesAndPlusInCPU)
@@ -462,6 +501,12 @@ BOOST_AUTO_TEST_CASE(ReduceableTransposeTimesInCPU)
     TestReduceableTransposeTimes<double>(4, 5, DeviceDescriptor::CPUDevice(), 3);
 }
 
+BOOST_AUTO_TEST_CASE(QuantizedTimesForEvaluationInCPU)
+{
+    if (ShouldRunOnCpu())
+        TestQuantizedTimesForEvaluation();
+}
+
 BOOST_AUTO_TEST_CASE(TimesReduceSequenceAxis)
 {
     if (ShouldRunOnGpu())
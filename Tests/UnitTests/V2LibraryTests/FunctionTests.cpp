@@ -5,6 +5,7 @@
 #include "stdafx.h"
 #include "CNTKLibrary.h"
 #include "Common.h"
+#include <thread>
 
 using namespace CNTK;
 
@@ -1001,6 +1002,82 @@ void TestFindName(const DeviceDescriptor& device)
     CheckFindAllWithNameResult(minusFunc4->FindAllWithName(aliasFuncName, true), aliasFuncName, 1);
 }
 
+template <typename ElementType>
+void TestEvaluationContextPool(const DeviceDescriptor& device)
+{
+    const size_t inputDim = 7, outputDim = 5, numContexts = 2, numThreads = 4, numIterations = 10, batchSize = 3;
+
+    auto input = InputVariable({ inputDim }, AsDataType<ElementType>(), L"features");
+    auto timesParam = Parameter({ outputDim, inputDim }, AsDataType<ElementType>(), GlorotUniformInitializer(), device);
+    auto plusParam = Parameter({ outputDim }, AsDataType<ElementType>(), 0.5, device);
+    auto model = Sigmoid(Plus(plusParam, Times(timesParam, input)), L"output");
+    auto output = model->Output();
+
+    auto pool = CreateEvaluationContextPool(model, numContexts, device);
+    BOOST_TEST(pool->NumContexts() == numContexts);
+
+    std::vector<std::vector<ElementType>> inputData(numThreads * numIterations);
+    for (auto& data : inputData)
+    {
+        data.resize(inputDim * batchSize);
+        for (auto& x : data)
+            x = (ElementType)rand() / RAND_MAX;
+    }
+
+    auto evaluate = [&](size_t i, const std::function<void(const std::unordered_map<Variable, ValuePtr>&, std::unordered_map<Variable, ValuePtr>&)>& evaluator)
+    {
+        std::unordered_map<Variable, ValuePtr> outputs = { { output, nullptr } };
+        evaluator({ { input, Value::CreateBatch(input.Shape(), inputData[i], device) } }, outputs);
+        std::vector<std::vector<ElementType>> outputData;
+        outputs[output]->CopyVariableValueTo(output, outputData);
+        return outputData;
+    };
+
+    // Evaluating with the pool from several threads must produce the results of evaluating the model itself.
+    auto runAndCompare = [&]()
+    {
+        std::vector<std::vector<std::vector<ElementType>>> expected(inputData.size()), actual(inputData.size());
+        for (size_t i = 0; i < inputData.size(); ++i)
+            expected[i] = evaluate(i, [&](const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputs) { model->Evaluate(arguments, outputs, device); });
+
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < numThreads; ++t)
+        {
+            threads.emplace_back([&, t]()
+            {
+                for (size_t i = t; i < inputData.size(); i += numThreads)
+                {
+                    auto context = pool->Acquire();
+                    actual[i] = evaluate(i, [&](const std::unordered_map<Variable, ValuePtr>& arguments, std::unordered_map<Variable, ValuePtr>& outputs) { context->Evaluate(arguments, outputs); });
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+            thread.join();
+
+        for (size_t i = 0; i < inputData.size(); ++i)
+        {
+            BOOST_TEST(actual[i].size() == expected[i].size());
+            for (size_t j = 0; j < expected[i].size(); ++j)
+                FloatingPointVectorCompare(actual[i][j], expected[i][j], "Output of the evaluation context pool does not match the output of the model.");
+        }
+    };
+
+    runAndCompare();
+
+    // The contexts share the parameters of the model.
+    plusParam.SetValue(MakeSharedObject<NDArrayView>(ElementType(-1.0), plusParam.Shape(), device));
+    runAndCompare();
+
+    // Outputs that are not outputs of the pooled model are rejected.
+    auto otherModel = Sigmoid(input);
+    std::unordered_map<Variable, ValuePtr> otherOutputs = { { otherModel->Output(), nullptr } };
+    VerifyException([&]() {
+        pool->Acquire()->Evaluate({ { input, Value::CreateBatch(input.Shape(), inputData[0], device) } }, otherOutputs);
+    }, "Was able to evaluate an output that does not belong to the pooled Function.");
+}
+
 BOOST_AUTO_TEST_SUITE(FunctionSuite)
 
 BOOST_AUTO_TEST_CASE(FindNameInCPU)
@@ -1108,6 +1185,21 @@ BOOST_AUTO_TEST_CASE(TimesIndirectSparseGradType)
         TestTimesIndirectSparseInputGradientSparse(DeviceDescriptor::CPUDevice());
 }
 
+BOOST_AUTO_TEST_CASE(EvaluationContextPoolInCPU)
+{
+    if (ShouldRunOnCpu())
+    {
+        TestEvaluationContextPool<float>(DeviceDescriptor::CPUDevice());
+        TestEvaluationContextPool<double>(DeviceDescriptor::CPUDevice());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(EvaluationContextPoolInGPU)
+{
+    if (ShouldRunOnGpu())
+        TestEvaluationContextPool<float>(DeviceDescriptor::GPUDevice(0));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }}
@@ -115,6 +115,77 @@ void TestRMSPropLearner(size_t numParameters, size_t numMinibatches, const Devic
     TestUpdate<ElementType>(learner, shape, numMinibatches, device);
 }
 
+// Updates two copies of the same parameters with the same gradients, one by one and all at once (fuseParameterUpdates),
+// which must result in the same values.
+template <typename ElementType>
+void TestFusedParameterUpdates(const function<LearnerPtr(const vector<Parameter>&, AdditionalLearningOptions)>& createLearner,
+                               size_t numParameters, size_t numMinibatches, bool clipWithTruncation)
+{
+    auto device = DeviceDescriptor::CPUDevice();
+    AdditionalLearningOptions additionalOptions;
+    additionalOptions.l2RegularizationWeight = 0.01;
+    additionalOptions.gradientClippingThresholdPerSample = 0.5;
+    additionalOptions.gradientClippingWithTruncation = clipWithTruncation;
+
+    vector<NDShape> shapes;
+    for (size_t i = 0; i < numParameters; i++)
+        shapes.push_back(CreateShape(rng() % maxNumAxes + 1, maxDimSize));
+
+    vector<Parameter> parameters[2];
+    LearnerPtr learners[2];
+    for (size_t k = 0; k < 2; k++)
+    {
+        for (size_t i = 0; i < numParameters; i++)
+            parameters[k].push_back(Parameter(NDArrayView::RandomUniform<ElementType>(shapes[i], -1.0, 1.0, i, device), L"parameter_" + to_wstring(i)));
+
+        additionalOptions.fuseParameterUpdates = (k == 1);
+        learners[k] = createLearner(parameters[k], additionalOptions);
+    }
+
+    auto seed = (unsigned long) rng();
+    for (size_t j = 0; j < numMinibatches; j++)
+    {
+        for (size_t k = 0; k < 2; k++)
+        {
+            unordered_map<Parameter, NDArrayViewPtr> gradientValues;
+            for (size_t i = 0; i < numParameters; i++)
+                gradientValues[parameters[k][i]] = NDArrayView::RandomUniform<ElementType>(shapes[i], -1.0, 1.0, seed + j * numParameters + i, device);
+
+            learners[k]->Update(gradientValues, 1 + j);
+        }
+    }
+
+    for (size_t i = 0; i < numParameters; i++)
+    {
+        auto expected = parameters[0][i].Value()->DataBuffer<ElementType>();
+        auto actual = parameters[1][i].Value()->DataBuffer<ElementType>();
+        FloatingPointVectorCompare(vector<ElementType>(actual, actual + shapes[i].TotalSize()), vector<ElementType>(expected, expected + shapes[i].TotalSize()),
+                                   "Parameter values of the fused update do not match the values of the update of the individual parameters");
+    }
+}
+
+void TestFusedParameterUpdates(size_t numParameters, size_t numMinibatches)
+{
+    LearningRatePerSampleSchedule learningRateSchedule(0.1);
+    MomentumPerMinibatchSchedule momentumSchedule(0.9);
+    vector<function<LearnerPtr(const vector<Parameter>&, AdditionalLearningOptions)>> createLearners = {
+        [&](const vector<Parameter>& parameters, AdditionalLearningOptions options) { return SGDLearner(parameters, learningRateSchedule, options); },
+        [&](const vector<Parameter>& parameters, AdditionalLearningOptions options) { return MomentumSGDLearner(parameters, learningRateSchedule, momentumSchedule, true, options); },
+        [&](const vector<Parameter>& parameters, AdditionalLearningOptions options) { return NesterovLearner(parameters, learningRateSchedule, momentumSchedule, false, options); },
+        [&](const vector<Parameter>& parameters, AdditionalLearningOptions options) { return FSAdaGradLearner(parameters, learningRateSchedule, momentumSchedule, true, MomentumPerMinibatchSchedule(0.99), options); },
+        [&](const vector<Parameter>& parameters, AdditionalLearningOptions options) { return AdamLearner(parameters, learningRateSchedule, momentumSchedule, true, MomentumPerMinibatchSchedule(0.99), options); },
+    };
+
+    for (const auto& createLearner : createLearners)
+    {
+        for (auto clipWithTruncation : { true, false })
+        {
+            TestFusedParameterUpdates<float>(createLearner, numParameters, numMinibatches, clipWithTruncation);
+            TestFusedParameterUpdates<double>(createLearner, numParameters, numMinibatches, clipWithTruncation);
+        }
+    }
+}
+
 void TestTrainingParametersSchedule()
 {
     LearningRatePerSampleSchedule schedule1 = 0.5;
@@ -417,6 +488,12 @@ BOOST_AUTO_TEST_CASE(CreateAndUpdateAdamLearner)
     }
 }
 
+BOOST_AUTO_TEST_CASE(FusedParameterUpdates)
+{
+    if (ShouldRunOnCpu())
+        TestFusedParameterUpdates(numParameters, numMinibatches);
+}
+
 BOOST_AUTO_TEST_CASE(TestResettingLearningRate)
 {
     NDShape shape = { 1 };
@@ -923,6 +923,65 @@ void TestLoadingModelFromMemoryBufferWithException()
     delete[] modelBuffer;
 }
 
+void TestRawTensorModelSaveAndLoad(const DeviceDescriptor& device)
+{
+    auto file = L"TestRawTensorModelSaveAndLoad.out";
+    auto inputVar = InputVariable({ 20 }, false, DataType::Float, L"features");
+    auto function = BuildLSTMClassifierNet(inputVar, 5, device);
+    function->SaveModel(file, ModelFormat::CNTKv2RawTensors);
+
+    auto reloadedFunction = Function::LoadModel(file, device);
+    if (!AreEqual(function, reloadedFunction))
+        BOOST_ERROR("TestRawTensorModelSaveAndLoad: original and reloaded functions are not identical.");
+
+    if (device.Type() == DeviceKind::CPU)
+    {
+        // The values are used in place, and updating them must not change the file.
+        for (auto& parameter : reloadedFunction->Parameters())
+        {
+            if ((reinterpret_cast<uintptr_t>(parameter.Value()->DataBuffer<float>()) % 64) != 0)
+                BOOST_ERROR("TestRawTensorModelSaveAndLoad: the values of a memory-mapped model are not 64-byte aligned.");
+            parameter.Value()->SetValue(0.0f);
+        }
+
+        if (!AreEqual(function, Function::LoadModel(file, device)))
+            BOOST_ERROR("TestRawTensorModelSaveAndLoad: updating the parameters of a memory-mapped model changed the model file.");
+    }
+
+    // A model loaded from the file can be saved to the same file, in either format; the file is replaced rather than
+    // overwritten, so that the values of the loaded model remain intact.
+    for (auto format : { ModelFormat::CNTKv2RawTensors, ModelFormat::CNTKv2 })
+    {
+        auto loadedFunction = Function::LoadModel(file, device);
+        try
+        {
+            loadedFunction->SaveModel(file, format);
+        }
+        catch (const std::runtime_error&)
+        {
+#ifdef _WIN32
+            // Windows without POSIX rename semantics (before Windows 10 1607, or not NTFS) cannot replace a mapped
+            // file; the save then fails and leaves the file unchanged.
+#else
+            throw;
+#endif
+        }
+        if (!AreEqual(function, loadedFunction))
+            BOOST_ERROR("TestRawTensorModelSaveAndLoad: saving a model to the file it was loaded from changed the model.");
+        if (!AreEqual(function, Function::LoadModel(file, device)))
+            BOOST_ERROR("TestRawTensorModelSaveAndLoad: a model saved to the file it was loaded from is not identical to the original.");
+    }
+
+    // no model uses the file anymore, so it can be replaced everywhere
+    reloadedFunction = nullptr;
+    function->SaveModel(file, ModelFormat::CNTKv2RawTensors);
+
+    auto stream = GetFstream(file, true);
+    vector<char> modelBuffer((istreambuf_iterator<char>(*stream)), istreambuf_iterator<char>());
+    if (!AreEqual(function, Function::LoadModel(modelBuffer.data(), modelBuffer.size(), device)))
+        BOOST_ERROR("TestRawTensorModelSaveAndLoad: original function and the function loaded from a memory buffer are not identical.");
+}
+
 BOOST_AUTO_TEST_SUITE(SerializationSuite)
 
 BOOST_AUTO_TEST_CASE(LoadingModelFromMemoryBuffer)
@@ -981,6 +1040,11 @@ BOOST_AUTO_TEST_CASE(FunctionSerializationInCPU)
     TestFunctionSerialization(DeviceDescriptor::CPUDevice());
 }
 
+BOOST_AUTO_TEST_CASE(RawTensorModelSerializationInCPU)
+{
+    TestRawTensorModelSaveAndLoad(DeviceDescriptor::CPUDevice());
+}
+
 BOOST_AUTO_TEST_CASE(ModelSerializationDuringTrainingInCPU)
 {
     TestModelSerializationDuringTraining(DeviceDescriptor::CPUDevice());
@@ -1034,6 +1098,14 @@ BOOST_AUTO_TEST_CASE(FunctionSerializationInGPU)
     }
 }
 
+BOOST_AUTO_TEST_CASE(RawTensorModelSerializationInGPU)
+{
+    if (ShouldRunOnGpu())
+    {
+        TestRawTensorModelSaveAndLoad(DeviceDescriptor::GPUDevice(0));
+    }
+}
+
 BOOST_AUTO_TEST_CASE(ModelSerializationDuringTrainingInGPU)
 {
     if (ShouldRunOnGpu())
@@ -328,6 +328,8 @@ SWIG_STD_VECTOR_ENHANCED(CNTK::DeviceDescriptor)
 %ignore_function CNTK::Internal::GetComputationNetworkTraceLevel;
 %ignore_function CNTK::Internal::SetComputationNetworkTrackGapNans;
 %ignore_function CNTK::Internal::GetComputationNetworkTrackGapNans;
+%ignore_function CNTK::Internal::SetComputationNetworkNodeProfiling;
+%ignore_function CNTK::Internal::GetComputationNetworkNodeProfiling;
 %ignore_function CNTK::Internal::SetGPUMemoryAllocationTraceLevel;
 %ignore_function CNTK::Internal::ForceSynchronousCUDAKernelExecutions;
 %ignore_function CNTK::Internal::ForceDeterministicAlgorithms;